@@ -17,11 +17,13 @@
 namespace ClientCore
 {
 std::shared_ptr<spdlog::logger> CClientSess::ms_loger;
+bool CClientSess::ms_bAllowBinary = true;
 
 CClientSess::CClientSess(asio::io_service &ioService, std::string &strIp,
 						 int port, CMediumServer *queue)
 	: m_ioService(ioService), m_serverIp(strIp), m_serverPort(port),
-	  m_queue(queue), m_socket(ioService), m_bConnect(ST_NOT_CONNECT)
+	  m_queue(queue), m_socket(ioService), m_bConnect(ST_NOT_CONNECT),
+	  m_recvbuf(MSG_DEFAULT_FRAME_SIZE)
 {
 	m_connectInfo = m_serverIp + ":" + std::to_string(m_serverPort);
 	//StartConnect();
@@ -49,6 +51,11 @@ int CClientSess::StartConnect()
 				if (!ec)
 				{
 					m_bConnect = ST_CONN_FINISHED;
+					//新的连接需要重新登录协商消息长度
+					m_recvpos = 0;
+					SetFrameSize(MSG_DEFAULT_FRAME_SIZE, FILE_DATA_CHUNK_SIZE);
+					//新的连接可能是旧版本的服务器,确认支持以前使用json
+					m_bBinaryCodec = false;
 					{
 						//m_connectInfo.clear();
 						//m_connectInfo = m_socket.local_endpoint().address().to_v4().to_string() + ":" + std::to_string(m_socket.local_endpoint().port());
@@ -118,9 +125,24 @@ void CClientSess::OnSocketError()
  */
 void CClientSess::handle_message(const TransBaseMsg_t& hdr)
 {
-	if (hdr.GetType() != E_MsgType::FileRecvDataReq_Type && hdr.GetType() != E_MsgType::FileSendDataReq_Type)
+	if (hdr.IsBinary() && !IsFileDataMsgType(hdr.GetType()))
 	{
-		LOG_INFO(ms_loger, "[{}] TCP Recv: {} Msg:{} {} [{} {}]",UserId(), GetConnectInfo(), MsgType(hdr.GetType()), hdr.to_string(), __FILENAME__, __LINE__);
+		EnableBinaryCodec();
+		//服务器的二进制消息在此处转为json,之后的处理和转发给界面的消息保持不变,文件数据帧保持二进制
+		auto pJsonMsg = ToJsonTransMsg(hdr);
+		if (pJsonMsg)
+		{
+			handle_message(*pJsonMsg);
+		}
+		else
+		{
+			LOG_WARN(ms_loger, "[{}] TCP Recv: {} Decode Failed:{} [{} {}]", UserId(), GetConnectInfo(), MsgType(hdr.GetType()), __FILENAME__, __LINE__);
+		}
+		return;
+	}
+	if (!IsFileDataMsgType(hdr.GetType()))
+	{
+		LOG_INFO(ms_loger, "[{}] TCP Recv: {} Msg:{} {} [{} {}]",UserId(), GetConnectInfo(), MsgType(hdr.GetType()), CLogSampler::Payload(hdr), __FILENAME__, __LINE__);
 	}
 	if (m_queue)
 	{
@@ -128,6 +150,19 @@ void CClientSess::handle_message(const TransBaseMsg_t& hdr)
 	}
 }
 
+/**
+ * @brief 服务器支持二进制编码,之后发送的消息使用二进制编码,配置关闭时保持json
+ * 
+ */
+void CClientSess::EnableBinaryCodec()
+{
+	if (ms_bAllowBinary && !m_bBinaryCodec)
+	{
+		m_bBinaryCodec = true;
+		LOG_INFO(ms_loger, "[{}] {} Use Binary Codec [{} {}]", UserId(), GetConnectInfo(), __FILENAME__, __LINE__);
+	}
+}
+
 /**
  * @brief 从socket读取数据
  *
@@ -138,20 +173,25 @@ int CClientSess::do_read()
 	if (IsConnect())
 	{
 		auto self = shared_from_this();
+		//登录协商以后扩大接收缓冲区,此时没有未完成的读取,已接收的数据保留
+		if (m_recvbuf.size() < static_cast<std::size_t>(m_nMaxFrameSize))
+		{
+			m_recvbuf.resize(static_cast<std::size_t>(m_nMaxFrameSize));
+		}
 		m_socket.async_read_some(
-			asio::buffer(m_recvbuf + m_recvpos, max_length - m_recvpos),
+			asio::buffer(m_recvbuf.data() + m_recvpos, m_recvbuf.size() - m_recvpos),
 			[this, self](std::error_code ec, std::size_t length) {
-			TransBaseMsg_t msg(m_recvbuf);
+			TransBaseMsg_t msg(m_recvbuf.data());
 			auto curlen = m_recvpos + length;
 			//此处必须为 >=，否则需要等到下一条消息到来的时候，前一条消息才能处理
 			while (curlen >= sizeof(Header) && curlen >= msg.GetSize())
 			{
 				handle_message(msg);
 				curlen -= msg.GetSize();
-				memmove(m_recvbuf, m_recvbuf + msg.GetSize(), curlen);
+				memmove(m_recvbuf.data(), m_recvbuf.data() + msg.GetSize(), curlen);
 			}
 			m_recvpos = (uint32_t)curlen;
-			if (m_recvpos < max_length && !ec)
+			if ((m_recvpos < m_recvbuf.size() || m_recvbuf.size() < static_cast<std::size_t>(m_nMaxFrameSize)) && !ec)
 			{
 				do_read();
 			}
@@ -177,7 +217,7 @@ int CClientSess::do_read()
  */
 bool CClientSess::SendMsg(const BaseMsg* pMsg)
 {
-	auto pSend = std::make_shared<TransBaseMsg_t>(pMsg->GetMsgType(), pMsg->ToString());
+	auto pSend = std::make_shared<TransBaseMsg_t>(*pMsg, m_bBinaryCodec);
 	return SendMsg(pSend);
 }
 
@@ -203,33 +243,70 @@ bool CClientSess::SendMsg(std::shared_ptr<TransBaseMsg_t> pMsg)
 {
 	if (IsConnect())
 	{
-		auto self = shared_from_this();
-		asio::async_write(
-			m_socket, asio::buffer(pMsg->GetData(), pMsg->GetSize()),
-			[this, self, pMsg](std::error_code ec, std::size_t /*length*/) mutable {
-				if (ec)
-				{
-					LOG_ERR(ms_loger, "[{}] TCP Send: {} Msg:{}{} [{} {}]", UserId(), GetConnectInfo(), MsgType(pMsg->GetType()), pMsg->to_string(), __FILENAME__, __LINE__);
-					OnSocketError();
-				}
-				else
-				{
-					if (pMsg->GetType() != E_MsgType::FileRecvDataReq_Type && pMsg->GetType() != E_MsgType::FileSendDataReq_Type)
-					{
-						LOG_INFO(ms_loger, "[{}] TCP Send: {} Msg:{} {} [{} {}]",UserId(),GetConnectInfo(), MsgType(pMsg->GetType()), pMsg->to_string(), __FILENAME__, __LINE__);
-					}
-				}
-			});
+		if (E_SEND_QUEUE_PUSH::START_SEND == m_sendQueue.Push(pMsg))
+		{
+			DoSendMsg();
+		}
 	}
 	else
 	{
-		LOG_WARN(ms_loger, "{} Not TCP Connect {}", GetConnectInfo(), pMsg->to_string());
+		LOG_WARN(ms_loger, "{} Not TCP Connect {}", GetConnectInfo(), pMsg->ToPrintString());
 		StartConnect();
 	}
 	return true;
 }
 
 
+/**
+ * @brief 发送队列中的消息,排队的消息合并为一批,用一次async_write发送,
+ *        buffer直接指向每条消息自己的数据,不做拷贝
+ *
+ */
+void CClientSess::DoSendMsg()
+{
+	auto pBatch = m_sendQueue.NextBatch();
+	if (!pBatch)
+	{
+		return;
+	}
+	std::vector<asio::const_buffer> bufVec;
+	bufVec.reserve(pBatch->size());
+	for (const auto& pMsg : *pBatch)
+	{
+		bufVec.push_back(asio::buffer(pMsg->GetData(), pMsg->GetSize()));
+	}
+	auto self = shared_from_this();
+	asio::async_write(
+		m_socket, bufVec,
+		[this, self, pBatch](std::error_code ec, std::size_t /*length*/) {
+			//日志级别关闭时不遍历整批消息
+			if (LOG_LEVEL_ON(ms_loger, ec ? spdlog::level::err : spdlog::level::info))
+			{
+				for (const auto& pMsg : *pBatch)
+				{
+					if (ec)
+					{
+						LOG_ERR(ms_loger, "[{}] TCP Send: {} Msg:{}{} [{} {}]", UserId(), GetConnectInfo(), MsgType(pMsg->GetType()), CLogSampler::Payload(*pMsg), __FILENAME__, __LINE__);
+					}
+					else if (!IsFileDataMsgType(pMsg->GetType()))
+					{
+						LOG_INFO(ms_loger, "[{}] TCP Send: {} Msg:{} {} [{} {}]", UserId(), GetConnectInfo(), MsgType(pMsg->GetType()), CLogSampler::Payload(*pMsg), __FILENAME__, __LINE__);
+					}
+				}
+			}
+			if (ec)
+			{
+				//未发送的消息随连接一起丢弃,重连以后重新登录
+				m_sendQueue.Clear();
+				OnSocketError();
+			}
+			else
+			{
+				DoSendMsg();
+			}
+		});
+}
+
 /**
  * @brief 发送心跳请求消息
  * 
@@ -239,7 +316,7 @@ bool CClientSess::SendMsg(std::shared_ptr<TransBaseMsg_t> pMsg)
 bool CClientSess::SendKeepAlive()
 {
 	KeepAliveReqMsg reqMsg(UserId());
-	auto pSendMsg = std::make_shared<TransBaseMsg_t>(reqMsg.GetMsgType(), reqMsg.ToString());
+	auto pSendMsg = std::make_shared<TransBaseMsg_t>(reqMsg, m_bBinaryCodec);
 	SendMsg(pSendMsg);
 	return true;
 }
@@ -253,7 +330,7 @@ void CClientSess::handleKeepAliveReq(const KeepAliveReqMsg &reqMsg)
 {
 	LOG_INFO(ms_loger, "KeepAliveReq: {}", reqMsg.ToString());
 	KeepAliveRspMsg rspMsg(m_strUserId);
-	auto pSendMsg = std::make_shared<TransBaseMsg_t>(rspMsg.GetMsgType(), rspMsg.ToString());
+	auto pSendMsg = std::make_shared<TransBaseMsg_t>(rspMsg, m_bBinaryCodec);
 	SendMsg(pSendMsg);
 }
 
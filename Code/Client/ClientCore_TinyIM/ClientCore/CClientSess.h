@@ -14,6 +14,8 @@
 #include "asio_common.h"
 #include "Log.h"
 #include "CommonMsg.h"
+#include "CSendQueue.h"
+#include "CLogSampler.h"
 namespace ClientCore
 {
 using asio::ip::tcp;
@@ -46,15 +48,26 @@ protected:
 	//Sess的连接状态
 	int m_bConnect=ST_NOT_CONNECT;
 	
-	enum { max_length = 16384, msg_max_len=8192 };
-	
-	//接收buf
-	char m_recvbuf[max_length];
+	//登录时协商的单条消息最大长度,接收缓冲区在下一次读取前扩大到该长度
+	int32_t m_nMaxFrameSize = MSG_DEFAULT_FRAME_SIZE;
+
+	//登录时协商的文件数据包长度
+	int32_t m_nChunkSize = FILE_DATA_CHUNK_SIZE;
+
+	//接收buf,长度为协商后的单条消息最大长度
+	std::vector<char> m_recvbuf;
 	
 	//接收位置
     uint32_t m_recvpos=0;
+
+	//发送队列,排队的消息合并为一批发送
+	CSendQueue m_sendQueue;
+
+	//发送到服务器的消息是否使用二进制编码,服务器确认支持以前使用json
+	bool m_bBinaryCodec = false;
 public:
 	static	std::shared_ptr<spdlog::logger> ms_loger;//会话日志
+	static  bool ms_bAllowBinary;//是否允许与服务器协商使用二进制编码
 public:
 	//检查是否为同一个连接
 	bool is_same_connect(const std::string& strIp,const int nport)
@@ -92,9 +105,24 @@ public:
 	std::string UserId() const {
 		return m_strUserId;
 	}
+
+	//设置登录时协商的消息长度和文件数据包长度
+	void SetFrameSize(const int32_t nMaxFrameSize, const int32_t nChunkSize) {
+		m_nMaxFrameSize = nMaxFrameSize;
+		m_nChunkSize = nChunkSize;
+	}
+
+	//通过TCP发送文件时使用的数据包长度
+	int32_t ChunkSize() const {
+		return m_nChunkSize;
+	}
+
+	//服务器在登录回复中确认支持二进制编码,或者已经用二进制编码回复
+	void EnableBinaryCodec();
 private:
 	std::string GetConnectInfo() const;
 	int do_read();
+	void DoSendMsg();
 	void handle_message(const TransBaseMsg_t& msg);
 
 	
@@ -69,6 +69,67 @@ void CMediumServer::loadConfig(const json11::Json &cfg, std::error_code& ec)
 		m_udpCfg.m_nPort = udpJson["port"].int_value();
 		LOG_INFO(ms_loger, "UDP CONNECT:{} [{} {}]", m_udpCfg.to_string(), __FILENAME__, __LINE__);
 	}
+
+	{
+		//与服务器之间的消息编码,服务器确认支持以后使用二进制编码,配置为false时始终使用json
+		if (cfg["binarycodec"].is_bool())
+		{
+			CClientSess::ms_bAllowBinary = cfg["binarycodec"].bool_value();
+		}
+		LOG_INFO(ms_loger, "BINARY CODEC:{} [{} {}]", CClientSess::ms_bAllowBinary, __FILENAME__, __LINE__);
+	}
+
+	{
+		//文件传输时同时在途的数据包个数
+		if (cfg["filewindow"].is_number() && cfg["filewindow"].int_value() > 0)
+		{
+			m_nFileWindowSize = cfg["filewindow"].int_value();
+		}
+		LOG_INFO(ms_loger, "FILE WINDOW:{} [{} {}]", m_nFileWindowSize, __FILENAME__, __LINE__);
+	}
+
+	{
+		//发送文件的Hash算法,"md5"或者"blake2b",接收时按对方Hash的长度判断算法
+		if (cfg["filehash"].is_string() && !CFileHash::ParseType(cfg["filehash"].string_value(), m_eFileHashType))
+		{
+			LOG_ERR(ms_loger, "Unknown File Hash:{} [{} {}]", cfg["filehash"].string_value(), __FILENAME__, __LINE__);
+		}
+		LOG_INFO(ms_loger, "FILE HASH:{} [{} {}]", CFileHash::TypeName(m_eFileHashType), __FILENAME__, __LINE__);
+	}
+
+	{
+		//登录时向服务器请求的单条消息最大长度和文件数据包长度,以服务器的回复为准
+		if (cfg["maxframesize"].is_number() && cfg["maxframesize"].int_value() > 0)
+		{
+			m_nMaxFrameSize = cfg["maxframesize"].int_value();
+		}
+		if (cfg["chunksize"].is_number() && cfg["chunksize"].int_value() > 0)
+		{
+			m_nChunkSize = cfg["chunksize"].int_value();
+		}
+		LOG_INFO(ms_loger, "MAX FRAME SIZE:{} CHUNK SIZE:{} [{} {}]", m_nMaxFrameSize, m_nChunkSize, __FILENAME__, __LINE__);
+	}
+
+	{
+		//登录时向服务器请求的每批群聊消息条数,0表示逐条接收
+		if (cfg["groupmsgbatch"].is_number() && cfg["groupmsgbatch"].int_value() >= 0)
+		{
+			m_nGroupMsgBatch = cfg["groupmsgbatch"].int_value();
+		}
+		LOG_INFO(ms_loger, "GROUP MSG BATCH:{} [{} {}]", m_nGroupMsgBatch, __FILENAME__, __LINE__);
+	}
+
+	{
+		//收发消息日志的内容采样
+		E_PAYLOAD_LOG mode = CLogSampler::Mode();
+		if (cfg["logpayload"].is_string() && !ParsePayloadLogMode(cfg["logpayload"].string_value(), mode))
+		{
+			LOG_WARN(ms_loger, "UNKNOWN PAYLOAD LOG MODE:{} [{} {}]", cfg["logpayload"].string_value(), __FILENAME__, __LINE__);
+		}
+		uint32_t nSampleRate = cfg["logsamplerate"].is_number() && cfg["logsamplerate"].int_value() > 0 ? static_cast<uint32_t>(cfg["logsamplerate"].int_value()) : 100;
+		CLogSampler::SetMode(mode, nSampleRate);
+		LOG_INFO(ms_loger, "PAYLOAD LOG MODE:{} SAMPLE RATE:{} [{} {}]", PayloadLogModeName(mode), CLogSampler::SampleRate(), __FILENAME__, __LINE__);
+	}
 }
 
 /**
@@ -154,7 +215,7 @@ void CMediumServer::Handle_UdpMsg(const asio::ip::udp::endpoint endPt, const Fil
 {
 	if (reqMsg.m_nDataIndex <= reqMsg.m_nDataTotalCount)
 	{
-		m_fileUtil.OnWriteData(reqMsg.m_nFileId + 1, reqMsg.m_szData, reqMsg.m_nDataLength);
+		int nCumAckIndex = OnRecvFileData(reqMsg.m_nFileId + 1, reqMsg.m_nDataTotalCount, reqMsg.m_nDataIndex, reqMsg.m_nChunkSize, reqMsg.m_dataVec);
 		FileDataSendRspMsg rspMsg;
 		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
 		rspMsg.m_nFileId = reqMsg.m_nFileId;
@@ -162,6 +223,7 @@ void CMediumServer::Handle_UdpMsg(const asio::ip::udp::endpoint endPt, const Fil
 		rspMsg.m_strFriendId = reqMsg.m_strFriendId;
 		rspMsg.m_nDataTotalCount = reqMsg.m_nDataTotalCount;
 		rspMsg.m_nDataIndex = reqMsg.m_nDataIndex;
+		rspMsg.m_nCumAckIndex = nCumAckIndex;
 		auto pSess = GetUdpSess(reqMsg.m_strUserId);
 		if (pSess)
 		{
@@ -201,8 +263,10 @@ void CMediumServer::Handle_UdpMsg(const asio::ip::udp::endpoint endPt, const Fil
  */
 void CMediumServer::HSB_FileDataSendRsp(const std::shared_ptr<CClientSess>& pClientSess,const FileDataSendRspMsg& rspMsg)
 {
-	auto pMsg = DoSendBackFileDataSendRsp(rspMsg);
-	pClientSess->SendMsg(pMsg);
+	if (pClientSess)
+	{
+		OnFileDataSendRsp(rspMsg);
+	}
 }
 std::vector<std::string> CMediumServer::GetLocalAllIp()
 {
@@ -223,116 +287,350 @@ std::vector<std::string> CMediumServer::GetLocalAllIp()
 	return result;
 }
 /**
- * @brief 实际处理文件数据发送的回复消息
+ * @brief UDP消息处理,处理从UDP收到的文件数据发送回复消息
  * 
- * @param rspMsg 文件数据发送的回复消息
- * @return TransBaseMsg_S_PTR 待发送的消息
+ * @param endPt UDP消息的来源地址
+ * @param rspMsg 文件数据发送回复消息
  */
-TransBaseMsg_S_PTR CMediumServer::DoSendBackFileDataSendRsp(const FileDataSendRspMsg& rspMsg)
+void CMediumServer::Handle_UdpMsg(const asio::ip::udp::endpoint /*endPt*/,const FileDataSendRspMsg& rspMsg)
 {
-	if (rspMsg.m_nDataIndex < rspMsg.m_nDataTotalCount)
+	OnFileDataSendRsp(rspMsg);
+}
+
+/**
+ * @brief 开始按滑动窗口发送文件,窗口内的数据包连续发出,不等待前一个数据包的确认
+ * 
+ * @param sendWindow 文件发送的状态
+ */
+void CMediumServer::StartFileDataSend(const FileSendWindow_st& sendWindow)
+{
+	int nFileId = sendWindow.m_reqMsg.m_nFileId;
+	m_fileSendWindowMap.erase(nFileId);
+	auto item = m_fileSendWindowMap.insert({ nFileId, sendWindow }).first;
+	//同一个文件的数据包使用相同的消息ID,以索引区分
+	item->second.m_reqMsg.m_strMsgId = m_httpServer->GenerateMsgId();
+	SendFileDataWindow(nFileId);
+	if (item->second.m_window.IsFinished())
 	{
-		FileDataSendReqMsg reqMsg;
-		if (m_fileUtil.OnReadData(rspMsg.m_nFileId, reqMsg.m_szData, reqMsg.m_nDataLength, 1024))
+		//空文件或者续传时接收端已经有全部数据,直接校验
+		FileDataSendRspMsg rspMsg;
+		rspMsg.m_nFileId = nFileId;
+		rspMsg.m_nDataTotalCount = item->second.m_window.TotalCount();
+		rspMsg.m_nCumAckIndex = rspMsg.m_nDataTotalCount;
+		OnFileDataSendRsp(rspMsg);
+	}
+}
+
+/**
+ * @brief 发送窗口内所有还没有发送的数据包
+ * 
+ * @param nFileId 文件ID
+ */
+void CMediumServer::SendFileDataWindow(const int nFileId)
+{
+	auto item = m_fileSendWindowMap.find(nFileId);
+	if (item != m_fileSendWindowMap.end())
+	{
+		int nIndex = 0;
+		while (item->second.m_window.NextSendIndex(nIndex))
 		{
-			LOG_INFO(ms_loger, "Read Data ", rspMsg.m_nFileId);
-			reqMsg.m_strMsgId = m_httpServer->GenerateMsgId();
-			reqMsg.m_nFileId = rspMsg.m_nFileId;
-			reqMsg.m_strUserId = rspMsg.m_strUserId;
-			reqMsg.m_strFriendId = rspMsg.m_strFriendId;
-			reqMsg.m_nDataTotalCount = rspMsg.m_nDataTotalCount;
-			reqMsg.m_nDataIndex = rspMsg.m_nDataIndex + 1;
+			if (!SendFileDataChunk(item->second, nIndex))
+			{
+				break;
+			}
 		}
-		auto pResult = std::make_shared<TransBaseMsg_t>(reqMsg.GetMsgType(), reqMsg.ToString());
-		return pResult;
 	}
-	else
+}
+
+/**
+ * @brief 按索引读取并发送一个数据包,首次发送和重传都使用此函数
+ * 
+ * @param sendWindow 文件发送的状态
+ * @param nIndex 数据包索引
+ * @return true 发送成功
+ * @return false 读取文件失败或对端不可达
+ */
+bool CMediumServer::SendFileDataChunk(FileSendWindow_st& sendWindow, const int nIndex)
+{
+	FileDataSendReqMsg& reqMsg = sendWindow.m_reqMsg;
+	reqMsg.m_nDataIndex = nIndex;
+	reqMsg.m_nDataLength = 0;
+	reqMsg.m_dataVec.resize(static_cast<std::size_t>(reqMsg.m_nChunkSize));
+	long nOffset = static_cast<long>(nIndex - 1) * reqMsg.m_nChunkSize;
+	if (!m_fileUtil.OnReadDataAt(reqMsg.m_nFileId, nOffset, reqMsg.m_dataVec.data(), reqMsg.m_nDataLength, reqMsg.m_nChunkSize))
+	{
+		LOG_ERR(ms_loger, "File:{} Read Index:{} Failed [{} {}]", reqMsg.m_nFileId, nIndex, __FILENAME__, __LINE__);
+		return false;
+	}
+	reqMsg.m_dataVec.resize(static_cast<std::size_t>(reqMsg.m_nDataLength));
+	if (sendWindow.m_strFileHash.empty())
 	{
-		FileVerifyReqMsg verifyReqMsg;
-		verifyReqMsg.m_strMsgId = m_httpServer->GenerateMsgId();
-		verifyReqMsg.m_nFileId = rspMsg.m_nFileId;
-		verifyReqMsg.m_strUserId = rspMsg.m_strUserId;
-		verifyReqMsg.m_strFriendId = rspMsg.m_strFriendId;
-		std::string strFileName = m_fileUtil.GetFileName(rspMsg.m_nFileId);
-		verifyReqMsg.m_strFileName = m_fileUtil.GetFileNameFromPath(strFileName);
-		m_fileUtil.GetFileSize(verifyReqMsg.m_nFileSize, strFileName);
-		verifyReqMsg.m_strFileHash = m_fileUtil.CalcHash(strFileName);
-		m_fileUtil.OnCloseFile(rspMsg.m_nFileId);
-		auto pResult = std::make_shared<TransBaseMsg_t>(verifyReqMsg.GetMsgType(), verifyReqMsg.ToString());
-		return pResult;
+		//首次发送按索引顺序,重传的数据包已经计算过
+		sendWindow.m_chunkHash.OnChunk(nIndex, reqMsg.m_dataVec.data(), reqMsg.m_dataVec.size());
 	}
+	return sendWindow.m_sendFunc(reqMsg);
 }
 
 /**
- * @brief UDP消息处理,处理从UDP收到的文件数据发送回复消息
+ * @brief 处理文件数据的确认,TCP和UDP(中转和P2P)的确认都在此处理,
+ * 滑动窗口并发送新的数据包,全部确认后发送文件校验请求
  * 
- * @param endPt UDP消息的来源地址
  * @param rspMsg 文件数据发送回复消息
  */
-void CMediumServer::Handle_UdpMsg(const asio::ip::udp::endpoint endPt,const FileDataSendRspMsg& rspMsg)
+void CMediumServer::OnFileDataSendRsp(const FileDataSendRspMsg& rspMsg)
 {
-	if (rspMsg.m_nDataIndex < rspMsg.m_nDataTotalCount)
+	auto item = m_fileSendWindowMap.find(rspMsg.m_nFileId);
+	if (item == m_fileSendWindowMap.end())
+	{
+		return;
+	}
+	auto& sendWindow = item->second;
+	if (!sendWindow.m_window.OnAck(rspMsg.m_nCumAckIndex, rspMsg.m_nDataIndex) && !sendWindow.m_window.IsFinished())
+	{
+		return;
+	}
+	//文件发送进度,进度变化时才通知界面
+	int nPercent = 0;
+	if (sendWindow.m_window.TotalCount() != 0)
+	{
+		nPercent = 100 * sendWindow.m_window.CumAckIndex() / sendWindow.m_window.TotalCount();
+	}
+	if (sendWindow.m_bNotifyProgress && nPercent != sendWindow.m_nNotifyPercent)
 	{
-		FileDataSendReqMsg reqMsg;
-		if (m_fileUtil.OnReadData(rspMsg.m_nFileId, reqMsg.m_szData, reqMsg.m_nDataLength, 1024))
+		sendWindow.m_nNotifyPercent = nPercent;
+		FileTransProgressNotifyReqMsg notifyMsg;
+		notifyMsg.m_strMsgId = m_httpServer->GenerateMsgId();
+		notifyMsg.m_strUserId = sendWindow.m_reqMsg.m_strUserId;
+		notifyMsg.m_strFileName = m_fileUtil.GetFileName(rspMsg.m_nFileId);
+		notifyMsg.m_strOtherId = sendWindow.m_reqMsg.m_strFriendId;
+		notifyMsg.m_eDirection = FILE_TRANS_DIRECTION::E_SEND_FILE;
+		notifyMsg.m_nTransPercent = nPercent;
+		auto pGuiSess = Get_GUI_Sess(notifyMsg.m_strUserId);
+		if (pGuiSess)
 		{
-			LOG_INFO(ms_loger, "Read Data ", rspMsg.m_nFileId);
-			reqMsg.m_strMsgId = m_httpServer->GenerateMsgId();
-			reqMsg.m_nFileId = rspMsg.m_nFileId;
-			reqMsg.m_strUserId = rspMsg.m_strUserId;
-			reqMsg.m_strFriendId = rspMsg.m_strFriendId;
-			reqMsg.m_nDataTotalCount = rspMsg.m_nDataTotalCount;
-			reqMsg.m_nDataIndex = rspMsg.m_nDataIndex + 1;
-			auto pUdpSess = GetUdpSess(reqMsg.m_strUserId);
-			if(pUdpSess)
+			pGuiSess->SendMsg(&notifyMsg);
+		}
+	}
+	if (!sendWindow.m_window.IsFinished())
+	{
+		SendFileDataWindow(rspMsg.m_nFileId);
+		return;
+	}
+
+	FileVerifyReqMsg verifyReqMsg;
+	verifyReqMsg.m_strMsgId = m_httpServer->GenerateMsgId();
+	verifyReqMsg.m_nFileId = rspMsg.m_nFileId;
+	verifyReqMsg.m_strUserId = sendWindow.m_reqMsg.m_strUserId;
+	verifyReqMsg.m_strFriendId = sendWindow.m_reqMsg.m_strFriendId;
+	std::string strFileName = m_fileUtil.GetFileName(rspMsg.m_nFileId);
+	verifyReqMsg.m_strFileName = m_fileUtil.GetFileNameFromPath(strFileName);
+	m_fileUtil.GetFileSize(verifyReqMsg.m_nFileSize, strFileName);
+	verifyReqMsg.m_strFileHash = sendWindow.m_strFileHash;
+	if (verifyReqMsg.m_strFileHash.empty() && !sendWindow.m_chunkHash.Finish(sendWindow.m_window.TotalCount(), verifyReqMsg.m_strFileHash))
+	{
+		verifyReqMsg.m_strFileHash = m_fileUtil.CalcHash(strFileName, sendWindow.m_chunkHash.Type());
+	}
+	m_fileUtil.OnCloseFile(rspMsg.m_nFileId);
+	m_fileSendWindowMap.erase(item);
+	auto pSess = GetClientSess(verifyReqMsg.m_strUserId);
+	if (pSess != nullptr)
+	{
+		pSess->SendMsg(&verifyReqMsg);
+	}
+}
+
+/**
+ * @brief 重传超时的文件数据包,长时间没有确认的文件放弃发送,在定时器中调用
+ * 
+ */
+void CMediumServer::CheckFileDataTimeout()
+{
+	auto item = m_fileSendWindowMap.begin();
+	while (item != m_fileSendWindowMap.end())
+	{
+		auto indexVec = item->second.m_window.TimeoutIndexes(std::chrono::milliseconds(CFileSendWindow::RETRANS_TIMEOUT_MS));
+		if (item->second.m_window.TimeoutRounds() > CFileSendWindow::MAX_TIMEOUT_ROUNDS)
+		{
+			LOG_WARN(ms_loger, "User:{} File:{} Send Timeout At:{} [{} {}]", item->second.m_reqMsg.m_strUserId, item->first, item->second.m_window.CumAckIndex(), __FILENAME__, __LINE__);
+			m_fileUtil.OnCloseFile(item->first);
+			item = m_fileSendWindowMap.erase(item);
+			continue;
+		}
+		for (const auto nIndex : indexVec)
+		{
+			SendFileDataChunk(item->second, nIndex);
+		}
+		item++;
+	}
+}
+
+/**
+ * @brief 记录收到的文件数据包并按索引写入文件,重传的数据包只确认不重复写入
+ * 
+ * @param nWriteFileId 写入的文件ID
+ * @param nDataTotalCount 文件总数据包数
+ * @param nDataIndex 数据包索引
+ * @param nChunkSize 发送方的分包大小
+ * @param dataVec 文件数据
+ * @return int 累计确认的索引
+ */
+int CMediumServer::OnRecvFileData(const int nWriteFileId, const int nDataTotalCount, const int nDataIndex, const int nChunkSize, const std::vector<char>& dataVec)
+{
+	auto item = m_fileRecvWindowMap.find(nWriteFileId);
+	if (item == m_fileRecvWindowMap.end())
+	{
+		item = m_fileRecvWindowMap.insert({ nWriteFileId, CFileRecvWindow(nDataTotalCount) }).first;
+	}
+	if (item->second.OnRecv(nDataIndex))
+	{
+		long nOffset = static_cast<long>(nDataIndex - 1) * nChunkSize;
+		if (m_fileUtil.OnWriteDataAt(nWriteFileId, nOffset, dataVec.data(), static_cast<int>(dataVec.size())))
+		{
+			//写入失败的数据包不计算,校验时读取文件
+			auto resumeItem = m_fileResumeMap.find(nWriteFileId);
+			auto hashItem = m_fileRecvHashMap.find(nWriteFileId);
+			if (hashItem == m_fileRecvHashMap.end() && resumeItem == m_fileResumeMap.end())
 			{
-				pUdpSess->send_msg(endPt, &reqMsg);
+				hashItem = m_fileRecvHashMap.insert({ nWriteFileId, CChunkHash(m_eFileHashType) }).first;
 			}
-			else
+			if (hashItem != m_fileRecvHashMap.end())
 			{
-				LOG_ERR(ms_loger, "UDP Sess Failed:{}", reqMsg.m_strUserId);
+				hashItem->second.OnChunk(nDataIndex, dataVec.data(), dataVec.size());
 			}
-		}
-		//Send File Process
-		{
-			//File Process
+			//数据先刷新到磁盘再保存续传状态,状态中记录的数据包一定已经写入
+			if (resumeItem != m_fileResumeMap.end() && nChunkSize == resumeItem->second.m_state.ChunkSize() &&
+				resumeItem->second.m_state.OnRecv(nDataIndex))
 			{
-				FileTransProgressNotifyReqMsg notifyMsg;
-				notifyMsg.m_strMsgId = m_httpServer->GenerateMsgId();
-				notifyMsg.m_strUserId = reqMsg.m_strUserId;
-				notifyMsg.m_strFileName = m_fileUtil.GetFileName(reqMsg.m_nFileId);
-				notifyMsg.m_strOtherId = reqMsg.m_strFriendId;
-				notifyMsg.m_eDirection = FILE_TRANS_DIRECTION::E_SEND_FILE;
-				if (reqMsg.m_nDataTotalCount != 0)
-				{
-					notifyMsg.m_nTransPercent = 100 * reqMsg.m_nDataIndex / reqMsg.m_nDataTotalCount;
-				}
-				auto pGuiSess = Get_GUI_Sess(notifyMsg.m_strUserId);
-				if (pGuiSess)
-				{
-					pGuiSess->SendMsg(&notifyMsg);
-				}
+				m_fileUtil.FlushFile(nWriteFileId);
+				resumeItem->second.m_state.Save(resumeItem->second.m_strStatePath);
 			}
 		}
+		if (item->second.IsFinished())
+		{
+			LOG_INFO(ms_loger, "Recv File Finished:{} Count:{} [{} {}]", nWriteFileId, nDataTotalCount, __FILENAME__, __LINE__);
+			m_fileUtil.OnCloseFile(nWriteFileId);
+		}
 	}
-	else
+	return item->second.CumAckIndex();
+}
+
+/**
+ * @brief 结束文件接收,取得接收时计算的Hash
+ * 
+ * 所有数据包都已按顺序计算并且算法与发送端相同时直接使用结果,否则读取文件计算。
+ * @param nWriteFileId 写入的文件ID
+ * @param strFileName 接收的文件
+ * @param strPeerHash 发送端的Hash,用于确定算法
+ * @return std::string 接收到的文件的Hash
+ */
+std::string CMediumServer::FinishRecvHash(const int nWriteFileId, const std::string& strFileName, const std::string& strPeerHash)
+{
+	FILE_HASH_TYPE eHashType = FILE_HASH_TYPE::HASH_MD5;
+	CFileHash::TypeOfHash(strPeerHash, eHashType);
+	std::string strFileHash;
+	auto windowItem = m_fileRecvWindowMap.find(nWriteFileId);
+	auto hashItem = m_fileRecvHashMap.find(nWriteFileId);
+	if (windowItem == m_fileRecvWindowMap.end() || hashItem == m_fileRecvHashMap.end() ||
+		hashItem->second.Type() != eHashType || !hashItem->second.Finish(windowItem->second.TotalCount(), strFileHash))
 	{
-		FileVerifyReqMsg verifyReqMsg;
-		verifyReqMsg.m_strMsgId = m_httpServer->GenerateMsgId();
-		verifyReqMsg.m_nFileId = rspMsg.m_nFileId;
-		verifyReqMsg.m_strUserId = rspMsg.m_strUserId;
-		verifyReqMsg.m_strFriendId = rspMsg.m_strFriendId;
-		std::string strFileName = m_fileUtil.GetFileName(rspMsg.m_nFileId);
-		verifyReqMsg.m_strFileName = m_fileUtil.GetFileNameFromPath(strFileName);
-		m_fileUtil.GetFileSize(verifyReqMsg.m_nFileSize, strFileName);
-		verifyReqMsg.m_strFileHash = m_fileUtil.CalcHash(strFileName);
-		auto pSess = GetClientSess(verifyReqMsg.m_strUserId);
-		if (pSess != nullptr)
+		strFileHash = m_fileUtil.CalcHash(strFileName, eHashType);
+	}
+	if (windowItem != m_fileRecvWindowMap.end())
+	{
+		m_fileRecvWindowMap.erase(windowItem);
+	}
+	if (hashItem != m_fileRecvHashMap.end())
+	{
+		m_fileRecvHashMap.erase(hashItem);
+	}
+	return strFileHash;
+}
+
+/**
+ * @brief 开始可以续传的文件接收,上次中断时保存的状态与文件匹配时只接收缺少的数据包
+ * 
+ * @param nWriteFileId 写入的文件ID
+ * @param req 文件发送数据开始请求
+ * @param strFileName 接收的文件
+ * @param rspMsg 续传时填入缺少的数据包范围
+ * @return true 已经打开文件
+ * @return false 发送端不支持续传或者文件无法续传,按原来的方式接收
+ */
+bool CMediumServer::StartRecvResume(const int nWriteFileId, const FileSendDataBeginReq& req, const std::string& strFileName, FileSendDataBeginRsp& rspMsg)
+{
+	const std::string strStateName = CFileResumeState::StateFileName(req.m_strFileHash);
+	//旧版本的服务器没有文件长度和数据包长度
+	if (req.m_nFileSize <= 0 || req.m_nChunkSize <= 0 || strStateName.empty())
+	{
+		return false;
+	}
+	//之前的连接中断时没有结束的接收
+	for (auto item = m_fileResumeMap.begin(); item != m_fileResumeMap.end(); item++)
+	{
+		if (item->second.m_state.FileHash() == req.m_strFileHash)
 		{
-			auto pSend = std::make_shared<TransBaseMsg_t>(verifyReqMsg.GetMsgType(), verifyReqMsg.ToString());
-			pSess->SendMsg(pSend);
+			m_fileUtil.OnCloseFile(item->first);
+			item->second.m_state.Save(item->second.m_strStatePath);
+			m_fileRecvWindowMap.erase(item->first);
+			m_fileRecvHashMap.erase(item->first);
+			m_fileResumeMap.erase(item);
+			break;
 		}
-		m_fileUtil.OnCloseFile(rspMsg.m_nFileId);
+	}
+	FileRecvResume_st resume;
+	resume.m_strStatePath = GetUserImageDir(req.m_strUserId) + strStateName;
+	CFileResumeState& state = resume.m_state;
+	bool bResume = state.Load(resume.m_strStatePath) && state.IsMatch(req.m_strFileHash, req.m_nFileSize) &&
+		state.FileName() == strFileName && m_fileUtil.IsFileExist(strFileName);
+	if (!bResume)
+	{
+		//同名的文件不能覆盖
+		if (m_fileUtil.IsFileExist(strFileName))
+		{
+			return false;
+		}
+		state = CFileResumeState(req.m_strFileHash, strFileName, req.m_nFileSize, req.m_nChunkSize);
+	}
+	state.Rebase(req.m_nChunkSize);
+	if (!m_fileUtil.OpenResumeFile(nWriteFileId, strFileName))
+	{
+		return false;
+	}
+	CFileRecvWindow recvWindow(state.TotalCount());
+	for (int nIndex = 1; nIndex <= state.TotalCount(); nIndex++)
+	{
+		if (state.IsRecv(nIndex))
+		{
+			recvWindow.OnRecv(nIndex);
+		}
+	}
+	m_fileRecvWindowMap.erase(nWriteFileId);
+	m_fileRecvWindowMap.insert({ nWriteFileId, recvWindow });
+	state.Save(resume.m_strStatePath);
+	if (state.RecvCount() > 0)
+	{
+		rspMsg.m_bResume = true;
+		rspMsg.m_nChunkSize = req.m_nChunkSize;
+		rspMsg.m_missingRangeVec = state.MissingRanges();
+		LOG_INFO(ms_loger, "{} File:{} Resume Recv:{}/{} [{} {}]", req.m_strUserId, strFileName, state.RecvCount(), state.TotalCount(), __FILENAME__, __LINE__);
+	}
+	m_fileResumeMap.erase(nWriteFileId);
+	m_fileResumeMap.insert({ nWriteFileId, resume });
+	return true;
+}
+
+/**
+ * @brief 文件接收结束,删除续传状态
+ * 
+ * @param nWriteFileId 写入的文件ID
+ */
+void CMediumServer::FinishRecvResume(const int nWriteFileId)
+{
+	auto item = m_fileResumeMap.find(nWriteFileId);
+	if (item != m_fileResumeMap.end())
+	{
+		m_fileUtil.RemoveFile(item->second.m_strStatePath);
+		m_fileResumeMap.erase(item);
 	}
 }
 
@@ -358,7 +656,7 @@ void CMediumServer::DispatchUdpMsg(const asio::ip::udp::endpoint endPt, TransBas
 		case E_MsgType::FileSendDataReq_Type:
 		{
 			FileDataSendReqMsg reqMsg;
-			if (reqMsg.FromString(pMsg->to_string())) {
+			if (pMsg->DecodeMsg(reqMsg)) {
 				Handle_UdpMsg(endPt, reqMsg);
 			}
 		}break;
@@ -373,7 +671,7 @@ void CMediumServer::DispatchUdpMsg(const asio::ip::udp::endpoint endPt, TransBas
 		case E_MsgType::FileRecvDataReq_Type:
 		{
 			FileDataRecvReqMsg reqMsg;
-			if (reqMsg.FromString(pMsg->to_string())) {
+			if (pMsg->DecodeMsg(reqMsg)) {
 				Handle_UdpMsg(endPt, reqMsg);
 			}
 		}break;
@@ -677,7 +975,7 @@ bool CMediumServer::HandleHttpMsg(const BaseMsg* pMsg)
 		auto pSess = GetClientSess(msg->m_strUserId);
 		if (pSess)
 		{
-			std::string strHash = m_fileUtil.CalcHash(msg->m_strFileName);
+			std::string strHash = m_fileUtil.CalcHash(msg->m_strFileName, m_eFileHashType);
 			m_hashTypeMap.insert({ strHash,FILE_TYPE::FILE_TYPE_FILE });
 			pSess->SendMsg(pMsg);
 		}
@@ -969,8 +1267,10 @@ void CMediumServer::OnTimer()
 	}
 	m_timeCount++;
 	CheckAllConnect();
+	CheckFileDataTimeout();
 	if (m_timeCount % 60 == 0)
 	{
+		ReportDispatchStat();
 		if (!m_userId_ClientSessMap.empty())
 		{
 			m_nNoSessTimeCount = 0;
@@ -1062,8 +1362,13 @@ std::string CMediumServer::getServerIpPort()
  */
 void CMediumServer::SendBack(const std::shared_ptr<CClientSess>& pClientSess, const TransBaseMsg_t& msg)
 {
+	//文件数据帧保持二进制,在本地直接解码写入文件,不转发给界面
+	if (IsFileDataMsgType(msg.GetType()))
+	{
+		HandleSendBack(pClientSess, msg);
+		return;
+	}
 
-	auto pMsg = std::make_shared<TransBaseMsg_t>(msg.GetType(), msg.to_string());
 	//auto item = m_BackSessMap.find(pClientSess);
 	auto pGuiSess = Get_GUI_Sess(pClientSess->UserId());
 	if (!pGuiSess)
@@ -1072,18 +1377,19 @@ void CMediumServer::SendBack(const std::shared_ptr<CClientSess>& pClientSess, co
 	}
 	if (pGuiSess)
 	{
+		//本地已经处理的消息不再转发,只有转发给界面时才拷贝消息
 		if (HandleSendBack(pClientSess, msg))
 		{
 		}
 		else
 		{
-			pGuiSess->SendMsg(pMsg);
+			pGuiSess->SendMsg(std::make_shared<TransBaseMsg_t>(msg));
 		}
 	}
 	else
 	{
 		//HandleSendBack(pClientSess, msg);
-		OnHttpRsp(pClientSess,pMsg);
+		OnHttpRsp(pClientSess, std::make_shared<TransBaseMsg_t>(msg));
 	}
 }
 
@@ -1097,7 +1403,8 @@ void CMediumServer::HandleFileVerifyReq(const FileVerifyReqMsg& msg)
 	FileVerifyRspMsg rspMsg;
 	m_fileUtil.OnCloseFile(msg.m_nFileId + 1);
 	std::string strFileName = GetUserImageDir(msg.m_strUserId) + msg.m_strFileName;
-	std::string strRecvHash = m_fileUtil.CalcHash(strFileName);
+	std::string strRecvHash = FinishRecvHash(msg.m_nFileId + 1, strFileName, msg.m_strFileHash);
+	FinishRecvResume(msg.m_nFileId + 1);
 	//
 	if (msg.m_strFileHash == strRecvHash)
 	{
@@ -1257,26 +1564,33 @@ void CMediumServer::HandleFriendNotifyFileMsgReq(const FriendNotifyFileMsgReqMsg
 			int nFileSize = 0;
 			m_fileUtil.GetFileSize(nFileSize, notifyMsg.m_strFileName);
 			auto pSess = GetUdpSess(notifyMsg.m_strUserId);
-			if (pSess)
-			{
-				FileDataSendReqMsg reqMsg;
-				reqMsg.m_nDataTotalCount = nFileSize / 1024 + (nFileSize % 1024 == 0 ? 0 : 1);
-				int nIndex = 1;
-				//while (nIndex <= reqMsg.m_nDataTotalCount)
-				//{
-				reqMsg.m_nDataIndex = nIndex;
-				reqMsg.m_nFileId = notifyMsg.m_nFileId;
-				reqMsg.m_strFriendId = notifyMsg.m_strFriendId;
-				reqMsg.m_strUserId = notifyMsg.m_strUserId;
-				m_fileUtil.OnReadData(reqMsg.m_nFileId, reqMsg.m_szData, reqMsg.m_nDataLength, 1024);
-				pSess->sendToServer(&reqMsg);
-				//	nIndex++;
-				//}
-				//pSess->DoSend();
+			if (bResult && pSess)
+			{
+				FileSendWindow_st sendWindow;
+				int nTotalCount = FileDataChunkCount(nFileSize, FILE_DATA_UDP_CHUNK_SIZE);
+				sendWindow.m_window = CFileSendWindow(nTotalCount, m_nFileWindowSize);
+				sendWindow.m_chunkHash = CChunkHash(m_eFileHashType);
+				sendWindow.m_reqMsg.m_nDataTotalCount = nTotalCount;
+				sendWindow.m_reqMsg.m_nChunkSize = FILE_DATA_UDP_CHUNK_SIZE;
+				sendWindow.m_reqMsg.m_nFileId = notifyMsg.m_nFileId;
+				sendWindow.m_reqMsg.m_strFriendId = notifyMsg.m_strFriendId;
+				sendWindow.m_reqMsg.m_strUserId = notifyMsg.m_strUserId;
+				sendWindow.m_bNotifyProgress = true;
+				std::weak_ptr<CUdpClient> weakSess = pSess;
+				sendWindow.m_sendFunc = [weakSess](const FileDataSendReqMsg& reqMsg) {
+					auto pUdpSess = weakSess.lock();
+					if (pUdpSess)
+					{
+						pUdpSess->sendToServer(&reqMsg);
+						return true;
+					}
+					return false;
+				};
+				StartFileDataSend(sendWindow);
 			}
 			else
 			{
-				LOG_ERR(ms_loger, "{} No Udp Sess", notifyMsg.m_strUserId);
+				LOG_ERR(ms_loger, "{} No Udp Sess Or Open File Failed:{} [{} {}]", notifyMsg.m_strUserId, notifyMsg.m_strFileName, __FILENAME__, __LINE__);
 			}
 		}
 		//拒绝
@@ -1294,37 +1608,56 @@ void CMediumServer::HandleFriendNotifyFileMsgReq(const FriendNotifyFileMsgReqMsg
 			int nFileSize = 0;
 			m_fileUtil.GetFileSize(nFileSize, strFileName);
 			if (m_fileUtil.OpenReadFile(notifyMsg.m_nFileId, strFileName)) {
-				FileDataSendReqMsg sendReqMsg;
-				sendReqMsg.m_strMsgId = m_httpServer->GenerateMsgId();
-				sendReqMsg.m_strUserId = notifyMsg.m_strUserId;
-				sendReqMsg.m_strFriendId = notifyMsg.m_strFriendId;
-				sendReqMsg.m_nFileId = notifyMsg.m_nFileId;
-
-				sendReqMsg.m_nDataTotalCount = nFileSize / 1024 + (nFileSize % 1024 == 0 ? 0 : 1);
-				sendReqMsg.m_nDataIndex = 1;
-				sendReqMsg.m_nDataLength = 0;
-				m_fileUtil.OnReadData(sendReqMsg.m_nFileId, sendReqMsg.m_szData, sendReqMsg.m_nDataLength, 1024);
-
+				FileSendWindow_st sendWindow;
+				int nTotalCount = FileDataChunkCount(nFileSize, FILE_DATA_UDP_CHUNK_SIZE);
+				sendWindow.m_window = CFileSendWindow(nTotalCount, m_nFileWindowSize);
+				sendWindow.m_chunkHash = CChunkHash(m_eFileHashType);
+				sendWindow.m_reqMsg.m_nChunkSize = FILE_DATA_UDP_CHUNK_SIZE;
+				sendWindow.m_reqMsg.m_strUserId = notifyMsg.m_strUserId;
+				sendWindow.m_reqMsg.m_strFriendId = notifyMsg.m_strFriendId;
+				sendWindow.m_reqMsg.m_nFileId = notifyMsg.m_nFileId;
+				sendWindow.m_reqMsg.m_nDataTotalCount = nTotalCount;
+				sendWindow.m_bNotifyProgress = true;
+
+				auto pUdpSess = GetUdpSess(notifyMsg.m_strUserId);
+				if (pUdpSess)
 				{
-					auto pUdpSess = GetUdpSess(sendReqMsg.m_strUserId);
-					//if(notifyMsg.m_trans)
-					if (pUdpSess)
+					std::weak_ptr<CUdpClient> weakSess = pUdpSess;
+					auto udpItem = m_userIdUdpAddrMap.find(notifyMsg.m_strUserId);
+					if (notifyMsg.m_transMode == FILE_TRANS_TYPE::UDP_ONLINE_P2P_MODE && udpItem != m_userIdUdpAddrMap.end())
 					{
-						auto udpItem = m_userIdUdpAddrMap.find(sendReqMsg.m_strUserId);
-						if (notifyMsg.m_transMode == FILE_TRANS_TYPE::UDP_ONLINE_P2P_MODE &&  udpItem != m_userIdUdpAddrMap.end())
-						{
-							pUdpSess->send_msg(udpItem->second.m_strServerIp, udpItem->second.m_nPort, &sendReqMsg);
-							pUdpSess->DoSend();
-						}
-						else
-						{
-							pUdpSess->sendToServer(&sendReqMsg);
-						}
+						//P2P直接发给对端
+						std::string strIp = udpItem->second.m_strServerIp;
+						int nPort = udpItem->second.m_nPort;
+						sendWindow.m_sendFunc = [weakSess, strIp, nPort](const FileDataSendReqMsg& reqMsg) {
+							auto pSess = weakSess.lock();
+							if (pSess)
+							{
+								pSess->send_msg(strIp, nPort, &reqMsg);
+								return true;
+							}
+							return false;
+						};
 					}
 					else
 					{
-						LOG_ERR(ms_loger, "UDP Sess Failed:{}", sendReqMsg.m_strFriendId);
+						//经过服务器中转
+						sendWindow.m_sendFunc = [weakSess](const FileDataSendReqMsg& reqMsg) {
+							auto pSess = weakSess.lock();
+							if (pSess)
+							{
+								pSess->sendToServer(&reqMsg);
+								return true;
+							}
+							return false;
+						};
 					}
+					StartFileDataSend(sendWindow);
+				}
+				else
+				{
+					LOG_ERR(ms_loger, "UDP Sess Failed:{}", notifyMsg.m_strFriendId);
+					m_fileUtil.OnCloseFile(notifyMsg.m_nFileId);
 				}
 			}
 		}
@@ -1342,8 +1675,7 @@ void CMediumServer::Handle_TcpMsg(const std::shared_ptr<CClientSess>& pClientSes
 {
 	if (reqMsg.m_nDataIndex <= reqMsg.m_nDataTotalCount)
 	{
-		m_fileUtil.OnWriteData(reqMsg.m_nFileId + 1, reqMsg.m_szData, reqMsg.m_nDataLength);
-		LOG_INFO(ms_loger, "WriteData {} [{} {}]", reqMsg.m_nFileId,__FILENAME__,__LINE__);
+		int nCumAckIndex = OnRecvFileData(reqMsg.m_nFileId + 1, reqMsg.m_nDataTotalCount, reqMsg.m_nDataIndex, reqMsg.m_nChunkSize, reqMsg.m_dataVec);
 		FileDataRecvRspMsg rspMsg;
 		{
 			rspMsg.m_strMsgId = reqMsg.m_strMsgId;
@@ -1352,14 +1684,10 @@ void CMediumServer::Handle_TcpMsg(const std::shared_ptr<CClientSess>& pClientSes
 			rspMsg.m_strFriendId = reqMsg.m_strFriendId;
 			rspMsg.m_nDataTotalCount = reqMsg.m_nDataTotalCount;
 			rspMsg.m_nDataIndex = reqMsg.m_nDataIndex;
+			rspMsg.m_nCumAckIndex = nCumAckIndex;
 		}
 		pClientSess->SendMsg(&rspMsg);
 	}
-
-	if (reqMsg.m_nDataIndex == reqMsg.m_nDataTotalCount)
-	{
-		m_fileUtil.OnCloseFile(reqMsg.m_nFileId + 1);
-	}
 }
 /**
  * @brief 处理从UDP收到文件数据的接收请求消息
@@ -1369,10 +1697,18 @@ void CMediumServer::Handle_TcpMsg(const std::shared_ptr<CClientSess>& pClientSes
  */
 void CMediumServer::Handle_UdpMsg(const asio::ip::udp::endpoint endPt, const FileDataRecvReqMsg& reqMsg)
 {
+	int nOldCumAckIndex = 0;
+	int nCumAckIndex = 0;
+	{
+		auto recvItem = m_fileRecvWindowMap.find(reqMsg.m_nFileId + 1);
+		if (recvItem != m_fileRecvWindowMap.end())
+		{
+			nOldCumAckIndex = recvItem->second.CumAckIndex();
+		}
+	}
 	if (reqMsg.m_nDataIndex <= reqMsg.m_nDataTotalCount)
 	{
-		m_fileUtil.OnWriteData(reqMsg.m_nFileId + 1, reqMsg.m_szData, reqMsg.m_nDataLength);
-		LOG_INFO(ms_loger, "WriteData:File ID {} [{} {}]", reqMsg.m_nFileId, __FILENAME__,__LINE__);
+		nCumAckIndex = OnRecvFileData(reqMsg.m_nFileId + 1, reqMsg.m_nDataTotalCount, reqMsg.m_nDataIndex, reqMsg.m_nChunkSize, reqMsg.m_dataVec);
 		FileDataRecvRspMsg rspMsg;
 		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
 		rspMsg.m_nFileId = reqMsg.m_nFileId;
@@ -1380,6 +1716,7 @@ void CMediumServer::Handle_UdpMsg(const asio::ip::udp::endpoint endPt, const Fil
 		rspMsg.m_strFriendId = reqMsg.m_strFriendId;
 		rspMsg.m_nDataTotalCount = reqMsg.m_nDataTotalCount;
 		rspMsg.m_nDataIndex = reqMsg.m_nDataIndex;
+		rspMsg.m_nCumAckIndex = nCumAckIndex;
 		auto pUdpSess = GetUdpSess(reqMsg.m_strUserId);
 		if (pUdpSess)
 		{
@@ -1391,11 +1728,8 @@ void CMediumServer::Handle_UdpMsg(const asio::ip::udp::endpoint endPt, const Fil
 			//LOG_ERR(ms_loger, "UDP Sess Failed:{}", reqMsg.m_strFromId);
 		}
 	}
-	
-	if(reqMsg.m_nDataIndex == reqMsg.m_nDataTotalCount)
-	{
-		m_fileUtil.OnCloseFile(reqMsg.m_nFileId + 1);
-	}
+	//接收进度变化时才通知界面
+	if (reqMsg.m_nDataTotalCount != 0 && 100 * nCumAckIndex / reqMsg.m_nDataTotalCount != 100 * nOldCumAckIndex / reqMsg.m_nDataTotalCount)
 	{
 		{
 			FileTransProgressNotifyReqMsg notifyMsg;
@@ -1404,10 +1738,7 @@ void CMediumServer::Handle_UdpMsg(const asio::ip::udp::endpoint endPt, const Fil
 			notifyMsg.m_strFileName = m_fileUtil.GetFileName(reqMsg.m_nFileId);
 			notifyMsg.m_strOtherId = reqMsg.m_strFriendId;
 			notifyMsg.m_eDirection = FILE_TRANS_DIRECTION::E_RECV_FILE;
-			if (reqMsg.m_nDataTotalCount != 0)
-			{
-				notifyMsg.m_nTransPercent = 100 * reqMsg.m_nDataIndex / reqMsg.m_nDataTotalCount;
-			}
+			notifyMsg.m_nTransPercent = 100 * nCumAckIndex / reqMsg.m_nDataTotalCount;
 			auto pGuiSess = Get_GUI_Sess(notifyMsg.m_strUserId);
 			if (pGuiSess)
 			{
@@ -1822,7 +2153,7 @@ void CMediumServer::HSF_GetGroupChatHistoryReq(const std::shared_ptr<CServerSess
  */
 void CMediumServer::HSF_FileSendDataBeginReq(const std::shared_ptr<CServerSess>& pServerSess,FileSendDataBeginReq& reqMsg)
 {
-	reqMsg.m_strFileHash = m_fileUtil.CalcHash(reqMsg.m_strFileName);
+	reqMsg.m_strFileHash = m_fileUtil.CalcHash(reqMsg.m_strFileName, m_eFileHashType);
 	{
 		
 	}
@@ -1836,6 +2167,8 @@ void CMediumServer::HSF_FileSendDataBeginReq(const std::shared_ptr<CServerSess>&
 	{
 		LOG_ERR(ms_loger, "UserId {} No Msg Util [{} {}] ", reqMsg.m_strUserId, __FILENAME__, __LINE__);
 	}
+	//接收端根据文件长度和数据包长度判断能否续传
+	m_fileUtil.GetFileSize(reqMsg.m_nFileSize, reqMsg.m_strFileName);
 	if (!strFileName.empty())
 	{
 		reqMsg.m_strFileName = strFileName;
@@ -1859,6 +2192,7 @@ void CMediumServer::HSF_FileSendDataBeginReq(const std::shared_ptr<CServerSess>&
 		auto pClientSess = GetClientSess(reqMsg.m_strUserId);
 		if (pClientSess)
 		{
+			reqMsg.m_nChunkSize = pClientSess->ChunkSize();
 			auto pMsg = std::make_shared<TransBaseMsg_t>(reqMsg.GetMsgType(), reqMsg.ToString());
 			pClientSess->SendMsg(pMsg);
 		}
@@ -1874,7 +2208,7 @@ void CMediumServer::HSF_FileSendDataBeginReq(const std::shared_ptr<CServerSess>&
 std::string CMediumServer::GetSendFileNewName(const std::string strUserId, const std::string strOrgFileName)
 {
 	{
-		std::string strFileHash = m_fileUtil.CalcHash(strOrgFileName);
+		std::string strFileHash = m_fileUtil.CalcHash(strOrgFileName, m_eFileHashType);
 		auto pUtil = GetMsgPersisUtil(strUserId);
 		if (pUtil)
 		{
@@ -1924,14 +2258,17 @@ bool CMediumServer::DoSF_FriendChatSendTxtReq(FriendChatSendTxtReqMsg& reqMsg)
 				beginReqMsg.m_strMsgId = m_httpServer->GenerateMsgId();
 				beginReqMsg.m_strUserId = reqMsg.m_strSenderId;
 				beginReqMsg.m_strFriendId = reqMsg.m_strReceiverId;
-				beginReqMsg.m_strFileHash = m_fileUtil.CalcHash(item.m_strImageName);
+				beginReqMsg.m_strFileHash = m_fileUtil.CalcHash(item.m_strImageName, m_eFileHashType);
 				strFileHash = beginReqMsg.m_strFileHash;
+				m_fileUtil.GetFileSize(beginReqMsg.m_nFileSize, item.m_strImageName);
 
 				beginReqMsg.m_strFileName = GetSendFileNewName(reqMsg.m_strSenderId, item.m_strImageName);
 
 				auto item = m_userId_ClientSessMap.find(reqMsg.m_strSenderId);
 				if (item != m_userId_ClientSessMap.end())
 				{
+					beginReqMsg.m_nChunkSize = item->second->ChunkSize();
+					beginReqMsg.m_bProofSupport = true;
 					auto pMsg = std::make_shared<TransBaseMsg_t>(beginReqMsg.GetMsgType(), beginReqMsg.ToString());
 					item->second->SendMsg(pMsg);
 				}
@@ -2000,12 +2337,15 @@ void CMediumServer::HSF_SendGroupTextMsgReqMsg(const std::shared_ptr<CServerSess
 				beginReqMsg.m_strMsgId = m_httpServer->GenerateMsgId();
 				beginReqMsg.m_strUserId = reqMsg.m_chatMsg.m_strSenderId;
 				beginReqMsg.m_strFriendId = reqMsg.m_chatMsg.m_strGroupId;
-				beginReqMsg.m_strFileHash = m_fileUtil.CalcHash(item.m_strImageName);
+				beginReqMsg.m_strFileHash = m_fileUtil.CalcHash(item.m_strImageName, m_eFileHashType);
 				strFileHash = beginReqMsg.m_strFileHash;
+				m_fileUtil.GetFileSize(beginReqMsg.m_nFileSize, item.m_strImageName);
 				beginReqMsg.m_strFileName = GetSendFileNewName(pServerSess->UserId(), item.m_strImageName);
 				auto item = m_userId_ClientSessMap.find(reqMsg.m_chatMsg.m_strSenderId);
 				if (item != m_userId_ClientSessMap.end())
 				{
+					beginReqMsg.m_nChunkSize = item->second->ChunkSize();
+					beginReqMsg.m_bProofSupport = true;
 					auto pMsg = std::make_shared<TransBaseMsg_t>(beginReqMsg.GetMsgType(), beginReqMsg.ToString());
 					item->second->SendMsg(pMsg);
 				}
@@ -2041,6 +2381,10 @@ void CMediumServer::HSF_SendGroupTextMsgReqMsg(const std::shared_ptr<CServerSess
 
 void CMediumServer::HSF_UserLoginReq(const std::shared_ptr<CServerSess>& pServerSess, UserLoginReqMsg& reqMsg)
 {
+	//和服务器协商消息长度,重连时保存的登录消息同样携带
+	reqMsg.m_nMaxFrameSize = m_nMaxFrameSize;
+	reqMsg.m_nChunkSize = m_nChunkSize;
+	reqMsg.m_nGroupMsgBatch = m_nGroupMsgBatch;
 	{
 		auto item = m_ForwardSessMap.find(pServerSess);
 		if (item != m_ForwardSessMap.end())
@@ -2066,6 +2410,85 @@ void CMediumServer::HSF_UserLoginReq(const std::shared_ptr<CServerSess>& pServer
 		m_userLoginMsgMap.insert({ reqMsg.m_strUserName,reqMsg });
 	}
 }
+/**
+ * @brief 注册从服务器返回的消息中需要在本地处理的消息,新增的消息类型在此处增加一行注册
+ * 
+ */
+void CMediumServer::RegisterSendBackHandlers()
+{
+	m_sendBackDispatcher.Register<FriendChatRecvTxtReqMsg>(E_MsgType::FriendChatReceiveTxtMsgReq_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const FriendChatRecvTxtReqMsg& msg) { HSB_FriendChatRecvTxtReq(pClientSess, msg); });
+	m_sendBackDispatcher.Register<FriendChatSendTxtRspMsg>(E_MsgType::FriendChatSendTxtMsgRsp_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const FriendChatSendTxtRspMsg& msg) { HSB_FriendChatSendTxtRsp(pClientSess, msg); });
+	m_sendBackDispatcher.Register<SendGroupTextMsgRspMsg>(E_MsgType::SendGroupTextMsgRsp_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const SendGroupTextMsgRspMsg& msg) { HSB_SendGroupTextMsgRspMsg(pClientSess, msg); });
+	m_sendBackDispatcher.Register<RecvGroupTextMsgReqMsg>(E_MsgType::RecvGroupTextMsgReq_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const RecvGroupTextMsgReqMsg& msg) { HSB_RecvGroupTextMsgReqMsg(pClientSess, msg); });
+	m_sendBackDispatcher.Register<RecvGroupTextMsgBatchReqMsg>(E_MsgType::RecvGroupTextMsgBatchReq_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const RecvGroupTextMsgBatchReqMsg& msg) { HSB_RecvGroupTextMsgBatchReqMsg(pClientSess, msg); });
+	m_sendBackDispatcher.Register<FileSendDataBeginReq>(E_MsgType::FileSendDataBeginReq_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const FileSendDataBeginReq& msg) { HSB_FileSendDataBeginReq(pClientSess, msg); });
+	m_sendBackDispatcher.Register<FileSendDataBeginRsp>(E_MsgType::FileSendDataBeginRsp_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const FileSendDataBeginRsp& msg) { HSB_FileSendDataBeginRsp(pClientSess, msg); });
+	m_sendBackDispatcher.Register<FileVerifyReqMsg>(E_MsgType::FileVerifyReq_Type, [this](const std::shared_ptr<CClientSess>& /*pClientSess*/, const FileVerifyReqMsg& msg) { HandleFileVerifyReq(msg); });
+	m_sendBackDispatcher.Register<UserLoginRspMsg>(E_MsgType::UserLoginRsp_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const UserLoginRspMsg& msg) { HSB_UserLoginRsp(pClientSess, msg); });
+	m_sendBackDispatcher.Register<UserLogoutRspMsg>(E_MsgType::UserLogoutRsp_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const UserLogoutRspMsg& msg) { HSB_UserLogoutRsp(pClientSess, msg); });
+	m_sendBackDispatcher.Register<FileDownLoadRspMsg>(E_MsgType::FileDownLoadRsp_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const FileDownLoadRspMsg& msg) { HSB_FileDownLoadRsp(pClientSess, msg); });
+	m_sendBackDispatcher.Register<FriendRecvFileMsgReqMsg>(E_MsgType::FriendRecvFileMsgReq_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const FriendRecvFileMsgReqMsg& msg) { HSB_FriendRecvFileMsgReq(pClientSess, msg); });
+	m_sendBackDispatcher.Register<QueryUserUdpAddrRspMsg>(E_MsgType::QueryUserUdpAddrRsp_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const QueryUserUdpAddrRspMsg& msg) { HSB_QueryUserUdpAddrRsp(pClientSess, msg); });
+	m_sendBackDispatcher.Register<FileDataSendRspMsg>(E_MsgType::FileSendDataRsp_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const FileDataSendRspMsg& msg) { HSB_FileDataSendRsp(pClientSess, msg); });
+	m_sendBackDispatcher.Register<FileDataRecvReqMsg>(E_MsgType::FileRecvDataReq_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const FileDataRecvReqMsg& msg) { Handle_TcpMsg(pClientSess, msg); });
+	m_sendBackDispatcher.Register<FileVerifyRspMsg>(E_MsgType::FileVerifyRsp_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const FileVerifyRspMsg& msg) { HSB_FileVerifyRsp(pClientSess, msg); });
+	m_sendBackDispatcher.Register<GetFriendListRspMsg>(E_MsgType::GetFriendListRsp_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const GetFriendListRspMsg& msg) { HSB_GetFriendListRsp(pClientSess, msg); });
+	m_sendBackDispatcher.Register<FriendNotifyFileMsgReqMsg>(E_MsgType::FriendNotifyFileMsgReq_Type, [this](const std::shared_ptr<CClientSess>& /*pClientSess*/, const FriendNotifyFileMsgReqMsg& msg) { HandleFriendNotifyFileMsgReq(msg); });
+	m_sendBackDispatcher.Register<NotifyGroupMsgReqMsg>(E_MsgType::NotifyGroupMsgReq_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const NotifyGroupMsgReqMsg& msg) { HSB_NotifyGroupMsgReqMsg(pClientSess, msg); });
+	m_sendBackDispatcher.Register<FriendUnReadNotifyReqMsg>(E_MsgType::FriendUnReadMsgNotifyReq_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const FriendUnReadNotifyReqMsg& msg) { HSB_FriendUnReadNotifyReq(pClientSess, msg); });
+	m_sendBackDispatcher.Register<KeepAliveReqMsg>(E_MsgType::KeepAliveReq_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const KeepAliveReqMsg& /*msg*/) { HSB_KeepAlive(pClientSess); });
+	m_sendBackDispatcher.Register<KeepAliveRspMsg>(E_MsgType::KeepAliveRsp_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const KeepAliveRspMsg& /*msg*/) { HSB_KeepAlive(pClientSess); });
+	m_sendBackDispatcher.Register<UserRegisterRspMsg>(E_MsgType::UserRegisterRsp_Type, [](const std::shared_ptr<CClientSess>& /*pClientSess*/, const UserRegisterRspMsg& /*msg*/) {});
+	m_sendBackDispatcher.RegisterRaw(E_MsgType::NetFailedReport_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const TransBaseMsg_t& /*msg*/) { HSB_NetFailed(pClientSess); });
+	m_sendBackDispatcher.RegisterRaw(E_MsgType::NetRecoverReport_Type, [this](const std::shared_ptr<CClientSess>& pClientSess, const TransBaseMsg_t& /*msg*/) { HSB_NetRecover(pClientSess); });
+}
+
+/**
+ * @brief 注册来自GUI客户端的消息中需要在本地处理的消息,没有注册的消息原样转发到服务器
+ * 
+ */
+void CMediumServer::RegisterSendForwardHandlers()
+{
+	m_sendForwardDispatcher.Register<GetFriendChatHistoryReq>(E_MsgType::GetFriendChatHistroyReq_Type, [this](const std::shared_ptr<CServerSess>& pServerSess, const GetFriendChatHistoryReq& msg) { HSF_GetFriendChatHistoryReq(pServerSess, msg); });
+	m_sendForwardDispatcher.Register<GetGroupChatHistoryReq>(E_MsgType::GetGroupChatHistoryReq_Type, [this](const std::shared_ptr<CServerSess>& pServerSess, const GetGroupChatHistoryReq& msg) { HSF_GetGroupChatHistoryReq(pServerSess, msg); });
+	m_sendForwardDispatcher.Register<FileSendDataBeginReq>(E_MsgType::FileSendDataBeginReq_Type, [this](const std::shared_ptr<CServerSess>& pServerSess, FileSendDataBeginReq& msg) { HSF_FileSendDataBeginReq(pServerSess, msg); });
+	m_sendForwardDispatcher.Register<FriendChatSendTxtReqMsg>(E_MsgType::FriendChatSendTxtMsgReq_Type, [this](const std::shared_ptr<CServerSess>& pServerSess, FriendChatSendTxtReqMsg& msg) { HSF_FriendChatSendTxtReqMsg(pServerSess, msg); });
+	m_sendForwardDispatcher.Register<UserLoginReqMsg>(E_MsgType::UserLoginReq_Type, [this](const std::shared_ptr<CServerSess>& pServerSess, UserLoginReqMsg& msg) { HSF_UserLoginReq(pServerSess, msg); });
+	m_sendForwardDispatcher.Register<SendGroupTextMsgReqMsg>(E_MsgType::SendGroupTextMsgReq_Type, [this](const std::shared_ptr<CServerSess>& pServerSess, SendGroupTextMsgReqMsg& msg) { HSF_SendGroupTextMsgReqMsg(pServerSess, msg); });
+	m_sendForwardDispatcher.Register<FriendSendFileMsgReqMsg>(E_MsgType::FriendSendFileMsgReq_Type, [this](const std::shared_ptr<CServerSess>& pServerSess, const FriendSendFileMsgReqMsg& msg) { HSF_FriendSendFileMsgReq(pServerSess, msg); });
+	m_sendForwardDispatcher.RegisterRaw(E_MsgType::NetFailedReport_Type, [this](const std::shared_ptr<CServerSess>& pServerSess, const TransBaseMsg_t& /*msg*/) { HSF_NetFailedReq(pServerSess); });
+}
+
+/**
+ * @brief 输出上一个周期内每种消息的处理次数和耗时分布,输出以后清零
+ * 
+ */
+void CMediumServer::ReportDispatchStat()
+{
+	m_sendBackDispatcher.VisitStat([this](const E_MsgType type, const MsgDispatchStat_st& stat) {
+		LOG_INFO(ms_loger, "SendBack {} {} [{} {}]", MsgType(type), stat.ToString(), __FILENAME__, __LINE__);
+	}, true);
+	m_sendForwardDispatcher.VisitStat([this](const E_MsgType type, const MsgDispatchStat_st& stat) {
+		LOG_INFO(ms_loger, "SendForward {} {} [{} {}]", MsgType(type), stat.ToString(), __FILENAME__, __LINE__);
+	}, true);
+}
+
+/**
+ * @brief 处理GUI客户端发送文件的请求,计算文件的Hash以后发送到服务器
+ * 
+ * @param reqMsg 发送文件的请求
+ */
+void CMediumServer::HSF_FriendSendFileMsgReq(const std::shared_ptr<CServerSess>& /*pServerSess*/, const FriendSendFileMsgReqMsg& reqMsg)
+{
+	auto pSess = GetClientSess(reqMsg.m_strUserId);
+	if (pSess)
+	{
+		std::string strHash = m_fileUtil.CalcHash(reqMsg.m_strFileName, m_eFileHashType);
+		m_hashTypeMap.insert({ strHash,FILE_TYPE::FILE_TYPE_FILE });
+		pSess->SendMsg(&reqMsg);
+	}
+}
+
 /**
  * @brief 来自GUI客户端的部分消息,不需要发送到远端的服务器,在此函数进行处理
  * 
@@ -2076,94 +2499,36 @@ void CMediumServer::HSF_UserLoginReq(const std::shared_ptr<CServerSess>& pServer
  */
 bool CMediumServer::HandleSendForward(const std::shared_ptr<CServerSess>& pServerSess, const TransBaseMsg_t& msg)
 {
-	switch(msg.GetType())
+	switch (m_sendForwardDispatcher.Dispatch(msg, pServerSess))
 	{
-		case E_MsgType::GetFriendChatHistroyReq_Type:
-		{
-			GetFriendChatHistoryReq reqMsg;
-			if (reqMsg.FromString(msg.to_string())) {
-				HSF_GetFriendChatHistoryReq(pServerSess, reqMsg);
-			}
-		}break;
-		case E_MsgType::GetGroupChatHistoryReq_Type:
-		{
-			GetGroupChatHistoryReq reqMsg;
-			if (reqMsg.FromString(msg.to_string())) {
-				HSF_GetGroupChatHistoryReq(pServerSess, reqMsg);
-			}
-			return true;
-		}break;
-		case E_MsgType::FileSendDataBeginReq_Type:
-		{
-			FileSendDataBeginReq reqMsg;
-			if (reqMsg.FromString(msg.to_string())) {
-				HSF_FileSendDataBeginReq(pServerSess, reqMsg);
-			}
-		}break;
-		case E_MsgType::FriendChatSendTxtMsgReq_Type:
-		{
-			FriendChatSendTxtReqMsg reqMsg;
-			if (reqMsg.FromString(msg.to_string())) {
-				HSF_FriendChatSendTxtReqMsg(pServerSess, reqMsg);
-			}
-		}break;
-		case E_MsgType::UserLoginReq_Type:
-		{
-			UserLoginReqMsg reqMsg;
-			if (reqMsg.FromString(msg.to_string()))
-			{
-				HSF_UserLoginReq(pServerSess, reqMsg);
-			}
-		}break;
-		case E_MsgType::NetFailedReport_Type:
-		{
-			HSF_NetFailedReq(pServerSess);
-		}break;
-		case E_MsgType::SendGroupTextMsgReq_Type:
-		{
-			SendGroupTextMsgReqMsg reqMsg;
-			if (reqMsg.FromString(msg.to_string())) 
-			{
-				HSF_SendGroupTextMsgReqMsg(pServerSess, reqMsg);
-			}
-		}break;
-		case E_MsgType::FriendSendFileMsgReq_Type:
+	case E_DISPATCH_RESULT::NO_HANDLER:
+	{
+		//对于原始消息，原封不动的转发
+		auto item = m_ForwardSessMap.find(pServerSess);
+		if (item != m_ForwardSessMap.end())
 		{
-			FriendSendFileMsgReqMsg reqMsg;
-			if (reqMsg.FromString(msg.to_string()))
-			{
-				auto pSess = GetClientSess(reqMsg.m_strUserId);
-				if (pSess)
-				{
-					std::string strHash = m_fileUtil.CalcHash(reqMsg.m_strFileName);
-					m_hashTypeMap.insert({ strHash,FILE_TYPE::FILE_TYPE_FILE });
-					pSess->SendMsg(&reqMsg);
-				}
-			}
-		}break;
-		default:
+			item->second->SendMsg(std::make_shared<TransBaseMsg_t>(msg));
+		}
+		else
 		{
-			//对于原始消息，原封不动的转发
-			auto item = m_ForwardSessMap.find(pServerSess);
-			if (item != m_ForwardSessMap.end())
+			auto pClientSess = GetClientSess(pServerSess->UserId());
+			if (pClientSess)
 			{
-				auto pMsg = std::make_shared<TransBaseMsg_t>(msg.GetType(), msg.to_string());
-				item->second->SendMsg(pMsg);
+				pClientSess->SendMsg(std::make_shared<TransBaseMsg_t>(msg));
 			}
 			else
 			{
-				auto pClientSess = GetClientSess(pServerSess->UserId());
-				if (pClientSess)
-				{
-					auto pMsg = std::make_shared<TransBaseMsg_t>(msg.GetType(), msg.to_string());
-					pClientSess->SendMsg(pMsg);
-				}
-				else
-				{
-					return false;
-				}
+				return false;
 			}
-		}break;
+		}
+	}break;
+	case E_DISPATCH_RESULT::DECODE_FAILED:
+	{
+		LOG_WARN(ms_loger, "Decode Failed MsgType:{} Content:{} [{} {}]", MsgType(msg.GetType()), msg.to_string(), __FILENAME__, __LINE__);
+	}break;
+	default:
+	{
+	}break;
 	}
 	return true;
 }
@@ -2449,7 +2814,7 @@ void CMediumServer::HSB_FriendChatSendTxtRsp(const std::shared_ptr<CClientSess>&
 	}
 }
 
-void CMediumServer::HSB_RecvGroupTextMsgReqMsg(const std::shared_ptr<CClientSess>& pClientSess, const RecvGroupTextMsgReqMsg& reqMsg)
+void CMediumServer::HSB_RecvGroupTextMsgReqMsg(const std::shared_ptr<CClientSess>& pClientSess, const RecvGroupTextMsgReqMsg& reqMsg, const bool bSendRsp)
 {
 		bool bWaitImage = false;
 		bool bWaitFile = false;
@@ -2540,15 +2905,43 @@ void CMediumServer::HSB_RecvGroupTextMsgReqMsg(const std::shared_ptr<CClientSess
 			{
 				LOG_ERR(ms_loger, "User Id {} No Sess [{} {}]", reqMsg.m_strUserId, __FILENAME__, __LINE__);
 			}
-			RecvGroupTextMsgRspMsg rspMsg;
-			rspMsg.m_strUserId = reqMsg.m_strUserId;
-			rspMsg.m_strGroupId = reqMsg.m_chatMsg.m_strGroupId;
-			rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-			rspMsg.m_strChatMsgId = reqMsg.m_chatMsg.m_strChatMsgId;
-			pClientSess->SendMsg(&rspMsg);
+			if (bSendRsp)
+			{
+				RecvGroupTextMsgRspMsg rspMsg;
+				rspMsg.m_strUserId = reqMsg.m_strUserId;
+				rspMsg.m_strGroupId = reqMsg.m_chatMsg.m_strGroupId;
+				rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+				rspMsg.m_strChatMsgId = reqMsg.m_chatMsg.m_strChatMsgId;
+				pClientSess->SendMsg(&rspMsg);
+			}
 		}
 }
 
+/**
+ * @brief 处理服务器批量下发的群聊消息,每条消息按单条消息处理,处理完以后只回复一次
+ * 
+ * @param pClientSess 客户端连接
+ * @param reqMsg 批量群聊消息
+ */
+void CMediumServer::HSB_RecvGroupTextMsgBatchReqMsg(const std::shared_ptr<CClientSess>& pClientSess, const RecvGroupTextMsgBatchReqMsg& reqMsg)
+{
+	for (const auto& item : reqMsg.m_chatMsgVec)
+	{
+		//等待图片下载的消息以消息ID为键,每条消息使用不同的ID
+		RecvGroupTextMsgReqMsg itemMsg;
+		itemMsg.m_strMsgId = m_httpServer->GenerateMsgId();
+		itemMsg.m_strUserId = reqMsg.m_strUserId;
+		itemMsg.m_chatMsg = item;
+		HSB_RecvGroupTextMsgReqMsg(pClientSess, itemMsg, false);
+	}
+	RecvGroupTextMsgRspMsg rspMsg;
+	rspMsg.m_strUserId = reqMsg.m_strUserId;
+	rspMsg.m_strGroupId = reqMsg.m_strGroupId;
+	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+	rspMsg.m_strChatMsgId = reqMsg.m_strLastChatMsgId;
+	pClientSess->SendMsg(&rspMsg);
+}
+
 /**
  * @brief 处理服务器发送过来的文件数据开始请求
  * 
@@ -2586,9 +2979,19 @@ void CMediumServer::HSB_FileSendDataBeginReq(const std::shared_ptr<CClientSess>&
 	
 
 		strFileName = GetUserImageDir(pClientSess->UserId())+m_fileUtil.GetFileNameFromPath(reqMsg.m_strFileName);
-		if (m_fileUtil.OpenWriteFile(reqMsg.m_nFileId + 1, strFileName))
+		if (StartRecvResume(reqMsg.m_nFileId + 1, reqMsg, strFileName, rspMsg) && rspMsg.m_bResume)
+		{
+			//续传时已经写入的数据包不再计算,校验时读取文件
+			m_fileRecvHashMap.erase(reqMsg.m_nFileId + 1);
+		}
+		else if (m_fileResumeMap.count(reqMsg.m_nFileId + 1) > 0 || m_fileUtil.OpenWriteFile(reqMsg.m_nFileId + 1, strFileName))
 		{
 			LOG_INFO(ms_loger, "{} Open File Succeed:{} [{} {}]", reqMsg.m_strUserId, strFileName, __FILENAME__, __LINE__);
+			//按发送端Hash的算法在接收时计算
+			FILE_HASH_TYPE eHashType = m_eFileHashType;
+			CFileHash::TypeOfHash(reqMsg.m_strFileHash, eHashType);
+			m_fileRecvHashMap.erase(reqMsg.m_nFileId + 1);
+			m_fileRecvHashMap.insert({ reqMsg.m_nFileId + 1, CChunkHash(eHashType) });
 		}
 		else
 		{
@@ -2738,7 +3141,9 @@ void CMediumServer::HSB_FileDownLoadRsp(const std::shared_ptr<CClientSess>& pCli
 	{
 		m_fileHashMsgIdMap.insert({ rspMsg.m_strFileHash, rspMsg.m_strRelateMsgId });
 		std::string strFileName = GetUserImageDir(pClientSess->UserId()) + rspMsg.m_strFileName;
-		if (m_fileUtil.IsFileExist(strFileName) && rspMsg.m_strFileHash == m_fileUtil.CalcHash(strFileName))
+		FILE_HASH_TYPE eHashType = FILE_HASH_TYPE::HASH_MD5;
+		CFileHash::TypeOfHash(rspMsg.m_strFileHash, eHashType);
+		if (m_fileUtil.IsFileExist(strFileName) && rspMsg.m_strFileHash == m_fileUtil.CalcHash(strFileName, eHashType))
 		{
 			HandleUserRecvImageByHash(pClientSess, strFileName, rspMsg.m_strFileHash);
 			HandleGroupRecvImageByHash(pClientSess, strFileName, rspMsg.m_strFileHash);
@@ -2815,6 +3220,32 @@ void CMediumServer::SendWaitMsgByHash(const std::shared_ptr<CClientSess>& pClien
  */
 void CMediumServer::HSB_FileSendDataBeginRsp(const std::shared_ptr<CClientSess>& pClientSess, const FileSendDataBeginRsp rspMsg)
 {
+	//服务器已有相同内容的文件,用服务器给出的盐证明持有文件以后秒传
+	if (rspMsg.m_errCode == ERROR_CODE_TYPE::E_CODE_FILE_NEED_PROOF)
+	{
+		std::string strImageName = GetUserImageDir(pClientSess->UserId()) + rspMsg.m_strFileName;
+		FileSendDataBeginReq beginReqMsg;
+		beginReqMsg.m_nFileId = rspMsg.m_nFileId;
+		beginReqMsg.m_strMsgId = rspMsg.m_strMsgId;
+		beginReqMsg.m_strUserId = rspMsg.m_strUserId;
+		beginReqMsg.m_strFriendId = rspMsg.m_strFriendId;
+		beginReqMsg.m_strFileName = rspMsg.m_strFileName;
+		beginReqMsg.m_eFileType = rspMsg.m_eFileType;
+		beginReqMsg.m_strFileHash = m_fileUtil.CalcHash(strImageName, m_eFileHashType);
+		m_fileUtil.GetFileSize(beginReqMsg.m_nFileSize, strImageName);
+		beginReqMsg.m_nChunkSize = pClientSess->ChunkSize();
+		beginReqMsg.m_bProofSupport = true;
+		beginReqMsg.m_strProofSalt = rspMsg.m_strProofSalt;
+		beginReqMsg.m_strFileProof = CFileHash::CalcProof(strImageName, rspMsg.m_strProofSalt);
+		if (beginReqMsg.m_strFileProof.empty())
+		{
+			LOG_ERR(ms_loger, "User:{} File:{} Not Exist [{} {}]", pClientSess->UserId(), strImageName, __FILENAME__, __LINE__);
+			return;
+		}
+		auto pMsg = std::make_shared<TransBaseMsg_t>(beginReqMsg.GetMsgType(), beginReqMsg.ToString());
+		pClientSess->SendMsg(pMsg);
+		return;
+	}
 	if (rspMsg.m_errCode == ERROR_CODE_TYPE::E_CODE_SUCCEED)
 	{
 		//int nFileId = static_cast<int>(time(nullptr));
@@ -2822,22 +3253,34 @@ void CMediumServer::HSB_FileSendDataBeginRsp(const std::shared_ptr<CClientSess>&
 		std::string strImageName = GetUserImageDir(pClientSess->UserId()) + rspMsg.m_strFileName;
 		m_fileUtil.GetFileSize(nFileSize, strImageName);
 		if (m_fileUtil.OpenReadFile(rspMsg.m_nFileId, strImageName)) {
-			FileDataSendReqMsg sendReqMsg;
-			sendReqMsg.m_strMsgId = m_httpServer->GenerateMsgId();
-			sendReqMsg.m_strFriendId = rspMsg.m_strFriendId;
-			sendReqMsg.m_strUserId = rspMsg.m_strUserId;
-			sendReqMsg.m_nFileId = rspMsg.m_nFileId;
-
-			sendReqMsg.m_nDataTotalCount = nFileSize / 1024 + (nFileSize % 1024 == 0 ? 0 : 1);
-			sendReqMsg.m_nDataIndex = 1;
-			sendReqMsg.m_nDataLength = 0;
-			m_fileUtil.OnReadData(sendReqMsg.m_nFileId, sendReqMsg.m_szData, sendReqMsg.m_nDataLength, 1024);
-			pClientSess->SendMsg(&sendReqMsg);
+			FileSendWindow_st sendWindow;
+			//TCP使用登录时协商的数据包长度
+			int nChunkSize = pClientSess->ChunkSize();
+			int nTotalCount = FileDataChunkCount(nFileSize, nChunkSize);
+			sendWindow.m_window = CFileSendWindow(nTotalCount, m_nFileWindowSize);
+			sendWindow.m_chunkHash = CChunkHash(m_eFileHashType);
+			sendWindow.m_reqMsg.m_nChunkSize = nChunkSize;
+			sendWindow.m_reqMsg.m_strFriendId = rspMsg.m_strFriendId;
+			sendWindow.m_reqMsg.m_strUserId = rspMsg.m_strUserId;
+			sendWindow.m_reqMsg.m_nFileId = rspMsg.m_nFileId;
+			sendWindow.m_reqMsg.m_nDataTotalCount = nTotalCount;
+			//接收端续传时只发送缺少的数据包
+			if (rspMsg.m_bResume && rspMsg.m_nChunkSize == nChunkSize)
+			{
+				sendWindow.m_window.SetSendRanges(rspMsg.m_missingRangeVec);
+				sendWindow.m_strFileHash = m_fileUtil.CalcHash(strImageName, m_eFileHashType);
+			}
+			std::weak_ptr<CClientSess> weakSess = pClientSess;
+			sendWindow.m_sendFunc = [weakSess](const FileDataSendReqMsg& reqMsg) {
+				auto pSess = weakSess.lock();
+				return pSess && pSess->SendMsg(&reqMsg);
+			};
+			StartFileDataSend(sendWindow);
 		}
 	}
 	else {
 		std::string strImageName = GetUserImageDir(pClientSess->UserId()) + rspMsg.m_strFileName;
-		std::string strFileHash = m_fileUtil.CalcHash(strImageName);
+		std::string strFileHash = m_fileUtil.CalcHash(strImageName, m_eFileHashType);
 		SendWaitMsgByHash(pClientSess,strFileHash);
 	}
 }
@@ -2851,6 +3294,14 @@ void CMediumServer::HSB_FileSendDataBeginRsp(const std::shared_ptr<CClientSess>&
 void CMediumServer::HSB_UserLoginRsp(const std::shared_ptr<CClientSess>& pClientSess, const UserLoginRspMsg rspMsg) {
 	if (rspMsg.m_eErrCode == ERROR_CODE_TYPE::E_CODE_SUCCEED)
 	{
+		//旧版本的服务器回复默认长度
+		pClientSess->SetFrameSize(rspMsg.m_nMaxFrameSize, rspMsg.m_nChunkSize);
+		//旧版本的服务器不回复BinaryCodec,继续使用json
+		if (rspMsg.m_bBinaryCodec)
+		{
+			pClientSess->EnableBinaryCodec();
+		}
+		LOG_INFO(ms_loger, "[{}] Max Frame Size:{} Chunk Size:{} [{} {}]", rspMsg.m_strUserId, rspMsg.m_nMaxFrameSize, rspMsg.m_nChunkSize, __FILENAME__, __LINE__);
 		m_userStateMap.erase(rspMsg.m_strUserId);
 		m_userStateMap.insert({ rspMsg.m_strUserId,CLIENT_SESS_STATE::SESS_LOGIN_FINISHED });
 		//ForwardMap 和 BackMap的对应关系删除,移动到UserId的Map
@@ -3120,6 +3571,59 @@ void CMediumServer::HSB_QueryUserUdpAddrRsp(const std::shared_ptr<CClientSess>&
 	}
 }
 
+/**
+ * @brief 网络恢复以后,正在登录的用户重新发送登录请求
+ * 
+ * @param pClientSess 恢复连接的会话
+ */
+void CMediumServer::HSB_NetRecover(const std::shared_ptr<CClientSess>& pClientSess)
+{
+	auto stateItem = m_userStateMap.find(pClientSess->UserId());
+	if(stateItem != m_userStateMap.end()){
+		if (stateItem->second == CLIENT_SESS_STATE::SESS_LOGIN_SEND) {
+			auto item = m_userLoginMsgMap.find(pClientSess->UserName());
+			if (item != m_userLoginMsgMap.end())
+			{
+				pClientSess->SendMsg(&(item->second));
+			}
+		}
+	}
+}
+
+/**
+ * @brief 收到服务器的TCP心跳以后,通过UDP发送心跳,保持UDP地址有效
+ * 
+ * @param pClientSess 收到心跳的会话
+ */
+void CMediumServer::HSB_KeepAlive(const std::shared_ptr<CClientSess>& pClientSess)
+{
+	KeepAliveReqMsg reqMsg;
+	reqMsg.m_strClientId = pClientSess->UserId();
+	auto pUdpSess = GetUdpSess(pClientSess->UserId());
+	if (nullptr != pUdpSess)
+	{
+		pUdpSess->sendToServer(&reqMsg);
+	}
+}
+
+/**
+ * @brief 回复服务器的好友未读消息通知
+ * 
+ * @param reqMsg 好友未读消息通知
+ */
+void CMediumServer::HSB_FriendUnReadNotifyReq(const std::shared_ptr<CClientSess>& /*pClientSess*/, const FriendUnReadNotifyReqMsg& reqMsg)
+{
+	FriendUnReadNotifyRspMsg rspMsg;
+	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+	rspMsg.m_strUserId = reqMsg.m_strUserId;
+	auto pSess = GetClientSess(rspMsg.m_strUserId);
+	if (pSess != nullptr)
+	{
+		auto pSend = std::make_shared<TransBaseMsg_t>(rspMsg.GetMsgType(), rspMsg.ToString());
+		pSess->SendMsg(pSend);
+	}
+}
+
 /**
  * @brief 部分消息不需要返回给GUI客户端，在此函数进行处理
  * 
@@ -3130,208 +3634,19 @@ void CMediumServer::HSB_QueryUserUdpAddrRsp(const std::shared_ptr<CClientSess>&
  */
 bool CMediumServer::HandleSendBack(const std::shared_ptr<CClientSess>& pClientSess, const TransBaseMsg_t& msg)
 {
-	switch (msg.GetType())
-	{
-	case E_MsgType::FriendChatReceiveTxtMsgReq_Type:
-	{
-		FriendChatRecvTxtReqMsg reqMsg;
-		if (reqMsg.FromString(msg.to_string())) {
-			HSB_FriendChatRecvTxtReq(pClientSess, reqMsg);
-		}
-	}break;
-	case E_MsgType::FriendChatSendTxtMsgRsp_Type:
+	switch (m_sendBackDispatcher.Dispatch(msg, pClientSess))
 	{
-		FriendChatSendTxtRspMsg rspMsg;
-		if (rspMsg.FromString(msg.to_string())) {
-			HSB_FriendChatSendTxtRsp(pClientSess, rspMsg);
-		}
-	}break;
-	case E_MsgType::SendGroupTextMsgRsp_Type:
-	{
-		SendGroupTextMsgRspMsg rspMsg;
-		if (rspMsg.FromString(msg.to_string())) {
-			HSB_SendGroupTextMsgRspMsg(pClientSess, rspMsg);
-		}
-	}break;
-	case E_MsgType::RecvGroupTextMsgReq_Type:
+	case E_DISPATCH_RESULT::NO_HANDLER:
 	{
-		RecvGroupTextMsgReqMsg reqMsg;
-		if (reqMsg.FromString(msg.to_string())) {
-			HSB_RecvGroupTextMsgReqMsg(pClientSess,reqMsg);
-		}
-	}break;
-	case E_MsgType::FileSendDataBeginReq_Type:
-	{
-		FileSendDataBeginReq reqMsg;
-		if (reqMsg.FromString(msg.to_string())) {
-			HSB_FileSendDataBeginReq(pClientSess, reqMsg);
-		}
-	}break;
-	case E_MsgType::FileSendDataBeginRsp_Type:
-	{
-		FileSendDataBeginRsp rspMsg;
-		if (rspMsg.FromString(msg.to_string())) {
-			HSB_FileSendDataBeginRsp(pClientSess, rspMsg);
-		}
-	}break;
-	case E_MsgType::FileVerifyReq_Type:
-	{
-		FileVerifyReqMsg reqMsg;
-		if (reqMsg.FromString(msg.to_string())) {
-			HandleFileVerifyReq(reqMsg);
-		}
-	}break;
-	case E_MsgType::UserLoginRsp_Type:
-	{
-		UserLoginRspMsg rspMsg;
-		if (rspMsg.FromString(msg.to_string())) {
-			HSB_UserLoginRsp(pClientSess, rspMsg);
-		}
-	}break;
-	case E_MsgType::UserLogoutRsp_Type:
-	{
-		UserLogoutRspMsg rspMsg;
-		if (rspMsg.FromString(msg.to_string())) {
-			HSB_UserLogoutRsp(pClientSess, rspMsg);
-		}
-	}break;
-	case E_MsgType::NetFailedReport_Type:
-	{
-		HSB_NetFailed(pClientSess);
-	}break;
-	case E_MsgType::FileDownLoadRsp_Type:
-	{
-		FileDownLoadRspMsg rspMsg;
-		if (rspMsg.FromString(msg.to_string())) {
-			HSB_FileDownLoadRsp(pClientSess,rspMsg);
-		}
-	}break;
-	case E_MsgType::FriendRecvFileMsgReq_Type:
-	{
-		FriendRecvFileMsgReqMsg reqMsg;
-		if (reqMsg.FromString(msg.to_string())) {
-			HSB_FriendRecvFileMsgReq(pClientSess, reqMsg);
-		}
-	}break;
-	case E_MsgType::NetRecoverReport_Type: {
-		auto stateItem = m_userStateMap.find(pClientSess->UserId());
-		if(stateItem != m_userStateMap.end()){
-			if (stateItem->second == CLIENT_SESS_STATE::SESS_LOGIN_SEND) {
-				auto item = m_userLoginMsgMap.find(pClientSess->UserName());
-				if (item != m_userLoginMsgMap.end())
-				{
-					pClientSess->SendMsg(&(item->second));
-				}
-			}
-		}
-	}break;
-	case E_MsgType::KeepAliveRsp_Type:
-	{
-		KeepAliveRspMsg rspMsg;
-		if (rspMsg.FromString(msg.to_string()))
-		{
-			KeepAliveReqMsg reqMsg;
-			reqMsg.m_strClientId = pClientSess->UserId();
-			{
-				auto pUdpSess = GetUdpSess(pClientSess->UserId());
-				if (nullptr != pUdpSess)
-				{
-					pUdpSess->sendToServer(&reqMsg);
-				}
-			}
-		}
-	}break;
-	case E_MsgType::KeepAliveReq_Type:
-	{
-		KeepAliveReqMsg reqMsg;
-		if (reqMsg.FromString(msg.to_string()))
-		{
-			KeepAliveReqMsg reqMsg2;
-			reqMsg2.m_strClientId = pClientSess->UserId();
-			{
-				auto pUdpSess = GetUdpSess(pClientSess->UserId());
-				if (nullptr != pUdpSess)
-				{
-					pUdpSess->sendToServer(&reqMsg2);
-				}
-			}
-		}
-	}break;
-	case E_MsgType::QueryUserUdpAddrRsp_Type:
-	{
-		QueryUserUdpAddrRspMsg rspMsg;
-		if (rspMsg.FromString(msg.to_string())) {
-			HSB_QueryUserUdpAddrRsp(pClientSess, rspMsg);
-		}
-	}break;
-	case E_MsgType::FriendUnReadMsgNotifyReq_Type:
-	{
-		FriendUnReadNotifyReqMsg reqMsg;
-		if (reqMsg.FromString(msg.to_string())) {
-			FriendUnReadNotifyRspMsg rspMsg;
-			rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-			rspMsg.m_strUserId = reqMsg.m_strUserId;
-			auto pSess = GetClientSess(rspMsg.m_strUserId);
-			if (pSess != nullptr)
-			{
-				auto pSend = std::make_shared<TransBaseMsg_t>(rspMsg.GetMsgType(), rspMsg.ToString());
-				pSess->SendMsg(pSend);
-			}
-		}
-	}break;
-	case E_MsgType::FileSendDataRsp_Type:
-	{
-		FileDataSendRspMsg rspMsg;
-		if (rspMsg.FromString(msg.to_string())) {
-			HSB_FileDataSendRsp(pClientSess,rspMsg);
-		}
-	}break;
-	case E_MsgType::FileRecvDataReq_Type:
-	{
-		FileDataRecvReqMsg reqMsg;
-		if (reqMsg.FromString(msg.to_string())) {
-			Handle_TcpMsg(pClientSess, reqMsg);
-		}
-		return true;
-	}break;
-	case E_MsgType::FileVerifyRsp_Type:
-	{
-		FileVerifyRspMsg rspMsg;
-		if (rspMsg.FromString(msg.to_string())) {
-			HSB_FileVerifyRsp(pClientSess, rspMsg);
-		}
-	}break;
-	case E_MsgType::GetFriendListRsp_Type:
-	{
-		GetFriendListRspMsg rspMsg;
-		if (rspMsg.FromString(msg.to_string())) {
-			HSB_GetFriendListRsp(pClientSess, rspMsg);
-		}
-	}break;
-	case E_MsgType::FriendNotifyFileMsgReq_Type:
-	{
-		FriendNotifyFileMsgReqMsg reqMsg;
-		if (reqMsg.FromString(msg.to_string())) {
-			HandleFriendNotifyFileMsgReq(reqMsg);
-		}
-	}break;
-	case E_MsgType::UserRegisterRsp_Type:
-	{
-		UserRegisterRspMsg rspMsg;
-		if (rspMsg.FromString(msg.to_string())) {
-		}
+		LOG_WARN(ms_loger, "UnHandle MsgType:{} Content:{} [{} {}]", MsgType(msg.GetType()), msg.to_string(), __FILENAME__, __LINE__);
+		return false;
 	}break;
-	case E_MsgType::NotifyGroupMsgReq_Type:
+	case E_DISPATCH_RESULT::DECODE_FAILED:
 	{
-		NotifyGroupMsgReqMsg reqMsg;
-		if (reqMsg.FromString(msg.to_string())) {
-			HSB_NotifyGroupMsgReqMsg(pClientSess,reqMsg);
-		}
+		LOG_WARN(ms_loger, "Decode Failed MsgType:{} Content:{} [{} {}]", MsgType(msg.GetType()), msg.ToPrintString(), __FILENAME__, __LINE__);
 	}break;
 	default:
 	{
-		LOG_WARN(ms_loger, "UnHandle MsgType:{} Content:{} [{} {}]", MsgType(msg.GetType()), msg.to_string(), __FILENAME__, __LINE__);
-		return false;
 	}break;
 	}
 	return true;
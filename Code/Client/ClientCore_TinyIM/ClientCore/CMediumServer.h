@@ -29,10 +29,40 @@
 #include "CMsgPersistentUtil.h"
 #include "CFileUtil.h"
 #include "CFileTransSpeedUtil.h"
+#include "CFileTransWindow.h"
+#include "CFileHash.h"
+#include "CFileResume.h"
+#include "CMsgDispatcher.h"
 namespace ClientCore
 {
 using tcp = asio::ip::tcp;
 class CClientSess;
+
+/**
+ * @brief 按滑动窗口发送文件的状态
+ * 
+ */
+struct FileSendWindow_st
+{
+	CFileSendWindow m_window;//发送窗口
+	FileDataSendReqMsg m_reqMsg;//数据包共用的字段,每次发送时填入索引和数据
+	std::function<bool(const FileDataSendReqMsg&)> m_sendFunc;//发送一个数据包,对端不可达时返回false
+	bool m_bNotifyProgress = false;//是否向界面通知发送进度
+	int m_nNotifyPercent = -1;//上次通知界面的进度,进度变化时才通知
+	CChunkHash m_chunkHash;//发送时按数据包计算的Hash,发送完成时不再读取文件
+	std::string m_strFileHash;//续传时跳过的数据包无法按数据包计算,发送前读取文件计算
+};
+
+/**
+ * @brief 接收文件的断点续传状态
+ * 
+ */
+struct FileRecvResume_st
+{
+	std::string m_strStatePath;//续传状态保存的文件
+	CFileResumeState m_state;
+};
+
 class CMediumServer : public std::enable_shared_from_this<CMediumServer>
 {
   protected:
@@ -53,6 +83,16 @@ class CMediumServer : public std::enable_shared_from_this<CMediumServer>
 
 	CFileUtil m_fileUtil;
 
+	int m_nFileWindowSize = CFileSendWindow::DEFAULT_WINDOW_SIZE;//文件传输时同时在途的数据包个数
+	int m_nMaxFrameSize = MSG_MAX_FRAME_SIZE;//登录时请求的单条消息最大长度
+	int m_nChunkSize = FILE_DATA_TCP_CHUNK_SIZE;//登录时请求的TCP文件数据包长度
+	int m_nGroupMsgBatch = GROUP_MSG_BATCH_DEFAULT;//登录时请求的每批群聊消息条数,0表示逐条接收
+	std::map<int, FileSendWindow_st> m_fileSendWindowMap;//正在发送的文件,以文件ID为键
+	std::map<int, CFileRecvWindow> m_fileRecvWindowMap;//正在接收的文件,以写入的文件ID为键
+	std::map<int, CChunkHash> m_fileRecvHashMap;//正在接收的文件写入时计算的Hash,以写入的文件ID为键
+	std::map<int, FileRecvResume_st> m_fileResumeMap;//可以续传的正在接收的文件,以写入的文件ID为键
+	FILE_HASH_TYPE m_eFileHashType = FILE_HASH_TYPE::HASH_MD5;//发送文件使用的Hash算法,旧版本的服务器只支持MD5
+
     
 	//std::vector<std::shared_ptr<CServerSess>> m_GuiSessList; //监听的套接字的列表
 	//std::vector<std::shared_ptr<CClientSess>> m_ConnectSessList; //连接到服务器的套接字列表
@@ -84,9 +124,19 @@ class CMediumServer : public std::enable_shared_from_this<CMediumServer>
 
 	void HandleFileDataSendRsp(const FileDataSendRspMsg& rspMsg);
 
+	void StartFileDataSend(const FileSendWindow_st& sendWindow);
+	void SendFileDataWindow(const int nFileId);
+	bool SendFileDataChunk(FileSendWindow_st& sendWindow, const int nIndex);
+	void OnFileDataSendRsp(const FileDataSendRspMsg& rspMsg);
+	void CheckFileDataTimeout();
+	int OnRecvFileData(const int nWriteFileId, const int nDataTotalCount, const int nDataIndex, const int nChunkSize, const std::vector<char>& dataVec);
+
 	void HandleFileDataRecvReq(const FileDataRecvReqMsg& reqMsg);
 
 	void HandleFileVerifyReq(const FileVerifyReqMsg& msg);
+	std::string FinishRecvHash(const int nWriteFileId, const std::string& strFileName, const std::string& strPeerHash);
+	bool StartRecvResume(const int nWriteFileId, const FileSendDataBeginReq& req, const std::string& strFileName, FileSendDataBeginRsp& rspMsg);
+	void FinishRecvResume(const int nWriteFileId);
 	void HandleFriendNotifyFileMsgReq(const FriendNotifyFileMsgReqMsg& reqMsg);
   public:
     static std::shared_ptr<spdlog::logger> ms_loger;
@@ -143,6 +193,8 @@ class CMediumServer : public std::enable_shared_from_this<CMediumServer>
         }
 		m_timeCount = 0;
 		m_nNoSessTimeCount = 0;
+		RegisterSendBackHandlers();
+		RegisterSendForwardHandlers();
     }
 
 	void ServerSessClose(const CServerSess_SHARED_PTR pSess);
@@ -155,7 +207,6 @@ class CMediumServer : public std::enable_shared_from_this<CMediumServer>
 	GetFriendChatHistoryRsp DoFriendChatHistoryReq(const GetFriendChatHistoryReq& reqMsg);
 	GetGroupChatHistoryRsp DoFriendChatHistoryReq(const GetGroupChatHistoryReq& reqMsg);
 	SearchChatHistoryRsp DoSearchChatHistoryReq(const SearchChatHistoryReq& reqMsg);
-	TransBaseMsg_S_PTR DoSendBackFileDataSendRsp(const FileDataSendRspMsg& rspMsg);
 private:
 	std::vector<std::string> GetLocalAllIp();
 	CServerSess_SHARED_PTR Get_GUI_Sess(const std::string strUserId);
@@ -173,9 +224,13 @@ private:
 	void HSB_FileDataSendRsp(const std::shared_ptr<CClientSess>& pClientSess, const FileDataSendRspMsg& rspMsg);
 	void HSB_FileVerifyRsp(const std::shared_ptr<CClientSess>& pClientSess, const FileVerifyRspMsg& rspMsg);
 	void HSB_FriendRecvFileMsgReq(const std::shared_ptr<CClientSess>& pClientSess, const FriendRecvFileMsgReqMsg reqMsg);
-	void HSB_RecvGroupTextMsgReqMsg(const std::shared_ptr<CClientSess>& pClientSess, const RecvGroupTextMsgReqMsg& reqMsg);
+	void HSB_RecvGroupTextMsgReqMsg(const std::shared_ptr<CClientSess>& pClientSess, const RecvGroupTextMsgReqMsg& reqMsg, const bool bSendRsp = true);
+	void HSB_RecvGroupTextMsgBatchReqMsg(const std::shared_ptr<CClientSess>& pClientSess, const RecvGroupTextMsgBatchReqMsg& reqMsg);
 	void HSB_SendGroupTextMsgRspMsg(const std::shared_ptr<CClientSess>& pClientSess, const SendGroupTextMsgRspMsg& rspMsg);
 	void HSB_NotifyGroupMsgReqMsg(const std::shared_ptr<CClientSess>& pClientSess, const NotifyGroupMsgReqMsg& reqMsg);
+	void HSB_NetRecover(const std::shared_ptr<CClientSess>& pClientSess);
+	void HSB_KeepAlive(const std::shared_ptr<CClientSess>& pClientSess);
+	void HSB_FriendUnReadNotifyReq(const std::shared_ptr<CClientSess>& pClientSess, const FriendUnReadNotifyReqMsg& reqMsg);
 
 	bool HandleSendForward(const std::shared_ptr<CServerSess>& pServerSess, const TransBaseMsg_t& msg);
 	void HSF_GetFriendChatHistoryReq(const std::shared_ptr<CServerSess>& pServerSess, const GetFriendChatHistoryReq& msg);
@@ -185,6 +240,13 @@ private:
 	void HSF_UserLoginReq(const std::shared_ptr<CServerSess>& pServerSess, UserLoginReqMsg& reqMsg);
 	void HSF_NetFailedReq(const std::shared_ptr<CServerSess>& pServerSess);
 	void HSF_SendGroupTextMsgReqMsg(const std::shared_ptr<CServerSess>& pServerSess, SendGroupTextMsgReqMsg& reqMsg);
+	void HSF_FriendSendFileMsgReq(const std::shared_ptr<CServerSess>& pServerSess, const FriendSendFileMsgReqMsg& reqMsg);
+
+	void RegisterSendBackHandlers();
+	void RegisterSendForwardHandlers();
+	void ReportDispatchStat();
+	CMsgDispatcher<const std::shared_ptr<CClientSess>&> m_sendBackDispatcher;//从服务器返回的消息的分发器
+	CMsgDispatcher<const std::shared_ptr<CServerSess>&> m_sendForwardDispatcher;//来自GUI客户端的消息的分发器
 
 	void Handle_TcpMsg(const std::shared_ptr<CClientSess>& pClientSess, const FileDataRecvReqMsg& reqMsg);
 
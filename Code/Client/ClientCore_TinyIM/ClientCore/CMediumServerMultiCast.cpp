@@ -154,7 +154,7 @@ void CMultiCastCoreServer::Handle_UdpMsg(const asio::ip::udp::endpoint endPt, co
 {
 	if (reqMsg.m_nDataIndex <= reqMsg.m_nDataTotalCount)
 	{
-		m_fileUtil.OnWriteData(reqMsg.m_nFileId + 1, reqMsg.m_szData, reqMsg.m_nDataLength);
+		m_fileUtil.OnWriteData(reqMsg.m_nFileId + 1, reqMsg.m_dataVec.data(), static_cast<int>(reqMsg.m_dataVec.size()));
 		FileDataSendRspMsg rspMsg;
 		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
 		rspMsg.m_nFileId = reqMsg.m_nFileId;
@@ -322,8 +322,10 @@ TransBaseMsg_S_PTR CMultiCastCoreServer::DoSendBackFileDataSendRsp(const FileDat
 	if (rspMsg.m_nDataIndex < rspMsg.m_nDataTotalCount)
 	{
 		FileDataSendReqMsg reqMsg;
-		if (m_fileUtil.OnReadData(rspMsg.m_nFileId, reqMsg.m_szData, reqMsg.m_nDataLength, 1024))
+		reqMsg.m_dataVec.resize(FILE_DATA_CHUNK_SIZE);
+		if (m_fileUtil.OnReadData(rspMsg.m_nFileId, reqMsg.m_dataVec.data(), reqMsg.m_nDataLength, FILE_DATA_CHUNK_SIZE))
 		{
+			reqMsg.m_dataVec.resize(reqMsg.m_nDataLength);
 			LOG_INFO(ms_loger, "Read Data ", rspMsg.m_nFileId);
 			reqMsg.m_strMsgId = m_httpServer->GenerateMsgId();
 			reqMsg.m_nFileId = rspMsg.m_nFileId;
@@ -363,8 +365,10 @@ void CMultiCastCoreServer::Handle_UdpMsg(const asio::ip::udp::endpoint endPt,con
 	if (rspMsg.m_nDataIndex < rspMsg.m_nDataTotalCount)
 	{
 		FileDataSendReqMsg reqMsg;
-		if (m_fileUtil.OnReadData(rspMsg.m_nFileId, reqMsg.m_szData, reqMsg.m_nDataLength, 1024))
+		reqMsg.m_dataVec.resize(FILE_DATA_CHUNK_SIZE);
+		if (m_fileUtil.OnReadData(rspMsg.m_nFileId, reqMsg.m_dataVec.data(), reqMsg.m_nDataLength, FILE_DATA_CHUNK_SIZE))
 		{
+			reqMsg.m_dataVec.resize(reqMsg.m_nDataLength);
 			LOG_INFO(ms_loger, "Read Data ", rspMsg.m_nFileId);
 			reqMsg.m_strMsgId = m_httpServer->GenerateMsgId();
 			reqMsg.m_nFileId = rspMsg.m_nFileId;
@@ -1206,7 +1210,9 @@ void CMultiCastCoreServer::HandleFriendNotifyFileMsgReq(const FriendNotifyFileMs
 				reqMsg.m_nFileId = notifyMsg.m_nFileId;
 				reqMsg.m_strFriendId = notifyMsg.m_strFriendId;
 				reqMsg.m_strUserId = notifyMsg.m_strUserId;
-				m_fileUtil.OnReadData(reqMsg.m_nFileId, reqMsg.m_szData, reqMsg.m_nDataLength, 1024);
+				reqMsg.m_dataVec.resize(FILE_DATA_CHUNK_SIZE);
+				m_fileUtil.OnReadData(reqMsg.m_nFileId, reqMsg.m_dataVec.data(), reqMsg.m_nDataLength, FILE_DATA_CHUNK_SIZE);
+				reqMsg.m_dataVec.resize(reqMsg.m_nDataLength);
 				pSess->sendToServer(&reqMsg);
 				//	nIndex++;
 				//}
@@ -1241,7 +1247,9 @@ void CMultiCastCoreServer::HandleFriendNotifyFileMsgReq(const FriendNotifyFileMs
 				sendReqMsg.m_nDataTotalCount = nFileSize / 1024 + (nFileSize % 1024 == 0 ? 0 : 1);
 				sendReqMsg.m_nDataIndex = 1;
 				sendReqMsg.m_nDataLength = 0;
-				m_fileUtil.OnReadData(sendReqMsg.m_nFileId, sendReqMsg.m_szData, sendReqMsg.m_nDataLength, 1024);
+				sendReqMsg.m_dataVec.resize(FILE_DATA_CHUNK_SIZE);
+				m_fileUtil.OnReadData(sendReqMsg.m_nFileId, sendReqMsg.m_dataVec.data(), sendReqMsg.m_nDataLength, FILE_DATA_CHUNK_SIZE);
+				sendReqMsg.m_dataVec.resize(sendReqMsg.m_nDataLength);
 
 				{
 					auto pUdpSess = GetUdpSess(sendReqMsg.m_strUserId);
@@ -1311,7 +1319,7 @@ void CMultiCastCoreServer::Handle_UdpMsg(const asio::ip::udp::endpoint endPt, co
 {
 	if (reqMsg.m_nDataIndex <= reqMsg.m_nDataTotalCount)
 	{
-		m_fileUtil.OnWriteData(reqMsg.m_nFileId + 1, reqMsg.m_szData, reqMsg.m_nDataLength);
+		m_fileUtil.OnWriteData(reqMsg.m_nFileId + 1, reqMsg.m_dataVec.data(), static_cast<int>(reqMsg.m_dataVec.size()));
 		LOG_INFO(ms_loger, "WriteData:File ID {} [{} {}]", reqMsg.m_nFileId, __FILENAME__,__LINE__);
 		FileDataRecvRspMsg rspMsg;
 		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
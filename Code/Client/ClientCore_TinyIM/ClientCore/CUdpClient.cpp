@@ -99,7 +99,7 @@ namespace ClientCore {
 		if (!endpoints.empty())
 		{
 			
-			auto pSend = std::make_shared<TransBaseMsg_t>(pMsg->GetMsgType(), pMsg->ToString());
+			auto pSend = std::make_shared<TransBaseMsg_t>(*pMsg, IsFileDataMsgType(pMsg->GetMsgType()));
 			send_msg(*endpoints.begin(), pSend);
 		}
 	}
@@ -124,7 +124,8 @@ namespace ClientCore {
 	 */
 	void CUdpClient::send_msg(const asio::ip::udp::endpoint endPt, const BaseMsg* pMsg)
 	{
-		auto pSend= std::make_shared<TransBaseMsg_t>(pMsg->GetMsgType(), pMsg->ToString());
+		//文件数据使用二进制帧,原始数据直接放在帧尾,不做hex转换
+		auto pSend= std::make_shared<TransBaseMsg_t>(*pMsg, IsFileDataMsgType(pMsg->GetMsgType()));
 		send_msg(endPt, pSend);
 	}
 
@@ -148,9 +149,9 @@ namespace ClientCore {
 		
 		if (m_udpSocket)
 		{
-			memcpy(m_sendbuf, pMsg->GetData(), pMsg->GetSize());
 			try {
-				m_udpSocket->async_send_to(asio::buffer(m_sendbuf, pMsg->GetSize()), endPt, [this](std::error_code /*ec*/, std::size_t /*bytes*/) {
+				//每个发送请求持有自己的数据,避免未完成的发送被后续消息覆盖
+				m_udpSocket->async_send_to(asio::buffer(pMsg->GetData(), pMsg->GetSize()), endPt, [pMsg](std::error_code /*ec*/, std::size_t /*bytes*/) {
 				});
 			}
 			catch (std::exception ec)
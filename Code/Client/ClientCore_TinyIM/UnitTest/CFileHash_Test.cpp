@@ -0,0 +1,91 @@
+#include <doctest/doctest.h>
+#include "CFileHash.h"
+
+static std::string CalcHashOf(const FILE_HASH_TYPE eType, const std::string& strData)
+{
+	CFileHash hash(eType);
+	hash.Update(strData.data(), strData.length());
+	return hash.HexDigest();
+}
+
+TEST_CASE("FileHashVector") {
+	CHECK(CalcHashOf(FILE_HASH_TYPE::HASH_MD5, "abc") == "900150983cd24fb0d6963f7d28e17f72");
+	CHECK(CalcHashOf(FILE_HASH_TYPE::HASH_BLAKE2B, "") == "0e5751c026e543b2e8ab2eb06099daa1d1e5df47778f7787faab45cdf12fe3a8");
+	CHECK(CalcHashOf(FILE_HASH_TYPE::HASH_BLAKE2B, "abc") == "bddd813c634239723171ef3fee98579b94964e3bb1cb3e427262c8c068d52319");
+
+	//分多次添加的结果和一次添加相同,包括刚好是数据块整数倍的长度
+	std::string strData(256, 'a');
+	CFileHash hash(FILE_HASH_TYPE::HASH_BLAKE2B);
+	hash.Update(strData.data(), 100);
+	hash.Update(strData.data() + 100, 28);
+	hash.Update(strData.data() + 128, 128);
+	CHECK(hash.HexDigest() == CalcHashOf(FILE_HASH_TYPE::HASH_BLAKE2B, strData));
+
+	FILE_HASH_TYPE eType = FILE_HASH_TYPE::HASH_MD5;
+	CHECK(CFileHash::TypeOfHash(CalcHashOf(FILE_HASH_TYPE::HASH_BLAKE2B, "abc"), eType));
+	CHECK(eType == FILE_HASH_TYPE::HASH_BLAKE2B);
+	CHECK(CFileHash::TypeOfHash("900150983cd24fb0d6963f7d28e17f72", eType));
+	CHECK(eType == FILE_HASH_TYPE::HASH_MD5);
+	CHECK_FALSE(CFileHash::TypeOfHash("", eType));
+	CHECK(CFileHash::ParseType("blake2b", eType));
+	CHECK(eType == FILE_HASH_TYPE::HASH_BLAKE2B);
+	CHECK_FALSE(CFileHash::ParseType("sha1", eType));
+	CHECK(CFileHash::TypeName(FILE_HASH_TYPE::HASH_MD5) == "md5");
+}
+
+TEST_CASE("ChunkHashReorder") {
+	const std::string strChunk[4] = { "1111", "2222", "3333", "44" };
+	const std::string strAll = strChunk[0] + strChunk[1] + strChunk[2] + strChunk[3];
+
+	CChunkHash chunkHash(FILE_HASH_TYPE::HASH_BLAKE2B);
+	chunkHash.OnChunk(1, strChunk[0].data(), strChunk[0].length());
+	//乱序到达的数据包暂存
+	chunkHash.OnChunk(3, strChunk[2].data(), strChunk[2].length());
+	chunkHash.OnChunk(4, strChunk[3].data(), strChunk[3].length());
+	CHECK(chunkHash.HashedIndex() == 1);
+	CHECK(chunkHash.PendingCount() == 2);
+
+	//缺少数据包时没有结果
+	std::string strHash;
+	CHECK_FALSE(chunkHash.Finish(4, strHash));
+
+	//重复的数据包忽略
+	chunkHash.OnChunk(1, "xxxx", 4);
+	chunkHash.OnChunk(3, "xxxx", 4);
+	chunkHash.OnChunk(2, strChunk[1].data(), strChunk[1].length());
+	CHECK(chunkHash.HashedIndex() == 4);
+	CHECK(chunkHash.PendingCount() == 0);
+	REQUIRE(chunkHash.Finish(4, strHash));
+	CHECK(strHash == CalcHashOf(FILE_HASH_TYPE::HASH_BLAKE2B, strAll));
+
+	//空文件没有数据包
+	CChunkHash emptyHash;
+	REQUIRE(emptyHash.Finish(0, strHash));
+	CHECK(strHash == CalcHashOf(FILE_HASH_TYPE::HASH_MD5, ""));
+}
+
+TEST_CASE("FileHashDigestAndProof") {
+	const std::string strFileName = "FileHashProofTest.dat";
+	const std::string strData(100 * 1024, 'p');
+	std::FILE* pFile = std::fopen(strFileName.c_str(), "wb");
+	REQUIRE(pFile != nullptr);
+	std::fwrite(strData.data(), 1, strData.length(), pFile);
+	std::fclose(pFile);
+
+	//一次读取得到两种Hash
+	FileDigest_st digest;
+	REQUIRE(CFileHash::CalcFile(strFileName, digest));
+	CHECK(digest.m_strMd5 == CalcHashOf(FILE_HASH_TYPE::HASH_MD5, strData));
+	CHECK(digest.m_strBlake2b == CalcHashOf(FILE_HASH_TYPE::HASH_BLAKE2B, strData));
+	CHECK(digest.Of(FILE_HASH_TYPE::HASH_BLAKE2B) == digest.m_strBlake2b);
+
+	//证明和盐有关,不等于文件的Hash
+	std::string strProof = CFileHash::CalcProof(strFileName, "0011223344556677");
+	CHECK(strProof == CalcHashOf(FILE_HASH_TYPE::HASH_BLAKE2B, "0011223344556677" + strData));
+	CHECK(strProof != CFileHash::CalcProof(strFileName, "8899aabbccddeeff"));
+	CHECK(strProof != digest.m_strBlake2b);
+
+	std::remove(strFileName.c_str());
+	CHECK_FALSE(CFileHash::CalcFile(strFileName, digest));
+	CHECK(CFileHash::CalcProof(strFileName, "0011223344556677").empty());
+}
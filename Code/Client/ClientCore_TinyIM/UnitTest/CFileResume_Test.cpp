@@ -0,0 +1,71 @@
+#include <doctest/doctest.h>
+#include "CFileResume.h"
+
+TEST_CASE("FileResumeRanges") {
+	CFileResumeState state("00112233445566778899aabbccddeeff", "a.png", 1000, 100);
+	CHECK(state.TotalCount() == 10);
+	CHECK(state.MissingRanges() == std::vector<FILE_DATA_RANGE>({ { 1, 10 } }));
+	CHECK_FALSE(state.OnRecv(1));
+	CHECK_FALSE(state.OnRecv(1));
+	CHECK_FALSE(state.OnRecv(11));
+	state.OnRecv(2);
+	state.OnRecv(5);
+	state.OnRecv(10);
+	CHECK(state.RecvCount() == 4);
+	CHECK(state.MissingRanges() == std::vector<FILE_DATA_RANGE>({ { 3, 4 }, { 6, 9 } }));
+	//范围过多时剩下的全部发送
+	CHECK(state.MissingRanges(1) == std::vector<FILE_DATA_RANGE>({ { 3, 10 } }));
+
+	//数据包长度变大时,只保留覆盖的旧数据包全部收到的数据包
+	CFileResumeState bigState = state;
+	bigState.Rebase(200);
+	CHECK(bigState.TotalCount() == 5);
+	CHECK(bigState.MissingRanges() == std::vector<FILE_DATA_RANGE>({ { 2, 5 } }));
+	//数据包长度变小
+	CFileResumeState smallState = state;
+	smallState.Rebase(30);
+	CHECK(smallState.TotalCount() == 34);
+	CHECK(smallState.IsRecv(1));
+	CHECK(smallState.IsRecv(6));
+	CHECK_FALSE(smallState.IsRecv(7));
+	CHECK(smallState.IsRecv(34));
+}
+
+TEST_CASE("FileResumeSaveLoad") {
+	const std::string strPath = "FileResumeTest.resume";
+	CFileResumeState state("00112233445566778899aabbccddeeff", "a.png", 200000, 1000);
+	bool bNeedSave = false;
+	for (int i = 1; i <= CFileResumeState::SAVE_INTERVAL; i++)
+	{
+		bNeedSave = state.OnRecv(i * 2 - 1);
+	}
+	CHECK(bNeedSave);
+	REQUIRE(state.Save(strPath));
+	CHECK_FALSE(state.OnRecv(2));
+
+	CFileResumeState loadState;
+	REQUIRE(loadState.Load(strPath));
+	CHECK(loadState.IsMatch("00112233445566778899aabbccddeeff", 200000));
+	CHECK_FALSE(loadState.IsMatch("00112233445566778899aabbccddeeff", 200001));
+	CHECK(loadState.FileName() == "a.png");
+	CHECK(loadState.ChunkSize() == 1000);
+	CHECK(loadState.RecvCount() == CFileResumeState::SAVE_INTERVAL);
+	CHECK(loadState.IsRecv(127));
+	CHECK_FALSE(loadState.IsRecv(2));
+	CHECK_FALSE(loadState.IsRecv(129));
+
+	//内容不正确的文件不加载
+	std::FILE* pFile = std::fopen(strPath.c_str(), "wb");
+	REQUIRE(pFile != nullptr);
+	std::fputs("{\"FileHash\":\"00\",\"FileName\":\"a.png\",\"FileSize\":100,\"ChunkSize\":10,\"Bitmap\":\"0\"}", pFile);
+	std::fclose(pFile);
+	CHECK_FALSE(loadState.Load(strPath));
+	CHECK(loadState.FileName() == "a.png");
+	std::remove(strPath.c_str());
+	CHECK_FALSE(loadState.Load(strPath));
+
+	//状态文件名只由十六进制的Hash组成
+	CHECK(CFileResumeState::StateFileName("00112233445566778899AABBCCDDEEFF") == "00112233445566778899aabbccddeeff.resume");
+	CHECK(CFileResumeState::StateFileName("../../../../../../../etc/passwd").empty());
+	CHECK(CFileResumeState::StateFileName("").empty());
+}
@@ -0,0 +1,90 @@
+#include <doctest/doctest.h>
+#include "CFileTransWindow.h"
+
+TEST_CASE("FileSendWindowLimit") {
+	CFileSendWindow window(10, 4);
+	std::vector<int> sendVec;
+	int nIndex = 0;
+	while (window.NextSendIndex(nIndex))
+	{
+		sendVec.push_back(nIndex);
+	}
+	CHECK(sendVec == std::vector<int>({ 1, 2, 3, 4 }));
+	CHECK(window.InFlightCount() == 4);
+
+	//累计确认两个数据包,窗口滑动两个
+	CHECK(window.OnAck(2, 2));
+	CHECK(window.CumAckIndex() == 2);
+	CHECK(window.NextSendIndex(nIndex));
+	CHECK(nIndex == 5);
+	CHECK(window.NextSendIndex(nIndex));
+	CHECK(nIndex == 6);
+	CHECK_FALSE(window.NextSendIndex(nIndex));
+
+	//重复的确认
+	CHECK_FALSE(window.OnAck(2, 2));
+}
+
+TEST_CASE("FileSendWindowSelectiveAck") {
+	CFileSendWindow window(3, 8);
+	int nIndex = 0;
+	while (window.NextSendIndex(nIndex))
+	{
+	}
+	//乱序确认,数据包1还没有确认
+	CHECK(window.OnAck(0, 3));
+	CHECK(window.OnAck(0, 2));
+	CHECK(window.CumAckIndex() == 0);
+	CHECK_FALSE(window.IsFinished());
+
+	auto indexVec = window.TimeoutIndexes(std::chrono::milliseconds(0));
+	CHECK(indexVec == std::vector<int>({ 1 }));
+	CHECK(window.TimeoutRounds() == 1);
+
+	CHECK(window.OnAck(1, 1));
+	CHECK(window.CumAckIndex() == 3);
+	CHECK(window.IsFinished());
+	CHECK(window.TimeoutRounds() == 0);
+}
+
+TEST_CASE("FileRecvWindow") {
+	CFileRecvWindow window(4);
+	CHECK(window.OnRecv(2));
+	CHECK(window.CumAckIndex() == 0);
+	CHECK_FALSE(window.OnRecv(2));
+	CHECK_FALSE(window.OnRecv(5));
+	CHECK(window.OnRecv(1));
+	CHECK(window.CumAckIndex() == 2);
+	CHECK(window.OnRecv(4));
+	CHECK(window.OnRecv(3));
+	CHECK(window.CumAckIndex() == 4);
+	CHECK(window.IsFinished());
+}
+
+TEST_CASE("FileSendWindowResume") {
+	CFileSendWindow window(10, 4);
+	window.SetSendRanges({ { 3, 4 }, { 9, 9 } });
+	CHECK(window.CumAckIndex() == 2);
+	std::vector<int> sendVec;
+	int nIndex = 0;
+	while (window.NextSendIndex(nIndex))
+	{
+		sendVec.push_back(nIndex);
+	}
+	CHECK(sendVec == std::vector<int>({ 3, 4 }));
+
+	//接收端已经有的数据包直接当作已确认
+	CHECK(window.OnAck(4, 4));
+	CHECK(window.CumAckIndex() == 8);
+	CHECK(window.NextSendIndex(nIndex));
+	CHECK(nIndex == 9);
+	CHECK_FALSE(window.NextSendIndex(nIndex));
+	CHECK(window.OnAck(9, 9));
+	CHECK(window.IsFinished());
+
+	//接收端已经有全部数据包
+	CFileSendWindow fullWindow(5, 4);
+	fullWindow.SetSendRanges({});
+	CHECK_FALSE(fullWindow.NextSendIndex(nIndex));
+	CHECK(fullWindow.IsFinished());
+}
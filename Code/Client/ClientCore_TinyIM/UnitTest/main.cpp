@@ -4,6 +4,9 @@
 //#include "header.h"
 #include "TransBaseMessage_Test.cpp"
 #include "CFileUtil_Test.cpp"
+#include "CFileTransWindow_Test.cpp"
+#include "CFileHash_Test.cpp"
+#include "CFileResume_Test.cpp"
 #include "MsgSaveToDB_Test.cpp"
 int program();
 //void some_program_code(int argc, char** argv);
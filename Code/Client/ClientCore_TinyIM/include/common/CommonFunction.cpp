@@ -1,5 +1,6 @@
 
 #include "CommonFunction.h"
+#include <spdlog/async.h>
 
 #ifdef  _WIN32
 #include <windows.h>
@@ -205,7 +206,31 @@ std::shared_ptr<spdlog::logger> CreateLogger(json11::Json& cfg)
 	sinks.push_back(consoleSink);
     //sinks.push_back(sysLog);
 
-	auto combined_logger = std::make_shared<spdlog::logger>("T",begin(sinks),end(sinks));
+    //默认使用异步日志,格式化后的日志经有界队列交给后台线程写文件,界面和网络线程不等待磁盘
+    //logoverflow为block时队列满了等待,否则丢弃最旧的日志
+    std::shared_ptr<spdlog::logger> combined_logger;
+    bool bAsync = cfg["logasync"].is_number() ? (0 != cfg["logasync"].int_value()) : true;
+    if(bAsync)
+    {
+        std::size_t nQueueSize = 8192;
+        if(cfg["logqueuesize"].is_number() && cfg["logqueuesize"].int_value() > 0)
+        {
+            nQueueSize = static_cast<std::size_t>(cfg["logqueuesize"].int_value());
+        }
+        if(!spdlog::thread_pool())
+        {
+            spdlog::init_thread_pool(nQueueSize, 1);
+        }
+        auto overflow = ("block" == cfg["logoverflow"].string_value()) ? spdlog::async_overflow_policy::block : spdlog::async_overflow_policy::overrun_oldest;
+        combined_logger = std::make_shared<spdlog::async_logger>("T",begin(sinks),end(sinks),spdlog::thread_pool(),overflow);
+    }
+    else
+    {
+        combined_logger = std::make_shared<spdlog::logger>("T",begin(sinks),end(sinks));
+    }
+    //日志宏先按logger的级别过滤,关闭的级别不会计算参数
+    combined_logger->set_level(1 == debugOn ? spdlog::level::debug : spdlog::level::info);
+    combined_logger->flush_on(spdlog::level::err);
 	//spdlog::register_logger(combined_logger);
     return combined_logger;
 }
\ No newline at end of file
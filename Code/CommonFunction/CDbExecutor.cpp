@@ -0,0 +1,14 @@
+#include "CDbExecutor.h"
+
+std::string DbExecutorStat_st::ToString() const
+{
+	return "Queue:" + std::to_string(m_nQueueCount) +
+		" Post:" + std::to_string(m_nPostCount) +
+		" Done:" + std::to_string(m_nDoneCount) +
+		" Error:" + std::to_string(m_nErrorCount) +
+		" Slow:" + std::to_string(m_nSlowCount) +
+		" Ping:" + std::to_string(m_nPingCount) +
+		" PingFailed:" + std::to_string(m_nPingFailed) +
+		" MaxWait:" + std::to_string(m_nMaxWaitUs) + "us" +
+		" MaxExec:" + std::to_string(m_nMaxExecUs) + "us";
+}
@@ -0,0 +1,378 @@
+/**
+ * @file CDbExecutor.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 数据库执行器,每个工作线程独占一个数据库连接,阻塞的数据库操作不在网络线程上执行
+ * @version 0.1
+ * @date 2020-04-13
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_DB_EXECUTOR_H_
+#define _DENNIS_THINK_C_DB_EXECUTOR_H_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 数据库执行器的配置
+ *
+ */
+struct DbExecutorCfg_st
+{
+	std::size_t m_nWorkerCount = 4;//工作线程数,也是连接数
+	int m_nQueryTimeout = 5;//连接的读写超时(秒),由创建连接的函数设置
+	int m_nPingIntervalMs = 60000;//连接空闲超过该时间,使用前先检查连接
+	int m_nSlowQueryMs = 200;//执行超过该时间的操作记为慢查询
+};
+
+/**
+ * @brief 数据库执行器的统计
+ *
+ */
+struct DbExecutorStat_st
+{
+	std::size_t m_nQueueCount = 0;//当前排队的操作数
+	uint64_t m_nPostCount = 0;//投递的操作数
+	uint64_t m_nDoneCount = 0;//执行完的操作数
+	uint64_t m_nErrorCount = 0;//执行时抛出异常的操作数
+	uint64_t m_nSlowCount = 0;//慢查询的个数
+	uint64_t m_nPingCount = 0;//检查连接的次数
+	uint64_t m_nPingFailed = 0;//检查连接失败的次数
+	uint64_t m_nMaxWaitUs = 0;//最长排队时间
+	uint64_t m_nMaxExecUs = 0;//最长执行时间
+
+	std::string ToString() const;
+};
+
+/**
+ * @brief 数据库执行器,ConnT为数据库连接的类型
+ *
+ * 每个工作线程独占一个连接,操作按key分配到工作线程,key相同的操作在同一个连接上按投递顺序执行,
+ * 例如同一个用户的上线和下线状态更新。执行结果投递回调用者的strand,回调中可以直接访问业务数据:
+ *     m_dbExecutor.Post(strUserId, [](CMySqlConnect& util) { return util.IsUserExist(strUserId); },
+ *         m_strand, [this, pSelf](bool bExist) { ... });
+ */
+template<typename ConnT>
+class CDbExecutor
+{
+public:
+	using Clock = std::chrono::steady_clock;
+	using ConnPtr = std::shared_ptr<ConnT>;
+	using Task = std::function<void(ConnT&)>;
+
+	//创建连接,在调用Start的线程上执行
+	using ConnFactory = std::function<ConnPtr()>;
+
+	//在工作线程上检查连接,连接断开时重连,返回连接是否可用
+	using PingFunc = std::function<bool(ConnT&)>;
+
+	//工作线程开始和结束时调用,例如mysql_thread_init和mysql_thread_end
+	using ThreadHook = std::function<void()>;
+
+	CDbExecutor() = default;
+	CDbExecutor(const CDbExecutor&) = delete;
+	CDbExecutor& operator=(const CDbExecutor&) = delete;
+
+	~CDbExecutor()
+	{
+		Stop();
+	}
+
+	/**
+	 * @brief 创建连接并启动工作线程
+	 *
+	 * @param cfg 执行器配置
+	 * @param factory 创建连接的函数
+	 * @param ping 检查连接的函数
+	 * @param onThreadStart 工作线程开始时调用
+	 * @param onThreadStop 工作线程结束时调用
+	 * @return true 启动成功
+	 * @return false 已经启动或者创建连接失败
+	 */
+	bool Start(const DbExecutorCfg_st& cfg, ConnFactory factory, PingFunc ping, ThreadHook onThreadStart = nullptr, ThreadHook onThreadStop = nullptr)
+	{
+		if (!m_workerVec.empty() || !factory)
+		{
+			return false;
+		}
+		m_cfg = cfg;
+		m_ping = ping;
+		std::size_t nWorkerCount = cfg.m_nWorkerCount > 0 ? cfg.m_nWorkerCount : 1;
+		for (std::size_t i = 0; i < nWorkerCount; i++)
+		{
+			auto pConn = factory();
+			if (!pConn)
+			{
+				Stop();
+				return false;
+			}
+			std::unique_ptr<Worker_st> pWorker(new Worker_st());
+			pWorker->m_pConn = pConn;
+			pWorker->m_lastUse = Clock::now();
+			m_workerVec.push_back(std::move(pWorker));
+		}
+		for (auto& pWorker : m_workerVec)
+		{
+			Worker_st* pRaw = pWorker.get();
+			pRaw->m_thread = std::thread([this, pRaw, onThreadStart, onThreadStop]() {
+				if (onThreadStart)
+				{
+					onThreadStart();
+				}
+				WorkerLoop(*pRaw);
+				if (onThreadStop)
+				{
+					onThreadStop();
+				}
+			});
+		}
+		return true;
+	}
+
+	/**
+	 * @brief 停止工作线程,已经投递的操作执行完以后才退出
+	 *
+	 */
+	void Stop()
+	{
+		for (auto& pWorker : m_workerVec)
+		{
+			{
+				std::lock_guard<std::mutex> lock(pWorker->m_mutex);
+				pWorker->m_bStop = true;
+			}
+			pWorker->m_cond.notify_all();
+		}
+		for (auto& pWorker : m_workerVec)
+		{
+			if (pWorker->m_thread.joinable())
+			{
+				pWorker->m_thread.join();
+			}
+		}
+		m_workerVec.clear();
+	}
+
+	bool IsRunning() const
+	{
+		return !m_workerVec.empty();
+	}
+
+	std::size_t WorkerCount() const
+	{
+		return m_workerVec.size();
+	}
+
+	/**
+	 * @brief 投递一个不需要结果的操作
+	 *
+	 * @param strKey 分配工作线程的key,为空时轮流分配
+	 * @param task 在工作线程上执行的操作
+	 * @return true 投递成功
+	 * @return false 执行器没有启动
+	 */
+	bool Post(const std::string& strKey, Task task)
+	{
+		if (m_workerVec.empty())
+		{
+			return false;
+		}
+		std::size_t nIndex = 0;
+		if (strKey.empty())
+		{
+			nIndex = m_nNextWorker++ % m_workerVec.size();
+		}
+		else
+		{
+			nIndex = std::hash<std::string>()(strKey) % m_workerVec.size();
+		}
+		auto& worker = *m_workerVec[nIndex];
+		{
+			std::lock_guard<std::mutex> lock(worker.m_mutex);
+			worker.m_taskQueue.push_back(TaskItem_st{ std::move(task), Clock::now() });
+		}
+		worker.m_cond.notify_one();
+		{
+			std::lock_guard<std::mutex> lock(m_statMutex);
+			m_stat.m_nPostCount++;
+		}
+		return true;
+	}
+
+	/**
+	 * @brief 投递一个有结果的操作,结果通过executor的post回到调用者的线程或strand
+	 *
+	 * @param strKey 分配工作线程的key
+	 * @param query 在工作线程上执行,参数为(ConnT&),返回结果
+	 * @param executor 执行回调的对象,例如asio的strand
+	 * @param done 回调函数,参数为query的结果,query抛出异常时为Result的默认值
+	 * @return true 投递成功
+	 * @return false 执行器没有启动
+	 */
+	template<typename Query, typename Executor, typename Done>
+	bool Post(const std::string& strKey, Query query, Executor& executor, Done done)
+	{
+		using Result = decltype(query(std::declval<ConnT&>()));
+		auto pExecutor = &executor;
+		//done随结果一起移交给executor,工作线程不保留调用者的引用,调用者不会在工作线程上析构
+		return Post(strKey, Task([query, pExecutor, done](ConnT& conn) mutable {
+			auto pResult = std::make_shared<Result>();
+			try
+			{
+				*pResult = query(conn);
+			}
+			catch (std::exception&)
+			{
+				//出错时done收到默认构造的结果,调用者不会一直等待;异常继续抛出用于统计
+				pExecutor->post([done = std::move(done), pResult]() {
+					done(*pResult);
+				});
+				throw;
+			}
+			pExecutor->post([done = std::move(done), pResult]() {
+				done(*pResult);
+			});
+		}));
+	}
+
+	/**
+	 * @brief 获取统计数据
+	 *
+	 * @param bReset 获取以后是否清零,用于按周期输出
+	 */
+	DbExecutorStat_st Stat(const bool bReset = false)
+	{
+		std::size_t nQueueCount = 0;
+		for (auto& pWorker : m_workerVec)
+		{
+			std::lock_guard<std::mutex> lock(pWorker->m_mutex);
+			nQueueCount += pWorker->m_taskQueue.size();
+		}
+		std::lock_guard<std::mutex> lock(m_statMutex);
+		DbExecutorStat_st stat = m_stat;
+		stat.m_nQueueCount = nQueueCount;
+		if (bReset)
+		{
+			m_stat = DbExecutorStat_st();
+		}
+		return stat;
+	}
+private:
+	struct TaskItem_st
+	{
+		Task m_task;
+		Clock::time_point m_postTime;
+	};
+
+	struct Worker_st
+	{
+		std::thread m_thread;
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		std::deque<TaskItem_st> m_taskQueue;
+		bool m_bStop = false;
+		ConnPtr m_pConn;
+		Clock::time_point m_lastUse;//只在工作线程上访问
+	};
+
+	static uint64_t ElapseUs(const Clock::time_point begin, const Clock::time_point end)
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count());
+	}
+
+	void PingConn(Worker_st& worker)
+	{
+		if (!m_ping)
+		{
+			return;
+		}
+		bool bOk = m_ping(*worker.m_pConn);
+		worker.m_lastUse = Clock::now();
+		std::lock_guard<std::mutex> lock(m_statMutex);
+		m_stat.m_nPingCount++;
+		if (!bOk)
+		{
+			m_stat.m_nPingFailed++;
+		}
+	}
+
+	void WorkerLoop(Worker_st& worker)
+	{
+		auto pingInterval = std::chrono::milliseconds(m_cfg.m_nPingIntervalMs > 0 ? m_cfg.m_nPingIntervalMs : 60000);
+		while (true)
+		{
+			TaskItem_st item;
+			{
+				std::unique_lock<std::mutex> lock(worker.m_mutex);
+				worker.m_cond.wait_for(lock, pingInterval, [&worker]() {
+					return worker.m_bStop || !worker.m_taskQueue.empty();
+				});
+				if (worker.m_taskQueue.empty())
+				{
+					if (worker.m_bStop)
+					{
+						break;
+					}
+					//空闲时定期检查连接,避免被数据库服务器断开
+					lock.unlock();
+					PingConn(worker);
+					continue;
+				}
+				item = std::move(worker.m_taskQueue.front());
+				worker.m_taskQueue.pop_front();
+			}
+			auto begin = Clock::now();
+			if (begin - worker.m_lastUse >= pingInterval)
+			{
+				PingConn(worker);
+				begin = Clock::now();
+			}
+			bool bError = false;
+			try
+			{
+				item.m_task(*worker.m_pConn);
+			}
+			catch (std::exception&)
+			{
+				bError = true;
+			}
+			auto end = Clock::now();
+			worker.m_lastUse = end;
+			item.m_task = nullptr;
+
+			uint64_t nWaitUs = ElapseUs(item.m_postTime, begin);
+			uint64_t nExecUs = ElapseUs(begin, end);
+			std::lock_guard<std::mutex> lock(m_statMutex);
+			m_stat.m_nDoneCount++;
+			if (bError)
+			{
+				m_stat.m_nErrorCount++;
+			}
+			if (nExecUs >= static_cast<uint64_t>(m_cfg.m_nSlowQueryMs) * 1000)
+			{
+				m_stat.m_nSlowCount++;
+			}
+			m_stat.m_nMaxWaitUs = std::max(m_stat.m_nMaxWaitUs, nWaitUs);
+			m_stat.m_nMaxExecUs = std::max(m_stat.m_nMaxExecUs, nExecUs);
+		}
+	}
+
+	DbExecutorCfg_st m_cfg;
+	PingFunc m_ping;
+	std::vector<std::unique_ptr<Worker_st>> m_workerVec;
+	std::atomic<std::size_t> m_nNextWorker{ 0 };
+	std::mutex m_statMutex;
+	DbExecutorStat_st m_stat;
+};
+#endif
@@ -0,0 +1,324 @@
+#include "CFileHash.h"
+#include <cstdio>
+#include <cstring>
+
+static const uint64_t BLAKE2B_IV[8] = {
+	0x6A09E667F3BCC908ULL, 0xBB67AE8584CAA73BULL,
+	0x3C6EF372FE94F82BULL, 0xA54FF53A5F1D36F1ULL,
+	0x510E527FADE682D1ULL, 0x9B05688C2B3E6C1FULL,
+	0x1F83D9ABFB41BD6BULL, 0x5BE0CD19137E2179ULL,
+};
+
+static const uint8_t BLAKE2B_SIGMA[12][16] = {
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 },
+	{ 11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4 },
+	{ 7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8 },
+	{ 9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13 },
+	{ 2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9 },
+	{ 12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11 },
+	{ 13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10 },
+	{ 6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5 },
+	{ 10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 },
+};
+
+static inline uint64_t Rotr64(const uint64_t x, const int n)
+{
+	return (x >> n) | (x << (64 - n));
+}
+
+static inline uint64_t Load64(const unsigned char* p)
+{
+	uint64_t nValue = 0;
+	for (int i = 7; i >= 0; i--)
+	{
+		nValue = (nValue << 8) | p[i];
+	}
+	return nValue;
+}
+
+static inline void Blake2bG(uint64_t* v, const int a, const int b, const int c, const int d, const uint64_t x, const uint64_t y)
+{
+	v[a] = v[a] + v[b] + x;
+	v[d] = Rotr64(v[d] ^ v[a], 32);
+	v[c] = v[c] + v[d];
+	v[b] = Rotr64(v[b] ^ v[c], 24);
+	v[a] = v[a] + v[b] + y;
+	v[d] = Rotr64(v[d] ^ v[a], 16);
+	v[c] = v[c] + v[d];
+	v[b] = Rotr64(v[b] ^ v[c], 63);
+}
+
+CBlake2b::CBlake2b() :
+	m_nBlockLen(0)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		m_h[i] = BLAKE2B_IV[i];
+	}
+	//参数块:摘要长度32字节,没有密钥,fanout和depth为1
+	m_h[0] ^= 0x01010000ULL ^ DIGEST_SIZE;
+	m_t[0] = 0;
+	m_t[1] = 0;
+	std::memset(m_block, 0, sizeof(m_block));
+}
+
+/**
+ * @brief 压缩m_block中的一个数据块,调用前已经把数据块的长度计入m_t
+ *
+ * @param bLast 是否为最后一块
+ */
+void CBlake2b::Compress(const bool bLast)
+{
+	uint64_t v[16];
+	uint64_t m[16];
+	for (int i = 0; i < 8; i++)
+	{
+		v[i] = m_h[i];
+		v[i + 8] = BLAKE2B_IV[i];
+	}
+	v[12] ^= m_t[0];
+	v[13] ^= m_t[1];
+	if (bLast)
+	{
+		v[14] = ~v[14];
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		m[i] = Load64(m_block + 8 * i);
+	}
+	for (int i = 0; i < 12; i++)
+	{
+		const uint8_t* s = BLAKE2B_SIGMA[i];
+		Blake2bG(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+		Blake2bG(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+		Blake2bG(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+		Blake2bG(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+		Blake2bG(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+		Blake2bG(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+		Blake2bG(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+		Blake2bG(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+	}
+	for (int i = 0; i < 8; i++)
+	{
+		m_h[i] ^= v[i] ^ v[i + 8];
+	}
+}
+
+/**
+ * @brief 添加数据,m_block满了并且还有后续数据时才压缩,保证最后一块留到Final
+ *
+ */
+void CBlake2b::Update(const unsigned char* pData, std::size_t nLen)
+{
+	while (nLen > 0)
+	{
+		if (m_nBlockLen == BLOCK_SIZE)
+		{
+			m_t[0] += BLOCK_SIZE;
+			if (m_t[0] < BLOCK_SIZE)
+			{
+				m_t[1]++;
+			}
+			Compress(false);
+			m_nBlockLen = 0;
+		}
+		std::size_t nCopy = BLOCK_SIZE - m_nBlockLen;
+		if (nCopy > nLen)
+		{
+			nCopy = nLen;
+		}
+		std::memcpy(m_block + m_nBlockLen, pData, nCopy);
+		m_nBlockLen += nCopy;
+		pData += nCopy;
+		nLen -= nCopy;
+	}
+}
+
+void CBlake2b::Final(unsigned char* pDigest)
+{
+	m_t[0] += m_nBlockLen;
+	if (m_t[0] < m_nBlockLen)
+	{
+		m_t[1]++;
+	}
+	std::memset(m_block + m_nBlockLen, 0, BLOCK_SIZE - m_nBlockLen);
+	Compress(true);
+	for (std::size_t i = 0; i < DIGEST_SIZE; i++)
+	{
+		pDigest[i] = static_cast<unsigned char>(m_h[i / 8] >> (8 * (i % 8)));
+	}
+}
+
+CFileHash::CFileHash(const FILE_HASH_TYPE eType) :
+	m_eType(eType)
+{
+}
+
+void CFileHash::Update(const char* pData, const std::size_t nLen)
+{
+	if (FILE_HASH_TYPE::HASH_BLAKE2B == m_eType)
+	{
+		m_blake2b.Update(reinterpret_cast<const unsigned char*>(pData), nLen);
+	}
+	else
+	{
+		m_md5.update(pData, static_cast<MD5::size_type>(nLen));
+	}
+}
+
+std::string CFileHash::HexDigest()
+{
+	if (FILE_HASH_TYPE::HASH_BLAKE2B == m_eType)
+	{
+		static const char HEX_CHARS[] = "0123456789abcdef";
+		unsigned char digest[CBlake2b::DIGEST_SIZE] = { 0 };
+		m_blake2b.Final(digest);
+		std::string strResult;
+		for (std::size_t i = 0; i < CBlake2b::DIGEST_SIZE; i++)
+		{
+			strResult.push_back(HEX_CHARS[digest[i] >> 4]);
+			strResult.push_back(HEX_CHARS[digest[i] & 0x0F]);
+		}
+		return strResult;
+	}
+	return m_md5.finalize().hexdigest();
+}
+
+bool CFileHash::TypeOfHash(const std::string& strHash, FILE_HASH_TYPE& eType)
+{
+	if (strHash.length() == 2 * CBlake2b::DIGEST_SIZE)
+	{
+		eType = FILE_HASH_TYPE::HASH_BLAKE2B;
+		return true;
+	}
+	if (strHash.length() == 32)
+	{
+		eType = FILE_HASH_TYPE::HASH_MD5;
+		return true;
+	}
+	return false;
+}
+
+bool CFileHash::ParseType(const std::string& strName, FILE_HASH_TYPE& eType)
+{
+	if (strName == "md5")
+	{
+		eType = FILE_HASH_TYPE::HASH_MD5;
+		return true;
+	}
+	if (strName == "blake2b")
+	{
+		eType = FILE_HASH_TYPE::HASH_BLAKE2B;
+		return true;
+	}
+	return false;
+}
+
+std::string CFileHash::TypeName(const FILE_HASH_TYPE eType)
+{
+	return FILE_HASH_TYPE::HASH_BLAKE2B == eType ? "blake2b" : "md5";
+}
+
+std::string CFileHash::CalcFile(const std::string& strFileName, const FILE_HASH_TYPE eType)
+{
+	std::FILE* pFile = std::fopen(strFileName.c_str(), "rb");
+	if (nullptr == pFile)
+	{
+		return "";
+	}
+	CFileHash hash(eType);
+	std::vector<char> buff(64 * 1024);
+	std::size_t nReadLen = 0;
+	while ((nReadLen = std::fread(buff.data(), 1, buff.size(), pFile)) > 0)
+	{
+		hash.Update(buff.data(), nReadLen);
+	}
+	std::fclose(pFile);
+	return hash.HexDigest();
+}
+
+bool CFileHash::CalcFile(const std::string& strFileName, FileDigest_st& digest)
+{
+	std::FILE* pFile = std::fopen(strFileName.c_str(), "rb");
+	if (nullptr == pFile)
+	{
+		return false;
+	}
+	CFileHash md5Hash(FILE_HASH_TYPE::HASH_MD5);
+	CFileHash blake2bHash(FILE_HASH_TYPE::HASH_BLAKE2B);
+	std::vector<char> buff(64 * 1024);
+	std::size_t nReadLen = 0;
+	while ((nReadLen = std::fread(buff.data(), 1, buff.size(), pFile)) > 0)
+	{
+		md5Hash.Update(buff.data(), nReadLen);
+		blake2bHash.Update(buff.data(), nReadLen);
+	}
+	std::fclose(pFile);
+	digest.m_strMd5 = md5Hash.HexDigest();
+	digest.m_strBlake2b = blake2bHash.HexDigest();
+	return true;
+}
+
+std::string CFileHash::CalcProof(const std::string& strFileName, const std::string& strSalt)
+{
+	std::FILE* pFile = std::fopen(strFileName.c_str(), "rb");
+	if (nullptr == pFile)
+	{
+		return "";
+	}
+	CFileHash hash(FILE_HASH_TYPE::HASH_BLAKE2B);
+	hash.Update(strSalt.data(), strSalt.length());
+	std::vector<char> buff(64 * 1024);
+	std::size_t nReadLen = 0;
+	while ((nReadLen = std::fread(buff.data(), 1, buff.size(), pFile)) > 0)
+	{
+		hash.Update(buff.data(), nReadLen);
+	}
+	std::fclose(pFile);
+	return hash.HexDigest();
+}
+
+CChunkHash::CChunkHash(const FILE_HASH_TYPE eType) :
+	m_hash(eType),
+	m_nHashedIndex(0)
+{
+}
+
+void CChunkHash::OnChunk(const int nIndex, const char* pData, const std::size_t nLen)
+{
+	if (nIndex <= m_nHashedIndex)
+	{
+		return;
+	}
+	if (nIndex > m_nHashedIndex + 1)
+	{
+		if (m_pendingMap.find(nIndex) == m_pendingMap.end())
+		{
+			m_pendingMap[nIndex].assign(pData, pData + nLen);
+		}
+		return;
+	}
+	m_hash.Update(pData, nLen);
+	m_nHashedIndex = nIndex;
+	//前面的数据包到达以后,计算暂存的连续数据包
+	auto item = m_pendingMap.begin();
+	while (item != m_pendingMap.end() && item->first == m_nHashedIndex + 1)
+	{
+		m_hash.Update(item->second.data(), item->second.size());
+		m_nHashedIndex = item->first;
+		item = m_pendingMap.erase(item);
+	}
+}
+
+bool CChunkHash::Finish(const int nTotalCount, std::string& strHash)
+{
+	if (m_nHashedIndex != nTotalCount || !m_pendingMap.empty())
+	{
+		return false;
+	}
+	strHash = m_hash.HexDigest();
+	return true;
+}
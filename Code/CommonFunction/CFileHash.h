@@ -0,0 +1,149 @@
+/**
+ * @file CFileHash.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 文件Hash的流式计算,传输过程中按数据包更新,传输完成时直接得到结果
+ * @version 0.1
+ * @date 2020-05-30
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_FILE_HASH_H_
+#define _DENNIS_THINK_C_FILE_HASH_H_
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "md5.h"
+
+/**
+ * @brief 文件Hash的算法,Hash的十六进制字符串长度不同,由长度可以判断算法
+ *
+ */
+enum class FILE_HASH_TYPE
+{
+	HASH_MD5,//32个字符,旧版本的客户端和服务器只支持MD5
+	HASH_BLAKE2B,//BLAKE2b-256,64个字符,比MD5快并且没有已知的碰撞
+};
+
+/**
+ * @brief BLAKE2b-256,按RFC 7693实现,不使用密钥
+ *
+ */
+class CBlake2b
+{
+public:
+	static const std::size_t DIGEST_SIZE = 32;
+	static const std::size_t BLOCK_SIZE = 128;
+
+	CBlake2b();
+
+	void Update(const unsigned char* pData, std::size_t nLen);
+
+	void Final(unsigned char* pDigest);
+private:
+	void Compress(const bool bLast);
+
+	uint64_t m_h[8];
+	uint64_t m_t[2];//已经压缩的字节数
+	unsigned char m_block[BLOCK_SIZE];
+	std::size_t m_nBlockLen;//m_block中的字节数,最后一块在Final时压缩
+};
+
+/**
+ * @brief 同一个文件的两种Hash,读取一次文件同时计算
+ *
+ */
+struct FileDigest_st
+{
+	std::string m_strMd5;
+	std::string m_strBlake2b;
+
+	const std::string& Of(const FILE_HASH_TYPE eType) const
+	{
+		return FILE_HASH_TYPE::HASH_BLAKE2B == eType ? m_strBlake2b : m_strMd5;
+	}
+};
+
+/**
+ * @brief 流式计算一个文件的Hash
+ *
+ */
+class CFileHash
+{
+public:
+	explicit CFileHash(const FILE_HASH_TYPE eType = FILE_HASH_TYPE::HASH_MD5);
+
+	FILE_HASH_TYPE Type() const { return m_eType; }
+
+	void Update(const char* pData, const std::size_t nLen);
+
+	//计算结果,之后不能再Update
+	std::string HexDigest();
+
+	//根据Hash字符串的长度判断算法
+	static bool TypeOfHash(const std::string& strHash, FILE_HASH_TYPE& eType);
+
+	//配置文件中的算法名称,"md5"或者"blake2b"
+	static bool ParseType(const std::string& strName, FILE_HASH_TYPE& eType);
+	static std::string TypeName(const FILE_HASH_TYPE eType);
+
+	//读取整个文件计算Hash,文件不存在时返回空字符串
+	static std::string CalcFile(const std::string& strFileName, const FILE_HASH_TYPE eType);
+
+	//读取一次文件计算MD5和BLAKE2b,文件不存在时返回false
+	static bool CalcFile(const std::string& strFileName, FileDigest_st& digest);
+
+	/**
+	 * @brief 持有文件内容的证明,BLAKE2b(盐 + 文件内容)
+	 *
+	 * 盐由服务器为每次秒传随机生成,只知道文件Hash无法算出证明
+	 * @param strFileName 文件
+	 * @param strSalt 服务器生成的盐
+	 * @return std::string 证明的十六进制字符串,文件不存在时返回空字符串
+	 */
+	static std::string CalcProof(const std::string& strFileName, const std::string& strSalt);
+private:
+	FILE_HASH_TYPE m_eType;
+	MD5 m_md5;
+	CBlake2b m_blake2b;
+};
+
+/**
+ * @brief 按数据包索引更新文件的Hash,数据包索引从1开始,与FileDataSendReqMsg::m_nDataIndex一致
+ *
+ * 数据包按索引顺序计算。乱序到达的数据包复制一份暂存,前面的数据包全部到达以后再计算,
+ * 暂存的数据包个数不超过传输窗口的大小。重复的数据包忽略。
+ */
+class CChunkHash
+{
+public:
+	explicit CChunkHash(const FILE_HASH_TYPE eType = FILE_HASH_TYPE::HASH_MD5);
+
+	FILE_HASH_TYPE Type() const { return m_hash.Type(); }
+
+	void OnChunk(const int nIndex, const char* pData, const std::size_t nLen);
+
+	//已经计算到的连续数据包索引
+	int HashedIndex() const { return m_nHashedIndex; }
+
+	//暂存的乱序数据包个数
+	std::size_t PendingCount() const { return m_pendingMap.size(); }
+
+	/**
+	 * @brief 计算结果,之后不能再更新
+	 *
+	 * @param nTotalCount 文件的数据包总数
+	 * @param strHash 文件的Hash
+	 * @return true 所有数据包都已经计算
+	 * @return false 还有数据包没有到达,调用者需要读取文件计算
+	 */
+	bool Finish(const int nTotalCount, std::string& strHash);
+private:
+	CFileHash m_hash;
+	int m_nHashedIndex;
+	std::map<int, std::vector<char>> m_pendingMap;
+};
+#endif
@@ -0,0 +1,358 @@
+#include "CFileIoEngine.h"
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+std::string FileIoStat_st::ToString() const
+{
+	return "Queue:" + std::to_string(m_nQueueCount) +
+		" Open:" + std::to_string(m_nOpenCount) +
+		" Post:" + std::to_string(m_nPostCount) +
+		" Done:" + std::to_string(m_nDoneCount) +
+		" Fail:" + std::to_string(m_nFailCount) +
+		" Slow:" + std::to_string(m_nSlowCount) +
+		" MaxWait:" + std::to_string(m_nMaxWaitUs) + "us" +
+		" MaxExec:" + std::to_string(m_nMaxExecUs) + "us";
+}
+
+CIoFile::~CIoFile()
+{
+#ifdef _WIN32
+	if (nullptr != m_pFile)
+	{
+		fclose(m_pFile);
+	}
+#else
+	if (m_nFd >= 0)
+	{
+		close(m_nFd);
+	}
+#endif
+}
+
+std::shared_ptr<CIoFile> CIoFile::Open(const std::string& strFileName, const FILE_OPEN_MODE eMode)
+{
+	std::shared_ptr<CIoFile> pFile(new CIoFile());
+	pFile->m_strFileName = strFileName;
+#ifdef _WIN32
+	const char* szMode = "rb";
+	if (FILE_OPEN_MODE::OPEN_WRITE == eMode)
+	{
+		std::FILE* pExist = nullptr;
+		fopen_s(&pExist, strFileName.c_str(), "rb");
+		if (nullptr != pExist)
+		{
+			fclose(pExist);
+			return nullptr;
+		}
+		szMode = "w+b";
+	}
+	else if (FILE_OPEN_MODE::OPEN_RESUME == eMode)
+	{
+		//r+b不能新建文件,先以追加方式创建
+		std::FILE* pCreate = nullptr;
+		fopen_s(&pCreate, strFileName.c_str(), "ab");
+		if (nullptr != pCreate)
+		{
+			fclose(pCreate);
+		}
+		szMode = "r+b";
+	}
+	fopen_s(&pFile->m_pFile, strFileName.c_str(), szMode);
+	if (nullptr == pFile->m_pFile)
+	{
+		return nullptr;
+	}
+#else
+	int nFlags = O_RDONLY;
+	if (FILE_OPEN_MODE::OPEN_WRITE == eMode)
+	{
+		nFlags = O_RDWR | O_CREAT | O_EXCL;
+	}
+	else if (FILE_OPEN_MODE::OPEN_RESUME == eMode)
+	{
+		nFlags = O_RDWR | O_CREAT;
+	}
+	pFile->m_nFd = open(strFileName.c_str(), nFlags | O_CLOEXEC, 0644);
+	if (pFile->m_nFd < 0)
+	{
+		return nullptr;
+	}
+#endif
+	return pFile;
+}
+
+bool CIoFile::WriteAt(const int64_t nOffset, const char* pData, const std::size_t nLen)
+{
+	if (nOffset < 0)
+	{
+		return false;
+	}
+#ifdef _WIN32
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (_fseeki64(m_pFile, nOffset, SEEK_SET) != 0)
+	{
+		return false;
+	}
+	return fwrite(pData, 1, nLen, m_pFile) == nLen;
+#else
+	std::size_t nWriteLen = 0;
+	while (nWriteLen < nLen)
+	{
+		ssize_t nRet = pwrite(m_nFd, pData + nWriteLen, nLen - nWriteLen, static_cast<off_t>(nOffset + static_cast<int64_t>(nWriteLen)));
+		if (nRet < 0)
+		{
+			if (EINTR == errno)
+			{
+				continue;
+			}
+			return false;
+		}
+		nWriteLen += static_cast<std::size_t>(nRet);
+	}
+	return true;
+#endif
+}
+
+bool CIoFile::ReadAt(const int64_t nOffset, char* pData, const std::size_t nMaxLen, std::size_t& nReadLen)
+{
+	nReadLen = 0;
+	if (nOffset < 0)
+	{
+		return false;
+	}
+#ifdef _WIN32
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (_fseeki64(m_pFile, nOffset, SEEK_SET) != 0)
+	{
+		return false;
+	}
+	nReadLen = fread(pData, 1, nMaxLen, m_pFile);
+#else
+	while (nReadLen < nMaxLen)
+	{
+		ssize_t nRet = pread(m_nFd, pData + nReadLen, nMaxLen - nReadLen, static_cast<off_t>(nOffset + static_cast<int64_t>(nReadLen)));
+		if (nRet < 0)
+		{
+			if (EINTR == errno)
+			{
+				continue;
+			}
+			return false;
+		}
+		if (0 == nRet)
+		{
+			break;
+		}
+		nReadLen += static_cast<std::size_t>(nRet);
+	}
+#endif
+	return nReadLen > 0;
+}
+
+#ifdef __linux__
+int64_t CIoFile::SendTo(const int nSocket, int64_t& nOffset, const std::size_t nMaxLen)
+{
+	while (true)
+	{
+		off_t nPos = static_cast<off_t>(nOffset);
+		ssize_t nRet = sendfile(nSocket, m_nFd, &nPos, nMaxLen);
+		if (nRet < 0 && EINTR == errno)
+		{
+			continue;
+		}
+		if (nRet > 0)
+		{
+			nOffset = static_cast<int64_t>(nPos);
+		}
+		return static_cast<int64_t>(nRet);
+	}
+}
+#endif
+
+bool CFileIoEngine::Start(const FileIoEngineCfg_st& cfg)
+{
+	if (!m_workerVec.empty())
+	{
+		return false;
+	}
+	m_cfg = cfg;
+	for (std::size_t i = 0; i < cfg.m_nWorkerCount; i++)
+	{
+		m_workerVec.push_back(std::unique_ptr<Worker_st>(new Worker_st()));
+	}
+	for (auto& pWorker : m_workerVec)
+	{
+		Worker_st* pRaw = pWorker.get();
+		pRaw->m_thread = std::thread([this, pRaw]() {
+			WorkerLoop(*pRaw);
+		});
+	}
+	return !m_workerVec.empty();
+}
+
+void CFileIoEngine::Stop()
+{
+	for (auto& pWorker : m_workerVec)
+	{
+		{
+			std::lock_guard<std::mutex> lock(pWorker->m_mutex);
+			pWorker->m_bStop = true;
+		}
+		pWorker->m_cond.notify_all();
+	}
+	for (auto& pWorker : m_workerVec)
+	{
+		if (pWorker->m_thread.joinable())
+		{
+			pWorker->m_thread.join();
+		}
+	}
+	m_workerVec.clear();
+}
+
+bool CFileIoEngine::Open(const int nFileId, const std::string& strFileName, const FILE_OPEN_MODE eMode)
+{
+	Close(nFileId);
+	auto pFile = CIoFile::Open(strFileName, eMode);
+	if (!pFile)
+	{
+		return false;
+	}
+	m_fileMap.insert({ nFileId, pFile });
+	return true;
+}
+
+bool CFileIoEngine::Close(const int nFileId)
+{
+	//投递时已经取得文件的操作还持有引用,执行完以后关闭
+	return m_fileMap.erase(nFileId) > 0;
+}
+
+bool CFileIoEngine::IsOpen(const int nFileId) const
+{
+	return m_fileMap.find(nFileId) != m_fileMap.end();
+}
+
+std::string CFileIoEngine::FileName(const int nFileId) const
+{
+	auto item = m_fileMap.find(nFileId);
+	if (item != m_fileMap.end())
+	{
+		return item->second->FileName();
+	}
+	return "";
+}
+
+std::shared_ptr<CIoFile> CFileIoEngine::FindFile(const int nFileId) const
+{
+	auto item = m_fileMap.find(nFileId);
+	if (item != m_fileMap.end())
+	{
+		return item->second;
+	}
+	return nullptr;
+}
+
+void CFileIoEngine::Post(const int nFileId, Task task)
+{
+	TaskItem_st item{ std::move(task), Clock::now() };
+	{
+		std::lock_guard<std::mutex> lock(m_statMutex);
+		m_stat.m_nPostCount++;
+	}
+	if (m_workerVec.empty())
+	{
+		RunTask(item);
+		return;
+	}
+	//同一个文件的操作在同一个工作线程上按顺序执行
+	auto& worker = *m_workerVec[static_cast<unsigned int>(nFileId) % m_workerVec.size()];
+	{
+		std::lock_guard<std::mutex> lock(worker.m_mutex);
+		worker.m_taskQueue.push_back(std::move(item));
+	}
+	worker.m_cond.notify_one();
+}
+
+FileIoStat_st CFileIoEngine::Stat(const bool bReset)
+{
+	std::size_t nQueueCount = 0;
+	for (auto& pWorker : m_workerVec)
+	{
+		std::lock_guard<std::mutex> lock(pWorker->m_mutex);
+		nQueueCount += pWorker->m_taskQueue.size();
+	}
+	std::lock_guard<std::mutex> lock(m_statMutex);
+	FileIoStat_st stat = m_stat;
+	stat.m_nQueueCount = nQueueCount;
+	stat.m_nOpenCount = m_fileMap.size();
+	if (bReset)
+	{
+		m_stat = FileIoStat_st();
+	}
+	return stat;
+}
+
+void CFileIoEngine::CountIo(const bool bOk)
+{
+	if (!bOk)
+	{
+		std::lock_guard<std::mutex> lock(m_statMutex);
+		m_stat.m_nFailCount++;
+	}
+}
+
+void CFileIoEngine::RunTask(TaskItem_st& item)
+{
+	auto begin = Clock::now();
+	try
+	{
+		item.m_task();
+	}
+	catch (std::exception&)
+	{
+		//有结果的操作在抛出前已经把默认的结果交给了回调
+		CountIo(false);
+	}
+	auto end = Clock::now();
+	item.m_task = nullptr;
+
+	uint64_t nWaitUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(begin - item.m_postTime).count());
+	uint64_t nExecUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count());
+	std::lock_guard<std::mutex> lock(m_statMutex);
+	m_stat.m_nDoneCount++;
+	if (nExecUs >= static_cast<uint64_t>(m_cfg.m_nSlowIoMs) * 1000)
+	{
+		m_stat.m_nSlowCount++;
+	}
+	m_stat.m_nMaxWaitUs = std::max(m_stat.m_nMaxWaitUs, nWaitUs);
+	m_stat.m_nMaxExecUs = std::max(m_stat.m_nMaxExecUs, nExecUs);
+}
+
+void CFileIoEngine::WorkerLoop(Worker_st& worker)
+{
+	while (true)
+	{
+		TaskItem_st item;
+		{
+			std::unique_lock<std::mutex> lock(worker.m_mutex);
+			worker.m_cond.wait(lock, [&worker]() {
+				return worker.m_bStop || !worker.m_taskQueue.empty();
+			});
+			if (worker.m_taskQueue.empty())
+			{
+				break;
+			}
+			item = std::move(worker.m_taskQueue.front());
+			worker.m_taskQueue.pop_front();
+		}
+		RunTask(item);
+	}
+}
@@ -0,0 +1,317 @@
+/**
+ * @file CFileIoEngine.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 文件读写线程池,按文件ID分配工作线程,在指定位置读写,阻塞的磁盘操作不在网络线程上执行
+ * @version 0.1
+ * @date 2020-06-13
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_FILE_IO_ENGINE_H_
+#define _DENNIS_THINK_C_FILE_IO_ENGINE_H_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 打开文件的方式
+ *
+ */
+enum class FILE_OPEN_MODE
+{
+	OPEN_READ,//只读
+	OPEN_WRITE,//新建文件,文件已经存在时失败
+	OPEN_RESUME,//读写,保留已有的内容,文件不存在时新建,用于断点续传
+};
+
+/**
+ * @brief 文件读写线程池的配置
+ *
+ */
+struct FileIoEngineCfg_st
+{
+	std::size_t m_nWorkerCount = 2;//工作线程数,0表示在调用线程上读写
+	int m_nSlowIoMs = 100;//执行超过该时间的操作记为慢操作
+};
+
+/**
+ * @brief 文件读写线程池的统计
+ *
+ */
+struct FileIoStat_st
+{
+	std::size_t m_nQueueCount = 0;//当前排队的操作数
+	std::size_t m_nOpenCount = 0;//打开的文件数
+	uint64_t m_nPostCount = 0;//投递的操作数
+	uint64_t m_nDoneCount = 0;//执行完的操作数
+	uint64_t m_nFailCount = 0;//读写失败的次数
+	uint64_t m_nSlowCount = 0;//慢操作的个数
+	uint64_t m_nMaxWaitUs = 0;//最长排队时间
+	uint64_t m_nMaxExecUs = 0;//最长执行时间
+
+	std::string ToString() const;
+};
+
+/**
+ * @brief 一个打开的文件,按位置读写,不移动共享的文件位置,最后一个引用释放时关闭
+ *
+ */
+class CIoFile
+{
+public:
+	~CIoFile();
+	CIoFile(const CIoFile&) = delete;
+	CIoFile& operator=(const CIoFile&) = delete;
+
+	//打开失败时返回空指针
+	static std::shared_ptr<CIoFile> Open(const std::string& strFileName, const FILE_OPEN_MODE eMode);
+
+	bool WriteAt(const int64_t nOffset, const char* pData, const std::size_t nLen);
+
+	/**
+	 * @brief 从指定位置读取数据
+	 *
+	 * @param nOffset 读取的位置
+	 * @param pData 读取到的数据
+	 * @param nMaxLen 最多读取的长度
+	 * @param nReadLen 实际读取的长度,到达文件末尾时小于nMaxLen
+	 * @return true 读取到数据
+	 * @return false 读取失败或者已经到达文件末尾
+	 */
+	bool ReadAt(const int64_t nOffset, char* pData, const std::size_t nMaxLen, std::size_t& nReadLen);
+
+#ifdef __linux__
+	/**
+	 * @brief 用sendfile把文件数据直接写入socket,数据不经过用户空间
+	 *
+	 * @param nSocket 非阻塞的socket
+	 * @param nOffset 读取的位置,返回时移动到已经发送的数据之后
+	 * @param nMaxLen 最多发送的长度
+	 * @return int64_t 发送的长度,0表示已经到达文件末尾,-1表示失败,errno为EAGAIN时socket缓冲区已满
+	 */
+	int64_t SendTo(const int nSocket, int64_t& nOffset, const std::size_t nMaxLen);
+#endif
+
+	const std::string& FileName() const { return m_strFileName; }
+private:
+	CIoFile() = default;
+
+	std::string m_strFileName;
+#ifdef _WIN32
+	std::FILE* m_pFile = nullptr;
+	std::mutex m_mutex;//没有pread和pwrite,定位和读写一起加锁
+#else
+	int m_nFd = -1;
+#endif
+};
+
+/**
+ * @brief 文件读写线程池
+ *
+ * 同一个文件的操作分配到同一个工作线程,按投递顺序执行,因此关闭文件以后投递的操作
+ * 一定在之前的写入完成以后执行。读写的结果投递回调用者的strand:
+ *     m_fileIo.WriteAt(nFileId, nOffset, std::move(dataVec), m_strand, [this, pSelf](bool bOk) { ... });
+ * Open和Close只在调用者的strand上调用,工作线程只访问投递时取得的文件。
+ */
+class CFileIoEngine
+{
+public:
+	using Clock = std::chrono::steady_clock;
+	using Task = std::function<void()>;
+
+	CFileIoEngine() = default;
+	CFileIoEngine(const CFileIoEngine&) = delete;
+	CFileIoEngine& operator=(const CFileIoEngine&) = delete;
+
+	~CFileIoEngine()
+	{
+		Stop();
+	}
+
+	//启动工作线程,工作线程数为0时不启动,所有操作在调用线程上执行
+	bool Start(const FileIoEngineCfg_st& cfg);
+
+	//停止工作线程,已经投递的操作执行完以后才退出
+	void Stop();
+
+	bool IsRunning() const
+	{
+		return !m_workerVec.empty();
+	}
+
+	std::size_t WorkerCount() const
+	{
+		return m_workerVec.size();
+	}
+
+	//打开文件,同一个文件ID已经打开的文件先关闭
+	bool Open(const int nFileId, const std::string& strFileName, const FILE_OPEN_MODE eMode);
+
+	//关闭文件,已经投递的读写完成以后才真正关闭
+	bool Close(const int nFileId);
+
+	bool IsOpen(const int nFileId) const;
+
+	std::string FileName(const int nFileId) const;
+
+	//获取打开的文件,用于在线程池以外直接读取,文件没有打开时返回空指针
+	std::shared_ptr<CIoFile> FindFile(const int nFileId) const;
+
+	/**
+	 * @brief 在文件的工作线程上执行操作,与该文件的读写按投递顺序执行
+	 *
+	 * @param nFileId 文件ID
+	 * @param task 操作
+	 */
+	void Post(const int nFileId, Task task);
+
+	/**
+	 * @brief 在文件的工作线程上执行有结果的操作,结果通过executor的post回到调用者的strand
+	 *
+	 * @param nFileId 文件ID
+	 * @param query 在工作线程上执行,返回结果
+	 * @param executor 执行回调的对象,例如asio的strand
+	 * @param done 回调函数,参数为query的结果,query抛出异常时为Result的默认值
+	 */
+	template<typename Query, typename Executor, typename Done>
+	void Post(const int nFileId, Query query, Executor& executor, Done done)
+	{
+		using Result = decltype(query());
+		auto pExecutor = &executor;
+		Post(nFileId, Task([query, pExecutor, done]() mutable {
+			auto pResult = std::make_shared<Result>();
+			try
+			{
+				*pResult = query();
+			}
+			catch (std::exception&)
+			{
+				//出错时done收到默认构造的结果,调用者不会一直等待;异常继续抛出用于统计
+				pExecutor->post([done = std::move(done), pResult]() {
+					done(*pResult);
+				});
+				throw;
+			}
+			pExecutor->post([done = std::move(done), pResult]() {
+				done(*pResult);
+			});
+		}));
+	}
+
+	/**
+	 * @brief 在指定位置写入数据,数据包可以乱序写入
+	 *
+	 * @param nFileId 文件ID
+	 * @param nOffset 写入的位置
+	 * @param dataVec 写入的数据,移交给工作线程
+	 * @param executor 执行回调的对象
+	 * @param done 回调函数,参数为是否写入成功
+	 * @return true 已经投递
+	 * @return false 文件没有打开
+	 */
+	template<typename Executor, typename Done>
+	bool WriteAt(const int nFileId, const int64_t nOffset, std::vector<char> dataVec, Executor& executor, Done done)
+	{
+		auto pFile = FindFile(nFileId);
+		if (!pFile)
+		{
+			return false;
+		}
+		auto pData = std::make_shared<std::vector<char>>(std::move(dataVec));
+		Post(nFileId, [this, pFile, nOffset, pData]() {
+			bool bOk = pFile->WriteAt(nOffset, pData->data(), pData->size());
+			CountIo(bOk);
+			return bOk;
+		}, executor, done);
+		return true;
+	}
+
+	/**
+	 * @brief 从指定位置读取数据
+	 *
+	 * @param nFileId 文件ID
+	 * @param nOffset 读取的位置
+	 * @param nMaxLen 最多读取的长度
+	 * @param executor 执行回调的对象
+	 * @param done 回调函数,参数为(bool bOk, std::vector<char>& dataVec),数据可以移走
+	 * @return true 已经投递
+	 * @return false 文件没有打开
+	 */
+	template<typename Executor, typename Done>
+	bool ReadAt(const int nFileId, const int64_t nOffset, const std::size_t nMaxLen, Executor& executor, Done done)
+	{
+		auto pFile = FindFile(nFileId);
+		if (!pFile)
+		{
+			return false;
+		}
+		Post(nFileId, [this, pFile, nOffset, nMaxLen]() {
+			ReadResult_st result;
+			result.m_dataVec.resize(nMaxLen);
+			std::size_t nReadLen = 0;
+			result.m_bOk = pFile->ReadAt(nOffset, result.m_dataVec.data(), nMaxLen, nReadLen);
+			result.m_dataVec.resize(nReadLen);
+			CountIo(result.m_bOk);
+			return result;
+		}, executor, [done](ReadResult_st& result) {
+			done(result.m_bOk, result.m_dataVec);
+		});
+		return true;
+	}
+
+	/**
+	 * @brief 获取统计数据
+	 *
+	 * @param bReset 获取以后是否清零,用于按周期输出
+	 */
+	FileIoStat_st Stat(const bool bReset = false);
+private:
+	struct ReadResult_st
+	{
+		bool m_bOk = false;
+		std::vector<char> m_dataVec;
+	};
+
+	struct TaskItem_st
+	{
+		Task m_task;
+		Clock::time_point m_postTime;
+	};
+
+	struct Worker_st
+	{
+		std::thread m_thread;
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		std::deque<TaskItem_st> m_taskQueue;
+		bool m_bStop = false;
+	};
+
+	void CountIo(const bool bOk);
+
+	void RunTask(TaskItem_st& item);
+
+	void WorkerLoop(Worker_st& worker);
+
+	FileIoEngineCfg_st m_cfg;
+	std::vector<std::unique_ptr<Worker_st>> m_workerVec;
+	std::map<int, std::shared_ptr<CIoFile>> m_fileMap;//只在调用者的strand上访问
+	std::mutex m_statMutex;
+	FileIoStat_st m_stat;
+};
+#endif
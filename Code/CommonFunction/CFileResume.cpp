@@ -0,0 +1,269 @@
+#include "CFileResume.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "json11.hpp"
+#include "CFileHash.h"
+
+const int CFileResumeState::SAVE_INTERVAL;
+const std::size_t CFileResumeState::MAX_RANGE_COUNT;
+
+static int ResumeChunkCount(const int nFileSize, const int nChunkSize)
+{
+	if (nFileSize <= 0 || nChunkSize <= 0)
+	{
+		return 0;
+	}
+	return nFileSize / nChunkSize + (nFileSize % nChunkSize == 0 ? 0 : 1);
+}
+
+//每个字节保存8个数据包,低位在前
+static std::string BitmapToHex(const std::vector<bool>& flagVec)
+{
+	static const char HEX_CHARS[] = "0123456789abcdef";
+	std::string strResult;
+	for (std::size_t i = 0; i < flagVec.size(); i += 8)
+	{
+		unsigned int nByte = 0;
+		for (std::size_t j = 0; j < 8 && i + j < flagVec.size(); j++)
+		{
+			if (flagVec[i + j])
+			{
+				nByte |= 1u << j;
+			}
+		}
+		strResult.push_back(HEX_CHARS[nByte >> 4]);
+		strResult.push_back(HEX_CHARS[nByte & 0x0F]);
+	}
+	return strResult;
+}
+
+static int HexValue(const char ch)
+{
+	if (ch >= '0' && ch <= '9')
+	{
+		return ch - '0';
+	}
+	if (ch >= 'a' && ch <= 'f')
+	{
+		return ch - 'a' + 10;
+	}
+	if (ch >= 'A' && ch <= 'F')
+	{
+		return ch - 'A' + 10;
+	}
+	return -1;
+}
+
+static bool HexToBitmap(const std::string& strHex, std::vector<bool>& flagVec)
+{
+	if (strHex.length() != (flagVec.size() + 7) / 8 * 2)
+	{
+		return false;
+	}
+	for (std::size_t i = 0; i < strHex.length(); i += 2)
+	{
+		int nHigh = HexValue(strHex[i]);
+		int nLow = HexValue(strHex[i + 1]);
+		if (nHigh < 0 || nLow < 0)
+		{
+			return false;
+		}
+		unsigned int nByte = static_cast<unsigned int>(nHigh * 16 + nLow);
+		for (std::size_t j = 0; j < 8 && i / 2 * 8 + j < flagVec.size(); j++)
+		{
+			flagVec[i / 2 * 8 + j] = ((nByte >> j) & 1u) != 0;
+		}
+	}
+	return true;
+}
+
+CFileResumeState::CFileResumeState() :
+	m_nFileSize(0),
+	m_nChunkSize(0),
+	m_nRecvCount(0),
+	m_nUnsavedCount(0)
+{
+}
+
+CFileResumeState::CFileResumeState(const std::string& strFileHash, const std::string& strFileName, const int nFileSize, const int nChunkSize) :
+	m_strFileHash(strFileHash),
+	m_strFileName(strFileName),
+	m_nFileSize(nFileSize),
+	m_nChunkSize(nChunkSize),
+	m_nRecvCount(0),
+	m_nUnsavedCount(0),
+	m_recvFlagVec(static_cast<std::size_t>(ResumeChunkCount(nFileSize, nChunkSize)), false)
+{
+}
+
+bool CFileResumeState::Load(const std::string& strPath)
+{
+	std::ifstream inFile(strPath, std::ios::binary);
+	if (!inFile.is_open())
+	{
+		return false;
+	}
+	std::stringstream strStream;
+	strStream << inFile.rdbuf();
+	std::string err;
+	auto pJson = json11::Json::parse(strStream.str(), err);
+	if (!err.empty() || !pJson["FileHash"].is_string() || !pJson["FileName"].is_string() ||
+		!pJson["FileSize"].is_number() || !pJson["ChunkSize"].is_number() || !pJson["Bitmap"].is_string())
+	{
+		return false;
+	}
+	CFileResumeState state(pJson["FileHash"].string_value(), pJson["FileName"].string_value(),
+		pJson["FileSize"].int_value(), pJson["ChunkSize"].int_value());
+	if (state.m_nFileSize <= 0 || state.m_nChunkSize <= 0 || !HexToBitmap(pJson["Bitmap"].string_value(), state.m_recvFlagVec))
+	{
+		return false;
+	}
+	for (const auto bRecv : state.m_recvFlagVec)
+	{
+		if (bRecv)
+		{
+			state.m_nRecvCount++;
+		}
+	}
+	*this = state;
+	return true;
+}
+
+bool CFileResumeState::Save(const std::string& strPath)
+{
+	json11::Json stateJson = json11::Json::object({
+		{ "FileHash", m_strFileHash },
+		{ "FileName", m_strFileName },
+		{ "FileSize", m_nFileSize },
+		{ "ChunkSize", m_nChunkSize },
+		{ "Bitmap", BitmapToHex(m_recvFlagVec) },
+	});
+	const std::string strData = stateJson.dump();
+	const std::string strTmpPath = strPath + ".tmp";
+	std::FILE* pFile = std::fopen(strTmpPath.c_str(), "wb");
+	if (nullptr == pFile)
+	{
+		return false;
+	}
+	bool bResult = std::fwrite(strData.data(), 1, strData.length(), pFile) == strData.length();
+	bResult = (0 == std::fclose(pFile)) && bResult;
+	if (bResult)
+	{
+#ifdef _WIN32
+		std::remove(strPath.c_str());
+#endif
+		bResult = (0 == std::rename(strTmpPath.c_str(), strPath.c_str()));
+	}
+	if (!bResult)
+	{
+		std::remove(strTmpPath.c_str());
+		return false;
+	}
+	m_nUnsavedCount = 0;
+	return true;
+}
+
+bool CFileResumeState::IsMatch(const std::string& strFileHash, const int nFileSize) const
+{
+	return m_strFileHash == strFileHash && m_nFileSize == nFileSize;
+}
+
+std::string CFileResumeState::StateFileName(const std::string& strFileHash)
+{
+	FILE_HASH_TYPE eType = FILE_HASH_TYPE::HASH_MD5;
+	if (!CFileHash::TypeOfHash(strFileHash, eType))
+	{
+		return "";
+	}
+	std::string strName;
+	for (const auto ch : strFileHash)
+	{
+		int nValue = HexValue(ch);
+		if (nValue < 0)
+		{
+			return "";
+		}
+		strName.push_back("0123456789abcdef"[nValue]);
+	}
+	return strName + ".resume";
+}
+
+/**
+ * @brief 按新的数据包长度重新计算,新的数据包覆盖的旧数据包全部收到时才算收到
+ *
+ * @param nChunkSize 新的数据包长度
+ */
+void CFileResumeState::Rebase(const int nChunkSize)
+{
+	if (nChunkSize <= 0 || nChunkSize == m_nChunkSize)
+	{
+		return;
+	}
+	CFileResumeState state(m_strFileHash, m_strFileName, m_nFileSize, nChunkSize);
+	for (int nIndex = 1; m_nChunkSize > 0 && nIndex <= state.TotalCount(); nIndex++)
+	{
+		int64_t nBegin = static_cast<int64_t>(nIndex - 1) * nChunkSize;
+		int64_t nEnd = std::min<int64_t>(static_cast<int64_t>(nIndex) * nChunkSize, m_nFileSize);
+		int nOldBegin = static_cast<int>(nBegin / m_nChunkSize) + 1;
+		int nOldEnd = static_cast<int>((nEnd - 1) / m_nChunkSize) + 1;
+		bool bRecv = true;
+		for (int nOld = nOldBegin; nOld <= nOldEnd && bRecv; nOld++)
+		{
+			bRecv = IsRecv(nOld);
+		}
+		if (bRecv)
+		{
+			state.OnRecv(nIndex);
+		}
+	}
+	state.m_nUnsavedCount = 0;
+	*this = state;
+}
+
+bool CFileResumeState::OnRecv(const int nIndex)
+{
+	if (nIndex < 1 || nIndex > TotalCount() || m_recvFlagVec[nIndex - 1])
+	{
+		return false;
+	}
+	m_recvFlagVec[nIndex - 1] = true;
+	m_nRecvCount++;
+	m_nUnsavedCount++;
+	return m_nUnsavedCount >= SAVE_INTERVAL;
+}
+
+bool CFileResumeState::IsRecv(const int nIndex) const
+{
+	return nIndex >= 1 && nIndex <= TotalCount() && m_recvFlagVec[nIndex - 1];
+}
+
+std::vector<FILE_DATA_RANGE> CFileResumeState::MissingRanges(const std::size_t nMaxCount) const
+{
+	std::vector<FILE_DATA_RANGE> rangeVec;
+	int nIndex = 1;
+	while (nIndex <= TotalCount())
+	{
+		if (IsRecv(nIndex))
+		{
+			nIndex++;
+			continue;
+		}
+		int nEnd = nIndex;
+		while (nEnd < TotalCount() && !IsRecv(nEnd + 1))
+		{
+			nEnd++;
+		}
+		if (nMaxCount > 0 && rangeVec.size() + 1 >= nMaxCount)
+		{
+			//范围过多,剩下的数据包全部重新发送
+			rangeVec.push_back({ nIndex, TotalCount() });
+			break;
+		}
+		rangeVec.push_back({ nIndex, nEnd });
+		nIndex = nEnd + 1;
+	}
+	return rangeVec;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file CFileResume.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 文件接收的断点续传状态,记录已经写入的数据包并保存到文件,连接断开以后只发送缺少的数据包
+ * @version 0.1
+ * @date 2020-06-06
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_FILE_RESUME_H_
+#define _DENNIS_THINK_C_FILE_RESUME_H_
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+//数据包索引的范围,起止索引都包含在内
+using FILE_DATA_RANGE = std::pair<int, int>;
+
+/**
+ * @brief 一个正在接收的文件已经写入的数据包,以文件Hash区分
+ *
+ * 数据包索引从1开始,与FileDataSendReqMsg::m_nDataIndex一致。
+ * 续传时发送端的数据包长度可能和上次不同,Rebase以后只保留完整收到的数据包。
+ */
+class CFileResumeState
+{
+public:
+	static const int SAVE_INTERVAL = 64;//收到多少个新的数据包保存一次
+	static const std::size_t MAX_RANGE_COUNT = 256;//缺少的数据包范围的最大个数
+
+	CFileResumeState();
+	CFileResumeState(const std::string& strFileHash, const std::string& strFileName, const int nFileSize, const int nChunkSize);
+
+	//从文件加载,文件不存在或者内容不正确时返回false
+	bool Load(const std::string& strPath);
+
+	//写入临时文件以后替换,保存成功以后重新开始计数
+	bool Save(const std::string& strPath);
+
+	bool IsMatch(const std::string& strFileHash, const int nFileSize) const;
+
+	//续传状态文件的文件名,Hash不是十六进制字符串时返回空字符串
+	static std::string StateFileName(const std::string& strFileHash);
+
+	//按新的数据包长度重新计算已经收到的数据包
+	void Rebase(const int nChunkSize);
+
+	/**
+	 * @brief 记录已经写入文件的数据包
+	 *
+	 * @param nIndex 数据包索引
+	 * @return true 距离上次保存已经收到SAVE_INTERVAL个新的数据包
+	 * @return false 不需要保存
+	 */
+	bool OnRecv(const int nIndex);
+
+	bool IsRecv(const int nIndex) const;
+
+	//缺少的数据包范围,超过nMaxCount个时最后一个范围延伸到最后一个数据包
+	std::vector<FILE_DATA_RANGE> MissingRanges(const std::size_t nMaxCount = MAX_RANGE_COUNT) const;
+
+	int TotalCount() const { return static_cast<int>(m_recvFlagVec.size()); }
+
+	int RecvCount() const { return m_nRecvCount; }
+
+	const std::string& FileHash() const { return m_strFileHash; }
+
+	//接收的文件的路径
+	const std::string& FileName() const { return m_strFileName; }
+	void SetFileName(const std::string& strFileName) { m_strFileName = strFileName; }
+
+	int FileSize() const { return m_nFileSize; }
+
+	int ChunkSize() const { return m_nChunkSize; }
+private:
+	std::string m_strFileHash;
+	std::string m_strFileName;
+	int m_nFileSize;
+	int m_nChunkSize;
+	int m_nRecvCount;//已经收到的数据包个数
+	int m_nUnsavedCount;//上次保存以后收到的数据包个数
+	std::vector<bool> m_recvFlagVec;//每个数据包是否已经写入
+};
+#endif
@@ -0,0 +1,163 @@
+#include "CFileTransWindow.h"
+#include <algorithm>
+
+const int CFileSendWindow::DEFAULT_WINDOW_SIZE;
+const int CFileSendWindow::RETRANS_TIMEOUT_MS;
+const int CFileSendWindow::MAX_TIMEOUT_ROUNDS;
+
+CFileSendWindow::CFileSendWindow(const int nTotalCount, const int nWindowSize) :
+	m_nTotalCount(nTotalCount),
+	m_nWindowSize(std::max(nWindowSize, 1)),
+	m_nNextIndex(1),
+	m_nCumAckIndex(0),
+	m_nTimeoutRounds(0)
+{
+}
+
+/**
+ * @brief 设置续传时需要发送的数据包,不在范围内的数据包不再发送
+ *
+ * @param rangeVec 接收端缺少的数据包范围
+ */
+void CFileSendWindow::SetSendRanges(const std::vector<std::pair<int, int>>& rangeVec)
+{
+	m_skipFlagVec.assign(static_cast<std::size_t>(std::max(m_nTotalCount, 0)), true);
+	for (const auto& range : rangeVec)
+	{
+		for (int nIndex = std::max(range.first, 1); nIndex <= std::min(range.second, m_nTotalCount); nIndex++)
+		{
+			m_skipFlagVec[nIndex - 1] = false;
+		}
+	}
+	AdvanceCumAck();
+}
+
+/**
+ * @brief 获取下一个可以发送的新数据包,只有在窗口内的数据包才可以发送
+ *
+ * @param nIndex 数据包索引
+ * @return true 可以发送
+ * @return false 窗口已满或者已经全部发送
+ */
+bool CFileSendWindow::NextSendIndex(int& nIndex)
+{
+	AdvanceCumAck();
+	if (m_nNextIndex > m_nTotalCount || m_nNextIndex > m_nCumAckIndex + m_nWindowSize)
+	{
+		return false;
+	}
+	nIndex = m_nNextIndex++;
+	m_inFlightMap[nIndex] = Clock::now();
+	return true;
+}
+
+/**
+ * @brief 处理接收端的确认,累计确认之前的数据包和选择确认的数据包都从在途列表中删除
+ *
+ * @param nCumAckIndex 累计确认的索引
+ * @param nAckIndex 选择确认的索引
+ * @return true 有新的数据包被确认,窗口可能已经滑动
+ * @return false 重复的确认
+ */
+bool CFileSendWindow::OnAck(const int nCumAckIndex, const int nAckIndex)
+{
+	std::size_t nOldCount = m_inFlightMap.size();
+	int nOldCumAck = m_nCumAckIndex;
+	m_inFlightMap.erase(m_inFlightMap.begin(), m_inFlightMap.upper_bound(nCumAckIndex));
+	m_inFlightMap.erase(nAckIndex);
+	m_nCumAckIndex = std::max(m_nCumAckIndex, std::min(nCumAckIndex, m_nNextIndex - 1));
+	AdvanceCumAck();
+	if (m_inFlightMap.size() != nOldCount || m_nCumAckIndex != nOldCumAck)
+	{
+		m_nTimeoutRounds = 0;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief 获取超时的数据包,用于重传
+ *
+ * @param timeout 超时时间
+ * @return std::vector<int> 需要重传的数据包索引
+ */
+std::vector<int> CFileSendWindow::TimeoutIndexes(const std::chrono::milliseconds timeout)
+{
+	std::vector<int> result;
+	auto now = Clock::now();
+	for (auto& item : m_inFlightMap)
+	{
+		if (now - item.second >= timeout)
+		{
+			item.second = now;
+			result.push_back(item.first);
+		}
+	}
+	if (!result.empty())
+	{
+		m_nTimeoutRounds++;
+	}
+	return result;
+}
+
+bool CFileSendWindow::IsFinished() const
+{
+	return m_nCumAckIndex >= m_nTotalCount;
+}
+
+bool CFileSendWindow::IsSkipped(const int nIndex) const
+{
+	return nIndex >= 1 && nIndex <= static_cast<int>(m_skipFlagVec.size()) && m_skipFlagVec[nIndex - 1];
+}
+
+/**
+ * @brief 推进累计确认的索引,接收端已经有的数据包不需要发送,直接跳过
+ *
+ */
+void CFileSendWindow::AdvanceCumAck()
+{
+	while (m_nNextIndex <= m_nTotalCount && IsSkipped(m_nNextIndex))
+	{
+		m_nNextIndex++;
+	}
+	//已发送且不在途的数据包都已被确认
+	while (m_nCumAckIndex + 1 < m_nNextIndex && m_inFlightMap.find(m_nCumAckIndex + 1) == m_inFlightMap.end())
+	{
+		m_nCumAckIndex++;
+	}
+}
+
+CFileRecvWindow::CFileRecvWindow(const int nTotalCount) :
+	m_nTotalCount(std::max(nTotalCount, 0)),
+	m_nRecvCount(0),
+	m_nCumAckIndex(0),
+	m_recvFlagVec(static_cast<std::size_t>(std::max(nTotalCount, 0)), false)
+{
+}
+
+/**
+ * @brief 记录收到的数据包,并推进累计确认的索引
+ *
+ * @param nIndex 数据包索引
+ * @return true 新的数据包,需要写入文件
+ * @return false 重复或越界的数据包
+ */
+bool CFileRecvWindow::OnRecv(const int nIndex)
+{
+	if (nIndex < 1 || nIndex > m_nTotalCount || m_recvFlagVec[nIndex - 1])
+	{
+		return false;
+	}
+	m_recvFlagVec[nIndex - 1] = true;
+	m_nRecvCount++;
+	while (m_nCumAckIndex < m_nTotalCount && m_recvFlagVec[m_nCumAckIndex])
+	{
+		m_nCumAckIndex++;
+	}
+	return true;
+}
+
+bool CFileRecvWindow::IsFinished() const
+{
+	return m_nRecvCount >= m_nTotalCount;
+}
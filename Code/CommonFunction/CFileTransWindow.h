@@ -0,0 +1,94 @@
+/**
+ * @file CFileTransWindow.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 文件传输的滑动窗口,发送端允许多个数据包同时在途,接收端记录收到的数据包并生成确认
+ * @version 0.1
+ * @date 2020-03-21
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_FILE_TRANS_WINDOW_H_
+#define _DENNIS_THINK_C_FILE_TRANS_WINDOW_H_
+#include <chrono>
+#include <map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 文件发送窗口,数据包索引从1开始,与FileDataSendReqMsg::m_nDataIndex一致
+ *
+ */
+class CFileSendWindow
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static const int DEFAULT_WINDOW_SIZE = 32;//默认同时在途的数据包个数
+	static const int RETRANS_TIMEOUT_MS = 1000;//数据包发出后多久没有确认就重传
+	static const int MAX_TIMEOUT_ROUNDS = 10;//连续超时多少次以后放弃发送
+
+	explicit CFileSendWindow(const int nTotalCount = 0, const int nWindowSize = DEFAULT_WINDOW_SIZE);
+
+	//续传时只发送接收端缺少的数据包,范围起止索引都包含在内,其他数据包当作已经确认,在发送之前调用
+	void SetSendRanges(const std::vector<std::pair<int, int>>& rangeVec);
+
+	//获取下一个可以发送的新数据包索引,窗口已满或已全部发送时返回false
+	bool NextSendIndex(int& nIndex);
+
+	//处理确认,nCumAckIndex及之前的数据包全部已收到,nAckIndex为本次收到的数据包
+	bool OnAck(const int nCumAckIndex, const int nAckIndex);
+
+	//获取超时未确认的数据包,返回的数据包重新开始计时
+	std::vector<int> TimeoutIndexes(const std::chrono::milliseconds timeout);
+
+	//全部数据包是否都已确认
+	bool IsFinished() const;
+
+	int TotalCount() const { return m_nTotalCount; }
+
+	int CumAckIndex() const { return m_nCumAckIndex; }
+
+	int InFlightCount() const { return static_cast<int>(m_inFlightMap.size()); }
+
+	//连续超时且没有新确认的次数,用于判断对端是否已经断开
+	int TimeoutRounds() const { return m_nTimeoutRounds; }
+private:
+	int m_nTotalCount;//数据包总数
+	int m_nWindowSize;//窗口大小
+	int m_nNextIndex;//下一个新发送的数据包索引
+	int m_nCumAckIndex;//该索引及之前的数据包全部已确认
+	int m_nTimeoutRounds;//连续超时的次数,收到新的确认后清零
+	std::map<int, Clock::time_point> m_inFlightMap;//已发送未确认的数据包和发送时间
+	std::vector<bool> m_skipFlagVec;//续传时接收端已经有的数据包,为空时全部发送
+
+	bool IsSkipped(const int nIndex) const;
+	void AdvanceCumAck();
+};
+
+/**
+ * @brief 文件接收窗口,记录收到的数据包,生成累计确认,重复的数据包不会重复写入
+ *
+ */
+class CFileRecvWindow
+{
+public:
+	explicit CFileRecvWindow(const int nTotalCount = 0);
+
+	//记录收到的数据包,新的数据包返回true,重复或越界的数据包返回false
+	bool OnRecv(const int nIndex);
+
+	//全部数据包是否都已收到
+	bool IsFinished() const;
+
+	int TotalCount() const { return m_nTotalCount; }
+
+	int CumAckIndex() const { return m_nCumAckIndex; }
+private:
+	int m_nTotalCount;//数据包总数
+	int m_nRecvCount;//已收到的数据包个数
+	int m_nCumAckIndex;//该索引及之前的数据包全部已收到
+	std::vector<bool> m_recvFlagVec;//每个数据包是否已收到
+};
+#endif
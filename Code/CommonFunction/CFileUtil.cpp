@@ -18,6 +18,7 @@
 #include  <stdio.h>
 #include  <stdlib.h>
 #include "md5.h"
+#include "CFileHash.h"
 
 /**
  * @brief 获取文件的大小
@@ -112,6 +113,54 @@ bool CFileUtil::OpenWriteFile(const int nFileId, const std::string strFileName)
 	}
 }
 
+/**
+ * @brief 以读写的方式打开文件,已经存在的文件保留内容,用于断点续传
+ * 
+ * @param nFileId 文件ID
+ * @param strFileName 文件名称
+ * @return true 打开成功
+ * @return false 打开失败
+ */
+bool CFileUtil::OpenResumeFile(const int nFileId, const std::string strFileName)
+{
+	if (!IsFileExist(strFileName))
+	{
+		return OpenWriteFile(nFileId, strFileName);
+	}
+	m_strFileNameMap.erase(nFileId);
+	m_strFileNameMap.insert({ nFileId, strFileName });
+	FILE * pFile=nullptr;
+#ifdef _WIN32
+	fopen_s(&pFile,strFileName.c_str(), "r+b");
+#else
+	pFile = fopen(strFileName.c_str(), "r+b");
+#endif
+	if (nullptr != pFile) {
+		m_WriteFileMap.insert({ nFileId,pFile });
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+/**
+ * @brief 把写入的数据刷新到操作系统,保存续传状态之前调用
+ * 
+ * @param nFileId 文件ID
+ * @return true 成功
+ * @return false 文件没有打开或者刷新失败
+ */
+bool CFileUtil::FlushFile(const int nFileId)
+{
+	auto item = m_WriteFileMap.find(nFileId);
+	if (item != m_WriteFileMap.end())
+	{
+		return fflush(item->second) == 0;
+	}
+	return false;
+}
+
 /**
  * @brief 响应文件写入数据
  * 
@@ -165,6 +214,62 @@ bool CFileUtil::OnReadData(const int nFileId, char * pData, int& nReadLen, const
 	}
 	return false;
 }
+/**
+ * @brief 在文件的指定位置写入数据,用于乱序到达的文件数据包
+ * 
+ * @param nFileId 文件ID
+ * @param nOffset 写入的位置
+ * @param pData 数据
+ * @param nDataLen 数据长度
+ * @return true 成功
+ * @return false 失败
+ */
+bool CFileUtil::OnWriteDataAt(const int nFileId, const long nOffset, const char * pData, const int nDataLen)
+{
+	auto item = m_WriteFileMap.find(nFileId);
+	if (item != m_WriteFileMap.end())
+	{
+		if (fseek(item->second, nOffset, SEEK_SET) != 0)
+		{
+			return false;
+		}
+		auto writeSize = fwrite(pData, 1, nDataLen, item->second);
+		return static_cast<int>(writeSize) == nDataLen;
+	}
+	return false;
+}
+
+/**
+ * @brief 从文件的指定位置读取数据,用于按索引发送和重传文件数据包
+ * 
+ * @param nFileId 文件ID
+ * @param nOffset 读取的位置
+ * @param pData 读取到的文件数据
+ * @param nReadLen 实际读取到的数据长度
+ * @param nMaxDataLen 可以读取的数据的最大长度
+ * @return true 读取数据成功
+ * @return false 读取数据失败
+ */
+bool CFileUtil::OnReadDataAt(const int nFileId, const long nOffset, char * pData, int& nReadLen, const int nMaxDataLen)
+{
+	auto item = m_ReadFileMap.find(nFileId);
+	if (item != m_ReadFileMap.end())
+	{
+		if (fseek(item->second, nOffset, SEEK_SET) != 0)
+		{
+			return false;
+		}
+		auto readSize = fread(pData, 1, nMaxDataLen, item->second);
+		if (readSize <= 0)
+		{
+			return false;
+		}
+		nReadLen = static_cast<int>(readSize);
+		return true;
+	}
+	return false;
+}
+
 std::string CFileUtil::GetFileNameFromPath(const std::string strFullPath)
 {
 	std::string::size_type iPos = strFullPath.find_last_of('\\') + 1;
@@ -354,21 +459,19 @@ bool CFileUtil::RemoveFolder(const std::string strFolder)
  */
 std::string CFileUtil::CalcHash(const std::string strFileName)
 {
-	MD5 hashUtil;
-	int fileId = rand();
-	if (OpenReadFile(fileId, strFileName))
-	{
-		char buff[1024] = { 0 };
-		int nReadLen = 0;
-		while (OnReadData(fileId, buff, nReadLen, 1024))
-		{
-			hashUtil.update(buff, nReadLen);
-		}
-		OnCloseFile(fileId);
-		auto result = hashUtil.finalize();
-		return result.hexdigest();
-	}
-	return "";
+	return CalcHash(strFileName, FILE_HASH_TYPE::HASH_MD5);
+}
+
+/**
+ * @brief 读取整个文件计算Hash,传输中的文件使用CChunkHash,只有没有流式计算结果时才调用
+ *
+ * @param strFileName 文件名
+ * @param eType Hash算法
+ * @return std::string 文件的Hash,文件不存在时为空
+ */
+std::string CFileUtil::CalcHash(const std::string strFileName, const FILE_HASH_TYPE eType)
+{
+	return CFileHash::CalcFile(strFileName, eType);
 }
 
 std::string CFileUtil::GetCurDir()
@@ -14,6 +14,7 @@
 #include <cstdio>
 #include <map>
 #include <fstream>
+#include "CFileHash.h"
 class CFileUtil
 {
 public:
@@ -28,12 +29,17 @@ public:
 	bool OpenReadFile(const int nFileId, const std::string strFileName);
 
 	bool OpenWriteFile(const int nFileId, const std::string strFileName);
+	bool OpenResumeFile(const int nFileId, const std::string strFileName);
+	bool FlushFile(const int nFileId);
 	bool OnWriteData(const int nFileId,const char * pData,const int nDataLen);
 	bool OnReadData(const int nFileId,char * pData,int& nReadLen,const int nMaxDataLen);
+	bool OnWriteDataAt(const int nFileId,const long nOffset,const char * pData,const int nDataLen);
+	bool OnReadDataAt(const int nFileId,const long nOffset,char * pData,int& nReadLen,const int nMaxDataLen);
 	bool OnCloseFile(const int nFileId);
 	bool UtilCopy(const std::string strSrcName, const std::string strDstName);
 	static std::string GetFileNameExtension(const std::string strFullPath);
 	std::string CalcHash(const std::string strFileName);
+	std::string CalcHash(const std::string strFileName, const FILE_HASH_TYPE eType);
 	std::string GetFileNameFromPath(const std::string strFullPath);
 	std::string GetCurDir();
 	std::string GetFileName(const int nFileId);
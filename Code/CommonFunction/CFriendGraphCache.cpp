@@ -0,0 +1,96 @@
+#include "CFriendGraphCache.h"
+
+std::string FriendCacheStat_st::ToString() const
+{
+	return "Size:" + std::to_string(m_nSize) +
+		" Hit:" + std::to_string(m_nHitCount) +
+		" Miss:" + std::to_string(m_nMissCount) +
+		" Evict:" + std::to_string(m_nEvictCount);
+}
+
+CFriendGraphCache::CFriendGraphCache(const std::size_t nCapacity)
+	: m_nCapacity(nCapacity)
+{
+}
+
+void CFriendGraphCache::SetCapacity(const std::size_t nCapacity)
+{
+	m_nCapacity = nCapacity;
+	Evict();
+}
+
+bool CFriendGraphCache::Get(const std::string& strUserId, std::vector<FriendEdge_st>& edgeVec)
+{
+	auto item = m_cacheMap.find(strUserId);
+	if (item == m_cacheMap.end())
+	{
+		m_stat.m_nMissCount++;
+		return false;
+	}
+	m_lruList.splice(m_lruList.begin(), m_lruList, item->second.m_lruPos);
+	edgeVec = item->second.m_edgeVec;
+	m_stat.m_nHitCount++;
+	return true;
+}
+
+void CFriendGraphCache::Put(const std::string& strUserId, std::vector<FriendEdge_st> edgeVec)
+{
+	if (0 == m_nCapacity)
+	{
+		return;
+	}
+	auto item = m_cacheMap.find(strUserId);
+	if (item != m_cacheMap.end())
+	{
+		m_lruList.splice(m_lruList.begin(), m_lruList, item->second.m_lruPos);
+		item->second.m_edgeVec = std::move(edgeVec);
+		return;
+	}
+	m_lruList.push_front(strUserId);
+	Entry_st entry;
+	entry.m_edgeVec = std::move(edgeVec);
+	entry.m_lruPos = m_lruList.begin();
+	m_cacheMap.insert({ strUserId, std::move(entry) });
+	Evict();
+}
+
+void CFriendGraphCache::Invalidate(const std::string& strUserId)
+{
+	auto item = m_cacheMap.find(strUserId);
+	if (item != m_cacheMap.end())
+	{
+		m_lruList.erase(item->second.m_lruPos);
+		m_cacheMap.erase(item);
+	}
+}
+
+void CFriendGraphCache::Clear()
+{
+	m_lruList.clear();
+	m_cacheMap.clear();
+}
+
+FriendCacheStat_st CFriendGraphCache::Stat(const bool bReset)
+{
+	FriendCacheStat_st stat = m_stat;
+	stat.m_nSize = m_cacheMap.size();
+	if (bReset)
+	{
+		m_stat = FriendCacheStat_st();
+	}
+	return stat;
+}
+
+/**
+ * @brief 超过容量时从最久没有使用的用户开始淘汰
+ *
+ */
+void CFriendGraphCache::Evict()
+{
+	while (m_cacheMap.size() > m_nCapacity && !m_lruList.empty())
+	{
+		m_cacheMap.erase(m_lruList.back());
+		m_lruList.pop_back();
+		m_stat.m_nEvictCount++;
+	}
+}
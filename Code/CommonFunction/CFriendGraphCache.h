@@ -0,0 +1,95 @@
+/**
+ * @file CFriendGraphCache.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 好友关系的内存缓存,用户上下线通知好友时不再每次查询数据库
+ * @version 0.1
+ * @date 2020-04-16
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_FRIEND_GRAPH_CACHE_H_
+#define _DENNIS_THINK_C_FRIEND_GRAPH_CACHE_H_
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 一条好友关系,好友ID和所在的分组
+ *
+ */
+struct FriendEdge_st
+{
+	std::string m_strFriendId;//好友ID
+	std::string m_strTeamId;//好友所在的分组ID
+};
+
+/**
+ * @brief 缓存的统计
+ *
+ */
+struct FriendCacheStat_st
+{
+	std::size_t m_nSize = 0;//缓存的用户数
+	uint64_t m_nHitCount = 0;//命中次数
+	uint64_t m_nMissCount = 0;//未命中次数
+	uint64_t m_nEvictCount = 0;//超过容量被淘汰的用户数
+
+	std::string ToString() const;
+};
+
+/**
+ * @brief 用户ID到好友列表的缓存,超过容量时淘汰最久没有使用的用户
+ *
+ * 只缓存好友关系,不缓存好友的资料和在线状态。添加、删除好友,移动好友分组,删除分组以后,
+ * 调用Invalidate删除相关用户的缓存。没有加锁,只在CChatServer的strand上使用。
+ */
+class CFriendGraphCache
+{
+public:
+	explicit CFriendGraphCache(const std::size_t nCapacity = 10000);
+
+	//设置容量,0表示不缓存
+	void SetCapacity(const std::size_t nCapacity);
+
+	std::size_t Capacity() const { return m_nCapacity; }
+
+	/**
+	 * @brief 获取用户的好友列表
+	 *
+	 * @param strUserId 用户ID
+	 * @param edgeVec 好友列表
+	 * @return true 命中缓存
+	 * @return false 没有缓存,需要查询数据库
+	 */
+	bool Get(const std::string& strUserId, std::vector<FriendEdge_st>& edgeVec);
+
+	//保存从数据库查询到的好友列表
+	void Put(const std::string& strUserId, std::vector<FriendEdge_st> edgeVec);
+
+	//用户的好友关系改变以后删除缓存
+	void Invalidate(const std::string& strUserId);
+
+	void Clear();
+
+	std::size_t Size() const { return m_cacheMap.size(); }
+
+	FriendCacheStat_st Stat(const bool bReset = false);
+private:
+	struct Entry_st
+	{
+		std::vector<FriendEdge_st> m_edgeVec;
+		std::list<std::string>::iterator m_lruPos;
+	};
+
+	void Evict();
+
+	std::size_t m_nCapacity;
+	std::list<std::string> m_lruList;//最近使用的用户在最前面
+	std::unordered_map<std::string, Entry_st> m_cacheMap;
+	FriendCacheStat_st m_stat;
+};
+#endif
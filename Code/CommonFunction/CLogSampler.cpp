@@ -0,0 +1,91 @@
+#include "CLogSampler.h"
+
+std::atomic<int> CLogSampler::ms_nMode(static_cast<int>(E_PAYLOAD_LOG::ALL));
+std::atomic<uint32_t> CLogSampler::ms_nSampleRate(1);
+std::atomic<uint64_t> CLogSampler::ms_nCounter(0);
+
+bool ParsePayloadLogMode(const std::string& strMode, E_PAYLOAD_LOG& mode)
+{
+	if ("all" == strMode)
+	{
+		mode = E_PAYLOAD_LOG::ALL;
+		return true;
+	}
+	if ("sample" == strMode)
+	{
+		mode = E_PAYLOAD_LOG::SAMPLE;
+		return true;
+	}
+	if ("none" == strMode)
+	{
+		mode = E_PAYLOAD_LOG::NONE;
+		return true;
+	}
+	return false;
+}
+
+std::string PayloadLogModeName(const E_PAYLOAD_LOG mode)
+{
+	switch (mode)
+	{
+	case E_PAYLOAD_LOG::ALL:
+	{
+		return "all";
+	}break;
+	case E_PAYLOAD_LOG::SAMPLE:
+	{
+		return "sample";
+	}break;
+	case E_PAYLOAD_LOG::NONE:
+	{
+		return "none";
+	}break;
+	}
+	return "unknown";
+}
+
+void CLogSampler::SetMode(const E_PAYLOAD_LOG mode, const uint32_t nSampleRate)
+{
+	ms_nSampleRate = nSampleRate > 0 ? nSampleRate : 1;
+	ms_nCounter = 0;
+	ms_nMode = static_cast<int>(mode);
+}
+
+E_PAYLOAD_LOG CLogSampler::Mode()
+{
+	return static_cast<E_PAYLOAD_LOG>(ms_nMode.load(std::memory_order_relaxed));
+}
+
+uint32_t CLogSampler::SampleRate()
+{
+	return ms_nSampleRate.load(std::memory_order_relaxed);
+}
+
+bool CLogSampler::ShouldLogPayload()
+{
+	switch (Mode())
+	{
+	case E_PAYLOAD_LOG::ALL:
+	{
+		return true;
+	}break;
+	case E_PAYLOAD_LOG::SAMPLE:
+	{
+		uint64_t nIndex = ms_nCounter.fetch_add(1, std::memory_order_relaxed);
+		return 0 == nIndex % SampleRate();
+	}break;
+	default:
+	{
+		return false;
+	}break;
+	}
+}
+
+std::string CLogSampler::Payload(const TransBaseMsg_t& msg)
+{
+	if (ShouldLogPayload())
+	{
+		return msg.ToPrintString();
+	}
+	return "LEN:" + std::to_string(msg.GetSize());
+}
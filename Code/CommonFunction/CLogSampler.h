@@ -0,0 +1,66 @@
+/**
+ * @file CLogSampler.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 消息内容日志的采样控制,避免在收发热路径上为每条消息格式化完整内容
+ * @version 0.1
+ * @date 2020-04-12
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_LOG_SAMPLER_H_
+#define _DENNIS_THINK_C_LOG_SAMPLER_H_
+#include "CommonMsg.h"
+#include <atomic>
+#include <string>
+
+/**
+ * @brief 消息内容的日志模式
+ *
+ */
+enum class E_PAYLOAD_LOG
+{
+	ALL,//每条消息都输出内容
+	SAMPLE,//每N条消息输出一次内容,其余只输出长度
+	NONE,//只输出长度
+};
+
+//解析配置中的日志模式,取值为all,sample,none
+bool ParsePayloadLogMode(const std::string& strMode, E_PAYLOAD_LOG& mode);
+
+std::string PayloadLogModeName(const E_PAYLOAD_LOG mode);
+
+/**
+ * @brief 进程内共享的消息内容采样器,多个线程可以同时调用
+ *
+ * 使用方式:
+ *     LOG_INFO(ms_loger, "RECV: {} {}", MsgType(pMsg->GetType()), CLogSampler::Payload(*pMsg));
+ * 由于LOG_INFO先判断级别,级别关闭时Payload不会被调用,采样计数也不会增加。
+ */
+class CLogSampler
+{
+public:
+	/**
+	 * @brief 设置日志模式
+	 *
+	 * @param mode 日志模式
+	 * @param nSampleRate SAMPLE模式下每多少条消息输出一次内容,0按1处理
+	 */
+	static void SetMode(const E_PAYLOAD_LOG mode, const uint32_t nSampleRate);
+
+	static E_PAYLOAD_LOG Mode();
+
+	static uint32_t SampleRate();
+
+	//本条消息是否需要输出内容
+	static bool ShouldLogPayload();
+
+	//返回需要输出的消息内容,未被采样时只返回长度
+	static std::string Payload(const TransBaseMsg_t& msg);
+private:
+	static std::atomic<int> ms_nMode;
+	static std::atomic<uint32_t> ms_nSampleRate;
+	static std::atomic<uint64_t> ms_nCounter;
+};
+#endif
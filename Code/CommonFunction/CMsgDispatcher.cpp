@@ -0,0 +1,64 @@
+#include "CMsgDispatcher.h"
+#include <algorithm>
+
+void MsgDispatchStat_st::Record(const uint64_t nUs)
+{
+	std::size_t nBucket = 0;
+	while (nBucket + 1 < HISTOGRAM_BUCKETS && nUs >= (static_cast<uint64_t>(1) << nBucket))
+	{
+		nBucket++;
+	}
+	m_histogram[nBucket]++;
+	m_nCount++;
+	m_nTotalUs += nUs;
+	m_nMaxUs = std::max(m_nMaxUs, nUs);
+}
+
+void MsgDispatchStat_st::Merge(const MsgDispatchStat_st& other)
+{
+	for (std::size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+	{
+		m_histogram[i] += other.m_histogram[i];
+	}
+	m_nCount += other.m_nCount;
+	m_nDecodeFailed += other.m_nDecodeFailed;
+	m_nTotalUs += other.m_nTotalUs;
+	m_nMaxUs = std::max(m_nMaxUs, other.m_nMaxUs);
+}
+
+/**
+ * @brief 根据直方图估算分位数
+ *
+ * @param fPercent 分位,取值0到100
+ * @return uint64_t 分位数所在桶的耗时上限,最后一个桶返回最大耗时
+ */
+uint64_t MsgDispatchStat_st::PercentileUs(const double fPercent) const
+{
+	if (0 == m_nCount)
+	{
+		return 0;
+	}
+	uint64_t nTarget = static_cast<uint64_t>(m_nCount * std::min(std::max(fPercent, 0.0), 100.0) / 100.0);
+	nTarget = std::max<uint64_t>(nTarget, 1);
+	uint64_t nSum = 0;
+	for (std::size_t i = 0; i + 1 < HISTOGRAM_BUCKETS; i++)
+	{
+		nSum += m_histogram[i];
+		if (nSum >= nTarget)
+		{
+			return std::min(static_cast<uint64_t>(1) << i, m_nMaxUs);
+		}
+	}
+	return m_nMaxUs;
+}
+
+std::string MsgDispatchStat_st::ToString() const
+{
+	uint64_t nAvgUs = m_nCount > 0 ? m_nTotalUs / m_nCount : 0;
+	return "Count:" + std::to_string(m_nCount) +
+		" DecodeFailed:" + std::to_string(m_nDecodeFailed) +
+		" Avg:" + std::to_string(nAvgUs) + "us" +
+		" P50:" + std::to_string(PercentileUs(50)) + "us" +
+		" P99:" + std::to_string(PercentileUs(99)) + "us" +
+		" Max:" + std::to_string(m_nMaxUs) + "us";
+}
@@ -0,0 +1,183 @@
+/**
+ * @file CMsgDispatcher.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 基于注册的消息分发器,按消息类型直接索引处理函数,并统计每种消息的处理次数和耗时
+ * @version 0.1
+ * @date 2020-04-11
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_MSG_DISPATCHER_H_
+#define _DENNIS_THINK_C_MSG_DISPATCHER_H_
+#include "CommonMsg.h"
+#include <array>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 分发的结果
+ *
+ */
+enum class E_DISPATCH_RESULT
+{
+	HANDLED,//已处理
+	NO_HANDLER,//该类型没有注册处理函数
+	DECODE_FAILED,//消息解码失败
+};
+
+/**
+ * @brief 一种消息的分发统计,耗时按2的幂次(微秒)分桶
+ *
+ */
+struct MsgDispatchStat_st
+{
+	static const std::size_t HISTOGRAM_BUCKETS = 24;//最后一个桶记录超过4秒的处理
+
+	uint64_t m_nCount = 0;//处理次数
+	uint64_t m_nDecodeFailed = 0;//解码失败次数
+	uint64_t m_nTotalUs = 0;//总耗时
+	uint64_t m_nMaxUs = 0;//最大耗时
+	std::array<uint64_t, HISTOGRAM_BUCKETS> m_histogram{ {} };//第i个桶记录耗时小于2^i微秒的处理
+
+	//记录一次处理的耗时
+	void Record(const uint64_t nUs);
+
+	//合并另一个分发器中同一种消息的统计
+	void Merge(const MsgDispatchStat_st& other);
+
+	//按直方图估算的分位数耗时,返回所在桶的上限
+	uint64_t PercentileUs(const double fPercent) const;
+
+	std::string ToString() const;
+};
+
+/**
+ * @brief 消息分发器,Args为处理函数在消息之前的参数,例如收到消息的会话
+ *
+ * 处理函数按消息类型保存在连续的数组中,分发时直接索引,解码和处理只经过一次间接调用。
+ * 新增消息只需要注册一行:
+ *     dispatcher.Register<KeepAliveReqMsg>(E_MsgType::KeepAliveReq_Type, [this](const Sess_S_PTR& pSess, const KeepAliveReqMsg& msg) { ... });
+ * 分发器不加锁,注册、分发和统计需要在同一个线程或strand上进行。
+ */
+template<typename... Args>
+class CMsgDispatcher
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	//解码并处理消息,解码失败时返回false
+	using HandlerFunc = std::function<bool(const TransBaseMsg_t&, Args...)>;
+
+	/**
+	 * @brief 注册一种消息的处理函数,消息先解码为MsgT再调用处理函数
+	 *
+	 * @param type 消息类型
+	 * @param func 处理函数,参数为(Args..., const MsgT&)
+	 */
+	template<typename MsgT, typename Func>
+	void Register(const E_MsgType type, Func func)
+	{
+		SetHandler(type, [func](const TransBaseMsg_t& transMsg, Args... args)->bool {
+			MsgT msg;
+			if (!transMsg.DecodeMsg(msg))
+			{
+				return false;
+			}
+			func(args..., msg);
+			return true;
+		});
+	}
+
+	/**
+	 * @brief 注册不需要解码的消息处理函数
+	 *
+	 * @param type 消息类型
+	 * @param func 处理函数,参数为(Args..., const TransBaseMsg_t&)
+	 */
+	template<typename Func>
+	void RegisterRaw(const E_MsgType type, Func func)
+	{
+		SetHandler(type, [func](const TransBaseMsg_t& transMsg, Args... args)->bool {
+			func(args..., transMsg);
+			return true;
+		});
+	}
+
+	/**
+	 * @brief 分发一条消息
+	 *
+	 * @param transMsg 收到的消息
+	 * @param args 传给处理函数的参数
+	 * @return E_DISPATCH_RESULT 分发的结果
+	 */
+	E_DISPATCH_RESULT Dispatch(const TransBaseMsg_t& transMsg, Args... args)
+	{
+		std::size_t nIndex = static_cast<std::size_t>(transMsg.GetType());
+		if (nIndex >= m_entryVec.size() || !m_entryVec[nIndex].m_handler)
+		{
+			return E_DISPATCH_RESULT::NO_HANDLER;
+		}
+		auto& entry = m_entryVec[nIndex];
+		auto begin = Clock::now();
+		bool bDecoded = entry.m_handler(transMsg, args...);
+		auto nUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - begin).count();
+		entry.m_stat.Record(static_cast<uint64_t>(nUs));
+		if (!bDecoded)
+		{
+			entry.m_stat.m_nDecodeFailed++;
+			return E_DISPATCH_RESULT::DECODE_FAILED;
+		}
+		return E_DISPATCH_RESULT::HANDLED;
+	}
+
+	//该类型是否已经注册了处理函数
+	bool HasHandler(const E_MsgType type) const
+	{
+		std::size_t nIndex = static_cast<std::size_t>(type);
+		return nIndex < m_entryVec.size() && m_entryVec[nIndex].m_handler;
+	}
+
+	/**
+	 * @brief 遍历有处理记录的消息类型的统计
+	 *
+	 * @param func 参数为(消息类型,统计数据)
+	 * @param bReset 遍历以后是否清零,用于按周期输出
+	 */
+	void VisitStat(const std::function<void(const E_MsgType, const MsgDispatchStat_st&)>& func, const bool bReset = false)
+	{
+		for (std::size_t i = 0; i < m_entryVec.size(); i++)
+		{
+			if (m_entryVec[i].m_stat.m_nCount > 0)
+			{
+				func(static_cast<E_MsgType>(i), m_entryVec[i].m_stat);
+				if (bReset)
+				{
+					m_entryVec[i].m_stat = MsgDispatchStat_st();
+				}
+			}
+		}
+	}
+private:
+	struct Entry_st
+	{
+		HandlerFunc m_handler;
+		MsgDispatchStat_st m_stat;
+	};
+
+	void SetHandler(const E_MsgType type, HandlerFunc handler)
+	{
+		std::size_t nIndex = static_cast<std::size_t>(type);
+		if (nIndex >= m_entryVec.size())
+		{
+			m_entryVec.resize(nIndex + 1);
+		}
+		m_entryVec[nIndex].m_handler = std::move(handler);
+	}
+
+	std::vector<Entry_st> m_entryVec;//按消息类型索引
+};
+#endif
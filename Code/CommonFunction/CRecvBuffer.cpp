@@ -0,0 +1,105 @@
+#include "CRecvBuffer.h"
+#include <algorithm>
+#include <string.h>
+
+CRecvBuffer::CRecvBuffer(const std::size_t nInitSize, const std::size_t nMaxFrameSize) :
+	m_pBlock(std::make_shared<std::vector<char>>(nInitSize)),
+	m_nInitSize(nInitSize),
+	m_nMaxFrameSize(std::max(nMaxFrameSize, nInitSize)),
+	m_nReadPos(0),
+	m_nWritePos(0),
+	m_bError(false)
+{
+}
+
+/**
+ * @brief 获取未完整接收的消息需要的长度
+ *
+ * @return std::size_t 消息头已经收全时为消息的长度,否则为消息头的长度
+ */
+std::size_t CRecvBuffer::PendingFrameSize() const
+{
+	if (ReadableSize() < sizeof(Header))
+	{
+		return sizeof(Header);
+	}
+	Header head;
+	memcpy(&head, m_pBlock->data() + m_nReadPos, sizeof(head));
+	return static_cast<std::size_t>(head.m_length);
+}
+
+/**
+ * @brief 准备下一次接收,数据块剩余空间不够时整理或者更换数据块
+ *
+ * @return char* 可写入的位置
+ */
+char* CRecvBuffer::PrepareWrite()
+{
+	bool bShared = m_pBlock.use_count() > 1;
+	if (m_nReadPos == m_nWritePos)
+	{
+		m_nReadPos = 0;
+		m_nWritePos = 0;
+		if (bShared)
+		{
+			//取出的消息还在使用旧的数据块
+			m_pBlock = std::make_shared<std::vector<char>>(m_nInitSize);
+		}
+	}
+	std::size_t nFrameSize = std::min(std::max(PendingFrameSize(), sizeof(Header)), m_nMaxFrameSize);
+	if (m_nWritePos < m_pBlock->size() && m_nReadPos + nFrameSize <= m_pBlock->size())
+	{
+		return m_pBlock->data() + m_nWritePos;
+	}
+
+	std::size_t nLength = ReadableSize();
+	if (!bShared && nFrameSize <= m_pBlock->size())
+	{
+		memmove(m_pBlock->data(), m_pBlock->data() + m_nReadPos, nLength);
+	}
+	else
+	{
+		auto pBlock = std::make_shared<std::vector<char>>(std::max(nFrameSize, m_nInitSize));
+		memcpy(pBlock->data(), m_pBlock->data() + m_nReadPos, nLength);
+		m_pBlock = pBlock;
+	}
+	m_nReadPos = 0;
+	m_nWritePos = nLength;
+	return m_pBlock->data() + m_nWritePos;
+}
+
+std::size_t CRecvBuffer::WritableSize() const
+{
+	return m_pBlock->size() - m_nWritePos;
+}
+
+void CRecvBuffer::CommitWrite(const std::size_t nLength)
+{
+	m_nWritePos = std::min(m_nWritePos + nLength, m_pBlock->size());
+}
+
+/**
+ * @brief 取出下一条完整的消息,消息直接引用数据块中的数据
+ *
+ * @return TransBaseMsg_S_PTR 完整的消息,数据不足或者消息非法时为nullptr
+ */
+TransBaseMsg_S_PTR CRecvBuffer::NextMsg()
+{
+	if (m_bError || ReadableSize() < sizeof(Header))
+	{
+		return nullptr;
+	}
+	std::size_t nFrameSize = PendingFrameSize();
+	if (nFrameSize < sizeof(Header) || nFrameSize > m_nMaxFrameSize)
+	{
+		m_bError = true;
+		return nullptr;
+	}
+	if (ReadableSize() < nFrameSize)
+	{
+		return nullptr;
+	}
+	auto pMsg = std::make_shared<TransBaseMsg_t>(m_pBlock, m_pBlock->data() + m_nReadPos);
+	m_nReadPos += nFrameSize;
+	return pMsg;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file CRecvBuffer.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief TCP接收缓冲区,消息在缓冲区中直接解析,取出的消息引用缓冲区的数据而不拷贝
+ * @version 0.1
+ * @date 2020-03-28
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_RECV_BUFFER_H_
+#define _DENNIS_THINK_C_RECV_BUFFER_H_
+#include "CommonMsg.h"
+#include <memory>
+#include <vector>
+
+/**
+ * @brief 接收缓冲区,由一个或多个数据块组成
+ *
+ * 取出的消息和缓冲区共享当前数据块,数据块不再被引用时才会被重用。
+ * 只有剩余空间放不下未完整接收的消息时,才把未处理的数据移动到数据块开头,
+ * 如果数据块仍被消息引用或者长度不够,就换一个新的数据块。
+ */
+class CRecvBuffer
+{
+public:
+	explicit CRecvBuffer(const std::size_t nInitSize = MSG_DEFAULT_FRAME_SIZE, const std::size_t nMaxFrameSize = MSG_MAX_FRAME_SIZE);
+
+	//准备下一次接收,保证剩余空间可以放下未完整接收的消息,返回可写入的位置
+	char* PrepareWrite();
+
+	//可写入的长度,在PrepareWrite之后调用
+	std::size_t WritableSize() const;
+
+	//接收到nLength字节的数据
+	void CommitWrite(const std::size_t nLength);
+
+	//取出下一条完整的消息,数据不足或者消息非法时返回nullptr
+	TransBaseMsg_S_PTR NextMsg();
+
+	//是否收到了非法的消息头,收到以后连接应该关闭
+	bool HasError() const { return m_bError; }
+
+	//未处理的数据长度
+	std::size_t ReadableSize() const { return m_nWritePos - m_nReadPos; }
+
+	//当前数据块的长度
+	std::size_t Capacity() const { return m_pBlock->size(); }
+private:
+	//未完整接收的消息需要的长度,消息头还没有收全时为消息头的长度
+	std::size_t PendingFrameSize() const;
+
+	std::shared_ptr<std::vector<char>> m_pBlock;//当前数据块
+	std::size_t m_nInitSize;//新数据块的默认长度
+	std::size_t m_nMaxFrameSize;//单条消息的最大长度
+	std::size_t m_nReadPos;//未处理数据的开始位置
+	std::size_t m_nWritePos;//未处理数据的结束位置
+	bool m_bError;//是否收到了非法的消息头
+};
+#endif
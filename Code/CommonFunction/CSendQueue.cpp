@@ -0,0 +1,283 @@
+#include "CSendQueue.h"
+#include <algorithm>
+
+/**
+ * @brief 获取通知消息的合并标识,同一标识的通知只需要发送最新的一条
+ *
+ * @param msg 通知消息
+ * @return std::string 合并标识,不能合并时为空
+ */
+static std::string CoalesceKey(const TransBaseMsg_t& msg)
+{
+	std::string strKey = MsgType(msg.GetType());
+	switch (msg.GetType())
+	{
+	case E_MsgType::UpdateFriendListNotifyReq_Type:
+	case E_MsgType::UpdateGroupListNotifyReq_Type:
+	{
+		return strKey;
+	}break;
+	case E_MsgType::FriendStateChangeNotifyReq_Type:
+	{
+		FriendStateChangeNotifyReqMsg notifyMsg;
+		if (msg.DecodeMsg(notifyMsg))
+		{
+			return strKey + ":" + notifyMsg.m_strFriendId;
+		}
+	}break;
+	case E_MsgType::GroupMemberStateChangeNotifyReq_Type:
+	{
+		GroupMemberStateChangeNotifyReqMsg notifyMsg;
+		if (msg.DecodeMsg(notifyMsg))
+		{
+			return strKey + ":" + notifyMsg.m_strGroupId + ":" + notifyMsg.m_strMemberId;
+		}
+	}break;
+	case E_MsgType::FileTransProgressNotifyReq_Type:
+	{
+		FileTransProgressNotifyReqMsg notifyMsg;
+		if (msg.DecodeMsg(notifyMsg))
+		{
+			return strKey + ":" + notifyMsg.m_strOtherId + ":" + notifyMsg.m_strFileName;
+		}
+	}break;
+	default:
+	{
+	}break;
+	}
+	return "";
+}
+
+bool ParseSendQueuePolicy(const std::string& strPolicy, E_SEND_QUEUE_POLICY& policy)
+{
+	if (strPolicy == "drop")
+	{
+		policy = E_SEND_QUEUE_POLICY::DROP_NOTIFY;
+	}
+	else if (strPolicy == "coalesce")
+	{
+		policy = E_SEND_QUEUE_POLICY::COALESCE_NOTIFY;
+	}
+	else if (strPolicy == "disconnect")
+	{
+		policy = E_SEND_QUEUE_POLICY::DISCONNECT;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+std::string SendQueuePolicyName(const E_SEND_QUEUE_POLICY policy)
+{
+	switch (policy)
+	{
+	case E_SEND_QUEUE_POLICY::DROP_NOTIFY:
+	{
+		return "drop";
+	}break;
+	case E_SEND_QUEUE_POLICY::COALESCE_NOTIFY:
+	{
+		return "coalesce";
+	}break;
+	case E_SEND_QUEUE_POLICY::DISCONNECT:
+	{
+		return "disconnect";
+	}break;
+	}
+	return "unknown";
+}
+
+CSendQueue::CSendQueue(const SendQueueCfg_st& cfg) :
+	m_cfg(cfg),
+	m_nNextSeq(0),
+	m_bSending(false),
+	m_bOverload(false)
+{
+	m_cfg.m_nBatchCount = std::max<std::size_t>(m_cfg.m_nBatchCount, 1);
+	m_cfg.m_nLowBytes = std::min(m_cfg.m_nLowBytes, m_cfg.m_nHighBytes);
+	m_cfg.m_nLowCount = std::min(m_cfg.m_nLowCount, m_cfg.m_nHighCount);
+}
+
+/**
+ * @brief 过载时可以丢弃或者合并的消息,只包括可以由后续消息或者重新拉取恢复的通知
+ *
+ * @param type 消息类型
+ * @return true 可以丢弃
+ * @return false 不能丢弃
+ */
+bool CSendQueue::IsDroppableMsgType(const E_MsgType& type)
+{
+	return E_MsgType::FileTransProgressNotifyReq_Type == type ||
+		E_MsgType::UpdateFriendListNotifyReq_Type == type ||
+		E_MsgType::UpdateGroupListNotifyReq_Type == type ||
+		E_MsgType::FriendStateChangeNotifyReq_Type == type ||
+		E_MsgType::GroupMemberStateChangeNotifyReq_Type == type;
+}
+
+bool CSendQueue::AboveHighWater(const std::size_t nBytes, const std::size_t nCount) const
+{
+	return nBytes > m_cfg.m_nHighBytes || nCount > m_cfg.m_nHighCount;
+}
+
+bool CSendQueue::AboveHardLimit(const std::size_t nBytes, const std::size_t nCount) const
+{
+	return nBytes > 2 * m_cfg.m_nHighBytes || nCount > 2 * m_cfg.m_nHighCount;
+}
+
+/**
+ * @brief 加入一条待发送的消息,过载时按策略处理
+ *
+ * @param pMsg 待发送的消息
+ * @return E_SEND_QUEUE_PUSH 处理结果,START_SEND时调用方需要调用NextBatch开始发送,
+ *         OVERFLOW_CLOSE时消息没有加入队列,调用方应该断开连接
+ */
+E_SEND_QUEUE_PUSH CSendQueue::Push(const TransBaseMsg_S_PTR& pMsg)
+{
+	if (!pMsg)
+	{
+		return E_SEND_QUEUE_PUSH::DROPPED;
+	}
+	std::size_t nNewBytes = m_stat.m_nQueueBytes + pMsg->GetSize();
+	std::size_t nNewCount = m_msgQueue.size() + 1;
+	bool bDroppable = IsDroppableMsgType(pMsg->GetType());
+	std::string strCoalesceKey;
+	if (bDroppable && E_SEND_QUEUE_POLICY::COALESCE_NOTIFY == m_cfg.m_policy)
+	{
+		strCoalesceKey = CoalesceKey(*pMsg);
+	}
+	//单条消息总是可以排队,避免一条大消息直接触发过载
+	if (!m_bOverload && !m_msgQueue.empty() && AboveHighWater(nNewBytes, nNewCount))
+	{
+		m_bOverload = true;
+		m_stat.m_nOverloadCount++;
+	}
+	if (m_bOverload)
+	{
+		if (E_SEND_QUEUE_POLICY::DISCONNECT == m_cfg.m_policy)
+		{
+			return E_SEND_QUEUE_PUSH::OVERFLOW_CLOSE;
+		}
+		if (bDroppable)
+		{
+			if (!strCoalesceKey.empty() && Coalesce(pMsg, strCoalesceKey))
+			{
+				m_stat.m_nCoalesceCount++;
+				return E_SEND_QUEUE_PUSH::COALESCED;
+			}
+			if (E_SEND_QUEUE_POLICY::DROP_NOTIFY == m_cfg.m_policy)
+			{
+				m_stat.m_nDropCount++;
+				return E_SEND_QUEUE_PUSH::DROPPED;
+			}
+		}
+		if (AboveHardLimit(nNewBytes, nNewCount))
+		{
+			return E_SEND_QUEUE_PUSH::OVERFLOW_CLOSE;
+		}
+	}
+	Append(pMsg, strCoalesceKey);
+	if (m_bSending)
+	{
+		return E_SEND_QUEUE_PUSH::QUEUED;
+	}
+	m_bSending = true;
+	return E_SEND_QUEUE_PUSH::START_SEND;
+}
+
+void CSendQueue::Append(const TransBaseMsg_S_PTR& pMsg, const std::string& strCoalesceKey)
+{
+	QueueItem_st item;
+	item.m_pMsg = pMsg;
+	item.m_nSeq = m_nNextSeq++;
+	if (!strCoalesceKey.empty())
+	{
+		m_coalesceMap[strCoalesceKey] = item.m_nSeq;
+	}
+	m_msgQueue.push_back(item);
+	m_stat.m_nQueueBytes += pMsg->GetSize();
+	m_stat.m_nPeakBytes = std::max(m_stat.m_nPeakBytes, m_stat.m_nQueueBytes);
+}
+
+/**
+ * @brief 用新的通知替换队列中同一标识的通知,已经开始发送的通知不能替换
+ *
+ * @param pMsg 新的通知
+ * @param strCoalesceKey 合并标识
+ * @return true 已替换
+ * @return false 队列中没有同一标识的通知
+ */
+bool CSendQueue::Coalesce(const TransBaseMsg_S_PTR& pMsg, const std::string& strCoalesceKey)
+{
+	auto item = m_coalesceMap.find(strCoalesceKey);
+	if (item == m_coalesceMap.end())
+	{
+		return false;
+	}
+	//队列中的序号是连续的,可以直接计算位置
+	if (m_msgQueue.empty() || item->second < m_msgQueue.front().m_nSeq)
+	{
+		m_coalesceMap.erase(item);
+		return false;
+	}
+	auto& queueItem = m_msgQueue[static_cast<std::size_t>(item->second - m_msgQueue.front().m_nSeq)];
+	m_stat.m_nQueueBytes = m_stat.m_nQueueBytes - queueItem.m_pMsg->GetSize() + pMsg->GetSize();
+	queueItem.m_pMsg = pMsg;
+	return true;
+}
+
+/**
+ * @brief 按顺序取出下一批消息,条数和字节数都不超过限制,至少包含一条消息
+ *
+ * @return MsgBatch_S_PTR 下一批消息,在发送完成之前由调用方持有;队列为空时为nullptr
+ */
+CSendQueue::MsgBatch_S_PTR CSendQueue::NextBatch()
+{
+	if (m_msgQueue.empty())
+	{
+		m_coalesceMap.clear();
+		m_bSending = false;
+		return nullptr;
+	}
+	auto pBatch = std::make_shared<std::vector<TransBaseMsg_S_PTR>>();
+	pBatch->reserve(std::min(m_msgQueue.size(), m_cfg.m_nBatchCount));
+	std::size_t nBatchBytes = 0;
+	while (!m_msgQueue.empty() && pBatch->size() < m_cfg.m_nBatchCount)
+	{
+		std::size_t nMsgSize = m_msgQueue.front().m_pMsg->GetSize();
+		if (!pBatch->empty() && nBatchBytes + nMsgSize > m_cfg.m_nBatchBytes)
+		{
+			break;
+		}
+		nBatchBytes += nMsgSize;
+		pBatch->push_back(m_msgQueue.front().m_pMsg);
+		m_msgQueue.pop_front();
+	}
+	m_stat.m_nQueueBytes -= nBatchBytes;
+	m_stat.m_nSendCount += pBatch->size();
+	m_stat.m_nSendBytes += nBatchBytes;
+	m_stat.m_nBatchCount++;
+	if (m_bOverload && m_stat.m_nQueueBytes <= m_cfg.m_nLowBytes && m_msgQueue.size() <= m_cfg.m_nLowCount)
+	{
+		m_bOverload = false;
+	}
+	m_bSending = true;
+	return pBatch;
+}
+
+void CSendQueue::Clear()
+{
+	m_msgQueue.clear();
+	m_coalesceMap.clear();
+	m_stat.m_nQueueBytes = 0;
+	m_bSending = false;
+	m_bOverload = false;
+}
+
+SendQueueStat_st CSendQueue::Stat() const
+{
+	SendQueueStat_st stat = m_stat;
+	stat.m_nQueueCount = m_msgQueue.size();
+	return stat;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file CSendQueue.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief TCP发送队列,把排队的多条消息合并为一批,通过一次async_write发送
+ * @version 0.1
+ * @date 2020-04-04
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_SEND_QUEUE_H_
+#define _DENNIS_THINK_C_SEND_QUEUE_H_
+#include "CommonMsg.h"
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief 队列超过高水位以后的处理策略
+ *
+ */
+enum class E_SEND_QUEUE_POLICY
+{
+	DROP_NOTIFY,//丢弃可丢弃的通知消息
+	COALESCE_NOTIFY,//同一对象的通知消息只保留最新的一条
+	DISCONNECT,//直接断开连接
+};
+
+/**
+ * @brief 加入消息的结果
+ *
+ */
+enum class E_SEND_QUEUE_PUSH
+{
+	START_SEND,//之前没有在发送,调用方需要开始发送
+	QUEUED,//已加入队列,等待正在发送的批次完成
+	DROPPED,//超过高水位,通知消息被丢弃
+	COALESCED,//超过高水位,替换了队列中同一对象的通知消息
+	OVERFLOW_CLOSE,//队列超过上限,调用方应该断开连接
+};
+
+/**
+ * @brief 发送队列的配置,高低水位同时限制字节数和消息条数
+ *
+ */
+struct SendQueueCfg_st
+{
+	std::size_t m_nBatchCount = 64;//每批最多的消息条数,与asio一次writev的buffer个数一致
+	std::size_t m_nBatchBytes = 256 * 1024;//每批最多的字节数,单条消息超过时单独发送
+	std::size_t m_nHighBytes = 4 * 1024 * 1024;//高水位字节数,超过以后按策略处理新的消息
+	std::size_t m_nLowBytes = 1024 * 1024;//低水位字节数,回落到低水位以下恢复正常
+	std::size_t m_nHighCount = 4096;//高水位消息条数
+	std::size_t m_nLowCount = 1024;//低水位消息条数
+	E_SEND_QUEUE_POLICY m_policy = E_SEND_QUEUE_POLICY::DROP_NOTIFY;
+};
+
+/**
+ * @brief 发送队列的统计数据
+ *
+ */
+struct SendQueueStat_st
+{
+	std::size_t m_nQueueCount = 0;//排队等待发送的消息条数
+	std::size_t m_nQueueBytes = 0;//排队等待发送的字节数
+	std::size_t m_nPeakBytes = 0;//排队字节数的峰值
+	uint64_t m_nSendCount = 0;//已交给socket发送的消息条数
+	uint64_t m_nSendBytes = 0;//已交给socket发送的字节数
+	uint64_t m_nBatchCount = 0;//发送的批次数
+	uint64_t m_nDropCount = 0;//丢弃的通知消息条数
+	uint64_t m_nCoalesceCount = 0;//被合并的通知消息条数
+	uint64_t m_nOverloadCount = 0;//超过高水位的次数
+};
+
+//解析策略的配置,支持drop、coalesce和disconnect,无法识别时返回false
+bool ParseSendQueuePolicy(const std::string& strPolicy, E_SEND_QUEUE_POLICY& policy);
+
+//获取策略的名称,用于日志
+std::string SendQueuePolicyName(const E_SEND_QUEUE_POLICY policy);
+
+/**
+ * @brief 发送队列,同一时间只有一批消息在发送
+ *
+ * 每一批消息按顺序取出,发送方用消息自己的数据组成buffer序列,不拷贝到发送缓冲区。
+ * 队列不为空时一定处于发送状态,发送完成的回调负责取出下一批。
+ * 排队的数据超过高水位以后进入过载状态,回落到低水位以下才恢复,过载期间按配置的策略
+ * 处理可丢弃的通知消息;排队的数据达到高水位的两倍时,任何策略都要求断开连接。
+ */
+class CSendQueue
+{
+public:
+	using MsgBatch_S_PTR = std::shared_ptr<std::vector<TransBaseMsg_S_PTR>>;
+
+	explicit CSendQueue(const SendQueueCfg_st& cfg = SendQueueCfg_st());
+
+	//加入一条消息
+	E_SEND_QUEUE_PUSH Push(const TransBaseMsg_S_PTR& pMsg);
+
+	//取出下一批消息,队列为空时返回nullptr并结束发送状态
+	MsgBatch_S_PTR NextBatch();
+
+	//发送失败时丢弃未发送的消息,并结束发送状态
+	void Clear();
+
+	//是否有一批消息正在发送
+	bool IsSending() const { return m_bSending; }
+
+	//是否处于过载状态
+	bool IsOverload() const { return m_bOverload; }
+
+	//排队等待发送的消息条数,不包括正在发送的批次
+	std::size_t Size() const { return m_msgQueue.size(); }
+
+	//排队等待发送的字节数,不包括正在发送的批次
+	std::size_t Bytes() const { return m_stat.m_nQueueBytes; }
+
+	//统计数据
+	SendQueueStat_st Stat() const;
+
+	//过载时可以丢弃或合并的通知消息
+	static bool IsDroppableMsgType(const E_MsgType& type);
+private:
+	//排队的消息和它的序号,序号用于定位需要合并的消息
+	struct QueueItem_st
+	{
+		TransBaseMsg_S_PTR m_pMsg;
+		uint64_t m_nSeq;
+	};
+
+	bool AboveHighWater(const std::size_t nBytes, const std::size_t nCount) const;
+
+	bool AboveHardLimit(const std::size_t nBytes, const std::size_t nCount) const;
+
+	void Append(const TransBaseMsg_S_PTR& pMsg, const std::string& strCoalesceKey);
+
+	bool Coalesce(const TransBaseMsg_S_PTR& pMsg, const std::string& strCoalesceKey);
+
+	SendQueueCfg_st m_cfg;
+	std::deque<QueueItem_st> m_msgQueue;//等待发送的消息
+	std::map<std::string, uint64_t> m_coalesceMap;//可合并的消息在队列中的序号
+	uint64_t m_nNextSeq;//下一条消息的序号
+	SendQueueStat_st m_stat;
+	bool m_bSending;//是否有一批消息正在发送
+	bool m_bOverload;//是否处于过载状态
+};
+#endif
@@ -0,0 +1,47 @@
+#include "CUnReadMsgWindow.h"
+
+CUnReadMsgWindow::CUnReadMsgWindow(const int nWindowSize)
+	: m_nWindowSize(nWindowSize > 0 ? nWindowSize : 1)
+{
+}
+
+bool CUnReadMsgWindow::CanSend() const
+{
+	return static_cast<int>(m_inFlightSet.size()) < m_nWindowSize;
+}
+
+void CUnReadMsgWindow::OnSend(const std::string& strMsgId)
+{
+	m_inFlightSet.insert(strMsgId);
+}
+
+bool CUnReadMsgWindow::OnAck(const std::string& strMsgId)
+{
+	if (0 == m_inFlightSet.erase(strMsgId))
+	{
+		return false;
+	}
+	m_ackedVec.push_back(strMsgId);
+	return true;
+}
+
+bool CUnReadMsgWindow::NeedFlush() const
+{
+	if (m_ackedVec.empty())
+	{
+		return false;
+	}
+	return static_cast<int>(m_ackedVec.size()) >= m_nWindowSize || m_inFlightSet.empty();
+}
+
+std::vector<std::string> CUnReadMsgWindow::TakeAcked()
+{
+	std::vector<std::string> ackedVec;
+	ackedVec.swap(m_ackedVec);
+	return ackedVec;
+}
+
+bool CUnReadMsgWindow::IsIdle() const
+{
+	return m_inFlightSet.empty() && m_ackedVec.empty();
+}
@@ -0,0 +1,60 @@
+/**
+ * @file CUnReadMsgWindow.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 下发离线消息的窗口,允许多条消息同时在途,收到的确认攒够一批以后一起更新数据库
+ * @version 0.1
+ * @date 2020-04-18
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_UNREAD_MSG_WINDOW_H_
+#define _DENNIS_THINK_C_UNREAD_MSG_WINDOW_H_
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 离线消息的下发窗口,以消息ID记录已发送未确认和已确认未更新状态的消息
+ *
+ * 已确认的消息在数据库中仍然是未读,在TakeAcked取出并更新完成之前,
+ * 不能从数据库读取下一页未读消息,否则会重复下发。
+ */
+class CUnReadMsgWindow
+{
+public:
+	static const int DEFAULT_WINDOW_SIZE = 32;//默认同时在途的消息条数
+	static const int DEFAULT_PAGE_SIZE = 500;//默认每次从数据库读取的未读消息条数
+
+	explicit CUnReadMsgWindow(const int nWindowSize = DEFAULT_WINDOW_SIZE);
+
+	//窗口是否还可以发送新的消息
+	bool CanSend() const;
+
+	//记录已经发送的消息
+	void OnSend(const std::string& strMsgId);
+
+	//处理确认,不是本窗口发送的消息返回false
+	bool OnAck(const std::string& strMsgId);
+
+	//已确认的消息达到窗口大小,或者在途的消息全部确认以后,需要更新数据库
+	bool NeedFlush() const;
+
+	//取出已确认的消息ID,用于一次更新数据库
+	std::vector<std::string> TakeAcked();
+
+	//没有在途的消息,也没有等待更新的消息
+	bool IsIdle() const;
+
+	int WindowSize() const { return m_nWindowSize; }
+
+	int InFlightCount() const { return static_cast<int>(m_inFlightSet.size()); }
+
+	int AckedCount() const { return static_cast<int>(m_ackedVec.size()); }
+private:
+	int m_nWindowSize;//窗口大小,同时也是一次更新的条数
+	std::set<std::string> m_inFlightSet;//已发送未确认的消息
+	std::vector<std::string> m_ackedVec;//已确认未更新数据库的消息
+};
+#endif
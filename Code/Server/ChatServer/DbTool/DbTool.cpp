@@ -0,0 +1,379 @@
+/**
+ * @file DbTool.cpp
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 数据库工具,升级聊天表的结构和分区,离线导出恢复归档文件,测试按游标查询的耗时随表的增长的变化
+ * @version 0.1
+ * @date 2020-05-03
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "CommonFunction.h"
+#include "CMySqlConnect.h"
+#include "CChatArchive.h"
+#include "CChatPartition.h"
+
+const int64_t BENCH_SEED_ROWS = 1000;//初始插入的行数,以后每次复制已有的行
+const int64_t BENCH_COPY_ROWS = 1000000;//每条INSERT ... SELECT最多复制的行数
+const int64_t BENCH_USER_COUNT = 100000;//好友消息分布在多少个接收者上
+const int64_t BENCH_GROUP_COUNT = 1000;//群聊消息分布在多少个群组上
+const int64_t BENCH_PROBE_ID_BASE = 1000000000000000LL;//测试用户的未读消息ID,不在复制的范围内
+const int BENCH_PROBE_ROWS = 50;//每次查询读取的条数
+const int BENCH_REPEAT = 200;//每个查询重复的次数
+const std::string BENCH_PROBE_USER = "99999999";
+const std::string BENCH_PROBE_GROUP = "00000001";
+
+void PrintUsage()
+{
+	std::cout << "Usage: DbTool <ConfigFile> migrate" << std::endl;
+	std::cout << "       DbTool <ConfigFile> bench [MaxRows]" << std::endl;
+	std::cout << "       DbTool <ConfigFile> partition" << std::endl;
+	std::cout << "       DbTool <ConfigFile> archive <HotMonths> [ArchiveDir]" << std::endl;
+	std::cout << "       DbTool <ConfigFile> export <Table> <Partition> <ArchiveFile>" << std::endl;
+	std::cout << "       DbTool <ConfigFile> restore <ArchiveFile>" << std::endl;
+	std::cout << "       DbTool <ConfigFile> dump <ArchiveFile>" << std::endl;
+	std::cout << "  migrate    convert chat message ids to BIGINT UNSIGNED and add cursor indexes" << std::endl;
+	std::cout << "  partition  partition unpartitioned chat tables by month of message id" << std::endl;
+	std::cout << "  archive    export partitions older than HotMonths to ArchiveDir (default archive) and drop them" << std::endl;
+	std::cout << "  export     export one partition to a file without dropping it" << std::endl;
+	std::cout << "  restore    insert the messages of an archive file back, existing ones are skipped" << std::endl;
+	std::cout << "  dump       print the messages of an archive file as json lines, no database needed" << std::endl;
+	std::cout << "  bench      fill an EMPTY database up to MaxRows (default 100000000) chat messages" << std::endl;
+	std::cout << "             and print the cursor query latency at every power of ten" << std::endl;
+}
+
+/**
+ * @brief 查询的耗时统计,单位微秒
+ *
+ */
+struct BenchCost_st
+{
+	int64_t m_nAvgUs = 0;
+	int64_t m_nP99Us = 0;
+	std::size_t m_nRows = 0;//最后一次查询返回的行数
+};
+
+template<typename Query>
+BenchCost_st MeasureQuery(Query query)
+{
+	BenchCost_st cost;
+	std::vector<int64_t> costVec;
+	for (int i = 0; i < BENCH_REPEAT; i++)
+	{
+		auto beginTime = std::chrono::steady_clock::now();
+		cost.m_nRows = query();
+		costVec.push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - beginTime).count());
+	}
+	std::sort(costVec.begin(), costVec.end());
+	int64_t nTotal = 0;
+	for (const auto& item : costVec)
+	{
+		nTotal += item;
+	}
+	cost.m_nAvgUs = nTotal / static_cast<int64_t>(costVec.size());
+	cost.m_nP99Us = costVec[costVec.size() * 99 / 100];
+	return cost;
+}
+
+/**
+ * @brief 复制已有的行,使两个聊天表的行数增长到nTarget,消息ID从1开始连续
+ *
+ * @param util 数据库连接
+ * @param nCurRows 当前的行数
+ * @param nTarget 目标行数
+ */
+bool GrowChatTables(CMySqlConnect& util, int64_t& nCurRows, const int64_t nTarget)
+{
+	while (nCurRows < nTarget)
+	{
+		int64_t nCopy = std::min(std::min(nCurRows, nTarget - nCurRows), BENCH_COPY_ROWS);
+		std::string strOffset = std::to_string(nCurRows);
+		std::string strRange = " BETWEEN 1 AND " + std::to_string(nCopy) + ";";
+		std::string strFriendSql = "INSERT INTO T_FRIEND_CHAT_MSG(F_MSG_ID,F_MSG_TYPE,F_FROM_ID,F_TO_ID,F_MSG_CONTEXT,F_READ_FLAG) "
+			"SELECT F_MSG_ID+" + strOffset + ",F_MSG_TYPE,F_FROM_ID,LPAD((F_MSG_ID+" + strOffset + ")%" + std::to_string(BENCH_USER_COUNT) + ",8,'0'),F_MSG_CONTEXT,'READ' "
+			"FROM T_FRIEND_CHAT_MSG WHERE F_MSG_ID" + strRange;
+		std::string strGroupSql = "INSERT INTO T_GROUP_CHAT_MSG(F_MSG_ID,F_MSG_TYPE,F_SENDER_ID,F_GROUP_ID,F_MSG_CONTEXT) "
+			"SELECT F_MSG_ID+" + strOffset + ",F_MSG_TYPE,F_SENDER_ID,LPAD((F_MSG_ID+" + strOffset + ")%" + std::to_string(BENCH_GROUP_COUNT) + ",8,'0'),F_MSG_CONTEXT "
+			"FROM T_GROUP_CHAT_MSG WHERE F_MSG_ID" + strRange;
+		if (!util.ExecuteSql(strFriendSql) || !util.ExecuteSql(strGroupSql))
+		{
+			return false;
+		}
+		nCurRows += nCopy;
+	}
+	return true;
+}
+
+/**
+ * @brief 在空的数据库中填充聊天消息,每增长10倍测试一次服务器使用的游标查询
+ *
+ * 好友表测试接收者的未读消息,群聊表测试从接近最新的位置读取一页消息。
+ * 有索引时两个查询都只读取返回的行,耗时不随表的行数增长。
+ */
+int RunBench(CMySqlConnect& util, const int64_t nMaxRows)
+{
+	int64_t nFriendRows = 0;
+	int64_t nGroupRows = 0;
+	if (!util.SelectCount("SELECT COUNT(*) FROM T_FRIEND_CHAT_MSG;", nFriendRows) ||
+		!util.SelectCount("SELECT COUNT(*) FROM T_GROUP_CHAT_MSG;", nGroupRows))
+	{
+		return 1;
+	}
+	if (nFriendRows > 0 || nGroupRows > 0)
+	{
+		std::cout << "bench needs an empty database, the chat tables have " << nFriendRows << "/" << nGroupRows << " rows" << std::endl;
+		return 1;
+	}
+	if (!util.IsChatSchemaMigrated())
+	{
+		std::cout << "chat tables are not migrated, run 'DbTool <ConfigFile> migrate' first" << std::endl;
+		return 1;
+	}
+
+	std::string strTextType = ChatType(CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE);
+	std::string strSeq = "WITH RECURSIVE seq(n) AS (SELECT 1 UNION ALL SELECT n+1 FROM seq WHERE n<" + std::to_string(BENCH_SEED_ROWS) + ") ";
+	if (!util.ExecuteSql("INSERT INTO T_FRIEND_CHAT_MSG(F_MSG_ID,F_MSG_TYPE,F_FROM_ID,F_TO_ID,F_MSG_CONTEXT,F_READ_FLAG) " + strSeq +
+			"SELECT n,'" + strTextType + "','10000001',LPAD(n%" + std::to_string(BENCH_USER_COUNT) + ",8,'0'),REPEAT('x',64),'READ' FROM seq;") ||
+		!util.ExecuteSql("INSERT INTO T_GROUP_CHAT_MSG(F_MSG_ID,F_MSG_TYPE,F_SENDER_ID,F_GROUP_ID,F_MSG_CONTEXT) " + strSeq +
+			"SELECT n,'" + strTextType + "','10000001',LPAD(n%" + std::to_string(BENCH_GROUP_COUNT) + ",8,'0'),REPEAT('x',64) FROM seq;"))
+	{
+		return 1;
+	}
+	//测试用户的未读消息,使用复制范围以外的ID
+	for (int i = 1; i <= BENCH_PROBE_ROWS; i++)
+	{
+		util.ExecuteSql("INSERT INTO T_FRIEND_CHAT_MSG(F_MSG_ID,F_MSG_TYPE,F_FROM_ID,F_TO_ID,F_MSG_CONTEXT) VALUES(" +
+			std::to_string(BENCH_PROBE_ID_BASE + i) + ",'" + strTextType + "','10000001','" + BENCH_PROBE_USER + "','probe');");
+	}
+	int64_t nRows = BENCH_SEED_ROWS;
+
+	std::printf("%12s %18s %18s %18s\n", "Rows", "UnReadAvg/P99(us)", "UnReadEmpty(us)", "GroupPageAvg/P99(us)");
+	for (int64_t nCheckPoint = 10000; nCheckPoint <= nMaxRows; nCheckPoint *= 10)
+	{
+		auto beginTime = std::chrono::steady_clock::now();
+		if (!GrowChatTables(util, nRows, nCheckPoint))
+		{
+			std::cout << "fill chat tables failed at " << nRows << " rows" << std::endl;
+			return 1;
+		}
+		auto nFillSec = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - beginTime).count();
+		util.ExecuteSql("ANALYZE TABLE T_FRIEND_CHAT_MSG, T_GROUP_CHAT_MSG;");
+
+		std::vector<T_USER_CHAT_MSG> friendMsgVec;
+		auto unReadCost = MeasureQuery([&]() {
+			util.SelectUnReadFriendChatMsg(BENCH_PROBE_USER, BENCH_PROBE_ROWS, friendMsgVec);
+			return friendMsgVec.size();
+		});
+		//普通用户只有已读的消息,索引中没有匹配的行
+		auto emptyCost = MeasureQuery([&]() {
+			util.SelectUnReadFriendChatMsg(BENCH_PROBE_GROUP, BENCH_PROBE_ROWS, friendMsgVec);
+			return friendMsgVec.size();
+		});
+		//群组中最新的BENCH_PROBE_ROWS条消息之前的位置
+		std::string strCursor = std::to_string(std::max<int64_t>(0, nRows - BENCH_PROBE_ROWS * BENCH_GROUP_COUNT));
+		std::vector<T_GROUP_CHAT_MSG> groupMsgVec;
+		auto groupCost = MeasureQuery([&]() {
+			util.SelectGroupChatTextList(BENCH_PROBE_GROUP, strCursor, BENCH_PROBE_ROWS, groupMsgVec);
+			return groupMsgVec.size();
+		});
+		std::printf("%12lld %8lld/%-9lld %18lld %9lld/%-9lld rows:%zu/%zu/%zu fill:%llds\n",
+			static_cast<long long>(nRows),
+			static_cast<long long>(unReadCost.m_nAvgUs), static_cast<long long>(unReadCost.m_nP99Us),
+			static_cast<long long>(emptyCost.m_nAvgUs),
+			static_cast<long long>(groupCost.m_nAvgUs), static_cast<long long>(groupCost.m_nP99Us),
+			unReadCost.m_nRows, emptyCost.m_nRows, groupCost.m_nRows, static_cast<long long>(nFillSec));
+		std::fflush(stdout);
+	}
+	return 0;
+}
+
+/**
+ * @brief 给没有分区的聊天表分区,从最早的消息所在的月份到之后两个月每月一个分区
+ *
+ */
+int RunPartition(CMySqlConnect& util)
+{
+	int nResult = 0;
+	int nCurMonth = CChatPartition::CurrentMonthIndex();
+	for (const std::string strTable : { "T_FRIEND_CHAT_MSG", "T_GROUP_CHAT_MSG" })
+	{
+		std::vector<ChatPartition_st> partVec;
+		if (!util.SelectChatPartitions(strTable, partVec))
+		{
+			nResult = 1;
+			continue;
+		}
+		if (!partVec.empty())
+		{
+			std::cout << strTable << " already has " << partVec.size() << " partitions" << std::endl;
+			continue;
+		}
+		int64_t nMinMsgId = 0;
+		util.SelectCount("SELECT IFNULL(MIN(F_MSG_ID),0) FROM `" + strTable + "`;", nMinMsgId);
+		int nFirstMonth = std::min(nCurMonth, CChatPartition::MonthIndexOfMsgId(static_cast<uint64_t>(nMinMsgId)));
+		bool bResult = util.PartitionChatTable(strTable, CChatPartition::MonthPartitions(nFirstMonth, nCurMonth + 2));
+		std::cout << strTable << " partition from " << CChatPartition::PartitionName(nFirstMonth) << (bResult ? " succeed" : " failed, see the log") << std::endl;
+		nResult = bResult ? nResult : 1;
+	}
+	return nResult;
+}
+
+/**
+ * @brief 打印归档文件中的消息,每条消息一行json
+ *
+ */
+int RunDump(const std::string& strPath)
+{
+	CChatArchiveReader reader;
+	if (!reader.Open(strPath))
+	{
+		std::cout << "open archive " << strPath << " failed" << std::endl;
+		return 1;
+	}
+	for (std::size_t i = 0; i < reader.Blocks().size(); i++)
+	{
+		if (E_ARCHIVE_KIND::E_ARCHIVE_FRIEND_MSG == reader.Kind())
+		{
+			std::vector<T_USER_CHAT_MSG> msgVec;
+			if (!reader.ReadBlock(i, msgVec))
+			{
+				std::cout << "block " << i << " is broken" << std::endl;
+				return 1;
+			}
+			for (const auto& item : msgVec)
+			{
+				std::cout << json11::Json(json11::Json::object({
+					{ "MsgId", item.m_strF_MSG_ID }, { "MsgType", ChatType(item.m_eChatMsgType) },
+					{ "FromId", item.m_strF_FROM_ID }, { "ToId", item.m_strF_TO_ID },
+					{ "Context", item.m_strF_MSG_CONTEXT }, { "OtherInfo", item.m_strF_OTHER_INFO },
+					{ "ReadFlag", item.m_strF_READ_FLAG }, { "CreateTime", item.m_strF_CREATE_TIME },
+				})).dump() << std::endl;
+			}
+		}
+		else
+		{
+			std::vector<T_GROUP_CHAT_MSG> msgVec;
+			if (!reader.ReadBlock(i, msgVec))
+			{
+				std::cout << "block " << i << " is broken" << std::endl;
+				return 1;
+			}
+			for (const auto& item : msgVec)
+			{
+				std::cout << json11::Json(json11::Json::object({
+					{ "MsgId", item.m_strF_MSG_ID }, { "MsgType", ChatType(item.m_eChatMsgType) },
+					{ "SenderId", item.m_strF_SENDER_ID }, { "GroupId", item.m_strF_GROUP_ID },
+					{ "Context", item.m_strF_MSG_CONTEXT }, { "OtherInfo", item.m_strF_OTHER_INFO },
+					{ "CreateTime", item.m_strF_CREATE_TIME },
+				})).dump() << std::endl;
+			}
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		PrintUsage();
+		return 1;
+	}
+	std::string strcfg, errinfo;
+	load_txtfile(argv[1], strcfg);
+	if (!strcfg.length())
+	{
+		std::cout << "no Configure" << std::endl;
+		return 1;
+	}
+	auto cfg = json11::Json::parse(strcfg, errinfo, json11::JsonParse::COMMENTS);
+	auto logger = CreateLogger(cfg);
+	if (!logger)
+	{
+		std::cout << "Can not Create Logger" << std::endl;
+		return 1;
+	}
+	CMySqlConnect::m_loger = logger;
+	CChatArchive::ms_loger = logger;
+
+	std::string strCmd = argv[2];
+	if (strCmd == "dump" && argc > 3)
+	{
+		return RunDump(argv[3]);
+	}
+
+	auto mysqlCfg = cfg["mysql"];
+	CMySqlConnect util;
+	if (!util.ConnectToServer(mysqlCfg["username"].string_value(),
+		mysqlCfg["password"].string_value(),
+		mysqlCfg["dbname"].string_value(),
+		mysqlCfg["ip"].string_value(),
+		mysqlCfg["port"].is_number() ? mysqlCfg["port"].int_value() : 3306))
+	{
+		std::cout << "Connect To Database Failed" << std::endl;
+		return 1;
+	}
+
+	if (strCmd == "migrate")
+	{
+		bool bResult = util.MigrateChatSchema();
+		std::cout << "migrate " << (bResult ? "succeed" : "failed, see the log") << std::endl;
+		return bResult ? 0 : 1;
+	}
+	if (strCmd == "partition")
+	{
+		return RunPartition(util);
+	}
+	if (strCmd == "archive" && argc > 3)
+	{
+		CChatArchive archive;
+		if (!archive.Open(argc > 4 ? argv[4] : "archive"))
+		{
+			std::cout << "open archive dir failed" << std::endl;
+			return 1;
+		}
+		bool bResult = archive.Maintain(util, std::max(1, std::atoi(argv[3])), 2);
+		std::cout << "archive " << (bResult ? "succeed" : "failed, see the log") << std::endl;
+		return bResult ? 0 : 1;
+	}
+	if (strCmd == "export" && argc > 5)
+	{
+		int nMonth = 0;
+		uint64_t nRows = 0;
+		if (!CChatPartition::ParsePartitionName(argv[4], nMonth))
+		{
+			std::cout << "unknown partition " << argv[4] << std::endl;
+			return 1;
+		}
+		bool bResult = CChatArchive::ExportPartition(util, argv[3], argv[4], argv[5], nRows);
+		std::cout << "export " << nRows << " rows " << (bResult ? "succeed" : "failed, see the log") << std::endl;
+		return bResult ? 0 : 1;
+	}
+	if (strCmd == "restore" && argc > 3)
+	{
+		uint64_t nRows = 0;
+		bool bResult = CChatArchive::RestoreArchive(util, argv[3], nRows);
+		std::cout << "restore " << nRows << " rows " << (bResult ? "succeed" : "failed, see the log") << std::endl;
+		if (bResult)
+		{
+			//恢复以后的消息从数据库读取,不再放在服务器的归档目录中
+			std::string strPath = argv[3];
+			std::rename(strPath.c_str(), (strPath + ".restored").c_str());
+		}
+		return bResult ? 0 : 1;
+	}
+	if (strCmd == "bench")
+	{
+		int64_t nMaxRows = (argc > 3) ? std::stoll(argv[3]) : 100000000LL;
+		return RunBench(util, nMaxRows);
+	}
+	PrintUsage();
+	return 1;
+}
@@ -0,0 +1,460 @@
+#include "CBlobStore.h"
+#include <fstream>
+#include <vector>
+#include "json11.hpp"
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+const std::string CBlobStore::INDEX_FILE_NAME = "blob.index";
+const std::string CBlobStore::TEMP_DIR_NAME = "tmp";
+const std::size_t CBlobStore::KEY_HASH_LENGTH;
+
+static void MakeDir(const std::string& strDir)
+{
+#ifdef _WIN32
+	_mkdir(strDir.c_str());
+#else
+	mkdir(strDir.c_str(), 0755);
+#endif
+}
+
+//文件大小,文件不存在时返回-1
+static int64_t BlobFileSize(const std::string& strPath)
+{
+	std::FILE* pFile = std::fopen(strPath.c_str(), "rb");
+	if (nullptr == pFile)
+	{
+		return -1;
+	}
+	int64_t nSize = -1;
+	if (0 == std::fseek(pFile, 0, SEEK_END))
+	{
+		nSize = static_cast<int64_t>(std::ftell(pFile));
+	}
+	std::fclose(pFile);
+	return nSize;
+}
+
+static std::string LinkRecord(const std::string& strName, const BlobInfo_st& blob)
+{
+	json11::Json::object recordObj({
+		{ "Op", "Link" },
+		{ "Name", strName },
+		{ "Hash", blob.m_strHash },
+		{ "Size", static_cast<double>(blob.m_nSize) },
+	});
+	if (!blob.m_strMd5.empty())
+	{
+		recordObj["Md5"] = blob.m_strMd5;
+	}
+	return json11::Json(recordObj).dump();
+}
+
+static std::string UnlinkRecord(const std::string& strName)
+{
+	json11::Json recordObj = json11::Json::object({
+		{ "Op", "Unlink" },
+		{ "Name", strName },
+	});
+	return recordObj.dump();
+}
+
+std::string BlobStat_st::ToString() const
+{
+	return "Blobs:" + std::to_string(m_nBlobs) +
+		" Names:" + std::to_string(m_nNames) +
+		" Bytes:" + std::to_string(m_nBytes) +
+		" DedupBytes:" + std::to_string(m_nDedupBytes);
+}
+
+CBlobStore::CBlobStore()
+	: m_pIndex(nullptr)
+{
+}
+
+CBlobStore::~CBlobStore()
+{
+	Close();
+}
+
+bool CBlobStore::Open(const std::string& strDir)
+{
+	Close();
+	m_strDir = strDir;
+	MakeDir(m_strDir);
+	MakeDir(m_strDir + "/" + TEMP_DIR_NAME);
+	LoadIndex();
+	//索引中有记录但是文件已经不存在的内容不再使用
+	std::vector<std::string> lostVec;
+	for (const auto& item : m_blobMap)
+	{
+		if (BlobFileSize(BlobPath(item.first)) != item.second.m_nSize)
+		{
+			lostVec.push_back(item.first);
+		}
+	}
+	for (const auto& strHash : lostVec)
+	{
+		m_md5Map.erase(m_blobMap[strHash].m_strMd5);
+		m_blobMap.erase(strHash);
+	}
+	if (!lostVec.empty())
+	{
+		auto item = m_nameMap.begin();
+		while (item != m_nameMap.end())
+		{
+			if (m_blobMap.find(item->second) == m_blobMap.end())
+			{
+				item = m_nameMap.erase(item);
+			}
+			else
+			{
+				item++;
+			}
+		}
+	}
+	return RewriteIndex();
+}
+
+void CBlobStore::Close()
+{
+	if (nullptr != m_pIndex)
+	{
+		std::fclose(m_pIndex);
+		m_pIndex = nullptr;
+	}
+	m_blobMap.clear();
+	m_nameMap.clear();
+	m_md5Map.clear();
+}
+
+bool CBlobStore::IsValidHash(const std::string& strHash)
+{
+	if (strHash.length() < 16 || strHash.length() > 128)
+	{
+		return false;
+	}
+	return strHash.find_first_not_of("0123456789abcdefABCDEF") == std::string::npos;
+}
+
+std::string CBlobStore::NormalizeHash(const std::string& strHash)
+{
+	std::string strResult = strHash;
+	for (auto& ch : strResult)
+	{
+		if (ch >= 'A' && ch <= 'F')
+		{
+			ch = static_cast<char>(ch - 'A' + 'a');
+		}
+	}
+	return strResult;
+}
+
+bool CBlobStore::IsValidName(const std::string& strName)
+{
+	if (strName.empty() || strName.length() > 255 || strName == "." || strName == "..")
+	{
+		return false;
+	}
+	return strName.find_first_of(std::string("/\\:\0", 4)) == std::string::npos;
+}
+
+std::string CBlobStore::BlobPath(const std::string& strHash) const
+{
+	return m_strDir + "/" + strHash.substr(0, 2) + "/" + strHash;
+}
+
+std::string CBlobStore::TempPath(const std::string& strName) const
+{
+	return m_strDir + "/" + TEMP_DIR_NAME + "/" + strName;
+}
+
+std::string CBlobStore::IndexPath() const
+{
+	return m_strDir + "/" + INDEX_FILE_NAME;
+}
+
+const BlobInfo_st* CBlobStore::FindBlob(const std::string& strInHash) const
+{
+	const std::string strHash = NormalizeHash(strInHash);
+	auto item = m_blobMap.find(strHash);
+	if (item == m_blobMap.end())
+	{
+		auto md5Item = m_md5Map.find(strHash);
+		if (md5Item == m_md5Map.end())
+		{
+			return nullptr;
+		}
+		item = m_blobMap.find(md5Item->second);
+	}
+	return item == m_blobMap.end() ? nullptr : &item->second;
+}
+
+bool CBlobStore::FindName(const std::string& strName, std::string& strHash) const
+{
+	auto item = m_nameMap.find(strName);
+	if (item == m_nameMap.end())
+	{
+		return false;
+	}
+	strHash = item->second;
+	return true;
+}
+
+bool CBlobStore::Link(const std::string& strName, const std::string& strInHash)
+{
+	if (!IsValidName(strName) || !IsValidHash(strInHash))
+	{
+		return false;
+	}
+	const BlobInfo_st* pBlob = FindBlob(strInHash);
+	if (nullptr == pBlob)
+	{
+		return false;
+	}
+	//文件名是全局的,改为引用其他内容会让已经发送的消息指向新的内容
+	auto nameItem = m_nameMap.find(strName);
+	if (nameItem != m_nameMap.end())
+	{
+		return nameItem->second == pBlob->m_strHash;
+	}
+	const BlobInfo_st blob = *pBlob;
+	if (!WriteRecord(LinkRecord(strName, blob)))
+	{
+		return false;
+	}
+	ApplyLink(strName, blob.m_strHash, blob.m_nSize, blob.m_strMd5);
+	return true;
+}
+
+bool CBlobStore::Commit(const std::string& strPath, const std::string& strName, const std::string& strInHash, const std::string& strMd5)
+{
+	//新保存的内容都按BLAKE2b保存
+	if (!IsOpen() || !IsValidName(strName) || !IsValidHash(strInHash) || strInHash.length() != KEY_HASH_LENGTH ||
+		(!strMd5.empty() && !IsValidHash(strMd5)))
+	{
+		return false;
+	}
+	const std::string strHash = NormalizeHash(strInHash);
+	auto nameItem = m_nameMap.find(strName);
+	if (nameItem != m_nameMap.end() && nameItem->second != strHash)
+	{
+		return false;
+	}
+	const int64_t nSize = BlobFileSize(strPath);
+	if (nSize < 0)
+	{
+		return false;
+	}
+	auto blobItem = m_blobMap.find(strHash);
+	if (blobItem != m_blobMap.end())
+	{
+		//Hash相同而大小不同,不当作相同的内容
+		if (blobItem->second.m_nSize != nSize || !Link(strName, strHash))
+		{
+			return false;
+		}
+		std::remove(strPath.c_str());
+		return true;
+	}
+
+	//上次移动以后没有写入索引的文件,内容相同,直接使用
+	const std::string strBlobPath = BlobPath(strHash);
+	bool bMoved = false;
+	if (BlobFileSize(strBlobPath) != nSize)
+	{
+		MakeDir(m_strDir + "/" + strHash.substr(0, 2));
+		std::remove(strBlobPath.c_str());
+		if (0 != std::rename(strPath.c_str(), strBlobPath.c_str()))
+		{
+			return false;
+		}
+		bMoved = true;
+	}
+	BlobInfo_st blob;
+	blob.m_strHash = strHash;
+	blob.m_strMd5 = NormalizeHash(strMd5);
+	blob.m_nSize = nSize;
+	if (!WriteRecord(LinkRecord(strName, blob)))
+	{
+		if (bMoved)
+		{
+			std::rename(strBlobPath.c_str(), strPath.c_str());
+		}
+		return false;
+	}
+	if (!bMoved)
+	{
+		std::remove(strPath.c_str());
+	}
+	ApplyLink(strName, strHash, nSize, blob.m_strMd5);
+	return true;
+}
+
+bool CBlobStore::Unlink(const std::string& strName)
+{
+	if (m_nameMap.find(strName) == m_nameMap.end() || !WriteRecord(UnlinkRecord(strName)))
+	{
+		return false;
+	}
+	ApplyUnlink(strName);
+	return true;
+}
+
+BlobStat_st CBlobStore::Stat() const
+{
+	BlobStat_st stat;
+	stat.m_nBlobs = m_blobMap.size();
+	stat.m_nNames = m_nameMap.size();
+	for (const auto& item : m_blobMap)
+	{
+		stat.m_nBytes += item.second.m_nSize;
+		if (item.second.m_nRefCount > 1)
+		{
+			stat.m_nDedupBytes += item.second.m_nSize * (item.second.m_nRefCount - 1);
+		}
+	}
+	return stat;
+}
+
+/**
+ * @brief 写入一条索引记录并刷新到操作系统
+ *
+ */
+bool CBlobStore::WriteRecord(const std::string& strLine)
+{
+	if (nullptr == m_pIndex)
+	{
+		return false;
+	}
+	std::string strData = strLine + "\n";
+	return std::fwrite(strData.data(), 1, strData.length(), m_pIndex) == strData.length() && 0 == std::fflush(m_pIndex);
+}
+
+/**
+ * @brief 文件名引用内容,原来引用的内容引用数减1
+ *
+ * Link和Commit不会改变文件名引用的内容,只有重放旧版本写入的索引时才会出现
+ *
+ */
+void CBlobStore::ApplyLink(const std::string& strName, const std::string& strHash, const int64_t nSize, const std::string& strMd5)
+{
+	auto nameItem = m_nameMap.find(strName);
+	if (nameItem != m_nameMap.end() && nameItem->second == strHash)
+	{
+		return;
+	}
+	ApplyUnlink(strName);
+	auto& blob = m_blobMap[strHash];
+	blob.m_strHash = strHash;
+	blob.m_nSize = nSize;
+	blob.m_nRefCount++;
+	if (blob.m_strMd5.empty() && !strMd5.empty() && strMd5 != strHash)
+	{
+		blob.m_strMd5 = strMd5;
+		m_md5Map[strMd5] = strHash;
+	}
+	m_nameMap[strName] = strHash;
+}
+
+/**
+ * @brief 删除文件名,内容的引用数为0时删除内容,加载索引时文件已经删除过
+ *
+ */
+void CBlobStore::ApplyUnlink(const std::string& strName)
+{
+	auto nameItem = m_nameMap.find(strName);
+	if (nameItem == m_nameMap.end())
+	{
+		return;
+	}
+	auto blobItem = m_blobMap.find(nameItem->second);
+	m_nameMap.erase(nameItem);
+	if (blobItem != m_blobMap.end() && --blobItem->second.m_nRefCount == 0)
+	{
+		if (IsOpen())
+		{
+			std::remove(BlobPath(blobItem->first).c_str());
+		}
+		m_md5Map.erase(blobItem->second.m_strMd5);
+		m_blobMap.erase(blobItem);
+	}
+}
+
+/**
+ * @brief 重放索引文件,进程崩溃时最后一行可能不完整,跳过不能解析的行
+ *
+ */
+bool CBlobStore::LoadIndex()
+{
+	std::ifstream inFile(IndexPath(), std::ios::binary);
+	if (!inFile.is_open())
+	{
+		return false;
+	}
+	std::string strLine;
+	while (std::getline(inFile, strLine))
+	{
+		std::string err;
+		auto pJson = json11::Json::parse(strLine, err);
+		if (!err.empty())
+		{
+			continue;
+		}
+		const std::string strName = pJson["Name"].string_value();
+		if (pJson["Op"].string_value() == "Link" && IsValidName(strName) && IsValidHash(pJson["Hash"].string_value()))
+		{
+			//旧版本的记录没有MD5
+			const std::string strMd5 = IsValidHash(pJson["Md5"].string_value()) ? NormalizeHash(pJson["Md5"].string_value()) : "";
+			ApplyLink(strName, NormalizeHash(pJson["Hash"].string_value()), static_cast<int64_t>(pJson["Size"].number_value()), strMd5);
+		}
+		else if (pJson["Op"].string_value() == "Unlink")
+		{
+			ApplyUnlink(strName);
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief 只保留有效的Link记录重写索引文件,然后打开用于追加
+ *
+ */
+bool CBlobStore::RewriteIndex()
+{
+	const std::string strTmpPath = IndexPath() + ".tmp";
+	std::FILE* pFile = std::fopen(strTmpPath.c_str(), "wb");
+	if (nullptr == pFile)
+	{
+		return false;
+	}
+	bool bResult = true;
+	for (const auto& item : m_nameMap)
+	{
+		std::string strData = LinkRecord(item.first, m_blobMap[item.second]) + "\n";
+		if (std::fwrite(strData.data(), 1, strData.length(), pFile) != strData.length())
+		{
+			bResult = false;
+			break;
+		}
+	}
+	bResult = (0 == std::fclose(pFile)) && bResult;
+	if (bResult)
+	{
+#ifdef _WIN32
+		std::remove(IndexPath().c_str());
+#endif
+		bResult = (0 == std::rename(strTmpPath.c_str(), IndexPath().c_str()));
+	}
+	if (!bResult)
+	{
+		std::remove(strTmpPath.c_str());
+		return false;
+	}
+	m_pIndex = std::fopen(IndexPath().c_str(), "ab");
+	return nullptr != m_pIndex;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file CBlobStore.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 按内容Hash保存的图片和文件,相同内容只保存一份
+ * @version 0.1
+ * @date 2020-05-23
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_BLOB_STORE_H_
+#define _DENNIS_THINK_C_BLOB_STORE_H_
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief 一份文件内容
+ *
+ */
+struct BlobInfo_st
+{
+	std::string m_strHash;//文件内容的Hash,也是保存的文件名
+	std::string m_strMd5;//文件内容的MD5,用于旧版本的客户端,没有记录时为空
+	int64_t m_nSize = 0;//文件大小
+	uint32_t m_nRefCount = 0;//引用这份内容的文件名个数
+};
+
+/**
+ * @brief 存储的统计
+ *
+ */
+struct BlobStat_st
+{
+	std::size_t m_nBlobs = 0;//保存的文件个数
+	std::size_t m_nNames = 0;//文件名个数
+	int64_t m_nBytes = 0;//实际占用的字节数
+	int64_t m_nDedupBytes = 0;//相同内容没有重复保存而节省的字节数
+
+	std::string ToString() const;
+};
+
+/**
+ * @brief 按内容Hash保存文件的存储
+ *
+ * 文件保存在 目录/Hash前两位/Hash 中,聊天消息中的文件名通过索引找到对应的Hash。
+ * 新保存的内容使用BLAKE2b-256作为Hash,同时记录MD5,查找时两种Hash都可以使用;旧版本按MD5保存的内容不变。
+ * 上传时先写入 目录/tmp/文件名,校验通过以后Commit移动到Hash对应的位置,已经有相同内容时删除临时文件。
+ * 上传开始时Hash已经存在的,Link以后直接完成上传,不再传输数据。
+ * 索引文件每行一条json记录,Link记录文件名对应的Hash,Unlink删除文件名,引用数为0时删除文件。
+ * Open时重放索引并重写为只有有效记录的新文件。没有加锁,只在CChatServer的strand上使用。
+ */
+class CBlobStore
+{
+public:
+	static const std::string INDEX_FILE_NAME;
+	static const std::string TEMP_DIR_NAME;
+	static const std::size_t KEY_HASH_LENGTH = 64;//BLAKE2b-256的十六进制长度
+
+	CBlobStore();
+	~CBlobStore();
+
+	/**
+	 * @brief 打开存储目录,加载索引
+	 *
+	 * @param strDir 存储目录,不存在时创建
+	 * @return true 打开成功
+	 * @return false 打开失败,调用者按文件名保存文件
+	 */
+	bool Open(const std::string& strDir);
+
+	void Close();
+
+	bool IsOpen() const { return nullptr != m_pIndex; }
+
+	//Hash为十六进制字符串,统一转换为小写
+	static bool IsValidHash(const std::string& strHash);
+	static std::string NormalizeHash(const std::string& strHash);
+
+	//文件名不能为空,不能包含路径
+	static bool IsValidName(const std::string& strName);
+
+	//Hash对应的文件路径
+	std::string BlobPath(const std::string& strHash) const;
+
+	//上传时临时文件的路径
+	std::string TempPath(const std::string& strName) const;
+
+	//查找Hash或者MD5对应的内容,没有时返回nullptr
+	const BlobInfo_st* FindBlob(const std::string& strHash) const;
+
+	//查找文件名对应的Hash
+	bool FindName(const std::string& strName, std::string& strHash) const;
+
+	/**
+	 * @brief 文件名引用已经保存的内容,用于秒传
+	 *
+	 * @param strName 文件名
+	 * @param strHash 文件内容的Hash或者MD5
+	 * @return true 引用成功
+	 * @return false 没有该Hash的内容,需要上传;或者文件名已经引用其他内容
+	 */
+	bool Link(const std::string& strName, const std::string& strHash);
+
+	/**
+	 * @brief 上传完成并且校验通过的文件放入存储
+	 *
+	 * @param strPath 上传的文件,成功以后不再存在
+	 * @param strName 文件名
+	 * @param strHash 已经校验过的文件内容的BLAKE2b
+	 * @param strMd5 文件内容的MD5,可以为空
+	 * @return true 保存成功
+	 * @return false 保存失败或者文件名已经引用其他内容,上传的文件保持不变
+	 */
+	bool Commit(const std::string& strPath, const std::string& strName, const std::string& strHash, const std::string& strMd5);
+
+	//删除文件名,内容的引用数为0时删除文件
+	bool Unlink(const std::string& strName);
+
+	BlobStat_st Stat() const;
+
+	std::string IndexPath() const;
+private:
+	bool WriteRecord(const std::string& strLine);
+	void ApplyLink(const std::string& strName, const std::string& strHash, const int64_t nSize, const std::string& strMd5);
+	void ApplyUnlink(const std::string& strName);
+	bool LoadIndex();
+	bool RewriteIndex();
+
+	std::string m_strDir;
+	std::FILE* m_pIndex;
+	std::unordered_map<std::string, BlobInfo_st> m_blobMap;//Hash到内容
+	std::unordered_map<std::string, std::string> m_nameMap;//文件名到Hash
+	std::unordered_map<std::string, std::string> m_md5Map;//MD5到Hash
+};
+#endif
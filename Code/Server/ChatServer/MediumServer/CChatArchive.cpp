@@ -0,0 +1,970 @@
+#include "CChatArchive.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include "CChatPartition.h"
+#include "CMySqlConnect.h"
+#ifdef _WIN32
+#include <io.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+std::shared_ptr<spdlog::logger> CChatArchive::ms_loger = nullptr;
+const std::string CChatArchive::FILE_SUFFIX = ".archive";
+
+const char ARCHIVE_HEAD_MAGIC[] = "TIMCHAT1";
+const char ARCHIVE_TAIL_MAGIC[] = "TIMCHATE";
+const std::size_t ARCHIVE_MAGIC_LEN = 8;
+const std::size_t ARCHIVE_HEAD_LEN = ARCHIVE_MAGIC_LEN + 1;//魔数和归档类型
+const std::size_t ARCHIVE_TAIL_LEN = 4 + ARCHIVE_MAGIC_LEN;//块索引长度和魔数
+const std::size_t ARCHIVE_BLOCK_HEAD_LEN = 8;//数据块长度和校验值
+const uint32_t ARCHIVE_MAX_BLOCK_LEN = 256 * 1024 * 1024;
+const int ARCHIVE_EXPORT_PAGE = 1000;//导出时每次从数据库读取的行数
+
+const uint8_t COLUMN_ENCODE_DICT = 1;//字典编码,适合用户ID、消息类型等重复多的列
+const uint8_t COLUMN_ENCODE_FRONT = 2;//和上一行的公共前缀长度加后缀,适合按顺序变化的时间
+
+//每种归档的字符串列数
+static std::size_t ColumnCount(const E_ARCHIVE_KIND kind)
+{
+	switch (kind)
+	{
+	case E_ARCHIVE_KIND::E_ARCHIVE_FRIEND_MSG:return 7;
+	case E_ARCHIVE_KIND::E_ARCHIVE_GROUP_MSG:return 6;
+	default:return 0;
+	}
+}
+
+static uint64_t MsgIdValue(const std::string& strMsgId)
+{
+	return std::strtoull(strMsgId.c_str(), nullptr, 10);
+}
+
+static void PutVarint(std::string& strBuff, uint64_t nValue)
+{
+	while (nValue >= 0x80)
+	{
+		strBuff.push_back(static_cast<char>((nValue & 0x7F) | 0x80));
+		nValue >>= 7;
+	}
+	strBuff.push_back(static_cast<char>(nValue));
+}
+
+static bool GetVarint(const char*& pData, const char* pEnd, uint64_t& nValue)
+{
+	nValue = 0;
+	for (int nShift = 0; nShift < 64 && pData < pEnd; nShift += 7)
+	{
+		uint8_t nByte = static_cast<uint8_t>(*pData++);
+		nValue |= static_cast<uint64_t>(nByte & 0x7F) << nShift;
+		if (0 == (nByte & 0x80))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static void PutFixed32(std::string& strBuff, const uint32_t nValue)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		strBuff.push_back(static_cast<char>((nValue >> (8 * i)) & 0xFF));
+	}
+}
+
+static uint32_t GetFixed32(const char* pData)
+{
+	uint32_t nValue = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		nValue |= static_cast<uint32_t>(static_cast<uint8_t>(pData[i])) << (8 * i);
+	}
+	return nValue;
+}
+
+static uint32_t BlockChecksum(const std::string& strData)
+{
+	uint32_t nHash = 2166136261U;
+	for (const auto& item : strData)
+	{
+		nHash ^= static_cast<uint8_t>(item);
+		nHash *= 16777619U;
+	}
+	return nHash;
+}
+
+static bool GetString(const char*& pData, const char* pEnd, std::string& strValue)
+{
+	uint64_t nLen = 0;
+	if (!GetVarint(pData, pEnd, nLen) || nLen > static_cast<uint64_t>(pEnd - pData))
+	{
+		return false;
+	}
+	strValue.assign(pData, static_cast<std::size_t>(nLen));
+	pData += nLen;
+	return true;
+}
+
+/**
+ * @brief 编码一个字符串列,字典编码和前缀编码中选择较小的一种
+ *
+ */
+static std::string EncodeColumn(const std::vector<std::string>& valueVec)
+{
+	std::string strDict(1, static_cast<char>(COLUMN_ENCODE_DICT));
+	{
+		std::map<std::string, uint64_t> dictMap;
+		std::vector<const std::string*> dictVec;
+		std::string strIndex;
+		for (const auto& item : valueVec)
+		{
+			auto pos = dictMap.insert({ item, dictVec.size() });
+			if (pos.second)
+			{
+				dictVec.push_back(&pos.first->first);
+			}
+			PutVarint(strIndex, pos.first->second);
+		}
+		PutVarint(strDict, dictVec.size());
+		for (const auto& item : dictVec)
+		{
+			PutVarint(strDict, item->length());
+			strDict.append(*item);
+		}
+		strDict.append(strIndex);
+	}
+	std::string strFront(1, static_cast<char>(COLUMN_ENCODE_FRONT));
+	{
+		const std::string* pPrev = nullptr;
+		for (const auto& item : valueVec)
+		{
+			std::size_t nShared = 0;
+			if (nullptr != pPrev)
+			{
+				std::size_t nMax = std::min(pPrev->length(), item.length());
+				while (nShared < nMax && (*pPrev)[nShared] == item[nShared])
+				{
+					nShared++;
+				}
+			}
+			PutVarint(strFront, nShared);
+			PutVarint(strFront, item.length() - nShared);
+			strFront.append(item, nShared, std::string::npos);
+			pPrev = &item;
+		}
+	}
+	return strDict.length() <= strFront.length() ? strDict : strFront;
+}
+
+static bool DecodeColumn(const char* pData, const char* pEnd, const std::size_t nRows, std::vector<std::string>& valueVec)
+{
+	valueVec.clear();
+	if (pData >= pEnd)
+	{
+		return false;
+	}
+	uint8_t nEncode = static_cast<uint8_t>(*pData++);
+	if (COLUMN_ENCODE_DICT == nEncode)
+	{
+		uint64_t nDictSize = 0;
+		if (!GetVarint(pData, pEnd, nDictSize) || nDictSize > static_cast<uint64_t>(pEnd - pData))
+		{
+			return false;
+		}
+		std::vector<std::string> dictVec(static_cast<std::size_t>(nDictSize));
+		for (auto& item : dictVec)
+		{
+			if (!GetString(pData, pEnd, item))
+			{
+				return false;
+			}
+		}
+		for (std::size_t i = 0; i < nRows; i++)
+		{
+			uint64_t nIndex = 0;
+			if (!GetVarint(pData, pEnd, nIndex) || nIndex >= dictVec.size())
+			{
+				return false;
+			}
+			valueVec.push_back(dictVec[static_cast<std::size_t>(nIndex)]);
+		}
+		return pData == pEnd;
+	}
+	if (COLUMN_ENCODE_FRONT == nEncode)
+	{
+		std::string strPrev;
+		for (std::size_t i = 0; i < nRows; i++)
+		{
+			uint64_t nShared = 0;
+			std::string strSuffix;
+			if (!GetVarint(pData, pEnd, nShared) || nShared > strPrev.length() || !GetString(pData, pEnd, strSuffix))
+			{
+				return false;
+			}
+			strPrev = strPrev.substr(0, static_cast<std::size_t>(nShared)) + strSuffix;
+			valueVec.push_back(strPrev);
+		}
+		return pData == pEnd;
+	}
+	return false;
+}
+
+/**
+ * @brief 好友消息和列的对应关系,第0列为接收者ID
+ *
+ */
+static void AppendColumns(ChatArchiveColumns_st& block, const T_USER_CHAT_MSG& chatMsg)
+{
+	block.m_msgIdVec.push_back(MsgIdValue(chatMsg.m_strF_MSG_ID));
+	block.m_columnVec[0].push_back(chatMsg.m_strF_TO_ID);
+	block.m_columnVec[1].push_back(ChatType(chatMsg.m_eChatMsgType));
+	block.m_columnVec[2].push_back(chatMsg.m_strF_FROM_ID);
+	block.m_columnVec[3].push_back(chatMsg.m_strF_READ_FLAG);
+	block.m_columnVec[4].push_back(chatMsg.m_strF_CREATE_TIME);
+	block.m_columnVec[5].push_back(chatMsg.m_strF_MSG_CONTEXT);
+	block.m_columnVec[6].push_back(chatMsg.m_strF_OTHER_INFO);
+}
+
+/**
+ * @brief 群聊消息和列的对应关系,第0列为群组ID
+ *
+ */
+static void AppendColumns(ChatArchiveColumns_st& block, const T_GROUP_CHAT_MSG& chatMsg)
+{
+	block.m_msgIdVec.push_back(MsgIdValue(chatMsg.m_strF_MSG_ID));
+	block.m_columnVec[0].push_back(chatMsg.m_strF_GROUP_ID);
+	block.m_columnVec[1].push_back(ChatType(chatMsg.m_eChatMsgType));
+	block.m_columnVec[2].push_back(chatMsg.m_strF_SENDER_ID);
+	block.m_columnVec[3].push_back(chatMsg.m_strF_CREATE_TIME);
+	block.m_columnVec[4].push_back(chatMsg.m_strF_MSG_CONTEXT);
+	block.m_columnVec[5].push_back(chatMsg.m_strF_OTHER_INFO);
+}
+
+static T_USER_CHAT_MSG FriendMsgOfRow(const ChatArchiveColumns_st& block, const std::size_t nRow)
+{
+	T_USER_CHAT_MSG chatMsg;
+	chatMsg.m_strF_MSG_ID = std::to_string(block.m_msgIdVec[nRow]);
+	chatMsg.m_strF_TO_ID = block.m_columnVec[0][nRow];
+	chatMsg.m_eChatMsgType = ChatType(block.m_columnVec[1][nRow]);
+	chatMsg.m_strF_FROM_ID = block.m_columnVec[2][nRow];
+	chatMsg.m_strF_READ_FLAG = block.m_columnVec[3][nRow];
+	chatMsg.m_strF_CREATE_TIME = block.m_columnVec[4][nRow];
+	chatMsg.m_strF_MSG_CONTEXT = block.m_columnVec[5][nRow];
+	chatMsg.m_strF_OTHER_INFO = block.m_columnVec[6][nRow];
+	return chatMsg;
+}
+
+static T_GROUP_CHAT_MSG GroupMsgOfRow(const ChatArchiveColumns_st& block, const std::size_t nRow)
+{
+	T_GROUP_CHAT_MSG chatMsg;
+	chatMsg.m_strF_MSG_ID = std::to_string(block.m_msgIdVec[nRow]);
+	chatMsg.m_strF_GROUP_ID = block.m_columnVec[0][nRow];
+	chatMsg.m_eChatMsgType = ChatType(block.m_columnVec[1][nRow]);
+	chatMsg.m_strF_SENDER_ID = block.m_columnVec[2][nRow];
+	chatMsg.m_strF_CREATE_TIME = block.m_columnVec[3][nRow];
+	chatMsg.m_strF_MSG_CONTEXT = block.m_columnVec[4][nRow];
+	chatMsg.m_strF_OTHER_INFO = block.m_columnVec[5][nRow];
+	return chatMsg;
+}
+
+CChatArchiveWriter::CChatArchiveWriter(const std::size_t nBlockRows)
+	: m_pFile(nullptr)
+	, m_kind(E_ARCHIVE_KIND::E_ARCHIVE_UNKNOWN)
+	, m_nBlockRows(nBlockRows > 0 ? nBlockRows : DEFAULT_BLOCK_ROWS)
+	, m_nRows(0)
+	, m_nOffset(0)
+{
+}
+
+CChatArchiveWriter::~CChatArchiveWriter()
+{
+	Abort();
+}
+
+bool CChatArchiveWriter::Open(const std::string& strPath, const E_ARCHIVE_KIND kind)
+{
+	Abort();
+	if (0 == ColumnCount(kind))
+	{
+		return false;
+	}
+	m_pFile = std::fopen((strPath + ".tmp").c_str(), "wb");
+	if (nullptr == m_pFile)
+	{
+		return false;
+	}
+	m_strPath = strPath;
+	m_kind = kind;
+	m_nRows = 0;
+	m_blockVec.clear();
+	m_block = ChatArchiveColumns_st();
+	m_block.m_columnVec.resize(ColumnCount(kind));
+	std::string strHead(ARCHIVE_HEAD_MAGIC, ARCHIVE_MAGIC_LEN);
+	strHead.push_back(static_cast<char>(kind));
+	m_nOffset = strHead.length();
+	return std::fwrite(strHead.data(), 1, strHead.length(), m_pFile) == strHead.length();
+}
+
+bool CChatArchiveWriter::Append(const T_USER_CHAT_MSG& chatMsg)
+{
+	if (nullptr == m_pFile || E_ARCHIVE_KIND::E_ARCHIVE_FRIEND_MSG != m_kind)
+	{
+		return false;
+	}
+	AppendColumns(m_block, chatMsg);
+	return m_block.Rows() < m_nBlockRows || FlushBlock();
+}
+
+bool CChatArchiveWriter::Append(const T_GROUP_CHAT_MSG& chatMsg)
+{
+	if (nullptr == m_pFile || E_ARCHIVE_KIND::E_ARCHIVE_GROUP_MSG != m_kind)
+	{
+		return false;
+	}
+	AppendColumns(m_block, chatMsg);
+	return m_block.Rows() < m_nBlockRows || FlushBlock();
+}
+
+/**
+ * @brief 写入当前的数据块
+ *
+ * 数据块的格式: 长度(4字节) 校验值(4字节) 行数 列数 消息ID列 字符串列...
+ * 消息ID列为和上一行差值的zigzag变长整数,每个字符串列前面写列的字节数,读取时可以跳过
+ */
+bool CChatArchiveWriter::FlushBlock()
+{
+	if (0 == m_block.Rows())
+	{
+		return true;
+	}
+	ChatArchiveBlock_st blockInfo;
+	blockInfo.m_nOffset = m_nOffset;
+	blockInfo.m_nRows = m_block.Rows();
+	blockInfo.m_nMinMsgId = *std::min_element(m_block.m_msgIdVec.begin(), m_block.m_msgIdVec.end());
+	blockInfo.m_nMaxMsgId = *std::max_element(m_block.m_msgIdVec.begin(), m_block.m_msgIdVec.end());
+
+	std::string strData;
+	PutVarint(strData, m_block.Rows());
+	PutVarint(strData, m_block.m_columnVec.size());
+	uint64_t nPrev = 0;
+	for (const auto& item : m_block.m_msgIdVec)
+	{
+		int64_t nDelta = static_cast<int64_t>(item - nPrev);
+		PutVarint(strData, (static_cast<uint64_t>(nDelta) << 1) ^ static_cast<uint64_t>(nDelta >> 63));
+		nPrev = item;
+	}
+	for (const auto& column : m_block.m_columnVec)
+	{
+		std::string strColumn = EncodeColumn(column);
+		PutVarint(strData, strColumn.length());
+		strData.append(strColumn);
+	}
+	std::string strHead;
+	PutFixed32(strHead, static_cast<uint32_t>(strData.length()));
+	PutFixed32(strHead, BlockChecksum(strData));
+	if (std::fwrite(strHead.data(), 1, strHead.length(), m_pFile) != strHead.length() ||
+		std::fwrite(strData.data(), 1, strData.length(), m_pFile) != strData.length())
+	{
+		return false;
+	}
+	m_nOffset += strHead.length() + strData.length();
+	m_nRows += blockInfo.m_nRows;
+	m_blockVec.push_back(blockInfo);
+	for (auto& column : m_block.m_columnVec)
+	{
+		column.clear();
+	}
+	m_block.m_msgIdVec.clear();
+	return true;
+}
+
+/**
+ * @brief 块索引的格式: 块数 (偏移 行数 最小ID 最大ID)... 块索引长度(4字节) 结尾魔数
+ *
+ */
+bool CChatArchiveWriter::Finish()
+{
+	if (nullptr == m_pFile || !FlushBlock())
+	{
+		Abort();
+		return false;
+	}
+	std::string strFooter;
+	PutVarint(strFooter, m_blockVec.size());
+	for (const auto& item : m_blockVec)
+	{
+		PutVarint(strFooter, item.m_nOffset);
+		PutVarint(strFooter, item.m_nRows);
+		PutVarint(strFooter, item.m_nMinMsgId);
+		PutVarint(strFooter, item.m_nMaxMsgId);
+	}
+	PutFixed32(strFooter, static_cast<uint32_t>(strFooter.length()));
+	strFooter.append(ARCHIVE_TAIL_MAGIC, ARCHIVE_MAGIC_LEN);
+	bool bResult = std::fwrite(strFooter.data(), 1, strFooter.length(), m_pFile) == strFooter.length() && 0 == std::fflush(m_pFile);
+	//分区在归档以后删除,改名之前必须保证文件已经写到磁盘
+#ifdef _WIN32
+	bResult = bResult && 0 == _commit(_fileno(m_pFile));
+#else
+	bResult = bResult && 0 == fsync(fileno(m_pFile));
+#endif
+	bResult = (0 == std::fclose(m_pFile)) && bResult;
+	m_pFile = nullptr;
+	std::string strTmpPath = m_strPath + ".tmp";
+	if (bResult)
+	{
+		std::remove(m_strPath.c_str());
+		bResult = (0 == std::rename(strTmpPath.c_str(), m_strPath.c_str()));
+	}
+	if (!bResult)
+	{
+		std::remove(strTmpPath.c_str());
+	}
+	return bResult;
+}
+
+void CChatArchiveWriter::Abort()
+{
+	if (nullptr != m_pFile)
+	{
+		std::fclose(m_pFile);
+		m_pFile = nullptr;
+		std::remove((m_strPath + ".tmp").c_str());
+	}
+}
+
+bool CChatArchiveReader::Open(const std::string& strPath)
+{
+	m_kind = E_ARCHIVE_KIND::E_ARCHIVE_UNKNOWN;
+	m_blockVec.clear();
+	if (m_inFile.is_open())
+	{
+		m_inFile.close();
+	}
+	m_inFile.clear();
+	m_inFile.open(strPath, std::ios::binary);
+	if (!m_inFile.is_open())
+	{
+		return false;
+	}
+	char szHead[ARCHIVE_HEAD_LEN] = { 0 };
+	char szTail[ARCHIVE_TAIL_LEN] = { 0 };
+	m_inFile.seekg(0, std::ios::end);
+	int64_t nFileSize = static_cast<int64_t>(m_inFile.tellg());
+	if (nFileSize < static_cast<int64_t>(ARCHIVE_HEAD_LEN + ARCHIVE_TAIL_LEN))
+	{
+		return false;
+	}
+	m_inFile.seekg(0, std::ios::beg);
+	m_inFile.read(szHead, ARCHIVE_HEAD_LEN);
+	m_inFile.seekg(nFileSize - static_cast<int64_t>(ARCHIVE_TAIL_LEN), std::ios::beg);
+	m_inFile.read(szTail, ARCHIVE_TAIL_LEN);
+	if (!m_inFile.good() ||
+		0 != std::string(szHead, ARCHIVE_MAGIC_LEN).compare(ARCHIVE_HEAD_MAGIC) ||
+		0 != std::string(szTail + 4, ARCHIVE_MAGIC_LEN).compare(ARCHIVE_TAIL_MAGIC))
+	{
+		return false;
+	}
+	E_ARCHIVE_KIND kind = static_cast<E_ARCHIVE_KIND>(szHead[ARCHIVE_MAGIC_LEN]);
+	uint32_t nFooterLen = GetFixed32(szTail);
+	if (0 == ColumnCount(kind) || nFooterLen > nFileSize - static_cast<int64_t>(ARCHIVE_HEAD_LEN + ARCHIVE_TAIL_LEN))
+	{
+		return false;
+	}
+	std::string strFooter(nFooterLen, '\0');
+	m_inFile.seekg(nFileSize - static_cast<int64_t>(ARCHIVE_TAIL_LEN + nFooterLen), std::ios::beg);
+	m_inFile.read(&strFooter[0], nFooterLen);
+	const char* pData = strFooter.data();
+	const char* pEnd = pData + strFooter.length();
+	uint64_t nBlocks = 0;
+	if (!m_inFile.good() || !GetVarint(pData, pEnd, nBlocks))
+	{
+		return false;
+	}
+	std::vector<ChatArchiveBlock_st> blockVec;
+	for (uint64_t i = 0; i < nBlocks; i++)
+	{
+		ChatArchiveBlock_st item;
+		if (!GetVarint(pData, pEnd, item.m_nOffset) || !GetVarint(pData, pEnd, item.m_nRows) ||
+			!GetVarint(pData, pEnd, item.m_nMinMsgId) || !GetVarint(pData, pEnd, item.m_nMaxMsgId))
+		{
+			return false;
+		}
+		blockVec.push_back(item);
+	}
+	m_kind = kind;
+	m_blockVec.swap(blockVec);
+	return true;
+}
+
+uint64_t CChatArchiveReader::Rows() const
+{
+	uint64_t nRows = 0;
+	for (const auto& item : m_blockVec)
+	{
+		nRows += item.m_nRows;
+	}
+	return nRows;
+}
+
+bool CChatArchiveReader::ReadBlock(const std::size_t nBlock, ChatArchiveColumns_st& block, const std::size_t nKeyColumns)
+{
+	block = ChatArchiveColumns_st();
+	if (nBlock >= m_blockVec.size())
+	{
+		return false;
+	}
+	char szHead[ARCHIVE_BLOCK_HEAD_LEN] = { 0 };
+	m_inFile.clear();
+	m_inFile.seekg(static_cast<std::streamoff>(m_blockVec[nBlock].m_nOffset), std::ios::beg);
+	m_inFile.read(szHead, ARCHIVE_BLOCK_HEAD_LEN);
+	uint32_t nLen = GetFixed32(szHead);
+	if (!m_inFile.good() || nLen > ARCHIVE_MAX_BLOCK_LEN)
+	{
+		return false;
+	}
+	std::string strData(nLen, '\0');
+	m_inFile.read(&strData[0], nLen);
+	if (!m_inFile.good() || BlockChecksum(strData) != GetFixed32(szHead + 4))
+	{
+		return false;
+	}
+	const char* pData = strData.data();
+	const char* pEnd = pData + strData.length();
+	uint64_t nRows = 0;
+	uint64_t nColumns = 0;
+	if (!GetVarint(pData, pEnd, nRows) || !GetVarint(pData, pEnd, nColumns) ||
+		nRows != m_blockVec[nBlock].m_nRows || nColumns != ColumnCount(m_kind))
+	{
+		return false;
+	}
+	uint64_t nPrev = 0;
+	for (uint64_t i = 0; i < nRows; i++)
+	{
+		uint64_t nZigZag = 0;
+		if (!GetVarint(pData, pEnd, nZigZag))
+		{
+			return false;
+		}
+		nPrev += (nZigZag >> 1) ^ (~(nZigZag & 1) + 1);
+		block.m_msgIdVec.push_back(nPrev);
+	}
+	std::size_t nDecode = (0 == nKeyColumns) ? static_cast<std::size_t>(nColumns) : std::min<std::size_t>(nKeyColumns, static_cast<std::size_t>(nColumns));
+	block.m_columnVec.resize(nDecode);
+	for (std::size_t i = 0; i < nDecode; i++)
+	{
+		uint64_t nColumnLen = 0;
+		if (!GetVarint(pData, pEnd, nColumnLen) || nColumnLen > static_cast<uint64_t>(pEnd - pData) ||
+			!DecodeColumn(pData, pData + nColumnLen, static_cast<std::size_t>(nRows), block.m_columnVec[i]))
+		{
+			return false;
+		}
+		pData += nColumnLen;
+	}
+	return true;
+}
+
+bool CChatArchiveReader::ReadBlock(const std::size_t nBlock, std::vector<T_USER_CHAT_MSG>& msgVec)
+{
+	ChatArchiveColumns_st block;
+	if (E_ARCHIVE_KIND::E_ARCHIVE_FRIEND_MSG != m_kind || !ReadBlock(nBlock, block))
+	{
+		return false;
+	}
+	for (std::size_t i = 0; i < block.Rows(); i++)
+	{
+		msgVec.push_back(FriendMsgOfRow(block, i));
+	}
+	return true;
+}
+
+bool CChatArchiveReader::ReadBlock(const std::size_t nBlock, std::vector<T_GROUP_CHAT_MSG>& msgVec)
+{
+	ChatArchiveColumns_st block;
+	if (E_ARCHIVE_KIND::E_ARCHIVE_GROUP_MSG != m_kind || !ReadBlock(nBlock, block))
+	{
+		return false;
+	}
+	for (std::size_t i = 0; i < block.Rows(); i++)
+	{
+		msgVec.push_back(GroupMsgOfRow(block, i));
+	}
+	return true;
+}
+
+/**
+ * @brief 按块的顺序查找,先只解码群组ID列,没有该群组的块不再解码其他列
+ *
+ */
+bool CChatArchiveReader::SelectGroupChatTextList(const std::string& strGroupId, const std::string& strLastMsgId, const std::size_t nLimit, std::vector<T_GROUP_CHAT_MSG>& msgVec)
+{
+	if (E_ARCHIVE_KIND::E_ARCHIVE_GROUP_MSG != m_kind)
+	{
+		return false;
+	}
+	uint64_t nLastMsgId = MsgIdValue(strLastMsgId);
+	std::vector<std::pair<uint64_t, T_GROUP_CHAT_MSG>> foundVec;
+	uint64_t nFoundMaxId = 0;
+	for (std::size_t i = 0; i < m_blockVec.size(); i++)
+	{
+		const auto& blockInfo = m_blockVec[i];
+		if (blockInfo.m_nMaxMsgId <= nLastMsgId)
+		{
+			continue;
+		}
+		//导出时按消息ID排序,后面的块中不会有更小的ID
+		if (foundVec.size() >= nLimit && blockInfo.m_nMinMsgId > nFoundMaxId)
+		{
+			break;
+		}
+		ChatArchiveColumns_st block;
+		if (!ReadBlock(i, block, 1))
+		{
+			return false;
+		}
+		if (std::find(block.m_columnVec[0].begin(), block.m_columnVec[0].end(), strGroupId) == block.m_columnVec[0].end())
+		{
+			continue;
+		}
+		if (!ReadBlock(i, block))
+		{
+			return false;
+		}
+		for (std::size_t nRow = 0; nRow < block.Rows(); nRow++)
+		{
+			if (block.m_msgIdVec[nRow] > nLastMsgId && block.m_columnVec[0][nRow] == strGroupId)
+			{
+				foundVec.push_back({ block.m_msgIdVec[nRow], GroupMsgOfRow(block, nRow) });
+				nFoundMaxId = std::max(nFoundMaxId, block.m_msgIdVec[nRow]);
+			}
+		}
+	}
+	std::stable_sort(foundVec.begin(), foundVec.end(), [](const std::pair<uint64_t, T_GROUP_CHAT_MSG>& lhs, const std::pair<uint64_t, T_GROUP_CHAT_MSG>& rhs) {
+		return lhs.first < rhs.first;
+	});
+	for (std::size_t i = 0; i < foundVec.size() && msgVec.size() < nLimit; i++)
+	{
+		msgVec.push_back(foundVec[i].second);
+	}
+	return true;
+}
+
+bool CChatArchive::Open(const std::string& strDir)
+{
+	m_strDir = strDir;
+#ifdef _WIN32
+	_mkdir(m_strDir.c_str());
+#else
+	mkdir(m_strDir.c_str(), 0755);
+#endif
+	return Reload();
+}
+
+bool CChatArchive::Reload()
+{
+	std::vector<std::string> nameVec;
+#ifdef _WIN32
+	struct _finddata_t fileInfo;
+	intptr_t hFind = _findfirst((m_strDir + "/*" + FILE_SUFFIX).c_str(), &fileInfo);
+	if (-1 != hFind)
+	{
+		do
+		{
+			nameVec.push_back(fileInfo.name);
+		} while (0 == _findnext(hFind, &fileInfo));
+		_findclose(hFind);
+	}
+#else
+	DIR* pDir = opendir(m_strDir.c_str());
+	if (nullptr == pDir)
+	{
+		return false;
+	}
+	struct dirent* pEntry = nullptr;
+	while (nullptr != (pEntry = readdir(pDir)))
+	{
+		nameVec.push_back(pEntry->d_name);
+	}
+	closedir(pDir);
+#endif
+	std::vector<ChatArchiveFile_st> fileVec;
+	for (const auto& strName : nameVec)
+	{
+		if (strName.length() <= FILE_SUFFIX.length() ||
+			0 != strName.compare(strName.length() - FILE_SUFFIX.length(), FILE_SUFFIX.length(), FILE_SUFFIX))
+		{
+			continue;
+		}
+		ChatArchiveFile_st file;
+		file.m_strPath = m_strDir + "/" + strName;
+		CChatArchiveReader reader;
+		if (!reader.Open(file.m_strPath))
+		{
+			LOG_WARN(ms_loger, "Archive File {} Is Broken [{} {}]", file.m_strPath, __FILENAME__, __LINE__);
+			continue;
+		}
+		file.m_kind = reader.Kind();
+		file.m_nMinMsgId = reader.MinMsgId();
+		file.m_nMaxMsgId = reader.MaxMsgId();
+		file.m_nRows = reader.Rows();
+		fileVec.push_back(file);
+	}
+	std::sort(fileVec.begin(), fileVec.end(), [](const ChatArchiveFile_st& lhs, const ChatArchiveFile_st& rhs) {
+		return lhs.m_nMinMsgId < rhs.m_nMinMsgId;
+	});
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_fileVec.swap(fileVec);
+	return true;
+}
+
+std::string CChatArchive::ArchivePath(const std::string& strTable, const std::string& strPartition) const
+{
+	return m_strDir + "/" + strTable + "_" + strPartition + FILE_SUFFIX;
+}
+
+void CChatArchive::AddFile(const ChatArchiveFile_st& file)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_fileVec.erase(std::remove_if(m_fileVec.begin(), m_fileVec.end(), [&file](const ChatArchiveFile_st& item) {
+		return item.m_strPath == file.m_strPath;
+	}), m_fileVec.end());
+	auto pos = std::upper_bound(m_fileVec.begin(), m_fileVec.end(), file, [](const ChatArchiveFile_st& lhs, const ChatArchiveFile_st& rhs) {
+		return lhs.m_nMinMsgId < rhs.m_nMinMsgId;
+	});
+	m_fileVec.insert(pos, file);
+}
+
+std::vector<ChatArchiveFile_st> CChatArchive::Files()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_fileVec;
+}
+
+bool CChatArchive::SelectGroupChatTextList(const std::string& strGroupId, const std::string& strLastMsgId, const std::size_t nLimit, std::vector<T_GROUP_CHAT_MSG>& msgVec)
+{
+	msgVec.clear();
+	uint64_t nLastMsgId = MsgIdValue(strLastMsgId);
+	for (const auto& file : Files())
+	{
+		if (msgVec.size() >= nLimit)
+		{
+			break;
+		}
+		if (E_ARCHIVE_KIND::E_ARCHIVE_GROUP_MSG != file.m_kind || file.m_nMaxMsgId <= nLastMsgId)
+		{
+			continue;
+		}
+		CChatArchiveReader reader;
+		if (!reader.Open(file.m_strPath) || !reader.SelectGroupChatTextList(strGroupId, strLastMsgId, nLimit, msgVec))
+		{
+			LOG_WARN(ms_loger, "Read Archive File {} Failed [{} {}]", file.m_strPath, __FILENAME__, __LINE__);
+		}
+	}
+	return !msgVec.empty();
+}
+
+bool CChatArchive::ExportPartition(CMySqlConnect& util, const std::string& strTable, const std::string& strPartition, const std::string& strPath, uint64_t& nRows)
+{
+	nRows = 0;
+	bool bFriend = (strTable == "T_FRIEND_CHAT_MSG");
+	if (!bFriend && strTable != "T_GROUP_CHAT_MSG")
+	{
+		return false;
+	}
+	CChatArchiveWriter writer;
+	if (!writer.Open(strPath, bFriend ? E_ARCHIVE_KIND::E_ARCHIVE_FRIEND_MSG : E_ARCHIVE_KIND::E_ARCHIVE_GROUP_MSG))
+	{
+		LOG_ERR(ms_loger, "Create Archive File {} Failed [{} {}]", strPath, __FILENAME__, __LINE__);
+		return false;
+	}
+	ChatPartitionCursor_st cursor;
+	while (true)
+	{
+		std::vector<T_USER_CHAT_MSG> friendMsgVec;
+		std::vector<T_GROUP_CHAT_MSG> groupMsgVec;
+		bool bSelect = bFriend ? util.SelectFriendChatMsgPartition(strPartition, ARCHIVE_EXPORT_PAGE, cursor, friendMsgVec) :
+			util.SelectGroupChatTextPartition(strPartition, ARCHIVE_EXPORT_PAGE, cursor, groupMsgVec);
+		if (!bSelect)
+		{
+			writer.Abort();
+			return false;
+		}
+		bool bAppend = true;
+		for (const auto& item : friendMsgVec)
+		{
+			bAppend = bAppend && writer.Append(item);
+		}
+		for (const auto& item : groupMsgVec)
+		{
+			bAppend = bAppend && writer.Append(item);
+		}
+		if (!bAppend)
+		{
+			LOG_ERR(ms_loger, "Write Archive File {} Failed [{} {}]", strPath, __FILENAME__, __LINE__);
+			writer.Abort();
+			return false;
+		}
+		if (friendMsgVec.size() + groupMsgVec.size() < static_cast<std::size_t>(ARCHIVE_EXPORT_PAGE))
+		{
+			break;
+		}
+	}
+	nRows = writer.Rows();
+	return writer.Finish();
+}
+
+bool CChatArchive::RestoreArchive(CMySqlConnect& util, const std::string& strPath, uint64_t& nRows)
+{
+	nRows = 0;
+	CChatArchiveReader reader;
+	if (!reader.Open(strPath))
+	{
+		LOG_ERR(ms_loger, "Open Archive File {} Failed [{} {}]", strPath, __FILENAME__, __LINE__);
+		return false;
+	}
+	for (std::size_t i = 0; i < reader.Blocks().size(); i++)
+	{
+		if (E_ARCHIVE_KIND::E_ARCHIVE_FRIEND_MSG == reader.Kind())
+		{
+			std::vector<T_USER_CHAT_MSG> msgVec;
+			if (!reader.ReadBlock(i, msgVec))
+			{
+				return false;
+			}
+			std::vector<T_USER_CHAT_MSG> insertVec;
+			std::vector<std::string> readIdVec;
+			for (const auto& item : msgVec)
+			{
+				if (!util.IsFriendChatMsgExist(item.m_strF_MSG_ID))
+				{
+					insertVec.push_back(item);
+					if (item.m_strF_READ_FLAG == "READ")
+					{
+						readIdVec.push_back(item.m_strF_MSG_ID);
+					}
+				}
+			}
+			//插入时读取状态为默认的未读,已读的消息再更新,避免恢复以后重新下发
+			if (!util.InsertFriendChatMsg(insertVec) || (!readIdVec.empty() && !util.UpdateFriendChatMsgState(readIdVec, "READ")))
+			{
+				return false;
+			}
+			nRows += insertVec.size();
+		}
+		else
+		{
+			std::vector<T_GROUP_CHAT_MSG> msgVec;
+			if (!reader.ReadBlock(i, msgVec))
+			{
+				return false;
+			}
+			std::vector<T_GROUP_CHAT_MSG> insertVec;
+			for (const auto& item : msgVec)
+			{
+				if (!util.IsGroupChatTextExist(item.m_strF_MSG_ID))
+				{
+					insertVec.push_back(item);
+				}
+			}
+			if (!util.InsertGroupChatText(insertVec))
+			{
+				return false;
+			}
+			nRows += insertVec.size();
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief 导出一个冷分区,确认导出的行数和分区的行数一致以后删除分区
+ *
+ */
+bool CChatArchive::ArchivePartition(CMySqlConnect& util, const std::string& strTable, const ChatPartition_st& part)
+{
+	auto beginTime = std::chrono::steady_clock::now();
+	std::string strPath = ArchivePath(strTable, part.m_strName);
+	uint64_t nRows = 0;
+	if (!ExportPartition(util, strTable, part.m_strName, strPath, nRows))
+	{
+		LOG_ERR(ms_loger, "Export {} {} Failed [{} {}]", strTable, part.m_strName, __FILENAME__, __LINE__);
+		return false;
+	}
+	int64_t nCount = 0;
+	CChatArchiveReader reader;
+	if (!util.SelectCount("SELECT COUNT(*) FROM `" + strTable + "` PARTITION (`" + part.m_strName + "`);", nCount) ||
+		static_cast<uint64_t>(nCount) != nRows || !reader.Open(strPath) || reader.Rows() != nRows)
+	{
+		LOG_ERR(ms_loger, "Archive {} {} Rows:{} Db Rows:{} Mismatch [{} {}]", strTable, part.m_strName, nRows, nCount, __FILENAME__, __LINE__);
+		std::remove(strPath.c_str());
+		return false;
+	}
+	//先登记归档文件再删除分区,查询按消息ID的范围读取,两边同时存在的消息不会重复下发
+	if (nRows > 0)
+	{
+		ChatArchiveFile_st file;
+		file.m_strPath = strPath;
+		file.m_kind = reader.Kind();
+		file.m_nMinMsgId = reader.MinMsgId();
+		file.m_nMaxMsgId = reader.MaxMsgId();
+		file.m_nRows = nRows;
+		AddFile(file);
+	}
+	else
+	{
+		std::remove(strPath.c_str());
+	}
+	//删除失败时分区下次重新导出,覆盖已经登记的文件
+	if (!util.DropChatPartition(strTable, part.m_strName))
+	{
+		return false;
+	}
+	auto nCostMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - beginTime).count();
+	LOG_INFO(ms_loger, "Archive {} {} Rows:{} Cost:{}ms [{} {}]", strTable, part.m_strName, nRows, nCostMs, __FILENAME__, __LINE__);
+	return true;
+}
+
+bool CChatArchive::Maintain(CMySqlConnect& util, const int nHotMonths, const int nAheadMonths)
+{
+	bool bResult = true;
+	int nCurMonth = CChatPartition::CurrentMonthIndex();
+	for (const std::string strTable : { "T_FRIEND_CHAT_MSG", "T_GROUP_CHAT_MSG" })
+	{
+		std::vector<ChatPartition_st> partVec;
+		if (!util.SelectChatPartitions(strTable, partVec) || partVec.empty())
+		{
+			LOG_WARN(ms_loger, "Table {} Is Not Partitioned, Run 'DbTool <cfg> partition' [{} {}]", strTable, __FILENAME__, __LINE__);
+			bResult = false;
+			continue;
+		}
+		auto addVec = CChatPartition::MissingPartitions(partVec, nCurMonth + nAheadMonths);
+		if (!addVec.empty() && !util.AddChatPartitions(strTable, addVec))
+		{
+			bResult = false;
+		}
+		for (const auto& item : CChatPartition::ColdPartitions(partVec, nCurMonth, nHotMonths))
+		{
+			//还有未读好友消息的分区先保留,离线消息只从数据库下发;
+			//后面的分区也不归档,保证归档的分区都早于数据库中的分区
+			int64_t nUnRead = 0;
+			if (strTable == std::string("T_FRIEND_CHAT_MSG") &&
+				(!util.SelectCount("SELECT COUNT(*) FROM `" + strTable + "` PARTITION (`" + item.m_strName + "`) WHERE F_READ_FLAG='UNREAD';", nUnRead) || nUnRead > 0))
+			{
+				LOG_INFO(ms_loger, "Skip Archive {} {} UnRead:{} [{} {}]", strTable, item.m_strName, nUnRead, __FILENAME__, __LINE__);
+				break;
+			}
+			if (!ArchivePartition(util, strTable, item))
+			{
+				bResult = false;
+				break;
+			}
+		}
+	}
+	return bResult;
+}
@@ -0,0 +1,215 @@
+/**
+ * @file CChatArchive.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 聊天表冷分区的列式归档文件,以及归档目录的管理
+ * @version 0.1
+ * @date 2020-05-10
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_CHAT_ARCHIVE_H_
+#define _DENNIS_THINK_C_CHAT_ARCHIVE_H_
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "CMysqlStruct.h"
+#include "Log.h"
+
+class CMySqlConnect;
+
+enum class E_ARCHIVE_KIND : uint8_t
+{
+	E_ARCHIVE_UNKNOWN = 0,
+	E_ARCHIVE_FRIEND_MSG = 1,//T_FRIEND_CHAT_MSG
+	E_ARCHIVE_GROUP_MSG = 2,//T_GROUP_CHAT_MSG
+};
+
+/**
+ * @brief 归档文件中一个数据块的位置和消息ID范围
+ *
+ */
+struct ChatArchiveBlock_st
+{
+	uint64_t m_nOffset = 0;//数据块在文件中的偏移
+	uint64_t m_nRows = 0;
+	uint64_t m_nMinMsgId = 0;
+	uint64_t m_nMaxMsgId = 0;
+};
+
+/**
+ * @brief 一个数据块解码以后的内容,按列保存
+ *
+ * 第0列为接收者ID或者群组ID,读取时可以只解码这一列判断数据块中是否有需要的消息
+ */
+struct ChatArchiveColumns_st
+{
+	std::vector<uint64_t> m_msgIdVec;
+	std::vector<std::vector<std::string>> m_columnVec;
+
+	std::size_t Rows() const { return m_msgIdVec.size(); }
+};
+
+/**
+ * @brief 归档文件的写入
+ *
+ * 文件由文件头、若干数据块和块索引组成。每个数据块最多m_nBlockRows条消息,按列编码:
+ * 消息ID按差值写变长整数,字符串列在字典编码和前缀编码中选择较小的一种。
+ * 导出时按消息ID排序写入,块索引中记录每块的最小和最大消息ID,读取时可以跳过不需要的块。
+ * 先写入.tmp文件,Finish时同步到磁盘再改名,改名以后的文件一定是完整的。
+ */
+class CChatArchiveWriter
+{
+public:
+	static const std::size_t DEFAULT_BLOCK_ROWS = 4096;
+
+	explicit CChatArchiveWriter(const std::size_t nBlockRows = DEFAULT_BLOCK_ROWS);
+	~CChatArchiveWriter();
+
+	bool Open(const std::string& strPath, const E_ARCHIVE_KIND kind);
+	bool Append(const T_USER_CHAT_MSG& chatMsg);
+	bool Append(const T_GROUP_CHAT_MSG& chatMsg);
+
+	//写入最后一个数据块和块索引,成功以后文件才出现在strPath
+	bool Finish();
+
+	//放弃写入,删除临时文件
+	void Abort();
+
+	uint64_t Rows() const { return m_nRows; }
+private:
+	bool FlushBlock();
+
+	std::string m_strPath;
+	std::FILE* m_pFile;
+	E_ARCHIVE_KIND m_kind;
+	std::size_t m_nBlockRows;
+	uint64_t m_nRows;
+	uint64_t m_nOffset;
+	ChatArchiveColumns_st m_block;//当前还没有写入的数据块
+	std::vector<ChatArchiveBlock_st> m_blockVec;
+};
+
+/**
+ * @brief 归档文件的读取,打开时只读取块索引,数据块按需读取
+ *
+ */
+class CChatArchiveReader
+{
+public:
+	bool Open(const std::string& strPath);
+
+	E_ARCHIVE_KIND Kind() const { return m_kind; }
+	uint64_t Rows() const;
+	uint64_t MinMsgId() const { return m_blockVec.empty() ? 0 : m_blockVec.front().m_nMinMsgId; }
+	uint64_t MaxMsgId() const { return m_blockVec.empty() ? 0 : m_blockVec.back().m_nMaxMsgId; }
+	const std::vector<ChatArchiveBlock_st>& Blocks() const { return m_blockVec; }
+
+	/**
+	 * @brief 读取一个数据块
+	 *
+	 * @param nBlock 数据块的序号
+	 * @param nKeyColumns 只解码前几个字符串列,0表示全部解码
+	 */
+	bool ReadBlock(const std::size_t nBlock, ChatArchiveColumns_st& block, const std::size_t nKeyColumns = 0);
+
+	bool ReadBlock(const std::size_t nBlock, std::vector<T_USER_CHAT_MSG>& msgVec);
+	bool ReadBlock(const std::size_t nBlock, std::vector<T_GROUP_CHAT_MSG>& msgVec);
+
+	/**
+	 * @brief 读取群组中消息ID大于strLastMsgId的消息,按消息ID排列
+	 *
+	 * @return true 读取成功,msgVec可能为空
+	 * @return false 文件损坏或者不是群聊消息的归档
+	 */
+	bool SelectGroupChatTextList(const std::string& strGroupId, const std::string& strLastMsgId, const std::size_t nLimit, std::vector<T_GROUP_CHAT_MSG>& msgVec);
+private:
+	std::ifstream m_inFile;
+	E_ARCHIVE_KIND m_kind = E_ARCHIVE_KIND::E_ARCHIVE_UNKNOWN;
+	std::vector<ChatArchiveBlock_st> m_blockVec;
+};
+
+/**
+ * @brief 归档目录中的一个文件
+ *
+ */
+struct ChatArchiveFile_st
+{
+	std::string m_strPath;
+	E_ARCHIVE_KIND m_kind = E_ARCHIVE_KIND::E_ARCHIVE_UNKNOWN;
+	uint64_t m_nMinMsgId = 0;
+	uint64_t m_nMaxMsgId = 0;
+	uint64_t m_nRows = 0;
+};
+
+/**
+ * @brief 聊天消息的归档目录,管理聊天表的分区和冷分区的导出
+ *
+ * 文件名为<表名>_<分区名>.archive,每个冷分区一个文件。
+ * Maintain在数据库连接池的线程上执行,查询在业务strand上执行,文件列表用锁保护。
+ * 导出的分区整个删除,比逐条删除快得多;还有未读好友消息的分区暂不归档,等消息下发以后再归档。
+ */
+class CChatArchive
+{
+public:
+	static const std::string FILE_SUFFIX;
+	static std::shared_ptr<spdlog::logger> ms_loger;
+
+	bool Open(const std::string& strDir);
+	bool IsOpen() const { return !m_strDir.empty(); }
+	const std::string& Dir() const { return m_strDir; }
+
+	//重新扫描归档目录,离线恢复或者删除文件以后生效
+	bool Reload();
+
+	std::string ArchivePath(const std::string& strTable, const std::string& strPartition) const;
+
+	/**
+	 * @brief 创建以后的分区,导出并删除冷分区
+	 *
+	 * @param util 数据库连接
+	 * @param nHotMonths 包括当前月在内保留在数据库中的月数
+	 * @param nAheadMonths 提前创建的月数
+	 * @return true 全部成功
+	 * @return false 有表没有分区或者导出失败,下次继续
+	 */
+	bool Maintain(CMySqlConnect& util, const int nHotMonths, const int nAheadMonths);
+
+	/**
+	 * @brief 导出一个分区到文件,不删除分区
+	 *
+	 * @param util 数据库连接
+	 * @param strTable 表名
+	 * @param strPartition 分区名
+	 * @param strPath 归档文件的路径
+	 * @param nRows 导出的行数
+	 */
+	static bool ExportPartition(CMySqlConnect& util, const std::string& strTable, const std::string& strPartition, const std::string& strPath, uint64_t& nRows);
+
+	/**
+	 * @brief 把归档文件中的消息重新写入数据库,已经存在的消息跳过
+	 *
+	 * @param util 数据库连接
+	 * @param strPath 归档文件的路径
+	 * @param nRows 写入的行数
+	 */
+	static bool RestoreArchive(CMySqlConnect& util, const std::string& strPath, uint64_t& nRows);
+
+	//从归档中读取群组的历史消息,消息ID在归档的范围之后时返回false
+	bool SelectGroupChatTextList(const std::string& strGroupId, const std::string& strLastMsgId, const std::size_t nLimit, std::vector<T_GROUP_CHAT_MSG>& msgVec);
+
+	std::vector<ChatArchiveFile_st> Files();
+private:
+	bool ArchivePartition(CMySqlConnect& util, const std::string& strTable, const ChatPartition_st& part);
+	void AddFile(const ChatArchiveFile_st& file);
+
+	std::string m_strDir;
+	std::mutex m_mutex;
+	std::vector<ChatArchiveFile_st> m_fileVec;//按最小消息ID排列
+};
+#endif
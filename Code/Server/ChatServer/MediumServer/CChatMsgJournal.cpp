@@ -0,0 +1,304 @@
+#include "CChatMsgJournal.h"
+#include <algorithm>
+#include <fstream>
+#include "json11.hpp"
+#ifdef _WIN32
+#include <io.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+const std::string JOURNAL_FILE_PREFIX = "chatmsg_";
+const std::string JOURNAL_FILE_SUFFIX = ".journal";
+
+CChatMsgJournal::CChatMsgJournal()
+	: m_pFile(nullptr)
+	, m_nSegment(0)
+	, m_bSync(false)
+{
+}
+
+CChatMsgJournal::~CChatMsgJournal()
+{
+	Close();
+}
+
+std::string CChatMsgJournal::SegmentPath(const uint64_t nSegment) const
+{
+	return m_strDir + "/" + JOURNAL_FILE_PREFIX + std::to_string(nSegment) + JOURNAL_FILE_SUFFIX;
+}
+
+std::string CChatMsgJournal::ToJournalLine(const T_USER_CHAT_MSG& chatMsg)
+{
+	json11::Json clientObj = json11::Json::object({
+		{ "Kind", "Friend" },
+		{ "MsgId", chatMsg.m_strF_MSG_ID },
+		{ "MsgType", ChatType(chatMsg.m_eChatMsgType) },
+		{ "FromId", chatMsg.m_strF_FROM_ID },
+		{ "ToId", chatMsg.m_strF_TO_ID },
+		{ "Context", chatMsg.m_strF_MSG_CONTEXT },
+		{ "OtherInfo", chatMsg.m_strF_OTHER_INFO },
+		{ "CreateTime", chatMsg.m_strF_CREATE_TIME },
+	});
+	return clientObj.dump();
+}
+
+std::string CChatMsgJournal::ToJournalLine(const T_GROUP_CHAT_MSG& chatMsg)
+{
+	json11::Json clientObj = json11::Json::object({
+		{ "Kind", "Group" },
+		{ "MsgId", chatMsg.m_strF_MSG_ID },
+		{ "MsgType", ChatType(chatMsg.m_eChatMsgType) },
+		{ "SenderId", chatMsg.m_strF_SENDER_ID },
+		{ "GroupId", chatMsg.m_strF_GROUP_ID },
+		{ "Context", chatMsg.m_strF_MSG_CONTEXT },
+		{ "OtherInfo", chatMsg.m_strF_OTHER_INFO },
+		{ "CreateTime", chatMsg.m_strF_CREATE_TIME },
+	});
+	return clientObj.dump();
+}
+
+bool CChatMsgJournal::ParseJournalLine(const std::string& strLine, ChatMsgJournalBatch_st& batch)
+{
+	std::string err;
+	auto pJson = json11::Json::parse(strLine, err);
+	if (!err.empty() || !pJson["MsgId"].is_string() || pJson["MsgId"].string_value().empty())
+	{
+		return false;
+	}
+	if (pJson["Kind"].string_value() == "Friend")
+	{
+		T_USER_CHAT_MSG chatMsg;
+		chatMsg.m_strF_MSG_ID = pJson["MsgId"].string_value();
+		chatMsg.m_eChatMsgType = ChatType(pJson["MsgType"].string_value());
+		chatMsg.m_strF_FROM_ID = pJson["FromId"].string_value();
+		chatMsg.m_strF_TO_ID = pJson["ToId"].string_value();
+		chatMsg.m_strF_MSG_CONTEXT = pJson["Context"].string_value();
+		chatMsg.m_strF_OTHER_INFO = pJson["OtherInfo"].string_value();
+		chatMsg.m_strF_CREATE_TIME = pJson["CreateTime"].string_value();
+		batch.m_friendMsgVec.push_back(chatMsg);
+		return true;
+	}
+	if (pJson["Kind"].string_value() == "Group")
+	{
+		T_GROUP_CHAT_MSG chatMsg;
+		chatMsg.m_strF_MSG_ID = pJson["MsgId"].string_value();
+		chatMsg.m_eChatMsgType = ChatType(pJson["MsgType"].string_value());
+		chatMsg.m_strF_SENDER_ID = pJson["SenderId"].string_value();
+		chatMsg.m_strF_GROUP_ID = pJson["GroupId"].string_value();
+		chatMsg.m_strF_MSG_CONTEXT = pJson["Context"].string_value();
+		chatMsg.m_strF_OTHER_INFO = pJson["OtherInfo"].string_value();
+		chatMsg.m_strF_CREATE_TIME = pJson["CreateTime"].string_value();
+		batch.m_groupMsgVec.push_back(chatMsg);
+		return true;
+	}
+	return false;
+}
+
+bool CChatMsgJournal::Open(const std::string& strDir, std::vector<ChatMsgJournalBatch_st>& replayVec)
+{
+	Close();
+	replayVec.clear();
+	m_strDir = strDir;
+#ifdef _WIN32
+	_mkdir(m_strDir.c_str());
+#else
+	mkdir(m_strDir.c_str(), 0755);
+#endif
+	std::vector<uint64_t> segmentVec;
+	if (!ListSegments(segmentVec))
+	{
+		return false;
+	}
+	uint64_t nNextSegment = 1;
+	for (const auto& nSegment : segmentVec)
+	{
+		ChatMsgJournalBatch_st batch;
+		LoadSegment(nSegment, batch);
+		nNextSegment = nSegment + 1;
+		if (batch.Size() > 0)
+		{
+			replayVec.push_back(batch);
+		}
+		else
+		{
+			Remove(nSegment);
+		}
+	}
+	return OpenSegment(nNextSegment);
+}
+
+void CChatMsgJournal::Close()
+{
+	if (nullptr != m_pFile)
+	{
+		std::fclose(m_pFile);
+		m_pFile = nullptr;
+		//没有消息的日志文件直接删除
+		if (0 == m_batch.Size())
+		{
+			Remove(m_nSegment);
+		}
+	}
+	m_batch = ChatMsgJournalBatch_st();
+}
+
+bool CChatMsgJournal::Append(const T_USER_CHAT_MSG& chatMsg)
+{
+	if (!WriteLine(ToJournalLine(chatMsg)))
+	{
+		return false;
+	}
+	m_batch.m_friendMsgVec.push_back(chatMsg);
+	return true;
+}
+
+bool CChatMsgJournal::Append(const T_GROUP_CHAT_MSG& chatMsg)
+{
+	if (!WriteLine(ToJournalLine(chatMsg)))
+	{
+		return false;
+	}
+	m_batch.m_groupMsgVec.push_back(chatMsg);
+	return true;
+}
+
+bool CChatMsgJournal::Seal(ChatMsgJournalBatch_st& batch)
+{
+	if (nullptr == m_pFile || 0 == m_batch.Size())
+	{
+		return false;
+	}
+	if (m_bSync)
+	{
+#ifdef _WIN32
+		_commit(_fileno(m_pFile));
+#else
+		fdatasync(fileno(m_pFile));
+#endif
+	}
+	std::fclose(m_pFile);
+	m_pFile = nullptr;
+	batch = std::move(m_batch);
+	batch.m_nSegment = m_nSegment;
+	batch.m_bReplay = false;
+	m_batch = ChatMsgJournalBatch_st();
+	//新文件打开失败时IsOpen返回false,调用者改为同步入库
+	OpenSegment(m_nSegment + 1);
+	return true;
+}
+
+bool CChatMsgJournal::Remove(const uint64_t nSegment)
+{
+	return 0 == std::remove(SegmentPath(nSegment).c_str());
+}
+
+bool CChatMsgJournal::OpenSegment(const uint64_t nSegment)
+{
+	m_nSegment = nSegment;
+	m_pFile = std::fopen(SegmentPath(nSegment).c_str(), "ab");
+	return nullptr != m_pFile;
+}
+
+/**
+ * @brief 写入一行日志并刷新到操作系统,写入失败时截掉这一行,避免和下一行连在一起
+ *
+ */
+bool CChatMsgJournal::WriteLine(const std::string& strLine)
+{
+	if (nullptr == m_pFile)
+	{
+		return false;
+	}
+	long nPos = std::ftell(m_pFile);
+	std::string strData = strLine + "\n";
+	if (std::fwrite(strData.data(), 1, strData.length(), m_pFile) != strData.length() || 0 != std::fflush(m_pFile))
+	{
+		if (nPos >= 0)
+		{
+#ifdef _WIN32
+			_chsize(_fileno(m_pFile), nPos);
+#else
+			(void)!ftruncate(fileno(m_pFile), nPos);
+#endif
+		}
+		return false;
+	}
+	return true;
+}
+
+bool CChatMsgJournal::LoadSegment(const uint64_t nSegment, ChatMsgJournalBatch_st& batch)
+{
+	batch.m_nSegment = nSegment;
+	batch.m_bReplay = true;
+	std::ifstream inFile(SegmentPath(nSegment), std::ios::binary);
+	if (!inFile.is_open())
+	{
+		return false;
+	}
+	std::string strLine;
+	while (std::getline(inFile, strLine))
+	{
+		if (!strLine.empty() && strLine.back() == '\r')
+		{
+			strLine.pop_back();
+		}
+		//进程崩溃时最后一行可能不完整
+		if (!strLine.empty())
+		{
+			ParseJournalLine(strLine, batch);
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief 列出目录中的日志文件序号,从小到大排列
+ *
+ */
+bool CChatMsgJournal::ListSegments(std::vector<uint64_t>& segmentVec)
+{
+	segmentVec.clear();
+	auto parseName = [&segmentVec](const std::string& strName) {
+		if (strName.length() > JOURNAL_FILE_PREFIX.length() + JOURNAL_FILE_SUFFIX.length() &&
+			0 == strName.compare(0, JOURNAL_FILE_PREFIX.length(), JOURNAL_FILE_PREFIX) &&
+			0 == strName.compare(strName.length() - JOURNAL_FILE_SUFFIX.length(), JOURNAL_FILE_SUFFIX.length(), JOURNAL_FILE_SUFFIX))
+		{
+			std::string strSeq = strName.substr(JOURNAL_FILE_PREFIX.length(), strName.length() - JOURNAL_FILE_PREFIX.length() - JOURNAL_FILE_SUFFIX.length());
+			if (!strSeq.empty() && strSeq.find_first_not_of("0123456789") == std::string::npos)
+			{
+				segmentVec.push_back(std::stoull(strSeq));
+			}
+		}
+	};
+#ifdef _WIN32
+	struct _finddata_t fileInfo;
+	intptr_t hFind = _findfirst((m_strDir + "/*" + JOURNAL_FILE_SUFFIX).c_str(), &fileInfo);
+	if (-1 != hFind)
+	{
+		do
+		{
+			parseName(fileInfo.name);
+		} while (0 == _findnext(hFind, &fileInfo));
+		_findclose(hFind);
+	}
+#else
+	DIR* pDir = opendir(m_strDir.c_str());
+	if (nullptr == pDir)
+	{
+		return false;
+	}
+	struct dirent* pEntry = nullptr;
+	while (nullptr != (pEntry = readdir(pDir)))
+	{
+		parseName(pEntry->d_name);
+	}
+	closedir(pDir);
+#endif
+	std::sort(segmentVec.begin(), segmentVec.end());
+	return true;
+}
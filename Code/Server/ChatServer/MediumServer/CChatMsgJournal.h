@@ -0,0 +1,104 @@
+/**
+ * @file CChatMsgJournal.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 聊天消息的本地日志,消息先写日志再批量入库
+ * @version 0.1
+ * @date 2020-04-26
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_CHAT_MSG_JOURNAL_H_
+#define _DENNIS_THINK_C_CHAT_MSG_JOURNAL_H_
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "CMysqlStruct.h"
+
+/**
+ * @brief 一个日志文件中的消息,整批入库成功以后删除日志文件
+ *
+ */
+struct ChatMsgJournalBatch_st
+{
+	uint64_t m_nSegment = 0;//日志文件的序号
+	bool m_bReplay = false;//是否为重启后恢复或者入库失败重试的消息,入库前需要跳过已经存在的消息
+	std::vector<T_USER_CHAT_MSG> m_friendMsgVec;
+	std::vector<T_GROUP_CHAT_MSG> m_groupMsgVec;
+
+	std::size_t Size() const { return m_friendMsgVec.size() + m_groupMsgVec.size(); }
+};
+
+/**
+ * @brief 聊天消息的日志,按文件分段,每段对应一批入库的消息
+ *
+ * Append把消息写入当前的日志文件并刷新到操作系统,此后进程崩溃也不会丢失消息。
+ * Seal关闭当前文件并返回其中的消息,入库成功以后调用Remove删除文件。
+ * Open时读取目录中没有删除的日志文件,作为需要重新入库的批次。
+ * 每条消息一行json,进程崩溃时写了一半的行在恢复时跳过。没有加锁,只在CChatServer的strand上使用。
+ */
+class CChatMsgJournal
+{
+public:
+	static const std::size_t DEFAULT_FLUSH_ROWS = 256;//默认积累多少条消息时立即入库
+	static const int DEFAULT_FLUSH_INTERVAL_MS = 5;//默认最长多少毫秒入库一次
+
+	CChatMsgJournal();
+	~CChatMsgJournal();
+
+	/**
+	 * @brief 打开日志目录,恢复上次没有入库的消息
+	 *
+	 * @param strDir 日志目录,不存在时创建
+	 * @param replayVec 需要重新入库的批次,按写入的顺序
+	 * @return true 打开成功
+	 * @return false 打开失败,调用者使用同步入库
+	 */
+	bool Open(const std::string& strDir, std::vector<ChatMsgJournalBatch_st>& replayVec);
+
+	void Close();
+
+	bool IsOpen() const { return nullptr != m_pFile; }
+
+	//Seal时是否把日志文件同步到磁盘,不同步时机器掉电可能丢失最后一批消息
+	void SetSync(const bool bSync) { m_bSync = bSync; }
+
+	bool Append(const T_USER_CHAT_MSG& chatMsg);
+	bool Append(const T_GROUP_CHAT_MSG& chatMsg);
+
+	//当前日志文件中还没有入库的消息条数
+	std::size_t PendingCount() const { return m_batch.Size(); }
+
+	/**
+	 * @brief 关闭当前的日志文件,取出其中的消息,后续的消息写入新的文件
+	 *
+	 * @param batch 需要入库的消息
+	 * @return true 有需要入库的消息
+	 * @return false 当前文件为空
+	 */
+	bool Seal(ChatMsgJournalBatch_st& batch);
+
+	//一批消息入库成功以后删除对应的日志文件
+	bool Remove(const uint64_t nSegment);
+
+	std::string SegmentPath(const uint64_t nSegment) const;
+
+	static std::string ToJournalLine(const T_USER_CHAT_MSG& chatMsg);
+	static std::string ToJournalLine(const T_GROUP_CHAT_MSG& chatMsg);
+	//解析一行日志,返回false表示这一行不完整
+	static bool ParseJournalLine(const std::string& strLine, ChatMsgJournalBatch_st& batch);
+private:
+	bool OpenSegment(const uint64_t nSegment);
+	bool WriteLine(const std::string& strLine);
+	bool LoadSegment(const uint64_t nSegment, ChatMsgJournalBatch_st& batch);
+	bool ListSegments(std::vector<uint64_t>& segmentVec);
+
+	std::string m_strDir;
+	std::FILE* m_pFile;
+	uint64_t m_nSegment;//当前日志文件的序号
+	bool m_bSync;
+	ChatMsgJournalBatch_st m_batch;//当前日志文件中的消息
+};
+#endif
@@ -0,0 +1,137 @@
+#include "CChatPartition.h"
+#include <ctime>
+
+const std::string CChatPartition::MAX_PARTITION = "p_max";
+
+/**
+ * @brief 公历日期到1970-01-01的天数,不依赖时区和gmtime
+ *
+ */
+static int64_t DaysFromCivil(int64_t nYear, const int64_t nMonth, const int64_t nDay)
+{
+	nYear -= nMonth <= 2 ? 1 : 0;
+	const int64_t nEra = (nYear >= 0 ? nYear : nYear - 399) / 400;
+	const int64_t nYearOfEra = nYear - nEra * 400;
+	const int64_t nDayOfYear = (153 * (nMonth + (nMonth > 2 ? -3 : 9)) + 2) / 5 + nDay - 1;
+	const int64_t nDayOfEra = nYearOfEra * 365 + nYearOfEra / 4 - nYearOfEra / 100 + nDayOfYear;
+	return nEra * 146097 + nDayOfEra - 719468;
+}
+
+/**
+ * @brief 1970-01-01以来的天数对应的年和月
+ *
+ */
+static void CivilFromDays(int64_t nDays, int& nYear, int& nMonth)
+{
+	nDays += 719468;
+	const int64_t nEra = (nDays >= 0 ? nDays : nDays - 146096) / 146097;
+	const int64_t nDayOfEra = nDays - nEra * 146097;
+	const int64_t nYearOfEra = (nDayOfEra - nDayOfEra / 1460 + nDayOfEra / 36524 - nDayOfEra / 146096) / 365;
+	const int64_t nDayOfYear = nDayOfEra - (365 * nYearOfEra + nYearOfEra / 4 - nYearOfEra / 100);
+	const int64_t nMonthPart = (5 * nDayOfYear + 2) / 153;
+	nMonth = static_cast<int>(nMonthPart < 10 ? nMonthPart + 3 : nMonthPart - 9);
+	nYear = static_cast<int>(nYearOfEra + nEra * 400 + (nMonth <= 2 ? 1 : 0));
+}
+
+int CChatPartition::CurrentMonthIndex()
+{
+	int nYear = 0;
+	int nMonth = 0;
+	CivilFromDays(static_cast<int64_t>(std::time(nullptr)) / 86400, nYear, nMonth);
+	return MonthIndex(nYear, nMonth);
+}
+
+uint64_t CChatPartition::MonthStartMsgId(const int nMonthIndex)
+{
+	int64_t nMs = DaysFromCivil(nMonthIndex / 12, nMonthIndex % 12 + 1, 1) * 86400000LL;
+	if (nMs <= static_cast<int64_t>(SNOWFLAKE_EPOCH_MS))
+	{
+		return 0;
+	}
+	return (static_cast<uint64_t>(nMs) - SNOWFLAKE_EPOCH_MS) << SNOWFLAKE_TIME_SHIFT;
+}
+
+int CChatPartition::MonthIndexOfMsgId(const uint64_t nMsgId)
+{
+	uint64_t nMs = (nMsgId >> SNOWFLAKE_TIME_SHIFT) + SNOWFLAKE_EPOCH_MS;
+	int nYear = 0;
+	int nMonth = 0;
+	CivilFromDays(static_cast<int64_t>(nMs / 86400000ULL), nYear, nMonth);
+	return MonthIndex(nYear, nMonth);
+}
+
+std::string CChatPartition::PartitionName(const int nMonthIndex)
+{
+	int nMonth = nMonthIndex % 12 + 1;
+	return "p" + std::to_string(nMonthIndex / 12) + (nMonth < 10 ? "0" : "") + std::to_string(nMonth);
+}
+
+bool CChatPartition::ParsePartitionName(const std::string& strName, int& nMonthIndex)
+{
+	if (strName.length() != 7 || strName[0] != 'p' || strName.find_first_not_of("0123456789", 1) != std::string::npos)
+	{
+		return false;
+	}
+	int nYear = std::stoi(strName.substr(1, 4));
+	int nMonth = std::stoi(strName.substr(5, 2));
+	if (nMonth < 1 || nMonth > 12)
+	{
+		return false;
+	}
+	nMonthIndex = MonthIndex(nYear, nMonth);
+	return true;
+}
+
+std::vector<ChatPartition_st> CChatPartition::MonthPartitions(const int nFirstMonth, const int nLastMonth)
+{
+	std::vector<ChatPartition_st> partVec;
+	for (int nMonth = nFirstMonth; nMonth <= nLastMonth; nMonth++)
+	{
+		ChatPartition_st part;
+		part.m_strName = PartitionName(nMonth);
+		part.m_nLessThan = MonthStartMsgId(nMonth + 1);
+		partVec.push_back(part);
+	}
+	ChatPartition_st maxPart;
+	maxPart.m_strName = MAX_PARTITION;
+	maxPart.m_bMaxValue = true;
+	partVec.push_back(maxPart);
+	return partVec;
+}
+
+std::vector<ChatPartition_st> CChatPartition::MissingPartitions(const std::vector<ChatPartition_st>& curVec, const int nLastMonth)
+{
+	std::vector<ChatPartition_st> partVec;
+	//只能从最后的p_max中拆分,其他的分区方案不处理
+	if (curVec.empty() || !curVec.back().m_bMaxValue || curVec.back().m_strName != MAX_PARTITION)
+	{
+		return partVec;
+	}
+	int nFirstMonth = CurrentMonthIndex();
+	int nMonth = 0;
+	for (const auto& item : curVec)
+	{
+		if (ParsePartitionName(item.m_strName, nMonth) && nMonth + 1 > nFirstMonth)
+		{
+			nFirstMonth = nMonth + 1;
+		}
+	}
+	partVec = MonthPartitions(nFirstMonth, nLastMonth);
+	partVec.pop_back();
+	return partVec;
+}
+
+std::vector<ChatPartition_st> CChatPartition::ColdPartitions(const std::vector<ChatPartition_st>& curVec, const int nCurMonth, const int nHotMonths)
+{
+	std::vector<ChatPartition_st> partVec;
+	int nFirstHotMonth = nCurMonth - (nHotMonths < 1 ? 1 : nHotMonths) + 1;
+	int nMonth = 0;
+	for (const auto& item : curVec)
+	{
+		if (ParsePartitionName(item.m_strName, nMonth) && nMonth < nFirstHotMonth)
+		{
+			partVec.push_back(item);
+		}
+	}
+	return partVec;
+}
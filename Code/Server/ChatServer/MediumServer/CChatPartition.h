@@ -0,0 +1,81 @@
+/**
+ * @file CChatPartition.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 聊天表按月分区的计算,分区边界为每月第一毫秒对应的SnowFlake消息ID
+ * @version 0.1
+ * @date 2020-05-10
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_CHAT_PARTITION_H_
+#define _DENNIS_THINK_C_CHAT_PARTITION_H_
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CMysqlStruct.h"
+
+/**
+ * @brief 聊天表的分区方案
+ *
+ * T_FRIEND_CHAT_MSG和T_GROUP_CHAT_MSG按F_MSG_ID做RANGE分区,分区pYYYYMM保存该月(UTC)生成的消息,
+ * 最后一个分区p_max为MAXVALUE,提前拆分出后面几个月的分区,p_max一直为空,拆分时不需要移动数据。
+ * 消息ID由SnowFlake生成,高位为毫秒时间戳,所以月份的边界就是该月第一毫秒的最小ID。
+ * 最近几个月的分区保存在MySQL中,更早的分区导出为归档文件以后整个删除。
+ */
+class CChatPartition
+{
+public:
+	static const uint64_t SNOWFLAKE_EPOCH_MS = 1480166465631ULL;//和SnowFlake.h中的start_stmp_一致
+	static const uint64_t SNOWFLAKE_TIME_SHIFT = 22;//时间戳左移的位数,和SnowFlake.h中的timestmp_left一致
+	static const std::string MAX_PARTITION;//MAXVALUE分区的名字
+
+	//月份序号,year*12+month-1,方便按月加减
+	static int MonthIndex(const int nYear, const int nMonth) { return nYear * 12 + nMonth - 1; }
+
+	//当前的月份序号(UTC)
+	static int CurrentMonthIndex();
+
+	//该月第一毫秒(UTC)对应的最小消息ID,早于SnowFlake起始时间的月份为0
+	static uint64_t MonthStartMsgId(const int nMonthIndex);
+
+	//消息ID所在的月份序号,小于起始时间的ID算作起始的月份
+	static int MonthIndexOfMsgId(const uint64_t nMsgId);
+
+	//月份对应的分区名,例如p202604
+	static std::string PartitionName(const int nMonthIndex);
+
+	/**
+	 * @brief 解析月份分区的名字
+	 *
+	 * @param strName 分区名
+	 * @param nMonthIndex 分区的月份序号
+	 * @return true 是月份分区
+	 * @return false 是p_max或者不是本方案创建的分区
+	 */
+	static bool ParsePartitionName(const std::string& strName, int& nMonthIndex);
+
+	//nFirstMonth到nLastMonth每月一个分区,最后加上p_max,用于建表和给旧表分区
+	static std::vector<ChatPartition_st> MonthPartitions(const int nFirstMonth, const int nLastMonth);
+
+	/**
+	 * @brief 计算需要从p_max中拆分出来的分区
+	 *
+	 * @param curVec 表中现有的分区,按顺序排列
+	 * @param nLastMonth 需要提前创建到的月份
+	 * @return 需要新增的月份分区,不包含p_max
+	 */
+	static std::vector<ChatPartition_st> MissingPartitions(const std::vector<ChatPartition_st>& curVec, const int nLastMonth);
+
+	/**
+	 * @brief 计算可以归档的分区,包含当前月在内的nHotMonths个月保留在数据库中
+	 *
+	 * @param curVec 表中现有的分区,按顺序排列
+	 * @param nCurMonth 当前的月份序号
+	 * @param nHotMonths 保留在数据库中的月数,小于1时按1计算
+	 * @return 可以归档的分区,按从早到晚排列
+	 */
+	static std::vector<ChatPartition_st> ColdPartitions(const std::vector<ChatPartition_st>& curVec, const int nCurMonth, const int nHotMonths);
+};
+#endif
@@ -0,0 +1,160 @@
+#include "CGroupMsgCache.h"
+#include <algorithm>
+
+std::string GroupMsgCacheStat_st::ToString() const
+{
+	return "Group:" + std::to_string(m_nGroupCount) +
+		" Msg:" + std::to_string(m_nMsgCount) +
+		" Hit:" + std::to_string(m_nHitCount) +
+		" Miss:" + std::to_string(m_nMissCount);
+}
+
+CGroupMsgCache::CGroupMsgCache(const std::size_t nRingSize, const std::size_t nGroupCount)
+	: m_nRingSize(nRingSize)
+	, m_nGroupCount(nGroupCount)
+	, m_nMsgCount(0)
+{
+}
+
+bool CGroupMsgCache::MsgIdLess(const std::string& strLeft, const std::string& strRight)
+{
+	//读取位置的默认值为'00000000',去掉前面的0再比较
+	std::size_t nLeftPos = std::min(strLeft.find_first_not_of('0'), strLeft.length());
+	std::size_t nRightPos = std::min(strRight.find_first_not_of('0'), strRight.length());
+	std::size_t nLeftLen = strLeft.length() - nLeftPos;
+	std::size_t nRightLen = strRight.length() - nRightPos;
+	if (nLeftLen != nRightLen)
+	{
+		return nLeftLen < nRightLen;
+	}
+	return strLeft.compare(nLeftPos, nLeftLen, strRight, nRightPos, nRightLen) < 0;
+}
+
+void CGroupMsgCache::SetRingSize(const std::size_t nRingSize)
+{
+	m_nRingSize = nRingSize;
+	if (0 == m_nRingSize)
+	{
+		Clear();
+		return;
+	}
+	for (auto& item : m_ringMap)
+	{
+		auto& msgQueue = item.second.m_msgQueue;
+		while (msgQueue.size() > m_nRingSize)
+		{
+			msgQueue.pop_front();
+			m_nMsgCount--;
+		}
+	}
+}
+
+void CGroupMsgCache::SetGroupCount(const std::size_t nGroupCount)
+{
+	m_nGroupCount = nGroupCount;
+	Evict();
+}
+
+void CGroupMsgCache::Append(const T_GROUP_CHAT_MSG& msg)
+{
+	if (0 == m_nRingSize || 0 == m_nGroupCount)
+	{
+		return;
+	}
+	auto item = m_ringMap.find(msg.m_strF_GROUP_ID);
+	if (item == m_ringMap.end())
+	{
+		m_lruList.push_front(msg.m_strF_GROUP_ID);
+		Ring_st ring;
+		ring.m_lruPos = m_lruList.begin();
+		item = m_ringMap.insert({ msg.m_strF_GROUP_ID, std::move(ring) }).first;
+	}
+	else
+	{
+		m_lruList.splice(m_lruList.begin(), m_lruList, item->second.m_lruPos);
+	}
+	auto& msgQueue = item->second.m_msgQueue;
+	//入库完成的顺序一般就是ID的顺序,乱序时插入到对应的位置
+	if (msgQueue.empty() || MsgIdLess(msgQueue.back().m_strF_MSG_ID, msg.m_strF_MSG_ID))
+	{
+		msgQueue.push_back(msg);
+	}
+	else
+	{
+		auto pos = std::upper_bound(msgQueue.begin(), msgQueue.end(), msg.m_strF_MSG_ID,
+			[](const std::string& strMsgId, const T_GROUP_CHAT_MSG& other) { return MsgIdLess(strMsgId, other.m_strF_MSG_ID); });
+		msgQueue.insert(pos, msg);
+	}
+	m_nMsgCount++;
+	if (msgQueue.size() > m_nRingSize)
+	{
+		msgQueue.pop_front();
+		m_nMsgCount--;
+	}
+	Evict();
+}
+
+bool CGroupMsgCache::GetAfter(const std::string& strGroupId, const std::string& strLastMsgId, const std::size_t nLimit, std::vector<T_GROUP_CHAT_MSG>& msgVec)
+{
+	msgVec.clear();
+	auto item = m_ringMap.find(strGroupId);
+	//读取位置早于缓存中最早的消息时,中间可能有没有缓存的消息
+	if (item == m_ringMap.end() || item->second.m_msgQueue.empty() ||
+		MsgIdLess(strLastMsgId, item->second.m_msgQueue.front().m_strF_MSG_ID))
+	{
+		m_stat.m_nMissCount++;
+		return false;
+	}
+	const auto& msgQueue = item->second.m_msgQueue;
+	auto pos = std::upper_bound(msgQueue.begin(), msgQueue.end(), strLastMsgId,
+		[](const std::string& strMsgId, const T_GROUP_CHAT_MSG& other) { return MsgIdLess(strMsgId, other.m_strF_MSG_ID); });
+	for (; pos != msgQueue.end() && msgVec.size() < nLimit; ++pos)
+	{
+		msgVec.push_back(*pos);
+	}
+	m_stat.m_nHitCount++;
+	return true;
+}
+
+void CGroupMsgCache::Invalidate(const std::string& strGroupId)
+{
+	auto item = m_ringMap.find(strGroupId);
+	if (item != m_ringMap.end())
+	{
+		m_nMsgCount -= item->second.m_msgQueue.size();
+		m_lruList.erase(item->second.m_lruPos);
+		m_ringMap.erase(item);
+	}
+}
+
+void CGroupMsgCache::Clear()
+{
+	m_lruList.clear();
+	m_ringMap.clear();
+	m_nMsgCount = 0;
+}
+
+GroupMsgCacheStat_st CGroupMsgCache::Stat(const bool bReset)
+{
+	GroupMsgCacheStat_st stat = m_stat;
+	stat.m_nGroupCount = m_ringMap.size();
+	stat.m_nMsgCount = m_nMsgCount;
+	if (bReset)
+	{
+		m_stat = GroupMsgCacheStat_st();
+	}
+	return stat;
+}
+
+/**
+ * @brief 超过群组数时从最久没有消息的群组开始淘汰
+ *
+ */
+void CGroupMsgCache::Evict()
+{
+	while (m_ringMap.size() > m_nGroupCount && !m_lruList.empty())
+	{
+		std::string strGroupId = m_lruList.back();
+		Invalidate(strGroupId);
+	}
+}
@@ -0,0 +1,98 @@
+/**
+ * @file CGroupMsgCache.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 每个群组最近消息的内存缓存,在线成员读取新消息时不再每人查询一次数据库
+ * @version 0.1
+ * @date 2020-04-19
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_GROUP_MSG_CACHE_H_
+#define _DENNIS_THINK_C_GROUP_MSG_CACHE_H_
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "CMysqlStruct.h"
+
+/**
+ * @brief 缓存的统计
+ *
+ */
+struct GroupMsgCacheStat_st
+{
+	std::size_t m_nGroupCount = 0;//缓存的群组数
+	std::size_t m_nMsgCount = 0;//缓存的消息数
+	uint64_t m_nHitCount = 0;//读取位置在缓存范围内的次数
+	uint64_t m_nMissCount = 0;//需要查询数据库的次数
+
+	std::string ToString() const;
+};
+
+/**
+ * @brief 每个群组保存最近的若干条消息,按消息ID排序,超过条数时丢弃最早的消息
+ *
+ * 消息ID由SnowFlake生成,同一个群组的消息按ID递增入库。用户的读取位置不早于缓存中最早的消息时,
+ * 读取位置以后的消息全部在缓存中,否则返回false,由调用者查询数据库。
+ * 群组数超过上限时淘汰最久没有消息的群组。没有加锁,只在CChatServer的strand上使用。
+ */
+class CGroupMsgCache
+{
+public:
+	static const std::size_t DEFAULT_RING_SIZE = 256;//默认每个群组缓存的消息条数
+	static const std::size_t DEFAULT_GROUP_COUNT = 10000;//默认最多缓存的群组数
+
+	explicit CGroupMsgCache(const std::size_t nRingSize = DEFAULT_RING_SIZE, const std::size_t nGroupCount = DEFAULT_GROUP_COUNT);
+
+	//设置每个群组缓存的消息条数,0表示不缓存
+	void SetRingSize(const std::size_t nRingSize);
+
+	void SetGroupCount(const std::size_t nGroupCount);
+
+	std::size_t RingSize() const { return m_nRingSize; }
+
+	//消息入库成功以后加入缓存
+	void Append(const T_GROUP_CHAT_MSG& msg);
+
+	/**
+	 * @brief 读取群组中某条消息以后的消息
+	 *
+	 * @param strGroupId 群组ID
+	 * @param strLastMsgId 用户已经读取的最后一条消息ID
+	 * @param nLimit 最多读取的条数
+	 * @param msgVec 读取到的消息,可能为空
+	 * @return true 读取位置在缓存范围内
+	 * @return false 不在缓存范围内,需要查询数据库
+	 */
+	bool GetAfter(const std::string& strGroupId, const std::string& strLastMsgId, const std::size_t nLimit, std::vector<T_GROUP_CHAT_MSG>& msgVec);
+
+	//群组解散以后删除缓存
+	void Invalidate(const std::string& strGroupId);
+
+	void Clear();
+
+	GroupMsgCacheStat_st Stat(const bool bReset = false);
+
+	//按数值比较两个消息ID
+	static bool MsgIdLess(const std::string& strLeft, const std::string& strRight);
+private:
+	struct Ring_st
+	{
+		std::deque<T_GROUP_CHAT_MSG> m_msgQueue;
+		std::list<std::string>::iterator m_lruPos;
+	};
+
+	void Evict();
+
+	std::size_t m_nRingSize;
+	std::size_t m_nGroupCount;
+	std::size_t m_nMsgCount;
+	std::list<std::string> m_lruList;//最近有消息的群组在最前面
+	std::unordered_map<std::string, Ring_st> m_ringMap;
+	GroupMsgCacheStat_st m_stat;
+};
+#endif
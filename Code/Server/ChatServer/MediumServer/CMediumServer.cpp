@@ -15,8 +15,14 @@
 #include "EncodingUtil.h"
 #include "CTimeUtil.h"
 #include "md5.h"
+#include <limits>
+#include <random>
 const std::string DEFAULT_TEAM_ID = "10000000";
 const std::string DEFAULT_TEAM_NAME = u8"我的好友";
+//一批群聊消息的估算长度上限,不超过未协商时的单条消息长度
+const std::size_t GROUP_MSG_BATCH_LENGTH = MSG_DEFAULT_FRAME_SIZE - FILE_DATA_FRAME_RESERVE;
+//每条群聊消息除内容和字体以外的字段按json编码估算的长度
+const std::size_t GROUP_MSG_ITEM_RESERVE = 256;
 namespace ChatServer
 {
 std::shared_ptr<spdlog::logger> CChatServer::ms_loger;
@@ -102,6 +108,186 @@ void CChatServer::loadConfig(const json11::Json &cfg, std::error_code& ec)
 
 		}
 
+		//数据库连接池,poolsize为0时所有数据库操作在业务strand上执行
+		if (mysqlCfg["poolsize"].is_number() && mysqlCfg["poolsize"].int_value() >= 0)
+		{
+			m_dbExecutorCfg.m_nWorkerCount = static_cast<std::size_t>(mysqlCfg["poolsize"].int_value());
+		}
+		if (mysqlCfg["querytimeout"].is_number() && mysqlCfg["querytimeout"].int_value() > 0)
+		{
+			m_dbExecutorCfg.m_nQueryTimeout = mysqlCfg["querytimeout"].int_value();
+		}
+		if (mysqlCfg["pinginterval"].is_number() && mysqlCfg["pinginterval"].int_value() > 0)
+		{
+			m_dbExecutorCfg.m_nPingIntervalMs = mysqlCfg["pinginterval"].int_value() * 1000;
+		}
+		if (mysqlCfg["slowquery"].is_number() && mysqlCfg["slowquery"].int_value() > 0)
+		{
+			m_dbExecutorCfg.m_nSlowQueryMs = mysqlCfg["slowquery"].int_value();
+		}
+		LOG_INFO(ms_loger, "Db Pool Size:{} Query Timeout:{}s Ping Interval:{}ms Slow Query:{}ms [{} {}]", m_dbExecutorCfg.m_nWorkerCount, m_dbExecutorCfg.m_nQueryTimeout, m_dbExecutorCfg.m_nPingIntervalMs, m_dbExecutorCfg.m_nSlowQueryMs, __FILENAME__, __LINE__);
+	}
+	//文件传输时同时在途的数据包个数
+	if (cfg["filewindow"].is_number() && cfg["filewindow"].int_value() > 0)
+	{
+		m_nFileWindowSize = cfg["filewindow"].int_value();
+	}
+	LOG_INFO(ms_loger, "File Window:{} [{} {}]", m_nFileWindowSize, __FILENAME__, __LINE__);
+	//好友关系缓存的用户数,0表示不缓存
+	if (cfg["friendcachesize"].is_number() && cfg["friendcachesize"].int_value() >= 0)
+	{
+		m_friendCache.SetCapacity(static_cast<std::size_t>(cfg["friendcachesize"].int_value()));
+	}
+	LOG_INFO(ms_loger, "Friend Cache Size:{} [{} {}]", m_friendCache.Capacity(), __FILENAME__, __LINE__);
+	//每个群组缓存的最近消息条数,0表示不缓存
+	if (cfg["groupmsgcache"].is_number() && cfg["groupmsgcache"].int_value() >= 0)
+	{
+		m_groupMsgCache.SetRingSize(static_cast<std::size_t>(cfg["groupmsgcache"].int_value()));
+	}
+	LOG_INFO(ms_loger, "Group Msg Cache Size:{} [{} {}]", m_groupMsgCache.RingSize(), __FILENAME__, __LINE__);
+	//聊天消息的本地日志,dir为空时消息同步入库
+	{
+		auto journalCfg = cfg["journal"];
+		if (journalCfg["dir"].is_string())
+		{
+			m_strJournalDir = journalCfg["dir"].string_value();
+		}
+		if (journalCfg["sync"].is_bool())
+		{
+			m_bJournalSync = journalCfg["sync"].bool_value();
+		}
+		if (journalCfg["flushrows"].is_number() && journalCfg["flushrows"].int_value() > 0)
+		{
+			m_nJournalFlushRows = static_cast<std::size_t>(journalCfg["flushrows"].int_value());
+		}
+		if (journalCfg["flushms"].is_number() && journalCfg["flushms"].int_value() > 0)
+		{
+			m_nJournalFlushMs = journalCfg["flushms"].int_value();
+		}
+		LOG_INFO(ms_loger, "Chat Msg Journal Dir:{} Sync:{} Flush Rows:{} Flush Interval:{}ms [{} {}]", m_strJournalDir, m_bJournalSync, m_nJournalFlushRows, m_nJournalFlushMs, __FILENAME__, __LINE__);
+	}
+	//在线用户的分片数,每个分片的用户在自己的strand上处理,以及是否把在线状态写入数据库
+	{
+		auto presenceCfg = cfg["presence"];
+		if (presenceCfg["shards"].is_number() && presenceCfg["shards"].int_value() > 0)
+		{
+			m_presence.SetShardCount(static_cast<std::size_t>(presenceCfg["shards"].int_value()));
+		}
+		if (presenceCfg["savestate"].is_bool())
+		{
+			m_bSaveOnlineState = presenceCfg["savestate"].bool_value();
+		}
+		LOG_INFO(ms_loger, "Presence Shards:{} Save State:{} [{} {}]", m_presence.ShardCount(), m_bSaveOnlineState, __FILENAME__, __LINE__);
+	}
+	//聊天表的分区和冷分区的归档,dir为空时不归档
+	{
+		auto archiveCfg = cfg["archive"];
+		if (archiveCfg["dir"].is_string())
+		{
+			m_strArchiveDir = archiveCfg["dir"].string_value();
+		}
+		//至少保留上个月,避免导出时还有日志中的消息写入要删除的分区
+		if (archiveCfg["hotmonths"].is_number() && archiveCfg["hotmonths"].int_value() >= 2)
+		{
+			m_nArchiveHotMonths = archiveCfg["hotmonths"].int_value();
+		}
+		if (archiveCfg["aheadmonths"].is_number() && archiveCfg["aheadmonths"].int_value() >= 1)
+		{
+			m_nArchiveAheadMonths = archiveCfg["aheadmonths"].int_value();
+		}
+		if (archiveCfg["interval"].is_number() && archiveCfg["interval"].int_value() > 0)
+		{
+			m_nArchiveIntervalSec = archiveCfg["interval"].int_value();
+		}
+		LOG_INFO(ms_loger, "Chat Archive Dir:{} Hot Months:{} Ahead Months:{} Interval:{}s [{} {}]", m_strArchiveDir, m_nArchiveHotMonths, m_nArchiveAheadMonths, m_nArchiveIntervalSec, __FILENAME__, __LINE__);
+	}
+	//按内容Hash保存图片和文件,dir为空时按文件名保存
+	{
+		auto blobCfg = cfg["blob"];
+		if (blobCfg["dir"].is_string())
+		{
+			m_strBlobDir = blobCfg["dir"].string_value();
+		}
+		LOG_INFO(ms_loger, "Blob Store Dir:{} [{} {}]", m_strBlobDir, __FILENAME__, __LINE__);
+	}
+	//文件读写线程池,workers为0时在业务strand上读写
+	{
+		auto fileIoCfg = cfg["fileio"];
+		if (fileIoCfg["workers"].is_number() && fileIoCfg["workers"].int_value() >= 0)
+		{
+			m_fileIoCfg.m_nWorkerCount = static_cast<std::size_t>(fileIoCfg["workers"].int_value());
+		}
+		if (fileIoCfg["slowio"].is_number() && fileIoCfg["slowio"].int_value() > 0)
+		{
+			m_fileIoCfg.m_nSlowIoMs = fileIoCfg["slowio"].int_value();
+		}
+		LOG_INFO(ms_loger, "File Io Workers:{} Slow Io:{}ms [{} {}]", m_fileIoCfg.m_nWorkerCount, m_fileIoCfg.m_nSlowIoMs, __FILENAME__, __LINE__);
+	}
+
+	//登录时和客户端协商的单条消息最大长度和文件数据包长度
+	if (cfg["maxframesize"].is_number() && cfg["maxframesize"].int_value() > 0)
+	{
+		m_nMaxFrameSize = cfg["maxframesize"].int_value();
+	}
+	if (cfg["chunksize"].is_number() && cfg["chunksize"].int_value() > 0)
+	{
+		m_nChunkSize = cfg["chunksize"].int_value();
+	}
+	LOG_INFO(ms_loger, "Max Frame Size:{} Chunk Size:{} [{} {}]", m_nMaxFrameSize, m_nChunkSize, __FILENAME__, __LINE__);
+	//登录时和客户端协商的每批群聊消息条数,0表示逐条下发
+	if (cfg["groupmsgbatch"].is_number() && cfg["groupmsgbatch"].int_value() >= 0)
+	{
+		m_nGroupMsgBatch = cfg["groupmsgbatch"].int_value();
+	}
+	LOG_INFO(ms_loger, "Group Msg Batch:{} [{} {}]", m_nGroupMsgBatch, __FILENAME__, __LINE__);
+	//离线好友消息同时在途的条数和每次从数据库读取的条数
+	if (cfg["friendmsgwindow"].is_number() && cfg["friendmsgwindow"].int_value() > 0)
+	{
+		m_nUnReadMsgWindow = cfg["friendmsgwindow"].int_value();
+	}
+	if (cfg["friendmsgpage"].is_number() && cfg["friendmsgpage"].int_value() > 0)
+	{
+		m_nUnReadMsgPageSize = cfg["friendmsgpage"].int_value();
+	}
+	LOG_INFO(ms_loger, "Friend Msg Window:{} Page:{} [{} {}]", m_nUnReadMsgWindow, m_nUnReadMsgPageSize, __FILENAME__, __LINE__);
+
+	//每个会话发送队列的高低水位和过载策略
+	{
+		auto sendQueueCfg = cfg["sendqueue"];
+		SendQueueCfg_st& queueCfg = CServerSess::ms_sendQueueCfg;
+		if (sendQueueCfg["highbytes"].is_number() && sendQueueCfg["highbytes"].int_value() > 0)
+		{
+			queueCfg.m_nHighBytes = static_cast<std::size_t>(sendQueueCfg["highbytes"].int_value());
+		}
+		if (sendQueueCfg["lowbytes"].is_number() && sendQueueCfg["lowbytes"].int_value() >= 0)
+		{
+			queueCfg.m_nLowBytes = static_cast<std::size_t>(sendQueueCfg["lowbytes"].int_value());
+		}
+		if (sendQueueCfg["highcount"].is_number() && sendQueueCfg["highcount"].int_value() > 0)
+		{
+			queueCfg.m_nHighCount = static_cast<std::size_t>(sendQueueCfg["highcount"].int_value());
+		}
+		if (sendQueueCfg["lowcount"].is_number() && sendQueueCfg["lowcount"].int_value() >= 0)
+		{
+			queueCfg.m_nLowCount = static_cast<std::size_t>(sendQueueCfg["lowcount"].int_value());
+		}
+		if (sendQueueCfg["policy"].is_string() && !ParseSendQueuePolicy(sendQueueCfg["policy"].string_value(), queueCfg.m_policy))
+		{
+			LOG_WARN(ms_loger, "Unknown Send Queue Policy:{} [{} {}]", sendQueueCfg["policy"].string_value(), __FILENAME__, __LINE__);
+		}
+		LOG_INFO(ms_loger, "Send Queue High:{}/{} Low:{}/{} Policy:{} [{} {}]", queueCfg.m_nHighBytes, queueCfg.m_nHighCount, queueCfg.m_nLowBytes, queueCfg.m_nLowCount, SendQueuePolicyName(queueCfg.m_policy), __FILENAME__, __LINE__);
+	}
+
+	//收发消息日志的内容采样
+	{
+		E_PAYLOAD_LOG mode = CLogSampler::Mode();
+		if (cfg["logpayload"].is_string() && !ParsePayloadLogMode(cfg["logpayload"].string_value(), mode))
+		{
+			LOG_WARN(ms_loger, "Unknown Payload Log Mode:{} [{} {}]", cfg["logpayload"].string_value(), __FILENAME__, __LINE__);
+		}
+		uint32_t nSampleRate = cfg["logsamplerate"].is_number() && cfg["logsamplerate"].int_value() > 0 ? static_cast<uint32_t>(cfg["logsamplerate"].int_value()) : 100;
+		CLogSampler::SetMode(mode, nSampleRate);
+		LOG_INFO(ms_loger, "Payload Log Mode:{} SampleRate:{} [{} {}]", PayloadLogModeName(mode), CLogSampler::SampleRate(), __FILENAME__, __LINE__);
 	}
 }
 
@@ -138,15 +324,28 @@ void CChatServer::HandleUserKeepAliveRsp(const std::shared_ptr<CServerSess> pSes
 	}
 }
 /**
- * @brief 检查所有的socket连接
+ * @brief 检查所有的socket连接,每个分片在自己的strand上检查
  * 
  */
 void CChatServer::CheckAllConnect()
 {
-	for (auto item : m_UserSessVec) {
-		OnAddFriendNotifyReqMsg(item.first);
-		OnAddFriendRecvReqMsg(item.first);
-		//OnUserReceiveMsg(item.first);
+	auto pSelf = shared_from_this();
+	for (std::size_t i = 0; i < m_userShardVec.size(); i++)
+	{
+		m_userShardVec[i]->m_strand.post([this, pSelf, i]() {
+			std::vector<std::string> userIdVec;
+			m_presence.ForEach(i, [&userIdVec](UserPresence_st& user) {
+				if (user.m_pSess)
+				{
+					userIdVec.push_back(user.m_strUserId);
+				}
+			});
+			for (const auto& strUserId : userIdVec) {
+				OnAddFriendNotifyReqMsg(strUserId);
+				OnAddFriendRecvReqMsg(strUserId);
+				//OnUserReceiveMsg(strUserId);
+			}
+		});
 	}
 }
 
@@ -158,7 +357,7 @@ void CChatServer::do_accept()
 {
 	LOG_INFO(ms_loger,"CMediumServer do_accept[{} {}]", __FILENAME__, __LINE__);
 	auto pSelf = shared_from_this();
-	m_acceptor.async_accept(m_socket, [this,pSelf](std::error_code ec) {
+	m_acceptor.async_accept(m_socket, m_strand.wrap([this,pSelf](std::error_code ec) {
 		if (!ec)
 		{
 			LOG_INFO(ms_loger,"Server accept Successed [{} {}]", __FILENAME__, __LINE__);
@@ -168,7 +367,7 @@ void CChatServer::do_accept()
 			do_accept();
 		}
 
-	});
+	}));
 }
 
 /**
@@ -177,7 +376,41 @@ void CChatServer::do_accept()
  */
 void CChatServer::OnTimer()
 {
-	LOG_INFO(this->ms_loger,"{} Users Is OnLine Chat Server [ {} {} ]",m_UserSessVec.size(), __FILENAME__,__LINE__);
+	LOG_INFO(this->ms_loger,"Presence {} Chat Server [ {} {} ]",m_presence.Stat().ToString(), __FILENAME__,__LINE__);
+	if (m_blobStore.IsOpen())
+	{
+		LOG_INFO(ms_loger, "Blob Store {} [{} {}]", m_blobStore.Stat().ToString(), __FILENAME__, __LINE__);
+	}
+	m_presence.ForEach([](UserPresence_st& user) {
+		if (user.m_pSess)
+		{
+			user.m_pSess->ReportSendStat();
+		}
+	});
+	FlushUserOnlineState();
+	ReportDispatchStat();
+	ReportDbStat();
+	ReportFileIoStat();
+	{
+		std::lock_guard<std::mutex> lock(m_friendCacheMutex);
+		LOG_INFO(ms_loger, "Friend Cache {} [{} {}]", m_friendCache.Stat(true).ToString(), __FILENAME__, __LINE__);
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_groupMsgCacheMutex);
+		LOG_INFO(ms_loger, "Group Msg Cache {} [{} {}]", m_groupMsgCache.Stat(true).ToString(), __FILENAME__, __LINE__);
+	}
+	std::size_t nJournalPending = JournalPendingCount();
+	if (nJournalPending > 0 || !m_journalBatchQueue.empty())
+	{
+		LOG_INFO(ms_loger, "Chat Msg Journal Pending:{} Batches:{} [{} {}]", nJournalPending, m_journalBatchQueue.size(), __FILENAME__, __LINE__);
+	}
+	MaintainChatArchive();
+	//连接池没有启动时数据库操作使用m_util,连接空闲时可能被数据库断开,定时检查并重连
+	if (!m_dbExecutor.IsRunning())
+	{
+		std::lock_guard<std::mutex> lock(m_utilMutex);
+		m_util.Ping();
+	}
 	CheckAllConnect();
 }
 
@@ -192,7 +425,7 @@ void CChatServer::SetTimer(int nSeconds)
 	{
 		m_timer->expires_from_now(std::chrono::seconds(nSeconds));
 		auto self = shared_from_this();
-		m_timer->async_wait([this,nSeconds,self](const std::error_code& ec){
+		m_timer->async_wait(m_strand.wrap([this,nSeconds,self](const std::error_code& ec){
 			if(!ec)
 			{
 				this->OnTimer();
@@ -202,331 +435,706 @@ void CChatServer::SetTimer(int nSeconds)
 			{
 				LOG_WARN(this->ms_loger,"On Timer at ChatServer {}  [{} {}]",ec.message(),__FILENAME__,__LINE__);
 			}
-		});
+		}));
 	}
 }
 
 /**
- * @brief TCP消息处理,根据消息类型分发收到的TCP消息
+ * @brief 注册TCP消息的处理函数,新增的消息类型在此处增加一行注册
  * 
- * @param pSess 用户会话
- * @param pMsg TCP消息
  */
-void CChatServer::DispatchRecvTcpMsg(const std::shared_ptr<CServerSess> pSess, const TransBaseMsg_t* pMsg)
+void CChatServer::RegisterTcpHandlers()
 {
-	if (pMsg->GetType() != E_MsgType::FileRecvDataReq_Type && pMsg->GetType() != E_MsgType::FileSendDataReq_Type)
-	{
-		LOG_INFO(ms_loger, "[ {} ] RECV: [ {} {} ]  [ {} {} ]", pSess->UserId(), MsgType(pMsg->GetType()), pMsg->to_string(), __FILENAME__, __LINE__);
-	}
-	switch (pMsg->GetType())
-	{
-	case E_MsgType::KeepAliveReq_Type:
+	m_tcpDispatcher.Register<KeepAliveReqMsg>(E_MsgType::KeepAliveReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const KeepAliveReqMsg& msg) {
+		HandleUserKeepAliveReq(pSess, msg);
+		auto pSelf = shared_from_this();
+		std::string strClientId = msg.m_strClientId;
+		m_strand.post([this, pSelf, strClientId]() { CheckFileDataRsp(strClientId); });
+	});
+	m_tcpDispatcher.Register<KeepAliveRspMsg>(E_MsgType::KeepAliveRsp_Type, [this](const std::shared_ptr<CServerSess>& pSess, const KeepAliveRspMsg& msg) { HandleUserKeepAliveRsp(pSess, msg); });
+	m_tcpDispatcher.Register<UserLoginReqMsg>(E_MsgType::UserLoginReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const UserLoginReqMsg& msg) { HandleUserLoginReq(pSess, msg); });
+	m_tcpDispatcher.Register<UserLogoutReqMsg>(E_MsgType::UserLogoutReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const UserLogoutReqMsg& msg) { HandleUserLogoutReq(pSess, msg); });
+	m_tcpDispatcher.Register<UserRegisterReqMsg>(E_MsgType::UserRegisterReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const UserRegisterReqMsg& msg) { HandleUserRegisterReq(pSess, msg); });
+	m_tcpDispatcher.Register<UserUnRegisterReqMsg>(E_MsgType::UserUnRegisterReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const UserUnRegisterReqMsg& msg) { HandleUserUnRegisterReq(pSess, msg); });
+	m_tcpDispatcher.Register<FriendChatSendTxtReqMsg>(E_MsgType::FriendChatSendTxtMsgReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FriendChatSendTxtReqMsg& msg) { HandleFriendChatSendTxtReq(pSess, msg); });
+	m_tcpDispatcher.Register<FriendChatRecvTxtRspMsg>(E_MsgType::FriendChatReceiveTxtMsgRsp_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FriendChatRecvTxtRspMsg& msg) { HandleFriendChatRecvMsgRsp(pSess, msg); });
+	m_tcpDispatcher.Register<GetFriendListReqMsg>(E_MsgType::GetFriendListReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const GetFriendListReqMsg& msg) { HandleGetFriendListReq(pSess, msg); });
+	m_tcpDispatcher.Register<FindFriendReqMsg>(E_MsgType::FindFriendReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FindFriendReqMsg& msg) { HandleFindFriendReq(pSess, msg); });
+	m_tcpDispatcher.Register<AddFriendSendReqMsg>(E_MsgType::AddFriendSendReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const AddFriendSendReqMsg& msg) { HandleAddFriendReq(pSess, msg); });
+	m_tcpDispatcher.Register<AddFriendRecvRspMsg>(E_MsgType::AddFriendRecvRsp_Type, [this](const std::shared_ptr<CServerSess>& /*pSess*/, const AddFriendRecvRspMsg& msg) { HandleAddFriendRecvRsp(msg); });
+	m_tcpDispatcher.Register<AddFriendNotifyRspMsg>(E_MsgType::AddFriendNotifyRsp_Type, [this](const std::shared_ptr<CServerSess>& pSess, const AddFriendNotifyRspMsg& msg) { HandleAddFriendNotifyRsp(pSess, msg); });
+	m_tcpDispatcher.Register<RemoveFriendReqMsg>(E_MsgType::RemoveFriendReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const RemoveFriendReqMsg& msg) { HandleRemoveFriendReq(pSess, msg); });
+	m_tcpDispatcher.Register<AddTeamReqMsg>(E_MsgType::AddTeamReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const AddTeamReqMsg& msg) { HandleAddTeamReq(pSess, msg); });
+	m_tcpDispatcher.Register<RemoveTeamReqMsg>(E_MsgType::RemoveTeamReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const RemoveTeamReqMsg& msg) { HandleRemoveTeamReq(pSess, msg); });
+	m_tcpDispatcher.Register<MoveFriendToTeamReqMsg>(E_MsgType::MoveFriendToTeamReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const MoveFriendToTeamReqMsg& msg) { HandleMoveFriendToTeamReq(pSess, msg); });
+	m_tcpDispatcher.Register<CreateGroupReqMsg>(E_MsgType::CreateGroupReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const CreateGroupReqMsg& msg) { HandleCreateGroupReq(pSess, msg); });
+	m_tcpDispatcher.Register<DestroyGroupReqMsg>(E_MsgType::DestroyGroupReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const DestroyGroupReqMsg& msg) { HandleDestroyGroupReq(pSess, msg); });
+	m_tcpDispatcher.Register<FindGroupReqMsg>(E_MsgType::FindGroupReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FindGroupReqMsg& msg) { HandleFindGroupReq(pSess, msg); });
+	m_tcpDispatcher.Register<GetGroupListReqMsg>(E_MsgType::GetGroupListReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const GetGroupListReqMsg& msg) { HandleGetGroupListReq(pSess, msg); });
+	m_tcpDispatcher.Register<SendGroupTextMsgReqMsg>(E_MsgType::SendGroupTextMsgReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const SendGroupTextMsgReqMsg& msg) { HandleSendGroupTextReq(pSess, msg); });
+	m_tcpDispatcher.Register<AddToGroupReqMsg>(E_MsgType::AddToGroupReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const AddToGroupReqMsg& msg) { HandleAddToGroupReq(pSess, msg); });
+	m_tcpDispatcher.Register<FileDataRecvRspMsg>(E_MsgType::FileRecvDataRsp_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FileDataRecvRspMsg& msg) { HandleFileDataRecvRsp(pSess, msg); });
+	m_tcpDispatcher.Register<QuitFromGroupReqMsg>(E_MsgType::QuitGroupReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const QuitFromGroupReqMsg& msg) { HandleQuitGroupReqMsg(pSess, msg); });
+	m_tcpDispatcher.Register<RecvGroupTextMsgRspMsg>(E_MsgType::RecvGroupTextMsgRsp_Type, [this](const std::shared_ptr<CServerSess>& pSess, const RecvGroupTextMsgRspMsg& msg) { HandleRecvGroupTextMsgRspMsg(pSess, msg); });
+	m_tcpDispatcher.Register<FriendSendFileMsgReqMsg>(E_MsgType::FriendSendFileMsgReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FriendSendFileMsgReqMsg& msg) { HandleFriendSendFileReq(pSess, msg); });
+	m_tcpDispatcher.Register<FriendRecvFileMsgRspMsg>(E_MsgType::FriendRecvFileMsgRsp_Type, [this](const std::shared_ptr<CServerSess>& /*pSess*/, const FriendRecvFileMsgRspMsg& msg) { HandleFriendRecvFileRsp(msg); });
+	m_tcpDispatcher.Register<FriendNotifyFileMsgRspMsg>(E_MsgType::FriendNotifyFileMsgRsp_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FriendNotifyFileMsgRspMsg& msg) { HandleFriendNotifyFileRsp(pSess, msg); });
+	m_tcpDispatcher.Register<FileVerifyReqMsg>(E_MsgType::FileVerifyReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FileVerifyReqMsg& msg) { HandleFileVerifyReq(pSess, msg); });
+	m_tcpDispatcher.Register<FileVerifyRspMsg>(E_MsgType::FileVerifyRsp_Type, [this](const std::shared_ptr<CServerSess>& /*pSess*/, const FileVerifyRspMsg& msg) { HandleFileVerifyRsp(msg); });
+	m_tcpDispatcher.Register<UserKickOffRspMsg>(E_MsgType::UserKickOffRsp_Type, [this](const std::shared_ptr<CServerSess>& /*pSess*/, const UserKickOffRspMsg& msg) { HandleUserKickOffRsp(msg); });
+	m_tcpDispatcher.Register<FriendUnReadNotifyRspMsg>(E_MsgType::FriendUnReadMsgNotifyRsp_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FriendUnReadNotifyRspMsg& msg) { HandleFriendUnReadNotifyRspMsg(pSess, msg); });
+	m_tcpDispatcher.Register<UpdateFriendListNotifyRspMsg>(E_MsgType::UpdateFriendListNotifyRsp_Type, [this](const std::shared_ptr<CServerSess>& /*pSess*/, const UpdateFriendListNotifyRspMsg& msg) { HandleUpdateFriendListRsp(msg); });
+	m_tcpDispatcher.Register<UpdateGroupListNotifyRspMsg>(E_MsgType::UpdateGroupListNotifyRsp_Type, [this](const std::shared_ptr<CServerSess>& /*pSess*/, const UpdateGroupListNotifyRspMsg& msg) { HandleUpdateGroupListRsp(msg); });
+	m_tcpDispatcher.Register<QueryUserUdpAddrReqMsg>(E_MsgType::QueryUserUdpAddrReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const QueryUserUdpAddrReqMsg& msg) { HandleQueryUserUdpAddr(pSess, msg); });
+	m_tcpDispatcher.Register<FileSendDataBeginReq>(E_MsgType::FileSendDataBeginReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginReq& msg) { HandleFileSendDataBeginReq(pSess, msg); });
+	m_tcpDispatcher.Register<FileSendDataBeginRsp>(E_MsgType::FileSendDataBeginRsp_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginRsp& msg) { HandleFileSendDataBeginRsp(pSess, msg); });
+	m_tcpDispatcher.Register<FileDataSendReqMsg>(E_MsgType::FileSendDataReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FileDataSendReqMsg& msg) { HandleFileDataSendReq(pSess, msg); });
+	m_tcpDispatcher.Register<FileDownLoadReqMsg>(E_MsgType::FileDownLoadReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const FileDownLoadReqMsg& msg) { HandleFileDownLoadReq(pSess, msg); });
+	m_tcpDispatcher.Register<GetRandomUserReqMsg>(E_MsgType::GetRandomUserReq_Type, [this](const std::shared_ptr<CServerSess>& pSess, const GetRandomUserReqMsg& msg) { HandleGetRandomUserReq(pSess, msg); });
+	m_tcpDispatcher.Register<NotifyGroupMsgRspMsg>(E_MsgType::NotifyGroupMsgRsp_Type, [this](const std::shared_ptr<CServerSess>& pSess, const NotifyGroupMsgRspMsg& msg) { HandleNotifyGroupMsgRsp(pSess, msg); });
+}
+
+/**
+ * @brief 为每个m_presence的分片创建strand和分发器
+ * 
+ */
+void CChatServer::StartUserShards()
+{
+	m_userShardVec.clear();
+	for (std::size_t i = 0; i < m_presence.ShardCount(); i++)
 	{
-		KeepAliveReqMsg msg;
-		if (msg.FromString(pMsg->to_string()))
-		{
-			HandleUserKeepAliveReq(pSess, msg);
-		}
-		CheckFileDataRsp(msg.m_strClientId);
+		std::unique_ptr<UserShard_st> pShard(new UserShard_st(m_ioService));
+		pShard->m_tcpDispatcher = m_tcpDispatcher;
+		m_userShardVec.push_back(std::move(pShard));
 	}
-	break;
-	case E_MsgType::KeepAliveRsp_Type:
+	LOG_INFO(ms_loger, "User Shards:{} [{} {}]", m_userShardVec.size(), __FILENAME__, __LINE__);
+}
+
+/**
+ * @brief 用户所在的分片
+ * 
+ * @param strUserId 用户ID,未登录的会话为空,空ID也对应一个固定的分片
+ * @return UserShard_st& 用户所在的分片
+ */
+UserShard_st& CChatServer::UserShard(const std::string& strUserId)
+{
+	return *m_userShardVec[m_presence.ShardIndex(strUserId)];
+}
+
+/**
+ * @brief 当前线程正在执行的strand,数据库操作的结果回到此strand
+ * 
+ * @return asio::io_service::strand& 正在执行的分片strand,不在分片上时为全局的strand
+ */
+asio::io_service::strand& CChatServer::CurrentStrand()
+{
+	for (auto& pShard : m_userShardVec)
 	{
-		KeepAliveRspMsg rspMsg;
-		if (rspMsg.FromString(pMsg->to_string()))
+		if (pShard->m_strand.running_in_this_thread())
 		{
-			HandleUserKeepAliveRsp(pSess, rspMsg);
+			return pShard->m_strand;
 		}
 	}
-	break;
-	case E_MsgType::UserLoginReq_Type:
-	{
-		UserLoginReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleUserLoginReq(pSess, msg);
-		}
-		else {
+	return m_strand;
+}
 
-		}
-	}break;
-	case E_MsgType::UserLogoutReq_Type: {
-		UserLogoutReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleUserLogoutReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::UserRegisterReq_Type:
+/**
+ * @brief 文件传输的消息使用全局的文件状态,在全局的strand上处理
+ * 
+ * @param type 消息类型
+ * @return true 文件传输的消息
+ */
+static bool IsFileTransMsg(const E_MsgType type)
+{
+	switch (type)
 	{
-		UserRegisterReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleUserRegisterReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::UserUnRegisterReq_Type:
+	case E_MsgType::FriendSendFileMsgReq_Type:
+	case E_MsgType::FriendRecvFileMsgRsp_Type:
+	case E_MsgType::FriendNotifyFileMsgRsp_Type:
+	case E_MsgType::FileSendDataBeginReq_Type:
+	case E_MsgType::FileSendDataBeginRsp_Type:
+	case E_MsgType::FileSendDataReq_Type:
+	case E_MsgType::FileRecvDataRsp_Type:
+	case E_MsgType::FileVerifyReq_Type:
+	case E_MsgType::FileVerifyRsp_Type:
+	case E_MsgType::FileDownLoadReq_Type:
 	{
-		UserUnRegisterReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleUserUnRegisterReq(pSess, msg);
-		}
+		return true;
 	}break;
-	case E_MsgType::FriendChatSendTxtMsgReq_Type:
+	default:
 	{
-		FriendChatSendTxtReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleFriendChatSendTxtReq(pSess, msg);
-		}
+		return false;
 	}break;
+	}
+}
 
-	case E_MsgType::FriendChatReceiveTxtMsgRsp_Type:
-	{
-		FriendChatRecvTxtRspMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleFriendChatRecvMsgRsp(pSess, msg);
-		}
-	}break;
-	case E_MsgType::GetFriendListReq_Type:
+/**
+ * @brief 处理TCP消息的strand,文件传输的消息在全局的strand上,其他消息在会话用户所在分片的strand上
+ * 
+ * @param pSess 用户会话
+ * @param type 消息类型
+ * @return asio::io_service::strand& 处理消息的strand
+ */
+asio::io_service::strand& CChatServer::RecvMsgStrand(const std::shared_ptr<CServerSess>& pSess, const E_MsgType type)
+{
+	if (IsFileTransMsg(type) || m_userShardVec.empty())
 	{
-		GetFriendListReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleGetFriendListReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::FindFriendReq_Type:
+		return m_strand;
+	}
+	return UserShard(pSess->UserId()).m_strand;
+}
+
+/**
+ * @brief TCP消息处理,根据消息类型分发收到的TCP消息
+ * 
+ * @param pSess 用户会话
+ * @param pMsg TCP消息
+ */
+void CChatServer::DispatchRecvTcpMsg(const std::shared_ptr<CServerSess> pSess, const TransBaseMsg_t* pMsg)
+{
+	if (pMsg->GetType() != E_MsgType::FileRecvDataReq_Type && pMsg->GetType() != E_MsgType::FileSendDataReq_Type)
 	{
-		FindFriendReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleFindFriendReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::AddFriendSendReq_Type:
+		LOG_INFO(ms_loger, "[ {} ] RECV: [ {} {} ]  [ {} {} ]", pSess->UserId(), MsgType(pMsg->GetType()), CLogSampler::Payload(*pMsg), __FILENAME__, __LINE__);
+	}
+	auto& dispatcher = (IsFileTransMsg(pMsg->GetType()) || m_userShardVec.empty()) ? m_tcpDispatcher : UserShard(pSess->UserId()).m_tcpDispatcher;
+	switch (dispatcher.Dispatch(*pMsg, pSess))
 	{
-		AddFriendSendReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleAddFriendReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::AddFriendRecvRsp_Type:
+	case E_DISPATCH_RESULT::NO_HANDLER:
 	{
-		AddFriendRecvRspMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleAddFriendRecvRsp(msg);
-		}
+		LOG_ERR(ms_loger, "User:{} Unhandle E_MsgType:{} [ {} {} ]", pSess->UserId(), MsgType(pMsg->GetType()), __FILENAME__, __LINE__);
 	}break;
-	case E_MsgType::AddFriendNotifyRsp_Type:
+	case E_DISPATCH_RESULT::DECODE_FAILED:
 	{
-		AddFriendNotifyRspMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleAddFriendNotifyRsp(msg);
-		}
+		LOG_WARN(ms_loger, "User:{} Decode Failed E_MsgType:{} [ {} {} ]", pSess->UserId(), MsgType(pMsg->GetType()), __FILENAME__, __LINE__);
 	}break;
-	case E_MsgType::RemoveFriendReq_Type:
+	default:
 	{
-		RemoveFriendReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleRemoveFriendReq(pSess, msg);
-		}
 	}break;
-	case E_MsgType::AddTeamReq_Type:
-	{
-		AddTeamReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleAddTeamReq(pSess, msg);
+	}
+}
+
+/**
+ * @brief 输出上一个周期内每种TCP消息的处理次数和耗时分布,输出以后清零
+ * 
+ * 每个分片在自己的strand上取出统计,回到全局的strand上合并,所有分片合并以后输出
+ */
+void CChatServer::ReportDispatchStat()
+{
+	using DispatchStatMap = std::map<E_MsgType, MsgDispatchStat_st>;
+	auto pStatMap = std::make_shared<DispatchStatMap>();
+	m_tcpDispatcher.VisitStat([pStatMap](const E_MsgType type, const MsgDispatchStat_st& stat) {
+		(*pStatMap)[type].Merge(stat);
+	}, true);
+	auto reportStat = [this](const DispatchStatMap& statMap) {
+		for (const auto& item : statMap)
+		{
+			LOG_INFO(ms_loger, "Dispatch {} {} [{} {}]", MsgType(item.first), item.second.ToString(), __FILENAME__, __LINE__);
 		}
-	}break;
-	case E_MsgType::RemoveTeamReq_Type:
+	};
+	if (m_userShardVec.empty())
 	{
-		RemoveTeamReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleRemoveTeamReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::MoveFriendToTeamReq_Type: {
-		MoveFriendToTeamReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleMoveFriendToTeamReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::CreateGroupReq_Type:
+		reportStat(*pStatMap);
+		return;
+	}
+	auto pRemain = std::make_shared<std::size_t>(m_userShardVec.size());
+	auto pSelf = shared_from_this();
+	for (auto& pShard : m_userShardVec)
+	{
+		UserShard_st* pUserShard = pShard.get();
+		pShard->m_strand.post([this, pSelf, pUserShard, pStatMap, pRemain, reportStat]() {
+			auto pShardStat = std::make_shared<DispatchStatMap>();
+			pUserShard->m_tcpDispatcher.VisitStat([pShardStat](const E_MsgType type, const MsgDispatchStat_st& stat) {
+				(*pShardStat)[type] = stat;
+			}, true);
+			m_strand.post([pSelf, pShardStat, pStatMap, pRemain, reportStat]() {
+				for (const auto& item : *pShardStat)
+				{
+					(*pStatMap)[item.first].Merge(item.second);
+				}
+				if (0 == --(*pRemain))
+				{
+					reportStat(*pStatMap);
+				}
+			});
+		});
+	}
+}
+
+/**
+ * @brief 启动数据库连接池,每个工作线程使用自己的连接
+ * 
+ */
+void CChatServer::StartDbExecutor()
+{
+	if (0 == m_dbExecutorCfg.m_nWorkerCount)
 	{
-		CreateGroupReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleCreateGroupReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::DestroyGroupReq_Type:
+		LOG_INFO(ms_loger, "Db Executor Disabled [{} {}]", __FILENAME__, __LINE__);
+		return;
+	}
+	MySqlCfg dbCfg = m_dbCfg;
+	int nTimeout = m_dbExecutorCfg.m_nQueryTimeout;
+	bool bStart = m_dbExecutor.Start(m_dbExecutorCfg, [dbCfg, nTimeout]() {
+		auto pConn = std::make_shared<CMySqlConnect>();
+		pConn->SetTimeout(nTimeout);
+		//连接失败时不影响启动,工作线程使用前会检查并重连
+		pConn->ConnectToServer(dbCfg.m_strUserName,
+			dbCfg.m_strPassword,
+			dbCfg.m_strDbName,
+			dbCfg.m_strDbIp,
+			dbCfg.m_nDbPort,
+			false);
+		return pConn;
+	}, [](CMySqlConnect& conn) {
+		return conn.Ping();
+	}, []() {
+		mysql_thread_init();
+	}, []() {
+		mysql_thread_end();
+	});
+	LOG_INFO(ms_loger, "Db Executor Start:{} Workers:{} [{} {}]", bStart, m_dbExecutor.WorkerCount(), __FILENAME__, __LINE__);
+}
+
+/**
+ * @brief 输出上一个周期内数据库连接池的统计,输出以后清零
+ * 
+ */
+void CChatServer::ReportDbStat()
+{
+	if (!m_dbExecutor.IsRunning())
 	{
-		DestroyGroupReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleDestroyGroupReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::FindGroupReq_Type:
+		return;
+	}
+	auto stat = m_dbExecutor.Stat(true);
+	if (stat.m_nSlowCount > 0 || stat.m_nPingFailed > 0 || stat.m_nErrorCount > 0)
 	{
-		FindGroupReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleFindGroupReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::GetGroupListReq_Type:
+		LOG_WARN(ms_loger, "Db Executor {} [{} {}]", stat.ToString(), __FILENAME__, __LINE__);
+	}
+	else
 	{
-		GetGroupListReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleGetGroupListReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::SendGroupTextMsgReq_Type:
+		LOG_INFO(ms_loger, "Db Executor {} [{} {}]", stat.ToString(), __FILENAME__, __LINE__);
+	}
+}
+
+/**
+ * @brief 启动文件读写线程池,在业务strand上调用
+ * 
+ */
+void CChatServer::StartFileIoEngine()
+{
+	bool bStart = m_fileIo.Start(m_fileIoCfg);
+	LOG_INFO(ms_loger, "File Io Engine Start:{} Workers:{} [{} {}]", bStart, m_fileIo.WorkerCount(), __FILENAME__, __LINE__);
+}
+
+/**
+ * @brief 输出上一个周期内文件读写的统计,输出以后清零
+ * 
+ */
+void CChatServer::ReportFileIoStat()
+{
+	auto stat = m_fileIo.Stat(true);
+	if (0 == stat.m_nPostCount && 0 == stat.m_nOpenCount)
 	{
-		SendGroupTextMsgReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleSendGroupTextReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::AddToGroupReq_Type: {
-		AddToGroupReqMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleAddToGroupReq(pSess, msg);
-		}
-	}break;
-	case E_MsgType::FileRecvDataRsp_Type:
+		return;
+	}
+	if (stat.m_nSlowCount > 0 || stat.m_nFailCount > 0)
 	{
-		FileDataRecvRspMsg rspMsg;
-		if (rspMsg.FromString(pMsg->to_string())){
-			HandleFileDataRecvRsp(pSess, rspMsg);
-		}
-	}break;
-	case E_MsgType::QuitGroupReq_Type:
+		LOG_WARN(ms_loger, "File Io {} [{} {}]", stat.ToString(), __FILENAME__, __LINE__);
+	}
+	else
 	{
-		QuitFromGroupReqMsg reqMsg;
-		if (reqMsg.FromString(pMsg->to_string())) {
-			HandleQuitGroupReqMsg(pSess, reqMsg);
-		}
-	}break;
-	case E_MsgType::RecvGroupTextMsgRsp_Type:
+		LOG_INFO(ms_loger, "File Io {} [{} {}]", stat.ToString(), __FILENAME__, __LINE__);
+	}
+}
+
+/**
+ * @brief 在连接池上执行不需要结果的数据库操作,连接池没有启动时直接使用m_util执行
+ * 
+ * @param strKey key相同的操作按顺序执行
+ * @param task 数据库操作
+ */
+void CChatServer::PostDbTask(const std::string& strKey, std::function<void(CMySqlConnect&)> task)
+{
+	if (!m_dbExecutor.Post(strKey, task))
 	{
-		RecvGroupTextMsgRspMsg msg;
-		if (msg.FromString(pMsg->to_string())) {
-			HandleRecvGroupTextMsgRspMsg(pSess, msg);
-		}
-	}break;
-	case E_MsgType::FriendSendFileMsgReq_Type:
+		std::lock_guard<std::mutex> lock(m_utilMutex);
+		task(m_util);
+	}
+}
+
+/**
+ * @brief 记录用户的在线状态,定时批量写入数据库
+ * 
+ * 好友列表中的在线状态从m_presence中读取,数据库中的状态只供其他程序查询,晚一个定时周期写入没有影响。
+ * 积累的状态在全局的strand上保存,在分片的strand上调用时投递过去
+ * 
+ * @param strUserId 用户ID
+ * @param state 在线状态
+ */
+void CChatServer::SaveUserOnlineState(const std::string& strUserId, const CLIENT_STATE state)
+{
+	if (!m_bSaveOnlineState || strUserId.empty())
 	{
-		FriendSendFileMsgReqMsg reqMsg;
-		if (reqMsg.FromString(pMsg->to_string())) {
-			HandleFriendSendFileReq(pSess, reqMsg);
-		}
-	}break;
-	case E_MsgType::FriendRecvFileMsgRsp_Type:
+		return;
+	}
+	if (!m_strand.running_in_this_thread())
 	{
-		FriendRecvFileMsgRspMsg reqMsg;
-		if (reqMsg.FromString(pMsg->to_string())) {
-			HandleFriendRecvFileRsp(reqMsg);
-		}
-	}break;
-	case E_MsgType::FriendNotifyFileMsgRsp_Type:
+		auto pSelf = shared_from_this();
+		m_strand.post([this, pSelf, strUserId, state]() {
+			SaveUserOnlineState(strUserId, state);
+		});
+		return;
+	}
+	m_onlineStateMap[strUserId] = state;
+	if (m_onlineStateMap.size() >= ONLINE_STATE_FLUSH_SIZE)
 	{
-		FriendNotifyFileMsgRspMsg rspMsg;
-		if (rspMsg.FromString(pMsg->to_string())) {
-			HandleFriendNotifyFileRsp(pSess, rspMsg);
-		}
-	}break;
-	case E_MsgType::FileVerifyReq_Type:
+		FlushUserOnlineState();
+	}
+}
+
+/**
+ * @brief 把积累的在线状态按状态分组,每组一条语句写入数据库
+ * 
+ */
+void CChatServer::FlushUserOnlineState()
+{
+	if (m_onlineStateMap.empty())
 	{
-		FileVerifyReqMsg reqMsg;
-		if (reqMsg.FromString(pMsg->to_string())) {
-			HandleFileVerifyReq(pSess, reqMsg);
-		}
-	}break;
-	case E_MsgType::FileVerifyRsp_Type:
+		return;
+	}
+	std::map<CLIENT_STATE, std::vector<std::string>> stateUserMap;
+	for (const auto& item : m_onlineStateMap)
 	{
-		FileVerifyRspMsg rspMsg;
-		if (rspMsg.FromString(pMsg->to_string())) {
-			HandleFileVerifyRsp(rspMsg);
-		}
-	}break;
-	case E_MsgType::UserKickOffRsp_Type:
+		stateUserMap[item.second].push_back(item.first);
+	}
+	m_onlineStateMap.clear();
+	for (auto& item : stateUserMap)
 	{
-		UserKickOffRspMsg rspMsg;
-		if (rspMsg.FromString(pMsg->to_string())) {
-			HandleUserKickOffRsp(rspMsg);
-		}
-	}break;
-	case E_MsgType::FriendUnReadMsgNotifyRsp_Type:
+		CLIENT_STATE state = item.first;
+		auto userIdVec = std::move(item.second);
+		PostDbTask("OnlineState", [state, userIdVec](CMySqlConnect& util) {
+			if (!util.UpdateUserOnlineState(userIdVec, state))
+			{
+				LOG_WARN(ms_loger, "Update {} Users Online State Failed [{} {}]", userIdVec.size(), __FILENAME__, __LINE__);
+			}
+		});
+	}
+}
+
+/**
+ * @brief 打开归档目录,并立即检查一次分区
+ * 
+ */
+void CChatServer::StartChatArchive()
+{
+	if (m_strArchiveDir.empty())
 	{
-		FriendUnReadNotifyRspMsg rspMsg;
-		if (rspMsg.FromString(pMsg->to_string())) {
-			HandleFriendUnReadNotifyRspMsg(pSess, rspMsg);
-		}
-	}break;
-	case E_MsgType::UpdateFriendListNotifyRsp_Type:
+		LOG_INFO(ms_loger, "Chat Archive Disabled [{} {}]", __FILENAME__, __LINE__);
+		return;
+	}
+	if (!m_chatArchive.Open(m_strArchiveDir))
 	{
-		UpdateFriendListNotifyRspMsg rspMsg;
-		if (rspMsg.FromString(pMsg->to_string())) {
-			HandleUpdateFriendListRsp(rspMsg);
-		}
-	}break;
-	case E_MsgType::UpdateGroupListNotifyRsp_Type:
+		LOG_WARN(ms_loger, "Chat Archive Open {} Failed [{} {}]", m_strArchiveDir, __FILENAME__, __LINE__);
+		return;
+	}
+	for (const auto& item : m_chatArchive.Files())
 	{
-		UpdateGroupListNotifyRspMsg rspMsg;
-		if (rspMsg.FromString(pMsg->to_string())) {
-			HandleUpdateGroupListRsp(rspMsg);
-		}
-	}break;
-	case E_MsgType::QueryUserUdpAddrReq_Type:
+		LOG_INFO(ms_loger, "Chat Archive File:{} Rows:{} Msg Id:{}..{} [{} {}]", item.m_strPath, item.m_nRows, item.m_nMinMsgId, item.m_nMaxMsgId, __FILENAME__, __LINE__);
+	}
+	m_archiveCheckTime = std::chrono::steady_clock::now() - std::chrono::seconds(m_nArchiveIntervalSec);
+	MaintainChatArchive();
+}
+
+/**
+ * @brief 每隔m_nArchiveIntervalSec检查一次,提前创建分区,导出并删除冷分区
+ * 
+ * 同一时间只有一个检查在连接池上执行,导出大分区时不影响业务strand
+ */
+void CChatServer::MaintainChatArchive()
+{
+	if (!m_chatArchive.IsOpen() || m_bArchiveRunning ||
+		std::chrono::steady_clock::now() - m_archiveCheckTime < std::chrono::seconds(m_nArchiveIntervalSec))
 	{
-		QueryUserUdpAddrReqMsg reqMsg;
-		if (reqMsg.FromString(pMsg->to_string())) {
-			HandleQueryUserUdpAddr(pSess, reqMsg);
+		return;
+	}
+	m_bArchiveRunning = true;
+	m_archiveCheckTime = std::chrono::steady_clock::now();
+	int nHotMonths = m_nArchiveHotMonths;
+	int nAheadMonths = m_nArchiveAheadMonths;
+	auto pArchive = &m_chatArchive;
+	PostDbQuery("ChatArchive", [pArchive, nHotMonths, nAheadMonths](CMySqlConnect& util) {
+		//离线恢复或者删除的文件在下次检查时生效
+		pArchive->Reload();
+		return pArchive->Maintain(util, nHotMonths, nAheadMonths);
+	}, [this](const bool bResult) {
+		m_bArchiveRunning = false;
+		if (!bResult)
+		{
+			LOG_WARN(ms_loger, "Chat Archive Maintain Failed, Retry In {}s [{} {}]", m_nArchiveIntervalSec, __FILENAME__, __LINE__);
 		}
+	});
+}
 
-	}break;
-	case E_MsgType::FileSendDataBeginReq_Type:
+/**
+ * @brief 读取群组中strLastMsgId之后的消息,归档中没有更新的消息时查询数据库
+ * 
+ * 归档的分区都早于数据库中的分区,归档中有消息时先下发归档中的消息;
+ * 读取归档文件和数据库都会阻塞,只在连接池的线程上调用
+ */
+bool CChatServer::SelectGroupChatTextList(CMySqlConnect& util, const std::string& strGroupId, const std::string& strLastMsgId, const int nLimit, std::vector<T_GROUP_CHAT_MSG>& msgVec)
+{
+	if (m_chatArchive.IsOpen() && m_chatArchive.SelectGroupChatTextList(strGroupId, strLastMsgId, static_cast<std::size_t>(nLimit), msgVec))
 	{
-		FileSendDataBeginReq reqMsg;
-		if (reqMsg.FromString(pMsg->to_string())) {
-			HandleFileSendDataBeginReq(pSess, reqMsg);
-		}
-	}break;
-	case E_MsgType::FileSendDataBeginRsp_Type:
+		return true;
+	}
+	return util.SelectGroupChatTextList(strGroupId, strLastMsgId, nLimit, msgVec);
+}
+
+/**
+ * @brief 打开聊天消息的本地日志,上次没有入库的消息排在最前面入库
+ * 
+ */
+void CChatServer::StartChatMsgJournal()
+{
+	if (m_strJournalDir.empty())
 	{
-		FileSendDataBeginRsp rspMsg;
-		if (rspMsg.FromString(pMsg->to_string())) {
-			HandleFileSendDataBeginRsp(pSess, rspMsg);
-		}
-	}break;
-	case E_MsgType::FileSendDataReq_Type:
+		LOG_INFO(ms_loger, "Chat Msg Journal Disabled [{} {}]", __FILENAME__, __LINE__);
+		return;
+	}
+	std::vector<ChatMsgJournalBatch_st> replayVec;
+	bool bOpen = false;
+	{
+		std::lock_guard<std::mutex> lock(m_journalMutex);
+		m_chatMsgJournal.SetSync(m_bJournalSync);
+		bOpen = m_chatMsgJournal.Open(m_strJournalDir, replayVec);
+	}
+	if (!bOpen)
+	{
+		LOG_WARN(ms_loger, "Chat Msg Journal Open {} Failed, Save Chat Msg Directly [{} {}]", m_strJournalDir, __FILENAME__, __LINE__);
+	}
+	for (auto& batch : replayVec)
+	{
+		LOG_INFO(ms_loger, "Chat Msg Journal Replay Segment:{} Friend:{} Group:{} [{} {}]", batch.m_nSegment, batch.m_friendMsgVec.size(), batch.m_groupMsgVec.size(), __FILENAME__, __LINE__);
+		m_journalBatchQueue.push_back(std::make_shared<ChatMsgJournalBatch_st>(std::move(batch)));
+	}
+	FlushJournal();
+}
+
+/**
+ * @brief 当前日志文件中还没有入库的消息条数
+ * 
+ * @return std::size_t 消息条数
+ */
+std::size_t CChatServer::JournalPendingCount()
+{
+	std::lock_guard<std::mutex> lock(m_journalMutex);
+	return m_chatMsgJournal.PendingCount();
+}
+
+/**
+ * @brief 消息写入日志以后调用,积累的消息足够多时立即入库,否则等待定时器
+ * 
+ * 入库的状态在全局的strand上,在分片的strand上调用时投递过去
+ */
+void CChatServer::ScheduleJournalFlush()
+{
+	if (!m_strand.running_in_this_thread())
+	{
+		auto pSelf = shared_from_this();
+		m_strand.post([this, pSelf]() {
+			ScheduleJournalFlush();
+		});
+		return;
+	}
+	if (JournalPendingCount() >= m_nJournalFlushRows)
+	{
+		FlushJournal();
+	}
+	else
+	{
+		SetJournalTimer(m_nJournalFlushMs);
+	}
+}
+
+/**
+ * @brief 设置日志入库的定时器,已经在运行时不重新设置
+ * 
+ * @param nMilliSeconds 定时的毫秒数
+ */
+void CChatServer::SetJournalTimer(const int nMilliSeconds)
+{
+	if (m_bJournalTimerRun || !m_journalTimer)
 	{
-		FileDataSendReqMsg reqMsg;
-		if (reqMsg.FromString(pMsg->to_string())) {
-			HandleFileDataSendReq(pSess, reqMsg);
+		return;
+	}
+	m_bJournalTimerRun = true;
+	m_journalTimer->expires_from_now(std::chrono::milliseconds(nMilliSeconds));
+	auto self = shared_from_this();
+	m_journalTimer->async_wait(m_strand.wrap([this, self](const std::error_code& ec) {
+		m_bJournalTimerRun = false;
+		if (!ec)
+		{
+			this->FlushJournal();
 		}
-	}break;
-	case E_MsgType::FileDownLoadReq_Type:
+	}));
+}
+
+/**
+ * @brief 把一个日志文件中的消息在一个事务中入库
+ * 
+ * 同一时间只有一批消息在入库,入库期间到达的消息写入新的日志文件,下一次一起入库
+ */
+void CChatServer::FlushJournal()
+{
+	if (m_bJournalFlushing)
+	{
+		return;
+	}
+	if (m_journalBatchQueue.empty())
 	{
-		FileDownLoadReqMsg reqMsg;
-		if (reqMsg.FromString(pMsg->to_string())) {
-			HandleFileDownLoadReq(pSess, reqMsg);
+		auto pBatch = std::make_shared<ChatMsgJournalBatch_st>();
+		std::lock_guard<std::mutex> lock(m_journalMutex);
+		if (!m_chatMsgJournal.Seal(*pBatch))
+		{
+			return;
 		}
-	}break;
-	case E_MsgType::GetRandomUserReq_Type:
+		m_journalBatchQueue.push_back(pBatch);
+	}
+	m_bJournalFlushing = true;
+	auto pBatch = m_journalBatchQueue.front();
+	auto pSelf = shared_from_this();
+	PostDbQuery("ChatMsgJournal", [this, pBatch](CMySqlConnect& util) {
+		return DoSaveChatMsgBatch(util, *pBatch);
+	}, [this, pSelf](const bool bSaved) {
+		OnJournalBatchSaved(bSaved);
+	});
+}
+
+/**
+ * @brief 一批消息入库完成,成功时删除日志文件并通知接收者,失败时稍后重试
+ * 
+ * @param bSaved 是否入库成功
+ */
+void CChatServer::OnJournalBatchSaved(const bool bSaved)
+{
+	m_bJournalFlushing = false;
+	if (m_journalBatchQueue.empty())
+	{
+		return;
+	}
+	auto pBatch = m_journalBatchQueue.front();
+	if (!bSaved)
+	{
+		//可能已经提交但是没有收到结果,重试时跳过已经入库的消息
+		pBatch->m_bReplay = true;
+		LOG_WARN(ms_loger, "Chat Msg Journal Segment:{} Save Failed, Retry Later [{} {}]", pBatch->m_nSegment, __FILENAME__, __LINE__);
+		SetJournalTimer(1000);
+		return;
+	}
+	m_journalBatchQueue.pop_front();
+	{
+		std::lock_guard<std::mutex> lock(m_journalMutex);
+		m_chatMsgJournal.Remove(pBatch->m_nSegment);
+	}
+	OnChatMsgBatchSaved(*pBatch);
+	std::size_t nPending = JournalPendingCount();
+	if (!m_journalBatchQueue.empty() || nPending >= m_nJournalFlushRows)
+	{
+		FlushJournal();
+	}
+	else if (nPending > 0)
+	{
+		SetJournalTimer(m_nJournalFlushMs);
+	}
+}
+
+/**
+ * @brief 消息入库以后通知接收者,接收者从数据库读取未读消息
+ * 
+ * 接收者的检查投递到各自分片的strand上,群成员按分片分批通知
+ * @param batch 入库的消息
+ */
+void CChatServer::OnChatMsgBatchSaved(const ChatMsgJournalBatch_st& batch)
+{
+	std::set<std::string> receiverSet;
+	for (const auto& chatMsg : batch.m_friendMsgVec)
+	{
+		receiverSet.insert(chatMsg.m_strF_TO_ID);
+	}
+	for (const auto& strReceiver : receiverSet)
+	{
+		OnUserStateCheck(strReceiver);
+	}
+
+	//同一个群的消息只查询一次群成员
+	std::set<std::string> groupSet;
 	{
-		GetRandomUserReqMsg reqMsg;
-		if (reqMsg.FromString(pMsg->to_string())) {
-			HandleGetRandomUserReq(pSess, reqMsg);
+		std::lock_guard<std::mutex> lock(m_groupMsgCacheMutex);
+		for (const auto& chatMsg : batch.m_groupMsgVec)
+		{
+			m_groupMsgCache.Append(chatMsg);
+			groupSet.insert(chatMsg.m_strF_GROUP_ID);
 		}
-	}break;
-	case E_MsgType::NotifyGroupMsgRsp_Type:
+	}
+	auto pSelf = shared_from_this();
+	for (const auto& strGroupId : groupSet)
+	{
+		PostDbQuery(strGroupId, [strGroupId](CMySqlConnect& util) {
+			std::vector<T_GROUP_RELATION_BEAN> groupUsers;
+			util.SelectGroupRelation(strGroupId, groupUsers);
+			return groupUsers;
+		}, [this, pSelf, strGroupId](const std::vector<T_GROUP_RELATION_BEAN>& groupUsers) {
+			OnDispatchGroupMsg(strGroupId, groupUsers);
+		});
+	}
+}
+
+/**
+ * @brief 在一个事务中保存一批好友消息和群聊消息
+ * 
+ * @param util 执行操作的数据库连接
+ * @param batch 需要保存的消息,恢复或重试的批次先跳过已经入库的消息
+ * @return true 全部保存成功
+ * @return false 保存失败,事务已经回滚
+ */
+bool CChatServer::DoSaveChatMsgBatch(CMySqlConnect& util, const ChatMsgJournalBatch_st& batch)
+{
+	std::vector<T_USER_CHAT_MSG> friendMsgVec;
+	std::vector<T_GROUP_CHAT_MSG> groupMsgVec;
+	if (batch.m_bReplay)
 	{
-		NotifyGroupMsgRspMsg rspMsg;
-		if (rspMsg.FromString(pMsg->to_string())) {
-			HandleNotifyGroupMsgRsp(pSess, rspMsg);
+		for (const auto& chatMsg : batch.m_friendMsgVec)
+		{
+			if (!util.IsFriendChatMsgExist(chatMsg.m_strF_MSG_ID))
+			{
+				friendMsgVec.push_back(chatMsg);
+			}
 		}
-	}break;
-	default:
+		for (const auto& chatMsg : batch.m_groupMsgVec)
+		{
+			if (!util.IsGroupChatTextExist(chatMsg.m_strF_MSG_ID))
+			{
+				groupMsgVec.push_back(chatMsg);
+			}
+		}
+	}
+	const auto& saveFriendVec = batch.m_bReplay ? friendMsgVec : batch.m_friendMsgVec;
+	const auto& saveGroupVec = batch.m_bReplay ? groupMsgVec : batch.m_groupMsgVec;
+	if (saveFriendVec.empty() && saveGroupVec.empty())
 	{
-		LOG_ERR(ms_loger, "User:{} Unhandle E_MsgType:{} [ {} {} ]", pSess->UserId(), MsgType(pMsg->GetType()), __FILENAME__, __LINE__);
-	}break;
+		return true;
+	}
+	if (!util.BeginTransaction())
+	{
+		return false;
 	}
+	if (util.InsertFriendChatMsg(saveFriendVec) && util.InsertGroupChatText(saveGroupVec) && util.Commit())
+	{
+		return true;
+	}
+	util.Rollback();
+	return false;
 }
+
 /**
  * @brief 处理接收的UDP消息
  * 在此函数完成UDP消息的分发
@@ -542,34 +1150,34 @@ void CChatServer::DispatchRecvUdpMsg(const asio::ip::udp::endpoint sendPt, const
 		case E_MsgType::KeepAliveReq_Type:
 		{
 			KeepAliveReqMsg reqMsg;
-			if (reqMsg.FromString(pMsg->to_string())) {
+			if (pMsg->DecodeMsg(reqMsg)) {
 				Handle_RecvUdpMsg(sendPt, reqMsg);
 			}
 		}break;
 		case E_MsgType::FileSendDataReq_Type:
 		{
 			FileDataSendReqMsg reqMsg;
-			if (reqMsg.FromString(pMsg->to_string())) {
+			if (pMsg->DecodeMsg(reqMsg)) {
 				Handle_UdpFileDataSendReqMsg(sendPt,reqMsg);
 			}
 		}break;
 		case E_MsgType::FileRecvDataRsp_Type:
 		{
 			FileDataRecvRspMsg rspMsg;
-			if (rspMsg.FromString(pMsg->to_string())) {
+			if (pMsg->DecodeMsg(rspMsg)) {
 				Handle_RecvUdpMsg(sendPt, rspMsg);
 			}
 		}break;
 		case E_MsgType::UdpP2PStartReq_Type:
 		{
 			UdpP2pStartReqMsg reqMsg;
-			if (reqMsg.FromString(pMsg->to_string())) {
+			if (pMsg->DecodeMsg(reqMsg)) {
 				Handle_RecvUdpMsg(sendPt, reqMsg);
 			}
 		}break;
 		default:
 		{
-			LOG_ERR(ms_loger, "UnHandle Udp Msg {} {} [{} {}]", MsgType(pMsg->GetType()), pMsg->to_string(), __FILENAME__, __LINE__);
+			LOG_ERR(ms_loger, "UnHandle Udp Msg {} {} [{} {}]", MsgType(pMsg->GetType()), pMsg->ToPrintString(), __FILENAME__, __LINE__);
 		}break;
 		}
 	}
@@ -588,34 +1196,19 @@ void CChatServer::Handle_RecvUdpMsg(const asio::ip::udp::endpoint sendPt, const
 	rspMsg.m_strUserId = pMsg.m_strUserId;
 	rspMsg.m_strMsgId = pMsg.m_strMsgId;
 	m_udpServer->sendMsg(sendPt, &rspMsg);
-	auto item = m_UserSessVec.find(pMsg.m_strUserId);
-	if (item != m_UserSessVec.end())
-	{
-		auto udpItem = m_userIdUdpAddrMap.find(pMsg.m_strUserId);
-		if (udpItem != m_userIdUdpAddrMap.end())
-		{
-			IpPortCfg udpIp;
-			udpIp.m_strServerIp = sendPt.address().to_string();
-			udpIp.m_nPort = sendPt.port();
-			if (udpItem->second.m_strServerIp == udpIp.m_strServerIp &&
-				udpItem->second.m_nPort == udpIp.m_nPort)
-			{
-
-			}
-			else
-			{
-				m_userIdUdpAddrMap.erase(pMsg.m_strUserId);
-				m_userIdUdpAddrMap.insert({ pMsg.m_strUserId,udpIp });
-			}
-		}
-		else
+	//用户的在线记录只在用户所在分片的strand上修改
+	IpPortCfg udpAddr;
+	udpAddr.m_strServerIp = sendPt.address().to_string();
+	udpAddr.m_nPort = sendPt.port();
+	std::string strUserId = pMsg.m_strUserId;
+	auto pSelf = shared_from_this();
+	DispatchToUser(strUserId, [this, pSelf, strUserId, udpAddr]() {
+		UserPresence_st* pUser = m_presence.Find(strUserId);
+		if (nullptr != pUser && pUser->m_pSess)
 		{
-			IpPortCfg udpIp;
-			udpIp.m_strServerIp = sendPt.address().to_string();
-			udpIp.m_nPort = sendPt.port();
-			m_userIdUdpAddrMap.insert({ pMsg.m_strUserId,udpIp });
+			m_presence.SetUdpAddr(*pUser, true, udpAddr);
 		}
-	}
+	});
 }
 
 /**
@@ -681,66 +1274,207 @@ FriendChatMsg_s DbBeanToMsgBean(const T_USER_CHAT_MSG& msgBean)
  * @return false 接收失败
  */
 bool CChatServer::OnUserReceiveMsg(const std::string strUserId) {
-	T_USER_CHAT_MSG msgBean;
-	if(CLIENT_SESS_STATE::SESS_RECV_MSG_FINISHED == m_clientStateMap[strUserId])
+	UserPresence_st* pUser = m_presence.Find(strUserId);
+	if (nullptr == pUser || CLIENT_SESS_STATE::SESS_RECV_MSG_FINISHED != pUser->m_eState)
 	{
-		if (m_util.SelectUnReadFriendChatMsg(strUserId, msgBean))
-		{
-			if (CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE == msgBean.m_eChatMsgType)
-			{
-				FriendChatRecvTxtReqMsg reqMsg;
-				reqMsg.m_strMsgId = CreateMsgId();
-				reqMsg.m_chatMsg = DbBeanToMsgBean(msgBean);
-				{
-					auto item = m_UserSessVec.find(strUserId);
-					if (item != m_UserSessVec.end() && item->second->IsConnected())
-					{
-						item->second->SendMsg(&reqMsg);
-					}
-				}
-				m_clientStateMap[strUserId] = CLIENT_SESS_STATE::SESS_WAIT_RECV_MSG_RSP;
-			}
-			return true;
-		}
-		else {
-			m_clientStateMap[strUserId] = CLIENT_SESS_STATE::SESS_IDLE_STATE;
-			return false;
-		}
+		return false;
 	}
-	else
+	pUser->m_eState = CLIENT_SESS_STATE::SESS_WAIT_RECV_MSG_RSP;
+	auto& drainMap = UserShard(strUserId).m_friendMsgDrainMap;
+	if (drainMap.find(strUserId) == drainMap.end())
+	{
+		drainMap.insert({ strUserId, FriendMsgDrain_st(m_nUnReadMsgWindow) });
+	}
+	return DrainFriendMsg(strUserId);
+}
+
+/**
+ * @brief 按窗口下发离线好友消息
+ * 
+ * 窗口没有满时继续下发,确认攒够一批以后一次更新为已读,本页的消息全部更新以后在连接池上读取下一页,
+ * 没有未读消息时结束
+ * 
+ * @param strUserId 接收消息的用户ID
+ * @return true 还在下发
+ * @return false 下发结束
+ */
+bool CChatServer::DrainFriendMsg(const std::string strUserId)
+{
+	auto& drainMap = UserShard(strUserId).m_friendMsgDrainMap;
+	auto drainItem = drainMap.find(strUserId);
+	if (drainItem == drainMap.end())
 	{
 		return false;
 	}
+	auto sessItem = m_presence.GetSess(strUserId);
+	if (!sessItem || !sessItem->IsConnected())
+	{
+		drainMap.erase(drainItem);
+		SetUserState(strUserId, CLIENT_SESS_STATE::SESS_IDLE_STATE);
+		return false;
+	}
+	FriendMsgDrain_st& drain = drainItem->second;
+	while (drain.m_window.CanSend() && !drain.m_msgQueue.empty())
+	{
+		FriendChatRecvTxtReqMsg reqMsg;
+		reqMsg.m_strMsgId = CreateMsgId();
+		reqMsg.m_chatMsg = DbBeanToMsgBean(drain.m_msgQueue.front());
+		sessItem->SendMsg(&reqMsg);
+		drain.m_window.OnSend(drain.m_msgQueue.front().m_strF_MSG_ID);
+		drain.m_msgQueue.pop_front();
+	}
+	if (drain.m_bFlushing || drain.m_bLoading)
+	{
+		return true;
+	}
+	if (drain.m_window.NeedFlush())
+	{
+		FlushFriendMsgAck(strUserId, drain);
+		return true;
+	}
+	if (!drain.m_window.IsIdle() || !drain.m_msgQueue.empty())
+	{
+		return true;
+	}
+	LoadFriendMsgPage(strUserId, drain);
+	return true;
 }
 
+/**
+ * @brief 在连接池上读取下一页未读消息,读取完成以后继续下发,没有未读消息时结束
+ * 
+ * @param strUserId 接收消息的用户ID
+ * @param drain 用户的下发状态
+ */
+void CChatServer::LoadFriendMsgPage(const std::string strUserId, FriendMsgDrain_st& drain)
+{
+	drain.m_bLoading = true;
+	int nPageSize = m_nUnReadMsgPageSize;
+	auto pSelf = shared_from_this();
+	//和更新已读状态使用同一个key,读到的不会包含刚确认的消息
+	PostDbQuery(strUserId, [strUserId, nPageSize](CMySqlConnect& util) {
+		std::vector<T_USER_CHAT_MSG> msgVec;
+		if (!util.SelectUnReadFriendChatMsg(strUserId, nPageSize, msgVec))
+		{
+			msgVec.clear();
+		}
+		return msgVec;
+	}, [this, pSelf, strUserId](const std::vector<T_USER_CHAT_MSG>& msgVec) {
+		auto& drainMap = UserShard(strUserId).m_friendMsgDrainMap;
+		auto item = drainMap.find(strUserId);
+		if (item == drainMap.end() || !item->second.m_bLoading)
+		{
+			return;
+		}
+		item->second.m_bLoading = false;
+		if (msgVec.empty())
+		{
+			drainMap.erase(item);
+			SetUserState(strUserId, CLIENT_SESS_STATE::SESS_IDLE_STATE);
+			return;
+		}
+		LOG_DBG(ms_loger, "User:{} UnRead Page:{} [{} {}]", strUserId, msgVec.size(), __FILENAME__, __LINE__);
+		item->second.m_msgQueue.assign(msgVec.begin(), msgVec.end());
+		DrainFriendMsg(strUserId);
+	});
+}
+
+/**
+ * @brief 把窗口中已确认的消息一次更新为已读,更新完成以后继续下发
+ * 
+ * @param strUserId 接收消息的用户ID
+ * @param drain 用户的下发状态
+ */
+void CChatServer::FlushFriendMsgAck(const std::string strUserId, FriendMsgDrain_st& drain)
+{
+	drain.m_bFlushing = true;
+	std::vector<std::string> msgIdVec = drain.m_window.TakeAcked();
+	auto pSelf = shared_from_this();
+	PostDbQuery(strUserId, [msgIdVec](CMySqlConnect& util) {
+		return util.UpdateFriendChatMsgState(msgIdVec, "READ");
+	}, [this, pSelf, strUserId](const bool bUpdate) {
+		auto& drainMap = UserShard(strUserId).m_friendMsgDrainMap;
+		auto item = drainMap.find(strUserId);
+		if (item == drainMap.end())
+		{
+			return;
+		}
+		//更新失败的消息还是未读,读取下一页时会重新下发
+		if (!bUpdate)
+		{
+			LOG_ERR(ms_loger, "User:{} Update Msg State Failed [{} {}]", strUserId, __FILENAME__, __LINE__);
+		}
+		item->second.m_bFlushing = false;
+		DrainFriendMsg(strUserId);
+	});
+}
+
+/**
+ * @brief 清除会话的在线状态,在会话用户所在分片的strand上调用
+ * 
+ * @param pSess 断开的TCP会话
+ */
 void CChatServer::CloseSess(const std::shared_ptr<CServerSess>& pSess)
 {
 	LOG_INFO(ms_loger, "User:{} is Closed [{} {} ]", pSess->UserId(), __FILENAME__, __LINE__);
-	auto item = m_UserSessVec.find(pSess->UserId());
-	if (item != m_UserSessVec.end() &&
-		item->second == pSess)
-	{
-		m_UserSessVec.erase(pSess->UserId());
+	UserPresence_st* pUser = m_presence.Find(pSess->UserId());
+	if (nullptr != pUser && pUser->m_pSess == pSess)
+	{
+		//用户下线,会话、UDP地址和群组消息的下发状态一起清除
+		m_presence.SetSess(*pUser, nullptr);
+		pUser->m_eState = CLIENT_SESS_STATE::SESS_IDLE_STATE;
+		m_presence.SetUdpAddr(*pUser, false);
+		pUser->m_groupVec.clear();
+		UserShard(pSess->UserId()).m_friendMsgDrainMap.erase(pSess->UserId());
+		//文件传输的状态在全局的strand上
+		auto pSelf = shared_from_this();
+		std::string strUserId = pSess->UserId();
+		m_strand.post([this, pSelf, strUserId]() {
+			CloseUserFile(strUserId);
+		});
+		SaveUserOnlineState(strUserId, CLIENT_STATE::C_STATE_OFFLINE);
 	}
-	else
+	else if (nullptr != pUser && pUser->m_pKickOffSess == pSess)
 	{
-		LOG_ERR(ms_loger, "User:{} is Closed [{} {} ]", pSess->UserId(), __FILENAME__, __LINE__);
+		//被重复登录踢掉的旧会话,用户还在新的会话上在线
+		pUser->m_pKickOffSess.reset();
 	}
-	m_clientStateMap.erase(pSess->UserId());
-	m_clientStateMap.insert({ pSess->UserId(),CLIENT_SESS_STATE::SESS_IDLE_STATE });
-	m_util.UpdateUserOnlineState(pSess->UserId(), CLIENT_STATE::C_STATE_OFFLINE);
-	m_userIdUdpAddrMap.erase(pSess->UserId());
+	//未登录或者已经不是注册的会话,没有需要清除的状态
+	m_presence.Release(pSess->UserId());
 }
 
 
 /**
- * @brief 响应会话关闭
+ * @brief 将会话收到的TCP消息投递到处理它的strand上
+ * 
+ * 会话的用户ID在登录时设置,执行时不在当前应该处理的strand上则重新投递
+ * @param pSess 用户会话
+ * @param pMsg TCP消息
+ */
+void CChatServer::PostRecvTcpMsg(const std::shared_ptr<CServerSess> pSess, const TransBaseMsg_S_PTR pMsg)
+{
+	auto pSelf = shared_from_this();
+	RecvMsgStrand(pSess, pMsg->GetType()).post([this, pSelf, pSess, pMsg]() {
+		if (!RecvMsgStrand(pSess, pMsg->GetType()).running_in_this_thread())
+		{
+			PostRecvTcpMsg(pSess, pMsg);
+			return;
+		}
+		DispatchRecvTcpMsg(pSess, pMsg.get());
+	});
+}
+
+/**
+ * @brief 响应会话关闭,会话在自己的strand上调用,此处转到会话用户所在分片的strand上处理
  * 
  * @param pSess 断开的TCP会话
  */
 void CChatServer::OnSessClose(const std::shared_ptr<CServerSess>& pSess) {
-	NotifyUserFriends(pSess->UserId());
-	CloseSess(pSess);
+	auto pSelf = shared_from_this();
+	UserShard(pSess->UserId()).m_strand.post([this, pSelf, pSess]() {
+		NotifyUserFriends(pSess->UserId());
+		CloseSess(pSess);
+	});
 }
 
 /**
@@ -790,22 +1524,38 @@ void CChatServer::start(const std::function<void(const std::error_code &)> &call
 				m_serverCfg.to_string(), ec.value(), ec.message(), __FILENAME__, __LINE__);
 		}
 		SetTimer(30);
+		StartUserShards();
 		do_accept();
 		auto pSelf = shared_from_this();
 		m_udpServer = std::make_shared<CUdpServer>(m_ioService, "127.0.0.1", 20000, [this, pSelf](const asio::ip::udp::endpoint sendPt, const TransBaseMsg_t* pMsg) {
-			DispatchRecvUdpMsg(sendPt, pMsg);
+			//pMsg指向UDP的接收缓冲区,拷贝后再投递到业务strand
+			auto pCopy = std::make_shared<TransBaseMsg_t>(*pMsg);
+			m_strand.post([this, pSelf, sendPt, pCopy]() {
+				DispatchRecvUdpMsg(sendPt, pCopy.get());
+			});
 		});
 		if (m_udpServer)
 		{
 			m_udpServer->StartConnect();
 		}
 		{
-			m_util.ConnectToServer(m_dbCfg.m_strUserName,
+			m_util.SetTimeout(m_dbExecutorCfg.m_nQueryTimeout);
+			if (m_util.ConnectToServer(m_dbCfg.m_strUserName,
 				m_dbCfg.m_strPassword,
 				m_dbCfg.m_strDbName,
 				m_dbCfg.m_strDbIp,
-				m_dbCfg.m_nDbPort);
+				m_dbCfg.m_nDbPort) && !m_util.IsChatSchemaMigrated())
+			{
+				LOG_ERR(ms_loger, "Chat Tables Use Old Schema, Run 'DbTool <cfg> migrate' [{} {}]", __FILENAME__, __LINE__);
+			}
 			//m_util.ConnectToServer(m_mysqlCfg.m_strIp,m_mysqlCfg.m)
+			StartDbExecutor();
+			m_strand.post([this, pSelf]() {
+				StartFileIoEngine();
+				StartChatMsgJournal();
+				StartChatArchive();
+				StartBlobStore();
+			});
 		}
 	}
 	else
@@ -824,51 +1574,49 @@ void CChatServer::start(const std::function<void(const std::error_code &)> &call
  * @param io_service asio的IOService
  */
 CChatServer::CChatServer(asio::io_service &io_service)
-	: m_ioService(io_service), m_socket(io_service), m_acceptor(io_service), m_MsgID_Util(1, 3)
+	: m_ioService(io_service), m_strand(io_service), m_socket(io_service), m_acceptor(io_service), m_MsgID_Util(1, 3)
 {
 	if (!m_timer)
 	{
 		m_timer = std::make_shared<asio::high_resolution_timer>(m_ioService);
 	}
+	m_fileTimer = std::make_shared<asio::high_resolution_timer>(m_ioService);
+	m_journalTimer = std::make_shared<asio::high_resolution_timer>(m_ioService);
+	RegisterTcpHandlers();
 }
 /**
  * @brief 处理添加好友的回复请求消息，在用户登录的时候
  * 
+ * 未读的添加好友消息在连接池上查询,查询到以后在业务strand上发送
  * @param strUser 用户名
- * @return true 成功
- * @return false 失败
  */
-bool CChatServer::OnAddFriendRecvReqMsg(const std::string strUser)
+void CChatServer::OnAddFriendRecvReqMsg(const std::string strUser)
 {
-	T_ADD_FRIEND_MSG_BEAN msgBean;
-	if (m_util.SelectUnReadAddFriendMsg(strUser, msgBean))
-	{
+	auto pSelf = shared_from_this();
+	PostDbQuery(strUser, [strUser](CMySqlConnect& util) {
+		T_ADD_FRIEND_MSG_BEAN msgBean;
+		bool bHasMsg = util.SelectUnReadAddFriendMsg(strUser, msgBean);
+		return std::make_pair(bHasMsg, msgBean);
+	}, [this, pSelf, strUser](const std::pair<bool, T_ADD_FRIEND_MSG_BEAN>& result) {
+		if (!result.first)
 		{
-			AddFriendRecvReqMsg reqMsg;
-
-			reqMsg.m_strMsgId = msgBean.m_strF_MSG_ID;
-			reqMsg.m_strFriendId = msgBean.m_strF_FRIEND_ID;
-			reqMsg.m_strUserId = strUser;
-
-			{
-				auto item = m_UserSessVec.find(strUser);
-				if (item != m_UserSessVec.end() && item->second->IsConnected())
-				{
-					item->second->SendMsg(&reqMsg);
-				}
-				else
-				{
-					LOG_INFO(ms_loger, "Could Not Find Sess For {} [{}  {}]", strUser, __FILENAME__, __LINE__);
-				}
-			}
-
+			LOG_INFO(ms_loger, "{} has No UnRead Add Friend Msg [{} {}]", strUser, __FILENAME__, __LINE__);
+			return;
 		}
-		return true;
-	}
-	else {
-		LOG_INFO(ms_loger, "{} has No UnRead Add Friend Msg [{} {}]",strUser, __FILENAME__, __LINE__);
-		return false;
-	}
+		AddFriendRecvReqMsg reqMsg;
+		reqMsg.m_strMsgId = result.second.m_strF_MSG_ID;
+		reqMsg.m_strFriendId = result.second.m_strF_FRIEND_ID;
+		reqMsg.m_strUserId = strUser;
+		auto item = m_presence.GetSess(strUser);
+		if (item && item->IsConnected())
+		{
+			item->SendMsg(&reqMsg);
+		}
+		else
+		{
+			LOG_INFO(ms_loger, "Could Not Find Sess For {} [{}  {}]", strUser, __FILENAME__, __LINE__);
+		}
+	});
 }
 
 
@@ -879,21 +1627,55 @@ bool CChatServer::OnAddFriendRecvReqMsg(const std::string strUser)
  */
 void CChatServer::OnUserStateCheck(const std::string strUserId)
 {
-	auto stateItem = m_clientStateMap.find(strUserId);
-	auto item = m_userIdUdpAddrMap.find(strUserId);
-	if (stateItem != m_clientStateMap.end())
+	//用户的在线记录只在用户所在分片的strand上修改
+	auto& strand = UserShard(strUserId).m_strand;
+	if (!strand.running_in_this_thread())
+	{
+		auto pSelf = shared_from_this();
+		strand.post([this, pSelf, strUserId]() {
+			OnUserStateCheck(strUserId);
+		});
+		return;
+	}
+	UserPresence_st* pUser = m_presence.Find(strUserId);
+	if (nullptr == pUser)
+	{
+		LOG_WARN(ms_loger, "No User {} State [ {}  {} ]", strUserId, __FILENAME__, __LINE__);
+		return;
+	}
+	if (pUser->m_eState != CLIENT_SESS_STATE::SESS_IDLE_STATE)
+	{
+		return;
+	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(strUserId, [strUserId](CMySqlConnect& util) {
+		return util.HaveUnReadMsg(strUserId);
+	}, [this, pSelf, strUserId](const bool bHaveUnRead) {
+		OnUserUnReadChecked(strUserId, bHaveUnRead);
+	});
+}
+
+/**
+ * @brief 查询到用户是否有未读消息以后,通知空闲的用户接收消息
+ * 
+ * @param strUserId 用户ID
+ * @param bHaveUnRead 是否有未读消息
+ */
+void CChatServer::OnUserUnReadChecked(const std::string strUserId, const bool bHaveUnRead)
+{
+	//查询期间用户可能已经下线或者开始接收消息
+	UserPresence_st* pUser = m_presence.Find(strUserId);
+	if (nullptr != pUser)
 	{
-		T_USER_CHAT_MSG chatMsg;
-		if (stateItem->second == CLIENT_SESS_STATE::SESS_IDLE_STATE) {
-			if (m_util.HaveUnReadMsg(strUserId)) {
-				m_clientStateMap[strUserId] = CLIENT_SESS_STATE::SESS_FRIEND_MSG_SEND_RECV_STATE;
+		if (pUser->m_eState == CLIENT_SESS_STATE::SESS_IDLE_STATE) {
+			if (bHaveUnRead) {
+				pUser->m_eState = CLIENT_SESS_STATE::SESS_FRIEND_MSG_SEND_RECV_STATE;
 				FriendUnReadNotifyReqMsg reqMsg;
 				reqMsg.m_strMsgId = std::to_string(m_MsgID_Util.nextId());
 				reqMsg.m_strUserId = strUserId;
 
-				auto item = m_UserSessVec.find(strUserId);
-				if (item != m_UserSessVec.end()) {
-					item->second->SendMsg(&reqMsg);
+				if (pUser->m_pSess) {
+					pUser->m_pSess->SendMsg(&reqMsg);
 				}
 				else
 				{
@@ -924,20 +1706,61 @@ void CChatServer::OnUserStateCheck(const std::string strUserId)
  */
 void CChatServer::HandleUserLoginReq(const std::shared_ptr<CServerSess>& pSess, const UserLoginReqMsg& reqMsg)
 {
-	UserLoginRspMsg rspMsg = DoUserLoginReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserName, [this, reqMsg](CMySqlConnect& util) {
+		return DoUserLoginReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](const UserLoginRspMsg& rspMsg) {
+		OnUserLoginRsp(pSess, reqMsg, rspMsg);
+	});
+}
+
+/**
+ * @brief 数据库校验完用户以后完成登录,登录成功的用户在自己所在分片的strand上注册
+ * 
+ * @param pSess 用户的连接会话
+ * @param reqMsg 登陆请求消息
+ * @param rspMsg 数据库校验的结果
+ */
+void CChatServer::OnUserLoginRsp(const std::shared_ptr<CServerSess>& pSess, const UserLoginReqMsg& reqMsg, UserLoginRspMsg rspMsg)
+{
+	//查询数据库期间连接已经断开
+	if (!pSess || !pSess->IsConnected())
 	{
-		pSess->SendMsg(&rspMsg);
+		LOG_WARN(ms_loger, "User:{} Closed Before Login Finished [{} {}]", reqMsg.m_strUserName, __FILENAME__, __LINE__);
+		return;
 	}
-
+	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
 	if (rspMsg.m_eErrCode == ERROR_CODE_TYPE::E_CODE_SUCCEED)
 	{
-		HandleReLogin(rspMsg.m_strUserId, pSess);
-		//OnAddFriendRecvReqMsg(rspMsg.m_strUserId);
-		//OnAddFriendNotifyReqMsg(rspMsg.m_strUserId);
-		NotifyUserFriends(rspMsg.m_strUserId);
+		//接收缓冲区按需扩大,会话只需要记录TCP发送文件时使用的数据包长度
+		rspMsg.m_nMaxFrameSize = NegotiateFrameSize(reqMsg.m_nMaxFrameSize, m_nMaxFrameSize);
+		rspMsg.m_nChunkSize = NegotiateChunkSize(reqMsg.m_nChunkSize, m_nChunkSize, rspMsg.m_nMaxFrameSize);
+		rspMsg.m_nGroupMsgBatch = NegotiateGroupMsgBatch(reqMsg.m_nGroupMsgBatch, m_nGroupMsgBatch);
+		//告知客户端可以使用二进制编码,客户端在收到此回复之前只发送json
+		rspMsg.m_bBinaryCodec = true;
+		if (pSess)
+		{
+			pSess->SetChunkSize(rspMsg.m_nChunkSize);
+			pSess->SetGroupMsgBatch(rspMsg.m_nGroupMsgBatch);
+		}
+	}
+	if (rspMsg.m_eErrCode != ERROR_CODE_TYPE::E_CODE_SUCCEED)
+	{
+		pSess->SendMsg(&rspMsg);
+		return;
 	}
+
+	SaveUserOnlineState(rspMsg.m_strUserId, CLIENT_STATE::C_STATE_ONLINE);
+	//设置会话的用户ID以后再回复,客户端随后的消息都投递到用户所在的分片
+	std::string strUserId = rspMsg.m_strUserId;
+	auto pSelf = shared_from_this();
+	DispatchToUser(strUserId, [this, pSelf, strUserId, pSess, rspMsg]() {
+		HandleReLogin(strUserId, pSess);
+		pSess->SendMsg(&rspMsg);
+		//OnAddFriendRecvReqMsg(strUserId);
+		//OnAddFriendNotifyReqMsg(strUserId);
+		NotifyUserFriends(strUserId);
+	});
 }
 
 /**
@@ -950,8 +1773,12 @@ void CChatServer::HandleFriendUnReadNotifyRspMsg(const std::shared_ptr<CServerSe
 {
 	if(pSess)
 	{
-		m_clientStateMap[rspMsg.m_strUserId] = CLIENT_SESS_STATE::SESS_RECV_MSG_FINISHED;
-		OnUserReceiveMsg(rspMsg.m_strUserId);
+		std::string strUserId = rspMsg.m_strUserId;
+		auto pSelf = shared_from_this();
+		DispatchToUser(strUserId, [this, pSelf, strUserId]() {
+			SetUserState(strUserId, CLIENT_SESS_STATE::SESS_RECV_MSG_FINISHED);
+			OnUserReceiveMsg(strUserId);
+		});
 	}
 }
 
@@ -978,16 +1805,24 @@ void CChatServer::HandleUserKeepAliveReq(const std::shared_ptr<CServerSess> pSes
  */
 void CChatServer::HandleUserLogoutReq(const std::shared_ptr<CServerSess>& pSess, const UserLogoutReqMsg& reqMsg)
 {
-	UserLogoutRspMsg rspMsg = DoUserLogoutReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserName, [this, reqMsg](CMySqlConnect& util) {
+		return DoUserLogoutReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](UserLogoutRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (!pSess)
+		{
+			return;
+		}
 		pSess->SendMsg(&rspMsg);
-		NotifyUserFriends(pSess->UserId());
-		CloseSess(pSess);
-		RemoveUserAllGroupState(pSess->UserId());
-	}
-
+		//查询期间连接可能已经关闭,或者用户已经在新的连接上登录,只清除本连接的状态
+		if (m_presence.GetSess(pSess->UserId()) == pSess)
+		{
+			NotifyUserFriends(pSess->UserId());
+			CloseSess(pSess);
+			RemoveUserAllGroupState(pSess->UserId());
+		}
+	});
 }
 
 /**
@@ -998,12 +1833,16 @@ void CChatServer::HandleUserLogoutReq(const std::shared_ptr<CServerSess>& pSess,
  */
 void CChatServer::HandleUserRegisterReq(const std::shared_ptr<CServerSess>& pSess, const UserRegisterReqMsg& reqMsg)
 {
-	UserRegisterRspMsg rspMsg = DoUserRegisterReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserName, [this, reqMsg](CMySqlConnect& util) {
+		return DoUserRegisterReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](UserRegisterRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 }
 
 /**
@@ -1014,50 +1853,27 @@ void CChatServer::HandleUserRegisterReq(const std::shared_ptr<CServerSess>& pSes
  */
 void CChatServer::HandleUserUnRegisterReq(const std::shared_ptr<CServerSess>& pSess, const UserUnRegisterReqMsg& reqMsg)
 {
-	UserUnRegisterRspMsg rspMsg = DoUserUnRegisterReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserName, [this, reqMsg](CMySqlConnect& util) {
+		return DoUserUnRegisterReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](UserUnRegisterRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 }
 
 
 /**
- * @brief TCP消息处理,处理文件发送数据开始请求消息
+ * @brief 文件发送数据开始请求的回复
  * 
- * @param pSess 发送TCP消息的会话
  * @param req 文件发送数据开始请求消息
+ * @return FileSendDataBeginRsp 填好请求中字段的回复
  */
-void CChatServer::HandleFileSendDataBeginReq(const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginReq& req)
+static FileSendDataBeginRsp FileSendDataBeginRspOf(const FileSendDataBeginReq& req)
 {
-	//
-	//{
-	//	T_FILE_HASH_BEAN bean;
-	//	if(m_util.SelectFileByHash(bean,req.m_strFileHash))
-	//	{
-	//		std::string strFileName = strFolder+ bean.m_strF_FILE_NAME;
-	//		if (m_fileUtil.IsFileExist(strFileName))
-	//		{
-	//			LOG_INFO(ms_loger, "FileName:{} Is On Server Hash:{} [{} {}]", strFileName, req.m_strFileHash,__FILENAME__,__LINE__);
-	//			FileSendDataBeginRsp rspMsg;
-	//			rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_FILE_HAS_EXIST;
-	//			rspMsg.m_nFileId = req.m_nFileId;
-	//			rspMsg.m_strFileName = req.m_strFileName;
-	//			rspMsg.m_strFriendId = req.m_strFriendId;
-	//			rspMsg.m_strUserId = req.m_strUserId;
-	//			rspMsg.m_strMsgId = req.m_strMsgId;
-	//			rspMsg.m_eFileType = req.m_eFileType;
-	//			pSess->SendMsg(&rspMsg);
-	//			return;
-	//		}
-	//		else
-	//		{
-	//			m_util.DeleteFileByHash(req.m_strFileHash);
-	//		}
-	//	}
-	//}
-	std::string strFolder = GetImageDir();
 	FileSendDataBeginRsp rspMsg;
 	rspMsg.m_nFileId = req.m_nFileId;
 	rspMsg.m_strFileName = req.m_strFileName;
@@ -1065,113 +1881,330 @@ void CChatServer::HandleFileSendDataBeginReq(const std::shared_ptr<CServerSess>&
 	rspMsg.m_strUserId = req.m_strUserId;
 	rspMsg.m_strMsgId = req.m_strMsgId;
 	rspMsg.m_eFileType = req.m_eFileType;
-	if (IsFileRecving(req.m_strFileHash))
-	{
-		rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_FILE_TRANSING;
-		LOG_WARN(ms_loger, "User:{} File:{} Is Recving [{} {}]", req.m_strUserId, req.m_strFileName, __FILENAME__, __LINE__);
-	}
-	else
-	{
-		SaveRecvingState(req.m_strFileHash);
-		std::string strFileName = strFolder + req.m_strFileName;
-		if (!m_fileUtil.IsFileExist(strFileName)) {
-			m_fileUtil.OpenWriteFile(req.m_nFileId, strFileName);
-		}
-		rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
-
-	}
-	pSess->SendMsg(&rspMsg);
-
+	return rspMsg;
 }
 
 /**
- * @brief TCP消息处理,处理文件下载请求消息
+ * @brief 秒传时的盐,每次随机生成
  * 
- * @param pSess 发送TCP消息的会话
- * @param req 文件下载请求消息
+ * @return std::string 十六进制字符串
  */
-void CChatServer::HandleFileDownLoadReq(const std::shared_ptr<CServerSess>& pSess, const FileDownLoadReqMsg& req)
+static std::string CreateProofSalt()
 {
-	if (pSess)
+	static const char HEX_CHARS[] = "0123456789abcdef";
+	std::random_device randomDev;
+	std::string strSalt;
+	for (int i = 0; i < 4; i++)
 	{
-		FileDownLoadRspMsg rspMsg;
-		rspMsg.m_strMsgId = req.m_strMsgId;
-		rspMsg.m_strUserId = req.m_strUserId;
-		rspMsg.m_strFriendId = req.m_strFriendId;
-		rspMsg.m_strFileName = req.m_strFileName;
-		rspMsg.m_strRelateMsgId = req.m_strRelateMsgId;
-		rspMsg.m_eFileType = req.m_eFileType;
+		uint32_t nValue = randomDev();
+		for (int j = 0; j < 8; j++)
 		{
-			std::string strFileName = GetImageDir() + req.m_strFileName;
-			rspMsg.m_strFileHash = m_fileUtil.CalcHash(strFileName);
-			if (!m_fileUtil.IsFileExist(strFileName))
-			{
-				LOG_ERR(ms_loger, "File Not Exist: {} [{} {}]", strFileName,__FILENAME__,__LINE__);
-				rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_NO_SUCH_FILE;
-				pSess->SendMsg(&rspMsg);
-			}
-			else
-			{
-				rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
-				pSess->SendMsg(&rspMsg);
-				FileSendDataBeginReq reqMsg;
-				reqMsg.m_strUserId = req.m_strUserId;
-				reqMsg.m_strFriendId = req.m_strFriendId;
-				reqMsg.m_strFileName = req.m_strFileName;
-				reqMsg.m_nFileId = rand();
-				reqMsg.m_strFileHash = rspMsg.m_strFileHash;
-				reqMsg.m_strMsgId = CreateMsgId();
-				reqMsg.m_eFileType = req.m_eFileType;
-				pSess->SendMsg(&reqMsg);
-				SaveSendingState(reqMsg.m_strFileHash);
-			}
+			strSalt.push_back(HEX_CHARS[nValue & 0x0F]);
+			nValue >>= 4;
 		}
 	}
+	return strSalt;
 }
 
 /**
- * @brief TCP消息处理,处理文件发送数据开始回复消息
+ * @brief TCP消息处理,处理文件发送数据开始请求消息
  * 
+ * 服务器已经保存过相同内容的文件时,发送端用服务器给出的盐计算持有证明,证明正确以后文件名直接引用,
+ * 不再传输数据。只知道Hash不能拿到文件,不支持证明的旧版本按普通上传接收。
  * @param pSess 发送TCP消息的会话
- * @param req 文件发送数据开始回复消息
+ * @param req 文件发送数据开始请求消息
  */
-void CChatServer::HandleFileSendDataBeginRsp(const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginRsp& req)
+void CChatServer::HandleFileSendDataBeginReq(const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginReq& req)
 {
-	if (req.m_errCode == ERROR_CODE_TYPE::E_CODE_SUCCEED)
+	const BlobInfo_st* pBlob = m_blobStore.IsOpen() ? m_blobStore.FindBlob(req.m_strFileHash) : nullptr;
+	if (nullptr == pBlob || !req.m_bProofSupport)
 	{
-		std::string strFileName = GetImageDir() + req.m_strFileName;
-		if (m_fileUtil.IsFileExist(req.m_strFileName))
-		{
-			strFileName = req.m_strFileName;
-		}
-		int nFileSize = 0;
-		m_fileUtil.GetFileSize(nFileSize, strFileName);
-		if (m_fileUtil.OpenReadFile(req.m_nFileId, strFileName)) {
-			FileDataRecvReqMsg sendReqMsg;
-			sendReqMsg.m_strMsgId = std::to_string(m_MsgID_Util.nextId());
-			sendReqMsg.m_strFriendId = req.m_strFriendId;
-			sendReqMsg.m_strUserId = req.m_strUserId;
-			sendReqMsg.m_nFileId = req.m_nFileId;
-
-			sendReqMsg.m_nDataTotalCount = nFileSize / 1024 + (nFileSize % 1024 == 0 ? 0 : 1);
-			sendReqMsg.m_nDataIndex = 1;
-			sendReqMsg.m_nDataLength = 0;
-			m_fileUtil.OnReadData(sendReqMsg.m_nFileId, sendReqMsg.m_szData, sendReqMsg.m_nDataLength, 1024);
-			if (req.m_eFileType == FILE_TYPE::FILE_TYPE_IMAGE)
-			{
-				pSess->SendMsg(&sendReqMsg);
-			}
-			else if (req.m_eFileType == FILE_TYPE::FILE_TYPE_FILE)
-			{
-				auto udpAddr = m_userIdUdpAddrMap.find(sendReqMsg.m_strUserId);
-				if (udpAddr != m_userIdUdpAddrMap.end())
-				{
-					m_udpServer->sendMsg(udpAddr->second.m_strServerIp,udpAddr->second.m_nPort, &sendReqMsg);
-				}
-			}
-		}
+		BeginRecvFile(pSess, req);
+		return;
 	}
-}
+	const std::string strProofKey = req.m_strUserId + "/" + pBlob->m_strHash;
+	if (req.m_strFileProof.empty())
+	{
+		FileSendDataBeginRsp rspMsg = FileSendDataBeginRspOf(req);
+		rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_FILE_NEED_PROOF;
+		rspMsg.m_strProofSalt = CreateProofSalt();
+		m_fileProofMap[strProofKey] = rspMsg.m_strProofSalt;
+		pSess->SendMsg(&rspMsg);
+		return;
+	}
+	//盐只使用一次,不是服务器给出的盐按普通上传接收
+	auto proofItem = m_fileProofMap.find(strProofKey);
+	if (proofItem == m_fileProofMap.end() || proofItem->second != req.m_strProofSalt)
+	{
+		LOG_WARN(ms_loger, "User:{} File:{} Unknown Proof Salt [{} {}]", req.m_strUserId, req.m_strFileName, __FILENAME__, __LINE__);
+		BeginRecvFile(pSess, req);
+		return;
+	}
+	m_fileProofMap.erase(proofItem);
+	const std::string strBlobPath = m_blobStore.BlobPath(pBlob->m_strHash);
+	const std::string strSalt = req.m_strProofSalt;
+	auto pSelf = shared_from_this();
+	m_fileIo.Post(req.m_nFileId, [strBlobPath, strSalt]() {
+		return CFileHash::CalcProof(strBlobPath, strSalt);
+	}, m_strand, [this, pSelf, pSess, req](const std::string& strProof) {
+		OnFileProofChecked(pSess, req, !strProof.empty() && strProof == req.m_strFileProof);
+	});
+}
+
+/**
+ * @brief 持有证明计算完成,证明正确时文件名引用已经保存的内容,否则按普通上传接收
+ * 
+ * @param pSess 发送TCP消息的会话
+ * @param req 文件发送数据开始请求消息
+ * @param bProof 证明是否正确
+ */
+void CChatServer::OnFileProofChecked(const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginReq& req, const bool bProof)
+{
+	if (!bProof)
+	{
+		LOG_WARN(ms_loger, "User:{} File:{} Hash:{} Proof Mismatch [{} {}]", req.m_strUserId, req.m_strFileName, req.m_strFileHash, __FILENAME__, __LINE__);
+	}
+	//计算期间内容可能已经删除
+	else if (m_blobStore.Link(m_fileUtil.GetFileNameFromPath(req.m_strFileName), req.m_strFileHash))
+	{
+		LOG_INFO(ms_loger, "User:{} File:{} Hash:{} Is On Server [{} {}]", req.m_strUserId, req.m_strFileName, req.m_strFileHash, __FILENAME__, __LINE__);
+		FileSendDataBeginRsp rspMsg = FileSendDataBeginRspOf(req);
+		rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_FILE_HAS_EXIST;
+		pSess->SendMsg(&rspMsg);
+		return;
+	}
+	BeginRecvFile(pSess, req);
+}
+
+/**
+ * @brief 开始接收上传的文件,上次中断的上传只接收缺少的数据包
+ * 
+ * 发送端的文件ID由各个客户端自己生成,可能相同,接收时换成服务器分配的文件ID,
+ * 回复中带回新的ID,发送端之后的数据包和校验请求使用回复中的ID
+ * @param pSess 发送TCP消息的会话
+ * @param beginReq 文件发送数据开始请求消息
+ */
+void CChatServer::BeginRecvFile(const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginReq& beginReq)
+{
+	FileSendDataBeginReq req = beginReq;
+	req.m_nFileId = CreateFileId();
+	FileSendDataBeginRsp rspMsg = FileSendDataBeginRspOf(req);
+	//数据包的长度使用登录时协商的长度,旧版本的发送端没有此字段
+	rspMsg.m_nChunkSize = pSess->ChunkSize();
+	if (req.m_nChunkSize > 0 && req.m_nChunkSize != rspMsg.m_nChunkSize)
+	{
+		rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_FILE_SEND_FAILED;
+		LOG_WARN(ms_loger, "User:{} File:{} Chunk Size:{} Not Negotiated:{} [{} {}]", req.m_strUserId, req.m_strFileName, req.m_nChunkSize, rspMsg.m_nChunkSize, __FILENAME__, __LINE__);
+	}
+	else if (IsFileRecving(req.m_strFileHash) && !TakeOverRecvFile(req))
+	{
+		rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_FILE_TRANSING;
+		LOG_WARN(ms_loger, "User:{} File:{} Is Recving [{} {}]", req.m_strUserId, req.m_strFileName, __FILENAME__, __LINE__);
+	}
+	else
+	{
+		SaveRecvingState(req.m_strFileHash);
+		std::string strFileName = UploadFilePath(m_fileUtil.GetFileNameFromPath(req.m_strFileName));
+		if (!StartRecvResume(req, strFileName, rspMsg))
+		{
+			//上次中断的上传留下的临时文件
+			if (m_blobStore.IsOpen())
+			{
+				m_fileUtil.RemoveFile(strFileName);
+			}
+			if (!m_fileUtil.IsFileExist(strFileName)) {
+				m_fileIo.Open(req.m_nFileId, strFileName, FILE_OPEN_MODE::OPEN_WRITE);
+			}
+		}
+		m_fileRecvHashMap.erase(req.m_nFileId);
+		//续传时已经写入的数据包不再计算,校验时读取文件
+		if (!rspMsg.m_bResume)
+		{
+			//按发送端Hash的算法在接收时计算
+			FILE_HASH_TYPE eHashType = FILE_HASH_TYPE::HASH_MD5;
+			CFileHash::TypeOfHash(req.m_strFileHash, eHashType);
+			m_fileRecvHashMap.insert({ req.m_nFileId, CChunkHash(eHashType) });
+		}
+		SetFileRecvLimit(req.m_nFileId, rspMsg.m_nChunkSize, req.m_nFileSize);
+		rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
+
+	}
+	pSess->SendMsg(&rspMsg);
+}
+
+/**
+ * @brief 记录接收文件时数据包的限制,数据包的偏移和接收窗口的大小都由此限制
+ * 
+ * @param nFileId 文件ID
+ * @param nChunkSize 协商的数据包长度
+ * @param nFileSize 文件大小,旧版本的发送端为0
+ */
+void CChatServer::SetFileRecvLimit(const int nFileId, const int nChunkSize, const int nFileSize)
+{
+	FileRecvLimit_st limit;
+	limit.m_nChunkSize = nChunkSize;
+	limit.m_nMaxCount = FileDataChunkCount(nFileSize > 0 ? nFileSize : std::numeric_limits<int>::max(), nChunkSize);
+	m_fileRecvLimitMap[nFileId] = limit;
+}
+
+/**
+ * @brief TCP消息处理,处理文件下载请求消息
+ * 
+ * @param pSess 发送TCP消息的会话
+ * @param req 文件下载请求消息
+ */
+void CChatServer::HandleFileDownLoadReq(const std::shared_ptr<CServerSess>& pSess, const FileDownLoadReqMsg& req)
+{
+	if (pSess)
+	{
+		FileDownLoadRspMsg rspMsg;
+		rspMsg.m_strMsgId = req.m_strMsgId;
+		rspMsg.m_strUserId = req.m_strUserId;
+		rspMsg.m_strFriendId = req.m_strFriendId;
+		rspMsg.m_strFileName = req.m_strFileName;
+		rspMsg.m_strRelateMsgId = req.m_strRelateMsgId;
+		rspMsg.m_eFileType = req.m_eFileType;
+		//没有保存Hash的文件在文件读写线程上计算,计算完成以后回复
+		const int nFileId = CreateFileId();
+		auto pSelf = shared_from_this();
+		FindStoredFile(nFileId, req.m_strFileName, [this, pSelf, pSess, req, rspMsg, nFileId](const bool bFound, const std::string& strFileName, const std::string& strFileHash) {
+			FileDownLoadRspMsg downRspMsg = rspMsg;
+			if (!bFound)
+			{
+				LOG_ERR(ms_loger, "File Not Exist: {} [{} {}]", strFileName,__FILENAME__,__LINE__);
+				downRspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_NO_SUCH_FILE;
+				pSess->SendMsg(&downRspMsg);
+				return;
+			}
+			downRspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
+			downRspMsg.m_strFileHash = strFileHash;
+			pSess->SendMsg(&downRspMsg);
+			FileSendDataBeginReq reqMsg;
+			reqMsg.m_strUserId = req.m_strUserId;
+			reqMsg.m_strFriendId = req.m_strFriendId;
+			reqMsg.m_strFileName = req.m_strFileName;
+			reqMsg.m_nFileId = nFileId;
+			reqMsg.m_strFileHash = strFileHash;
+			reqMsg.m_strMsgId = CreateMsgId();
+			reqMsg.m_eFileType = req.m_eFileType;
+			//接收端根据文件长度和数据包长度判断能否续传
+			m_fileUtil.GetFileSize(reqMsg.m_nFileSize, strFileName);
+			reqMsg.m_nChunkSize = req.m_eFileType == FILE_TYPE::FILE_TYPE_IMAGE ? pSess->ChunkSize() : FILE_DATA_UDP_CHUNK_SIZE;
+			pSess->SendMsg(&reqMsg);
+			SaveSendingState(reqMsg.m_strFileHash);
+		});
+	}
+}
+
+/**
+ * @brief TCP消息处理,处理文件发送数据开始回复消息
+ * 
+ * @param pSess 发送TCP消息的会话
+ * @param req 文件发送数据开始回复消息
+ */
+void CChatServer::HandleFileSendDataBeginRsp(const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginRsp& req)
+{
+	if (req.m_errCode != ERROR_CODE_TYPE::E_CODE_SUCCEED)
+	{
+		return;
+	}
+	if (m_fileUtil.IsFileExist(req.m_strFileName))
+	{
+		BeginSendFile(pSess, req, req.m_strFileName, "");
+		return;
+	}
+	auto pSelf = shared_from_this();
+	FindStoredFile(req.m_nFileId, req.m_strFileName, [this, pSelf, pSess, req](const bool bFound, const std::string& strFileName, const std::string& strFileHash) {
+		if (!bFound)
+		{
+			LOG_ERR(ms_loger, "File Not Exist: {} [{} {}]", req.m_strFileName, __FILENAME__, __LINE__);
+			return;
+		}
+		BeginSendFile(pSess, req, strFileName, strFileHash);
+	});
+}
+
+/**
+ * @brief 接收端同意接收以后开始发送文件数据
+ * 
+ * @param pSess 接收端的会话
+ * @param req 文件发送数据开始回复消息
+ * @param strFileName 发送的文件
+ * @param strFileHash 文件的Hash,不知道时为空,发送时计算
+ */
+void CChatServer::BeginSendFile(const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginRsp& req, const std::string strFileName, const std::string strFileHash)
+{
+	int nFileSize = 0;
+	m_fileUtil.GetFileSize(nFileSize, strFileName);
+	if (m_fileIo.Open(req.m_nFileId, strFileName, FILE_OPEN_MODE::OPEN_READ)) {
+		FileSendWindow_st sendWindow;
+		sendWindow.m_strFileName = m_fileUtil.GetFileNameFromPath(req.m_strFileName);
+		sendWindow.m_strFileHash = strFileHash;
+		sendWindow.m_nFileSize = nFileSize;
+		FileDataRecvReqMsg& sendReqMsg = sendWindow.m_reqMsg;
+		sendReqMsg.m_strFriendId = req.m_strFriendId;
+		sendReqMsg.m_strUserId = req.m_strUserId;
+		sendReqMsg.m_nFileId = req.m_nFileId;
+		sendReqMsg.m_strMsgId = std::to_string(m_MsgID_Util.nextId());
+		if (req.m_eFileType == FILE_TYPE::FILE_TYPE_IMAGE)
+		{
+			//TCP使用登录时协商的数据包长度
+			sendReqMsg.m_nChunkSize = pSess ? pSess->ChunkSize() : FILE_DATA_CHUNK_SIZE;
+			std::weak_ptr<CServerSess> pWeakSess = pSess;
+			sendWindow.m_sendFunc = [pWeakSess](const FileDataRecvReqMsg& msg) {
+				auto pSendSess = pWeakSess.lock();
+				if (pSendSess && pSendSess->IsConnected())
+				{
+					pSendSess->SendMsg(&msg);
+					return true;
+				}
+				return false;
+			};
+			//文件数据不经过用户空间,无法在发送时计算Hash,只对已知Hash的文件使用
+			if (pSess && pSess->CanSendFileData() && !sendWindow.m_strFileHash.empty())
+			{
+				sendWindow.m_sendFileFunc = [pWeakSess](const FileDataRecvReqMsg& msg, const std::shared_ptr<CIoFile>& pFile, const int64_t nOffset) {
+					auto pSendSess = pWeakSess.lock();
+					if (pSendSess && pSendSess->IsConnected())
+					{
+						pSendSess->SendFileData(FileDataFramePrefix(msg), pFile, nOffset, static_cast<std::size_t>(msg.m_nDataLength));
+						return true;
+					}
+					return false;
+				};
+			}
+		}
+		else if (req.m_eFileType == FILE_TYPE::FILE_TYPE_FILE)
+		{
+			IpPortCfg udpCfg;
+			if (!m_presence.GetUdpAddr(sendReqMsg.m_strUserId, udpCfg))
+			{
+				LOG_ERR(ms_loger, "User:{} No Udp Addr [{} {}]", sendReqMsg.m_strUserId, __FILENAME__, __LINE__);
+				m_fileIo.Close(req.m_nFileId);
+				return;
+			}
+			sendReqMsg.m_nChunkSize = FILE_DATA_UDP_CHUNK_SIZE;
+			auto pUdpServer = m_udpServer;
+			sendWindow.m_sendFunc = [pUdpServer, udpCfg](const FileDataRecvReqMsg& msg) {
+				pUdpServer->sendMsg(udpCfg.m_strServerIp, udpCfg.m_nPort, &msg);
+				return true;
+			};
+		}
+		else
+		{
+			m_fileIo.Close(req.m_nFileId);
+			return;
+		}
+		sendReqMsg.m_nDataTotalCount = FileDataChunkCount(nFileSize, sendReqMsg.m_nChunkSize);
+		sendWindow.m_window = CFileSendWindow(sendReqMsg.m_nDataTotalCount, m_nFileWindowSize);
+		//接收端续传时只发送缺少的数据包,跳过的数据包无法计算Hash,只对已知Hash的文件续传
+		if (req.m_bResume && req.m_nChunkSize == sendReqMsg.m_nChunkSize && !sendWindow.m_strFileHash.empty())
+		{
+			sendWindow.m_window.SetSendRanges(req.m_missingRangeVec);
+		}
+		StartFileDataSend(sendWindow);
+	}
+}
 
 /**
  * @brief 处理好友发送文本消息
@@ -1181,16 +2214,42 @@ void CChatServer::HandleFileSendDataBeginRsp(const std::shared_ptr<CServerSess>&
  */
 void CChatServer::HandleFriendChatSendTxtReq(const std::shared_ptr<CServerSess>& pSess, const FriendChatSendTxtReqMsg& reqMsg)
 {
-	FriendChatSendTxtRspMsg rspMsg = DoFriendChatSendTxtReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
+	//消息ID和时间在业务strand上生成,同一个发送者的消息按顺序入库
+	T_USER_CHAT_MSG  chatMsg;
+	chatMsg.m_strF_MSG_ID = std::to_string(m_MsgID_Util.nextId());
+	chatMsg.m_strF_FROM_ID = reqMsg.m_strSenderId;
+	chatMsg.m_strF_TO_ID = reqMsg.m_strReceiverId;
+	chatMsg.m_eChatMsgType = CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE;
+	chatMsg.m_strF_MSG_CONTEXT = reqMsg.m_strContext;
+	chatMsg.m_strF_OTHER_INFO = reqMsg.m_fontInfo.ToString();
+	chatMsg.m_strF_CREATE_TIME = CTimeUtil::GetYMD_HMS_Time();
+	//已经登录的用户发送的消息写入日志以后立即回复,接收者在消息入库以后收到通知
+	if (pSess && pSess->UserId() == reqMsg.m_strSenderId && AppendJournal(chatMsg))
 	{
+		FriendChatSendTxtRspMsg rspMsg;
+		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		rspMsg.m_chatMsg = DbBeanToMsgBean(chatMsg);
+		rspMsg.m_strErrMsg = "Succeed";
 		pSess->SendMsg(&rspMsg);
+		OnUserStateCheck(reqMsg.m_strSenderId);
+		ScheduleJournalFlush();
+		return;
 	}
-	//OnUserReceiveMsg(reqMsg.m_strSenderId);
-	//OnUserReceiveMsg(reqMsg.m_strReceiverId);
-	OnUserStateCheck(reqMsg.m_strSenderId);
-	OnUserStateCheck(reqMsg.m_strReceiverId);
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strSenderId, [this, reqMsg, chatMsg](CMySqlConnect& util) {
+		return DoFriendChatSendTxtReq(util, reqMsg, chatMsg);
+	}, [this, pSelf, pSess, reqMsg](FriendChatSendTxtRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+		//OnUserReceiveMsg(reqMsg.m_strSenderId);
+		//OnUserReceiveMsg(reqMsg.m_strReceiverId);
+		OnUserStateCheck(reqMsg.m_strSenderId);
+		OnUserStateCheck(reqMsg.m_strReceiverId);
+	});
 }
 
 /**
@@ -1201,12 +2260,16 @@ void CChatServer::HandleFriendChatSendTxtReq(const std::shared_ptr<CServerSess>&
  */
 void CChatServer::HandleFindFriendReq(const std::shared_ptr<CServerSess>& pSess, const FindFriendReqMsg& reqMsg)
 {
-	FindFriendRspMsg rspMsg = DoFindFriendReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserId, [this, reqMsg](CMySqlConnect& util) {
+		return DoFindFriendReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](FindFriendRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 }
 
 
@@ -1239,12 +2302,26 @@ void CChatServer::HandleUpdateGroupListRsp(const UpdateGroupListNotifyRspMsg& re
  * @param reqMsg 获取好友列表请求
  */
 void CChatServer::HandleGetFriendListReq(const std::shared_ptr<CServerSess>& pSess, const GetFriendListReqMsg& reqMsg) {
-	GetFriendListRspMsg rspMsg = DoGetFriendReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	std::string strUserId = reqMsg.m_strUserId;
+	//分组和好友资料在连接池上查询,回复和好友关系缓存在业务strand上处理
+	PostDbQuery(strUserId, [strUserId](CMySqlConnect& util) {
+		FriendListQuery_st query;
+		query.m_bHasTeam = util.SelectUserTeams(strUserId, query.m_teamVec);
+		if (query.m_bHasTeam)
+		{
+			//好友关系和好友资料一次查询,不再每个好友查询一次
+			util.SelectFriendInfoList(strUserId, query.m_friendVec);
+		}
+		return query;
+	}, [this, pSelf, pSess, reqMsg](const FriendListQuery_st& query) {
+		GetFriendListRspMsg rspMsg = DoGetFriendReq(reqMsg, query);
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (pSess && pSess->IsConnected())
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 	//获取好友列表以后，再将未读消息下发，聊天窗口中就不会没有昵称了
 	//OnUserStateCheck(reqMsg.m_strUserId);
 }
@@ -1258,12 +2335,16 @@ void CChatServer::HandleGetFriendListReq(const std::shared_ptr<CServerSess>& pSe
  */
 void CChatServer::HandleCreateGroupReq(const std::shared_ptr<CServerSess>& pSess, const CreateGroupReqMsg& reqMsg)
 {
-	CreateGroupRspMsg rspMsg = DoCreateGroupReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserId, [this, reqMsg](CMySqlConnect& util) {
+		return DoCreateGroupReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](CreateGroupRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 }
 
 
@@ -1275,21 +2356,30 @@ void CChatServer::HandleCreateGroupReq(const std::shared_ptr<CServerSess>& pSess
  */
 void CChatServer::HandleDestroyGroupReq(const std::shared_ptr<CServerSess>& pSess, const DestroyGroupReqMsg& reqMsg)
 {
-	DestroyGroupRspMsg rspMsg = DoDestroyGroupReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strGroupId, [this, reqMsg](CMySqlConnect& util) {
+		return DoDestroyGroupReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](DestroyGroupRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		{
+			std::lock_guard<std::mutex> lock(m_groupMsgCacheMutex);
+			m_groupMsgCache.Invalidate(reqMsg.m_strGroupId);
+		}
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 }
 
 /**
  * @brief 处理创建群组请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 群组创建请求
  * @return CreateGroupRspMsg 群组创建回复
  */
-CreateGroupRspMsg CChatServer::DoCreateGroupReq(const CreateGroupReqMsg& reqMsg)
+CreateGroupRspMsg CChatServer::DoCreateGroupReq(CMySqlConnect& util, const CreateGroupReqMsg& reqMsg)
 {
 	CreateGroupRspMsg rspMsg;
 
@@ -1299,7 +2389,7 @@ CreateGroupRspMsg CChatServer::DoCreateGroupReq(const CreateGroupReqMsg& reqMsg)
 		return rspMsg;
 	}
 
-	if (!m_util.IsUserExist(reqMsg.m_strUserId))
+	if (!util.IsUserExist(reqMsg.m_strUserId))
 	{
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_NO_SUCH_USER;
 		return rspMsg;
@@ -1313,7 +2403,7 @@ CreateGroupRspMsg CChatServer::DoCreateGroupReq(const CreateGroupReqMsg& reqMsg)
 		groupBean.m_strF_GROUP_ID = strGroupId;
 		groupBean.m_strF_GROUP_NAME = EncodeUtil::AnsiToUtf8(reqMsg.m_strGroupName);
 
-		if (m_util.InsertGroup(groupBean))
+		if (util.InsertGroup(groupBean))
 		{
 
 		}
@@ -1329,7 +2419,7 @@ CreateGroupRspMsg CChatServer::DoCreateGroupReq(const CreateGroupReqMsg& reqMsg)
 		relationBean.m_eRole = E_GROUP_MEMBER_ROLE::E_ROLE_CREATER;
 		relationBean.m_strF_USER_ID = reqMsg.m_strUserId;
 		relationBean.m_strF_GROUP_ID = strGroupId;
-		if (m_util.InsertGroupRelation(relationBean))
+		if (util.InsertGroupRelation(relationBean))
 		{
 
 		}
@@ -1357,29 +2447,31 @@ CreateGroupRspMsg CChatServer::DoCreateGroupReq(const CreateGroupReqMsg& reqMsg)
 /**
  * @brief 处理群组解散请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 群组解散请求
  * @return DestroyGroupRspMsg 群组解散回复 
  */
-DestroyGroupRspMsg CChatServer::DoDestroyGroupReq(const DestroyGroupReqMsg& reqMsg)
+DestroyGroupRspMsg CChatServer::DoDestroyGroupReq(CMySqlConnect& util, const DestroyGroupReqMsg& reqMsg)
 {
 	DestroyGroupRspMsg rspMsg;
 	T_GROUP_BEAN bean;
 	rspMsg.m_eErrorCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
-	m_util.DeleteGroup(reqMsg.m_strGroupId);
+	util.DeleteGroup(reqMsg.m_strGroupId);
 	return rspMsg;
 }
 
 /**
  * @brief 实际处理查找好友请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 查找好友请求
  * @return FindFriendRspMsg 查找好友回复
  */
-FindFriendRspMsg  CChatServer::DoFindFriendReq(const FindFriendReqMsg& reqMsg) {
+FindFriendRspMsg  CChatServer::DoFindFriendReq(CMySqlConnect& util, const FindFriendReqMsg& reqMsg) {
 	FindFriendRspMsg rspMsg;
 	rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 	T_USER_INFO_BEAN infoBean;
-	if (m_util.SelectUserInfoByName(reqMsg.m_strWantedName, infoBean)) {
+	if (util.SelectUserInfoByName(reqMsg.m_strWantedName, infoBean)) {
 		UserBaseInfo info;
 		{
 			info.m_strUserId = infoBean.m_strF_USER_ID;
@@ -1403,9 +2495,28 @@ FindFriendRspMsg  CChatServer::DoFindFriendReq(const FindFriendReqMsg& reqMsg) {
  * @param regMsg 收到消息的回复
  */
 void CChatServer::HandleFriendChatRecvMsgRsp(const std::shared_ptr<CServerSess>& pSess, const FriendChatRecvTxtRspMsg& regMsg) {
-	m_util.UpdateFriendChatMsgState(regMsg.m_strChatMsgId, "READ");
-	m_clientStateMap[pSess->UserId()] = CLIENT_SESS_STATE::SESS_RECV_MSG_FINISHED;
-	OnUserReceiveMsg(pSess->UserId());
+	//窗口中的消息确认以后继续下发,已确认的消息攒够一批再更新状态
+	std::string strChatMsgId = regMsg.m_strChatMsgId;
+	std::string strUserId = pSess->UserId();
+	auto pSelf = shared_from_this();
+	auto& drainMap = UserShard(strUserId).m_friendMsgDrainMap;
+	auto drainItem = drainMap.find(strUserId);
+	if (drainItem != drainMap.end() && drainItem->second.m_window.OnAck(strChatMsgId))
+	{
+		DrainFriendMsg(strUserId);
+		return;
+	}
+	//不在下发窗口中的消息单独更新
+	PostDbQuery(strUserId, [strChatMsgId](CMySqlConnect& util) {
+		return util.UpdateFriendChatMsgState(strChatMsgId, "READ");
+	}, [this, pSelf, strUserId](const bool /*bUpdate*/) {
+		auto& drainMap = UserShard(strUserId).m_friendMsgDrainMap;
+		if (drainMap.find(strUserId) == drainMap.end())
+		{
+			SetUserState(strUserId, CLIENT_SESS_STATE::SESS_RECV_MSG_FINISHED);
+			OnUserReceiveMsg(strUserId);
+		}
+	});
 }
 
 /**
@@ -1420,9 +2531,9 @@ void CChatServer::HandleFriendSendFileReq(const std::shared_ptr<CServerSess>& pS
 	if(reqMsg.m_transMode == FILE_TRANS_TYPE::UDP_ONLINE_MEDIUM_MODE || 
 	   reqMsg.m_transMode == FILE_TRANS_TYPE::UDP_ONLINE_P2P_MODE )
 	{
-		auto item = m_UserSessVec.find(reqMsg.m_strFriendId);
+		auto item = m_presence.GetSess(reqMsg.m_strFriendId);
 		//接收方在线
-		if (item != m_UserSessVec.end())
+		if (item)
 		{
 
 			{
@@ -1441,7 +2552,7 @@ void CChatServer::HandleFriendSendFileReq(const std::shared_ptr<CServerSess>& pS
 				recvMsg.m_strFriendId = reqMsg.m_strFriendId;
 				recvMsg.m_strFileName = reqMsg.m_strFileName;
 				recvMsg.m_transMode = reqMsg.m_transMode;
-				item->second->SendMsg(&recvMsg);
+				item->SendMsg(&recvMsg);
 				//pSess->SendMsg(&recvMsg);
 			}
 		}
@@ -1479,15 +2590,17 @@ void CChatServer::HandleFriendSendFileReq(const std::shared_ptr<CServerSess>& pS
 			sendReqMsg.m_strUserId = reqMsg.m_strUserId;
 			sendReqMsg.m_strFriendId = reqMsg.m_strFriendId;
 			sendReqMsg.m_strFileName = reqMsg.m_strFileName;
-			sendReqMsg.m_nFileId = rand();
+			sendReqMsg.m_nFileId = CreateFileId();
 			sendReqMsg.m_eOption = E_FRIEND_OPTION::E_AGREE_ADD;
 			sendReqMsg.m_transMode = reqMsg.m_transMode;
 			pSess->SendMsg(&sendReqMsg);
 
 			{
-				std::string strFileName = GetImageDir()+m_fileUtil.GetFileNameFromPath(reqMsg.m_strFileName);
-				m_fileUtil.OpenWriteFile(sendReqMsg.m_nFileId, strFileName);
+				std::string strFileName = UploadFilePath(m_fileUtil.GetFileNameFromPath(reqMsg.m_strFileName));
+				m_fileIo.Open(sendReqMsg.m_nFileId, strFileName, FILE_OPEN_MODE::OPEN_WRITE);
 				m_fileTranModeMap.insert({ sendReqMsg.m_nFileId,reqMsg.m_transMode });
+				//离线文件通过UDP发送,请求中没有文件大小
+				SetFileRecvLimit(sendReqMsg.m_nFileId, FILE_DATA_UDP_CHUNK_SIZE, 0);
 			}
 		}
 
@@ -1517,8 +2630,8 @@ void CChatServer::HandleFriendRecvFileRsp(const FriendRecvFileMsgRspMsg& reqMsg)
 	}
 	//通知文件发送方
 	{
-		auto item = m_UserSessVec.find(reqMsg.m_strUserId);
-		if (item != m_UserSessVec.end())
+		auto item = m_presence.GetSess(reqMsg.m_strUserId);
+		if (item)
 		{
 			FriendNotifyFileMsgReqMsg sendMsg;
 			sendMsg.m_strMsgId = reqMsg.m_strMsgId;
@@ -1527,7 +2640,7 @@ void CChatServer::HandleFriendRecvFileRsp(const FriendRecvFileMsgRspMsg& reqMsg)
 			sendMsg.m_strUserId = reqMsg.m_strFriendId;
 			sendMsg.m_strFileName = reqMsg.m_strFileName;
 			sendMsg.m_nFileId = reqMsg.m_nFileId;
-			item->second->SendMsg(&sendMsg);
+			item->SendMsg(&sendMsg);
 		}
 	}
 	
@@ -1554,125 +2667,179 @@ void CChatServer::HandleFriendNotifyFileRsp(const std::shared_ptr<CServerSess>&
  */
 void CChatServer::NotifyUserFriends(const std::string strUserId)
 {
-	std::vector<std::string> strFriendIdList;
-	if (m_util.GetUserFriendList(strUserId, strFriendIdList))
+	std::vector<FriendEdge_st> edgeVec;
+	bool bCached = false;
 	{
-		for (auto item : strFriendIdList)
+		std::lock_guard<std::mutex> lock(m_friendCacheMutex);
+		bCached = m_friendCache.Get(strUserId, edgeVec);
+	}
+	if (bCached)
+	{
+		NotifyFriendEdges(edgeVec);
+		return;
+	}
+	//缓存中没有时在连接池上查询,查询结果保存到缓存以后再通知
+	auto pSelf = shared_from_this();
+	PostDbQuery(strUserId, [strUserId](CMySqlConnect& util) {
+		return SelectFriendEdges(util, strUserId);
+	}, [this, pSelf, strUserId](const std::vector<FriendEdge_st>& edgeVec) {
 		{
-			auto findItem = m_UserSessVec.find(item);
-			if (findItem != m_UserSessVec.end() && findItem->second->IsConnected())
-			{
-				UpdateFriendListNotifyReqMsg reqMsg;
-				reqMsg.m_strUserId = item;
-				reqMsg.m_strMsgId = std::to_string(m_MsgID_Util.nextId());
-				findItem->second->SendMsg(&reqMsg);
-			}
+			std::lock_guard<std::mutex> lock(m_friendCacheMutex);
+			m_friendCache.Put(strUserId, edgeVec);
 		}
-	}
-	
+		NotifyFriendEdges(edgeVec);
+	});
 }
 
-
 /**
- * @brief 处理获取群组请求
+ * @brief 通知在线的好友更新好友列表
  * 
- * @param pSess 用户会话
- * @param reqMsg 获取用户群组请求
+ * @param edgeVec 用户的好友关系
  */
-void CChatServer::HandleGetGroupListReq(const std::shared_ptr<CServerSess>& pSess, const GetGroupListReqMsg& reqMsg)
+void CChatServer::NotifyFriendEdges(const std::vector<FriendEdge_st>& edgeVec)
 {
-	GetGroupListRspMsg rspMsg = DoGetGroupListReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
+	for (const auto& item : edgeVec)
 	{
-		pSess->SendMsg(&rspMsg);
+		auto findItem = m_presence.GetSess(item.m_strFriendId);
+		if (findItem && findItem->IsConnected())
+		{
+			UpdateFriendListNotifyReqMsg reqMsg;
+			reqMsg.m_strUserId = item.m_strFriendId;
+			reqMsg.m_strMsgId = std::to_string(m_MsgID_Util.nextId());
+			findItem->SendMsg(&reqMsg);
+		}
 	}
 }
 
 /**
- * @brief 处理用户退出群聊请求
+ * @brief 查询用户的好友关系,在连接池的线程上执行
  * 
- * @param pSess 
- * @param reqMsg 
+ * @param util 数据库连接
+ * @param strUserId 用户ID
+ * @return std::vector<FriendEdge_st> 好友关系
  */
-void CChatServer::HandleQuitGroupReqMsg(const std::shared_ptr<CServerSess>& pSess, const QuitFromGroupReqMsg& reqMsg)
+std::vector<FriendEdge_st> CChatServer::SelectFriendEdges(CMySqlConnect& util, const std::string& strUserId)
 {
-	QuitFromGroupRspMsg rspMsg = DoQuitFromGroup(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
+	std::vector<FriendEdge_st> edgeVec;
+	std::vector<T_FRIEND_RELATION_BEAN> friendBeanList;
+	util.GetUserFriendList(strUserId, friendBeanList);
+	for (const auto& item : friendBeanList)
 	{
-		pSess->SendMsg(&rspMsg);
+		edgeVec.push_back(FriendEdge_st{ item.m_strF_FRIEND_ID, item.m_strF_TEAM_ID });
 	}
+	return edgeVec;
 }
 
 /**
- * @brief 执行用户退出群聊请求
+ * @brief 用户的好友关系改变以后删除缓存,下次使用时重新查询
  * 
- * @param reqMsg 用户退出群聊请求 
- * @return QuitFromGroupRspMsg 用户退出群聊回复
+ * @param strUserId 用户ID
  */
-QuitFromGroupRspMsg CChatServer::DoQuitFromGroup(const QuitFromGroupReqMsg& reqMsg)
+void CChatServer::InvalidateFriendCache(const std::string& strUserId)
 {
-	QuitFromGroupRspMsg rspMsg;
-	rspMsg.m_strGroupId = reqMsg.m_strGroupId;
-	rspMsg.m_strUserId = reqMsg.m_strUserId;
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	T_GROUP_RELATION_BEAN bean;
-	bean.m_strF_USER_ID = reqMsg.m_strUserId;
-	bean.m_strF_GROUP_ID = reqMsg.m_strGroupId;
-	if (m_util.DeleteGroupRelation(bean))
-	{
+	std::lock_guard<std::mutex> lock(m_friendCacheMutex);
+	m_friendCache.Invalidate(strUserId);
+}
 
-	}
 
-	return rspMsg;
-}
 /**
- * @brief 处理获取群组列表请求
+ * @brief 处理获取群组请求
  * 
- * @param reqMsg 获取群组列表请求
- * @return GetGroupListRspMsg 获取群组列表回复
+ * @param pSess 用户会话
+ * @param reqMsg 获取用户群组请求
  */
-GetGroupListRspMsg CChatServer::DoGetGroupListReq(const GetGroupListReqMsg& reqMsg)
+void CChatServer::HandleGetGroupListReq(const std::shared_ptr<CServerSess>& pSess, const GetGroupListReqMsg& reqMsg)
 {
-	GetGroupListRspMsg rspMsg;
-	//查找该用户所在的所有群组
-	std::vector<T_GROUP_RELATION_BEAN> userGroups;
-	if (m_util.SelectUserGroupRelation(reqMsg.m_strUserId,userGroups)) {
-		//
-		GroupInfo groupInfo;
-		for (const auto groupIdItem : userGroups)
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserId, [this, reqMsg](CMySqlConnect& util) {
+		return DoGetGroupListReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](GetGroupListRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (pSess)
 		{
-			T_GROUP_BEAN groupBean;
+			pSess->SendMsg(&rspMsg);
+		}
+	});
+}
+
+/**
+ * @brief 处理用户退出群聊请求
+ * 
+ * @param pSess 
+ * @param reqMsg 
+ */
+void CChatServer::HandleQuitGroupReqMsg(const std::shared_ptr<CServerSess>& pSess, const QuitFromGroupReqMsg& reqMsg)
+{
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strGroupId, [this, reqMsg](CMySqlConnect& util) {
+		return DoQuitFromGroup(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](QuitFromGroupRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
+}
+
+/**
+ * @brief 执行用户退出群聊请求
+ * 
+ * @param util 执行操作的数据库连接
+ * @param reqMsg 用户退出群聊请求 
+ * @return QuitFromGroupRspMsg 用户退出群聊回复
+ */
+QuitFromGroupRspMsg CChatServer::DoQuitFromGroup(CMySqlConnect& util, const QuitFromGroupReqMsg& reqMsg)
+{
+	QuitFromGroupRspMsg rspMsg;
+	rspMsg.m_strGroupId = reqMsg.m_strGroupId;
+	rspMsg.m_strUserId = reqMsg.m_strUserId;
+	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+	T_GROUP_RELATION_BEAN bean;
+	bean.m_strF_USER_ID = reqMsg.m_strUserId;
+	bean.m_strF_GROUP_ID = reqMsg.m_strGroupId;
+	if (util.DeleteGroupRelation(bean))
+	{
 
-			if(m_util.SelectGroupById(groupIdItem.m_strF_GROUP_ID,groupBean))
+	}
+
+	return rspMsg;
+}
+/**
+ * @brief 处理获取群组列表请求
+ * 
+ * @param util 执行操作的数据库连接
+ * @param reqMsg 获取群组列表请求
+ * @return GetGroupListRspMsg 获取群组列表回复
+ */
+GetGroupListRspMsg CChatServer::DoGetGroupListReq(CMySqlConnect& util, const GetGroupListReqMsg& reqMsg)
+{
+	GetGroupListRspMsg rspMsg;
+	//用户所在的群组和群组成员一次查询,同一个群组的成员相邻
+	std::vector<T_GROUP_MEMBER_INFO_BEAN> memberList;
+	if (util.SelectUserGroupMemberList(reqMsg.m_strUserId, memberList)) {
+		for (const auto& item : memberList)
+		{
+			if (rspMsg.m_GroupList.empty() || rspMsg.m_GroupList.back().m_strGroupId != item.m_group.m_strF_GROUP_ID)
 			{
-				groupInfo.m_strGroupName = groupBean.m_strF_GROUP_NAME;
-				groupInfo.m_strGroupId = groupIdItem.m_strF_GROUP_ID;
-				std::vector<T_GROUP_RELATION_BEAN> groupUsers;
-				if (m_util.SelectGroupRelation(groupIdItem.m_strF_GROUP_ID, groupUsers))
-				{
-					for (const auto userRelationItem : groupUsers) {
-						T_USER_INFO_BEAN userBean;
-						UserBaseInfo baseInfo;
-						if (m_util.SelectUserInfoByName(userRelationItem.m_strF_USER_ID, userBean)) {
-							{
-								baseInfo.m_strUserName = userBean.m_strF_USER_NAME;
-								baseInfo.m_strAddress = userBean.m_strF_ADDRESS;
-								baseInfo.m_strBirthDate = userBean.m_strF_BIRTH_DATE;
-								baseInfo.m_strEmail = userBean.m_strF_EMAIL_ADDR;
-								baseInfo.m_strFaceId = userBean.m_strF_FACE_ID;
-								baseInfo.m_strNickName = userBean.m_strF_NICK_NAME;
-								baseInfo.m_strSignature = userBean.m_strF_SIGNATURE;
-								baseInfo.m_strUserId = userBean.m_strF_USER_ID;
-							}
-							groupInfo.m_GroupUsers.push_back(baseInfo);
-						}
-					}
-				}
+				GroupInfo groupInfo;
+				groupInfo.m_strGroupId = item.m_group.m_strF_GROUP_ID;
+				groupInfo.m_strGroupName = item.m_group.m_strF_GROUP_NAME;
+				rspMsg.m_GroupList.push_back(groupInfo);
+			}
+			const T_USER_INFO_BEAN& userBean = item.m_userInfo;
+			UserBaseInfo baseInfo;
+			{
+				baseInfo.m_strUserName = userBean.m_strF_USER_NAME;
+				baseInfo.m_strAddress = userBean.m_strF_ADDRESS;
+				baseInfo.m_strBirthDate = userBean.m_strF_BIRTH_DATE;
+				baseInfo.m_strEmail = userBean.m_strF_EMAIL_ADDR;
+				baseInfo.m_strFaceId = userBean.m_strF_FACE_ID;
+				baseInfo.m_strNickName = userBean.m_strF_NICK_NAME;
+				baseInfo.m_strSignature = userBean.m_strF_SIGNATURE;
+				baseInfo.m_strUserId = userBean.m_strF_USER_ID;
 			}
-			rspMsg.m_GroupList.push_back(groupInfo);
-			groupInfo.m_GroupUsers.clear();
+			rspMsg.m_GroupList.back().m_GroupUsers.push_back(baseInfo);
 		}
 	}
 	rspMsg.m_strUserId = reqMsg.m_strUserId;
@@ -1687,14 +2854,17 @@ GetGroupListRspMsg CChatServer::DoGetGroupListReq(const GetGroupListReqMsg& reqM
  * @param reqMsg 添加好友请求
  */
 void CChatServer::HandleAddFriendReq(const std::shared_ptr<CServerSess>& pSess, const AddFriendSendReqMsg& reqMsg) {
-	AddFriendSendRspMsg rspMsg = DoAddFriendReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
-
-	OnAddFriendRecvReqMsg(reqMsg.m_strFriendId);
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserId, [this, reqMsg](CMySqlConnect& util) {
+		return DoAddFriendReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](AddFriendSendRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+		OnAddFriendRecvReqMsg(reqMsg.m_strFriendId);
+	});
 }
 
 /**
@@ -1705,8 +2875,12 @@ void CChatServer::HandleAddFriendReq(const std::shared_ptr<CServerSess>& pSess,
  */
 void CChatServer::HandleAddFriendRecvRsp(const AddFriendRecvRspMsg& rspMsg)
 {
-	T_ADD_FRIEND_MSG_BEAN bean;
-	m_util.UpdateToReadUnNotifyAddFriendMsg(rspMsg.m_strMsgId, rspMsg.m_option);
+	//和通知查询使用同一个key,通知时已经能读到更新以后的结果
+	std::string strMsgId = rspMsg.m_strMsgId;
+	E_FRIEND_OPTION option = rspMsg.m_option;
+	PostDbTask(rspMsg.m_strFriendId, [strMsgId, option](CMySqlConnect& util) {
+		util.UpdateToReadUnNotifyAddFriendMsg(strMsgId, option);
+	});
 	OnAddFriendNotifyReqMsg(rspMsg.m_strFriendId);
 }
 
@@ -1716,33 +2890,38 @@ void CChatServer::HandleAddFriendRecvRsp(const AddFriendRecvRspMsg& rspMsg)
  * @param pSess 用户会话
  * @param rspMsg 添加好友通知回复消息[发起方--->服务器]
  */
-void CChatServer::HandleAddFriendNotifyRsp(const AddFriendNotifyRspMsg& rspMsg)
+void CChatServer::HandleAddFriendNotifyRsp(const std::shared_ptr<CServerSess>& pSess, const AddFriendNotifyRspMsg& rspMsg)
 {
-	m_util.UpdateToNotifyAddFriendMsg(rspMsg.m_strMsgId);
+	//和定时的通知查询使用同一个key,更新以后不会重复通知
+	std::string strMsgId = rspMsg.m_strMsgId;
+	PostDbTask(pSess ? pSess->UserId() : strMsgId, [strMsgId](CMySqlConnect& util) {
+		util.UpdateToNotifyAddFriendMsg(strMsgId);
+	});
 }
 
 /**
  * @brief 实际处理删除好友请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 删除好友请求
  * @return RemoveFriendRspMsg 删除好友回复
  */
-RemoveFriendRspMsg CChatServer::DoRemoveFriendReq(const RemoveFriendReqMsg& reqMsg)
+RemoveFriendRspMsg CChatServer::DoRemoveFriendReq(CMySqlConnect& util, const RemoveFriendReqMsg& reqMsg)
 {
 	RemoveFriendRspMsg rspMsg;
 	rspMsg.m_strUserId = reqMsg.m_strUserId;
 	rspMsg.m_strFriendId = reqMsg.m_strFriendId;
 	rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_NO_SUCH_USER;
 	//正
-	if (m_util.IsFriend(reqMsg.m_strUserId, reqMsg.m_strFriendId))
+	if (util.IsFriend(reqMsg.m_strUserId, reqMsg.m_strFriendId))
 	{
-		m_util.DeleteFriendRelation(reqMsg.m_strUserId, reqMsg.m_strFriendId);
+		util.DeleteFriendRelation(reqMsg.m_strUserId, reqMsg.m_strFriendId);
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 	}
 	//反
-	if (m_util.IsFriend(reqMsg.m_strFriendId, reqMsg.m_strUserId))
+	if (util.IsFriend(reqMsg.m_strFriendId, reqMsg.m_strUserId))
 	{
-		m_util.DeleteFriendRelation(reqMsg.m_strFriendId, reqMsg.m_strUserId);
+		util.DeleteFriendRelation(reqMsg.m_strFriendId, reqMsg.m_strUserId);
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 	}
 
@@ -1757,13 +2936,19 @@ RemoveFriendRspMsg CChatServer::DoRemoveFriendReq(const RemoveFriendReqMsg& reqM
  * @param reqMsg 删除好友的消息
  */
 void CChatServer::HandleRemoveFriendReq(const std::shared_ptr<CServerSess>& pSess, const RemoveFriendReqMsg& reqMsg) {
-	RemoveFriendRspMsg rspMsg = DoRemoveFriendReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserId, [this, reqMsg](CMySqlConnect& util) {
+		return DoRemoveFriendReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](RemoveFriendRspMsg rspMsg) {
+		InvalidateFriendCache(reqMsg.m_strUserId);
+		InvalidateFriendCache(reqMsg.m_strFriendId);
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 }
 
 
@@ -1774,12 +2959,16 @@ void CChatServer::HandleRemoveFriendReq(const std::shared_ptr<CServerSess>& pSes
  * @param reqMsg 增加分组请求
  */
 void CChatServer::HandleAddTeamReq(const std::shared_ptr<CServerSess>& pSess, const AddTeamReqMsg& reqMsg) {
-	AddTeamRspMsg rspMsg = DoAddTeamReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserId, [this, reqMsg](CMySqlConnect& util) {
+		return DoAddTeamReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](AddTeamRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 }
 
 
@@ -1790,12 +2979,18 @@ void CChatServer::HandleAddTeamReq(const std::shared_ptr<CServerSess>& pSess, co
  * @param reqMsg 移动分组请求
  */
 void CChatServer::HandleRemoveTeamReq(const std::shared_ptr<CServerSess>& pSess, const RemoveTeamReqMsg& reqMsg) {
-	RemoveTeamRspMsg rspMsg = DoRemoveTeamReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserId, [this, reqMsg](CMySqlConnect& util) {
+		return DoRemoveTeamReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](RemoveTeamRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		//分组中的好友移动到了默认分组
+		InvalidateFriendCache(reqMsg.m_strUserId);
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 }
 
 /**
@@ -1805,12 +3000,20 @@ void CChatServer::HandleRemoveTeamReq(const std::shared_ptr<CServerSess>& pSess,
  * @param reqMsg 好友移动分组请求
  */
 void CChatServer::HandleMoveFriendToTeamReq(const std::shared_ptr<CServerSess>& pSess, const MoveFriendToTeamReqMsg& reqMsg) {
-	MoveFriendToTeamRspMsg rspMsg = DoMoveFriendToTeamReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserId, [this, reqMsg](CMySqlConnect& util) {
+		return DoMoveFriendToTeamReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](MoveFriendToTeamRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (ERROR_CODE_TYPE::E_CODE_SUCCEED == rspMsg.m_eErrCode)
+		{
+			InvalidateFriendCache(reqMsg.m_strUserId);
+		}
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 }
 
 
@@ -1838,38 +3041,36 @@ void CChatServer::HandleFriendChatRecvMsgReq(const std::shared_ptr<CServerSess>&
  */
 void CChatServer::HandleFindGroupReq(const std::shared_ptr<CServerSess>& pSess, const FindGroupReqMsg& reqMsg)
 {
-	FindGroupRspMsg rspMsg = DoFindGroupReq(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strUserId, [this, reqMsg](CMySqlConnect& util) {
+		return DoFindGroupReq(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](FindGroupRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 }
 
 /**
  * @brief 实际处理用户发送文本消息的请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 用户发送文本消息
+ * @param chatMsg 需要保存的聊天消息
  * @return FriendChatSendTxtRspMsg 用户发送文本消息的回复
  */
-FriendChatSendTxtRspMsg CChatServer::DoFriendChatSendTxtReq(const FriendChatSendTxtReqMsg& reqMsg)
+FriendChatSendTxtRspMsg CChatServer::DoFriendChatSendTxtReq(CMySqlConnect& util, const FriendChatSendTxtReqMsg& reqMsg, const T_USER_CHAT_MSG& chatMsg)
 {
 	FriendChatSendTxtRspMsg rspMsg; 
-	if (m_util.IsUserExist(reqMsg.m_strSenderId) && m_util.IsUserExist(reqMsg.m_strSenderId))
-	{
-		T_USER_CHAT_MSG  msg;
-		msg.m_strF_MSG_ID = std::to_string(m_MsgID_Util.nextId());
-		msg.m_strF_FROM_ID = reqMsg.m_strSenderId;
-		msg.m_strF_TO_ID = reqMsg.m_strReceiverId;
-		msg.m_eChatMsgType = CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE;
-		msg.m_strF_MSG_CONTEXT = reqMsg.m_strContext;
-		msg.m_strF_OTHER_INFO = reqMsg.m_fontInfo.ToString();
-		msg.m_strF_CREATE_TIME = CTimeUtil::GetYMD_HMS_Time();
-		m_util.InsertFriendChatMsg(msg);
+	if (util.IsUserExist(reqMsg.m_strSenderId) && util.IsUserExist(reqMsg.m_strSenderId))
+	{
+		util.InsertFriendChatMsg(chatMsg);
 		
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-		rspMsg.m_chatMsg = DbBeanToMsgBean(msg);
+		rspMsg.m_chatMsg = DbBeanToMsgBean(chatMsg);
 		rspMsg.m_strErrMsg = "Succeed";
 	}
 	else
@@ -1883,13 +3084,14 @@ FriendChatSendTxtRspMsg CChatServer::DoFriendChatSendTxtReq(const FriendChatSend
 /**
  * @brief 处理用户登陆请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 用户登陆请求
  * @return UserLoginRspMsg 用户登陆回复
  */
-UserLoginRspMsg CChatServer::DoUserLoginReq(const UserLoginReqMsg& reqMsg) {
+UserLoginRspMsg CChatServer::DoUserLoginReq(CMySqlConnect& util, const UserLoginReqMsg& reqMsg) {
 	UserLoginRspMsg rsp;
 	T_USER_BEAN userBean;
-	m_util.SelectUserByName(reqMsg.m_strUserName, userBean);
+	util.SelectUserByName(reqMsg.m_strUserName, userBean);
 	if (VerifyPassword(reqMsg.m_strPassword,userBean.m_strF_PASS_WORD))
 	{
 		rsp.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
@@ -1897,7 +3099,7 @@ UserLoginRspMsg CChatServer::DoUserLoginReq(const UserLoginReqMsg& reqMsg) {
 		rsp.m_strUserName = reqMsg.m_strUserName;
 
 		T_USER_INFO_BEAN infoBean;
-		m_util.SelectUserInfoByName(reqMsg.m_strUserName, infoBean);
+		util.SelectUserInfoByName(reqMsg.m_strUserName, infoBean);
 		{
 			rsp.m_userInfo.m_strUserId = infoBean.m_strF_USER_ID;
 			rsp.m_userInfo.m_strUserName = infoBean.m_strF_USER_NAME;
@@ -1909,7 +3111,6 @@ UserLoginRspMsg CChatServer::DoUserLoginReq(const UserLoginReqMsg& reqMsg) {
 			rsp.m_userInfo.m_strSignature = infoBean.m_strF_SIGNATURE;
 		}
 		rsp.m_strUserId = infoBean.m_strF_USER_ID;
-		m_util.UpdateUserOnlineState(userBean.m_strF_USER_ID, CLIENT_STATE::C_STATE_ONLINE);
 		return rsp;
 	}
 	else
@@ -1932,15 +3133,16 @@ std::string CChatServer::GenerateUserId() {
 /**
  * @brief 实际处理用户的注册请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 用户的注册请求
  * @return UserRegisterRspMsg 用户注册的回复
  */
-UserRegisterRspMsg CChatServer::DoUserRegisterReq(const UserRegisterReqMsg& reqMsg) {
+UserRegisterRspMsg CChatServer::DoUserRegisterReq(CMySqlConnect& util, const UserRegisterReqMsg& reqMsg) {
 	
 	UserRegisterRspMsg rsp;
 
 	T_USER_BEAN userBean;
-	if (m_util.SelectUserByName(reqMsg.m_strUserName, userBean))
+	if (util.SelectUserByName(reqMsg.m_strUserName, userBean))
 	{
 		rsp.m_eErrCode = ERROR_CODE_TYPE::E_CODE_USER_HAS_EXIST;
 		rsp.m_strErrMsg = "Failed";
@@ -1954,7 +3156,7 @@ UserRegisterRspMsg CChatServer::DoUserRegisterReq(const UserRegisterReqMsg& reqM
 		newUser.m_strF_USER_NAME = reqMsg.m_strUserName;
 		newUser.m_strF_PASS_WORD = GeneratePassword(reqMsg.m_strPassword);
 		newUser.m_strF_NICK_NAME = reqMsg.m_strNickName;
-		if (m_util.InsertUser(newUser))
+		if (util.InsertUser(newUser))
 		{
 			rsp.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 			rsp.m_strErrMsg = "Succeed";
@@ -1964,7 +3166,7 @@ UserRegisterRspMsg CChatServer::DoUserRegisterReq(const UserRegisterReqMsg& reqM
 			teamBean.m_strF_TEAM_ID = DEFAULT_TEAM_ID;
 			teamBean.m_strF_TEAM_NAME = DEFAULT_TEAM_NAME;
 			teamBean.m_strF_USER_ID = newUser.m_strF_USER_ID;
-			m_util.InsertUserTeam(teamBean);
+			util.InsertUserTeam(teamBean);
 		}
 		else
 		{
@@ -1980,13 +3182,14 @@ UserRegisterRspMsg CChatServer::DoUserRegisterReq(const UserRegisterReqMsg& reqM
 /**
  * @brief 处理用户注销请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 用户注销请求
  * @return UserUnRegisterRspMsg 用户注销回复 
  */
-UserUnRegisterRspMsg CChatServer::DoUserUnRegisterReq(const UserUnRegisterReqMsg& reqMsg) {
+UserUnRegisterRspMsg CChatServer::DoUserUnRegisterReq(CMySqlConnect& util, const UserUnRegisterReqMsg& reqMsg) {
 	UserUnRegisterRspMsg rspMsg;
 	T_USER_BEAN userBean;
-	m_util.SelectUserByName(reqMsg.m_strUserName, userBean);
+	util.SelectUserByName(reqMsg.m_strUserName, userBean);
 	if (userBean.m_strF_PASS_WORD.empty())
 	{
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_NO_SUCH_USER;
@@ -1997,7 +3200,7 @@ UserUnRegisterRspMsg CChatServer::DoUserUnRegisterReq(const UserUnRegisterReqMsg
 		if (userBean.m_strF_USER_NAME == reqMsg.m_strUserName && VerifyPassword(reqMsg.m_strPassword,userBean.m_strF_PASS_WORD))
 		{
 			T_USER_BEAN newUser;
-			m_util.DeleteUser(userBean.m_strF_USER_ID);
+			util.DeleteUser(userBean.m_strF_USER_ID);
 
 			rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 			rspMsg.m_strErrMsg = "Succeed";
@@ -2017,27 +3220,23 @@ UserUnRegisterRspMsg CChatServer::DoUserUnRegisterReq(const UserUnRegisterReqMsg
 
 
 /**
- * @brief 处理用户获取好友列表请求
+ * @brief 根据连接池上的查询结果生成获取好友列表的回复,并刷新好友关系缓存
  * 
  * @param req 获取好友列表请求
+ * @param query 查询到的分组和好友资料
  * @return GetFriendListRspMsg 获取好友列表回复
  */
-GetFriendListRspMsg CChatServer::DoGetFriendReq(const GetFriendListReqMsg& req) {
-	std::vector<std::string> strFriendIdList;
-	std::vector<T_FRIEND_RELATION_BEAN> friendBeanList;
-	std::vector<T_USER_TEAM_BEAN> teamBeanList;
+GetFriendListRspMsg CChatServer::DoGetFriendReq(const GetFriendListReqMsg& req, const FriendListQuery_st& query) {
+	const std::vector<T_FRIEND_INFO_BEAN>& friendBeanList = query.m_friendVec;
+	const std::vector<T_USER_TEAM_BEAN>& teamBeanList = query.m_teamVec;
 	GetFriendListRspMsg rspMsg;
 	rspMsg.m_strUserId = req.m_strUserId;
-	if (m_util.SelectUserTeams(req.m_strUserId, teamBeanList))
+	if (query.m_bHasTeam)
 	{
 		rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 		rspMsg.m_strErrMsg = ErrMsg(rspMsg.m_errCode);
-		if (m_util.GetUserFriendList(req.m_strUserId, friendBeanList))
-		{
-			
-		}
 			std::map<std::string,TeamBaseInfo> teamIdTeamMap;
-			for (const auto teamItem : teamBeanList)
+			for (const auto& teamItem : teamBeanList)
 			{
 				TeamBaseInfo teamInfo;
 				teamInfo.m_strTeamId = teamItem.m_strF_TEAM_ID;
@@ -2046,41 +3245,53 @@ GetFriendListRspMsg CChatServer::DoGetFriendReq(const GetFriendListReqMsg& req)
 			}
 			{	
 				UserBaseInfo info;
+				std::vector<FriendEdge_st> edgeVec;
 				for (const auto& friendItem : friendBeanList) {
-					T_USER_INFO_BEAN bean;
-					if (m_util.SelectUserInfoByName(friendItem.m_strF_FRIEND_ID, bean)) {
+					const T_USER_INFO_BEAN& bean = friendItem.m_userInfo;
+					const std::string& strTeamId = friendItem.m_relation.m_strF_TEAM_ID;
+					edgeVec.push_back(FriendEdge_st{ bean.m_strF_USER_ID, strTeamId });
+					{
+						info.m_strUserId = bean.m_strF_USER_ID;
+						info.m_strAddress = bean.m_strF_ADDRESS;
+						info.m_strBirthDate = bean.m_strF_BIRTH_DATE;
+						info.m_strEmail = bean.m_strF_EMAIL_ADDR;
+						info.m_strNickName = bean.m_strF_NICK_NAME;
+						info.m_strSignature = bean.m_strF_SIGNATURE;
+						info.m_strFaceId = bean.m_strF_FACE_ID;
+						info.m_strUserName = bean.m_strF_USER_NAME;
+						//数据库中的状态是批量写入的,是否在线以内存中的会话为准
+						auto pFriendSess = m_presence.GetSess(bean.m_strF_USER_ID);
+						if (pFriendSess && pFriendSess->IsConnected())
+						{
+							info.m_eOnlineState = CLIENT_STATE::C_STATE_ONLINE;
+						}
+						else
 						{
-							info.m_strUserId = bean.m_strF_USER_ID;
-							info.m_strAddress = bean.m_strF_ADDRESS;
-							info.m_strBirthDate = bean.m_strF_BIRTH_DATE;
-							info.m_strEmail = bean.m_strF_EMAIL_ADDR;
-							info.m_strNickName = bean.m_strF_NICK_NAME;
-							info.m_strSignature = bean.m_strF_SIGNATURE;
-							info.m_strFaceId = bean.m_strF_FACE_ID;
-							info.m_strUserName = bean.m_strF_USER_NAME;
-							info.m_eOnlineState = bean.m_eOnlineState;
+							info.m_eOnlineState = (CLIENT_STATE::C_STATE_ONLINE == bean.m_eOnlineState) ? CLIENT_STATE::C_STATE_OFFLINE : bean.m_eOnlineState;
 						}
+					}
+					{
+						auto item = teamIdTeamMap.find(strTeamId);
+						if (item != teamIdTeamMap.end())
+						{
+							item->second.m_teamUsers.push_back(info);
+						}
+						else
 						{
-							auto item = teamIdTeamMap.find(friendItem.m_strF_TEAM_ID);
-							if (item != teamIdTeamMap.end())
-							{
-								item->second.m_teamUsers.push_back(info);
-							}
-							else
-							{
-								TeamBaseInfo teamInfo;
-								teamInfo.m_strTeamId = DEFAULT_TEAM_ID;
-								teamInfo.m_strTeamName = DEFAULT_TEAM_NAME;
-								teamInfo.m_teamUsers.push_back(info);
-								teamIdTeamMap.insert({ friendItem.m_strF_TEAM_ID,teamInfo });
-							}
+							TeamBaseInfo teamInfo;
+							teamInfo.m_strTeamId = DEFAULT_TEAM_ID;
+							teamInfo.m_strTeamName = DEFAULT_TEAM_NAME;
+							teamInfo.m_teamUsers.push_back(info);
+							teamIdTeamMap.insert({ strTeamId,teamInfo });
 						}
 					}
-					//rspMsg.m_friendInfoVec.push_back(info);
 				}
+				//顺便刷新好友关系缓存,用户上下线通知好友时使用
+				std::lock_guard<std::mutex> lock(m_friendCacheMutex);
+				m_friendCache.Put(req.m_strUserId, std::move(edgeVec));
 			}
 
-			for (const auto item : teamIdTeamMap)
+			for (const auto& item : teamIdTeamMap)
 			{
 				rspMsg.m_teamVec.push_back(item.second);
 			}
@@ -2097,13 +3308,14 @@ GetFriendListRspMsg CChatServer::DoGetFriendReq(const GetFriendListReqMsg& req)
 /**
  * @brief 处理用户退出登陆请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 退出登陆请求
  * @return UserLogoutRspMsg 退出登陆回复
  */
-UserLogoutRspMsg CChatServer::DoUserLogoutReq(const UserLogoutReqMsg& reqMsg) {
+UserLogoutRspMsg CChatServer::DoUserLogoutReq(CMySqlConnect& util, const UserLogoutReqMsg& reqMsg) {
 	T_USER_BEAN bean;
 	UserLogoutRspMsg rspMsg;
-	if (m_util.SelectUserByName(reqMsg.m_strUserName, bean)) {
+	if (util.SelectUserByName(reqMsg.m_strUserName, bean)) {
 		if (VerifyPassword(reqMsg.m_strPassword,bean.m_strF_PASS_WORD)) {
 			rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 			rspMsg.m_strUserName = reqMsg.m_strUserName;
@@ -2117,10 +3329,11 @@ UserLogoutRspMsg CChatServer::DoUserLogoutReq(const UserLogoutReqMsg& reqMsg) {
 /**
  * @brief 处理添加好友请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 添加好友请求
  * @return AddFriendSendRspMsg 添加好友回复
  */
-AddFriendSendRspMsg CChatServer::DoAddFriendReq(const AddFriendSendReqMsg& reqMsg) {
+AddFriendSendRspMsg CChatServer::DoAddFriendReq(CMySqlConnect& util, const AddFriendSendReqMsg& reqMsg) {
 	AddFriendSendRspMsg rspMsg;
 	rspMsg.m_strUserId = reqMsg.m_strUserId;
 	rspMsg.m_strFriendId = reqMsg.m_strFriendId;
@@ -2128,7 +3341,7 @@ AddFriendSendRspMsg CChatServer::DoAddFriendReq(const AddFriendSendReqMsg& reqMs
 	{
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_ADD_SELF_AS_FRIEND;
 	}
-	else if (m_util.IsFriend(reqMsg.m_strUserId,reqMsg.m_strFriendId))
+	else if (util.IsFriend(reqMsg.m_strUserId,reqMsg.m_strFriendId))
 	{
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 		rspMsg.m_strErrMsg = "Succeed";
@@ -2141,7 +3354,7 @@ AddFriendSendRspMsg CChatServer::DoAddFriendReq(const AddFriendSendReqMsg& reqMs
 		msgBean.m_strF_FRIEND_ID = reqMsg.m_strFriendId;
 		msgBean.m_eF_FRIEND_OPTION = E_FRIEND_OPTION::E_UN_KNOWN;
 		msgBean.m_eF_ADD_FRIEND_STATUS = E_ADD_FRIEND_STATUS::E_UN_READ;
-		m_util.InsertAddFriendMsg(msgBean);
+		util.InsertAddFriendMsg(msgBean);
 
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 		rspMsg.m_strErrMsg = "Succeed";
@@ -2153,68 +3366,74 @@ AddFriendSendRspMsg CChatServer::DoAddFriendReq(const AddFriendSendReqMsg& reqMs
 /**
  * @brief 响应好友添加的结果通知消息，
  * 
+ * 查询消息和插入好友关系在连接池上执行,通知和删除好友关系缓存在业务strand上执行
  * @param strUser 添加好友的发起方用户名
- * @return true 成功
- * @return false 失败
  */
-bool CChatServer::OnAddFriendNotifyReqMsg(const std::string strUser)
+void CChatServer::OnAddFriendNotifyReqMsg(const std::string strUser)
 {
-	T_ADD_FRIEND_MSG_BEAN msgBean;
-	if (m_util.SelectUnNotifyAddFriendMsg(strUser, msgBean))
-	{
+	auto pSelf = shared_from_this();
+	PostDbQuery(strUser, [strUser](CMySqlConnect& util) {
+		AddFriendNotifyQuery_st query;
+		query.m_bHasMsg = util.SelectUnNotifyAddFriendMsg(strUser, query.m_msgBean);
+		if (!query.m_bHasMsg)
 		{
-			AddFriendNotifyReqMsg reqMsg;
-
-			reqMsg.m_strMsgId = msgBean.m_strF_MSG_ID;
-			reqMsg.m_strUserId = strUser;
-			reqMsg.m_strFriendId = msgBean.m_strF_FRIEND_ID;
-
-			reqMsg.m_option = msgBean.m_eF_FRIEND_OPTION;
-			if ((!m_util.IsFriend(reqMsg.m_strUserId, reqMsg.m_strFriendId))||
-				(!m_util.IsFriend(reqMsg.m_strFriendId, reqMsg.m_strUserId) ))
+			return query;
+		}
+		const std::string& strFriendId = query.m_msgBean.m_strF_FRIEND_ID;
+		query.m_bNotFriend = (!util.IsFriend(strUser, strFriendId)) || (!util.IsFriend(strFriendId, strUser));
+		if (query.m_bNotFriend && E_FRIEND_OPTION::E_AGREE_ADD == query.m_msgBean.m_eF_FRIEND_OPTION)
+		{
+			T_FRIEND_RELATION_BEAN bean;
+			bean.m_eF_STATUS = E_FRIEND_RELATION::E_FRIEND_TYPE;
+			bean.m_strF_TEAM_ID = DEFAULT_TEAM_ID;
+
+			bean.m_strF_USER_ID = strUser;
+			bean.m_strF_FRIEND_ID = strFriendId;
+			util.InsertFriendRelation(bean);
+
+			bean.m_strF_FRIEND_ID = strUser;
+			bean.m_strF_USER_ID = strFriendId;
+			util.InsertFriendRelation(bean);
+			query.m_bAddRelation = true;
+		}
+		return query;
+	}, [this, pSelf, strUser](const AddFriendNotifyQuery_st& query) {
+		if (!query.m_bHasMsg || !query.m_bNotFriend)
+		{
+			return;
+		}
+		AddFriendNotifyReqMsg reqMsg;
+		reqMsg.m_strMsgId = query.m_msgBean.m_strF_MSG_ID;
+		reqMsg.m_strUserId = strUser;
+		reqMsg.m_strFriendId = query.m_msgBean.m_strF_FRIEND_ID;
+		reqMsg.m_option = query.m_msgBean.m_eF_FRIEND_OPTION;
+		{
+			auto item = m_presence.GetSess(strUser);
+			if (item && item->IsConnected())
 			{
-				{
-					auto item = m_UserSessVec.find(strUser);
-					if (item != m_UserSessVec.end() && item->second->IsConnected())
-					{
-						item->second->SendMsg(&reqMsg);
-					}
-				}
-				if (E_FRIEND_OPTION::E_AGREE_ADD == reqMsg.m_option)
-				{
-					T_FRIEND_RELATION_BEAN bean;
-					bean.m_eF_STATUS = E_FRIEND_RELATION::E_FRIEND_TYPE;
-					bean.m_strF_TEAM_ID = DEFAULT_TEAM_ID;
-					
-					bean.m_strF_USER_ID = reqMsg.m_strUserId;
-					bean.m_strF_FRIEND_ID = reqMsg.m_strFriendId;
-					m_util.InsertFriendRelation(bean);
-					
-					bean.m_strF_FRIEND_ID = reqMsg.m_strUserId;
-					bean.m_strF_USER_ID = reqMsg.m_strFriendId;
-					m_util.InsertFriendRelation(bean);
-				}
-				else
-				{
-					LOG_INFO(ms_loger, "{}  {} Not Friend [ {}  {} ]", reqMsg.m_strUserId, reqMsg.m_strFriendId, __FILENAME__, __LINE__);
-				}
+				item->SendMsg(&reqMsg);
 			}
 		}
-		
-		return true;
-	}
-	else {
-		return false;
-	}
+		if (query.m_bAddRelation)
+		{
+			InvalidateFriendCache(reqMsg.m_strUserId);
+			InvalidateFriendCache(reqMsg.m_strFriendId);
+		}
+		else
+		{
+			LOG_INFO(ms_loger, "{}  {} Not Friend [ {}  {} ]", reqMsg.m_strUserId, reqMsg.m_strFriendId, __FILENAME__, __LINE__);
+		}
+	});
 }
 
 /**
  * @brief 处理增加好友分组请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg　 增加好友分组请求
  * @return AddTeamRspMsg 增加好友分组回复
  */
-AddTeamRspMsg CChatServer::DoAddTeamReq(const AddTeamReqMsg& reqMsg) {
+AddTeamRspMsg CChatServer::DoAddTeamReq(CMySqlConnect& util, const AddTeamReqMsg& reqMsg) {
 	AddTeamRspMsg rspMsg;
 
 	T_USER_TEAM_BEAN teamBean;
@@ -2222,7 +3441,7 @@ AddTeamRspMsg CChatServer::DoAddTeamReq(const AddTeamReqMsg& reqMsg) {
 	teamBean.m_strF_USER_ID = reqMsg.m_strUserId;
 	teamBean.m_strF_TEAM_NAME = reqMsg.m_strTeamName;
 	
-	if (m_util.InsertUserTeam(teamBean)) {
+	if (util.InsertUserTeam(teamBean)) {
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 		rspMsg.m_strErrMsg = "Succeed";
 		rspMsg.m_strTeamId = teamBean.m_strF_TEAM_ID;
@@ -2240,16 +3459,17 @@ AddTeamRspMsg CChatServer::DoAddTeamReq(const AddTeamReqMsg& reqMsg) {
 /**
  * @brief 处理删除分组请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 删除分组请求
  * @return RemoveTeamRspMsg 删除分组回复
  */
-RemoveTeamRspMsg CChatServer::DoRemoveTeamReq(const RemoveTeamReqMsg& reqMsg) {
+RemoveTeamRspMsg CChatServer::DoRemoveTeamReq(CMySqlConnect& util, const RemoveTeamReqMsg& reqMsg) {
 	RemoveTeamRspMsg rspMsg;
 	T_USER_TEAM_BEAN teamBean;
 	teamBean.m_strF_TEAM_ID = reqMsg.m_strTeamId;
 	teamBean.m_strF_USER_ID = reqMsg.m_strUserId;
 
-	if (m_util.DeleteUserTeam(teamBean)) {
+	if (util.DeleteUserTeam(teamBean)) {
 		rspMsg.m_eErrorCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 		rspMsg.m_strErrMsg = "Succeed";
 		rspMsg.m_strTeamId = reqMsg.m_strTeamId;
@@ -2261,11 +3481,7 @@ RemoveTeamRspMsg CChatServer::DoRemoveTeamReq(const RemoveTeamReqMsg& reqMsg) {
 	}
 
 	{
-		if (m_util.UpdateFriendTeamId(reqMsg.m_strUserId, reqMsg.m_strTeamId, DEFAULT_TEAM_ID))
-		{
-
-		}
-		else
+		if (!util.UpdateFriendTeamId(reqMsg.m_strUserId, reqMsg.m_strTeamId, DEFAULT_TEAM_ID))
 		{
 			LOG_ERR(ms_loger, "Update Friend Team Id Failed User:{} OldTeam:{} NewTeam:{} [{} {}]", reqMsg.m_strUserId, reqMsg.m_strTeamId, DEFAULT_TEAM_ID, __FILENAME__, __LINE__);
 		}
@@ -2276,16 +3492,17 @@ RemoveTeamRspMsg CChatServer::DoRemoveTeamReq(const RemoveTeamReqMsg& reqMsg) {
 /**
  * @brief 处理好友移动分组请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 好友移动分组请求
  * @return MoveFriendToTeamRspMsg 好友移动分组回复
  */
-MoveFriendToTeamRspMsg CChatServer::DoMoveFriendToTeamReq(const MoveFriendToTeamReqMsg& reqMsg) {
+MoveFriendToTeamRspMsg CChatServer::DoMoveFriendToTeamReq(CMySqlConnect& util, const MoveFriendToTeamReqMsg& reqMsg) {
 	MoveFriendToTeamRspMsg rspMsg;
 	T_FRIEND_RELATION_BEAN bean;
 	bean.m_strF_USER_ID = reqMsg.m_strUserId;
 	bean.m_strF_FRIEND_ID = reqMsg.m_strFriendId;
 	bean.m_strF_TEAM_ID = reqMsg.m_strDstTeamId;
-	if (m_util.UpdateFriendRelation(bean))
+	if (util.UpdateFriendRelation(bean))
 	{
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 	}
@@ -2300,13 +3517,14 @@ MoveFriendToTeamRspMsg CChatServer::DoMoveFriendToTeamReq(const MoveFriendToTeam
 /**
  * @brief 处理查找群组请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 查找群组请求
  * @return FindGroupRspMsg 查找群组回复
  */
-FindGroupRspMsg CChatServer::DoFindGroupReq(const FindGroupReqMsg& reqMsg) {
+FindGroupRspMsg CChatServer::DoFindGroupReq(CMySqlConnect& util, const FindGroupReqMsg& reqMsg) {
 	FindGroupRspMsg rspMsg;
 	std::vector<T_GROUP_BEAN> groupBeans;
-	if (m_util.SelectGroups(reqMsg.m_strGroupName, groupBeans)) {
+	if (util.SelectGroups(reqMsg.m_strGroupName, groupBeans)) {
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 		rspMsg.m_strGroupId = groupBeans[0].m_strF_GROUP_ID;
 		rspMsg.m_strGroupName = groupBeans[0].m_strF_GROUP_NAME;
@@ -2322,71 +3540,145 @@ FindGroupRspMsg CChatServer::DoFindGroupReq(const FindGroupReqMsg& reqMsg) {
 /**
  * @brief 处理用户登录以后，下发没有收到的群消息
  * 
+ * 用户所在的群组在连接池上查询,查询期间用户下线时不再下发
  * @param strUser 用户名
- * @return true 成功
- * @return false 失败
  */
-bool CChatServer::OnUserRecvGroupMsg(const std::string strUser)
+void CChatServer::OnUserRecvGroupMsg(const std::string strUser)
 {
-	auto item = m_UserSessVec.find(strUser);
-	if (item != m_UserSessVec.end())
+	auto& strand = UserShard(strUser).m_strand;
+	if (!strand.running_in_this_thread())
+	{
+		auto pSelf = shared_from_this();
+		strand.post([this, pSelf, strUser]() {
+			OnUserRecvGroupMsg(strUser);
+		});
+		return;
+	}
+	auto pSess = m_presence.GetSess(strUser);
+	if (!pSess)
 	{
-		auto pSess = item->second;
+		return;
+	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(strUser, [strUser](CMySqlConnect& util) {
 		std::vector<T_GROUP_RELATION_BEAN> userGroups;
-		if (m_util.SelectUserGroupRelation(strUser, userGroups)) {
-			for (auto item : userGroups) {
-				NotifyUserRecvGroupMsg(pSess, item.m_strF_GROUP_ID);
-			}
+		if (!util.SelectUserGroupRelation(strUser, userGroups))
+		{
+			userGroups.clear();
 		}
-	}
-	return false;
+		return userGroups;
+	}, [this, pSelf, pSess, strUser](const std::vector<T_GROUP_RELATION_BEAN>& userGroups) {
+		if (m_presence.GetSess(strUser) != pSess)
+		{
+			return;
+		}
+		for (const auto& item : userGroups) {
+			NotifyUserRecvGroupMsg(pSess, item.m_strF_GROUP_ID);
+		}
+	});
 }
-CLIENT_SESS_STATE CChatServer::GetGroupUserState(const UserIdGroupId_st& keyValue)
+CLIENT_SESS_STATE CChatServer::GetGroupUserState(const std::string& strUserId, const std::string& strGroupId)
 {
-	auto item = m_groupStateMap.find(keyValue);
-	if (item != m_groupStateMap.end())
+	UserPresence_st* pUser = m_presence.Find(strUserId);
+	GroupPresence_st* pGroup = (nullptr == pUser) ? nullptr : pUser->FindGroup(strGroupId);
+	if (nullptr != pGroup)
 	{
-		return item->second;
+		return pGroup->m_eState;
 	}
 	else
 	{
 		return CLIENT_SESS_STATE::SESS_IDLE_STATE;
 	}
 }
-void CChatServer::RemoveGroupUserState(const UserIdGroupId_st& keyValue)
-{
-	m_groupStateMap.erase(keyValue);
-}
 void CChatServer::RemoveUserAllGroupState(const std::string strUserId)
 {
-	std::vector<T_GROUP_RELATION_BEAN> userGroups;
-	if (m_util.SelectUserGroupRelation(strUserId, userGroups)) {
-		UserIdGroupId_st keyValue;
-		for (auto item : userGroups) {
-			keyValue.m_strUserId = strUserId;
-			keyValue.m_strGroupId = item.m_strF_GROUP_ID;
-			RemoveGroupUserState(keyValue);
-		}
+	UserPresence_st* pUser = m_presence.Find(strUserId);
+	if (nullptr != pUser)
+	{
+		pUser->m_groupVec.clear();
+		m_presence.Release(strUserId);
 	}
 }
 
-bool CChatServer::SetGroupUserState(const UserIdGroupId_st& keyValue, const CLIENT_SESS_STATE& state)
+/**
+ * @brief 设置用户在群组中的消息下发状态,空闲并且没有等待回复的一批消息时不再保存
+ * 
+ */
+bool CChatServer::SetGroupUserState(const std::string& strUserId, const std::string& strGroupId, const CLIENT_SESS_STATE& state)
 {
-	m_groupStateMap.erase(keyValue);
-	m_groupStateMap.insert({ keyValue, state });
+	if (CLIENT_SESS_STATE::SESS_IDLE_STATE != state)
+	{
+		m_presence.Insert(strUserId).InsertGroup(strGroupId).m_eState = state;
+		return true;
+	}
+	UserPresence_st* pUser = m_presence.Find(strUserId);
+	GroupPresence_st* pGroup = (nullptr == pUser) ? nullptr : pUser->FindGroup(strGroupId);
+	if (nullptr == pGroup)
+	{
+		return true;
+	}
+	pGroup->m_eState = state;
+	if (!pGroup->m_bBatchPending)
+	{
+		pUser->RemoveGroup(strGroupId);
+		m_presence.Release(strUserId);
+	}
 	return true;
 }
+
+/**
+ * @brief 设置用户的好友消息下发状态,用户不在线时不设置
+ * 
+ */
+void CChatServer::SetUserState(const std::string& strUserId, const CLIENT_SESS_STATE state)
+{
+	UserPresence_st* pUser = m_presence.Find(strUserId);
+	if (nullptr != pUser)
+	{
+		pUser->m_eState = state;
+	}
+}
 /**
  * @brief 处理群聊文本消息
  * 
  * @param pSess 用户会话
  * @param reqMsg 群聊文本消息
  */
-void CChatServer::HandleSendGroupTextReq(const std::shared_ptr<CServerSess>& pSess, const SendGroupTextMsgReqMsg& reqMsg)
+void CChatServer::HandleSendGroupTextReq(const std::shared_ptr<CServerSess>& /*pSess*/, const SendGroupTextMsgReqMsg& reqMsg)
 {
-	SendGroupTextMsgRspMsg rspMsg = DoSendGroupTextMsgReqMsg(reqMsg);
+	T_GROUP_CHAT_MSG chatMsg;
+	chatMsg.m_strF_GROUP_ID = reqMsg.m_chatMsg.m_strGroupId;
+	chatMsg.m_strF_SENDER_ID = reqMsg.m_chatMsg.m_strSenderId;
+	chatMsg.m_strF_MSG_CONTEXT = reqMsg.m_chatMsg.m_strContext;
+	chatMsg.m_strF_MSG_ID = std::to_string(m_MsgID_Util.nextId());
+	chatMsg.m_eChatMsgType = CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE;
+	chatMsg.m_strF_OTHER_INFO = reqMsg.m_chatMsg.m_fontInfo.ToString();
+	chatMsg.m_strF_CREATE_TIME = CTimeUtil::GetYMD_HMS_Time();
+
+	//写入日志以后批量入库,入库以后再通知群成员
+	if (AppendJournal(chatMsg))
+	{
+		ScheduleJournalFlush();
+		return;
+	}
 
-	OnDispatchGroupMsg(reqMsg.m_chatMsg.m_strGroupId);
+	//消息入库和查询群成员在同一个连接上完成,同一个群的消息按顺序入库
+	std::string strGroupId = reqMsg.m_chatMsg.m_strGroupId;
+	auto pSelf = shared_from_this();
+	PostDbQuery(strGroupId, [this, reqMsg, chatMsg, strGroupId](CMySqlConnect& util) {
+		bool bInsert = (ERROR_CODE_TYPE::E_CODE_SUCCEED == DoSendGroupTextMsgReqMsg(util, reqMsg, chatMsg).m_eErrCode);
+		std::vector<T_GROUP_RELATION_BEAN> groupUsers;
+		util.SelectGroupRelation(strGroupId, groupUsers);
+		return std::make_pair(bInsert, groupUsers);
+	}, [this, pSelf, strGroupId, chatMsg](const std::pair<bool, std::vector<T_GROUP_RELATION_BEAN>>& result) {
+		//入库成功的消息才放入缓存,在线成员从缓存读取
+		if (result.first)
+		{
+			std::lock_guard<std::mutex> lock(m_groupMsgCacheMutex);
+			m_groupMsgCache.Append(chatMsg);
+		}
+		OnDispatchGroupMsg(strGroupId, result.second);
+	});
 }
 
 /**
@@ -2397,12 +3689,16 @@ void CChatServer::HandleSendGroupTextReq(const std::shared_ptr<CServerSess>& pSe
  */
 void CChatServer::HandleAddToGroupReq(const std::shared_ptr<CServerSess>& pSess, const AddToGroupReqMsg& reqMsg)
 {
-	AddToGroupRspMsg rspMsg = DoAddToGroupReqMsg(reqMsg);
-	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(reqMsg.m_strGroupId, [this, reqMsg](CMySqlConnect& util) {
+		return DoAddToGroupReqMsg(util, reqMsg);
+	}, [this, pSelf, pSess, reqMsg](AddToGroupRspMsg rspMsg) {
+		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 }
 
 /**
@@ -2416,10 +3712,8 @@ void CChatServer::HandleQueryUserUdpAddr(const std::shared_ptr<CServerSess>& pSe
 	QueryUserUdpAddrRspMsg rspMsg;
 	rspMsg.m_strUdpUserId = reqMsg.m_strUdpUserId;
 	rspMsg.m_strUserId = reqMsg.m_strUserId;
-	auto item = m_userIdUdpAddrMap.find(reqMsg.m_strUdpUserId);
-	if (item != m_userIdUdpAddrMap.end()) {
+	if (m_presence.GetUdpAddr(reqMsg.m_strUdpUserId, rspMsg.m_udpEndPt)) {
 		rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
-		rspMsg.m_udpEndPt = item->second;
 	}
 	else
 	{
@@ -2444,13 +3738,15 @@ void CChatServer::Handle_UdpFileDataSendReqMsg(const asio::ip::udp::endpoint sen
 		{
 		case FILE_TRANS_TYPE::UDP_OFFLINE_MODE:
 		{
-			auto rspMsg = DoFileDataSendReq(reqMsg);
-			m_udpServer->sendMsg(sendPt, &rspMsg);
+			auto pUdpServer = m_udpServer;
+			DoFileDataSendReq(reqMsg, [pUdpServer, sendPt](const FileDataSendRspMsg& rspMsg) {
+				pUdpServer->sendMsg(sendPt, &rspMsg);
+			});
 		}break;
 		case FILE_TRANS_TYPE::UDP_ONLINE_MEDIUM_MODE:
 		{
-			auto buddyUdp = m_userIdUdpAddrMap.find(reqMsg.m_strFriendId);
-			if (buddyUdp != m_userIdUdpAddrMap.end())
+			IpPortCfg buddyUdp;
+			if (m_presence.GetUdpAddr(reqMsg.m_strFriendId, buddyUdp))
 			{
 				FileDataRecvReqMsg recvReqMsg;
 
@@ -2462,10 +3758,11 @@ void CChatServer::Handle_UdpFileDataSendReqMsg(const asio::ip::udp::endpoint sen
 					recvReqMsg.m_nDataTotalCount = reqMsg.m_nDataTotalCount;
 					recvReqMsg.m_nDataIndex = reqMsg.m_nDataIndex;
 					recvReqMsg.m_nDataLength = reqMsg.m_nDataLength;
-					memcpy(recvReqMsg.m_szData, reqMsg.m_szData, recvReqMsg.m_nDataLength);
+					recvReqMsg.m_nChunkSize = reqMsg.m_nChunkSize;
+					recvReqMsg.m_dataVec = reqMsg.m_dataVec;
 				}
 
-				m_udpServer->sendMsg(buddyUdp->second.m_strServerIp, buddyUdp->second.m_nPort, &recvReqMsg);
+				m_udpServer->sendMsg(buddyUdp.m_strServerIp, buddyUdp.m_nPort, &recvReqMsg);
 			}
 			else
 			{
@@ -2511,31 +3808,76 @@ void CChatServer::HandleFileVerifyReq(const std::shared_ptr<CServerSess>& pSess,
 					chatMsg.m_eChatMsgType = CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE;
 					FontInfo_s fontInfo;
 					chatMsg.m_strF_OTHER_INFO = fontInfo.ToString();
+					chatMsg.m_strF_CREATE_TIME = CTimeUtil::GetYMD_HMS_Time();
+				}
+				//和好友文本消息一样先写日志再批量入库,入库以后通知接收者
+				if (AppendJournal(chatMsg))
+				{
+					ScheduleJournalFlush();
+				}
+				else
+				{
+					PostDbTask(req.m_strUserId, [chatMsg](CMySqlConnect& util) {
+						util.InsertFriendChatMsg(chatMsg);
+					});
 				}
-				m_util.InsertFriendChatMsg(chatMsg);
 			}
 			m_fileTranModeMap.erase(req.m_nFileId);
 		}
 	}
-	{
-		m_fileUtil.OnCloseFile(req.m_nFileId);
-	}
-	{
-		std::string strFileName = GetImageDir()+m_fileUtil.GetFileNameFromPath(req.m_strFileName);
-		std::string strFileHash = m_fileUtil.CalcHash(strFileName);
-		FileVerifyRspMsg rspMsg;
+	//关闭以后投递的计算在之前的写入完成以后执行
+	m_fileIo.Close(req.m_nFileId);
+	std::string strFileName = UploadFilePath(m_fileUtil.GetFileNameFromPath(req.m_strFileName));
+	std::string strFileHash = FinishRecvHash(req.m_nFileId, req.m_strFileHash);
+	FinishRecvResume(req.m_nFileId);
+	FILE_HASH_TYPE eHashType = FILE_HASH_TYPE::HASH_MD5;
+	CFileHash::TypeOfHash(req.m_strFileHash, eHashType);
+	const bool bBlob = m_blobStore.IsOpen();
+	auto pSelf = shared_from_this();
+	m_fileIo.Post(req.m_nFileId, [strFileName, strFileHash, eHashType, bBlob]() {
+		FileDigest_st digest;
+		//按Hash保存的内容以BLAKE2b为键,MD5上传的文件读取一次同时计算两种Hash
+		if (bBlob && FILE_HASH_TYPE::HASH_MD5 == eHashType)
+		{
+			CFileHash::CalcFile(strFileName, digest);
+			return digest;
+		}
+		std::string strRecvHash = strFileHash.empty() ? CFileHash::CalcFile(strFileName, eHashType) : strFileHash;
+		if (FILE_HASH_TYPE::HASH_BLAKE2B == eHashType)
+		{
+			digest.m_strBlake2b = strRecvHash;
+		}
+		else
+		{
+			digest.m_strMd5 = strRecvHash;
+		}
+		return digest;
+	}, m_strand, [this, pSelf, pSess, req, strFileName, eHashType](const FileDigest_st& digest) {
+		OnFileVerifyHash(pSess, req, strFileName, digest.Of(eHashType), digest);
+	});
+}
+
+/**
+ * @brief 接收的文件的Hash计算完成,比较以后回复文件校验结果
+ * 
+ * @param pSess 用户会话
+ * @param req 验证请求消息
+ * @param strFileName 接收的文件
+ * @param strFileHash 接收的文件按发送端算法计算的Hash
+ * @param digest 接收的文件的Hash,按Hash保存时使用
+ */
+void CChatServer::OnFileVerifyHash(const std::shared_ptr<CServerSess>& pSess, const FileVerifyReqMsg& req, const std::string& strFileName, const std::string& strFileHash, const FileDigest_st& digest)
+{
+	{
+		FileVerifyRspMsg rspMsg;
 		rspMsg.m_strMsgId = req.m_strMsgId;
 		rspMsg.m_strFileName = req.m_strFileName;
 		rspMsg.m_strUserId = req.m_strUserId;
 		rspMsg.m_strFriendId = req.m_strFriendId;
 		rspMsg.m_nFileId = req.m_nFileId;
-		if (strFileHash == req.m_strFileHash)
+		//校验通过的文件按Hash保存,之后的下载直接使用保存的Hash
+		if (strFileHash == req.m_strFileHash && CommitUploadFile(m_fileUtil.GetFileNameFromPath(req.m_strFileName), digest))
 		{
-			//T_FILE_HASH_BEAN bean;
-			//bean.m_strF_FILE_HASH = strFileHash;
-			//bean.m_strF_FILE_NAME = req.m_strFileName;
-			//bean.m_strF_USER_ID = req.m_strUserId;
-			//m_util.InsertFileHash(bean);
 			rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 			//m_fileUtil.UtilCopy(strFileName, strNewFileName);
 			rspMsg.m_strFileHash = strFileHash;
@@ -2543,11 +3885,15 @@ void CChatServer::HandleFileVerifyReq(const std::shared_ptr<CServerSess>& pSess,
 		}
 		else
 		{
+			if (m_blobStore.IsOpen())
+			{
+				m_fileUtil.RemoveFile(strFileName);
+			}
 			rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_FILE_SEND_FAILED;
 		}
 		pSess->SendMsg(&rspMsg);
 
-		RemoveRecvingState(strFileHash);
+		RemoveRecvingState(req.m_strFileHash);
 		//RemoveSendingState(strFileHash);
 		CheckFileVerifyReq(req);
 	}
@@ -2556,16 +3902,17 @@ void CChatServer::HandleFileVerifyReq(const std::shared_ptr<CServerSess>& pSess,
 /**
  * @brief 实际处理随机获取用户名的请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 随机获取用户名的请求
  * @return GetRandomUserRspMsg 
  */
-GetRandomUserRspMsg CChatServer::DoGetRandomUserReqMsg(const GetRandomUserReqMsg& reqMsg)
+GetRandomUserRspMsg CChatServer::DoGetRandomUserReqMsg(CMySqlConnect& util, const GetRandomUserReqMsg& reqMsg)
 {
 	GetRandomUserRspMsg rspMsg;
 	std::vector<std::string> userNameVec;
 	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
 	rspMsg.m_strUserId = reqMsg.m_strUserId;
-	if (m_util.GetAllUserName(userNameVec))
+	if (util.GetAllUserName(userNameVec))
 	{
 		int index = rand() % userNameVec.size();
 		rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
@@ -2589,64 +3936,15 @@ GetRandomUserRspMsg CChatServer::DoGetRandomUserReqMsg(const GetRandomUserReqMsg
 void CChatServer::HandleFileVerifyRsp(const FileVerifyRspMsg& req)
 {
 	{
-		auto item = m_UserSessVec.find(req.m_strFriendId);
-		if (item != m_UserSessVec.end())
+		auto item = m_presence.GetSess(req.m_strFriendId);
+		if (item)
 		{
-			item->second->SendMsg(&req);
+			item->SendMsg(&req);
 		}
 	}
 }
 
 
-/**
- * @brief 实际处理文件数据接收回复消息
- * 
- * @param rspMsg 文件数据接收回复消息
- * @return TransBaseMsg_S_PTR 需要发送的消息(文件数据请求消息,文件校验请求消息)
- */
-TransBaseMsg_S_PTR CChatServer::DoFileDataRecvRsp(const FileDataRecvRspMsg& rspMsg)
-{
-	if (rspMsg.m_nDataIndex < rspMsg.m_nDataTotalCount)
-	{
-		{
-			FileDataRecvReqMsg sendReqMsg;
-			sendReqMsg.m_strMsgId = std::to_string(m_MsgID_Util.nextId());
-			sendReqMsg.m_strUserId = rspMsg.m_strUserId;
-			sendReqMsg.m_strFriendId = rspMsg.m_strFriendId;
-			sendReqMsg.m_nFileId = rspMsg.m_nFileId;
-
-			sendReqMsg.m_nDataTotalCount = rspMsg.m_nDataTotalCount;
-			sendReqMsg.m_nDataIndex = rspMsg.m_nDataIndex + 1;
-			sendReqMsg.m_nDataLength = 0;
-			if (m_fileUtil.OnReadData(sendReqMsg.m_nFileId, sendReqMsg.m_szData, sendReqMsg.m_nDataLength, 1024))
-			{
-				auto pResult = std::make_shared<TransBaseMsg_t>(sendReqMsg.GetMsgType(), sendReqMsg.ToString());
-				return pResult;
-			}
-			else
-			{
-				return nullptr;
-			}
-		}
-	}
-	else
-	{
-		std::string strFileName = m_fileUtil.GetFileName(rspMsg.m_nFileId);
-		FileVerifyReqMsg reqMsg;
-		reqMsg.m_nFileId = rspMsg.m_nFileId;
-		reqMsg.m_strMsgId = CreateMsgId();
-		reqMsg.m_strUserId = rspMsg.m_strUserId;
-		reqMsg.m_strFriendId = rspMsg.m_strFriendId;
-		reqMsg.m_strFileName = m_fileUtil.GetFileNameFromPath(strFileName);
-		reqMsg.m_strFileHash = m_fileUtil.CalcHash(strFileName);
-		RemoveSendingState(reqMsg.m_strFileHash);
-		m_fileUtil.GetFileSize(reqMsg.m_nFileSize, strFileName);
-
-		auto pResult = std::make_shared<TransBaseMsg_t>(reqMsg.GetMsgType(), reqMsg.ToString());
-		return pResult;
-	}
-}
-
 /**
  * @brief TCP消息处理,处理文件数据接收回复消息
  * 
@@ -2655,10 +3953,9 @@ TransBaseMsg_S_PTR CChatServer::DoFileDataRecvRsp(const FileDataRecvRspMsg& rspM
  */
 void CChatServer::HandleFileDataRecvRsp(const std::shared_ptr<CServerSess>& pSess, const FileDataRecvRspMsg& rspMsg)
 {
-	auto pResult = DoFileDataRecvRsp(rspMsg);
-	if (pResult)
+	if (pSess)
 	{
-		pSess->SendMsg(pResult);
+		OnFileDataRecvRsp(rspMsg);
 	}
 }
 
@@ -2670,11 +3967,15 @@ void CChatServer::HandleFileDataRecvRsp(const std::shared_ptr<CServerSess>& pSes
  */
 void CChatServer::HandleGetRandomUserReq(const std::shared_ptr<CServerSess>& pSess, const GetRandomUserReqMsg& req)
 {
-	auto rspMsg = DoGetRandomUserReqMsg(req);
-	if (pSess)
-	{
-		pSess->SendMsg(&rspMsg);
-	}
+	auto pSelf = shared_from_this();
+	PostDbQuery(req.m_strUserId, [this, req](CMySqlConnect& util) {
+		return DoGetRandomUserReqMsg(util, req);
+	}, [this, pSelf, pSess](const GetRandomUserRspMsg& rspMsg) {
+		if (pSess)
+		{
+			pSess->SendMsg(&rspMsg);
+		}
+	});
 }
 
 
@@ -2687,58 +3988,16 @@ void CChatServer::HandleGetRandomUserReq(const std::shared_ptr<CServerSess>& pSe
  */
 void CChatServer::Handle_RecvUdpMsg(const asio::ip::udp::endpoint /*sendPt*/, const FileDataRecvRspMsg& rspMsg)
 {
+	//服务器发出的文件数据的确认
+	if (m_fileSendWindowMap.find(rspMsg.m_nFileId) != m_fileSendWindowMap.end())
+	{
+		OnFileDataRecvRsp(rspMsg);
+		return;
+	}
 	auto fileTransMode = m_fileTranModeMap.find(rspMsg.m_nFileId);
 	if (fileTransMode != m_fileTranModeMap.end())
 	{
-		if (fileTransMode->second == FILE_TRANS_TYPE::UDP_OFFLINE_MODE)
-		{
-			//UDP Server SAVE Mode
-			if (rspMsg.m_nDataIndex < rspMsg.m_nDataTotalCount)
-			{
-				{
-					FileDataRecvReqMsg sendReqMsg;
-					sendReqMsg.m_strMsgId = std::to_string(m_MsgID_Util.nextId());
-					sendReqMsg.m_strUserId = rspMsg.m_strUserId;
-					sendReqMsg.m_strFriendId = rspMsg.m_strFriendId;
-					sendReqMsg.m_nFileId = rspMsg.m_nFileId;
-
-					sendReqMsg.m_nDataTotalCount = rspMsg.m_nDataTotalCount;
-					sendReqMsg.m_nDataIndex = rspMsg.m_nDataIndex + 1;
-					sendReqMsg.m_nDataLength = 0;
-					if (m_fileUtil.OnReadData(sendReqMsg.m_nFileId, sendReqMsg.m_szData, sendReqMsg.m_nDataLength, 1024))
-					{
-						auto item = m_userIdUdpAddrMap.find(rspMsg.m_strUserId);
-						if (item != m_userIdUdpAddrMap.end())
-						{
-							m_udpServer->sendMsg(item->second.m_strServerIp, item->second.m_nPort, &sendReqMsg);
-						}
-						else
-						{
-							LOG_ERR(ms_loger, "Can not find {} ", rspMsg.m_strUserId);
-						}
-					}
-				}
-			}
-			else
-			{
-				std::string strFileName = m_fileUtil.GetFileName(rspMsg.m_nFileId);
-				FileVerifyReqMsg reqMsg;
-				reqMsg.m_nFileId = rspMsg.m_nFileId;
-				reqMsg.m_strMsgId = CreateMsgId();
-				reqMsg.m_strUserId = rspMsg.m_strUserId;
-				reqMsg.m_strFriendId = rspMsg.m_strFriendId;
-				reqMsg.m_strFileName = m_fileUtil.GetFileNameFromPath(strFileName);
-				reqMsg.m_strFileHash = m_fileUtil.CalcHash(strFileName);
-				m_fileUtil.GetFileSize(reqMsg.m_nFileSize, strFileName);
-
-				auto item = m_UserSessVec.find(reqMsg.m_strUserId);
-				if (item != m_UserSessVec.end() && item->second->IsConnected())
-				{
-					item->second->SendMsg(&reqMsg);
-				}
-			}
-		}
-		else if (fileTransMode->second == FILE_TRANS_TYPE::UDP_ONLINE_MEDIUM_MODE)
+		if (fileTransMode->second == FILE_TRANS_TYPE::UDP_ONLINE_MEDIUM_MODE)
 		{
 			FileDataSendRspMsg sendRspMsg;
 			{
@@ -2747,12 +4006,13 @@ void CChatServer::Handle_RecvUdpMsg(const asio::ip::udp::endpoint /*sendPt*/, co
 				sendRspMsg.m_strFriendId = rspMsg.m_strUserId;
 				sendRspMsg.m_nFileId = rspMsg.m_nFileId;
 				sendRspMsg.m_nDataIndex = rspMsg.m_nDataIndex;
+				sendRspMsg.m_nCumAckIndex = rspMsg.m_nCumAckIndex;
 				sendRspMsg.m_nDataTotalCount = rspMsg.m_nDataTotalCount;
 			}
-			auto buddyUdp = m_userIdUdpAddrMap.find(rspMsg.m_strFriendId);
-			if (buddyUdp != m_userIdUdpAddrMap.end())
+			IpPortCfg buddyUdp;
+			if (m_presence.GetUdpAddr(rspMsg.m_strFriendId, buddyUdp))
 			{
-				m_udpServer->sendMsg(buddyUdp->second.m_strServerIp, buddyUdp->second.m_nPort, &sendRspMsg);
+				m_udpServer->sendMsg(buddyUdp.m_strServerIp, buddyUdp.m_nPort, &sendRspMsg);
 			}
 			else
 			{
@@ -2775,17 +4035,18 @@ void CChatServer::Handle_RecvUdpMsg(const asio::ip::udp::endpoint /*sendPt*/, co
 /**
  * @brief 实际响应加入群组请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 用户加入群组请求
  * @return AddToGroupRspMsg 用户加入群组回复
  */
-AddToGroupRspMsg CChatServer::DoAddToGroupReqMsg(const AddToGroupReqMsg& reqMsg)
+AddToGroupRspMsg CChatServer::DoAddToGroupReqMsg(CMySqlConnect& util, const AddToGroupReqMsg& reqMsg)
 {
 	AddToGroupRspMsg rspMsg;
 	T_GROUP_RELATION_BEAN relationBean;
 	relationBean.m_eRole = E_GROUP_MEMBER_ROLE::E_ROLE_MEMBER;
 	relationBean.m_strF_GROUP_ID = reqMsg.m_strGroupId;
 	relationBean.m_strF_USER_ID = reqMsg.m_strUserId;
-	if (m_util.InsertGroupRelation(relationBean))
+	if (util.InsertGroupRelation(relationBean))
 	{
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 		rspMsg.m_strGroupId = reqMsg.m_strGroupId;
@@ -2800,35 +4061,37 @@ AddToGroupRspMsg CChatServer::DoAddToGroupReqMsg(const AddToGroupReqMsg& reqMsg)
 
 std::shared_ptr<CServerSess> CChatServer::GetClientSess(const std::string strUserId)
 {
-	auto item = m_UserSessVec.find(strUserId);
-	if (item != m_UserSessVec.end())
-	{
-		return item->second;
-	}
-	else
-	{
-		return nullptr;
-	}
+	return m_presence.GetSess(strUserId);
 }
 
 /**
  * @brief 分发群组聊天消息
  * 
+ * 群成员按所在的分片分组,每个分片在自己的strand上通知本分片的成员
  * @param strGroupId 群组ID
+ * @param groupUsers 群组的成员
  */
-void CChatServer::OnDispatchGroupMsg(const std::string strGroupId)
+void CChatServer::OnDispatchGroupMsg(const std::string strGroupId, const std::vector<T_GROUP_RELATION_BEAN>& groupUsers)
 {
-	std::vector<T_GROUP_RELATION_BEAN> groupUsers;
-	if (m_util.SelectGroupRelation(strGroupId, groupUsers))
+	std::map<std::size_t, std::vector<std::string>> shardUserMap;
+	for (const auto& userId : groupUsers)
 	{
-		for (auto userId : groupUsers)
-		{
-			auto pSess = GetClientSess(userId.m_strF_USER_ID);
-			if (pSess)
+		shardUserMap[m_presence.ShardIndex(userId.m_strF_USER_ID)].push_back(userId.m_strF_USER_ID);
+	}
+	auto pSelf = shared_from_this();
+	for (const auto& item : shardUserMap)
+	{
+		std::vector<std::string> userIdVec = item.second;
+		m_userShardVec[item.first]->m_strand.post([this, pSelf, strGroupId, userIdVec]() {
+			for (const auto& strUserId : userIdVec)
 			{
-				NotifyUserRecvGroupMsg(pSess,strGroupId);
+				auto pSess = GetClientSess(strUserId);
+				if (pSess)
+				{
+					NotifyUserRecvGroupMsg(pSess, strGroupId);
+				}
 			}
-		}
+		});
 	}
 }
 
@@ -2859,6 +4122,53 @@ bool CChatServer::DoUserRecvGroupMsg(const std::shared_ptr<CServerSess>& pSess,
 	return false;
 }
 
+/**
+ * @brief 把查询到的一批群聊消息合并为一个消息下发给用户
+ * 
+ * 消息的总长度超过限制时,剩下的消息在收到回复以后和下一批一起下发;非文本消息不下发,
+ * 但是计入本批的最后一条消息ID,读取位置可以越过这些消息
+ * 
+ * @param pSess 用户会话
+ * @param strGroupId 群组ID
+ * @param msgVec 按消息ID排序的群聊消息
+ */
+void CChatServer::DoUserRecvGroupMsgBatch(const std::shared_ptr<CServerSess>& pSess, const std::string strGroupId, const std::vector<T_GROUP_CHAT_MSG>& msgVec)
+{
+	RecvGroupTextMsgBatchReqMsg reqMsg;
+	reqMsg.m_strMsgId = std::to_string(m_MsgID_Util.nextId());
+	reqMsg.m_strUserId = pSess->UserId();
+	reqMsg.m_strGroupId = strGroupId;
+	std::size_t nTotalLength = 0;
+	for (const auto& msg : msgVec)
+	{
+		std::size_t nItemLength = msg.m_strF_MSG_CONTEXT.length() + msg.m_strF_OTHER_INFO.length() + GROUP_MSG_ITEM_RESERVE;
+		//至少下发一条消息,保证读取位置可以前进
+		if (!reqMsg.m_strLastChatMsgId.empty() && nTotalLength + nItemLength > GROUP_MSG_BATCH_LENGTH)
+		{
+			break;
+		}
+		nTotalLength += nItemLength;
+		reqMsg.m_strLastChatMsgId = msg.m_strF_MSG_ID;
+		if (CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE != msg.m_eChatMsgType)
+		{
+			continue;
+		}
+		GroupChatMsg_s chatMsg;
+		chatMsg.m_strGroupId = msg.m_strF_GROUP_ID;
+		chatMsg.m_strSenderId = msg.m_strF_SENDER_ID;
+		chatMsg.m_strContext = msg.m_strF_MSG_CONTEXT;
+		chatMsg.m_strChatMsgId = msg.m_strF_MSG_ID;
+		chatMsg.m_fontInfo.FromString(msg.m_strF_OTHER_INFO);
+		chatMsg.m_strMsgTime = msg.m_strF_CREATE_TIME;
+		reqMsg.m_chatMsgVec.push_back(chatMsg);
+	}
+	GroupPresence_st& group = m_presence.Insert(pSess->UserId()).InsertGroup(strGroupId);
+	group.m_bBatchPending = true;
+	group.m_strBatchLastId = reqMsg.m_strLastChatMsgId;
+	LOG_DBG(ms_loger, "User:{} Group:{} Batch:{} Last:{} [{} {}]", pSess->UserId(), strGroupId, reqMsg.m_chatMsgVec.size(), reqMsg.m_strLastChatMsgId, __FILENAME__, __LINE__);
+	pSess->SendMsg(&reqMsg);
+}
+
 /**
  * @brief 发送群聊天消息到用户
  * 
@@ -2888,20 +4198,15 @@ bool CChatServer::DoUserRecvGroupMsg(const std::shared_ptr<CServerSess>& pSess,
 /**
  * @brief 处理用户发送的群组文本聊天消息请求
  * 
+ * @param util 执行操作的数据库连接
  * @param reqMsg 群组文字聊天消息请求
+ * @param chatMsg 需要保存的群聊消息
  * @return SendGroupTextMsgRspMsg 群组文字聊天消息回复
  */
-SendGroupTextMsgRspMsg CChatServer::DoSendGroupTextMsgReqMsg(const SendGroupTextMsgReqMsg& reqMsg)
+SendGroupTextMsgRspMsg CChatServer::DoSendGroupTextMsgReqMsg(CMySqlConnect& util, const SendGroupTextMsgReqMsg& reqMsg, const T_GROUP_CHAT_MSG& chatMsg)
 {
 	SendGroupTextMsgRspMsg rspMsg;
-	T_GROUP_CHAT_MSG chatMsg;
-	chatMsg.m_strF_GROUP_ID = reqMsg.m_chatMsg.m_strGroupId;
-	chatMsg.m_strF_SENDER_ID = reqMsg.m_chatMsg.m_strSenderId;
-	chatMsg.m_strF_MSG_CONTEXT = reqMsg.m_chatMsg.m_strContext;
-	chatMsg.m_strF_MSG_ID = std::to_string(m_MsgID_Util.nextId());
-	chatMsg.m_eChatMsgType = CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE;
-	chatMsg.m_strF_OTHER_INFO = reqMsg.m_chatMsg.m_fontInfo.ToString();
-	if (m_util.InsertGroupChatText(chatMsg))
+	if (util.InsertGroupChatText(chatMsg))
 	{
 		rspMsg.m_eErrCode = ERROR_CODE_TYPE::E_CODE_SUCCEED;
 		rspMsg.m_strMsgId = reqMsg.m_strMsgId;
@@ -2916,40 +4221,57 @@ SendGroupTextMsgRspMsg CChatServer::DoSendGroupTextMsgReqMsg(const SendGroupText
 }
 void CChatServer::HandleNotifyGroupMsgRsp(const std::shared_ptr<CServerSess>& pSess, const NotifyGroupMsgRspMsg& reqMsg)
 {
-	UserIdGroupId_st keyValue;
-	keyValue.m_strUserId = pSess->UserId();
-	keyValue.m_strGroupId = reqMsg.m_strGroupId;
-	if (CLIENT_SESS_STATE::SESS_IDLE_STATE == GetGroupUserState(keyValue))
+	if (CLIENT_SESS_STATE::SESS_IDLE_STATE == GetGroupUserState(pSess->UserId(), reqMsg.m_strGroupId))
 	{
-		std::string strLastReadId;
-		if (m_util.SelectGroupUserLastId(pSess->UserId(), reqMsg.m_strGroupId, strLastReadId))
-		{
-			SetGroupUserState(keyValue, CLIENT_SESS_STATE::SESS_GROUP_MSG_SEND_RECV_STATE);
-			SendGroupMsgToUser(pSess, reqMsg.m_strGroupId, strLastReadId);
-		}
+		//和更新已读位置使用同一个key,读到的是最新的已读位置
+		std::string strUserId = pSess->UserId();
+		std::string strGroupId = reqMsg.m_strGroupId;
+		auto pSelf = shared_from_this();
+		PostDbQuery(strUserId, [strUserId, strGroupId](CMySqlConnect& util) {
+			std::string strLastReadId;
+			if (!util.SelectGroupUserLastId(strUserId, strGroupId, strLastReadId))
+			{
+				strLastReadId.clear();
+			}
+			return strLastReadId;
+		}, [this, pSelf, pSess, strGroupId](const std::string& strLastReadId) {
+			if (strLastReadId.empty() || m_presence.GetSess(pSess->UserId()) != pSess ||
+				CLIENT_SESS_STATE::SESS_IDLE_STATE != GetGroupUserState(pSess->UserId(), strGroupId))
+			{
+				return;
+			}
+			SetGroupUserState(pSess->UserId(), strGroupId, CLIENT_SESS_STATE::SESS_GROUP_MSG_SEND_RECV_STATE);
+			SendGroupMsgToUser(pSess, strGroupId, strLastReadId);
+		});
 	}
 }
 
 void CChatServer::NotifyUserRecvGroupMsg(const std::shared_ptr<CServerSess>& pSess, const std::string strGroupId)
 {
-	UserIdGroupId_st keyValue;
-	keyValue.m_strUserId = pSess->UserId();
-	keyValue.m_strGroupId = strGroupId;
-	if (CLIENT_SESS_STATE::SESS_IDLE_STATE == GetGroupUserState(keyValue))
+	if (CLIENT_SESS_STATE::SESS_IDLE_STATE == GetGroupUserState(pSess->UserId(), strGroupId))
 	{
-		std::string strLastReadId;
-		if (m_util.SelectGroupUserLastId(pSess->UserId(), strGroupId, strLastReadId))
-		{
+		std::string strUserId = pSess->UserId();
+		auto pSelf = shared_from_this();
+		PostDbQuery(strUserId, [strUserId, strGroupId](CMySqlConnect& util) {
+			std::string strLastReadId;
+			return util.SelectGroupUserLastId(strUserId, strGroupId, strLastReadId);
+		}, [this, pSelf, pSess, strGroupId](const bool bHasLastId) {
+			if (!bHasLastId)
+			{
+				LOG_ERR(ms_loger, "User:{} No Last Msg Id [{} {}]", pSess->UserId(), __FILENAME__, __LINE__);
+				return;
+			}
+			if (m_presence.GetSess(pSess->UserId()) != pSess ||
+				CLIENT_SESS_STATE::SESS_IDLE_STATE != GetGroupUserState(pSess->UserId(), strGroupId))
+			{
+				return;
+			}
 			NotifyGroupMsgReqMsg reqMsg;
 			reqMsg.m_strMsgId = CreateMsgId();
 			reqMsg.m_strGroupId = strGroupId;
 			reqMsg.m_strUserId = pSess->UserId();
 			pSess->SendMsg(&reqMsg);
-		}
-		else
-		{
-			LOG_ERR(ms_loger, "User:{} No Last Msg Id [{} {}]", pSess->UserId(), __FILENAME__, __LINE__);
-		}
+		});
 	}
 	else
 	{
@@ -2958,26 +4280,71 @@ void CChatServer::NotifyUserRecvGroupMsg(const std::shared_ptr<CServerSess>& pSe
 }
 void CChatServer::SendGroupMsgToUser(const std::shared_ptr<CServerSess>& pSess, const std::string strGroupId, const std::string strLastReadId)
 {
-	UserIdGroupId_st keyValue;
-	keyValue.m_strUserId = pSess->UserId();
-	keyValue.m_strGroupId = strGroupId;
-	if (CLIENT_SESS_STATE::SESS_GROUP_MSG_SEND_RECV_STATE == GetGroupUserState(keyValue))
+	if (CLIENT_SESS_STATE::SESS_GROUP_MSG_SEND_RECV_STATE != GetGroupUserState(pSess->UserId(), strGroupId))
+	{
+		return;
+	}
+	//协商了批量条数的用户,一次查询和下发多条消息,收到回复以后再下发下一批
+	const int nLimit = pSess->GroupMsgBatch() > 0 ? pSess->GroupMsgBatch() : 1;
+	std::vector<T_GROUP_CHAT_MSG> msgVec;
+	bool bCached = false;
+	{
+		std::lock_guard<std::mutex> lock(m_groupMsgCacheMutex);
+		bCached = m_groupMsgCache.GetAfter(strGroupId, strLastReadId, static_cast<std::size_t>(nLimit), msgVec);
+	}
+	if (bCached)
+	{
+		OnGroupMsgSelected(pSess, strGroupId, msgVec);
+		return;
+	}
+	//缓存中没有读取位置之后的消息,归档文件和数据库在连接池的线程上读取
+	auto pSelf = shared_from_this();
+	PostDbQuery(strGroupId, [this, pSelf, strGroupId, strLastReadId, nLimit](CMySqlConnect& util) {
+		std::vector<T_GROUP_CHAT_MSG> selectVec;
+		SelectGroupChatTextList(util, strGroupId, strLastReadId, nLimit, selectVec);
+		return selectVec;
+	}, [this, pSelf, pSess, strGroupId](const std::vector<T_GROUP_CHAT_MSG>& selectVec) {
+		//查询期间用户重新登录或者已经下线
+		if (m_presence.GetSess(pSess->UserId()) != pSess)
+		{
+			return;
+		}
+		OnGroupMsgSelected(pSess, strGroupId, selectVec);
+	});
+}
+
+/**
+ * @brief 下发读取到的群组消息,没有新的消息时群组回到空闲状态
+ * 
+ * @param pSess 接收消息的用户连接
+ * @param strGroupId 群组ID
+ * @param msgVec 读取位置之后的消息
+ */
+void CChatServer::OnGroupMsgSelected(const std::shared_ptr<CServerSess>& pSess, const std::string strGroupId, const std::vector<T_GROUP_CHAT_MSG>& msgVec)
+{
+	if (CLIENT_SESS_STATE::SESS_GROUP_MSG_SEND_RECV_STATE != GetGroupUserState(pSess->UserId(), strGroupId))
+	{
+		return;
+	}
+	if (!msgVec.empty())
 	{
-		LOG_ERR(ms_loger, "User:{} No Last Msg Id [{} {}]", pSess->UserId(), __FILENAME__, __LINE__);
-		T_GROUP_CHAT_MSG msgBean;
-		msgBean.m_strF_GROUP_ID = strGroupId;
-		msgBean.m_strF_MSG_ID = strLastReadId;
-		if (m_util.SelectGroupChatText(msgBean))
+		if (pSess->GroupMsgBatch() > 0)
 		{
-			LOG_ERR(ms_loger, "User:{} No Last Msg Id [{} {}]", pSess->UserId(), __FILENAME__, __LINE__);
-			DoUserRecvGroupMsg(pSess, msgBean);
+			DoUserRecvGroupMsgBatch(pSess, strGroupId, msgVec);
 		}
 		else
 		{
-			LOG_ERR(ms_loger, "User:{} No Last Msg Id [{} {}]", pSess->UserId(), __FILENAME__, __LINE__);
-			SetGroupUserState(keyValue, CLIENT_SESS_STATE::SESS_IDLE_STATE);
+			DoUserRecvGroupMsg(pSess, msgVec.front());
 		}
+		return;
+	}
+	UserPresence_st* pUser = m_presence.Find(pSess->UserId());
+	GroupPresence_st* pGroup = (nullptr == pUser) ? nullptr : pUser->FindGroup(strGroupId);
+	if (nullptr != pGroup)
+	{
+		pGroup->m_bBatchPending = false;
 	}
+	SetGroupUserState(pSess->UserId(), strGroupId, CLIENT_SESS_STATE::SESS_IDLE_STATE);
 }
 
 /**
@@ -2988,16 +4355,28 @@ void CChatServer::SendGroupMsgToUser(const std::shared_ptr<CServerSess>& pSess,
  */
 void CChatServer::HandleRecvGroupTextMsgRspMsg(const std::shared_ptr<CServerSess>& pSess, const RecvGroupTextMsgRspMsg& reqMsg)
 {
+	//批量下发时只接受对当前这一批的回复,等待图片下载以后补发的单条回复已经包含在批量回复中
+	if (pSess->GroupMsgBatch() > 0)
+	{
+		UserPresence_st* pUser = m_presence.Find(pSess->UserId());
+		GroupPresence_st* pGroup = (nullptr == pUser) ? nullptr : pUser->FindGroup(reqMsg.m_strGroupId);
+		if (nullptr == pGroup || !pGroup->m_bBatchPending || pGroup->m_strBatchLastId != reqMsg.m_strChatMsgId)
+		{
+			LOG_DBG(ms_loger, "User:{} Group:{} Ignore Rsp {} [{} {}]", pSess->UserId(), reqMsg.m_strGroupId, reqMsg.m_strChatMsgId, __FILENAME__, __LINE__);
+			return;
+		}
+		pGroup->m_bBatchPending = false;
+	}
 	{
 		T_GROUP_RELATION_BEAN relationBean;
 		relationBean.m_strF_GROUP_ID = reqMsg.m_strGroupId;
 		relationBean.m_strF_USER_ID = pSess->UserId();
 		relationBean.m_strF_LAST_READ_MSG_ID = reqMsg.m_strChatMsgId;
 
-		if (m_util.UpdateGroupRelationLastReadId(relationBean))
-		{
-
-		}
+		//下一条消息按回复中的消息ID读取,不需要等待更新完成
+		PostDbTask(relationBean.m_strF_USER_ID, [relationBean](CMySqlConnect& util) {
+			util.UpdateGroupRelationLastReadId(relationBean);
+		});
 	}
 	SendGroupMsgToUser(pSess, reqMsg.m_strGroupId, reqMsg.m_strChatMsgId);
 }
@@ -3010,11 +4389,11 @@ void CChatServer::HandleRecvGroupTextMsgRspMsg(const std::shared_ptr<CServerSess
  */
 void CChatServer::HandleReLogin(std::string strUserId, std::shared_ptr<CServerSess> pSess)
 {
-	auto item = m_UserSessVec.find(strUserId);
-	if (item != m_UserSessVec.end())
+	UserPresence_st& user = m_presence.Insert(strUserId);
+	if (user.m_pSess)
 	{
 		//同一个Socket发起两次登录
-		if (item->second == pSess)
+		if (user.m_pSess == pSess)
 		{
 			LOG_INFO(ms_loger, "User:{} Login From {} Twice", strUserId, pSess->GetRemoteIp());
 			return;
@@ -3022,12 +4401,14 @@ void CChatServer::HandleReLogin(std::string strUserId, std::shared_ptr<CServerSe
 		else
 		{
 			pSess->SetUserId(strUserId);
-			m_UserSessVec.insert(std::pair<std::string, std::shared_ptr<CServerSess>>(strUserId, pSess));
-			LOG_WARN(ms_loger, "User:{} ReLogin From {} OldLoginIp:{} ", strUserId, pSess->GetRemoteIp(), item->second->GetRemoteIp());
-			auto pOldSess = item->second;
-			m_KickOffSessMap.insert({ strUserId,item->second });
-			m_UserSessVec.erase(strUserId);
-			m_clientStateMap.erase(strUserId);
+			LOG_WARN(ms_loger, "User:{} ReLogin From {} OldLoginIp:{} ", strUserId, pSess->GetRemoteIp(), user.m_pSess->GetRemoteIp());
+			auto pOldSess = user.m_pSess;
+			user.m_pKickOffSess = pOldSess;
+			m_presence.SetSess(user, pSess);
+			user.m_eState = CLIENT_SESS_STATE::SESS_IDLE_STATE;
+			m_presence.SetUdpAddr(user, false);
+			user.m_groupVec.clear();
+			UserShard(strUserId).m_friendMsgDrainMap.erase(strUserId);
 			{
 				UserKickOffReqMsg reqMsg;
 				reqMsg.m_strMsgId = std::to_string(m_MsgID_Util.nextId());
@@ -3041,8 +4422,8 @@ void CChatServer::HandleReLogin(std::string strUserId, std::shared_ptr<CServerSe
 	else
 	{
 		pSess->SetUserId(strUserId);
-		m_UserSessVec.insert(std::pair<std::string, std::shared_ptr<CServerSess>>(strUserId, pSess));
-		m_clientStateMap.insert({ strUserId,CLIENT_SESS_STATE::SESS_IDLE_STATE });
+		m_presence.SetSess(user, pSess);
+		user.m_eState = CLIENT_SESS_STATE::SESS_IDLE_STATE;
 	}
 }
 
@@ -3054,17 +4435,21 @@ void CChatServer::HandleReLogin(std::string strUserId, std::shared_ptr<CServerSe
  */
 void CChatServer::HandleUserKickOffRsp(const UserKickOffRspMsg& reqMsg)
 {
-	auto item = m_KickOffSessMap.find(reqMsg.m_strUserId);
-	item->second->CloseSocket();
-	if (item != m_KickOffSessMap.end())
-	{
-		LOG_INFO(ms_loger, "User:{} KickOff Finished ", reqMsg.m_strUserId);
-		m_KickOffSessMap.erase(reqMsg.m_strUserId);
-	}
-	else
-	{
-		LOG_ERR(ms_loger, "User:{} Should Not Receive KickOff ", reqMsg.m_strUserId);
-	}
+	std::string strUserId = reqMsg.m_strUserId;
+	auto pSelf = shared_from_this();
+	DispatchToUser(strUserId, [this, pSelf, strUserId]() {
+		UserPresence_st* pUser = m_presence.Find(strUserId);
+		if (nullptr != pUser && pUser->m_pKickOffSess)
+		{
+			//旧会话关闭以后在CloseSess中清除m_pKickOffSess
+			LOG_INFO(ms_loger, "User:{} KickOff Finished ", strUserId);
+			pUser->m_pKickOffSess->CloseSocket();
+		}
+		else
+		{
+			LOG_ERR(ms_loger, "User:{} Should Not Receive KickOff ", strUserId);
+		}
+	});
 }
 
 /**
@@ -3076,6 +4461,25 @@ std::string CChatServer::CreateMsgId()
 {
 	return std::to_string(m_MsgID_Util.nextId());
 }
+
+/**
+ * @brief 分配服务器接收和发送文件使用的文件ID,按顺序递增,跳过正在传输的文件
+ * 
+ * @return int 文件ID
+ */
+int CChatServer::CreateFileId()
+{
+	do
+	{
+		m_nLastFileId = (m_nLastFileId >= std::numeric_limits<int>::max()) ? 1 : m_nLastFileId + 1;
+	} while (m_fileIo.IsOpen(m_nLastFileId) ||
+		m_fileTranModeMap.find(m_nLastFileId) != m_fileTranModeMap.end() ||
+		m_fileSendWindowMap.find(m_nLastFileId) != m_fileSendWindowMap.end() ||
+		m_fileRecvWindowMap.find(m_nLastFileId) != m_fileRecvWindowMap.end() ||
+		m_fileRecvLimitMap.find(m_nLastFileId) != m_fileRecvLimitMap.end() ||
+		m_fileResumeMap.find(m_nLastFileId) != m_fileResumeMap.end());
+	return m_nLastFileId;
+}
 /**
  * @brief 生成密码需要的Salt
  * 
@@ -3110,324 +4514,950 @@ std::string CChatServer::GetSaltFromPasswd(const std::string strPasswd)
 }
 
 /**
- * @brief 根据原始密码生成密码
+ * @brief 根据原始密码生成密码
+ * 
+ * @param orgPassWord 原始密码
+ * @return std::string 新的密码
+ */
+std::string CChatServer::GeneratePassword(const std::string orgPassWord)
+{
+	std::string strSalt = GenerateSalt();
+	std::string strOrg = strSalt + orgPassWord;
+	std::string strOrgHash = md5(strOrg);
+	return strSalt + strOrgHash;
+}
+
+/**
+ * @brief 校验密码
+ * 
+ * @param orgPassword 原始密码
+ * @param dataBasePassword 数据库的密码
+ * @return true 校验通过
+ * @return false 校验失败
+ */
+bool CChatServer::VerifyPassword(const std::string orgPassword, const std::string dataBasePassword)
+{
+	std::string strSalt = GetSaltFromPasswd(dataBasePassword);
+	std::string strPasswd = strSalt+md5(strSalt + orgPassword);
+	if (strPasswd == dataBasePassword)
+	{
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
+/**
+ * @brief 根据用户ID和文件名，拼接出文件全路径
+ * 
+ * @param strUserId 用户ID
+ * @param strFileName 文件名
+ * @return std::string 文件全路径
+ */
+std::string CChatServer::GetFilePathByUserIdAndFileName(const std::string strUserId, const std::string strFileName)
+{
+	return GetFolderByUserId(strUserId) + strFileName;
+}
+
+/**
+ * @brief 根据用户ID获取对应的文件夹
+ * 
+ * @param strUserId 用户ID
+ * @return std::string 用户ID对应的文件夹
+ */
+std::string CChatServer::GetFolderByUserId(const std::string strUserId)
+{
+	std::string strFolder = m_fileUtil.GetCurDir() + "\\" + strUserId+"\\";
+	return strFolder;
+}
+
+/**
+ * @brief 根据文件Hash判断是否正在接收
+ * 
+ * @param strFileHash 文件HASH值
+ * @return true 正在接收
+ * @return false 没有在接收
+ */
+bool CChatServer::IsFileRecving(const std::string strFileHash)
+{
+	auto item = std::find(m_strRecvFileHashVec.begin(), m_strRecvFileHashVec.end(), strFileHash);
+	if (item != m_strRecvFileHashVec.end())
+	{
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
+/**
+ * @brief 根据文件HASH判断文件是否正在发送中
+ * 
+ * @param strFileHash 文件Hash值
+ * @return true 正在发生
+ * @return false 没有在发送
+ */
+bool CChatServer::IsFileSending(const std::string strFileHash)
+{
+	auto item = std::find(m_strSendFileHashVec.begin(), m_strSendFileHashVec.end(), strFileHash);
+	if (item != m_strSendFileHashVec.end())
+	{
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
+/**
+ * @brief 保存接收状态
+ * 
+ * @param strFileHash 文件hash值
+ * @return true 保存成功
+ * @return false 保存失败
+ */
+bool CChatServer::SaveRecvingState(const std::string strFileHash)
+{
+	if (IsFileRecving(strFileHash))
+	{
+		return false;
+	}
+	else
+	{
+		m_strRecvFileHashVec.push_back(strFileHash);
+		return true;
+	}
+}
+
+
+/**
+ * @brief 移除接收状态
+ * 
+ * @param strFileHash 文件hash值
+ * @return true 移除成功
+ * @return false 移除失败
+ */
+bool CChatServer::RemoveRecvingState(const std::string strFileHash)
+{
+	if (IsFileRecving(strFileHash))
+	{
+		auto item = std::find(m_strRecvFileHashVec.begin(), m_strRecvFileHashVec.end(), strFileHash);
+		m_strRecvFileHashVec.erase(item);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief 保存文件的发送状态
+ * 
+ * @param strFileHash 文件hash值
+ * @return true 保存成功
+ * @return false 保存失败
+ */
+bool CChatServer::SaveSendingState(const std::string strFileHash)
+{
+	if (IsFileSending(strFileHash))
+	{
+		return false;
+	}
+	else
+	{
+		m_strSendFileHashVec.push_back(strFileHash);
+		return true;
+	}
+}
+
+/**
+ * @brief 移除文件发送状态
+ * 
+ * @param strFileHash 文件Hash值
+ * @return true 移除成功
+ * @return false 移除失败
+ */
+bool CChatServer::RemoveSendingState(const std::string strFileHash)
+{
+	if (IsFileSending(strFileHash))
+	{
+		auto item = std::find(m_strSendFileHashVec.begin(), m_strSendFileHashVec.end(), strFileHash);
+		m_strSendFileHashVec.erase(item);
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+/**
+ * @brief 
+ * @TODO:
+ * @param strUserId 
+ */
+void CChatServer::CheckFileDataRsp(const std::string strUserId)
+{
+	auto item = m_fileDataRspMap.find(strUserId);
+	if (item != m_fileDataRspMap.end())
+	{
+		/*auto udpAddrItem = m_userIdUdpAddrMap.find(strUserId);
+		if (udpAddrItem != m_userIdUdpAddrMap.end())
+		{
+			for (const auto msgItem : item->second)
+			{
+				m_udpServer->sendMsg(udpAddrItem->second.m_strServerIp, udpAddrItem->second.m_nPort, &(msgItem.second));
+			}
+		}*/
+	}
+}
+
+/**
+ * @brief 
+ * TODO:
+ * @param reqMsg 
+ */
+void CChatServer::CheckFileVerifyReq(const FileVerifyReqMsg& reqMsg)
+{
+	auto item = m_fileDataRspMap.find(reqMsg.m_strUserId);
+	if (item != m_fileDataRspMap.end())
+	{
+		item->second.erase(reqMsg.m_nFileId);
+	}
+}
+
+/**
+ * @brief 保存发送文件回复消息
+ * TODO:
+ * @param rspMsg 文件数据发送回复消息
+ */
+void CChatServer::SaveFileDataRsp(const FileDataSendRspMsg& rspMsg)
+{
+	auto item = m_fileDataRspMap.find(rspMsg.m_strUserId);
+	if (item != m_fileDataRspMap.end())
+	{
+		m_fileDataRspMap[rspMsg.m_strUserId].erase(rspMsg.m_nFileId);
+		m_fileDataRspMap[rspMsg.m_strUserId].insert({ rspMsg.m_nFileId,rspMsg });
+	}
+	else
+	{
+		FILE_ID_RSP_MSG_MAP rspMap;
+		rspMap.insert({ rspMsg.m_nFileId,rspMsg });
+		m_fileDataRspMap.insert({ rspMsg.m_strUserId,rspMap });
+	}
+}
+
+/**
+ * @brief 关闭某个用户正在发生和接收的文件,用户断开连接的时候调用
+ * 
+ * @param strUserId 用户ID
+ */
+void CChatServer::CloseUserFile(const std::string strUserId)
+{
+	//正在接收的文件保留已经写入的数据,重新连接以后续传
+	std::vector<int> fileIdVec;
+	for (const auto& item : m_fileResumeMap)
+	{
+		if (item.second.m_strUserId == strUserId)
+		{
+			fileIdVec.push_back(item.first);
+		}
+	}
+	for (const auto nFileId : fileIdVec)
+	{
+		SuspendRecvFile(nFileId);
+	}
+	m_fileDataRspMap.erase(strUserId);
+	//没有使用的秒传的盐
+	auto proofItem = m_fileProofMap.lower_bound(strUserId + "/");
+	while (proofItem != m_fileProofMap.end() && proofItem->first.compare(0, strUserId.length() + 1, strUserId + "/") == 0)
+	{
+		proofItem = m_fileProofMap.erase(proofItem);
+	}
+}
+
+
+/**
+ * @brief 实际处理文件数据发送请求消息,数据在文件读写线程上写入,写入完成以后回复
+ * 
+ * @param reqMsg 文件数据发送请求消息
+ * @param sendRsp 发送文件数据发送回复消息,在业务strand上调用
+ */
+void CChatServer::DoFileDataSendReq(const FileDataSendReqMsg& reqMsg, std::function<void(const FileDataSendRspMsg&)> sendRsp)
+{
+	FileDataSendRspMsg rspMsg;
+	rspMsg.m_strMsgId = reqMsg.m_strMsgId;
+	rspMsg.m_strUserId = reqMsg.m_strUserId;
+	rspMsg.m_strFriendId = reqMsg.m_strFriendId;
+	rspMsg.m_nFileId = reqMsg.m_nFileId;
+	rspMsg.m_nDataTotalCount = reqMsg.m_nDataTotalCount;
+	rspMsg.m_nDataIndex = reqMsg.m_nDataIndex;
+
+	const int nFileId = reqMsg.m_nFileId;
+	//分包大小决定写入的偏移,数据包总数决定接收窗口的大小,都不能超过开始接收时的限制
+	auto limitItem = m_fileRecvLimitMap.find(nFileId);
+	if (limitItem == m_fileRecvLimitMap.end() ||
+		reqMsg.m_nChunkSize != limitItem->second.m_nChunkSize ||
+		reqMsg.m_dataVec.size() > static_cast<std::size_t>(reqMsg.m_nChunkSize) ||
+		reqMsg.m_nDataTotalCount <= 0 || reqMsg.m_nDataTotalCount > limitItem->second.m_nMaxCount)
+	{
+		LOG_WARN(ms_loger, "User:{} File:{} Index:{} Total:{} Chunk:{} Invalid File Data [{} {}]", reqMsg.m_strUserId, nFileId,
+			reqMsg.m_nDataIndex, reqMsg.m_nDataTotalCount, reqMsg.m_nChunkSize, __FILENAME__, __LINE__);
+		return;
+	}
+	bool bNewWindow = false;
+	auto item = m_fileRecvWindowMap.find(nFileId);
+	if (item == m_fileRecvWindowMap.end())
+	{
+		item = m_fileRecvWindowMap.insert({ nFileId, CFileRecvWindow(reqMsg.m_nDataTotalCount) }).first;
+		bNewWindow = true;
+	}
+	//数据包可能乱序或重传到达,按索引写入,重复的数据包只回复确认
+	if (!item->second.OnRecv(reqMsg.m_nDataIndex))
+	{
+		rspMsg.m_nCumAckIndex = item->second.CumAckIndex();
+		sendRsp(rspMsg);
+		return;
+	}
+	rspMsg.m_nCumAckIndex = item->second.CumAckIndex();
+	//Hash在业务strand上按到达顺序计算,写入失败时删除,校验时读取文件
+	auto hashItem = m_fileRecvHashMap.find(nFileId);
+	if (hashItem == m_fileRecvHashMap.end() && bNewWindow && m_fileResumeMap.find(nFileId) == m_fileResumeMap.end())
+	{
+		hashItem = m_fileRecvHashMap.insert({ nFileId, CChunkHash() }).first;
+	}
+	if (hashItem != m_fileRecvHashMap.end())
+	{
+		hashItem->second.OnChunk(reqMsg.m_nDataIndex, reqMsg.m_dataVec.data(), reqMsg.m_dataVec.size());
+	}
+	const int64_t nOffset = static_cast<int64_t>(reqMsg.m_nDataIndex - 1) * reqMsg.m_nChunkSize;
+	const int nChunkSize = reqMsg.m_nChunkSize;
+	auto pSelf = shared_from_this();
+	bool bPost = m_fileIo.WriteAt(nFileId, nOffset, reqMsg.m_dataVec, m_strand, [this, pSelf, rspMsg, nChunkSize, sendRsp](bool bOk) {
+		const int nFileId = rspMsg.m_nFileId;
+		if (!bOk)
+		{
+			LOG_ERR(ms_loger, "File:{} Write Index:{} Failed [{} {}]", nFileId, rspMsg.m_nDataIndex, __FILENAME__, __LINE__);
+			m_fileRecvHashMap.erase(nFileId);
+		}
+		else
+		{
+			//pwrite直接写入系统缓存,回调时数据已经写入,可以保存续传状态
+			auto resumeItem = m_fileResumeMap.find(nFileId);
+			if (resumeItem != m_fileResumeMap.end() && nChunkSize == resumeItem->second.m_state.ChunkSize() &&
+				resumeItem->second.m_state.OnRecv(rspMsg.m_nDataIndex))
+			{
+				resumeItem->second.m_state.Save(resumeItem->second.m_strStatePath);
+			}
+		}
+		//确认写入期间到达的其他数据包
+		FileDataSendRspMsg ackMsg = rspMsg;
+		auto windowItem = m_fileRecvWindowMap.find(nFileId);
+		if (windowItem != m_fileRecvWindowMap.end())
+		{
+			ackMsg.m_nCumAckIndex = std::max(ackMsg.m_nCumAckIndex, windowItem->second.CumAckIndex());
+		}
+		sendRsp(ackMsg);
+	});
+	if (!bPost)
+	{
+		LOG_ERR(ms_loger, "File:{} Is Not Open Index:{} [{} {}]", nFileId, reqMsg.m_nDataIndex, __FILENAME__, __LINE__);
+		m_fileRecvHashMap.erase(nFileId);
+		sendRsp(rspMsg);
+	}
+	if (item->second.IsFinished())
+	{
+		m_fileIo.Close(nFileId);
+	}
+}
+
+/**
+ * @brief 结束文件接收,取得接收时计算的Hash
+ * 
+ * 所有数据包都已按顺序计算并且算法与发送端相同时直接使用结果,否则需要读取文件计算。
+ * @param nFileId 文件ID
+ * @param strPeerHash 发送端的Hash,用于确定算法
+ * @return std::string 接收时计算的Hash,无法使用时返回空字符串
+ */
+std::string CChatServer::FinishRecvHash(const int nFileId, const std::string& strPeerHash)
+{
+	FILE_HASH_TYPE eHashType = FILE_HASH_TYPE::HASH_MD5;
+	CFileHash::TypeOfHash(strPeerHash, eHashType);
+	std::string strFileHash;
+	auto windowItem = m_fileRecvWindowMap.find(nFileId);
+	auto hashItem = m_fileRecvHashMap.find(nFileId);
+	if (windowItem == m_fileRecvWindowMap.end() || hashItem == m_fileRecvHashMap.end() ||
+		hashItem->second.Type() != eHashType || !hashItem->second.Finish(windowItem->second.TotalCount(), strFileHash))
+	{
+		strFileHash.clear();
+	}
+	if (windowItem != m_fileRecvWindowMap.end())
+	{
+		m_fileRecvWindowMap.erase(windowItem);
+	}
+	if (hashItem != m_fileRecvHashMap.end())
+	{
+		m_fileRecvHashMap.erase(hashItem);
+	}
+	m_fileRecvLimitMap.erase(nFileId);
+	return strFileHash;
+}
+
+/**
+ * @brief 续传状态保存的文件,与上传的临时文件放在一起
+ * 
+ * @param strFileHash 文件Hash
+ * @return std::string 续传状态文件的路径,Hash不正确时返回空字符串
+ */
+std::string CChatServer::ResumeStatePath(const std::string& strFileHash)
+{
+	const std::string strName = CFileResumeState::StateFileName(strFileHash);
+	if (strName.empty())
+	{
+		return "";
+	}
+	if (m_blobStore.IsOpen())
+	{
+		return m_blobStore.TempPath(strName);
+	}
+	return GetImageDir() + strName;
+}
+
+/**
+ * @brief 开始可以续传的文件接收,上次中断时保存的状态与文件匹配时只接收缺少的数据包
+ * 
+ * @param req 文件发送数据开始请求
+ * @param strFileName 接收的文件
+ * @param rspMsg 续传时填入缺少的数据包范围
+ * @return true 已经打开文件
+ * @return false 发送端不支持续传或者文件无法续传,按原来的方式接收
+ */
+bool CChatServer::StartRecvResume(const FileSendDataBeginReq& req, const std::string& strFileName, FileSendDataBeginRsp& rspMsg)
+{
+	//旧版本的发送端没有文件长度和数据包长度
+	FileRecvResume_st resume;
+	resume.m_strUserId = req.m_strUserId;
+	resume.m_strStatePath = ResumeStatePath(req.m_strFileHash);
+	if (req.m_nFileSize <= 0 || req.m_nChunkSize <= 0 || resume.m_strStatePath.empty())
+	{
+		return false;
+	}
+	CFileResumeState& state = resume.m_state;
+	bool bResume = state.Load(resume.m_strStatePath) && state.IsMatch(req.m_strFileHash, req.m_nFileSize) &&
+		state.RecvCount() > 0 && m_fileUtil.IsFileExist(state.FileName());
+	if (bResume && state.FileName() != strFileName)
+	{
+		//相同内容的文件以不同的文件名上传
+		if (m_blobStore.IsOpen())
+		{
+			m_fileUtil.RemoveFile(strFileName);
+		}
+		bResume = !m_fileUtil.IsFileExist(strFileName) && 0 == std::rename(state.FileName().c_str(), strFileName.c_str());
+	}
+	if (!bResume)
+	{
+		//Image目录中同名的文件不能覆盖
+		if (!m_blobStore.IsOpen() && m_fileUtil.IsFileExist(strFileName))
+		{
+			return false;
+		}
+		m_fileUtil.RemoveFile(strFileName);
+		state = CFileResumeState(req.m_strFileHash, strFileName, req.m_nFileSize, req.m_nChunkSize);
+	}
+	state.SetFileName(strFileName);
+	state.Rebase(req.m_nChunkSize);
+	//离线文件在请求时已经打开
+	m_fileIo.Close(req.m_nFileId);
+	if (!m_fileIo.Open(req.m_nFileId, strFileName, FILE_OPEN_MODE::OPEN_RESUME))
+	{
+		LOG_ERR(ms_loger, "User:{} File:{} Open Failed [{} {}]", req.m_strUserId, strFileName, __FILENAME__, __LINE__);
+		return false;
+	}
+	CFileRecvWindow recvWindow(state.TotalCount());
+	for (int nIndex = 1; nIndex <= state.TotalCount(); nIndex++)
+	{
+		if (state.IsRecv(nIndex))
+		{
+			recvWindow.OnRecv(nIndex);
+		}
+	}
+	m_fileRecvWindowMap.erase(req.m_nFileId);
+	m_fileRecvWindowMap.insert({ req.m_nFileId, recvWindow });
+	state.Save(resume.m_strStatePath);
+	if (state.RecvCount() > 0)
+	{
+		rspMsg.m_bResume = true;
+		rspMsg.m_nChunkSize = req.m_nChunkSize;
+		rspMsg.m_missingRangeVec = state.MissingRanges();
+		LOG_INFO(ms_loger, "User:{} File:{} Resume Recv:{}/{} [{} {}]", req.m_strUserId, req.m_strFileName, state.RecvCount(), state.TotalCount(), __FILENAME__, __LINE__);
+	}
+	m_fileResumeMap.erase(req.m_nFileId);
+	m_fileResumeMap.insert({ req.m_nFileId, resume });
+	return true;
+}
+
+/**
+ * @brief 同一个用户重新上传正在接收的文件,之前的连接已经中断,暂停之前的接收以后续传
+ * 
+ * @param req 文件发送数据开始请求
+ * @return true 已经暂停之前的接收
+ * @return false 文件正在被其他用户上传
+ */
+bool CChatServer::TakeOverRecvFile(const FileSendDataBeginReq& req)
+{
+	for (const auto& item : m_fileResumeMap)
+	{
+		if (item.second.m_strUserId == req.m_strUserId && item.second.m_state.FileHash() == req.m_strFileHash)
+		{
+			const int nFileId = item.first;
+			SuspendRecvFile(nFileId);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief 暂停文件接收,保存续传状态并关闭文件,已经写入的数据保留
  * 
- * @param orgPassWord 原始密码
- * @return std::string 新的密码
+ * @param nFileId 文件ID
  */
-std::string CChatServer::GeneratePassword(const std::string orgPassWord)
+void CChatServer::SuspendRecvFile(const int nFileId)
 {
-	std::string strSalt = GenerateSalt();
-	std::string strOrg = strSalt + orgPassWord;
-	std::string strOrgHash = md5(strOrg);
-	return strSalt + strOrgHash;
+	auto item = m_fileResumeMap.find(nFileId);
+	if (item == m_fileResumeMap.end())
+	{
+		return;
+	}
+	m_fileIo.Close(nFileId);
+	item->second.m_state.Save(item->second.m_strStatePath);
+	m_fileRecvWindowMap.erase(nFileId);
+	m_fileRecvHashMap.erase(nFileId);
+	m_fileRecvLimitMap.erase(nFileId);
+	RemoveRecvingState(item->second.m_state.FileHash());
+	LOG_INFO(ms_loger, "User:{} File:{} Suspend Recv:{}/{} [{} {}]", item->second.m_strUserId, item->second.m_state.FileName(),
+		item->second.m_state.RecvCount(), item->second.m_state.TotalCount(), __FILENAME__, __LINE__);
+	m_fileResumeMap.erase(item);
 }
 
 /**
- * @brief 校验密码
+ * @brief 文件接收结束,删除续传状态
  * 
- * @param orgPassword 原始密码
- * @param dataBasePassword 数据库的密码
- * @return true 校验通过
- * @return false 校验失败
+ * @param nFileId 文件ID
  */
-bool CChatServer::VerifyPassword(const std::string orgPassword, const std::string dataBasePassword)
+void CChatServer::FinishRecvResume(const int nFileId)
 {
-	std::string strSalt = GetSaltFromPasswd(dataBasePassword);
-	std::string strPasswd = strSalt+md5(strSalt + orgPassword);
-	if (strPasswd == dataBasePassword)
-	{
-		return true;
-	}
-	else
+	auto item = m_fileResumeMap.find(nFileId);
+	if (item != m_fileResumeMap.end())
 	{
-		return false;
+		m_fileUtil.RemoveFile(item->second.m_strStatePath);
+		m_fileResumeMap.erase(item);
 	}
 }
 
 /**
- * @brief 根据用户ID和文件名，拼接出文件全路径
+ * @brief TCP消息处理,处理文件数据请求消息
  * 
- * @param strUserId 用户ID
- * @param strFileName 文件名
- * @return std::string 文件全路径
+ * @param pSess 用户会话
+ * @param reqMsg 文件数据请求消息
  */
-std::string CChatServer::GetFilePathByUserIdAndFileName(const std::string strUserId, const std::string strFileName)
+void CChatServer::HandleFileDataSendReq(const std::shared_ptr<CServerSess>& pSess, const FileDataSendReqMsg& reqMsg)
 {
-	return GetFolderByUserId(strUserId) + strFileName;
+	DoFileDataSendReq(reqMsg, [pSess](const FileDataSendRspMsg& rspMsg) {
+		pSess->SendMsg(&rspMsg);
+	});
 }
 
 /**
- * @brief 根据用户ID获取对应的文件夹
+ * @brief 开始按滑动窗口发送文件,窗口内的数据包连续发出,不等待前一个数据包的确认
  * 
- * @param strUserId 用户ID
- * @return std::string 用户ID对应的文件夹
+ * @param sendWindow 文件发送的状态
  */
-std::string CChatServer::GetFolderByUserId(const std::string strUserId)
+void CChatServer::StartFileDataSend(const FileSendWindow_st& sendWindow)
 {
-	std::string strFolder = m_fileUtil.GetCurDir() + "\\" + strUserId+"\\";
-	return strFolder;
+	int nFileId = sendWindow.m_reqMsg.m_nFileId;
+	m_fileSendWindowMap.erase(nFileId);
+	m_fileSendWindowMap.insert({ nFileId, sendWindow });
+	SendFileDataWindow(nFileId);
+	auto item = m_fileSendWindowMap.find(nFileId);
+	if (item != m_fileSendWindowMap.end() && item->second.m_window.IsFinished())
+	{
+		//空文件或者续传时接收端已经有全部数据,直接校验
+		FileDataRecvRspMsg rspMsg;
+		rspMsg.m_nFileId = nFileId;
+		rspMsg.m_strUserId = item->second.m_reqMsg.m_strUserId;
+		rspMsg.m_strFriendId = item->second.m_reqMsg.m_strFriendId;
+		rspMsg.m_nDataTotalCount = item->second.m_window.TotalCount();
+		rspMsg.m_nCumAckIndex = rspMsg.m_nDataTotalCount;
+		OnFileDataRecvRsp(rspMsg);
+		return;
+	}
+	SetFileTimer();
 }
 
 /**
- * @brief 根据文件Hash判断是否正在接收
+ * @brief 发送窗口内所有还没有发送的数据包
  * 
- * @param strFileHash 文件HASH值
- * @return true 正在接收
- * @return false 没有在接收
+ * @param nFileId 文件ID
  */
-bool CChatServer::IsFileRecving(const std::string strFileHash)
+void CChatServer::SendFileDataWindow(const int nFileId)
 {
-	auto item = std::find(m_strRecvFileHashVec.begin(), m_strRecvFileHashVec.end(), strFileHash);
-	if (item != m_strRecvFileHashVec.end())
-	{
-		return true;
-	}
-	else
+	auto item = m_fileSendWindowMap.find(nFileId);
+	if (item != m_fileSendWindowMap.end())
 	{
-		return false;
+		int nIndex = 0;
+		while (item->second.m_window.NextSendIndex(nIndex))
+		{
+			if (!SendFileDataChunk(item->second, nIndex))
+			{
+				break;
+			}
+		}
 	}
 }
 
 /**
- * @brief 根据文件HASH判断文件是否正在发送中
+ * @brief 按索引读取并发送一个数据包,首次发送和重传都使用此函数
  * 
- * @param strFileHash 文件Hash值
- * @return true 正在发生
- * @return false 没有在发送
+ * 数据在文件读写线程上读取,读取完成以后在业务strand上发送,同一个文件按投递顺序完成。
+ * 会话支持sendfile时只生成帧头,文件数据由会话直接从文件写入socket。
+ * @param sendWindow 文件发送的状态
+ * @param nIndex 数据包索引
+ * @return true 已经投递读取或者交给会话发送
+ * @return false 文件没有打开或者对端不可达
  */
-bool CChatServer::IsFileSending(const std::string strFileHash)
+bool CChatServer::SendFileDataChunk(FileSendWindow_st& sendWindow, const int nIndex)
 {
-	auto item = std::find(m_strSendFileHashVec.begin(), m_strSendFileHashVec.end(), strFileHash);
-	if (item != m_strSendFileHashVec.end())
+	const int nFileId = sendWindow.m_reqMsg.m_nFileId;
+	const int64_t nOffset = static_cast<int64_t>(nIndex - 1) * sendWindow.m_reqMsg.m_nChunkSize;
+	if (sendWindow.m_sendFileFunc)
 	{
-		return true;
+		//文件数据由会话用sendfile直接从文件写入socket
+		auto pFile = m_fileIo.FindFile(nFileId);
+		if (!pFile)
+		{
+			LOG_ERR(ms_loger, "File:{} Is Not Open Index:{} [{} {}]", nFileId, nIndex, __FILENAME__, __LINE__);
+			return false;
+		}
+		FileDataRecvReqMsg& sendReqMsg = sendWindow.m_reqMsg;
+		sendReqMsg.m_nDataIndex = nIndex;
+		sendReqMsg.m_nDataLength = static_cast<int>(std::min<int64_t>(sendReqMsg.m_nChunkSize, sendWindow.m_nFileSize - nOffset));
+		sendReqMsg.m_dataVec.clear();
+		return sendWindow.m_sendFileFunc(sendReqMsg, pFile, nOffset);
 	}
-	else
+	auto pSelf = shared_from_this();
+	bool bPost = m_fileIo.ReadAt(nFileId, nOffset, static_cast<std::size_t>(sendWindow.m_reqMsg.m_nChunkSize), m_strand,
+		[this, pSelf, nFileId, nIndex](bool bOk, std::vector<char>& dataVec) {
+		//读取期间文件已经发送完成或者放弃发送
+		auto item = m_fileSendWindowMap.find(nFileId);
+		if (item == m_fileSendWindowMap.end())
+		{
+			return;
+		}
+		if (!bOk)
+		{
+			LOG_ERR(ms_loger, "File:{} Read Index:{} Failed [{} {}]", nFileId, nIndex, __FILENAME__, __LINE__);
+			return;
+		}
+		FileSendWindow_st& sendWindow = item->second;
+		if (sendWindow.m_strFileHash.empty())
+		{
+			//首次发送按索引顺序,重传的数据包已经计算过
+			sendWindow.m_chunkHash.OnChunk(nIndex, dataVec.data(), dataVec.size());
+		}
+		//同一个文件的数据包使用相同的消息ID,以索引区分
+		FileDataRecvReqMsg& sendReqMsg = sendWindow.m_reqMsg;
+		sendReqMsg.m_nDataIndex = nIndex;
+		sendReqMsg.m_nDataLength = static_cast<int>(dataVec.size());
+		sendReqMsg.m_dataVec = std::move(dataVec);
+		sendWindow.m_sendFunc(sendReqMsg);
+	});
+	if (!bPost)
 	{
-		return false;
+		LOG_ERR(ms_loger, "File:{} Is Not Open Index:{} [{} {}]", nFileId, nIndex, __FILENAME__, __LINE__);
 	}
+	return bPost;
 }
 
 /**
- * @brief 保存接收状态
+ * @brief 处理文件数据的确认,滑动窗口并发送新的数据包,全部确认后发送文件校验请求
  * 
- * @param strFileHash 文件hash值
- * @return true 保存成功
- * @return false 保存失败
+ * @param rspMsg 文件数据接收回复消息
  */
-bool CChatServer::SaveRecvingState(const std::string strFileHash)
+void CChatServer::OnFileDataRecvRsp(const FileDataRecvRspMsg& rspMsg)
 {
-	if (IsFileRecving(strFileHash))
+	auto item = m_fileSendWindowMap.find(rspMsg.m_nFileId);
+	if (item == m_fileSendWindowMap.end())
 	{
-		return false;
+		return;
 	}
-	else
+	item->second.m_window.OnAck(rspMsg.m_nCumAckIndex, rspMsg.m_nDataIndex);
+	if (!item->second.m_window.IsFinished())
 	{
-		m_strRecvFileHashVec.push_back(strFileHash);
-		return true;
+		SendFileDataWindow(rspMsg.m_nFileId);
+		return;
 	}
-}
 
+	std::string strFileName = m_fileIo.FileName(rspMsg.m_nFileId);
+	m_fileIo.Close(rspMsg.m_nFileId);
+	FileVerifyReqMsg reqMsg;
+	reqMsg.m_nFileId = rspMsg.m_nFileId;
+	reqMsg.m_strMsgId = CreateMsgId();
+	reqMsg.m_strUserId = rspMsg.m_strUserId;
+	reqMsg.m_strFriendId = rspMsg.m_strFriendId;
+	reqMsg.m_strFileName = item->second.m_strFileName.empty() ? m_fileUtil.GetFileNameFromPath(strFileName) : item->second.m_strFileName;
+	//按Hash保存的文件使用保存时的Hash,其他文件使用发送时计算的Hash
+	reqMsg.m_strFileHash = item->second.m_strFileHash;
+	bool bHash = !reqMsg.m_strFileHash.empty() || item->second.m_chunkHash.Finish(item->second.m_window.TotalCount(), reqMsg.m_strFileHash);
+	m_fileSendWindowMap.erase(item);
+	if (bHash)
+	{
+		SendFileVerifyReq(reqMsg, strFileName);
+		return;
+	}
+	//发送时没有算出Hash,在文件读写线程上读取文件计算
+	auto pSelf = shared_from_this();
+	m_fileIo.Post(reqMsg.m_nFileId, [strFileName]() {
+		return CFileHash::CalcFile(strFileName, FILE_HASH_TYPE::HASH_MD5);
+	}, m_strand, [this, pSelf, reqMsg, strFileName](const std::string& strFileHash) {
+		FileVerifyReqMsg verifyMsg = reqMsg;
+		verifyMsg.m_strFileHash = strFileHash;
+		SendFileVerifyReq(verifyMsg, strFileName);
+	});
+}
 
 /**
- * @brief 移除接收状态
+ * @brief 文件的数据包全部确认以后,向接收端发送文件校验请求
  * 
- * @param strFileHash 文件hash值
- * @return true 移除成功
- * @return false 移除失败
+ * @param reqMsg 文件校验请求,已经填入文件的Hash
+ * @param strFileName 发送的文件
  */
-bool CChatServer::RemoveRecvingState(const std::string strFileHash)
+void CChatServer::SendFileVerifyReq(FileVerifyReqMsg& reqMsg, const std::string& strFileName)
 {
-	if (IsFileRecving(strFileHash))
+	RemoveSendingState(reqMsg.m_strFileHash);
+	m_fileUtil.GetFileSize(reqMsg.m_nFileSize, strFileName);
+
+	auto sessItem = m_presence.GetSess(reqMsg.m_strUserId);
+	if (sessItem && sessItem->IsConnected())
 	{
-		auto item = std::find(m_strRecvFileHashVec.begin(), m_strRecvFileHashVec.end(), strFileHash);
-		m_strRecvFileHashVec.erase(item);
-		return true;
+		sessItem->SendMsg(&reqMsg);
 	}
-	return false;
 }
 
 /**
- * @brief 保存文件的发送状态
+ * @brief 启动文件数据包重传的定时器,没有正在发送的文件时定时器停止
  * 
- * @param strFileHash 文件hash值
- * @return true 保存成功
- * @return false 保存失败
  */
-bool CChatServer::SaveSendingState(const std::string strFileHash)
+void CChatServer::SetFileTimer()
 {
-	if (IsFileSending(strFileHash))
-	{
-		return false;
-	}
-	else
+	if (m_bFileTimerRun || m_fileSendWindowMap.empty() || !m_fileTimer)
 	{
-		m_strSendFileHashVec.push_back(strFileHash);
-		return true;
+		return;
 	}
+	m_bFileTimerRun = true;
+	m_fileTimer->expires_from_now(std::chrono::milliseconds(CFileSendWindow::RETRANS_TIMEOUT_MS / 2));
+	auto self = shared_from_this();
+	m_fileTimer->async_wait(m_strand.wrap([this, self](const std::error_code& ec) {
+		m_bFileTimerRun = false;
+		if (!ec)
+		{
+			this->OnFileTimer();
+			this->SetFileTimer();
+		}
+	}));
 }
 
 /**
- * @brief 移除文件发送状态
+ * @brief 重传超时的文件数据包,长时间没有确认的文件放弃发送
  * 
- * @param strFileHash 文件Hash值
- * @return true 移除成功
- * @return false 移除失败
  */
-bool CChatServer::RemoveSendingState(const std::string strFileHash)
+void CChatServer::OnFileTimer()
 {
-	if (IsFileSending(strFileHash))
+	auto item = m_fileSendWindowMap.begin();
+	while (item != m_fileSendWindowMap.end())
 	{
-		auto item = std::find(m_strSendFileHashVec.begin(), m_strSendFileHashVec.end(), strFileHash);
-		m_strSendFileHashVec.erase(item);
-		return true;
-	}
-	else {
-		return false;
+		auto indexVec = item->second.m_window.TimeoutIndexes(std::chrono::milliseconds(CFileSendWindow::RETRANS_TIMEOUT_MS));
+		if (item->second.m_window.TimeoutRounds() > CFileSendWindow::MAX_TIMEOUT_ROUNDS)
+		{
+			LOG_WARN(ms_loger, "User:{} File:{} Send Timeout At:{} [{} {}]", item->second.m_reqMsg.m_strUserId, item->first, item->second.m_window.CumAckIndex(), __FILENAME__, __LINE__);
+			m_fileIo.Close(item->first);
+			item = m_fileSendWindowMap.erase(item);
+			continue;
+		}
+		for (const auto nIndex : indexVec)
+		{
+			SendFileDataChunk(item->second, nIndex);
+		}
+		item++;
 	}
 }
 
 /**
- * @brief 
- * @TODO:
- * @param strUserId 
+ * @brief 获取图片的路径
+ * 
+ * @return std::string 获取服务器保存图片的文件夹
  */
-void CChatServer::CheckFileDataRsp(const std::string strUserId)
+std::string CChatServer::GetImageDir()
 {
-	auto item = m_fileDataRspMap.find(strUserId);
-	if (item != m_fileDataRspMap.end())
+	std::string strImageDir = m_fileUtil.GetCurDir() + "Image\\";
+	if (!m_fileUtil.IsFolder(strImageDir))
 	{
-		/*auto udpAddrItem = m_userIdUdpAddrMap.find(strUserId);
-		if (udpAddrItem != m_userIdUdpAddrMap.end())
-		{
-			for (const auto msgItem : item->second)
-			{
-				m_udpServer->sendMsg(udpAddrItem->second.m_strServerIp, udpAddrItem->second.m_nPort, &(msgItem.second));
-			}
-		}*/
+		m_fileUtil.CreateFolder(strImageDir);
 	}
+	return strImageDir;
 }
 
 /**
- * @brief 
- * TODO:
- * @param reqMsg 
+ * @brief 获取服务器保存文件的文件夹
+ * 
+ * @return std::string 保存文件的文件夹
  */
-void CChatServer::CheckFileVerifyReq(const FileVerifyReqMsg& reqMsg)
+std::string CChatServer::GetFileDir()
 {
-	auto item = m_fileDataRspMap.find(reqMsg.m_strUserId);
-	if (item != m_fileDataRspMap.end())
+	std::string strFileDir = m_fileUtil.GetCurDir() + "File\\";
+	if (!m_fileUtil.IsFolder(strFileDir))
 	{
-		item->second.erase(reqMsg.m_nFileId);
+		m_fileUtil.CreateFolder(strFileDir);
 	}
+	return strFileDir;
 }
 
 /**
- * @brief 保存发送文件回复消息
- * TODO:
- * @param rspMsg 文件数据发送回复消息
+ * @brief 打开按内容Hash保存图片和文件的存储,打开失败时按文件名保存在Image目录
+ * 
  */
-void CChatServer::SaveFileDataRsp(const FileDataSendRspMsg& rspMsg)
+void CChatServer::StartBlobStore()
 {
-	auto item = m_fileDataRspMap.find(rspMsg.m_strUserId);
-	if (item != m_fileDataRspMap.end())
+	if (m_strBlobDir.empty())
 	{
-		m_fileDataRspMap[rspMsg.m_strUserId].erase(rspMsg.m_nFileId);
-		m_fileDataRspMap[rspMsg.m_strUserId].insert({ rspMsg.m_nFileId,rspMsg });
+		LOG_INFO(ms_loger, "Blob Store Disabled [{} {}]", __FILENAME__, __LINE__);
+		return;
 	}
-	else
+	if (!m_blobStore.Open(m_strBlobDir))
 	{
-		FILE_ID_RSP_MSG_MAP rspMap;
-		rspMap.insert({ rspMsg.m_nFileId,rspMsg });
-		m_fileDataRspMap.insert({ rspMsg.m_strUserId,rspMap });
+		LOG_WARN(ms_loger, "Blob Store Open {} Failed, Save File By Name [{} {}]", m_strBlobDir, __FILENAME__, __LINE__);
+		return;
 	}
+	LOG_INFO(ms_loger, "Blob Store {} {} [{} {}]", m_strBlobDir, m_blobStore.Stat().ToString(), __FILENAME__, __LINE__);
 }
 
 /**
- * @brief 关闭某个用户正在发生和接收的文件,用户断开连接的时候调用
+ * @brief 上传的文件写入的路径,按Hash保存时先写入临时文件,校验通过以后再放入存储
  * 
- * @param strUserId 用户ID
+ * @param strFileName 文件名
+ * @return std::string 上传文件的路径
  */
-void CChatServer::CloseUserFile(const std::string strUserId)
+std::string CChatServer::UploadFilePath(const std::string& strFileName)
 {
-	auto item = m_fileDataRspMap.find(strUserId);
-	if (item != m_fileDataRspMap.end())
+	if (m_blobStore.IsOpen())
 	{
-		for (const auto msgItem : item->second)
-		{
-			std::string strFileName = m_fileUtil.GetFileName(msgItem.second.m_nFileId);
-			m_fileUtil.OnCloseFile(msgItem.second.m_nFileId);
-			m_fileUtil.RemoveFile(strFileName);
-		}
+		return m_blobStore.TempPath(strFileName);
 	}
+	return GetImageDir() + strFileName;
 }
 
-
 /**
- * @brief 实际处理文件数据发送请求消息
+ * @brief 校验通过的上传文件按Hash保存,相同内容已经存在时只增加引用
  * 
- * @param reqMsg 文件数据发送请求消息
- * @return TransBaseMsg_S_PTR 文件数据发送回复消息
+ * @param strFileName 文件名
+ * @param digest 校验过的文件Hash,以BLAKE2b为键保存
+ * @return true 保存成功,保存失败时文件移动到Image目录按文件名保存
+ * @return false 文件名已经引用其他内容,上传的文件已经删除
  */
-FileDataSendRspMsg CChatServer::DoFileDataSendReq(const FileDataSendReqMsg& reqMsg)
+bool CChatServer::CommitUploadFile(const std::string& strFileName, const FileDigest_st& digest)
 {
-	m_fileUtil.OnWriteData(reqMsg.m_nFileId, reqMsg.m_szData, reqMsg.m_nDataLength);
-	if (reqMsg.m_nDataIndex == reqMsg.m_nDataTotalCount)
+	if (!m_blobStore.IsOpen())
 	{
-		m_fileUtil.OnCloseFile(reqMsg.m_nFileId);
+		return true;
 	}
+	const std::string strUploadPath = UploadFilePath(strFileName);
+	const std::string& strFileHash = digest.m_strBlake2b;
+	std::string strOldHash;
+	if (m_blobStore.FindName(strFileName, strOldHash) && strOldHash != CBlobStore::NormalizeHash(strFileHash))
 	{
-		FileDataSendRspMsg sendRsp;
-		sendRsp.m_strMsgId = reqMsg.m_strMsgId;
-		sendRsp.m_strUserId = reqMsg.m_strUserId;
-		sendRsp.m_strFriendId = reqMsg.m_strFriendId;
-		sendRsp.m_nFileId = reqMsg.m_nFileId;
-		sendRsp.m_nDataTotalCount = reqMsg.m_nDataTotalCount;
-		sendRsp.m_nDataIndex = reqMsg.m_nDataIndex;
-		return sendRsp;
+		LOG_WARN(ms_loger, "File:{} Hash:{} Name Is Used By Hash:{} [{} {}]", strFileName, strFileHash, strOldHash, __FILENAME__, __LINE__);
+		m_fileUtil.RemoveFile(strUploadPath);
+		return false;
 	}
+	if (m_blobStore.Commit(strUploadPath, strFileName, strFileHash, digest.m_strMd5))
+	{
+		return true;
+	}
+	LOG_ERR(ms_loger, "File:{} Hash:{} Save To Blob Store Failed [{} {}]", strFileName, strFileHash, __FILENAME__, __LINE__);
+	std::rename(strUploadPath.c_str(), (GetImageDir() + strFileName).c_str());
+	return false;
 }
 
 /**
- * @brief TCP消息处理,处理文件数据请求消息
- * 
- * @param pSess 用户会话
- * @param reqMsg 文件数据请求消息
- */
-void CChatServer::HandleFileDataSendReq(const std::shared_ptr<CServerSess>& pSess, const FileDataSendReqMsg& reqMsg)
-{
-	auto pMsg = DoFileDataSendReq(reqMsg);
-	pSess->SendMsg(&pMsg);
-}
-
-/**
- * @brief 获取图片的路径
+ * @brief 查找按Hash保存的文件,只查找内存中的索引
  * 
- * @return std::string 获取服务器保存图片的文件夹
+ * 有MD5时使用MD5,旧版本的客户端只能校验MD5
+ * @param strName 文件名
+ * @param strFilePath 文件的路径
+ * @param strFileHash 文件的Hash
+ * @return true 文件存在
+ * @return false 文件名没有按Hash保存
  */
-std::string CChatServer::GetImageDir()
+bool CChatServer::FindBlobFile(const std::string& strName, std::string& strFilePath, std::string& strFileHash)
 {
-	std::string strImageDir = m_fileUtil.GetCurDir() + "Image\\";
-	if (!m_fileUtil.IsFolder(strImageDir))
+	std::string strBlobHash;
+	if (!m_blobStore.IsOpen() || !m_blobStore.FindName(strName, strBlobHash))
 	{
-		m_fileUtil.CreateFolder(strImageDir);
+		return false;
 	}
-	return strImageDir;
+	strFilePath = m_blobStore.BlobPath(strBlobHash);
+	const BlobInfo_st* pBlob = m_blobStore.FindBlob(strBlobHash);
+	strFileHash = (nullptr == pBlob || pBlob->m_strMd5.empty()) ? strBlobHash : pBlob->m_strMd5;
+	return true;
 }
 
 /**
- * @brief 获取服务器保存文件的文件夹
+ * @brief 查找文件名对应的文件和Hash,结果在业务strand上交给done
  * 
- * @return std::string 保存文件的文件夹
+ * 按Hash保存的文件直接使用保存时的Hash。Image目录中按文件名保存的文件在文件读写线程上计算一次Hash,
+ * 然后在业务strand上放入存储。
+ * @param nFileId 计算Hash使用的文件ID,与之后发送该文件使用同一个工作线程
+ * @param strFileName 文件名
+ * @param done 参数为(文件是否存在, 文件的路径, 文件的Hash)
  */
-std::string CChatServer::GetFileDir()
+void CChatServer::FindStoredFile(const int nFileId, const std::string& strFileName, StoredFileDone done)
 {
-	std::string strFileDir = m_fileUtil.GetCurDir() + "File\\";
-	if (!m_fileUtil.IsFolder(strFileDir))
+	const std::string strName = m_fileUtil.GetFileNameFromPath(strFileName);
+	std::string strFilePath;
+	std::string strFileHash;
+	if (FindBlobFile(strName, strFilePath, strFileHash))
 	{
-		m_fileUtil.CreateFolder(strFileDir);
+		done(true, strFilePath, strFileHash);
+		return;
 	}
-	return strFileDir;
+	strFilePath = GetImageDir() + strName;
+	auto pSelf = shared_from_this();
+	m_fileIo.Post(nFileId, [strFilePath]() {
+		FileDigest_st digest;
+		CFileHash::CalcFile(strFilePath, digest);
+		return digest;
+	}, m_strand, [this, pSelf, strName, strFilePath, done](const FileDigest_st& digest) {
+		if (digest.m_strMd5.empty())
+		{
+			done(false, strFilePath, "");
+			return;
+		}
+		//计算期间同一个文件可能已经被其他下载放入存储
+		std::string strBlobPath;
+		std::string strBlobHash;
+		if (FindBlobFile(strName, strBlobPath, strBlobHash))
+		{
+			done(true, strBlobPath, strBlobHash);
+			return;
+		}
+		if (m_blobStore.IsOpen() && m_blobStore.Commit(strFilePath, strName, digest.m_strBlake2b, digest.m_strMd5))
+		{
+			LOG_INFO(ms_loger, "File:{} Hash:{} Move To Blob Store [{} {}]", strFilePath, digest.m_strBlake2b, __FILENAME__, __LINE__);
+			done(true, m_blobStore.BlobPath(digest.m_strBlake2b), digest.m_strMd5);
+			return;
+		}
+		done(true, strFilePath, digest.m_strMd5);
+	});
 }
 }
\ No newline at end of file
@@ -12,10 +12,16 @@
 #ifndef _MEDIUM_SERVER_C_MEDIUM_SERVER_H_
 #define _MEDIUM_SERVER_C_MEDIUM_SERVER_H_
 
+#include <deque>
 #include <functional>
 
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "CommonMsg.h"
 #include "Log.h"
 #include "asio_common.h"
@@ -28,6 +34,19 @@
 #include "CMySqlConnect.h"
 #include "SnowFlake.h"
 #include "CFileUtil.h"
+#include "CFileTransWindow.h"
+#include "CFileHash.h"
+#include "CFileResume.h"
+#include "CMsgDispatcher.h"
+#include "CDbExecutor.h"
+#include "CFileIoEngine.h"
+#include "CFriendGraphCache.h"
+#include "CUnReadMsgWindow.h"
+#include "CGroupMsgCache.h"
+#include "CChatMsgJournal.h"
+#include "CChatArchive.h"
+#include "CPresenceRegistry.h"
+#include "CBlobStore.h"
 
 struct SendFileInfo_st
 {
@@ -35,36 +54,98 @@ struct SendFileInfo_st
 	int         m_nFileId;
 	time_t      m_lastPackageTime;
 };
-using FILE_ID_RSP_MSG_MAP = std::map<int, FileDataSendRspMsg>;
-using USER_FILE_DATA_RSP_MAP=std::map<std::string, FILE_ID_RSP_MSG_MAP>;
-struct UserIdGroupId_st
+/**
+ * @brief 服务器按滑动窗口发送文件的状态
+ * 
+ */
+struct FileSendWindow_st
 {
-	std::string m_strUserId;
-	std::string m_strGroupId;
-	bool operator <(const UserIdGroupId_st& other) const
-	{
-		if (m_strUserId < other.m_strUserId)
-		{
-			return true;
-		}
-
-		if ((m_strUserId >= other.m_strUserId) && (m_strGroupId < other.m_strGroupId))
-		{
-			return true;
-		}
-
-		return false;
-	}
+	CFileSendWindow m_window;//发送窗口
+	FileDataRecvReqMsg m_reqMsg;//数据包共用的字段,每次发送时填入索引和数据
+	std::function<bool(const FileDataRecvReqMsg&)> m_sendFunc;//发送一个数据包,对端不可达时返回false
+	std::function<bool(const FileDataRecvReqMsg&, const std::shared_ptr<CIoFile>&, const int64_t)> m_sendFileFunc;//用sendfile发送一个数据包的文件数据,为空时读取以后发送
+	int m_nFileSize = 0;//文件大小,用于计算最后一个数据包的长度
+	std::string m_strFileName;//文件名
+	std::string m_strFileHash;//保存文件时记录的Hash,发送完成时不再计算
+	CChunkHash m_chunkHash;//没有记录Hash的文件,发送时按数据包计算
+};
+/**
+ * @brief 服务器接收文件的断点续传状态,连接断开以后保留已经写入的数据
+ * 
+ */
+struct FileRecvResume_st
+{
+	std::string m_strUserId;//上传文件的用户
+	std::string m_strStatePath;//续传状态保存的文件
+	CFileResumeState m_state;
+};
+/**
+ * @brief 服务器接收文件时对数据包的限制,开始接收时确定,不使用数据包中发送端给出的值
+ * 
+ */
+struct FileRecvLimit_st
+{
+	int m_nChunkSize = FILE_DATA_CHUNK_SIZE;//协商的数据包长度,每个数据包的分包大小必须相同
+	int m_nMaxCount = 0;//数据包总数的上限,按文件大小计算,文件大小未知时按最大的文件大小计算
+};
+/**
+ * @brief 按窗口下发离线好友消息的状态
+ * 
+ */
+struct FriendMsgDrain_st
+{
+	explicit FriendMsgDrain_st(const int nWindowSize) :m_window(nWindowSize) {}
+	CUnReadMsgWindow m_window;//下发窗口
+	std::deque<T_USER_CHAT_MSG> m_msgQueue;//已经从数据库读取还没有下发的消息
+	bool m_bFlushing = false;//是否正在把已确认的消息更新为已读
+	bool m_bLoading = false;//是否正在读取下一页未读消息
+};
+/**
+ * @brief 获取好友列表时在连接池上查询到的分组和好友资料
+ * 
+ */
+struct FriendListQuery_st
+{
+	bool m_bHasTeam = false;//是否查询到用户的分组,查询不到时用户不存在
+	std::vector<T_USER_TEAM_BEAN> m_teamVec;//用户的分组
+	std::vector<T_FRIEND_INFO_BEAN> m_friendVec;//好友关系和好友资料
 };
+/**
+ * @brief 通知添加好友结果时在连接池上查询到的消息
+ * 
+ */
+struct AddFriendNotifyQuery_st
+{
+	bool m_bHasMsg = false;//是否有没有通知的添加好友消息
+	bool m_bNotFriend = false;//查询时双方是否还不是好友,已经是好友时不再通知
+	bool m_bAddRelation = false;//是否插入了双方的好友关系
+	T_ADD_FRIEND_MSG_BEAN m_msgBean;//没有通知的添加好友消息
+};
+using FILE_ID_RSP_MSG_MAP = std::map<int, FileDataSendRspMsg>;
+using USER_FILE_DATA_RSP_MAP=std::map<std::string, FILE_ID_RSP_MSG_MAP>;
 namespace ChatServer
 {
 
 using tcp = asio::ip::tcp;
 
+/**
+ * @brief 在线用户的一个分片,和CPresenceRegistry的分片一一对应
+ * 
+ * 分片中用户的TCP消息、在线记录和离线好友消息的下发都在分片的strand上处理,不同分片的用户在不同的线程上并行
+ */
+struct UserShard_st
+{
+	explicit UserShard_st(asio::io_service& ioService) :m_strand(ioService) {}
+	asio::io_service::strand m_strand;
+	CMsgDispatcher<const std::shared_ptr<CServerSess>&> m_tcpDispatcher;//从全局的分发器复制,统计各自记录
+	std::map<std::string, FriendMsgDrain_st> m_friendMsgDrainMap;//正在下发离线好友消息的用户
+};
+
 class CChatServer : public std::enable_shared_from_this<CChatServer>
 {
 public:
 	void DispatchRecvTcpMsg(const std::shared_ptr<CServerSess> pSess, const TransBaseMsg_t* pMsg);
+	void PostRecvTcpMsg(const std::shared_ptr<CServerSess> pSess, const TransBaseMsg_S_PTR pMsg);
 	void OnSessClose(const std::shared_ptr<CServerSess>& pSess);
 	
 	
@@ -73,36 +154,36 @@ public:
 	//void HandleUserLoginReq(const std::shared_ptr<CServerSess>& pSess, const UserLoginReqMsg& reqMsg);
 	//void HandleUserLoginReq(const std::shared_ptr<CServerSess>& pSess, const UserLoginReqMsg& reqMsg);
 	
-    UserLoginRspMsg DoUserLoginReq(const UserLoginReqMsg& reqMsg);
-	UserLogoutRspMsg DoUserLogoutReq(const UserLogoutReqMsg& reqMsg);
-	UserRegisterRspMsg DoUserRegisterReq(const UserRegisterReqMsg& reqMsg);
-	UserUnRegisterRspMsg DoUserUnRegisterReq(const UserUnRegisterReqMsg& reqMsg);
-	FriendChatSendTxtRspMsg DoFriendChatSendTxtReq(const FriendChatSendTxtReqMsg& reqMsg);
-	AddFriendSendRspMsg DoAddFriendReq(const AddFriendSendReqMsg& reqMsg);
+    UserLoginRspMsg DoUserLoginReq(CMySqlConnect& util, const UserLoginReqMsg& reqMsg);
+	UserLogoutRspMsg DoUserLogoutReq(CMySqlConnect& util, const UserLogoutReqMsg& reqMsg);
+	UserRegisterRspMsg DoUserRegisterReq(CMySqlConnect& util, const UserRegisterReqMsg& reqMsg);
+	UserUnRegisterRspMsg DoUserUnRegisterReq(CMySqlConnect& util, const UserUnRegisterReqMsg& reqMsg);
+	FriendChatSendTxtRspMsg DoFriendChatSendTxtReq(CMySqlConnect& util, const FriendChatSendTxtReqMsg& reqMsg, const T_USER_CHAT_MSG& chatMsg);
+	bool DoSaveChatMsgBatch(CMySqlConnect& util, const ChatMsgJournalBatch_st& batch);
+	AddFriendSendRspMsg DoAddFriendReq(CMySqlConnect& util, const AddFriendSendReqMsg& reqMsg);
 
-	GetFriendListRspMsg DoGetFriendReq(const GetFriendListReqMsg & reqMsg);
+	GetFriendListRspMsg DoGetFriendReq(const GetFriendListReqMsg & reqMsg, const FriendListQuery_st& query);
 
-	RemoveFriendRspMsg DoRemoveFriendReq(const RemoveFriendReqMsg& reqMsg);
-	FindFriendRspMsg   DoFindFriendReq(const FindFriendReqMsg& reqMsg);
-	AddTeamRspMsg DoAddTeamReq(const AddTeamReqMsg& reqMsg);
-	RemoveTeamRspMsg DoRemoveTeamReq(const RemoveTeamReqMsg& reqMsg);
-	MoveFriendToTeamRspMsg DoMoveFriendToTeamReq(const MoveFriendToTeamReqMsg& reqMsg);
+	RemoveFriendRspMsg DoRemoveFriendReq(CMySqlConnect& util, const RemoveFriendReqMsg& reqMsg);
+	FindFriendRspMsg   DoFindFriendReq(CMySqlConnect& util, const FindFriendReqMsg& reqMsg);
+	AddTeamRspMsg DoAddTeamReq(CMySqlConnect& util, const AddTeamReqMsg& reqMsg);
+	RemoveTeamRspMsg DoRemoveTeamReq(CMySqlConnect& util, const RemoveTeamReqMsg& reqMsg);
+	MoveFriendToTeamRspMsg DoMoveFriendToTeamReq(CMySqlConnect& util, const MoveFriendToTeamReqMsg& reqMsg);
 
-	CreateGroupRspMsg DoCreateGroupReq(const CreateGroupReqMsg& reqMsg);
+	CreateGroupRspMsg DoCreateGroupReq(CMySqlConnect& util, const CreateGroupReqMsg& reqMsg);
 
-	DestroyGroupRspMsg DoDestroyGroupReq(const DestroyGroupReqMsg& reqMsg);
+	DestroyGroupRspMsg DoDestroyGroupReq(CMySqlConnect& util, const DestroyGroupReqMsg& reqMsg);
 
-	GetGroupListRspMsg DoGetGroupListReq(const GetGroupListReqMsg& reqMsg);
+	GetGroupListRspMsg DoGetGroupListReq(CMySqlConnect& util, const GetGroupListReqMsg& reqMsg);
 
-	FindGroupRspMsg DoFindGroupReq(const FindGroupReqMsg& reqMsg);
+	FindGroupRspMsg DoFindGroupReq(CMySqlConnect& util, const FindGroupReqMsg& reqMsg);
 
-	SendGroupTextMsgRspMsg DoSendGroupTextMsgReqMsg(const SendGroupTextMsgReqMsg& reqMsg);
+	SendGroupTextMsgRspMsg DoSendGroupTextMsgReqMsg(CMySqlConnect& util, const SendGroupTextMsgReqMsg& reqMsg, const T_GROUP_CHAT_MSG& chatMsg);
 
-	AddToGroupRspMsg DoAddToGroupReqMsg(const AddToGroupReqMsg& reqMsg);
-	QuitFromGroupRspMsg DoQuitFromGroup(const QuitFromGroupReqMsg& reqMsg);
-	TransBaseMsg_S_PTR DoFileDataRecvRsp(const FileDataRecvRspMsg& rspMsg);
-	GetRandomUserRspMsg DoGetRandomUserReqMsg(const GetRandomUserReqMsg& reqMsg);
-	FileDataSendRspMsg DoFileDataSendReq(const FileDataSendReqMsg& reqMsg);
+	AddToGroupRspMsg DoAddToGroupReqMsg(CMySqlConnect& util, const AddToGroupReqMsg& reqMsg);
+	QuitFromGroupRspMsg DoQuitFromGroup(CMySqlConnect& util, const QuitFromGroupReqMsg& reqMsg);
+	GetRandomUserRspMsg DoGetRandomUserReqMsg(CMySqlConnect& util, const GetRandomUserReqMsg& reqMsg);
+	void DoFileDataSendReq(const FileDataSendReqMsg& reqMsg, std::function<void(const FileDataSendRspMsg&)> sendRsp);
 
 	void Handle_UdpFileDataSendReqMsg(const asio::ip::udp::endpoint sendPt,const FileDataSendReqMsg& reqMsg);
 
@@ -112,6 +193,31 @@ public:
     //asio的主循环类
     asio::io_service &m_ioService;
 
+    //全局的strand,文件传输、聊天消息日志的入库、在线状态的批量写入和定时任务在此strand上处理;
+    //用户的在线记录和消息在用户所在分片的strand上处理
+    asio::io_service::strand m_strand;
+
+    //在线用户的分片,数量和m_presence的分片数相同,启动时创建
+    std::vector<std::unique_ptr<UserShard_st>> m_userShardVec;
+
+    //用户所在的分片
+    UserShard_st& UserShard(const std::string& strUserId);
+
+    //当前线程正在执行的分片strand,不在分片上时为全局的strand
+    asio::io_service::strand& CurrentStrand();
+
+    /**
+     * @brief 在用户所在分片的strand上执行task,已经在该strand上时直接执行
+     * 
+     * @param strUserId 用户ID
+     * @param task 参数为空的函数
+     */
+    template<typename Task>
+    void DispatchToUser(const std::string& strUserId, Task task)
+    {
+        UserShard(strUserId).m_strand.dispatch(task);
+    }
+
     //用于接收连接的socket
     tcp::socket m_socket;
 
@@ -121,8 +227,69 @@ public:
     //服务器的IP端口设置
     IpPortCfg m_serverCfg;
     
-    //数据库操作类
+    //连接池没有启动时使用的数据库连接,各个strand共用,使用时持有m_utilMutex
     CMySqlConnect m_util;
+    std::mutex m_utilMutex;
+
+    //数据库执行器,登录、聊天消息等频繁的数据库操作在连接池的线程上执行,结果回到发起操作的strand
+    CDbExecutor<CMySqlConnect> m_dbExecutor;
+    DbExecutorCfg_st m_dbExecutorCfg;
+
+    //文件读写线程池,传输文件时的磁盘读写在工作线程上执行,结果回到全局的strand
+    CFileIoEngine m_fileIo;
+    FileIoEngineCfg_st m_fileIoCfg;
+
+    /**
+     * @brief 在连接池上执行query,结果在发起操作的strand上交给done;连接池没有启动时直接使用m_util执行
+     * 
+     * @param strKey key相同的操作按顺序执行,一般为用户ID或群组ID
+     * @param query 参数为(CMySqlConnect&),只能访问参数和数据库连接
+     * @param done 参数为query的结果
+     */
+    template<typename Query, typename Done>
+    void PostDbQuery(const std::string& strKey, Query query, Done done)
+    {
+        if (!m_dbExecutor.Post(strKey, query, CurrentStrand(), done))
+        {
+            std::unique_lock<std::mutex> lock(m_utilMutex);
+            auto result = query(m_util);
+            lock.unlock();
+            done(result);
+        }
+    }
+
+    //在连接池上执行不需要结果的数据库操作
+    void PostDbTask(const std::string& strKey, std::function<void(CMySqlConnect&)> task);
+
+    //好友关系缓存,各个分片的strand都会使用,访问时持有m_friendCacheMutex
+    CFriendGraphCache m_friendCache;
+    std::mutex m_friendCacheMutex;
+
+    //群组最近消息的缓存,各个分片的strand都会使用,访问时持有m_groupMsgCacheMutex
+    CGroupMsgCache m_groupMsgCache;
+    std::mutex m_groupMsgCacheMutex;
+
+    //聊天消息先写本地日志再批量入库,各个分片的strand写入,全局的strand入库,访问时持有m_journalMutex
+    CChatMsgJournal m_chatMsgJournal;
+    std::mutex m_journalMutex;
+
+    //写入聊天消息日志,日志没有打开时返回false
+    template<typename ChatMsgT>
+    bool AppendJournal(const ChatMsgT& chatMsg)
+    {
+        std::lock_guard<std::mutex> lock(m_journalMutex);
+        return m_chatMsgJournal.Append(chatMsg);
+    }
+    std::size_t JournalPendingCount();
+
+    //聊天表冷分区的归档,归档和查询都在连接池的线程上执行
+    CChatArchive m_chatArchive;
+
+    //读取群组中strLastMsgId之后的消息,读取位置在归档的范围内时先读归档文件
+    bool SelectGroupChatTextList(CMySqlConnect& util, const std::string& strGroupId, const std::string& strLastMsgId, const int nLimit, std::vector<T_GROUP_CHAT_MSG>& msgVec);
+
+    //在连接池上查询用户的好友关系
+    static std::vector<FriendEdge_st> SelectFriendEdges(CMySqlConnect& util, const std::string& strUserId);
     
     //所有的客户端的连接客户端的IP端口设置
     std::vector<IpPortCfg> m_clientCfgVec;
@@ -141,18 +308,25 @@ public:
     void do_accept();
 
 	bool OnUserReceiveMsg(const std::string strUser);
+	bool DrainFriendMsg(const std::string strUserId);
+	void FlushFriendMsgAck(const std::string strUserId, FriendMsgDrain_st& drain);
+	void LoadFriendMsgPage(const std::string strUserId, FriendMsgDrain_st& drain);
 
-	bool OnAddFriendRecvReqMsg(const std::string strUser);
+	void OnAddFriendRecvReqMsg(const std::string strUser);
 
-	bool OnAddFriendNotifyReqMsg(const std::string strUser);
+	void OnAddFriendNotifyReqMsg(const std::string strUser);
 
-	bool OnUserRecvGroupMsg(const std::string strUser);
+	void OnUserRecvGroupMsg(const std::string strUser);
 
 	bool DoUserRecvGroupMsg(const std::shared_ptr<CServerSess>& pSess, const T_GROUP_CHAT_MSG& msg);
-	void OnDispatchGroupMsg(const std::string strGroupId);
+	void DoUserRecvGroupMsgBatch(const std::shared_ptr<CServerSess>& pSess, const std::string strGroupId, const std::vector<T_GROUP_CHAT_MSG>& msgVec);
+	void OnDispatchGroupMsg(const std::string strGroupId, const std::vector<T_GROUP_RELATION_BEAN>& groupUsers);
 
 	void OnUserStateCheck(const std::string strUserId);
+	void OnUserUnReadChecked(const std::string strUserId, const bool bHaveUnRead);
 	void NotifyUserFriends(const std::string strUserId);
+	void NotifyFriendEdges(const std::vector<FriendEdge_st>& edgeVec);
+	void InvalidateFriendCache(const std::string& strUserId);
 
 
 	void CloseUserFile(const std::string strUserId);
@@ -161,6 +335,8 @@ public:
 private:
 	const std::size_t HASH_SALT_LENGTH = 32;//密码的哈希盐值的长度
 	std::string CreateMsgId();
+	int CreateFileId();
+	int m_nLastFileId = 0;//最近一次分配的文件ID
 	std::string GenerateSalt();
 	std::string GetSaltFromPasswd(const std::string strPasswd);
 	std::string GeneratePassword(const std::string orgPassWord);
@@ -170,14 +346,15 @@ private:
     SnowFlake m_MsgID_Util; //消息的唯一生成器
 	
   
-    std::map<std::string, std::shared_ptr<CServerSess>> m_UserSessVec;  //保存UserId和Sess的对应关系
-	std::map<std::string, CLIENT_SESS_STATE> m_clientStateMap;          //保存客户端的状态
-	
-	
-	std::map<std::string, std::shared_ptr<CServerSess>> m_KickOffSessMap;  //保存UserId和Sess的对应关系
+    CPresenceRegistry m_presence;  //用户的会话、状态、UDP地址和群组消息的下发状态,用户的记录只在所在分片的strand上修改
+
+	static const std::size_t ONLINE_STATE_FLUSH_SIZE = 256;//积累多少个用户的在线状态时立即写入数据库
+	bool m_bSaveOnlineState = true;//是否把用户的在线状态写入数据库
+	std::unordered_map<std::string, CLIENT_STATE> m_onlineStateMap;//还没有写入数据库的在线状态,同一个用户只保留最后一次
+	void SaveUserOnlineState(const std::string& strUserId, const CLIENT_STATE state);
+	void FlushUserOnlineState();
 
 	std::shared_ptr<CUdpServer> m_udpServer;
-	std::map<std::string, IpPortCfg> m_userIdUdpAddrMap;
 	std::map<int, FILE_TRANS_TYPE> m_fileTranModeMap;
 	std::string GenerateUserId();
 
@@ -193,8 +370,72 @@ private:
 	void CheckFileVerifyReq(const FileVerifyReqMsg& reqMsg);
 
 	void SaveFileDataRsp(const FileDataSendRspMsg& rspMsg);
+
+	void StartFileDataSend(const FileSendWindow_st& sendWindow);
+	void SendFileDataWindow(const int nFileId);
+	bool SendFileDataChunk(FileSendWindow_st& sendWindow, const int nIndex);
+	void OnFileDataRecvRsp(const FileDataRecvRspMsg& rspMsg);
+	void SendFileVerifyReq(FileVerifyReqMsg& reqMsg, const std::string& strFileName);
+	void SetFileTimer();
+	void OnFileTimer();
+
+	void RegisterTcpHandlers();
+	void StartUserShards();
+	asio::io_service::strand& RecvMsgStrand(const std::shared_ptr<CServerSess>& pSess, const E_MsgType type);
+	void ReportDispatchStat();
+	void StartDbExecutor();
+	void StartChatMsgJournal();
+	void ScheduleJournalFlush();
+	void SetJournalTimer(const int nMilliSeconds);
+	void FlushJournal();
+	void OnJournalBatchSaved(const bool bSaved);
+	void OnChatMsgBatchSaved(const ChatMsgJournalBatch_st& batch);
+	void StartChatArchive();
+	void MaintainChatArchive();
+	void ReportDbStat();
+	void StartFileIoEngine();
+	void ReportFileIoStat();
 private:
+	CMsgDispatcher<const std::shared_ptr<CServerSess>&> m_tcpDispatcher;//TCP消息的分发器,文件传输的消息在全局的strand上使用,每个分片复制一份
 	USER_FILE_DATA_RSP_MAP m_fileDataRspMap;
+	int m_nFileWindowSize = CFileSendWindow::DEFAULT_WINDOW_SIZE;//文件传输时同时在途的数据包个数
+	int m_nMaxFrameSize = MSG_MAX_FRAME_SIZE;//登录协商时允许的单条消息最大长度
+	int m_nChunkSize = FILE_DATA_TCP_CHUNK_SIZE;//登录协商时允许的TCP文件数据包长度
+	int m_nGroupMsgBatch = GROUP_MSG_BATCH_DEFAULT;//登录协商时允许的每批群聊消息条数,0表示逐条下发
+	int m_nUnReadMsgWindow = CUnReadMsgWindow::DEFAULT_WINDOW_SIZE;//同时在途的离线好友消息条数
+	int m_nUnReadMsgPageSize = CUnReadMsgWindow::DEFAULT_PAGE_SIZE;//每次从数据库读取的离线好友消息条数
+	std::shared_ptr<asio::high_resolution_timer> m_fileTimer;//文件数据包重传的定时器
+	std::string m_strJournalDir = "journal";//聊天消息日志的目录,为空时同步入库
+	bool m_bJournalSync = false;//日志文件入库前是否同步到磁盘
+	std::size_t m_nJournalFlushRows = CChatMsgJournal::DEFAULT_FLUSH_ROWS;//积累多少条消息时立即入库
+	int m_nJournalFlushMs = CChatMsgJournal::DEFAULT_FLUSH_INTERVAL_MS;//最长多少毫秒入库一次
+	std::deque<std::shared_ptr<ChatMsgJournalBatch_st>> m_journalBatchQueue;//等待入库的日志文件,队首正在入库
+	bool m_bJournalFlushing = false;//是否有一批消息正在入库
+	std::shared_ptr<asio::high_resolution_timer> m_journalTimer;//日志入库的定时器
+	bool m_bJournalTimerRun = false;
+	std::string m_strArchiveDir = "archive";//归档文件的目录,为空时不管理分区也不归档
+	int m_nArchiveHotMonths = 6;//包括当前月在内保留在数据库中的月数
+	int m_nArchiveAheadMonths = 2;//提前创建分区的月数
+	int m_nArchiveIntervalSec = 3600;//检查分区和归档的间隔
+	std::chrono::steady_clock::time_point m_archiveCheckTime;//上次检查分区的时间
+	bool m_bArchiveRunning = false;//是否正在检查分区或者归档
+	bool m_bFileTimerRun = false;//重传定时器是否在运行
+	std::string m_strBlobDir = "blob";//按内容Hash保存图片和文件的目录,为空时按文件名保存在Image目录
+	CBlobStore m_blobStore;
+	std::map<std::string, std::string> m_fileProofMap;//秒传时给发送端的盐,以"用户ID/内容Hash"为键,使用一次以后删除
+	std::map<int, FileSendWindow_st> m_fileSendWindowMap;//正在发送的文件,以文件ID为键
+	std::map<int, CFileRecvWindow> m_fileRecvWindowMap;//正在接收的文件,以文件ID为键
+	std::map<int, CChunkHash> m_fileRecvHashMap;//正在接收的文件写入时计算的Hash,以文件ID为键
+	std::map<int, FileRecvLimit_st> m_fileRecvLimitMap;//正在接收的文件的数据包限制,以文件ID为键
+	void SetFileRecvLimit(const int nFileId, const int nChunkSize, const int nFileSize);
+	std::string FinishRecvHash(const int nFileId, const std::string& strPeerHash);
+	void OnFileVerifyHash(const std::shared_ptr<CServerSess>& pSess, const FileVerifyReqMsg& req, const std::string& strFileName, const std::string& strFileHash, const FileDigest_st& digest);
+	std::map<int, FileRecvResume_st> m_fileResumeMap;//可以续传的正在接收的文件,以文件ID为键
+	std::string ResumeStatePath(const std::string& strFileHash);
+	bool StartRecvResume(const FileSendDataBeginReq& req, const std::string& strFileName, FileSendDataBeginRsp& rspMsg);
+	bool TakeOverRecvFile(const FileSendDataBeginReq& req);
+	void SuspendRecvFile(const int nFileId);
+	void FinishRecvResume(const int nFileId);
 	std::vector<std::string> m_strSendFileHashVec;
 	std::vector<std::string> m_strRecvFileHashVec;//从客户端上来的Hash的数组
 	bool IsFileRecving(const std::string strFileHash);//文件是否在接收状态
@@ -212,6 +453,7 @@ private:
 	void HandleUserKeepAliveReq(const std::shared_ptr<CServerSess> pSess, const KeepAliveReqMsg& reqMsg);
 	void HandleUserKeepAliveRsp(const std::shared_ptr<CServerSess> pSess, const KeepAliveRspMsg& rspMsg);
 	void HandleUserLoginReq(const std::shared_ptr<CServerSess>& pSess, const UserLoginReqMsg& reqMsg);
+	void OnUserLoginRsp(const std::shared_ptr<CServerSess>& pSess, const UserLoginReqMsg& reqMsg, UserLoginRspMsg rspMsg);
 
 
 	void HandleUserLogoutReq(const std::shared_ptr<CServerSess>& pSess, const UserLogoutReqMsg& reqMsg);
@@ -241,7 +483,10 @@ private:
 	void HandleFriendNotifyFileRsp(const std::shared_ptr<CServerSess>& pSess, const FriendNotifyFileMsgRspMsg& req);
 
 	void HandleFileSendDataBeginReq(const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginReq& req);
+	void OnFileProofChecked(const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginReq& req, const bool bProof);
+	void BeginRecvFile(const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginReq& beginReq);
 	void HandleFileSendDataBeginRsp(const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginRsp& req);
+	void BeginSendFile(const std::shared_ptr<CServerSess>& pSess, const FileSendDataBeginRsp& req, const std::string strFileName, const std::string strFileHash);
 
 	void HandleFileDownLoadReq(const std::shared_ptr<CServerSess>& pSess, const FileDownLoadReqMsg& req);
 
@@ -279,20 +524,26 @@ private:
 
 	void HandleUpdateGroupListRsp( const UpdateGroupListNotifyRspMsg& reqMsg);
 	void HandleAddFriendRecvRsp(const AddFriendRecvRspMsg& rspMsg);
-	void HandleAddFriendNotifyRsp(const AddFriendNotifyRspMsg& rspMsg);
+	void HandleAddFriendNotifyRsp(const std::shared_ptr<CServerSess>& pSess, const AddFriendNotifyRspMsg& rspMsg);
 	void HandleUserKickOffRsp(const UserKickOffRspMsg& reqMsg);
 
 	void SendGroupMsgToUser(const std::shared_ptr<CServerSess>& pSess, const std::string strGroupId,const std::string strLastReadId);
+	void OnGroupMsgSelected(const std::shared_ptr<CServerSess>& pSess, const std::string strGroupId, const std::vector<T_GROUP_CHAT_MSG>& msgVec);
 	void NotifyUserRecvGroupMsg(const std::shared_ptr<CServerSess>& pSess, const std::string strGroupId);
 	std::shared_ptr<CServerSess> GetClientSess(const std::string strUserId);
 private:
-	CLIENT_SESS_STATE GetGroupUserState(const UserIdGroupId_st& keyValue);
-	bool SetGroupUserState(const UserIdGroupId_st& keyValue, const CLIENT_SESS_STATE& state);
-	void RemoveGroupUserState(const UserIdGroupId_st& keyValue);
+	CLIENT_SESS_STATE GetGroupUserState(const std::string& strUserId, const std::string& strGroupId);
+	bool SetGroupUserState(const std::string& strUserId, const std::string& strGroupId, const CLIENT_SESS_STATE& state);
 	void RemoveUserAllGroupState(const std::string strUserId);
-	std::map<UserIdGroupId_st, CLIENT_SESS_STATE> m_groupStateMap;
+	void SetUserState(const std::string& strUserId, const CLIENT_SESS_STATE state);
 	std::string GetImageDir();
 	std::string GetFileDir();
+	void StartBlobStore();
+	std::string UploadFilePath(const std::string& strFileName);
+	bool CommitUploadFile(const std::string& strFileName, const FileDigest_st& digest);
+	bool FindBlobFile(const std::string& strName, std::string& strFilePath, std::string& strFileHash);
+	using StoredFileDone = std::function<void(const bool bFound, const std::string& strFilePath, const std::string& strFileHash)>;
+	void FindStoredFile(const int nFileId, const std::string& strFileName, StoredFileDone done);
 
 public:
 
@@ -10,10 +10,24 @@
  */
 
 #include "CMySqlConnect.h"
-#include "fmt/format.h"
+#include "CChatPartition.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 std::shared_ptr<spdlog::logger> CMySqlConnect::m_loger=nullptr;
 
+/**
+ * @brief 消息ID转换为整数绑定,和BIGINT列比较时按整数比较并且可以使用索引
+ * 
+ * 绑定字符串时MySQL按浮点数比较,SnowFlake生成的ID超过浮点数的精度
+ * @param strMsgId 消息ID,读取位置的默认值'00000000'转换为0
+ */
+static int64_t MsgIdValue(const std::string& strMsgId)
+{
+	return static_cast<int64_t>(std::strtoull(strMsgId.c_str(), nullptr, 10));
+}
+
 /**
  * @brief 构造函数
  * 
@@ -26,18 +40,13 @@ CMySqlConnect::CMySqlConnect()
 		else {
 			LOG_INFO(m_loger,"mysql_init()failed  [{} {}]", __FILENAME__, __LINE__);
 		}
-		int nResult = mysql_options(m_mysql,MYSQL_READ_DEFAULT_GROUP,"ChatServer");
-		LOG_INFO(m_loger,"mysql_options() {}  [{} {}]",nResult, __FILENAME__, __LINE__);
+		ApplyOptions();
 		if (0 == mysql_library_init(0, NULL, NULL)) {
 			LOG_INFO(m_loger,"mysql_library_init()succeed  [{} {}]", __FILENAME__, __LINE__);
 		}
 		else {
 			LOG_INFO(m_loger, "mysql_library_init()failed [{} {}]", __FILENAME__, __LINE__);
 		}
-
-		m_pFriendChatInsertStmt = nullptr;
-		m_pSelectUserByNameStmt = nullptr;
-		m_pSelectAllUserNameStmt = nullptr;
 }
 
 /**
@@ -46,9 +55,190 @@ CMySqlConnect::CMySqlConnect()
  */
 CMySqlConnect::~CMySqlConnect()
 {
+	CloseStmt();
     mysql_close(m_mysql);
 }
 
+/**
+ * @brief 设置连接的选项,mysql_init以后调用
+ * 
+ */
+void CMySqlConnect::ApplyOptions()
+{
+	int nResult = mysql_options(m_mysql,MYSQL_READ_DEFAULT_GROUP,"ChatServer");
+	LOG_INFO(m_loger,"mysql_options() {}  [{} {}]",nResult, __FILENAME__, __LINE__);
+	if (m_nTimeout > 0)
+	{
+		mysql_options(m_mysql, MYSQL_OPT_CONNECT_TIMEOUT, &m_nTimeout);
+		mysql_options(m_mysql, MYSQL_OPT_READ_TIMEOUT, &m_nTimeout);
+		mysql_options(m_mysql, MYSQL_OPT_WRITE_TIMEOUT, &m_nTimeout);
+	}
+}
+
+/**
+ * @brief 关闭缓存的预处理语句,预处理语句属于连接,重连以后需要重新准备
+ * 
+ */
+void CMySqlConnect::CloseStmt()
+{
+	m_pLastStmt = nullptr;
+	m_stmtMap.clear();
+}
+
+/**
+ * @brief 获取SQL对应的预处理语句,第一次使用时准备
+ * 
+ * 没有缓存结果集,同一个连接上执行其他语句之前,先丢弃上一个语句没有读完的结果
+ * @param strSql 带有?占位符的SQL语句
+ * @return CMySqlStmt* 准备失败返回nullptr
+ */
+CMySqlStmt* CMySqlConnect::GetStmt(const std::string& strSql)
+{
+	CMySqlStmt* pStmt = nullptr;
+	auto item = m_stmtMap.find(strSql);
+	if (item != m_stmtMap.end())
+	{
+		pStmt = item->second.get();
+	}
+	else
+	{
+		std::unique_ptr<CMySqlStmt> pNewStmt(new CMySqlStmt(m_mysql, strSql));
+		if (!pNewStmt->IsValid())
+		{
+			LOG_ERR(m_loger, "SQL:{} Prepare Failed {} {} [{} {}]", strSql, pNewStmt->Errno(), pNewStmt->Error(), __FILENAME__, __LINE__);
+			return nullptr;
+		}
+		pStmt = pNewStmt.get();
+		m_stmtMap.insert({ strSql, std::move(pNewStmt) });
+	}
+	if (nullptr != m_pLastStmt && pStmt != m_pLastStmt)
+	{
+		m_pLastStmt->FreeResult();
+	}
+	m_pLastStmt = pStmt;
+	return pStmt;
+}
+
+/**
+ * @brief 设置连接、读、写的超时时间,单次查询最多阻塞超时时间的数倍,而不是无限等待
+ * 
+ * @param nSeconds 超时时间(秒)
+ */
+void CMySqlConnect::SetTimeout(const int nSeconds)
+{
+	m_nTimeout = nSeconds > 0 ? static_cast<unsigned int>(nSeconds) : 0;
+	ApplyOptions();
+}
+
+/**
+ * @brief 检查数据库连接,连接已经断开时重新连接
+ * 
+ * @return true 连接可用
+ * @return false 连接断开且重连失败
+ */
+bool CMySqlConnect::Ping()
+{
+	if (nullptr != m_pLastStmt)
+	{
+		m_pLastStmt->FreeResult();
+	}
+	if (nullptr != m_mysql && 0 == mysql_ping(m_mysql))
+	{
+		return true;
+	}
+	LOG_WARN(m_loger, "mysql_ping() failed {} {}, Reconnect [{} {}]", mysql_errno(m_mysql), mysql_error(m_mysql), __FILENAME__, __LINE__);
+	return Reconnect();
+}
+
+/**
+ * @brief 开始事务,之后的语句在Commit之前不会提交
+ * 
+ * @return true 成功
+ * @return false 失败
+ */
+bool CMySqlConnect::BeginTransaction()
+{
+	if (nullptr != m_pLastStmt)
+	{
+		m_pLastStmt->FreeResult();
+	}
+	if (nullptr == m_mysql || 0 != mysql_autocommit(m_mysql, 0))
+	{
+		LOG_ERR(m_loger, "Begin Transaction Failed {} {} [{} {}]", mysql_errno(m_mysql), mysql_error(m_mysql), __FILENAME__, __LINE__);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief 提交事务并恢复自动提交
+ * 
+ * @return true 成功
+ * @return false 失败,事务中的修改没有生效
+ */
+bool CMySqlConnect::Commit()
+{
+	bool bCommit = (0 == mysql_commit(m_mysql));
+	if (!bCommit)
+	{
+		LOG_ERR(m_loger, "Commit Failed {} {} [{} {}]", mysql_errno(m_mysql), mysql_error(m_mysql), __FILENAME__, __LINE__);
+	}
+	mysql_autocommit(m_mysql, 1);
+	return bCommit;
+}
+
+/**
+ * @brief 回滚事务并恢复自动提交
+ * 
+ * @return true 成功
+ * @return false 失败
+ */
+bool CMySqlConnect::Rollback()
+{
+	bool bRollback = (0 == mysql_rollback(m_mysql));
+	mysql_autocommit(m_mysql, 1);
+	return bRollback;
+}
+
+/**
+ * @brief 关闭旧的连接,使用上次的参数重新连接
+ * 
+ * @return true 重连成功
+ * @return false 重连失败
+ */
+bool CMySqlConnect::Reconnect()
+{
+	if (m_strHost.empty())
+	{
+		return false;
+	}
+	CloseStmt();
+	mysql_close(m_mysql);
+	m_mysql = mysql_init(nullptr);
+	if (nullptr == m_mysql)
+	{
+		LOG_ERR(m_loger, "mysql_init() failed [{} {}]", __FILENAME__, __LINE__);
+		return false;
+	}
+	ApplyOptions();
+	return ConnectToServer(m_strUserName, m_strPasswd, m_strDataBase, m_strHost, m_nPort, false);
+}
+
+
+/**
+ * @brief 分区定义的SQL片段,分区名由CChatPartition生成,只包含字母数字和下划线
+ * 
+ */
+static std::string ChatPartitionDefine(const std::vector<ChatPartition_st>& partVec)
+{
+	std::string strSql;
+	for (const auto& item : partVec)
+	{
+		strSql += strSql.empty() ? "" : ",";
+		strSql += "PARTITION `" + item.m_strName + "` VALUES LESS THAN " + (item.m_bMaxValue ? std::string("MAXVALUE") : "(" + std::to_string(item.m_nLessThan) + ")");
+	}
+	return strSql;
+}
 
 /**
  * @brief 创建数据库对应的表格
@@ -60,6 +250,9 @@ bool CMySqlConnect::CreateTable()
 {
 	if (m_mysql)
 	{
+		//聊天表按月分区,建表时创建当前月和之后两个月的分区,之后由服务器提前创建
+		int nCurMonth = CChatPartition::CurrentMonthIndex();
+		std::string strPartitionSql = "PARTITION BY RANGE (`F_MSG_ID`) (" + ChatPartitionDefine(CChatPartition::MonthPartitions(nCurMonth, nCurMonth + 2)) + ");";
 		//TABLE T_ADD_FRIEND_MSG
 		{
 			std::string strSql = R"( CREATE TABLE `T_ADD_FRIEND_MSG`  (
@@ -142,7 +335,7 @@ bool CMySqlConnect::CreateTable()
 		{
 			std::string strSql = u8R"( CREATE TABLE `T_FRIEND_CHAT_MSG`  (
 			  `F_INDEX` bigint(255) UNSIGNED NOT NULL AUTO_INCREMENT COMMENT '自增ID，由数据库产生',
-			  `F_MSG_ID` char(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '消息ID,由程序生成',
+			  `F_MSG_ID` bigint UNSIGNED NOT NULL COMMENT '消息ID,由程序生成',
 			  `F_MSG_TYPE` char(32) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '消息类型',
 			  `F_FROM_ID` char(8) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '消息发送者ID',
 			  `F_TO_ID` char(8) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '消息接收者ID',
@@ -151,8 +344,10 @@ bool CMySqlConnect::CreateTable()
 			  `F_READ_FLAG` enum('UNREAD','READ') CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL DEFAULT 'UNREAD' COMMENT '信息是否被读取,\'READ\',\'UNREAD\'',
 			  `F_CREATE_TIME` timestamp(0) DEFAULT CURRENT_TIMESTAMP COMMENT '信息创建时间',
 			  `F_READ_TIME` timestamp(0) DEFAULT CURRENT_TIMESTAMP COMMENT '信息读取时间',
-			  PRIMARY KEY (`F_INDEX`) USING BTREE
-			) ENGINE = InnoDB AUTO_INCREMENT = 1 CHARACTER SET = utf8mb4 COLLATE = utf8mb4_bin ROW_FORMAT = Dynamic;)";
+			  PRIMARY KEY (`F_INDEX`, `F_MSG_ID`) USING BTREE,
+			  INDEX `IDX_MSG_ID`(`F_MSG_ID`) USING BTREE,
+			  INDEX `IDX_TO_UNREAD`(`F_TO_ID`, `F_READ_FLAG`, `F_MSG_ID`) USING BTREE
+			) ENGINE = InnoDB AUTO_INCREMENT = 1 CHARACTER SET = utf8mb4 COLLATE = utf8mb4_bin ROW_FORMAT = Dynamic )" + strPartitionSql;
 			int res = mysql_query(m_mysql, strSql.c_str());//查询
 			int errCode = mysql_errno(m_mysql);
 			std::string errMsg = mysql_error(m_mysql);
@@ -225,9 +420,11 @@ bool CMySqlConnect::CreateTable()
 			  `F_GROUP_ID` char(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '群组ID',
 			  `F_USER_ID` char(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '用户ID',
 			  `F_ROLE_TYPE` varchar(255) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '用户角色，\'OWNER\',\'MANAGER\',\'MEMBER\' ',
-			  `F_LAST_READ_MSG_ID` char(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin DEFAULT '00000000' COMMENT '阅读的最后一个消息的编号',
+			  `F_LAST_READ_MSG_ID` bigint UNSIGNED NOT NULL DEFAULT 0 COMMENT '阅读的最后一个消息的编号',
 			  `F_CREATE_TIME` datetime(0) DEFAULT CURRENT_TIMESTAMP COMMENT '创建时间',
-			  PRIMARY KEY (`F_INDEX`) USING BTREE
+			  PRIMARY KEY (`F_INDEX`) USING BTREE,
+			  INDEX `IDX_GROUP_USER`(`F_GROUP_ID`, `F_USER_ID`) USING BTREE,
+			  INDEX `IDX_USER_GROUP`(`F_USER_ID`, `F_GROUP_ID`) USING BTREE
 			) ENGINE = InnoDB AUTO_INCREMENT = 1 CHARACTER SET = utf8mb4 COLLATE = utf8mb4_bin ROW_FORMAT = Dynamic;)";
 			int res = mysql_query(m_mysql, strSql.c_str());//查询
 			int errCode = mysql_errno(m_mysql);
@@ -246,15 +443,17 @@ bool CMySqlConnect::CreateTable()
 		{
 			std::string strSql = u8R"( CREATE TABLE `T_GROUP_CHAT_MSG`  (
   `F_INDEX` int(255) UNSIGNED NOT NULL AUTO_INCREMENT COMMENT '自增ID',
-  `F_MSG_ID` char(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin DEFAULT NULL COMMENT '消息ID,由程序生成 ',
+  `F_MSG_ID` bigint UNSIGNED NOT NULL COMMENT '消息ID,由程序生成 ',
   `F_MSG_TYPE` char(32) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin DEFAULT NULL COMMENT '消息类型',
   `F_SENDER_ID` char(8) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin DEFAULT NULL COMMENT '消息发送者ID,外键链接到T_USER的F_USER_ID',
   `F_GROUP_ID` char(8) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin DEFAULT NULL COMMENT '群组ID，外键链接到T_GROUP的F_GROUP_ID',
   `F_MSG_CONTEXT` blob COMMENT '消息内容',
   `F_OTHER_INFO` char(255) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin DEFAULT NULL,
   `F_CREATE_TIME` datetime(0) DEFAULT CURRENT_TIMESTAMP COMMENT '创建时间',
-  PRIMARY KEY (`F_INDEX`) USING BTREE
-) ENGINE = InnoDB AUTO_INCREMENT = 1 CHARACTER SET = utf8mb4 COLLATE = utf8mb4_bin ROW_FORMAT = Dynamic;)";
+  PRIMARY KEY (`F_INDEX`, `F_MSG_ID`) USING BTREE,
+  INDEX `IDX_MSG_ID`(`F_MSG_ID`) USING BTREE,
+  INDEX `IDX_GROUP_MSG`(`F_GROUP_ID`, `F_MSG_ID`) USING BTREE
+) ENGINE = InnoDB AUTO_INCREMENT = 1 CHARACTER SET = utf8mb4 COLLATE = utf8mb4_bin ROW_FORMAT = Dynamic )" + strPartitionSql;
 			int res = mysql_query(m_mysql, strSql.c_str());//查询
 			int errCode = mysql_errno(m_mysql);
 			std::string errMsg = mysql_error(m_mysql);
@@ -330,399 +529,577 @@ bool CMySqlConnect::CreateTable()
 	}
 	return true;
 }
+
 /**
- * @brief 连接到Mysql服务器
+ * @brief 聊天表升级以后的消息ID列和索引
  * 
- * @param userName 数据库用户名
- * @param passwd 数据库密码
- * @param database 数据库名称
- * @param strHost 数据库服务器IP
- * @param port 数据库服务器断开
- * @return true 连接成功
- * @return false 连接失败
  */
-bool CMySqlConnect::ConnectToServer(const std::string userName,
-                                    const std::string passwd,
-                                    const std::string database,
-                                    const std::string strHost,const int port)
+struct ChatSchemaSpec_st
 {
-	try{
-		if (NULL != mysql_real_connect(m_mysql, strHost.c_str(),userName.c_str(),passwd.c_str(), database.c_str(), 0,NULL, 0))
-		{
-			LOG_INFO(m_loger, "mysql_real_connect() succeed [{} {}]", __FILENAME__, __LINE__);
-			int nResult = mysql_set_character_set(m_mysql, "UTF8");
-			LOG_INFO(m_loger, "{}  succeed [{} {}]", nResult, __FILENAME__, __LINE__);
-			return CreateTable();
-		}
-		else
-		{
-			LOG_ERR(m_loger, "mysql_real_connect() {} failed[{} {}]",port,__FILENAME__, __LINE__);
-            return false;
-		}
-	}
-	catch(std::exception ec)
-	{
-		LOG_INFO(m_loger,"MySql EC:{} ",ec.what());
-		return false;
-	}
+	std::string m_strTable;
+	std::string m_strIdColumn;//需要改为整数的消息ID列
+	std::string m_strIdDefine;//消息ID列升级以后的定义
+	std::vector<std::pair<std::string, std::string>> m_indexVec;//索引名和索引的列
+};
+
+static const std::vector<ChatSchemaSpec_st>& ChatSchemaSpecs()
+{
+	static const std::vector<ChatSchemaSpec_st> specVec = {
+		{ "T_FRIEND_CHAT_MSG", "F_MSG_ID", u8"bigint UNSIGNED NOT NULL COMMENT '消息ID,由程序生成'",
+			{ { "IDX_MSG_ID", "`F_MSG_ID`" }, { "IDX_TO_UNREAD", "`F_TO_ID`, `F_READ_FLAG`, `F_MSG_ID`" } } },
+		{ "T_GROUP_CHAT_MSG", "F_MSG_ID", u8"bigint UNSIGNED NOT NULL COMMENT '消息ID,由程序生成 '",
+			{ { "IDX_MSG_ID", "`F_MSG_ID`" }, { "IDX_GROUP_MSG", "`F_GROUP_ID`, `F_MSG_ID`" } } },
+		{ "T_GROUP_RELATION", "F_LAST_READ_MSG_ID", u8"bigint UNSIGNED NOT NULL DEFAULT 0 COMMENT '阅读的最后一个消息的编号'",
+			{ { "IDX_GROUP_USER", "`F_GROUP_ID`, `F_USER_ID`" }, { "IDX_USER_GROUP", "`F_USER_ID`, `F_GROUP_ID`" } } },
+	};
+	return specVec;
 }
 
 /**
- * @brief 根据用户名获取用户的密码
+ * @brief 升级聊天表,每个表的修改合并为一条ALTER TABLE,大表只重建一次
  * 
- * @param userName 用户名
- * @param bean 用户名和密码的结构体
- * @return true 获取成功
- * @return false 获取失败
+ * 消息ID中有空值或者非数字的表不升级,需要先清理这些记录
+ * @return true 全部升级成功或者已经是最新的
+ * @return false 有表升级失败
  */
-bool CMySqlConnect::SelectUserByName(const std::string userName, T_USER_BEAN& bean)
+bool CMySqlConnect::MigrateChatSchema()
 {
-
-	if (nullptr == m_pSelectUserByNameStmt)
+	bool bResult = true;
+	for (const auto& spec : ChatSchemaSpecs())
 	{
-
-		m_pSelectUserByNameStmt = mysql_stmt_init(m_mysql);
-		if (!m_pSelectUserByNameStmt)
+		std::string strType;
+		if (!SelectColumnType(spec.m_strTable, spec.m_strIdColumn, strType))
 		{
-			return false;
+			LOG_ERR(m_loger, "Table:{} Column:{} Not Found [{} {}]", spec.m_strTable, spec.m_strIdColumn, __FILENAME__, __LINE__);
+			bResult = false;
+			continue;
 		}
-		std::string strSql = "SELECT F_USER_ID,F_USER_NAME,F_PASS_WORD FROM T_USER WHERE F_USER_NAME=?;";
-		if (mysql_stmt_prepare(m_pSelectUserByNameStmt, strSql.c_str(), static_cast<unsigned long>(strSql.size())))
+		std::vector<std::string> clauseVec;
+		if (strType != "bigint")
 		{
-			LOG_WARN(m_loger, "{} {} [{} {}]", mysql_stmt_error(m_pSelectUserByNameStmt), mysql_stmt_errno(m_pSelectUserByNameStmt), __FILENAME__, __LINE__);
-			return false;
+			int64_t nInvalid = 0;
+			std::string strCheckSql = "SELECT COUNT(*) FROM `" + spec.m_strTable + "` WHERE `" + spec.m_strIdColumn + "` IS NULL OR `" + spec.m_strIdColumn + "` NOT REGEXP '^[0-9]+$';";
+			if (!SelectCount(strCheckSql, nInvalid) || nInvalid > 0)
+			{
+				LOG_ERR(m_loger, "Table:{} Has {} Rows With Invalid {} [{} {}]", spec.m_strTable, nInvalid, spec.m_strIdColumn, __FILENAME__, __LINE__);
+				bResult = false;
+				continue;
+			}
+			clauseVec.push_back("MODIFY `" + spec.m_strIdColumn + "` " + spec.m_strIdDefine);
+		}
+		for (const auto& index : spec.m_indexVec)
+		{
+			if (!IsIndexExist(spec.m_strTable, index.first))
+			{
+				clauseVec.push_back("ADD INDEX `" + index.first + "`(" + index.second + ") USING BTREE");
+			}
+		}
+		if (clauseVec.empty())
+		{
+			LOG_INFO(m_loger, "Table:{} Is Up To Date [{} {}]", spec.m_strTable, __FILENAME__, __LINE__);
+			continue;
+		}
+		std::string strSql = "ALTER TABLE `" + spec.m_strTable + "` " + clauseVec[0];
+		for (std::size_t i = 1; i < clauseVec.size(); i++)
+		{
+			strSql += ", " + clauseVec[i];
 		}
+		strSql += ";";
+		auto beginTime = std::chrono::steady_clock::now();
+		bool bAlter = ExecuteSql(strSql);
+		auto nCostMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - beginTime).count();
+		LOG_INFO(m_loger, "SQL:{} Result:{} Cost:{}ms [{} {}]", strSql, bAlter, nCostMs, __FILENAME__, __LINE__);
+		bResult = bAlter && bResult;
 	}
+	return bResult;
+}
 
-	MYSQL_BIND paramBind[1];
-	memset(paramBind, 0, sizeof(paramBind));
+/**
+ * @brief 检查聊天表的消息ID列和索引是否都已经升级
+ * 
+ * @return true 已经升级
+ * @return false 没有升级或者查询失败
+ */
+bool CMySqlConnect::IsChatSchemaMigrated()
+{
+	for (const auto& spec : ChatSchemaSpecs())
 	{
-		char buff[32] = { 0 };
-		#ifdef _WIN32
-		strcpy_s(buff, userName.c_str());
-		#else
-		strcpy(buff, userName.c_str());
-		#endif
-		paramBind[0].buffer_type = MYSQL_TYPE_STRING;
-		paramBind[0].buffer = buff;
-		paramBind[0].buffer_length = static_cast<unsigned long>(userName.length());
-
-		if (mysql_stmt_bind_param(m_pSelectUserByNameStmt, paramBind))
+		std::string strType;
+		if (!SelectColumnType(spec.m_strTable, spec.m_strIdColumn, strType) || strType != "bigint")
 		{
-			LOG_WARN(m_loger, "{} {} [{} {}]", mysql_stmt_error(m_pSelectUserByNameStmt), mysql_stmt_errno(m_pSelectUserByNameStmt),__FILENAME__,__LINE__);
 			return false;
 		}
-
-		
+		for (const auto& index : spec.m_indexVec)
 		{
-			unsigned long length[4];
-	
-			bool       is_null[4];
-			bool       error[4];
-			MYSQL_BIND resultBind[3];
-			memset(resultBind, 0, sizeof(resultBind));
-
-			char resultBuf[3][128] = { 0 };
-			
-			resultBind[0].buffer_type = MYSQL_TYPE_STRING;
-			resultBind[0].buffer = resultBuf[0];
-			resultBind[0].buffer_length = 64;
-			resultBind[0].length = &length[0];
-			resultBind[0].is_null = &is_null[0];
-			resultBind[0].error = &error[0];
-
-			resultBind[1].buffer_type = MYSQL_TYPE_STRING;
-			resultBind[1].buffer = resultBuf[1];
-			resultBind[1].buffer_length = 64;
-			resultBind[1].length = &length[1];
-			resultBind[1].is_null = &is_null[1];
-			resultBind[1].error = &error[1];
-
-			resultBind[2].buffer_type = MYSQL_TYPE_STRING;
-			resultBind[2].buffer = resultBuf[2];
-			resultBind[2].buffer_length = 64;
-			resultBind[2].length = &length[2];
-			resultBind[2].is_null = &is_null[2];
-			resultBind[2].error = &error[2];
-
-			try {
-				if (mysql_stmt_bind_result(m_pSelectUserByNameStmt, resultBind))
-				{
-					return false;
-				}
-				if (mysql_stmt_execute(m_pSelectUserByNameStmt))
-				{
-					return false;
-				}
-				if (mysql_stmt_store_result(m_pSelectUserByNameStmt))
-				{
-					return false;
-				}
-				while (true)
-				{
-					int nState = mysql_stmt_fetch(m_pSelectUserByNameStmt);
-					if (nState == 1 || nState == MYSQL_NO_DATA) {
-						return false;
-					}
-					else
-					{
-						bean.m_strF_USER_ID = std::string(static_cast<char*>(resultBind[0].buffer), *(resultBind[0].length));
-						bean.m_strF_USER_NAME = std::string(static_cast<char*>(resultBind[1].buffer), *(resultBind[1].length));
-						bean.m_strF_PASS_WORD = std::string(static_cast<char*>(resultBind[2].buffer), *(resultBind[2].length));
-					}
-					break;
-				}
-			}
-			catch (std::exception ec)
+			if (!IsIndexExist(spec.m_strTable, index.first))
 			{
-				LOG_ERR(m_loger, "EC:{} [{} {}]", ec.what(), __FILENAME__, __LINE__);
+				return false;
 			}
 		}
-		
 	}
 	return true;
-	//MYSQL_RES *result;
-	//MYSQL_ROW sql_row;
-	//int res = 0;
-	//bool bResult = false;
-	//constexpr char * strTemplate2 = "SELECT F_USER_ID,F_USER_NAME,F_PASS_WORD FROM T_USER WHERE F_USER_NAME='{0}';";
-	//std::string strSql = fmt::format(strTemplate2, userName);
-	//LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	//res = mysql_query(m_mysql, strSql.c_str());
-	//if (!res)
-	//{
-	//	result = mysql_store_result(m_mysql);
-	//	if (result)
-	//	{
-	//		while (sql_row = mysql_fetch_row(result))
-	//		{
-	//			bean.m_strF_USER_ID = sql_row[0];
-	//			bean.m_strF_USER_NAME = sql_row[1];
-	//			bean.m_strF_PASS_WORD = sql_row[2];
-	//			bResult = true;
-	//			break;
-	//		}
-	//	}
-	//}
-	//else
-	//{
-	//	return false;
-	//}
-	//if (result != NULL)
-	//{
-	//	mysql_free_result(result);
-	//}
- //   return bResult;
 }
 
-
 /**
- * @brief 判断用户是否存在
+ * @brief 直接执行SQL,丢弃返回的结果
  * 
- * @param userName 用户名
- * @return true 存在
- * @return false 不存在
+ * @param strSql SQL语句
+ * @return true 成功
+ * @return false 失败
  */
-bool CMySqlConnect::IsUserExist(const std::string strUserId)
+bool CMySqlConnect::ExecuteSql(const std::string& strSql)
 {
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_USER_ID FROM T_USER WHERE F_USER_ID='{0}';";
-	std::string strSql = fmt::format(strTemplate2, strUserId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql  ,__FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	bool bExist = false;
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				bExist = true;
-				break;
-			}
-		}
+	if (nullptr != m_pLastStmt)
+	{
+		m_pLastStmt->FreeResult();
 	}
-	else
+	if (nullptr == m_mysql || 0 != mysql_query(m_mysql, strSql.c_str()))
 	{
-		return bExist;
+		LOG_ERR(m_loger, "SQL:{} Failed {} {} [{} {}]", strSql, mysql_errno(m_mysql), mysql_error(m_mysql), __FILENAME__, __LINE__);
+		return false;
 	}
-	if (result != NULL)
+	MYSQL_RES* pResult = mysql_store_result(m_mysql);
+	if (nullptr != pResult)
 	{
-		mysql_free_result(result);
+		mysql_free_result(pResult);
 	}
-	return bExist;
+	return true;
 }
 
-
 /**
- * @brief 判断userName 和friendName是不是好友
+ * @brief 查询当前数据库中某一列的类型
  * 
- * @param userName 用户名
- * @param friendName 好友用户名
- * @return true friendName是userName的好友
- * @return false 不是好友
+ * @param strTable 表名
+ * @param strColumn 列名
+ * @param strType 列的类型,小写,不包含长度
+ * @return true 查询到该列
+ * @return false 没有该列
  */
-bool CMySqlConnect::IsFriend(const std::string userId,const std::string friendId)
+bool CMySqlConnect::SelectColumnType(const std::string& strTable, const std::string& strColumn, std::string& strType)
 {
-	MYSQL_RES *result=nullptr;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_STATUS FROM T_FRIEND_RELATION WHERE F_USER_ID='{0}' AND F_FRIEND_ID='{1}';";
-	std::string strSql = fmt::format(strTemplate2, userId, friendId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	bool bExist = false;
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				bExist = true;
-				break;
-			}
-		}
-	}
-	else
-	{
-		return bExist;
-	}
-	if (result != NULL)
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT DATA_TYPE FROM information_schema.COLUMNS WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME=? AND COLUMN_NAME=?;", strTable, strColumn);
+	if (nullptr == pStmt || !pStmt->Fetch())
 	{
-		mysql_free_result(result);
+		return false;
 	}
-	return bExist;
+	strType = pStmt->GetString(0);
+	pStmt->FreeResult();
+	return true;
 }
 
 /**
- * @brief 更新用户的密码
+ * @brief 判断当前数据库中的表是否有某个索引
  * 
- * @param bean 用户名和密码的结构体
- * @return true 更新成功
- * @return false 更新失败
+ * @param strTable 表名
+ * @param strIndex 索引名
+ * @return true 有该索引
+ * @return false 没有该索引
  */
-bool CMySqlConnect::UpdateUser(const T_USER_BEAN& bean)
+bool CMySqlConnect::IsIndexExist(const std::string& strTable, const std::string& strIndex)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "UPDATE T_USER SET F_PASS_WORD='{0}' WHERE F_USER_NAME='{1}';";
-	std::string strSql = fmt::format(strTemplate2, bean.m_strF_PASS_WORD, bean.m_strF_USER_NAME);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-		return true;
-	}
-	else
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT INDEX_NAME FROM information_schema.STATISTICS WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME=? AND INDEX_NAME=? LIMIT 1;", strTable, strIndex);
+	if (nullptr == pStmt || !pStmt->Fetch())
 	{
 		return false;
 	}
+	pStmt->FreeResult();
+	return true;
 }
 
-
 /**
- * @brief 更新用户在线状态
+ * @brief 执行返回一个整数的查询
  * 
- * @param strUserId 用户ID
- * @param type 在线状态
+ * @param strSql 查询语句,第一行第一列为整数
+ * @param nCount 查询的结果
  * @return true 成功
  * @return false 失败
  */
-bool CMySqlConnect::UpdateUserOnlineState(const std::string strUserId, const CLIENT_STATE type)
+bool CMySqlConnect::SelectCount(const std::string& strSql, int64_t& nCount)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "UPDATE T_USER SET F_ON_LINE_STATE='{0}' WHERE F_USER_ID='{1}';";
-	std::string strSql = fmt::format(strTemplate2, OnLineType(type), strUserId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-		return true;
-	}
-	else
+	CMySqlStmt* pStmt = ExecuteStmt(strSql);
+	if (nullptr == pStmt || !pStmt->Fetch())
 	{
 		return false;
 	}
+	nCount = pStmt->GetInt(0);
+	pStmt->FreeResult();
+	return true;
 }
 
 /**
- * @brief 删除某个用户
+ * @brief 查询表的分区
  * 
- * @param userName 待删除的用户名
- * @return true 删除成功
- * @return false 删除失败
+ * @param strTable 表名
+ * @param partVec 表的分区,按分区的顺序排列,没有分区的表为空
+ * @return true 查询成功
+ * @return false 查询失败
  */
-bool CMySqlConnect::DeleteUser(const std::string strUserId)
+bool CMySqlConnect::SelectChatPartitions(const std::string& strTable, std::vector<ChatPartition_st>& partVec)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "DELETE FROM T_USER WHERE F_USER_ID='{0}';";
-	std::string strSql = fmt::format(strTemplate2, strUserId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
+	partVec.clear();
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT PARTITION_NAME,PARTITION_DESCRIPTION,TABLE_ROWS FROM information_schema.PARTITIONS \
+WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME=? AND PARTITION_NAME IS NOT NULL ORDER BY PARTITION_ORDINAL_POSITION;", strTable);
+	if (nullptr == pStmt)
 	{
-		return true;
+		return false;
 	}
-	else
+	while (pStmt->Fetch())
 	{
-		return false;
+		ChatPartition_st part;
+		part.m_strName = pStmt->GetString(0);
+		std::string strLessThan = pStmt->GetString(1);
+		part.m_bMaxValue = (strLessThan == "MAXVALUE");
+		part.m_nLessThan = part.m_bMaxValue ? 0 : MsgIdValue(strLessThan);
+		part.m_nRows = pStmt->GetInt(2);
+		partVec.push_back(part);
 	}
 	return true;
 }
 
-
 /**
- * @brief 插入用户信息到数据库
+ * @brief 给没有分区的聊天表分区,需要重建整个表,由DbTool离线执行
  * 
- * @param bean 用户名和密码的结构体
+ * MySQL要求分区列包含在每个唯一索引中,主键从F_INDEX改为(F_INDEX,F_MSG_ID)
+ * @param strTable 表名
+ * @param partVec 分区,最后一个为p_max
  * @return true 成功
  * @return false 失败
  */
-bool CMySqlConnect::InsertUser(const T_USER_BEAN& bean)
+bool CMySqlConnect::PartitionChatTable(const std::string& strTable, const std::vector<ChatPartition_st>& partVec)
 {
-	if (bean.IsValid())
-	{
-		int res = 0;
-		constexpr char strTemplate2[] = "INSERT INTO T_USER(F_USER_ID,F_USER_NAME,F_PASS_WORD,F_NICK_NAME) VALUES('{0}','{1}','{2}','{3}');";
-		std::string strSql = fmt::format(strTemplate2, bean.m_strF_USER_ID, bean.m_strF_USER_NAME, bean.m_strF_PASS_WORD, bean.m_strF_NICK_NAME);
-
-		LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-		res = mysql_query(m_mysql, strSql.c_str());//查询
-		if (!res)
-		{
-			return true;
-		}
-		else
-		{
-			LOG_ERR(m_loger, "ERR:{} [{}  {} ]", mysql_errno(m_mysql),__FILENAME__, __LINE__);
-			return false;
-		}
-	}
-	else
+	if (partVec.empty())
 	{
-		LOG_ERR(m_loger, "Bean Is Not Valid [{} {}]", __FILENAME__, __LINE__);
 		return false;
 	}
-	
+	std::string strSql = "ALTER TABLE `" + strTable + "` DROP PRIMARY KEY, ADD PRIMARY KEY (`F_INDEX`, `F_MSG_ID`) USING BTREE \
+PARTITION BY RANGE (`F_MSG_ID`) (" + ChatPartitionDefine(partVec) + ");";
+	auto beginTime = std::chrono::steady_clock::now();
+	bool bResult = ExecuteSql(strSql);
+	auto nCostMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - beginTime).count();
+	LOG_INFO(m_loger, "Table:{} Partitions:{} Result:{} Cost:{}ms [{} {}]", strTable, partVec.size(), bResult, nCostMs, __FILENAME__, __LINE__);
+	return bResult;
 }
 
 /**
- * @brief 根据用户名查找用户的其他信息
+ * @brief 从p_max中拆分出新的分区,p_max中没有消息时不需要移动数据
  * 
- * @param userName 用户名
+ * @param strTable 表名
+ * @param partVec 新的月份分区,不包含p_max
+ * @return true 成功
+ * @return false 失败
+ */
+bool CMySqlConnect::AddChatPartitions(const std::string& strTable, const std::vector<ChatPartition_st>& partVec)
+{
+	if (partVec.empty())
+	{
+		return true;
+	}
+	ChatPartition_st maxPart;
+	maxPart.m_strName = CChatPartition::MAX_PARTITION;
+	maxPart.m_bMaxValue = true;
+	std::vector<ChatPartition_st> newVec = partVec;
+	newVec.push_back(maxPart);
+	bool bResult = ExecuteSql("ALTER TABLE `" + strTable + "` REORGANIZE PARTITION `" + CChatPartition::MAX_PARTITION + "` INTO (" + ChatPartitionDefine(newVec) + ");");
+	LOG_INFO(m_loger, "Table:{} Add Partition {}..{} Result:{} [{} {}]", strTable, partVec.front().m_strName, partVec.back().m_strName, bResult, __FILENAME__, __LINE__);
+	return bResult;
+}
+
+/**
+ * @brief 删除整个分区,代替逐条删除消息
+ * 
+ * @param strTable 表名
+ * @param strPartition 分区名
+ * @return true 成功
+ * @return false 失败
+ */
+bool CMySqlConnect::DropChatPartition(const std::string& strTable, const std::string& strPartition)
+{
+	bool bResult = ExecuteSql("ALTER TABLE `" + strTable + "` DROP PARTITION `" + strPartition + "`;");
+	LOG_INFO(m_loger, "Table:{} Drop Partition {} Result:{} [{} {}]", strTable, strPartition, bResult, __FILENAME__, __LINE__);
+	return bResult;
+}
+
+/**
+ * @brief 分页读取一个分区中的好友消息,包含读取状态
+ * 
+ * @param strPartition 分区名
+ * @param nLimit 最多读取的条数
+ * @param cursor 上一页的最后位置,读取以后更新
+ * @param msgVec 读取的消息
+ * @return true 成功
+ * @return false 失败
+ */
+bool CMySqlConnect::SelectFriendChatMsgPartition(const std::string& strPartition, const int nLimit, ChatPartitionCursor_st& cursor, std::vector<T_USER_CHAT_MSG>& msgVec)
+{
+	msgVec.clear();
+	std::string strSql = "SELECT F_INDEX,F_MSG_ID,F_MSG_TYPE,F_FROM_ID,F_TO_ID,F_MSG_CONTEXT,F_OTHER_INFO,F_READ_FLAG,F_CREATE_TIME FROM T_FRIEND_CHAT_MSG PARTITION (`" + strPartition + "`) \
+WHERE F_MSG_ID>=? AND (F_MSG_ID,F_INDEX)>(?,?) ORDER BY F_MSG_ID,F_INDEX LIMIT ?;";
+	CMySqlStmt* pStmt = ExecuteStmt(strSql, static_cast<int64_t>(cursor.m_nLastMsgId), static_cast<int64_t>(cursor.m_nLastMsgId), static_cast<int64_t>(cursor.m_nLastIndex), static_cast<int64_t>(nLimit));
+	if (nullptr == pStmt)
+	{
+		return false;
+	}
+	while (pStmt->Fetch())
+	{
+		T_USER_CHAT_MSG chatMsg;
+		cursor.m_nLastIndex = MsgIdValue(pStmt->GetString(0));
+		chatMsg.m_strF_MSG_ID = pStmt->GetString(1);
+		cursor.m_nLastMsgId = MsgIdValue(chatMsg.m_strF_MSG_ID);
+		chatMsg.m_eChatMsgType = ChatType(pStmt->GetString(2));
+		chatMsg.m_strF_FROM_ID = pStmt->GetString(3);
+		chatMsg.m_strF_TO_ID = pStmt->GetString(4);
+		chatMsg.m_strF_MSG_CONTEXT = pStmt->GetString(5);
+		chatMsg.m_strF_OTHER_INFO = pStmt->GetString(6);
+		chatMsg.m_strF_READ_FLAG = pStmt->GetString(7);
+		chatMsg.m_strF_CREATE_TIME = pStmt->GetString(8);
+		msgVec.push_back(chatMsg);
+	}
+	return true;
+}
+
+/**
+ * @brief 分页读取一个分区中的群聊消息
+ * 
+ * @param strPartition 分区名
+ * @param nLimit 最多读取的条数
+ * @param cursor 上一页的最后位置,读取以后更新
+ * @param msgVec 读取的消息
+ * @return true 成功
+ * @return false 失败
+ */
+bool CMySqlConnect::SelectGroupChatTextPartition(const std::string& strPartition, const int nLimit, ChatPartitionCursor_st& cursor, std::vector<T_GROUP_CHAT_MSG>& msgVec)
+{
+	msgVec.clear();
+	std::string strSql = "SELECT F_INDEX,F_MSG_ID,F_MSG_TYPE,F_SENDER_ID,F_GROUP_ID,F_MSG_CONTEXT,F_OTHER_INFO,F_CREATE_TIME FROM T_GROUP_CHAT_MSG PARTITION (`" + strPartition + "`) \
+WHERE F_MSG_ID>=? AND (F_MSG_ID,F_INDEX)>(?,?) ORDER BY F_MSG_ID,F_INDEX LIMIT ?;";
+	CMySqlStmt* pStmt = ExecuteStmt(strSql, static_cast<int64_t>(cursor.m_nLastMsgId), static_cast<int64_t>(cursor.m_nLastMsgId), static_cast<int64_t>(cursor.m_nLastIndex), static_cast<int64_t>(nLimit));
+	if (nullptr == pStmt)
+	{
+		return false;
+	}
+	while (pStmt->Fetch())
+	{
+		T_GROUP_CHAT_MSG chatMsg;
+		cursor.m_nLastIndex = MsgIdValue(pStmt->GetString(0));
+		chatMsg.m_strF_MSG_ID = pStmt->GetString(1);
+		cursor.m_nLastMsgId = MsgIdValue(chatMsg.m_strF_MSG_ID);
+		chatMsg.m_eChatMsgType = ChatType(pStmt->GetString(2));
+		chatMsg.m_strF_SENDER_ID = pStmt->GetString(3);
+		chatMsg.m_strF_GROUP_ID = pStmt->GetString(4);
+		chatMsg.m_strF_MSG_CONTEXT = pStmt->GetString(5);
+		chatMsg.m_strF_OTHER_INFO = pStmt->GetString(6);
+		chatMsg.m_strF_CREATE_TIME = pStmt->GetString(7);
+		msgVec.push_back(chatMsg);
+	}
+	return true;
+}
+/**
+ * @brief 连接到Mysql服务器
+ * 
+ * @param userName 数据库用户名
+ * @param passwd 数据库密码
+ * @param database 数据库名称
+ * @param strHost 数据库服务器IP
+ * @param port 数据库服务器断开
+ * @return true 连接成功
+ * @return false 连接失败
+ */
+bool CMySqlConnect::ConnectToServer(const std::string userName,
+                                    const std::string passwd,
+                                    const std::string database,
+                                    const std::string strHost,const int port,
+                                    const bool bCreateTable)
+{
+	m_strUserName = userName;
+	m_strPasswd = passwd;
+	m_strDataBase = database;
+	m_strHost = strHost;
+	m_nPort = port;
+	try{
+		if (NULL != mysql_real_connect(m_mysql, strHost.c_str(),userName.c_str(),passwd.c_str(), database.c_str(), 0,NULL, 0))
+		{
+			LOG_INFO(m_loger, "mysql_real_connect() succeed [{} {}]", __FILENAME__, __LINE__);
+			int nResult = mysql_set_character_set(m_mysql, "UTF8");
+			LOG_INFO(m_loger, "{}  succeed [{} {}]", nResult, __FILENAME__, __LINE__);
+			return bCreateTable ? CreateTable() : true;
+		}
+		else
+		{
+			LOG_ERR(m_loger, "mysql_real_connect() {} failed[{} {}]",port,__FILENAME__, __LINE__);
+            return false;
+		}
+	}
+	catch(std::exception ec)
+	{
+		LOG_INFO(m_loger,"MySql EC:{} ",ec.what());
+		return false;
+	}
+}
+
+/**
+ * @brief 根据用户名获取用户的密码
+ * 
+ * @param userName 用户名
+ * @param bean 用户名和密码的结构体
+ * @return true 获取成功
+ * @return false 获取失败
+ */
+bool CMySqlConnect::SelectUserByName(const std::string userName, T_USER_BEAN& bean)
+{
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_USER_ID,F_USER_NAME,F_PASS_WORD FROM T_USER WHERE F_USER_NAME=?;", userName);
+	if (nullptr == pStmt || !pStmt->Fetch())
+	{
+		return false;
+	}
+	bean.m_strF_USER_ID = pStmt->GetString(0);
+	bean.m_strF_USER_NAME = pStmt->GetString(1);
+	bean.m_strF_PASS_WORD = pStmt->GetString(2);
+	pStmt->FreeResult();
+	return true;
+}
+
+
+/**
+ * @brief 判断用户是否存在
+ * 
+ * @param userName 用户名
+ * @return true 存在
+ * @return false 不存在
+ */
+bool CMySqlConnect::IsUserExist(const std::string strUserId)
+{
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_USER_ID FROM T_USER WHERE F_USER_ID=?;", strUserId);
+	if (nullptr == pStmt)
+	{
+		return false;
+	}
+	bool bExist = pStmt->Fetch();
+	pStmt->FreeResult();
+	return bExist;
+}
+
+
+/**
+ * @brief 判断userName 和friendName是不是好友
+ * 
+ * @param userName 用户名
+ * @param friendName 好友用户名
+ * @return true friendName是userName的好友
+ * @return false 不是好友
+ */
+bool CMySqlConnect::IsFriend(const std::string userId,const std::string friendId)
+{
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_STATUS FROM T_FRIEND_RELATION WHERE F_USER_ID=? AND F_FRIEND_ID=?;", userId, friendId);
+	if (nullptr == pStmt)
+	{
+		return false;
+	}
+	bool bExist = pStmt->Fetch();
+	pStmt->FreeResult();
+	return bExist;
+}
+
+/**
+ * @brief 更新用户的密码
+ * 
+ * @param bean 用户名和密码的结构体
+ * @return true 更新成功
+ * @return false 更新失败
+ */
+bool CMySqlConnect::UpdateUser(const T_USER_BEAN& bean)
+{
+	return nullptr != ExecuteStmt("UPDATE T_USER SET F_PASS_WORD=? WHERE F_USER_NAME=?;", bean.m_strF_PASS_WORD, bean.m_strF_USER_NAME);
+}
+
+
+/**
+ * @brief 更新用户在线状态
+ * 
+ * @param strUserId 用户ID
+ * @param type 在线状态
+ * @return true 成功
+ * @return false 失败
+ */
+bool CMySqlConnect::UpdateUserOnlineState(const std::string strUserId, const CLIENT_STATE type)
+{
+	return nullptr != ExecuteStmt("UPDATE T_USER SET F_ON_LINE_STATE=? WHERE F_USER_ID=?;", OnLineType(type), strUserId);
+}
+
+/**
+ * @brief 批量更新用户的在线状态
+ * 
+ * @param userIdVec 用户ID
+ * @param type 在线状态
+ * @return true 成功
+ * @return false 失败
+ */
+bool CMySqlConnect::UpdateUserOnlineState(const std::vector<std::string>& userIdVec, const CLIENT_STATE type)
+{
+	//每条语句最多ONLINE_STATE_BATCH个用户,相同条数的语句只准备一次
+	const std::size_t ONLINE_STATE_BATCH = 256;
+	for (std::size_t nBegin = 0; nBegin < userIdVec.size(); nBegin += ONLINE_STATE_BATCH)
+	{
+		std::vector<std::string> batchVec(userIdVec.begin() + nBegin, userIdVec.begin() + std::min(userIdVec.size(), nBegin + ONLINE_STATE_BATCH));
+		std::string strSql = "UPDATE T_USER SET F_ON_LINE_STATE=? WHERE F_USER_ID IN (?";
+		for (std::size_t i = 1; i < batchVec.size(); i++)
+		{
+			strSql += ",?";
+		}
+		strSql += ");";
+		if (nullptr == ExecuteStmt(strSql, OnLineType(type), batchVec))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief 删除某个用户
+ * 
+ * @param userName 待删除的用户名
+ * @return true 删除成功
+ * @return false 删除失败
+ */
+bool CMySqlConnect::DeleteUser(const std::string strUserId)
+{
+	return nullptr != ExecuteStmt("DELETE FROM T_USER WHERE F_USER_ID=?;", strUserId);
+}
+
+
+/**
+ * @brief 插入用户信息到数据库
+ * 
+ * @param bean 用户名和密码的结构体
+ * @return true 成功
+ * @return false 失败
+ */
+bool CMySqlConnect::InsertUser(const T_USER_BEAN& bean)
+{
+	if (bean.IsValid())
+	{
+		return nullptr != ExecuteStmt("INSERT INTO T_USER(F_USER_ID,F_USER_NAME,F_PASS_WORD,F_NICK_NAME) VALUES(?,?,?,?);",
+			bean.m_strF_USER_ID, bean.m_strF_USER_NAME, bean.m_strF_PASS_WORD, bean.m_strF_NICK_NAME);
+	}
+	else
+	{
+		LOG_ERR(m_loger, "Bean Is Not Valid [{} {}]", __FILENAME__, __LINE__);
+		return false;
+	}
+	
+}
+
+/**
+ * @brief 根据用户名查找用户的其他信息
+ * 
+ * @param userName 用户名
  * @param bean 用户的其他信息
  * @return true 成功
  * @return false 失败
  */
 bool CMySqlConnect::SelectUserInfoByName(const std::string userId, T_USER_INFO_BEAN& bean)
 {
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_USER_ID,\
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_USER_ID,\
 F_USER_NAME,\
 F_ADDRESS,\
 F_BIRTH_DATE,\
@@ -731,39 +1108,24 @@ F_NICK_NAME,\
 F_SIGNATURE,\
 F_FACE_ID,\
 F_ON_LINE_STATE \
-FROM T_USER WHERE F_USER_ID='{0}' OR F_USER_NAME='{0}';";
-	
-	std::string strSql = fmt::format(strTemplate2, userId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				bean.m_strF_USER_ID = sql_row[0];
-				bean.m_strF_USER_NAME = sql_row[1];
-				bean.m_strF_ADDRESS = sql_row[2];
-				bean.m_strF_BIRTH_DATE = sql_row[3];
-				bean.m_strF_EMAIL_ADDR = sql_row[4];
-				bean.m_strF_NICK_NAME = sql_row[5];
-				bean.m_strF_SIGNATURE = sql_row[6];
-				bean.m_strF_FACE_ID = sql_row[7];
-				bean.m_eOnlineState = OnLineType(sql_row[8]);
-				break;
-			}
-		}
-	}
-	else
+FROM T_USER WHERE F_USER_ID=? OR F_USER_NAME=?;", userId, userId);
+	if (nullptr == pStmt)
 	{
 		return false;
 	}
-	if (result != NULL)
+	if (pStmt->Fetch())
 	{
-		mysql_free_result(result);
+		bean.m_strF_USER_ID = pStmt->GetString(0);
+		bean.m_strF_USER_NAME = pStmt->GetString(1);
+		bean.m_strF_ADDRESS = pStmt->GetString(2);
+		bean.m_strF_BIRTH_DATE = pStmt->GetString(3);
+		bean.m_strF_EMAIL_ADDR = pStmt->GetString(4);
+		bean.m_strF_NICK_NAME = pStmt->GetString(5);
+		bean.m_strF_SIGNATURE = pStmt->GetString(6);
+		bean.m_strF_FACE_ID = pStmt->GetString(7);
+		bean.m_eOnlineState = OnLineType(pStmt->GetString(8));
 	}
+	pStmt->FreeResult();
 	return true;
 }
 
@@ -777,26 +1139,14 @@ FROM T_USER WHERE F_USER_ID='{0}' OR F_USER_NAME='{0}';";
  */
 bool CMySqlConnect::UpdateUserInfo(const T_USER_INFO_BEAN& bean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "UPDATE T_USER SET F_ADDRESS='{0}',F_BIRTH_DATE='{1}',F_EMAIL_ADDR='{2}',F_NICK_NAME='{3}',F_SIGNATURE='{4}',F_FACE_ID='{5}' WHERE F_USER_NAME='{6}';";
-	std::string strSql = fmt::format(strTemplate2,bean.m_strF_ADDRESS,
+	return nullptr != ExecuteStmt("UPDATE T_USER SET F_ADDRESS=?,F_BIRTH_DATE=?,F_EMAIL_ADDR=?,F_NICK_NAME=?,F_SIGNATURE=?,F_FACE_ID=? WHERE F_USER_NAME=?;",
+		bean.m_strF_ADDRESS,
 		bean.m_strF_BIRTH_DATE,
 		bean.m_strF_EMAIL_ADDR,
 		bean.m_strF_NICK_NAME,
 		bean.m_strF_SIGNATURE,
 		bean.m_strF_FACE_ID,
 		bean.m_strF_USER_NAME);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-		return true;
-	}
-	else
-	{
-		return false;
-	}
-	return false;
 }
 
 /**
@@ -808,28 +1158,21 @@ bool CMySqlConnect::UpdateUserInfo(const T_USER_INFO_BEAN& bean)
  */
 bool CMySqlConnect::InsertUserInfo(const T_USER_INFO_BEAN& bean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "INSERT INTO T_USER(\
+	return nullptr != ExecuteStmt("INSERT INTO T_USER(\
 F_USER_NAME,\
 F_ADDRESS,\
 F_BIRTH_DATE,\
 F_EMAIL_ADDR,\
 F_NICK_NAME,\
 F_SIGNATURE,\
-F_FACE_ID) VALUES('{0}','{1}','{2},'{3}','{4}','{5}','{6}');";
-	std::string strSql = fmt::format(strTemplate2, bean.m_strF_USER_NAME, bean.m_strF_ADDRESS,bean.m_strF_BIRTH_DATE,bean.m_strF_EMAIL_ADDR,bean.m_strF_NICK_NAME,bean.m_strF_SIGNATURE,bean.m_strF_FACE_ID);
-
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-		return true;
-	}
-	else
-	{
-		return false;
-	}
-
+F_FACE_ID) VALUES(?,?,?,?,?,?,?);",
+		bean.m_strF_USER_NAME,
+		bean.m_strF_ADDRESS,
+		bean.m_strF_BIRTH_DATE,
+		bean.m_strF_EMAIL_ADDR,
+		bean.m_strF_NICK_NAME,
+		bean.m_strF_SIGNATURE,
+		bean.m_strF_FACE_ID);
 }
 
 
@@ -841,72 +1184,105 @@ F_FACE_ID) VALUES('{0}','{1}','{2},'{3}','{4}','{5}','{6}');";
  * @return false 失败
  */
 bool CMySqlConnect::InsertFriendChatMsg(const T_USER_CHAT_MSG& chatMsg) {
-
-	if (nullptr == m_pFriendChatInsertStmt)
-	{
-		m_pFriendChatInsertStmt = mysql_stmt_init(m_mysql); 
-		if (!m_pFriendChatInsertStmt)
-		{
-			return false;
-		}
-		std::string strSql = "INSERT INTO T_FRIEND_CHAT_MSG(F_MSG_ID,\
+	return nullptr != ExecuteStmt("INSERT INTO T_FRIEND_CHAT_MSG(F_MSG_ID,\
 F_MSG_TYPE,\
 F_FROM_ID,\
 F_TO_ID,\
 F_MSG_CONTEXT,\
-F_OTHER_INFO) VALUES(?,?,?,?,?,?);";
-		if (mysql_stmt_prepare(m_pFriendChatInsertStmt, strSql.c_str(), static_cast<unsigned long>(strSql.size())))
-		{
-			return false;
-		}
-	}
-
-	MYSQL_BIND paramBind[6];
-	memset(paramBind, 0, sizeof(paramBind));
-	{
-		paramBind[0].buffer_type = MYSQL_TYPE_STRING;
-		paramBind[0].buffer = (void*)(chatMsg.m_strF_MSG_ID.c_str());
-		paramBind[0].buffer_length = static_cast<unsigned long>(chatMsg.m_strF_MSG_ID.length());
-
-		paramBind[1].buffer_type = MYSQL_TYPE_STRING;
-		std::string strMsgType = ChatType(chatMsg.m_eChatMsgType);
-		paramBind[1].buffer = (void*)(strMsgType.c_str());
-		paramBind[1].buffer_length = static_cast<unsigned long>(strMsgType.length());
+F_OTHER_INFO) VALUES(?,?,?,?,?,?);",
+		chatMsg.m_strF_MSG_ID,
+		ChatType(chatMsg.m_eChatMsgType),
+		chatMsg.m_strF_FROM_ID,
+		chatMsg.m_strF_TO_ID,
+		chatMsg.m_strF_MSG_CONTEXT,
+		chatMsg.m_strF_OTHER_INFO);
+}
 
-		paramBind[2].buffer_type = MYSQL_TYPE_STRING;
-		paramBind[2].buffer = (void*)(chatMsg.m_strF_FROM_ID.c_str());
-		paramBind[2].buffer_length = static_cast<unsigned long>(chatMsg.m_strF_FROM_ID.length());
 
-		paramBind[3].buffer_type = MYSQL_TYPE_STRING;
-		paramBind[3].buffer = (void*)(chatMsg.m_strF_TO_ID.c_str());
-		paramBind[3].buffer_length = static_cast<unsigned long>(chatMsg.m_strF_TO_ID.length());
+/**
+ * @brief 生成多行插入的VALUES部分
+ * 
+ * @param strRow 一行的占位符,例如"(?,?)"
+ * @param nRows 行数
+ */
+static std::string MultiRowValues(const std::string& strRow, const std::size_t nRows)
+{
+	std::string strValues = strRow;
+	for (std::size_t i = 1; i < nRows; i++)
+	{
+		strValues += "," + strRow;
+	}
+	return strValues;
+}
 
-		paramBind[4].buffer_type = MYSQL_TYPE_STRING;
-		paramBind[4].buffer = (void*)(chatMsg.m_strF_MSG_CONTEXT.c_str());
-		paramBind[4].buffer_length = static_cast<unsigned long>(chatMsg.m_strF_MSG_CONTEXT.length());
+//多行插入时每条语句的最大行数,按2的幂拆分,每个连接上最多准备log2(n)+1条语句
+const std::size_t CHAT_MSG_INSERT_ROWS = 64;
 
-		paramBind[5].buffer_type = MYSQL_TYPE_STRING;
-		paramBind[5].buffer = (void*)(chatMsg.m_strF_OTHER_INFO.c_str());
-		paramBind[5].buffer_length = static_cast<unsigned long>(chatMsg.m_strF_OTHER_INFO.length());
+static std::size_t NextInsertRows(const std::size_t nRemain)
+{
+	std::size_t nRows = CHAT_MSG_INSERT_ROWS;
+	while (nRows > nRemain)
+	{
+		nRows /= 2;
+	}
+	return nRows;
+}
 
-		if (mysql_stmt_bind_param(m_pFriendChatInsertStmt, paramBind))
+/**
+ * @brief 批量插入好友聊天消息,使用消息生成时的时间作为创建时间
+ * 
+ * 由调用者决定是否放在一个事务中
+ * @param msgVec 好友聊天消息
+ * @return true 全部插入成功
+ * @return false 插入失败
+ */
+bool CMySqlConnect::InsertFriendChatMsg(const std::vector<T_USER_CHAT_MSG>& msgVec)
+{
+	std::size_t nIndex = 0;
+	while (nIndex < msgVec.size())
+	{
+		std::size_t nRows = NextInsertRows(msgVec.size() - nIndex);
+		std::vector<std::string> valueVec;
+		valueVec.reserve(nRows * 7);
+		for (std::size_t i = nIndex; i < nIndex + nRows; i++)
 		{
-			return false;
-		}
-		try {
-			if (mysql_stmt_execute(m_pFriendChatInsertStmt))
-			{
-				return false;
-			}
+			const auto& chatMsg = msgVec[i];
+			valueVec.push_back(chatMsg.m_strF_MSG_ID);
+			valueVec.push_back(ChatType(chatMsg.m_eChatMsgType));
+			valueVec.push_back(chatMsg.m_strF_FROM_ID);
+			valueVec.push_back(chatMsg.m_strF_TO_ID);
+			valueVec.push_back(chatMsg.m_strF_MSG_CONTEXT);
+			valueVec.push_back(chatMsg.m_strF_OTHER_INFO);
+			valueVec.push_back(chatMsg.m_strF_CREATE_TIME);
 		}
-		catch (std::exception ec)
+		std::string strSql = "INSERT INTO T_FRIEND_CHAT_MSG(F_MSG_ID,F_MSG_TYPE,F_FROM_ID,F_TO_ID,F_MSG_CONTEXT,F_OTHER_INFO,F_CREATE_TIME) VALUES" +
+			MultiRowValues("(?,?,?,?,?,?,?)", nRows) + ";";
+		if (nullptr == ExecuteStmt(strSql, valueVec))
 		{
-			LOG_ERR(m_loger, "EC:{} [{} {}]", ec.what(), __FILENAME__, __LINE__);
+			return false;
 		}
+		nIndex += nRows;
 	}
 	return true;
 }
 
+/**
+ * @brief 判断好友聊天消息是否已经入库,恢复本地日志时跳过已经入库的消息
+ * 
+ * @param strMsgId 消息ID
+ * @return true 已经入库
+ * @return false 没有入库
+ */
+bool CMySqlConnect::IsFriendChatMsgExist(const std::string& strMsgId)
+{
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_INDEX FROM T_FRIEND_CHAT_MSG WHERE F_MSG_ID=? LIMIT 1;", MsgIdValue(strMsgId));
+	if (nullptr == pStmt || !pStmt->Fetch())
+	{
+		return false;
+	}
+	pStmt->FreeResult();
+	return true;
+}
 
 /**
  * @brief 根据消息ID更新消息的状态
@@ -918,46 +1294,48 @@ F_OTHER_INFO) VALUES(?,?,?,?,?,?);";
  */
 bool CMySqlConnect::UpdateFriendChatMsgState(const std::string& strMsgId, const std::string msgState)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "UPDATE T_FRIEND_CHAT_MSG SET F_READ_FLAG='{0}',F_READ_TIME=now() WHERE F_MSG_ID='{1}';";
-	std::string strSql = fmt::format(strTemplate2, msgState, strMsgId);
-	
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-		auto nRows = mysql_affected_rows(m_mysql);
-		LOG_INFO(m_loger, "SQL:{}  Rows:{} [{}  {} ]", strSql, nRows,__FILENAME__, __LINE__);
-		return true;
-	}
-	else
+	CMySqlStmt* pStmt = ExecuteStmt("UPDATE T_FRIEND_CHAT_MSG SET F_READ_FLAG=?,F_READ_TIME=now() WHERE F_MSG_ID=?;", msgState, MsgIdValue(strMsgId));
+	if (nullptr == pStmt)
 	{
-		LOG_ERR(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
 		return false;
 	}
-
+	LOG_INFO(m_loger, "MsgId:{} State:{} Rows:{} [{}  {} ]", strMsgId, msgState, pStmt->AffectedRows(), __FILENAME__, __LINE__);
+	return true;
 }
 
 /**
- * @brief 从队列中获取未读消息
+ * @brief 根据消息ID批量更新消息的状态,一次确认窗口中的消息只执行一次UPDATE
  * 
- * @param strUserId 用户ID
- * @param chatMsg 未读消息
- * @return true 获取成功
- * @return false 获取失败
+ * @param msgIdVec 消息ID
+ * @param msgState 消息的状态，为未读('UN_READ')或者已读('READ')
+ * @return true 成功
+ * @return false 失败
  */
-bool CMySqlConnect::UnReadFromQueue(const std::string strUserId, T_USER_CHAT_MSG& chatMsg)
+bool CMySqlConnect::UpdateFriendChatMsgState(const std::vector<std::string>& msgIdVec, const std::string msgState)
 {
-	auto item = m_unReadChatMsg.find(strUserId);
-	if (item != m_unReadChatMsg.end())
+	if (msgIdVec.empty())
 	{
-		if (!m_unReadChatMsg[strUserId].empty())
-		{
-			chatMsg = m_unReadChatMsg[strUserId].front();
-			m_unReadChatMsg[strUserId].pop();
-			return true;
-		}
+		return true;
+	}
+	//相同条数的语句只准备一次,条数不超过下发窗口的大小
+	std::string strSql = "UPDATE T_FRIEND_CHAT_MSG SET F_READ_FLAG=?,F_READ_TIME=now() WHERE F_MSG_ID IN (?";
+	for (std::size_t i = 1; i < msgIdVec.size(); i++)
+	{
+		strSql += ",?";
+	}
+	strSql += ");";
+	std::vector<int64_t> idValueVec;
+	for (const auto& strMsgId : msgIdVec)
+	{
+		idValueVec.push_back(MsgIdValue(strMsgId));
 	}
-	return false;
+	CMySqlStmt* pStmt = ExecuteStmt(strSql, msgState, idValueVec);
+	if (nullptr == pStmt)
+	{
+		return false;
+	}
+	LOG_INFO(m_loger, "MsgCount:{} State:{} Rows:{} [{}  {} ]", msgIdVec.size(), msgState, pStmt->AffectedRows(), __FILENAME__, __LINE__);
+	return true;
 }
 
 /**
@@ -969,81 +1347,52 @@ bool CMySqlConnect::UnReadFromQueue(const std::string strUserId, T_USER_CHAT_MSG
  */
 bool CMySqlConnect::HaveUnReadMsg(const std::string strUserId)
 {
-	auto item = m_unReadChatMsg.find(strUserId);
-	if (item != m_unReadChatMsg.end())
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_MSG_ID FROM T_FRIEND_CHAT_MSG WHERE F_TO_ID=? AND F_READ_FLAG='UNREAD' AND F_MSG_TYPE=? LIMIT 1;",
+		strUserId, ChatType(CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE));
+	if (nullptr == pStmt || !pStmt->Fetch())
 	{
-		if (!(m_unReadChatMsg[strUserId].empty()))
-		{
-			return true;
-		}
+		return false;
 	}
-	return SaveMsgToQueue(strUserId);
+	pStmt->FreeResult();
+	return true;
 }
+
 /**
- * @brief 选择未读的聊天消息
+ * @brief 按写入的顺序读取一页未读的文本消息
  * 
- * @param strToID 接收方用户名
- * @param chatMsg 聊天消息
+ * 已经下发但是还没有更新为已读的消息也会被读到,调用者需要等这些消息更新完成以后再读取下一页
+ * 按(F_TO_ID,F_READ_FLAG,F_MSG_ID)索引的顺序读取,不需要排序
+ * 
+ * @param strToID 接收方用户ID
+ * @param nLimit 最多读取的条数
+ * @param chatMsgVec 未读消息
  * @return true 成功
  * @return false 失败
  */
-bool CMySqlConnect::SelectUnReadFriendChatMsg(const std::string& strToID, T_USER_CHAT_MSG& chatMsgNew)
+bool CMySqlConnect::SelectUnReadFriendChatMsg(const std::string& strToID, const int nLimit, std::vector<T_USER_CHAT_MSG>& chatMsgVec)
 {
-	if (UnReadFromQueue(strToID, chatMsgNew))
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_MSG_ID,F_MSG_TYPE,F_FROM_ID,F_TO_ID,F_MSG_CONTEXT,F_OTHER_INFO,F_CREATE_TIME FROM T_FRIEND_CHAT_MSG WHERE F_TO_ID=? AND F_READ_FLAG='UNREAD' AND F_MSG_TYPE=? ORDER BY F_MSG_ID LIMIT ?;",
+		strToID, ChatType(CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE), static_cast<int64_t>(nLimit));
+	if (nullptr == pStmt)
 	{
-		return true;
+		return false;
 	}
-	else
+	chatMsgVec.clear();
+	while (pStmt->Fetch())
 	{
-		SaveMsgToQueue(strToID);
+		T_USER_CHAT_MSG chatMsg;
+		chatMsg.m_strF_MSG_ID = pStmt->GetString(0);
+		chatMsg.m_eChatMsgType = ChatType(pStmt->GetString(1));
+		chatMsg.m_strF_FROM_ID = pStmt->GetString(2);
+		chatMsg.m_strF_TO_ID = pStmt->GetString(3);
+		chatMsg.m_strF_MSG_CONTEXT = pStmt->GetString(4);
+		chatMsg.m_strF_OTHER_INFO = pStmt->GetString(5);
+		chatMsg.m_strF_CREATE_TIME = pStmt->GetString(6);
+		chatMsgVec.push_back(chatMsg);
 	}
-	return UnReadFromQueue(strToID, chatMsgNew);
+	return true;
 }
 
-/**
- * @brief 从数据库中读取未读消息保存到未读队列
- * 
- * @param strUserId 用户ID
- * @return true 保存成功
- * @return false 保存失败
- */
-bool CMySqlConnect::SaveMsgToQueue(const std::string strUserId)
-{
-	std::queue<T_USER_CHAT_MSG> chatMsgQueue;
-	bool bResult = false;
-	MYSQL_RES *result = nullptr;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_MSG_ID,F_MSG_TYPE,F_FROM_ID,F_TO_ID,F_MSG_CONTEXT,F_OTHER_INFO,F_CREATE_TIME FROM T_FRIEND_CHAT_MSG WHERE (F_TO_ID={0} AND F_READ_FLAG='UNREAD');";
-	std::string strSql = fmt::format(strTemplate2, strUserId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			T_USER_CHAT_MSG chatMsg;
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				chatMsg.m_strF_MSG_ID = (sql_row[0]);
-				chatMsg.m_eChatMsgType = ChatType(sql_row[1]);
-				chatMsg.m_strF_FROM_ID = sql_row[2];
-				chatMsg.m_strF_TO_ID = sql_row[3];
-				chatMsg.m_strF_MSG_CONTEXT = sql_row[4];
-				chatMsg.m_strF_OTHER_INFO = sql_row[5];
-				chatMsg.m_strF_CREATE_TIME = sql_row[6];
-				chatMsgQueue.push(chatMsg);
-				bResult = true;
-			}
-		}
-		mysql_free_result(result);
-	}
-	m_unReadChatMsg.erase(strUserId);
-	m_unReadChatMsg.insert({ strUserId,chatMsgQueue });
-
-	return bResult;
-}
 /**
  * @brief 删除好友聊天消息
  * 
@@ -1052,20 +1401,7 @@ bool CMySqlConnect::SaveMsgToQueue(const std::string strUserId)
  * @return false 失败
  */
 bool CMySqlConnect::DeleteFriendChatMsg(const uint64_t msgId){
-	int res = 0;
-	constexpr char strTemplate2[] = "DELETE FROM T_FRIEND_CHAT_MSG WHERE F_MSG_ID='{0}';";
-	std::string strSql = fmt::format(strTemplate2, msgId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("DELETE FROM T_FRIEND_CHAT_MSG WHERE F_MSG_ID=?;", static_cast<int64_t>(msgId));
 }
 
 /**
@@ -1079,41 +1415,23 @@ bool CMySqlConnect::DeleteFriendChatMsg(const uint64_t msgId){
 bool CMySqlConnect::GetUserFriendList(const std::string strUser, std::vector<T_FRIEND_RELATION_BEAN>& friendList)
 {
 	bool bResult = false;
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_TEAM_ID,\
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_TEAM_ID,\
 F_FRIEND_ID,\
 F_STATUS \
-FROM T_FRIEND_RELATION WHERE F_USER_ID='{0}' ORDER BY F_TEAM_ID DESC;";
-	std::string strSql = fmt::format(strTemplate2, strUser);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			T_FRIEND_RELATION_BEAN bean;
-			bean.m_strF_USER_ID = strUser;
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				bean.m_strF_TEAM_ID = sql_row[0];
-				bean.m_strF_FRIEND_ID = sql_row[1];
-				bean.m_eF_STATUS = E_FRIEND_RELATION::E_FRIEND_TYPE;
-				friendList.push_back(bean);
-				bResult = true;
-			}
-		}
-	}
-	else
+FROM T_FRIEND_RELATION WHERE F_USER_ID=? ORDER BY F_TEAM_ID DESC;", strUser);
+	if (nullptr == pStmt)
 	{
 		return bResult;
 	}
-	if (result != NULL)
+	T_FRIEND_RELATION_BEAN bean;
+	bean.m_strF_USER_ID = strUser;
+	while (pStmt->Fetch())
 	{
-		mysql_free_result(result);
-		return bResult;
+		bean.m_strF_TEAM_ID = pStmt->GetString(0);
+		bean.m_strF_FRIEND_ID = pStmt->GetString(1);
+		bean.m_eF_STATUS = E_FRIEND_RELATION::E_FRIEND_TYPE;
+		friendList.push_back(bean);
+		bResult = true;
 	}
 	return bResult;
 }
@@ -1128,35 +1446,65 @@ FROM T_FRIEND_RELATION WHERE F_USER_ID='{0}' ORDER BY F_TEAM_ID DESC;";
 bool CMySqlConnect::GetUserFriendList(const std::string strUserName,std::vector<std::string>& friendList)
 {
 	bool bResult = false;
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_FRIEND_ID FROM T_FRIEND_RELATION WHERE F_USER_ID='{0}';";
-	std::string strSql = fmt::format(strTemplate2, strUserName);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				std::string strResult = sql_row[0];
-				friendList.push_back(strResult);
-				bResult = true;
-			}
-		}
-	}
-	else
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_FRIEND_ID FROM T_FRIEND_RELATION WHERE F_USER_ID=?;", strUserName);
+	if (nullptr == pStmt)
 	{
 		return bResult;
 	}
-	if (result != NULL)
+	while (pStmt->Fetch())
+	{
+		friendList.push_back(pStmt->GetString(0));
+		bResult = true;
+	}
+	return bResult;
+}
+
+/**
+ * @brief 获取用户的好友关系和好友的资料,一次查询代替每个好友查询一次资料
+ * 
+ * @param strUser 用户ID
+ * @param friendList 好友列表,按分组ID降序
+ * @return true 有好友
+ * @return false 没有好友或者查询失败
+ */
+bool CMySqlConnect::SelectFriendInfoList(const std::string strUser, std::vector<T_FRIEND_INFO_BEAN>& friendList)
+{
+	bool bResult = false;
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT R.F_TEAM_ID,\
+R.F_FRIEND_ID,\
+U.F_USER_NAME,\
+U.F_ADDRESS,\
+U.F_BIRTH_DATE,\
+U.F_EMAIL_ADDR,\
+U.F_NICK_NAME,\
+U.F_SIGNATURE,\
+U.F_FACE_ID,\
+U.F_ON_LINE_STATE \
+FROM T_FRIEND_RELATION R INNER JOIN T_USER U ON U.F_USER_ID=R.F_FRIEND_ID \
+WHERE R.F_USER_ID=? ORDER BY R.F_TEAM_ID DESC;", strUser);
+	if (nullptr == pStmt)
 	{
-		mysql_free_result(result);
 		return bResult;
 	}
+	T_FRIEND_INFO_BEAN bean;
+	bean.m_relation.m_strF_USER_ID = strUser;
+	bean.m_relation.m_eF_STATUS = E_FRIEND_RELATION::E_FRIEND_TYPE;
+	while (pStmt->Fetch())
+	{
+		bean.m_relation.m_strF_TEAM_ID = pStmt->GetString(0);
+		bean.m_relation.m_strF_FRIEND_ID = pStmt->GetString(1);
+		bean.m_userInfo.m_strF_USER_ID = bean.m_relation.m_strF_FRIEND_ID;
+		bean.m_userInfo.m_strF_USER_NAME = pStmt->GetString(2);
+		bean.m_userInfo.m_strF_ADDRESS = pStmt->GetString(3);
+		bean.m_userInfo.m_strF_BIRTH_DATE = pStmt->GetString(4);
+		bean.m_userInfo.m_strF_EMAIL_ADDR = pStmt->GetString(5);
+		bean.m_userInfo.m_strF_NICK_NAME = pStmt->GetString(6);
+		bean.m_userInfo.m_strF_SIGNATURE = pStmt->GetString(7);
+		bean.m_userInfo.m_strF_FACE_ID = pStmt->GetString(8);
+		bean.m_userInfo.m_eOnlineState = OnLineType(pStmt->GetString(9));
+		friendList.push_back(bean);
+		bResult = true;
+	}
 	return bResult;
 }
 
@@ -1169,24 +1517,11 @@ bool CMySqlConnect::GetUserFriendList(const std::string strUserName,std::vector<
  */
 bool CMySqlConnect::InsertFriendRelation(const T_FRIEND_RELATION_BEAN& bean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "INSERT INTO T_FRIEND_RELATION(F_USER_ID,\
+	return nullptr != ExecuteStmt("INSERT INTO T_FRIEND_RELATION(F_USER_ID,\
 F_FRIEND_ID,\
 F_TEAM_ID,\
 F_STATUS,\
-F_CREATE_TIME) VALUES('{0}','{1}','{2}','{3}',now());";
-	std::string strSql = fmt::format(strTemplate2,bean.m_strF_USER_ID,bean.m_strF_FRIEND_ID,bean.m_strF_TEAM_ID,FriendRelation(bean.m_eF_STATUS));
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+F_CREATE_TIME) VALUES(?,?,?,?,now());", bean.m_strF_USER_ID, bean.m_strF_FRIEND_ID, bean.m_strF_TEAM_ID, FriendRelation(bean.m_eF_STATUS));
 }
 
 /**
@@ -1200,29 +1535,15 @@ F_CREATE_TIME) VALUES('{0}','{1}','{2}','{3}',now());";
  */
 bool CMySqlConnect::InsertFriendRelation(const std::string strUser, const std::string strFriend, const E_FRIEND_RELATION relationType)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "INSERT INTO T_FRIEND_RELATION(F_USER_ID,\
-F_FRIEND_ID,\
-F_TEAM_ID,\
-F_STATUS,F_CREATE_TIME) VALUES('{0}','{1}','10000000','{2}',now());";
 	std::string strRelation = "FRIEND";
 	if (relationType == E_FRIEND_RELATION::E_BLACK_TYPE)
 	{
 		strRelation = "BLACK";
 	}
-	std::string strSql = fmt::format(strTemplate2, strUser, strFriend, strRelation);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		LOG_ERR(m_loger, "{} [{} {}]", strSql, __FILENAME__, __LINE__);
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("INSERT INTO T_FRIEND_RELATION(F_USER_ID,\
+F_FRIEND_ID,\
+F_TEAM_ID,\
+F_STATUS,F_CREATE_TIME) VALUES(?,?,'10000000',?,now());", strUser, strFriend, strRelation);
 }
 
 /**
@@ -1235,20 +1556,7 @@ F_STATUS,F_CREATE_TIME) VALUES('{0}','{1}','10000000','{2}',now());";
  */
 bool CMySqlConnect::DeleteFriendRelation(const std::string strUser, const std::string strFriend)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "DELETE FROM T_FRIEND_RELATION WHERE F_USER_ID='{0}' AND F_FRIEND_ID='{1}';";
-	std::string strSql = fmt::format(strTemplate2, strUser,strFriend);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("DELETE FROM T_FRIEND_RELATION WHERE F_USER_ID=? AND F_FRIEND_ID=?;", strUser, strFriend);
 }
 
 /**
@@ -1261,21 +1569,7 @@ bool CMySqlConnect::DeleteFriendRelation(const std::string strUser, const std::s
  */
 bool CMySqlConnect::UpdateFriendRelation(const T_FRIEND_RELATION_BEAN& bean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "UPDATE T_FRIEND_RELATION SET F_TEAM_ID='{0}' WHERE F_USER_ID='{1}' AND F_FRIEND_ID='{2}';";
-	std::string strSql = fmt::format(strTemplate2,bean.m_strF_TEAM_ID,bean.m_strF_USER_ID,bean.m_strF_FRIEND_ID);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
-	return false;
+	return nullptr != ExecuteStmt("UPDATE T_FRIEND_RELATION SET F_TEAM_ID=? WHERE F_USER_ID=? AND F_FRIEND_ID=?;", bean.m_strF_TEAM_ID, bean.m_strF_USER_ID, bean.m_strF_FRIEND_ID);
 }
 /**
  * @brief 查询A用户和B用户的好友关系
@@ -1288,51 +1582,28 @@ bool CMySqlConnect::UpdateFriendRelation(const T_FRIEND_RELATION_BEAN& bean)
  */
 bool CMySqlConnect::SelectFriendRelation(const std::string strUser, const std::string strFriend, E_FRIEND_RELATION& relationType)
 {
-	bool bResult = false;
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_STATUS FROM T_FRIEND_RELATION WHERE F_USER_NAME='{0}' AND F_FRIEND_NAME='{1}';";
-	std::string strSql = fmt::format(strTemplate2, strUser, strFriend);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_STATUS FROM T_FRIEND_RELATION WHERE F_USER_ID=? AND F_FRIEND_ID=?;", strUser, strFriend);
+	if (nullptr == pStmt || !pStmt->Fetch())
+	{
+		return false;
+	}
 	const std::string strFriendRelation = "FRIEND";
 	const std::string strBlackRelation = "BLACK";
-
-	if (!res)
+	std::string strStatus = pStmt->GetString(0);
+	if (strStatus == strFriendRelation)
 	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				if(sql_row[0]==strFriendRelation)
-				{
-					relationType = E_FRIEND_RELATION::E_FRIEND_TYPE;
-				}
-				else if(sql_row[0]==strBlackRelation)
-				{
-					relationType = E_FRIEND_RELATION::E_BLACK_TYPE;
-				}
-				else
-				{
-					relationType = E_FRIEND_RELATION::E_STRANGER_TYPE;
-				}
-				bResult = true;
-				break;
-			}
-		}
+		relationType = E_FRIEND_RELATION::E_FRIEND_TYPE;
 	}
-	else
+	else if (strStatus == strBlackRelation)
 	{
-		return bResult;
+		relationType = E_FRIEND_RELATION::E_BLACK_TYPE;
 	}
-	if (result != NULL)
+	else
 	{
-		mysql_free_result(result);
-		return bResult;
+		relationType = E_FRIEND_RELATION::E_STRANGER_TYPE;
 	}
-	return bResult;
+	pStmt->FreeResult();
+	return true;
 }
 
 /**
@@ -1346,20 +1617,7 @@ bool CMySqlConnect::SelectFriendRelation(const std::string strUser, const std::s
  */
 bool CMySqlConnect::UpdateFriendTeamId(const std::string strUser, const std::string strOldTeamId, const std::string strNewTeamId)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "UPDATE T_FRIEND_RELATION SET F_TEAM_ID='{0}' WHERE F_USER_ID='{1}' AND F_TEAM_ID='{2}';";
-	std::string strSql = fmt::format(strTemplate2,strNewTeamId,strUser,strOldTeamId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("UPDATE T_FRIEND_RELATION SET F_TEAM_ID=? WHERE F_USER_ID=? AND F_TEAM_ID=?;", strNewTeamId, strUser, strOldTeamId);
 }
 /**
  * @brief 更新好友关系
@@ -1386,31 +1644,17 @@ bool CMySqlConnect::UpdateFriendRelation(const std::string strUser, const std::s
  */
 bool CMySqlConnect::InsertAddFriendMsg(const T_ADD_FRIEND_MSG_BEAN msgBean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "INSERT INTO T_ADD_FRIEND_MSG(F_MSG_ID,\
+	return nullptr != ExecuteStmt("INSERT INTO T_ADD_FRIEND_MSG(F_MSG_ID,\
 F_USER_ID,\
 F_FRIEND_ID,\
 F_ADD_FRIEND_STATUS,\
 F_FRIEND_OPTION,F_CREATE_TIME)\
-VALUES('{0}','{1}','{2}','{3}','{4}',now());";
-
-	std::string strSql = fmt::format(strTemplate2, 
-								msgBean.m_strF_MSG_ID,
-								msgBean.m_strF_USER_ID,
-								msgBean.m_strF_FRIEND_ID,
-								FriendStatus(msgBean.m_eF_ADD_FRIEND_STATUS),
-		                        FriendOption(msgBean.m_eF_FRIEND_OPTION));
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+VALUES(?,?,?,?,?,now());",
+		msgBean.m_strF_MSG_ID,
+		msgBean.m_strF_USER_ID,
+		msgBean.m_strF_FRIEND_ID,
+		FriendStatus(msgBean.m_eF_ADD_FRIEND_STATUS),
+		FriendOption(msgBean.m_eF_FRIEND_OPTION));
 }
 
 /**
@@ -1422,40 +1666,17 @@ VALUES('{0}','{1}','{2}','{3}','{4}',now());";
  * @return false 失败
  */
 bool CMySqlConnect::SelectUnReadAddFriendMsg(const std::string strUserName, T_ADD_FRIEND_MSG_BEAN& msgBean)
-{
-	bool bResult = false;
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_MSG_ID,F_USER_ID FROM T_ADD_FRIEND_MSG WHERE F_FRIEND_ID='{0}' AND F_ADD_FRIEND_STATUS='UN_READ';";
-	std::string strSql = fmt::format(strTemplate2, strUserName);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				msgBean.m_strF_MSG_ID = sql_row[0];
-				msgBean.m_strF_FRIEND_ID = sql_row[1];
-				msgBean.m_strF_USER_ID = strUserName;
-				bResult = true;
-				break;
-			}
-		}
-	}
-	else
-	{
-		return bResult;
-	}
-	if (result != NULL)
+{
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_MSG_ID,F_USER_ID FROM T_ADD_FRIEND_MSG WHERE F_FRIEND_ID=? AND F_ADD_FRIEND_STATUS='UN_READ';", strUserName);
+	if (nullptr == pStmt || !pStmt->Fetch())
 	{
-		mysql_free_result(result);
-		return bResult;
+		return false;
 	}
-	return bResult;
+	msgBean.m_strF_MSG_ID = pStmt->GetString(0);
+	msgBean.m_strF_FRIEND_ID = pStmt->GetString(1);
+	msgBean.m_strF_USER_ID = strUserName;
+	pStmt->FreeResult();
+	return true;
 }
 
 
@@ -1469,41 +1690,18 @@ bool CMySqlConnect::SelectUnReadAddFriendMsg(const std::string strUserName, T_AD
  */
 bool CMySqlConnect::SelectUnNotifyAddFriendMsg(const std::string strUserName, T_ADD_FRIEND_MSG_BEAN& msgBean)
 {
-	bool bResult = false;
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_MSG_ID,\
-F_FRIEND_ID,F_FRIEND_OPTION  FROM T_ADD_FRIEND_MSG WHERE F_USER_ID='{0}' AND F_ADD_FRIEND_STATUS='READ_UN_NOTIFY';";
-	std::string strSql = fmt::format(strTemplate2, strUserName);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				msgBean.m_strF_MSG_ID = sql_row[0];
-				msgBean.m_strF_USER_ID = strUserName;
-				msgBean.m_strF_FRIEND_ID = sql_row[1];
-				msgBean.m_eF_FRIEND_OPTION = FriendOption(sql_row[2]);
-				bResult = true;
-				break;
-			}
-		}
-	}
-	else
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_MSG_ID,\
+F_FRIEND_ID,F_FRIEND_OPTION  FROM T_ADD_FRIEND_MSG WHERE F_USER_ID=? AND F_ADD_FRIEND_STATUS='READ_UN_NOTIFY';", strUserName);
+	if (nullptr == pStmt || !pStmt->Fetch())
 	{
-		return bResult;
-	}
-	if (result != NULL)
-	{
-		mysql_free_result(result);
-		return bResult;
+		return false;
 	}
-	return bResult;
+	msgBean.m_strF_MSG_ID = pStmt->GetString(0);
+	msgBean.m_strF_USER_ID = strUserName;
+	msgBean.m_strF_FRIEND_ID = pStmt->GetString(1);
+	msgBean.m_eF_FRIEND_OPTION = FriendOption(pStmt->GetString(2));
+	pStmt->FreeResult();
+	return true;
 }
 
 /**
@@ -1515,20 +1713,7 @@ F_FRIEND_ID,F_FRIEND_OPTION  FROM T_ADD_FRIEND_MSG WHERE F_USER_ID='{0}' AND F_A
  */
 bool CMySqlConnect::UpdateToNotifyAddFriendMsg(const std::string strMsgId)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "UPDATE T_ADD_FRIEND_MSG SET F_ADD_FRIEND_STATUS='NOTIFY',F_NOTIFY_TIME=now() WHERE F_MSG_ID='{0}';";
-	std::string strSql = fmt::format(strTemplate2, strMsgId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("UPDATE T_ADD_FRIEND_MSG SET F_ADD_FRIEND_STATUS='NOTIFY',F_NOTIFY_TIME=now() WHERE F_MSG_ID=?;", strMsgId);
 }
 
 /**
@@ -1541,20 +1726,7 @@ bool CMySqlConnect::UpdateToNotifyAddFriendMsg(const std::string strMsgId)
  */
 bool CMySqlConnect::UpdateToReadUnNotifyAddFriendMsg(const std::string strMsgId,const E_FRIEND_OPTION option)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "UPDATE T_ADD_FRIEND_MSG SET F_ADD_FRIEND_STATUS='READ_UN_NOTIFY',F_FRIEND_OPTION='{0}',F_OPTION_TIME=now() WHERE F_MSG_ID='{1}';";
-	std::string strSql = fmt::format(strTemplate2, FriendOption(option), strMsgId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("UPDATE T_ADD_FRIEND_MSG SET F_ADD_FRIEND_STATUS='READ_UN_NOTIFY',F_FRIEND_OPTION=?,F_OPTION_TIME=now() WHERE F_MSG_ID=?;", FriendOption(option), strMsgId);
 }
 
 /**
@@ -1566,23 +1738,8 @@ bool CMySqlConnect::UpdateToReadUnNotifyAddFriendMsg(const std::string strMsgId,
  */
 bool CMySqlConnect::InsertUserTeam(const T_USER_TEAM_BEAN& teamBean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "INSERT INTO T_USER_TEAM(F_USER_ID,F_TEAM_ID,F_TEAM_NAME,F_CREATE_TIME) VALUES('{0}','{1}','{2}',now());";
-	std::string strSql = fmt::format(strTemplate2, teamBean.m_strF_USER_ID,teamBean.m_strF_TEAM_ID,teamBean.m_strF_TEAM_NAME);
-
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		int nError = mysql_errno(m_mysql);
-		LOG_INFO(m_loger, "SQL_ERROR:{} [{}  {} ]", nError, __FILENAME__, __LINE__);
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("INSERT INTO T_USER_TEAM(F_USER_ID,F_TEAM_ID,F_TEAM_NAME,F_CREATE_TIME) VALUES(?,?,?,now());",
+		teamBean.m_strF_USER_ID, teamBean.m_strF_TEAM_ID, teamBean.m_strF_TEAM_NAME);
 }
 
 
@@ -1595,20 +1752,7 @@ bool CMySqlConnect::InsertUserTeam(const T_USER_TEAM_BEAN& teamBean)
  */
 bool CMySqlConnect::DeleteUserTeam(const T_USER_TEAM_BEAN& teamBean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "DELETE FROM T_USER_TEAM WHERE F_TEAM_ID='{0}' AND F_USER_ID='{1}';";
-	std::string strSql = fmt::format(strTemplate2, teamBean.m_strF_TEAM_ID,teamBean.m_strF_USER_ID);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("DELETE FROM T_USER_TEAM WHERE F_TEAM_ID=? AND F_USER_ID=?;", teamBean.m_strF_TEAM_ID, teamBean.m_strF_USER_ID);
 }
 
 /**
@@ -1623,36 +1767,18 @@ bool CMySqlConnect::DeleteUserTeam(const T_USER_TEAM_BEAN& teamBean)
 bool CMySqlConnect::SelectUserByTeamId(const std::string strUserName, const std::string strTeamId, std::vector<T_FRIEND_RELATION_BEAN>& teamBeans)
 {
 	bool bResult = false;
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_FRIEND_ID,F_TEAM_ID, FROM T_FRIEND_RELATION WHERE F_USER_ID='{0}' AND F_TEAM_ID='{1}';";
-	std::string strSql = fmt::format(strTemplate2, strUserName,strTeamId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			T_FRIEND_RELATION_BEAN bean;
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				bean.m_strF_FRIEND_ID = sql_row[0];
-				bean.m_strF_TEAM_ID = sql_row[1];
-				teamBeans.push_back(bean);
-				bResult = true;
-			}
-		}
-	}
-	else
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_FRIEND_ID,F_TEAM_ID FROM T_FRIEND_RELATION WHERE F_USER_ID=? AND F_TEAM_ID=?;", strUserName, strTeamId);
+	if (nullptr == pStmt)
 	{
 		return bResult;
 	}
-	if (result != NULL)
+	T_FRIEND_RELATION_BEAN bean;
+	while (pStmt->Fetch())
 	{
-		mysql_free_result(result);
-		return bResult;
+		bean.m_strF_FRIEND_ID = pStmt->GetString(0);
+		bean.m_strF_TEAM_ID = pStmt->GetString(1);
+		teamBeans.push_back(bean);
+		bResult = true;
 	}
 	return bResult;
 }
@@ -1667,37 +1793,19 @@ bool CMySqlConnect::SelectUserByTeamId(const std::string strUserName, const std:
 bool CMySqlConnect::SelectUserTeams(const std::string strUserName, std::vector<T_USER_TEAM_BEAN>& teamBeans)
 {
 	bool bResult = false;
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_USER_ID,F_TEAM_ID,F_TEAM_NAME FROM T_USER_TEAM WHERE F_USER_ID='{0}' ORDER BY F_TEAM_ID DESC;";
-	std::string strSql = fmt::format(strTemplate2, strUserName);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			T_USER_TEAM_BEAN bean;
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				bean.m_strF_USER_ID = sql_row[0];
-				bean.m_strF_TEAM_ID = sql_row[1];
-				bean.m_strF_TEAM_NAME = sql_row[2];
-				teamBeans.push_back(bean);
-				bResult = true;
-			}
-		}
-	}
-	else
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_USER_ID,F_TEAM_ID,F_TEAM_NAME FROM T_USER_TEAM WHERE F_USER_ID=? ORDER BY F_TEAM_ID DESC;", strUserName);
+	if (nullptr == pStmt)
 	{
 		return bResult;
 	}
-	if (result != NULL)
+	T_USER_TEAM_BEAN bean;
+	while (pStmt->Fetch())
 	{
-		mysql_free_result(result);
-		return bResult;
+		bean.m_strF_USER_ID = pStmt->GetString(0);
+		bean.m_strF_TEAM_ID = pStmt->GetString(1);
+		bean.m_strF_TEAM_NAME = pStmt->GetString(2);
+		teamBeans.push_back(bean);
+		bResult = true;
 	}
 	return bResult;
 }
@@ -1712,20 +1820,8 @@ bool CMySqlConnect::SelectUserTeams(const std::string strUserName, std::vector<T
  */
 bool CMySqlConnect::UpdateUserTeamName(const T_USER_TEAM_BEAN& teamBean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "UPDATE T_USER_TEAM SET F_TEAM_NAME='{0}' WHERE F_TEAM_ID='{1}' AND F_USER_ID='{2}";
-	std::string strSql = fmt::format(strTemplate2, teamBean.m_strF_TEAM_NAME,teamBean.m_strF_TEAM_ID, teamBean.m_strF_USER_ID);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("UPDATE T_USER_TEAM SET F_TEAM_NAME=? WHERE F_TEAM_ID=? AND F_USER_ID=?;",
+		teamBean.m_strF_TEAM_NAME, teamBean.m_strF_TEAM_ID, teamBean.m_strF_USER_ID);
 }
 
 
@@ -1738,21 +1834,8 @@ bool CMySqlConnect::UpdateUserTeamName(const T_USER_TEAM_BEAN& teamBean)
  */
 bool CMySqlConnect::InsertGroup(const T_GROUP_BEAN& groupBean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "INSERT INTO T_GROUP(F_GROUP_ID,F_GROUP_NAME,F_CREATE_TIME,F_GROUP_INFO) VALUES('{0}','{1}',now(),'{2}');";
-	std::string strSql = fmt::format(strTemplate2, groupBean.m_strF_GROUP_ID, groupBean.m_strF_GROUP_NAME, "NO INFO");
-
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("INSERT INTO T_GROUP(F_GROUP_ID,F_GROUP_NAME,F_CREATE_TIME,F_GROUP_INFO) VALUES(?,?,now(),'NO INFO');",
+		groupBean.m_strF_GROUP_ID, groupBean.m_strF_GROUP_NAME);
 }
 
 /**
@@ -1765,35 +1848,17 @@ bool CMySqlConnect::InsertGroup(const T_GROUP_BEAN& groupBean)
  */
 bool CMySqlConnect::SelectGroupById(const std::string groupId, T_GROUP_BEAN& groupBean)
 {
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
 	bool bResult = false;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_GROUP_ID,F_GROUP_NAME FROM T_GROUP WHERE F_GROUP_ID = '{0}';";
-	std::string strSql = fmt::format(strTemplate2, groupId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	T_GROUP_BEAN bean;
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				groupBean.m_strF_GROUP_ID = sql_row[0];
-				groupBean.m_strF_GROUP_NAME = sql_row[1];
-				bResult = true;
-			}
-		}
-	}
-	else
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_GROUP_ID,F_GROUP_NAME FROM T_GROUP WHERE F_GROUP_ID = ?;", groupId);
+	if (nullptr == pStmt)
 	{
 		return bResult;
 	}
-	if (result != NULL)
+	while (pStmt->Fetch())
 	{
-		mysql_free_result(result);
+		groupBean.m_strF_GROUP_ID = pStmt->GetString(0);
+		groupBean.m_strF_GROUP_NAME = pStmt->GetString(1);
+		bResult = true;
 	}
 	return bResult;
 }
@@ -1808,20 +1873,7 @@ bool CMySqlConnect::SelectGroupById(const std::string groupId, T_GROUP_BEAN& gro
  */
 bool CMySqlConnect::DeleteGroup(const std::string strGroupId)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "DELETE FROM T_GROUP WHERE F_GROUP_ID='{0}';";
-	std::string strSql = fmt::format(strTemplate2, strGroupId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("DELETE FROM T_GROUP WHERE F_GROUP_ID=?;", strGroupId);
 }
 
 /**
@@ -1834,36 +1886,19 @@ bool CMySqlConnect::DeleteGroup(const std::string strGroupId)
  */
 bool CMySqlConnect::SelectGroups(const std::string strGroupName, std::vector<T_GROUP_BEAN>& groupBeans)
 {
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
 	bool bResult = false;
-	int res = 0;
-constexpr char strTemplate2[] = "SELECT F_GROUP_ID,F_GROUP_NAME FROM T_GROUP WHERE F_GROUP_NAME LIKE '{0}' OR F_GROUP_ID LIKE '{0}';";
-	std::string strSql = fmt::format(strTemplate2, strGroupName);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	T_GROUP_BEAN bean;
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				bean.m_strF_GROUP_ID = sql_row[0];
-				bean.m_strF_GROUP_NAME = sql_row[1];
-				groupBeans.push_back(bean);
-				bResult = true;
-			}
-		}
-	}
-	else
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_GROUP_ID,F_GROUP_NAME FROM T_GROUP WHERE F_GROUP_NAME LIKE ? OR F_GROUP_ID LIKE ?;", strGroupName, strGroupName);
+	if (nullptr == pStmt)
 	{
 		return bResult;
 	}
-	if (result != NULL)
+	T_GROUP_BEAN bean;
+	while (pStmt->Fetch())
 	{
-		mysql_free_result(result);
+		bean.m_strF_GROUP_ID = pStmt->GetString(0);
+		bean.m_strF_GROUP_NAME = pStmt->GetString(1);
+		groupBeans.push_back(bean);
+		bResult = true;
 	}
 	return bResult;
 }
@@ -1878,21 +1913,8 @@ constexpr char strTemplate2[] = "SELECT F_GROUP_ID,F_GROUP_NAME FROM T_GROUP WHE
  */
 bool CMySqlConnect::InsertGroupRelation(const T_GROUP_RELATION_BEAN& memBean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "INSERT INTO T_GROUP_RELATION(F_GROUP_ID,F_USER_ID,F_ROLE_TYPE,F_CREATE_TIME) VALUES('{0}','{1}','{2}',now());";
-	std::string strSql = fmt::format(strTemplate2, memBean.m_strF_GROUP_ID, memBean.m_strF_USER_ID,MemberRole(memBean.m_eRole));
-
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("INSERT INTO T_GROUP_RELATION(F_GROUP_ID,F_USER_ID,F_ROLE_TYPE,F_CREATE_TIME) VALUES(?,?,?,now());",
+		memBean.m_strF_GROUP_ID, memBean.m_strF_USER_ID, MemberRole(memBean.m_eRole));
 }
 
 
@@ -1905,20 +1927,8 @@ bool CMySqlConnect::InsertGroupRelation(const T_GROUP_RELATION_BEAN& memBean)
  */
 bool CMySqlConnect::UpdateGroupRelation(const T_GROUP_RELATION_BEAN& memBean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "UPDATE T_GROUP_RELATION SET F_ROLE_TYPE='{0}' WHERE F_GROUP_ID='{1}' AND F_USER_ID='{2}';";
-	std::string strSql = fmt::format(strTemplate2,MemberRole(memBean.m_eRole),memBean.m_strF_GROUP_ID, memBean.m_strF_USER_ID);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("UPDATE T_GROUP_RELATION SET F_ROLE_TYPE=? WHERE F_GROUP_ID=? AND F_USER_ID=?;",
+		MemberRole(memBean.m_eRole), memBean.m_strF_GROUP_ID, memBean.m_strF_USER_ID);
 }
 
 /**
@@ -1930,20 +1940,8 @@ bool CMySqlConnect::UpdateGroupRelation(const T_GROUP_RELATION_BEAN& memBean)
  */
 bool CMySqlConnect::UpdateGroupRelationLastReadId(const T_GROUP_RELATION_BEAN& memBean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "UPDATE T_GROUP_RELATION SET F_LAST_READ_MSG_ID='{0}' WHERE F_GROUP_ID='{1}' AND F_USER_ID='{2}';";
-	std::string strSql = fmt::format(strTemplate2, memBean.m_strF_LAST_READ_MSG_ID, memBean.m_strF_GROUP_ID, memBean.m_strF_USER_ID);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("UPDATE T_GROUP_RELATION SET F_LAST_READ_MSG_ID=? WHERE F_GROUP_ID=? AND F_USER_ID=?;",
+		memBean.m_strF_LAST_READ_MSG_ID, memBean.m_strF_GROUP_ID, memBean.m_strF_USER_ID);
 }
 
 /**
@@ -1955,20 +1953,7 @@ bool CMySqlConnect::UpdateGroupRelationLastReadId(const T_GROUP_RELATION_BEAN& m
  */
 bool CMySqlConnect::DeleteGroupRelation(const T_GROUP_RELATION_BEAN& memBean)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "DELETE FROM T_GROUP_RELATION WHERE F_GROUP_ID='{0}' AND F_USER_ID='{1}';";
-	std::string strSql = fmt::format(strTemplate2, memBean.m_strF_GROUP_ID,memBean.m_strF_USER_ID);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
-
-	}
-	else
-	{
-		return false;
-	}
-	return true;
+	return nullptr != ExecuteStmt("DELETE FROM T_GROUP_RELATION WHERE F_GROUP_ID=? AND F_USER_ID=?;", memBean.m_strF_GROUP_ID, memBean.m_strF_USER_ID);
 }
 
 
@@ -1982,36 +1967,19 @@ bool CMySqlConnect::DeleteGroupRelation(const T_GROUP_RELATION_BEAN& memBean)
  */
 bool CMySqlConnect::SelectUserGroupRelation(const std::string strUserName, std::vector<T_GROUP_RELATION_BEAN>& memBeans)
 {
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_GROUP_ID,F_ROLE_TYPE,F_LAST_READ_MSG_ID FROM T_GROUP_RELATION WHERE F_USER_ID='{0}';";
-	std::string strSql = fmt::format(strTemplate2, strUserName);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			T_GROUP_RELATION_BEAN bean;
-			bean.m_strF_USER_ID = strUserName;
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				bean.m_strF_GROUP_ID = sql_row[0];
-				bean.m_eRole = MemberRole(sql_row[1]);
-				bean.m_strF_LAST_READ_MSG_ID = sql_row[2];
-				memBeans.push_back(bean);
-			}
-		}
-	}
-	else
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_GROUP_ID,F_ROLE_TYPE,F_LAST_READ_MSG_ID FROM T_GROUP_RELATION WHERE F_USER_ID=?;", strUserName);
+	if (nullptr == pStmt)
 	{
 		return false;
 	}
-	if (result != NULL)
+	T_GROUP_RELATION_BEAN bean;
+	bean.m_strF_USER_ID = strUserName;
+	while (pStmt->Fetch())
 	{
-		mysql_free_result(result);
+		bean.m_strF_GROUP_ID = pStmt->GetString(0);
+		bean.m_eRole = MemberRole(pStmt->GetString(1));
+		bean.m_strF_LAST_READ_MSG_ID = pStmt->GetString(2);
+		memBeans.push_back(bean);
 	}
 	return true;
 }
@@ -2026,35 +1994,67 @@ bool CMySqlConnect::SelectUserGroupRelation(const std::string strUserName, std::
  */
 bool CMySqlConnect::SelectGroupRelation(const std::string strGroupId, std::vector<T_GROUP_RELATION_BEAN>& memBeans)
 {
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_USER_ID,F_ROLE_TYPE,F_LAST_READ_MSG_ID FROM T_GROUP_RELATION WHERE F_GROUP_ID='{0}';";
-	std::string strSql = fmt::format(strTemplate2, strGroupId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			T_GROUP_RELATION_BEAN bean;
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				bean.m_strF_USER_ID = sql_row[0];
-				bean.m_eRole = MemberRole(sql_row[1]);
-				bean.m_strF_LAST_READ_MSG_ID = sql_row[2];
-				memBeans.push_back(bean);
-			}
-		}
-	}
-	else
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_USER_ID,F_ROLE_TYPE,F_LAST_READ_MSG_ID FROM T_GROUP_RELATION WHERE F_GROUP_ID=?;", strGroupId);
+	if (nullptr == pStmt)
 	{
 		return false;
 	}
-	if (result != NULL)
+	T_GROUP_RELATION_BEAN bean;
+	while (pStmt->Fetch())
+	{
+		bean.m_strF_USER_ID = pStmt->GetString(0);
+		bean.m_eRole = MemberRole(pStmt->GetString(1));
+		bean.m_strF_LAST_READ_MSG_ID = pStmt->GetString(2);
+		memBeans.push_back(bean);
+	}
+	return true;
+}
+
+/**
+ * @brief 查询用户所在的全部群组和每个群组的成员资料
+ * 
+ * @param strUserId 用户ID
+ * @param memberList 群组和成员的资料,同一个群组的成员相邻
+ * @return true 成功
+ * @return false 失败
+ */
+bool CMySqlConnect::SelectUserGroupMemberList(const std::string strUserId, std::vector<T_GROUP_MEMBER_INFO_BEAN>& memberList)
+{
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT G.F_GROUP_ID,\
+G.F_GROUP_NAME,\
+U.F_USER_ID,\
+U.F_USER_NAME,\
+U.F_ADDRESS,\
+U.F_BIRTH_DATE,\
+U.F_EMAIL_ADDR,\
+U.F_NICK_NAME,\
+U.F_SIGNATURE,\
+U.F_FACE_ID,\
+U.F_ON_LINE_STATE \
+FROM T_GROUP_RELATION R \
+INNER JOIN T_GROUP G ON G.F_GROUP_ID=R.F_GROUP_ID \
+INNER JOIN T_GROUP_RELATION M ON M.F_GROUP_ID=R.F_GROUP_ID \
+INNER JOIN T_USER U ON U.F_USER_ID=M.F_USER_ID \
+WHERE R.F_USER_ID=? ORDER BY G.F_GROUP_ID;", strUserId);
+	if (nullptr == pStmt)
 	{
-		mysql_free_result(result);
+		return false;
+	}
+	T_GROUP_MEMBER_INFO_BEAN bean;
+	while (pStmt->Fetch())
+	{
+		bean.m_group.m_strF_GROUP_ID = pStmt->GetString(0);
+		bean.m_group.m_strF_GROUP_NAME = pStmt->GetString(1);
+		bean.m_userInfo.m_strF_USER_ID = pStmt->GetString(2);
+		bean.m_userInfo.m_strF_USER_NAME = pStmt->GetString(3);
+		bean.m_userInfo.m_strF_ADDRESS = pStmt->GetString(4);
+		bean.m_userInfo.m_strF_BIRTH_DATE = pStmt->GetString(5);
+		bean.m_userInfo.m_strF_EMAIL_ADDR = pStmt->GetString(6);
+		bean.m_userInfo.m_strF_NICK_NAME = pStmt->GetString(7);
+		bean.m_userInfo.m_strF_SIGNATURE = pStmt->GetString(8);
+		bean.m_userInfo.m_strF_FACE_ID = pStmt->GetString(9);
+		bean.m_userInfo.m_eOnlineState = OnLineType(pStmt->GetString(10));
+		memberList.push_back(bean);
 	}
 	return true;
 }
@@ -2070,81 +2070,76 @@ bool CMySqlConnect::SelectGroupRelation(const std::string strGroupId, std::vecto
  */
 bool CMySqlConnect::SelectGroupChatText(T_GROUP_CHAT_MSG& chatMsg)
 {
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	bool bResult = false;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_MSG_ID,\
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_MSG_ID,\
 F_MSG_TYPE,\
 F_SENDER_ID,\
 F_MSG_CONTEXT,\
 F_OTHER_INFO,\
 F_CREATE_TIME \
-FROM T_GROUP_CHAT_MSG WHERE F_GROUP_ID='{0}' AND F_MSG_ID > '{1}' LIMIT 1;";
-	std::string strSql = fmt::format(strTemplate2, chatMsg.m_strF_GROUP_ID,chatMsg.m_strF_MSG_ID);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				chatMsg.m_strF_MSG_ID = sql_row[0];
-				chatMsg.m_eChatMsgType = ChatType(sql_row[1]);
-				chatMsg.m_strF_SENDER_ID = sql_row[2];
-				chatMsg.m_strF_MSG_CONTEXT = sql_row[3];
-				chatMsg.m_strF_OTHER_INFO = sql_row[4];
-				chatMsg.m_strF_CREATE_TIME = sql_row[5];
-				bResult = true;
-				break;
-			}
-		}
+FROM T_GROUP_CHAT_MSG WHERE F_GROUP_ID=? AND F_MSG_ID > ? ORDER BY F_MSG_ID LIMIT 1;", chatMsg.m_strF_GROUP_ID, MsgIdValue(chatMsg.m_strF_MSG_ID));
+	if (nullptr == pStmt || !pStmt->Fetch())
+	{
+		return false;
 	}
-	else
+	chatMsg.m_strF_MSG_ID = pStmt->GetString(0);
+	chatMsg.m_eChatMsgType = ChatType(pStmt->GetString(1));
+	chatMsg.m_strF_SENDER_ID = pStmt->GetString(2);
+	chatMsg.m_strF_MSG_CONTEXT = pStmt->GetString(3);
+	chatMsg.m_strF_OTHER_INFO = pStmt->GetString(4);
+	chatMsg.m_strF_CREATE_TIME = pStmt->GetString(5);
+	pStmt->FreeResult();
+	return true;
+}
+
+/**
+ * @brief 按消息ID的顺序查询群组中某条消息以后的多条消息,批量下发群聊消息时使用
+ * 
+ * @param strGroupId 群组ID
+ * @param strLastMsgId 用户已经读取的最后一条消息ID
+ * @param nLimit 最多查询的条数
+ * @param msgVec 查询到的消息
+ * @return true 成功
+ * @return false 失败
+ */
+bool CMySqlConnect::SelectGroupChatTextList(const std::string strGroupId, const std::string strLastMsgId, const int nLimit, std::vector<T_GROUP_CHAT_MSG>& msgVec)
+{
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_MSG_ID,\
+F_MSG_TYPE,\
+F_SENDER_ID,\
+F_MSG_CONTEXT,\
+F_OTHER_INFO,\
+F_CREATE_TIME \
+FROM T_GROUP_CHAT_MSG WHERE F_GROUP_ID=? AND F_MSG_ID > ? ORDER BY F_MSG_ID LIMIT ?;", strGroupId, MsgIdValue(strLastMsgId), static_cast<int64_t>(nLimit));
+	if (nullptr == pStmt)
 	{
-		return bResult;
+		return false;
 	}
-	if (result != NULL)
+	msgVec.clear();
+	while (pStmt->Fetch())
 	{
-		mysql_free_result(result);
+		T_GROUP_CHAT_MSG chatMsg;
+		chatMsg.m_strF_GROUP_ID = strGroupId;
+		chatMsg.m_strF_MSG_ID = pStmt->GetString(0);
+		chatMsg.m_eChatMsgType = ChatType(pStmt->GetString(1));
+		chatMsg.m_strF_SENDER_ID = pStmt->GetString(2);
+		chatMsg.m_strF_MSG_CONTEXT = pStmt->GetString(3);
+		chatMsg.m_strF_OTHER_INFO = pStmt->GetString(4);
+		chatMsg.m_strF_CREATE_TIME = pStmt->GetString(5);
+		msgVec.push_back(chatMsg);
 	}
-	return bResult;
+	return true;
 }
 
 bool CMySqlConnect::SelectGroupUserLastId(const std::string strUserId, const std::string strGroupId, std::string& strLastReadId)
 {
-	MYSQL_RES *result;
-	MYSQL_ROW sql_row;
-	bool bResult = false;
-	int res = 0;
-	constexpr char strTemplate2[] = "SELECT F_LAST_READ_MSG_ID FROM T_GROUP_RELATION WHERE F_USER_ID='{0}' AND F_GROUP_ID='{1}';";
-	std::string strSql = fmt::format(strTemplate2, strUserId,strGroupId);
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());
-	if (!res)
-	{
-		result = mysql_store_result(m_mysql);
-		if (result)
-		{
-			while ((sql_row = mysql_fetch_row(result)))
-			{
-				strLastReadId = sql_row[0];
-				bResult = true;
-				break;
-			}
-		}
-	}
-	else
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_LAST_READ_MSG_ID FROM T_GROUP_RELATION WHERE F_USER_ID=? AND F_GROUP_ID=?;", strUserId, strGroupId);
+	if (nullptr == pStmt || !pStmt->Fetch())
 	{
 		return false;
 	}
-	if (result != NULL)
-	{
-		mysql_free_result(result);
-	}
-	return bResult;
+	strLastReadId = pStmt->GetString(0);
+	pStmt->FreeResult();
+	return true;
 }
 
 /**
@@ -2156,35 +2151,78 @@ bool CMySqlConnect::SelectGroupUserLastId(const std::string strUserId, const std
  */
 bool CMySqlConnect::InsertGroupChatText(const T_GROUP_CHAT_MSG& chatMsg)
 {
-	int res = 0;
-	constexpr char strTemplate2[] = "INSERT INTO T_GROUP_CHAT_MSG(F_MSG_ID,\
+	return nullptr != ExecuteStmt("INSERT INTO T_GROUP_CHAT_MSG(F_MSG_ID,\
 F_MSG_TYPE,\
 F_SENDER_ID,\
 F_GROUP_ID,\
 F_MSG_CONTEXT,\
 F_OTHER_INFO,\
-F_CREATE_TIME) VALUES('{0}','{1}','{2}','{3}','{4}','{5}',now());";
-	std::string strSql = fmt::format(strTemplate2, chatMsg.m_strF_MSG_ID,
-		ChatType(chatMsg.m_eChatMsgType), 
+F_CREATE_TIME) VALUES(?,?,?,?,?,?,now());",
+		chatMsg.m_strF_MSG_ID,
+		ChatType(chatMsg.m_eChatMsgType),
 		chatMsg.m_strF_SENDER_ID,
 		chatMsg.m_strF_GROUP_ID,
 		chatMsg.m_strF_MSG_CONTEXT,
 		chatMsg.m_strF_OTHER_INFO);
+}
 
-	LOG_INFO(m_loger, "SQL:{} [{}  {} ]", strSql, __FILENAME__, __LINE__);
-	res = mysql_query(m_mysql, strSql.c_str());//查询
-	if (!res)
-	{
 
+/**
+ * @brief 批量插入群聊消息,使用消息生成时的时间作为创建时间
+ * 
+ * 由调用者决定是否放在一个事务中
+ * @param msgVec 群聊消息
+ * @return true 全部插入成功
+ * @return false 插入失败
+ */
+bool CMySqlConnect::InsertGroupChatText(const std::vector<T_GROUP_CHAT_MSG>& msgVec)
+{
+	std::size_t nIndex = 0;
+	while (nIndex < msgVec.size())
+	{
+		std::size_t nRows = NextInsertRows(msgVec.size() - nIndex);
+		std::vector<std::string> valueVec;
+		valueVec.reserve(nRows * 7);
+		for (std::size_t i = nIndex; i < nIndex + nRows; i++)
+		{
+			const auto& chatMsg = msgVec[i];
+			valueVec.push_back(chatMsg.m_strF_MSG_ID);
+			valueVec.push_back(ChatType(chatMsg.m_eChatMsgType));
+			valueVec.push_back(chatMsg.m_strF_SENDER_ID);
+			valueVec.push_back(chatMsg.m_strF_GROUP_ID);
+			valueVec.push_back(chatMsg.m_strF_MSG_CONTEXT);
+			valueVec.push_back(chatMsg.m_strF_OTHER_INFO);
+			valueVec.push_back(chatMsg.m_strF_CREATE_TIME);
+		}
+		std::string strSql = "INSERT INTO T_GROUP_CHAT_MSG(F_MSG_ID,F_MSG_TYPE,F_SENDER_ID,F_GROUP_ID,F_MSG_CONTEXT,F_OTHER_INFO,F_CREATE_TIME) VALUES" +
+			MultiRowValues("(?,?,?,?,?,?,?)", nRows) + ";";
+		if (nullptr == ExecuteStmt(strSql, valueVec))
+		{
+			return false;
+		}
+		nIndex += nRows;
 	}
-	else
+	return true;
+}
+
+/**
+ * @brief 判断群聊消息是否已经入库,恢复本地日志时跳过已经入库的消息
+ * 
+ * @param strMsgId 消息ID
+ * @return true 已经入库
+ * @return false 没有入库
+ */
+bool CMySqlConnect::IsGroupChatTextExist(const std::string& strMsgId)
+{
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_INDEX FROM T_GROUP_CHAT_MSG WHERE F_MSG_ID=? LIMIT 1;", MsgIdValue(strMsgId));
+	if (nullptr == pStmt || !pStmt->Fetch())
 	{
 		return false;
 	}
+	pStmt->FreeResult();
 	return true;
 }
 
-
 /**
  * @brief 插入文件Hash和文件名的关系
  * 
@@ -2299,69 +2337,14 @@ F_CREATE_TIME) VALUES('{0}','{1}','{2}','{3}','{4}','{5}',now());";
  */
 bool CMySqlConnect::GetAllUserName(std::vector<std::string>& userNameVec)
 {
-	if (nullptr == m_pSelectAllUserNameStmt)
+	CMySqlStmt* pStmt = ExecuteStmt("SELECT F_USER_NAME FROM T_USER;");
+	if (nullptr == pStmt)
 	{
-		m_pSelectAllUserNameStmt = mysql_stmt_init(m_mysql);
-		if (!m_pSelectAllUserNameStmt)
-		{
-			return false;
-		}
-		std::string strSql = "SELECT F_USER_NAME FROM T_USER;";
-		if (mysql_stmt_prepare(m_pSelectAllUserNameStmt, strSql.c_str(), static_cast<unsigned long>(strSql.size())))
-		{
-			return false;
-		}
+		return false;
 	}
-
-
-
-
+	while (pStmt->Fetch())
 	{
-		unsigned long length[1];
-
-		bool       is_null[1];
-		bool       error[1];
-		MYSQL_BIND resultBind[1];
-		memset(resultBind, 0, sizeof(resultBind));
-
-		char resultBuf[1][64] = { 0 };
-
-		resultBind[0].buffer_type = MYSQL_TYPE_STRING;
-		resultBind[0].buffer = resultBuf[0];
-		resultBind[0].buffer_length = 64;
-		resultBind[0].length = &length[0];
-		resultBind[0].is_null = &is_null[0];
-		resultBind[0].error = &error[0];
-		try {
-			if (mysql_stmt_bind_result(m_pSelectAllUserNameStmt, resultBind))
-			{
-				return false;
-			}
-			if (mysql_stmt_execute(m_pSelectAllUserNameStmt))
-			{
-				return false;
-			}
-			if (mysql_stmt_store_result(m_pSelectAllUserNameStmt))
-			{
-				return false;
-			}
-			while (true)
-			{
-				int nState = mysql_stmt_fetch(m_pSelectAllUserNameStmt);
-				if (nState == 1 || nState == MYSQL_NO_DATA) {
-					break;
-				}
-				else
-				{
-					std::string strUserName = std::string(static_cast<char*>(resultBind[0].buffer), *(resultBind[0].length));
-					userNameVec.push_back(strUserName);
-				}
-			}
-		}
-		catch (std::exception ec)
-		{
-			LOG_ERR(m_loger, "EC:{} [{} {}]", ec.what(), __FILENAME__, __LINE__);
-		}
+		userNameVec.push_back(pStmt->GetString(0));
 	}
 	return !(userNameVec.empty());
 }
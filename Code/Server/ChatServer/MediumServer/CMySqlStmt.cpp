@@ -0,0 +1,305 @@
+/**
+ * @file CMySqlStmt.cpp
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 预处理语句的封装
+ * @version 0.1
+ * @date 2020-04-15
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#include "CMySqlStmt.h"
+#include <algorithm>
+#include <cstdlib>
+
+//结果列的初始缓冲区大小,超过时按实际长度扩大
+constexpr std::size_t RESULT_BUFF_INIT_SIZE = 256;
+
+/**
+ * @brief 构造函数,初始化并准备语句
+ *
+ * @param pMysql 数据库连接
+ * @param strSql 带有?占位符的SQL语句
+ */
+CMySqlStmt::CMySqlStmt(MYSQL* pMysql, const std::string& strSql)
+	: m_pStmt(nullptr)
+	, m_strSql(strSql)
+	, m_bValid(false)
+	, m_bResultBind(false)
+	, m_bHasResult(false)
+	, m_nBindIndex(0)
+{
+	m_pStmt = mysql_stmt_init(pMysql);
+	if (nullptr == m_pStmt)
+	{
+		return;
+	}
+	if (mysql_stmt_prepare(m_pStmt, strSql.c_str(), static_cast<unsigned long>(strSql.size())))
+	{
+		return;
+	}
+	m_paramVec.resize(mysql_stmt_param_count(m_pStmt));
+	m_paramBind.resize(m_paramVec.size());
+	m_columnVec.resize(mysql_stmt_field_count(m_pStmt));
+	m_resultBind.resize(m_columnVec.size());
+	for (auto& column : m_columnVec)
+	{
+		column.m_buff.resize(RESULT_BUFF_INIT_SIZE);
+	}
+	m_bValid = true;
+}
+
+/**
+ * @brief 析构函数,关闭语句
+ *
+ */
+CMySqlStmt::~CMySqlStmt()
+{
+	if (nullptr != m_pStmt)
+	{
+		mysql_stmt_close(m_pStmt);
+		m_pStmt = nullptr;
+	}
+}
+
+/**
+ * @brief 绑定一个字符串参数
+ *
+ * @param strValue 参数的值
+ * @return CMySqlStmt& 语句本身,用于连续绑定
+ */
+CMySqlStmt& CMySqlStmt::Bind(const std::string& strValue)
+{
+	if (m_nBindIndex < m_paramVec.size())
+	{
+		Param_st& param = m_paramVec[m_nBindIndex];
+		param.m_strValue = strValue;
+		param.m_nLength = static_cast<unsigned long>(param.m_strValue.size());
+		MYSQL_BIND& bind = m_paramBind[m_nBindIndex];
+		bind.buffer_type = MYSQL_TYPE_STRING;
+		bind.buffer = const_cast<char*>(param.m_strValue.data());
+		bind.buffer_length = param.m_nLength;
+		bind.length = &param.m_nLength;
+		bind.is_null = nullptr;
+	}
+	m_nBindIndex++;
+	return *this;
+}
+
+/**
+ * @brief 绑定一个整数参数
+ *
+ * @param nValue 参数的值
+ * @return CMySqlStmt& 语句本身,用于连续绑定
+ */
+CMySqlStmt& CMySqlStmt::Bind(const int64_t nValue)
+{
+	if (m_nBindIndex < m_paramVec.size())
+	{
+		Param_st& param = m_paramVec[m_nBindIndex];
+		param.m_nValue = nValue;
+		MYSQL_BIND& bind = m_paramBind[m_nBindIndex];
+		bind.buffer_type = MYSQL_TYPE_LONGLONG;
+		bind.buffer = &param.m_nValue;
+		bind.buffer_length = sizeof(param.m_nValue);
+		bind.length = nullptr;
+		bind.is_null = nullptr;
+		bind.is_unsigned = false;
+	}
+	m_nBindIndex++;
+	return *this;
+}
+
+/**
+ * @brief 依次绑定多个字符串参数
+ *
+ * @param valueVec 参数的值
+ * @return CMySqlStmt& 语句本身,用于连续绑定
+ */
+CMySqlStmt& CMySqlStmt::Bind(const std::vector<std::string>& valueVec)
+{
+	for (const auto& item : valueVec)
+	{
+		Bind(item);
+	}
+	return *this;
+}
+
+/**
+ * @brief 依次绑定多个整数参数
+ *
+ * @param valueVec 参数的值
+ * @return CMySqlStmt& 语句本身,用于连续绑定
+ */
+CMySqlStmt& CMySqlStmt::Bind(const std::vector<int64_t>& valueVec)
+{
+	for (const auto& item : valueVec)
+	{
+		Bind(item);
+	}
+	return *this;
+}
+
+/**
+ * @brief 执行语句,执行前丢弃上次没有读完的结果
+ *
+ * @return true 执行成功
+ * @return false 参数个数不对或者执行失败
+ */
+bool CMySqlStmt::Execute()
+{
+	if (!m_bValid)
+	{
+		return false;
+	}
+	FreeResult();
+	bool bBindAll = (m_nBindIndex == m_paramVec.size());
+	m_nBindIndex = 0;
+	if (!bBindAll)
+	{
+		return false;
+	}
+	//MYSQL_BIND中的缓冲区地址每次绑定都可能变化,执行前重新提交给语句
+	if (!m_paramBind.empty() && mysql_stmt_bind_param(m_pStmt, m_paramBind.data()))
+	{
+		return false;
+	}
+	if (mysql_stmt_execute(m_pStmt))
+	{
+		return false;
+	}
+	m_bHasResult = !m_columnVec.empty();
+	return true;
+}
+
+/**
+ * @brief 获取INSERT、UPDATE、DELETE影响的行数
+ *
+ */
+uint64_t CMySqlStmt::AffectedRows() const
+{
+	return m_bValid ? mysql_stmt_affected_rows(m_pStmt) : 0;
+}
+
+/**
+ * @brief 把每一列的缓冲区绑定到语句的结果
+ *
+ */
+bool CMySqlStmt::BindResult()
+{
+	for (std::size_t i = 0; i < m_columnVec.size(); i++)
+	{
+		Column_st& column = m_columnVec[i];
+		MYSQL_BIND& bind = m_resultBind[i];
+		bind.buffer_type = MYSQL_TYPE_STRING;
+		bind.buffer = column.m_buff.data();
+		bind.buffer_length = static_cast<unsigned long>(column.m_buff.size());
+		bind.length = &column.m_nLength;
+		bind.is_null = &column.m_bNull;
+		bind.error = &column.m_bError;
+	}
+	if (mysql_stmt_bind_result(m_pStmt, m_resultBind.data()))
+	{
+		return false;
+	}
+	m_bResultBind = true;
+	return true;
+}
+
+/**
+ * @brief 从服务器读取下一行,超过缓冲区的列扩大缓冲区以后单独读取
+ *
+ * @return true 读取到一行
+ * @return false 没有数据或者出错,结果已经释放
+ */
+bool CMySqlStmt::Fetch()
+{
+	if (!m_bHasResult)
+	{
+		return false;
+	}
+	if (!m_bResultBind && !BindResult())
+	{
+		FreeResult();
+		return false;
+	}
+	int nState = mysql_stmt_fetch(m_pStmt);
+	if (MYSQL_DATA_TRUNCATED == nState)
+	{
+		for (std::size_t i = 0; i < m_columnVec.size(); i++)
+		{
+			Column_st& column = m_columnVec[i];
+			if (column.m_bNull || column.m_nLength <= column.m_buff.size())
+			{
+				continue;
+			}
+			column.m_buff.resize(column.m_nLength);
+			MYSQL_BIND& bind = m_resultBind[i];
+			bind.buffer = column.m_buff.data();
+			bind.buffer_length = static_cast<unsigned long>(column.m_buff.size());
+			if (mysql_stmt_fetch_column(m_pStmt, &bind, static_cast<unsigned int>(i), 0))
+			{
+				FreeResult();
+				return false;
+			}
+			//下一行使用扩大以后的缓冲区
+			m_bResultBind = false;
+		}
+		nState = 0;
+	}
+	if (0 != nState)
+	{
+		FreeResult();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief 获取当前行某一列的值,NULL返回空字符串
+ *
+ * @param nCol 列的序号,从0开始
+ */
+std::string CMySqlStmt::GetString(const std::size_t nCol) const
+{
+	if (IsNull(nCol))
+	{
+		return "";
+	}
+	const Column_st& column = m_columnVec[nCol];
+	return std::string(column.m_buff.data(), std::min<std::size_t>(column.m_nLength, column.m_buff.size()));
+}
+
+/**
+ * @brief 获取当前行某一列的整数值,NULL返回0
+ *
+ * @param nCol 列的序号,从0开始
+ */
+int64_t CMySqlStmt::GetInt(const std::size_t nCol) const
+{
+	return std::strtoll(GetString(nCol).c_str(), nullptr, 10);
+}
+
+bool CMySqlStmt::IsNull(const std::size_t nCol) const
+{
+	return nCol >= m_columnVec.size() || m_columnVec[nCol].m_bNull;
+}
+
+void CMySqlStmt::FreeResult()
+{
+	if (m_bHasResult)
+	{
+		mysql_stmt_free_result(m_pStmt);
+		m_bHasResult = false;
+	}
+}
+
+const char* CMySqlStmt::Error() const
+{
+	return nullptr != m_pStmt ? mysql_stmt_error(m_pStmt) : "mysql_stmt_init() failed";
+}
+
+unsigned int CMySqlStmt::Errno() const
+{
+	return nullptr != m_pStmt ? mysql_stmt_errno(m_pStmt) : 0;
+}
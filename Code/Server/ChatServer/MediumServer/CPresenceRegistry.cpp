@@ -0,0 +1,225 @@
+#include "CPresenceRegistry.h"
+#include <algorithm>
+
+GroupPresence_st* UserPresence_st::FindGroup(const std::string& strGroupId)
+{
+	for (auto& item : m_groupVec)
+	{
+		if (item.m_strGroupId == strGroupId)
+		{
+			return &item;
+		}
+	}
+	return nullptr;
+}
+
+GroupPresence_st& UserPresence_st::InsertGroup(const std::string& strGroupId)
+{
+	GroupPresence_st* pGroup = FindGroup(strGroupId);
+	if (nullptr != pGroup)
+	{
+		return *pGroup;
+	}
+	GroupPresence_st group;
+	group.m_strGroupId = strGroupId;
+	m_groupVec.push_back(group);
+	return m_groupVec.back();
+}
+
+void UserPresence_st::RemoveGroup(const std::string& strGroupId)
+{
+	m_groupVec.erase(std::remove_if(m_groupVec.begin(), m_groupVec.end(), [&strGroupId](const GroupPresence_st& item) {
+		return item.m_strGroupId == strGroupId;
+	}), m_groupVec.end());
+}
+
+bool UserPresence_st::IsEmpty() const
+{
+	return !m_pSess && !m_pKickOffSess && !m_bHasUdpAddr && m_groupVec.empty();
+}
+
+std::string PresenceStat_st::ToString() const
+{
+	return "Users:" + std::to_string(m_nUsers) +
+		" OnLine:" + std::to_string(m_nOnline) +
+		" MaxShard:" + std::to_string(m_nMaxShard);
+}
+
+CPresenceRegistry::CPresenceRegistry(const std::size_t nShardCount)
+{
+	SetShardCount(nShardCount);
+}
+
+bool CPresenceRegistry::SetShardCount(const std::size_t nShardCount)
+{
+	if (0 != Size())
+	{
+		return false;
+	}
+	m_shardVec.clear();
+	for (std::size_t i = 0; i < std::max<std::size_t>(1, nShardCount); i++)
+	{
+		m_shardVec.push_back(std::unique_ptr<Shard_st>(new Shard_st()));
+	}
+	return true;
+}
+
+bool CPresenceRegistry::UserKey(const std::string& strUserId, uint64_t& nKey)
+{
+	//"012"和"12"是不同的用户,有前导0的不转换
+	if (strUserId.empty() || strUserId.length() > 18 || (strUserId[0] == '0' && strUserId.length() > 1))
+	{
+		return false;
+	}
+	nKey = 0;
+	for (const char ch : strUserId)
+	{
+		if (ch < '0' || ch > '9')
+		{
+			return false;
+		}
+		nKey = nKey * 10 + static_cast<uint64_t>(ch - '0');
+	}
+	return true;
+}
+
+std::size_t CPresenceRegistry::ShardIndex(const std::string& strUserId) const
+{
+	uint64_t nKey = 0;
+	if (UserKey(strUserId, nKey))
+	{
+		return static_cast<std::size_t>(nKey % m_shardVec.size());
+	}
+	return std::hash<std::string>()(strUserId) % m_shardVec.size();
+}
+
+UserPresence_st* CPresenceRegistry::FindLocked(Shard_st& shard, const std::string& strUserId)
+{
+	uint64_t nKey = 0;
+	if (UserKey(strUserId, nKey))
+	{
+		auto item = shard.m_numMap.find(nKey);
+		return item == shard.m_numMap.end() ? nullptr : &item->second;
+	}
+	auto item = shard.m_strMap.find(strUserId);
+	return item == shard.m_strMap.end() ? nullptr : &item->second;
+}
+
+UserPresence_st* CPresenceRegistry::Find(const std::string& strUserId)
+{
+	Shard_st& shard = *m_shardVec[ShardIndex(strUserId)];
+	std::lock_guard<std::mutex> lock(shard.m_mutex);
+	return FindLocked(shard, strUserId);
+}
+
+UserPresence_st& CPresenceRegistry::Insert(const std::string& strUserId)
+{
+	Shard_st& shard = *m_shardVec[ShardIndex(strUserId)];
+	std::lock_guard<std::mutex> lock(shard.m_mutex);
+	uint64_t nKey = 0;
+	UserPresence_st* pUser = nullptr;
+	if (UserKey(strUserId, nKey))
+	{
+		pUser = &shard.m_numMap[nKey];
+	}
+	else
+	{
+		pUser = &shard.m_strMap[strUserId];
+	}
+	if (pUser->m_strUserId.empty())
+	{
+		pUser->m_strUserId = strUserId;
+	}
+	return *pUser;
+}
+
+void CPresenceRegistry::Release(const std::string& strUserId)
+{
+	UserPresence_st* pUser = Find(strUserId);
+	if (nullptr != pUser && pUser->IsEmpty())
+	{
+		Remove(strUserId);
+	}
+}
+
+void CPresenceRegistry::Remove(const std::string& strUserId)
+{
+	Shard_st& shard = *m_shardVec[ShardIndex(strUserId)];
+	std::lock_guard<std::mutex> lock(shard.m_mutex);
+	uint64_t nKey = 0;
+	if (UserKey(strUserId, nKey))
+	{
+		shard.m_numMap.erase(nKey);
+	}
+	else
+	{
+		shard.m_strMap.erase(strUserId);
+	}
+}
+
+std::shared_ptr<ChatServer::CServerSess> CPresenceRegistry::GetSess(const std::string& strUserId)
+{
+	Shard_st& shard = *m_shardVec[ShardIndex(strUserId)];
+	std::lock_guard<std::mutex> lock(shard.m_mutex);
+	UserPresence_st* pUser = FindLocked(shard, strUserId);
+	return nullptr == pUser ? nullptr : pUser->m_pSess;
+}
+
+bool CPresenceRegistry::GetUdpAddr(const std::string& strUserId, IpPortCfg& udpAddr)
+{
+	Shard_st& shard = *m_shardVec[ShardIndex(strUserId)];
+	std::lock_guard<std::mutex> lock(shard.m_mutex);
+	UserPresence_st* pUser = FindLocked(shard, strUserId);
+	if (nullptr == pUser || !pUser->m_bHasUdpAddr)
+	{
+		return false;
+	}
+	udpAddr = pUser->m_udpAddr;
+	return true;
+}
+
+void CPresenceRegistry::SetSess(UserPresence_st& user, std::shared_ptr<ChatServer::CServerSess> pSess)
+{
+	Shard_st& shard = *m_shardVec[ShardIndex(user.m_strUserId)];
+	std::lock_guard<std::mutex> lock(shard.m_mutex);
+	user.m_pSess = std::move(pSess);
+}
+
+void CPresenceRegistry::SetUdpAddr(UserPresence_st& user, const bool bHasUdpAddr, const IpPortCfg& udpAddr)
+{
+	Shard_st& shard = *m_shardVec[ShardIndex(user.m_strUserId)];
+	std::lock_guard<std::mutex> lock(shard.m_mutex);
+	user.m_bHasUdpAddr = bHasUdpAddr;
+	user.m_udpAddr = bHasUdpAddr ? udpAddr : IpPortCfg();
+}
+
+std::size_t CPresenceRegistry::Size() const
+{
+	std::size_t nSize = 0;
+	for (const auto& pShard : m_shardVec)
+	{
+		std::lock_guard<std::mutex> lock(pShard->m_mutex);
+		nSize += pShard->Size();
+	}
+	return nSize;
+}
+
+PresenceStat_st CPresenceRegistry::Stat() const
+{
+	PresenceStat_st stat;
+	for (const auto& pShard : m_shardVec)
+	{
+		std::lock_guard<std::mutex> lock(pShard->m_mutex);
+		stat.m_nUsers += pShard->Size();
+		stat.m_nMaxShard = std::max(stat.m_nMaxShard, pShard->Size());
+		for (const auto& item : pShard->m_numMap)
+		{
+			stat.m_nOnline += item.second.m_pSess ? 1 : 0;
+		}
+		for (const auto& item : pShard->m_strMap)
+		{
+			stat.m_nOnline += item.second.m_pSess ? 1 : 0;
+		}
+	}
+	return stat;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file CPresenceRegistry.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 在线用户的会话、状态、UDP地址和群组消息下发状态,每个用户一条记录
+ * @version 0.1
+ * @date 2020-05-16
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef _DENNIS_THINK_C_PRESENCE_REGISTRY_H_
+#define _DENNIS_THINK_C_PRESENCE_REGISTRY_H_
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "CommonDef.h"
+#include "CommonMsg.h"
+
+namespace ChatServer
+{
+class CServerSess;
+}
+
+/**
+ * @brief 用户在一个群组中的消息下发状态
+ *
+ */
+struct GroupPresence_st
+{
+	std::string m_strGroupId;
+	CLIENT_SESS_STATE m_eState = CLIENT_SESS_STATE::SESS_IDLE_STATE;
+	bool m_bBatchPending = false;//是否有已经下发还没有收到回复的一批群聊消息
+	std::string m_strBatchLastId;//该批消息的最后一条ID
+};
+
+/**
+ * @brief 一个用户的在线信息
+ *
+ * 用户加入的群组不多,并且只记录正在下发消息的群组,用数组顺序查找比再建一层哈希表快
+ */
+struct UserPresence_st
+{
+	std::string m_strUserId;
+	std::shared_ptr<ChatServer::CServerSess> m_pSess;//当前登录的会话,其他分片的strand也会读取,通过SetSess修改
+	std::shared_ptr<ChatServer::CServerSess> m_pKickOffSess;//被重复登录踢掉,等待回复的旧会话
+	CLIENT_SESS_STATE m_eState = CLIENT_SESS_STATE::SESS_IDLE_STATE;//好友消息的下发状态
+	bool m_bHasUdpAddr = false;//UDP地址其他分片的strand也会读取,通过SetUdpAddr修改
+	IpPortCfg m_udpAddr;//用户最近一次发送UDP消息的地址
+	std::vector<GroupPresence_st> m_groupVec;
+
+	GroupPresence_st* FindGroup(const std::string& strGroupId);
+	GroupPresence_st& InsertGroup(const std::string& strGroupId);
+	void RemoveGroup(const std::string& strGroupId);
+
+	//没有会话、UDP地址和群组状态,可以删除
+	bool IsEmpty() const;
+};
+
+/**
+ * @brief 在线信息的统计
+ *
+ */
+struct PresenceStat_st
+{
+	std::size_t m_nUsers = 0;//有记录的用户数
+	std::size_t m_nOnline = 0;//有会话的用户数
+	std::size_t m_nMaxShard = 0;//最大的分片中的用户数
+
+	std::string ToString() const;
+};
+
+/**
+ * @brief 用户ID到在线信息的分片哈希表
+ *
+ * 用户ID由数字组成,转换为整数作为键,不再每次比较字符串;不是数字的ID放在分片的字符串表中。
+ * 分片以后每个分片各自扩容,用户数增长时不会一次重新哈希所有用户。
+ * CChatServer为每个分片建立一个strand,记录的插入、删除和修改只在用户所在分片的strand上进行;
+ * 其他strand只通过GetSess和GetUdpAddr读取会话和UDP地址,所以这两项和哈希表本身用分片的锁保护,
+ * 状态和群组等只在本分片strand上访问的字段不加锁。记录保存在哈希表的节点中,其他记录的插入删除不影响已经取得的指针。
+ */
+class CPresenceRegistry
+{
+public:
+	static const std::size_t DEFAULT_SHARD_COUNT = 16;
+
+	explicit CPresenceRegistry(const std::size_t nShardCount = DEFAULT_SHARD_COUNT);
+
+	//修改分片数,已经有记录时不修改
+	bool SetShardCount(const std::size_t nShardCount);
+
+	std::size_t ShardCount() const { return m_shardVec.size(); }
+
+	/**
+	 * @brief 数字组成的用户ID转换为整数
+	 *
+	 * @param strUserId 用户ID
+	 * @param nKey 转换以后的整数
+	 * @return true 可以转换,不超过18位并且没有前导0
+	 * @return false 不能转换
+	 */
+	static bool UserKey(const std::string& strUserId, uint64_t& nKey);
+
+	//用户所在的分片
+	std::size_t ShardIndex(const std::string& strUserId) const;
+
+	//查找用户的记录,没有时返回nullptr
+	UserPresence_st* Find(const std::string& strUserId);
+
+	//查找用户的记录,没有时新建
+	UserPresence_st& Insert(const std::string& strUserId);
+
+	//记录为空时删除
+	void Release(const std::string& strUserId);
+
+	void Remove(const std::string& strUserId);
+
+	//用户当前的会话,不在线时返回nullptr,可以在任意strand上调用
+	std::shared_ptr<ChatServer::CServerSess> GetSess(const std::string& strUserId);
+
+	//用户的UDP地址,可以在任意strand上调用
+	bool GetUdpAddr(const std::string& strUserId, IpPortCfg& udpAddr);
+
+	//修改用户当前的会话
+	void SetSess(UserPresence_st& user, std::shared_ptr<ChatServer::CServerSess> pSess);
+
+	//修改用户的UDP地址,bHasUdpAddr为false时清除
+	void SetUdpAddr(UserPresence_st& user, const bool bHasUdpAddr, const IpPortCfg& udpAddr = IpPortCfg());
+
+	std::size_t Size() const;
+
+	PresenceStat_st Stat() const;
+
+	/**
+	 * @brief 遍历一个分片中的记录,遍历期间持有分片的锁
+	 *
+	 * 在其他分片的strand上调用时只能读取会话和UDP地址;func中不能再调用CPresenceRegistry的函数
+	 * @param nShard 分片的序号
+	 * @param func 参数为(UserPresence_st&)
+	 */
+	template<typename FUNC>
+	void ForEach(const std::size_t nShard, FUNC func)
+	{
+		Shard_st& shard = *m_shardVec[nShard];
+		std::lock_guard<std::mutex> lock(shard.m_mutex);
+		for (auto& item : shard.m_numMap)
+		{
+			func(item.second);
+		}
+		for (auto& item : shard.m_strMap)
+		{
+			func(item.second);
+		}
+	}
+
+	//按分片依次遍历所有的记录
+	template<typename FUNC>
+	void ForEach(FUNC func)
+	{
+		for (std::size_t i = 0; i < m_shardVec.size(); i++)
+		{
+			ForEach(i, func);
+		}
+	}
+private:
+	struct Shard_st
+	{
+		std::mutex m_mutex;//保护哈希表和记录中的会话、UDP地址
+		std::unordered_map<uint64_t, UserPresence_st> m_numMap;
+		std::unordered_map<std::string, UserPresence_st> m_strMap;//不是数字的用户ID
+
+		std::size_t Size() const { return m_numMap.size() + m_strMap.size(); }
+	};
+
+	//查找用户的记录,调用者需要持有分片的锁
+	UserPresence_st* FindLocked(Shard_st& shard, const std::string& strUserId);
+
+	std::vector<std::unique_ptr<Shard_st>> m_shardVec;
+};
+#endif
@@ -1,7 +1,9 @@
 ﻿#include "CClientSess.h"
+#include <cerrno>
 namespace ChatServer
 {
 std::shared_ptr<spdlog::logger> CServerSess::ms_loger;
+SendQueueCfg_st CServerSess::ms_sendQueueCfg;
 
 /**
  * @brief 从socket的读取数据的函数
@@ -10,46 +12,257 @@ std::shared_ptr<spdlog::logger> CServerSess::ms_loger;
 void CServerSess::do_read()
 {
 	auto self = shared_from_this();
+	char* pWrite = m_recvBuf.PrepareWrite();
 	m_socket.async_read_some(
-		asio::buffer(m_recvbuf + m_recvpos, max_length - m_recvpos),
-			[this, self](std::error_code ec, std::size_t length) {
-			if (length > sizeof(TransBaseMsg_t))
+		asio::buffer(pWrite, m_recvBuf.WritableSize()),
+			m_strand.wrap([this, self](std::error_code ec, std::size_t length) {
+			if (ec)
 			{
+				CloseSocket();
+				return;
+			}
+			m_recvBuf.CommitWrite(length);
+			//完整的消息直接引用接收缓冲区,不做拷贝和移动
+			auto pMsg = m_recvBuf.NextMsg();
+			while (pMsg)
+			{
+				handle_message(pMsg);
+				pMsg = m_recvBuf.NextMsg();
+			}
+			if (m_recvBuf.HasError())
+			{
+				LOG_WARN(ms_loger, "[ {} ] Recv Invalid Msg Head [{} {}]", UserId(), __FILENAME__, __LINE__);
+				CloseSocket();
+				return;
+			}
+			do_read();
+		}));
+}
 
-				TransBaseMsg_t msg(m_recvbuf);
-				auto curlen = m_recvpos + length;
-				while (curlen >= sizeof(Header) && curlen >= msg.GetSize())
+/**
+ * @brief 当do_read函数接收到一个完整消息的时候，调用此函数，在此函数中完成消息类型的判断和消息分发
+ *        hdr引用接收缓冲区的数据,缓冲区在消息处理完成之前不会被覆盖,投递到业务strand时不需要拷贝
+ * 
+ * @param hdr 需要被处理的消息
+ */
+void CServerSess::handle_message(const TransBaseMsg_S_PTR& hdr)
+{
+	if (m_server)
+	{
+		if (hdr->IsBinary())
+		{
+			//对端使用二进制编码发送,回复的消息也使用二进制编码
+			m_bBinaryCodec.store(true);
+		}
+		m_server->PostRecvTcpMsg(shared_from_this(), hdr);
+	}
+}
+
+
+void CServerSess::PushSendMsg(const TransBaseMsg_S_PTR& msg)
+{
+	bool bOverload = m_sendQueue.IsOverload();
+	switch (m_sendQueue.Push(msg))
+	{
+	case E_SEND_QUEUE_PUSH::START_SEND:
+	{
+		DoSendMsg();
+	}break;
+	case E_SEND_QUEUE_PUSH::OVERFLOW_CLOSE:
+	{
+		auto stat = m_sendQueue.Stat();
+		LOG_WARN(ms_loger, "[ {} ] Send Queue Overflow Count:{} Bytes:{} Policy:{} Close [{} {}]", UserId(), stat.m_nQueueCount, stat.m_nQueueBytes, SendQueuePolicyName(ms_sendQueueCfg.m_policy), __FILENAME__, __LINE__);
+		CloseSocket();
+	}break;
+	default:
+	{
+	}break;
+	}
+	if (!bOverload && m_sendQueue.IsOverload())
+	{
+		LOG_WARN(ms_loger, "[ {} ] Send Queue Above High Water Count:{} Bytes:{} [{} {}]", UserId(), m_sendQueue.Size(), m_sendQueue.Bytes(), __FILENAME__, __LINE__);
+	}
+}
+
+void CServerSess::ReportSendStat()
+{
+	auto self = shared_from_this();
+	m_strand.dispatch([this, self]() {
+		auto stat = m_sendQueue.Stat();
+		uint64_t nShedCount = stat.m_nDropCount + stat.m_nCoalesceCount;
+		if (stat.m_nQueueCount > 0 || nShedCount != m_nReportedShedCount)
+		{
+			LOG_INFO(ms_loger, "[ {} ] Send Queue Count:{} Bytes:{} Peak:{} Sent:{}/{} Batch:{} Drop:{} Coalesce:{} Overload:{} [{} {}]", UserId(), stat.m_nQueueCount, stat.m_nQueueBytes, stat.m_nPeakBytes, stat.m_nSendCount, stat.m_nSendBytes, stat.m_nBatchCount, stat.m_nDropCount, stat.m_nCoalesceCount, stat.m_nOverloadCount, __FILENAME__, __LINE__);
+			m_nReportedShedCount = nShedCount;
+		}
+		if (!m_fileFrameQueue.empty() || m_nFileFrameCount > 0)
+		{
+			LOG_INFO(ms_loger, "[ {} ] Send File Frame Queue:{} Sent:{}/{} [{} {}]", UserId(), m_fileFrameQueue.size(), m_nFileFrameCount, m_nFileFrameBytes, __FILENAME__, __LINE__);
+			m_nFileFrameCount = 0;
+			m_nFileFrameBytes = 0;
+		}
+	});
+}
+
+void CServerSess::DoSendMsg()
+{
+	//文件数据帧发送完成以后再取下一批
+	if (m_bFileFrameSending)
+	{
+		return;
+	}
+	auto pBatch = m_sendQueue.NextBatch();
+	if (!pBatch)
+	{
+		DoSendFileFrame();
+		return;
+	}
+	if (!IsConnected())
+	{
+		m_sendQueue.Clear();
+		CloseSocket();
+		return;
+	}
+	std::vector<asio::const_buffer> bufVec;
+	bufVec.reserve(pBatch->size());
+	for (const auto& msg : *pBatch)
+	{
+		bufVec.push_back(asio::buffer(msg->GetData(), msg->GetSize()));
+	}
+	auto self = shared_from_this();
+	//一批消息在回调中保持有效
+	asio::async_write(m_socket, bufVec, m_strand.wrap([this, self, pBatch](std::error_code ec, std::size_t /*length*/) {
+		//日志级别关闭时不遍历整批消息
+		if (LOG_LEVEL_ON(ms_loger, ec ? spdlog::level::warn : spdlog::level::info))
+		{
+			for (const auto& msg : *pBatch)
+			{
+				if (IsFileDataMsgType(msg->GetType()))
 				{
-					handle_message(&msg);
-					curlen -= msg.GetSize();
-					memmove(m_recvbuf, m_recvbuf + msg.GetSize(), curlen);
+					continue;
 				}
-				m_recvpos = (uint32_t)curlen;
-				if (m_recvpos < max_length && !ec)
+				if (!ec)
 				{
-					do_read();
+					LOG_INFO(ms_loger, "[ {} ] SendMsg Succeed:{} {} [{} {}]", UserId(), MsgType(msg->GetType()), CLogSampler::Payload(*msg), __FILENAME__, __LINE__);
 				}
 				else
 				{
-					CloseSocket();
+					LOG_WARN(ms_loger, "[ {} ] SendMsg Failed:{} {} [{} {}]", UserId(), MsgType(msg->GetType()), CLogSampler::Payload(*msg), __FILENAME__, __LINE__);
 				}
 			}
-		});
+		}
+		if (!ec)
+		{
+			DoSendMsg();
+		}
+		else
+		{
+			m_sendQueue.Clear();
+			CloseSocket();
+		}
+	}));
 }
 
-/**
- * @brief 当do_read函数接收到一个完整消息的时候，调用此函数，在此函数中完成消息类型的判断和消息分发
- * 
- * @param hdr 需要被处理的消息
- */
-void CServerSess::handle_message(const TransBaseMsg_t *hdr)
+void CServerSess::SendFileData(std::string strHead, const std::shared_ptr<CIoFile>& pFile, const int64_t nOffset, const std::size_t nLength)
 {
-	if (m_server)
+	auto pFrame = std::make_shared<FileFrame_st>();
+	pFrame->m_strHead = std::move(strHead);
+	pFrame->m_pFile = pFile;
+	pFrame->m_nOffset = nOffset;
+	pFrame->m_nLength = nLength;
+	auto self = shared_from_this();
+	m_strand.dispatch([this, self, pFrame]() {
+		m_fileFrameQueue.push_back(pFrame);
+		if (!m_sendQueue.IsSending() && !m_bFileFrameSending)
+		{
+			DoSendFileFrame();
+		}
+	});
+}
+
+void CServerSess::DoSendFileFrame()
+{
+	if (m_fileFrameQueue.empty())
+	{
+		return;
+	}
+	if (!IsConnected())
 	{
-		m_server->DispatchRecvTcpMsg(shared_from_this(), hdr);
+		m_fileFrameQueue.clear();
+		return;
 	}
+	auto pFrame = m_fileFrameQueue.front();
+	m_fileFrameQueue.pop_front();
+	m_bFileFrameSending = true;
+	auto self = shared_from_this();
+	asio::async_write(m_socket, asio::buffer(pFrame->m_strHead), m_strand.wrap([this, self, pFrame](std::error_code ec, std::size_t /*length*/) {
+		if (ec)
+		{
+			OnFileFrameSent(ec);
+			return;
+		}
+		SendFileBody(pFrame);
+	}));
+}
+
+void CServerSess::SendFileBody(const std::shared_ptr<FileFrame_st>& pFrame)
+{
+#ifdef __linux__
+	std::error_code ec;
+	if (!m_socket.native_non_blocking())
+	{
+		m_socket.native_non_blocking(true, ec);
+	}
+	while (!ec && pFrame->m_nLength > 0)
+	{
+		int64_t nSendLen = pFrame->m_pFile->SendTo(m_socket.native_handle(), pFrame->m_nOffset, pFrame->m_nLength);
+		if (nSendLen > 0)
+		{
+			pFrame->m_nLength -= static_cast<std::size_t>(nSendLen);
+			m_nFileFrameBytes += static_cast<uint64_t>(nSendLen);
+		}
+		else if (nSendLen < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+		{
+			auto self = shared_from_this();
+			m_socket.async_wait(tcp::socket::wait_write, m_strand.wrap([this, self, pFrame](std::error_code waitEc) {
+				if (waitEc)
+				{
+					OnFileFrameSent(waitEc);
+					return;
+				}
+				SendFileBody(pFrame);
+			}));
+			return;
+		}
+		else
+		{
+			//文件比帧头中的长度短,对端已经无法解析之后的数据
+			ec = (nSendLen < 0) ? std::error_code(errno, std::system_category()) : std::make_error_code(std::errc::io_error);
+		}
+	}
+	if (!ec)
+	{
+		m_nFileFrameCount++;
+	}
+	OnFileFrameSent(ec);
+#else
+	OnFileFrameSent(std::make_error_code(std::errc::operation_not_supported));
+#endif
 }
 
+void CServerSess::OnFileFrameSent(const std::error_code& ec)
+{
+	m_bFileFrameSending = false;
+	if (ec)
+	{
+		LOG_WARN(ms_loger, "[ {} ] Send File Frame Failed:{} [{} {}]", UserId(), ec.message(), __FILENAME__, __LINE__);
+		m_fileFrameQueue.clear();
+		m_sendQueue.Clear();
+		CloseSocket();
+		return;
+	}
+	DoSendMsg();
+}
 
 /**
  * @brief 处理心跳回复消息
@@ -68,12 +281,19 @@ void CServerSess::handleKeepAliveRsp(const KeepAliveRspMsg &rspMsg)
  * 
  */
 void CServerSess::CloseSocket() {
-	m_socket.close();
-	m_bConnect = false;
-	LOG_INFO(ms_loger, "{} Leave Server [ {} {}]", UserId(), __FILENAME__, __LINE__);
-	if (m_server) {
-		m_server->OnSessClose(shared_from_this());
-	}
+	auto self = shared_from_this();
+	m_strand.dispatch([this, self]() {
+		if (!m_bConnect.exchange(false))
+		{
+			return;
+		}
+		std::error_code ec;
+		m_socket.close(ec);
+		LOG_INFO(ms_loger, "{} Leave Server [ {} {}]", UserId(), __FILENAME__, __LINE__);
+		if (m_server) {
+			m_server->OnSessClose(self);
+		}
+	});
 }
 
 } // namespace MediumServer
\ No newline at end of file
@@ -15,8 +15,13 @@
 #include "CommonMsg.h"
 #include "asio_common.h"
 #include "Log.h"
+#include "CRecvBuffer.h"
+#include "CSendQueue.h"
+#include "CLogSampler.h"
+#include "CFileIoEngine.h"
 #include <atomic>
-#include <queue>
+#include <deque>
+#include <mutex>
 /*static std::string StringToHex(const char * data,const std::size_t length)
 {
 	const std::string hex = "0123456789ABCDEF";
@@ -39,6 +44,7 @@ class CServerSess : public std::enable_shared_from_this<CServerSess>
 {
 public:
 	static std::shared_ptr<spdlog::logger> ms_loger;
+	static SendQueueCfg_st ms_sendQueueCfg;//发送队列的水位和过载策略,新建的会话使用
 private:
     //套接字
     tcp::socket m_socket;
@@ -47,18 +53,23 @@ private:
     CChatServer* m_server;
 
     //是否已连接
-	bool m_bConnect = false;
+	std::atomic_bool m_bConnect{ false };
 
+	//串行化本会话的socket读写和发送队列,多个线程运行io_service时使用
+	asio::io_service::strand m_strand;
 
-    enum { max_length = 16384, msg_max_len=8192 };
+	//是否使用二进制编码发送消息,收到对端的二进制消息后开启
+	std::atomic_bool m_bBinaryCodec{ false };
 
-    //接收消息的buf    
-    char m_recvbuf[max_length];
-    
-    //已经接收的消息的长度
-    uint32_t m_recvpos=0;
 
-	char m_sendbuf[max_length];
+	//登录时协商的文件数据包长度
+	std::atomic<int32_t> m_nChunkSize{ FILE_DATA_CHUNK_SIZE };
+
+	//登录时协商的每批群聊消息条数,0表示逐条下发
+	std::atomic<int32_t> m_nGroupMsgBatch{ 0 };
+
+    //接收消息的缓冲区,消息在缓冲区中直接解析,按需扩大
+    CRecvBuffer m_recvBuf;
 public:
     /**
      * @brief 发送消息函数，所有的消息需要转为TransBaseMsg_t的类型来进行发送。
@@ -66,15 +77,10 @@ public:
      * @param msg 待发送的消息
      */
     void SendMsg(std::shared_ptr<TransBaseMsg_t> msg){
-		if (m_bSend) {
-			m_msgQueue.push(msg);
-		}
-		else
-		{
-			m_msgQueue.push(msg);
-			m_bSend.store(true);
-			DoSendMsg();
-		}
+		auto self = shared_from_this();
+		m_strand.dispatch([this, self, msg]() {
+			PushSendMsg(msg);
+		});
     }
 	/**
 	 * @brief 发送消息函数，所有的消息需要转为TransBaseMsg_t的类型来进行发送。
@@ -84,20 +90,11 @@ public:
 	void SendMsg(const BaseMsg* pMsg) {
 		if (pMsg)
 		{
-			auto pSend = std::make_shared<TransBaseMsg_t>(pMsg->GetMsgType(), pMsg->ToString());
-			if (m_bSend) {
-				m_msgQueue.push(pSend);
-			}
-			else
-			{
-				m_msgQueue.push(pSend);
-				m_bSend.store(true);
-				DoSendMsg();
-			}
+			SendMsg(std::make_shared<TransBaseMsg_t>(*pMsg, m_bBinaryCodec.load()));
 		}
 	}
 
-    CServerSess(tcp::socket socket, CChatServer* server) : m_socket(std::move(socket)),m_server(server),m_bConnect(true) { }
+    CServerSess(tcp::socket socket, CChatServer* server) : m_socket(std::move(socket)),m_server(server),m_bConnect(true),m_strand(m_socket.get_io_context()),m_sendQueue(ms_sendQueueCfg) { }
     
     virtual ~CServerSess(){
     }
@@ -112,7 +109,6 @@ public:
      */
     void Start() {
 		LOG_INFO(ms_loger,"Start Receive Socket [{} {}]", __FILENAME__, __LINE__);
-        m_recvpos=0;
         do_read();
     }
 	
@@ -136,6 +132,7 @@ public:
      * @return std::string 连接的用户名
      */
 	std::string UserId() const {
+		std::lock_guard<std::mutex> lock(m_userIdLock);
 		return m_strUserId;
 	}
 
@@ -146,19 +143,77 @@ public:
 	 * @param UserName 连接所对应的用户名
 	 */
 	void SetUserId(const std::string userId) {
+		std::lock_guard<std::mutex> lock(m_userIdLock);
 		m_strUserId = userId;
 	}
 
 
 	/**
-	 * @brief 关闭连接对应的socket
+	 * @brief 设置登录时协商的文件数据包长度
+	 *
+	 * @param nChunkSize 文件数据包长度
+	 */
+	void SetChunkSize(const int32_t nChunkSize) {
+		m_nChunkSize.store(nChunkSize);
+	}
+
+	/**
+	 * @brief 获取通过TCP发送文件时使用的数据包长度
+	 *
+	 * @return int32_t 文件数据包长度
+	 */
+	int32_t ChunkSize() const {
+		return m_nChunkSize.load();
+	}
+
+	/**
+	 * @brief 设置登录时协商的每批群聊消息条数
+	 *
+	 * @param nBatch 每批的条数,0表示逐条下发
+	 */
+	void SetGroupMsgBatch(const int32_t nBatch) {
+		m_nGroupMsgBatch.store(nBatch);
+	}
+
+	int32_t GroupMsgBatch() const {
+		return m_nGroupMsgBatch.load();
+	}
+
+	/**
+	 * @brief 发送文件数据帧,帧头在用户空间生成,文件数据用sendfile从文件直接写入socket,可以在任意线程调用
+	 *        文件数据帧和发送队列中的消息不会交错写入,发送队列中的消息优先发送
+	 *
+	 * @param strHead 文件数据之前的部分,由FileDataFramePrefix生成
+	 * @param pFile 文件数据所在的文件,发送完成以前保持打开
+	 * @param nOffset 文件数据在文件中的位置
+	 * @param nLength 文件数据的长度,与帧头中的长度一致
+	 */
+	void SendFileData(std::string strHead, const std::shared_ptr<CIoFile>& pFile, const int64_t nOffset, const std::size_t nLength);
+
+	//是否可以用sendfile发送文件数据,只支持Linux,对端需要使用二进制编码
+	bool CanSendFileData() const {
+#ifdef __linux__
+		return m_bBinaryCodec.load();
+#else
+		return false;
+#endif
+	}
+
+	/**
+	 * @brief 关闭连接对应的socket,可以在任意线程调用,实际的关闭在会话的strand上完成
 	 *
 	 */
 	void CloseSocket();
+
+	/**
+	 * @brief 输出发送队列的统计数据,有消息积压或者有新丢弃的消息时才输出,可以在任意线程调用
+	 *
+	 */
+	void ReportSendStat();
 private:
-	std::atomic_bool m_bSend{ false };
-	//连接对应的唯一用户标识
+	//连接对应的唯一用户标识,在业务strand上设置,在会话strand上读取
 	std::string m_strUserId;
+	mutable std::mutex m_userIdLock;
     
     /**
      * @brief 接收数据，在Start中被调用，通过asio的回调函数，实现连续接收
@@ -174,7 +229,7 @@ private:
      * 
      * @param msg 接收到的一条消息
      */
-    void handle_message(const TransBaseMsg_t* msg);
+    void handle_message(const TransBaseMsg_S_PTR& msg);
 
 
     /**
@@ -192,45 +247,63 @@ private:
     void handleKeepAliveReq(const KeepAliveReqMsg& reqMsg);
 
 
-	void DoSendMsg() {
-		if(!m_msgQueue.empty()) {
-			auto msg = m_msgQueue.front();
-			m_msgQueue.pop();
-			if (IsConnected())
-			{
-				auto self = shared_from_this();
-				std::size_t msgSize = msg->GetSize();
-				memcpy(m_sendbuf, msg->GetData(), msgSize);
-				asio::async_write(m_socket, asio::buffer(m_sendbuf, msg->GetSize()), [this, self, msg](std::error_code ec, std::size_t /*length*/) {
-					if (!ec)
-					{
-						if (msg->GetType() != E_MsgType::FileRecvDataReq_Type && msg->GetType() != E_MsgType::FileSendDataReq_Type)
-						{
-							LOG_INFO(ms_loger, "[ {} ] SendMsg Succeed:{} {} [{} {}]", UserId(), MsgType(msg->GetType()), msg->to_string(), __FILENAME__, __LINE__);
-						}
-						DoSendMsg();
-					}
-					else
-					{
-						if (msg->GetType() != E_MsgType::FileRecvDataReq_Type && msg->GetType() != E_MsgType::FileSendDataReq_Type)
-						{
-							LOG_WARN(ms_loger, "[ {} ] SendMsg Failed:{} {} [{} {}]", UserId(), MsgType(msg->GetType()), msg->to_string(), __FILENAME__, __LINE__);
-						}
-						CloseSocket();
-					}
-				});
-			}
-			else
-			{
-				CloseSocket();
-			}
-		}
-		else
-		{
-			m_bSend.store(false);
-		}
-	}
-	std::queue<std::shared_ptr<TransBaseMsg_t>> m_msgQueue;
+	/**
+	 * @brief 发送队列中的消息,排队的消息合并为一批,用一次async_write发送,
+	 *        buffer直接指向每条消息自己的数据,不拷贝到发送缓冲区。在会话的strand上调用
+	 *
+	 */
+	void DoSendMsg();
+
+	/**
+	 * @brief 消息加入发送队列,队列超过上限时断开连接。在会话的strand上调用
+	 *
+	 * @param msg 待发送的消息
+	 */
+	void PushSendMsg(const TransBaseMsg_S_PTR& msg);
+
+	/**
+	 * @brief 一个等待发送的文件数据帧
+	 *
+	 */
+	struct FileFrame_st
+	{
+		std::string m_strHead;//文件数据之前的部分
+		std::shared_ptr<CIoFile> m_pFile;//文件数据所在的文件
+		int64_t m_nOffset = 0;//下一个要发送的文件数据的位置
+		std::size_t m_nLength = 0;//还没有发送的文件数据的长度
+	};
+
+	/**
+	 * @brief 发送队列中没有消息时发送下一个文件数据帧,在会话的strand上调用
+	 *
+	 */
+	void DoSendFileFrame();
+
+	/**
+	 * @brief 发送文件数据帧中的文件数据,socket缓冲区满时等待可写以后继续,在会话的strand上调用
+	 *
+	 * @param pFrame 正在发送的文件数据帧
+	 */
+	void SendFileBody(const std::shared_ptr<FileFrame_st>& pFrame);
+
+	/**
+	 * @brief 文件数据帧发送完成,继续发送队列中的消息,发送失败时断开连接
+	 *
+	 * @param ec 发送的结果
+	 */
+	void OnFileFrameSent(const std::error_code& ec);
+
+	//上一次输出统计时丢弃和合并的消息条数
+	uint64_t m_nReportedShedCount = 0;
+
+	//等待发送的文件数据帧,只在会话的strand上访问
+	std::deque<std::shared_ptr<FileFrame_st>> m_fileFrameQueue;
+	bool m_bFileFrameSending = false;//是否有文件数据帧正在发送
+	uint64_t m_nFileFrameCount = 0;//已经发送的文件数据帧的个数
+	uint64_t m_nFileFrameBytes = 0;//用sendfile发送的文件数据的字节数
+
+	//发送队列,只在会话的strand上访问
+	CSendQueue m_sendQueue;
 };
 }
 #endif
@@ -94,15 +94,15 @@ namespace ChatServer
 		if (m_socket)
 		{
 			auto pSelf = shared_from_this();
-			TransBaseMsg_t trans(pMsg->GetMsgType(), pMsg->ToString());
-			memcpy(m_sendbuf, trans.GetData(), trans.GetSize());
-			if (pMsg->GetMsgType() != E_MsgType::FileSendDataReq_Type && pMsg->GetMsgType() != E_MsgType::FileRecvDataReq_Type)
+			//每个发送请求持有自己的数据,避免未完成的发送被后续消息覆盖
+			//文件数据使用二进制帧,原始数据直接放在帧尾,不做hex转换
+			auto pTrans = std::make_shared<TransBaseMsg_t>(*pMsg, IsFileDataMsgType(pMsg->GetMsgType()));
+			if (!IsFileDataMsgType(pMsg->GetMsgType()))
 			{
 				LOG_INFO(ms_loger, "UDP SEND TO: {}  Msg:{} [{} {}]", EndPoint(senderPt), pMsg->ToString(), __FILENAME__, __LINE__);
 			}
-			std::string strMsg = trans.to_string();
-			m_socket->async_send_to(asio::buffer(m_sendbuf, trans.GetSize()),senderPt,
-				[this, pSelf, senderPt, strMsg](std::error_code ec, std::size_t /*bytes_recvd*/) {
+			m_socket->async_send_to(asio::buffer(pTrans->GetData(), pTrans->GetSize()),senderPt,
+				[this, pSelf, senderPt, pTrans](std::error_code ec, std::size_t /*bytes_recvd*/) {
 				if (ec)
 				{
 					LOG_ERR(ms_loger, "UDP Send To:{} ERR:{} [{} {}]", EndPoint(senderPt),ec.value(), __FILENAME__, __LINE__);
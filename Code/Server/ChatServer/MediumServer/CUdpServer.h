@@ -30,9 +30,6 @@ namespace ChatServer
 		//接收buf
 		char m_recvbuf[max_length];
 
-		//接收buf
-		char m_sendbuf[max_length];
-
 		//接收位置
 		uint32_t m_recvpos = 0;
 	public:
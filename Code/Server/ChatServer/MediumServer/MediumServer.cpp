@@ -1,5 +1,8 @@
-﻿#include <iostream>
+﻿#include <algorithm>
+#include <iostream>
 #include <memory>
+#include <thread>
+#include <vector>
 #include "CMediumServer.h"
 #include "DaemonSvcApp.h"
 #include "CServerSess.h"
@@ -16,6 +19,7 @@ void GenerateCfgFile(std::string fileName)
     std::string strConfig=R"({
    "LogDir":"/home/test/Log/SourceServer/",
    "NodeId":"MediumServer",
+   "threads":0,
    "server":{
         "ip":"127.0.0.1",
         "port":9000
@@ -72,6 +76,7 @@ int FrontRun(int argc, char *argv[])
 	ChatServer::CChatServer::ms_loger = logger;
 	ChatServer::CUdpServer::ms_loger = logger;
 	CMySqlConnect::m_loger = logger;
+	CChatArchive::ms_loger = logger;
 	asio::io_service IoService;
 	auto server = std::make_shared<ChatServer::CChatServer>(IoService);
 	
@@ -88,7 +93,30 @@ int FrontRun(int argc, char *argv[])
 			LOG_ERR(logger, "ERROR Fail to start error:{} [{} {}]", ec.message(), __FILENAME__, __LINE__);
 		}
 	});
+
+	//运行io_service的线程数,配置为0时使用CPU的核数
+	std::size_t nThreads = 0;
+	if (cfg["threads"].is_number() && cfg["threads"].int_value() > 0)
+	{
+		nThreads = static_cast<std::size_t>(cfg["threads"].int_value());
+	}
+	else
+	{
+		nThreads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+	}
+	LOG_INFO(logger, "Run IoService With {} Threads [{} {}]", nThreads, __FILENAME__, __LINE__);
+	std::vector<std::thread> workThreads;
+	for (std::size_t i = 1; i < nThreads; i++)
+	{
+		workThreads.emplace_back([&IoService]() {
+			IoService.run();
+		});
+	}
 	IoService.run();
+	for (auto& item : workThreads)
+	{
+		item.join();
+	}
 	return 0;
 }
 #ifdef _WIN32
@@ -128,6 +156,7 @@ int main(int argc, char *argv[])
 	ChatServer::CChatServer::ms_loger = logger;
 	ChatServer::CUdpServer::ms_loger = logger;
 	CMySqlConnect::m_loger = logger;
+	CChatArchive::ms_loger = logger;
 	asio::io_service IoService;
 	auto server = std::make_shared<ChatServer::CChatServer>(IoService);
 	
@@ -188,6 +217,7 @@ int main(int argc, char *argv[])
 	ChatServer::CClientSessManager::ms_loger = logger;
 	ChatServer::CUdpServer::ms_loger = logger;
 	CMySqlConnect::m_loger = logger;
+	CChatArchive::ms_loger = logger;
 	asio::io_service IoService;
 	auto server = std::make_shared<ChatServer::CChatServer>(IoService);
 	
@@ -0,0 +1,150 @@
+#include <doctest/doctest.h>
+#include "../MediumServer/CBlobStore.h"
+
+static bool WriteBlobTestFile(const std::string& strPath, const std::string& strData)
+{
+	std::FILE* pFile = std::fopen(strPath.c_str(), "wb");
+	if (nullptr == pFile)
+	{
+		return false;
+	}
+	std::fwrite(strData.data(), 1, strData.length(), pFile);
+	std::fclose(pFile);
+	return true;
+}
+
+static bool IsBlobTestFileExist(const std::string& strPath)
+{
+	std::FILE* pFile = std::fopen(strPath.c_str(), "rb");
+	if (nullptr == pFile)
+	{
+		return false;
+	}
+	std::fclose(pFile);
+	return true;
+}
+
+TEST_CASE("BlobStoreName") {
+	CHECK(CBlobStore::IsValidHash("0123456789abcdef0123456789ABCDEF"));
+	CHECK_FALSE(CBlobStore::IsValidHash(""));
+	CHECK_FALSE(CBlobStore::IsValidHash("0123"));
+	CHECK_FALSE(CBlobStore::IsValidHash("0123456789abcdef0123456789abcdeg"));
+	CHECK_EQ("0123456789abcdef", CBlobStore::NormalizeHash("0123456789ABCDEF"));
+
+	CHECK(CBlobStore::IsValidName("20200523101010.png"));
+	CHECK_FALSE(CBlobStore::IsValidName(""));
+	CHECK_FALSE(CBlobStore::IsValidName(".."));
+	CHECK_FALSE(CBlobStore::IsValidName("../a.png"));
+	CHECK_FALSE(CBlobStore::IsValidName("a\\b.png"));
+}
+
+TEST_CASE("BlobStoreDedup") {
+	const std::string strDir = "BlobStoreTest";
+	const std::string strHashA = "00112233445566778899aabbccddeeff00112233445566778899aabbccddeeff";
+	const std::string strHashB = "ffeeddccbbaa99887766554433221100ffeeddccbbaa99887766554433221100";
+	const std::string strMd5A = "0123456789abcdef0123456789abcdef";
+	{
+		CBlobStore store;
+		REQUIRE(store.Open(strDir));
+		CHECK_EQ(0u, store.Stat().m_nBlobs);
+		//没有保存过的内容不能秒传
+		CHECK_FALSE(store.Link("a.png", strHashA));
+
+		REQUIRE(WriteBlobTestFile(store.TempPath("a.png"), "AAAA"));
+		//新保存的内容只能按BLAKE2b保存
+		CHECK_FALSE(store.Commit(store.TempPath("a.png"), "a.png", strMd5A, ""));
+		REQUIRE(store.Commit(store.TempPath("a.png"), "a.png", strHashA, strMd5A));
+		CHECK_FALSE(IsBlobTestFileExist(store.TempPath("a.png")));
+		CHECK(IsBlobTestFileExist(store.BlobPath(strHashA)));
+
+		//相同内容再次上传,删除临时文件
+		REQUIRE(WriteBlobTestFile(store.TempPath("b.png"), "AAAA"));
+		REQUIRE(store.Commit(store.TempPath("b.png"), "b.png", strHashA, ""));
+		CHECK_FALSE(IsBlobTestFileExist(store.TempPath("b.png")));
+		//大小不同的内容不当作相同
+		REQUIRE(WriteBlobTestFile(store.TempPath("x.png"), "AAAAAA"));
+		CHECK_FALSE(store.Commit(store.TempPath("x.png"), "x.png", strHashA, ""));
+		CHECK(IsBlobTestFileExist(store.TempPath("x.png")));
+		std::remove(store.TempPath("x.png").c_str());
+
+		//秒传,Hash的大小写不影响,旧版本的客户端使用MD5
+		REQUIRE(store.Link("c.png", "0123456789ABCDEF0123456789ABCDEF"));
+		REQUIRE(store.Link("c.png", strHashA));
+		REQUIRE(WriteBlobTestFile(store.TempPath("d.png"), "BBBBBBBB"));
+		REQUIRE(store.Commit(store.TempPath("d.png"), "d.png", strHashB, ""));
+
+		std::string strHash;
+		REQUIRE(store.FindName("c.png", strHash));
+		CHECK_EQ(strHashA, strHash);
+		CHECK_FALSE(store.FindName("x.png", strHash));
+		REQUIRE(store.FindBlob(strHashA) != nullptr);
+		CHECK_EQ(3u, store.FindBlob(strHashA)->m_nRefCount);
+		CHECK_EQ(4, store.FindBlob(strHashA)->m_nSize);
+		REQUIRE(store.FindBlob(strMd5A) != nullptr);
+		CHECK_EQ(strHashA, store.FindBlob(strMd5A)->m_strHash);
+		CHECK(store.FindBlob(strHashB)->m_strMd5.empty());
+
+		BlobStat_st stat = store.Stat();
+		CHECK_EQ(2u, stat.m_nBlobs);
+		CHECK_EQ(4u, stat.m_nNames);
+		CHECK_EQ(12, stat.m_nBytes);
+		CHECK_EQ(8, stat.m_nDedupBytes);
+
+		REQUIRE(store.Unlink("a.png"));
+		CHECK_FALSE(store.Unlink("a.png"));
+		//已经引用其他内容的文件名不能改为引用另一份内容
+		CHECK_FALSE(store.Link("b.png", strHashB));
+		REQUIRE(WriteBlobTestFile(store.TempPath("b.png"), "BBBBBBBB"));
+		CHECK_FALSE(store.Commit(store.TempPath("b.png"), "b.png", strHashB, ""));
+		std::remove(store.TempPath("b.png").c_str());
+		REQUIRE(store.FindName("b.png", strHash));
+		CHECK_EQ(strHashA, strHash);
+		CHECK_EQ(2u, store.FindBlob(strHashA)->m_nRefCount);
+		CHECK_EQ(1u, store.FindBlob(strHashB)->m_nRefCount);
+	}
+	{
+		//写了一半的索引记录在重新打开时跳过
+		std::FILE* pIndex = std::fopen((strDir + "/" + CBlobStore::INDEX_FILE_NAME).c_str(), "ab");
+		REQUIRE(pIndex != nullptr);
+		std::fputs("{\"Op\":\"Unlink\",\"Na", pIndex);
+		std::fclose(pIndex);
+
+		CBlobStore store;
+		REQUIRE(store.Open(strDir));
+		std::string strHash;
+		REQUIRE(store.FindName("b.png", strHash));
+		CHECK_EQ(strHashA, strHash);
+		CHECK_FALSE(store.FindName("a.png", strHash));
+		REQUIRE(store.FindBlob(strHashA) != nullptr);
+		CHECK_EQ(2u, store.FindBlob(strHashA)->m_nRefCount);
+		CHECK_EQ(1u, store.FindBlob(strHashB)->m_nRefCount);
+		//重新打开以后MD5仍然可以使用
+		REQUIRE(store.FindBlob(strMd5A) != nullptr);
+		CHECK_EQ(strMd5A, store.FindBlob(strHashA)->m_strMd5);
+
+		//最后一个引用删除时删除文件
+		REQUIRE(store.Unlink("c.png"));
+		REQUIRE(store.Unlink("b.png"));
+		CHECK(nullptr == store.FindBlob(strHashA));
+		CHECK(nullptr == store.FindBlob(strMd5A));
+		CHECK_FALSE(IsBlobTestFileExist(store.BlobPath(strHashA)));
+		REQUIRE(store.Unlink("d.png"));
+		CHECK_FALSE(IsBlobTestFileExist(store.BlobPath(strHashB)));
+
+		//文件已经被删除的内容在打开时去掉
+		REQUIRE(WriteBlobTestFile(store.TempPath("e.png"), "EE"));
+		REQUIRE(store.Commit(store.TempPath("e.png"), "e.png", strHashA, ""));
+		std::remove(store.BlobPath(strHashA).c_str());
+	}
+	{
+		CBlobStore store;
+		REQUIRE(store.Open(strDir));
+		CHECK_EQ(0u, store.Stat().m_nNames);
+		store.Close();
+	}
+	std::remove((strDir + "/" + CBlobStore::INDEX_FILE_NAME).c_str());
+	std::remove((strDir + "/" + strHashA.substr(0, 2)).c_str());
+	std::remove((strDir + "/" + strHashB.substr(0, 2)).c_str());
+	std::remove((strDir + "/" + CBlobStore::TEMP_DIR_NAME).c_str());
+	std::remove(strDir.c_str());
+}
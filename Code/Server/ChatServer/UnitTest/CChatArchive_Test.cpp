@@ -0,0 +1,179 @@
+#include <doctest/doctest.h>
+#include "../MediumServer/CChatPartition.h"
+#include "../MediumServer/CChatArchive.h"
+
+static T_USER_CHAT_MSG ArchiveFriendMsg(const uint64_t nMsgId)
+{
+	T_USER_CHAT_MSG msg;
+	msg.m_strF_MSG_ID = std::to_string(nMsgId);
+	msg.m_eChatMsgType = CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE;
+	msg.m_strF_FROM_ID = "10001";
+	msg.m_strF_TO_ID = std::to_string(10002 + nMsgId % 3);
+	msg.m_strF_MSG_CONTEXT = "Hello " + std::to_string(nMsgId);
+	msg.m_strF_OTHER_INFO = "{}";
+	msg.m_strF_READ_FLAG = (nMsgId % 2) ? "READ" : "UNREAD";
+	msg.m_strF_CREATE_TIME = "2020-04-26 10:00:0" + std::to_string(nMsgId % 10);
+	return msg;
+}
+
+static T_GROUP_CHAT_MSG ArchiveGroupMsg(const uint64_t nMsgId, const std::string& strGroupId)
+{
+	T_GROUP_CHAT_MSG msg;
+	msg.m_strF_MSG_ID = std::to_string(nMsgId);
+	msg.m_eChatMsgType = CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE;
+	msg.m_strF_SENDER_ID = "10001";
+	msg.m_strF_GROUP_ID = strGroupId;
+	msg.m_strF_MSG_CONTEXT = "Group " + std::to_string(nMsgId);
+	msg.m_strF_CREATE_TIME = "2020-04-26 10:00:00";
+	return msg;
+}
+
+TEST_CASE("ChatPartitionMonth") {
+	int nMonth = CChatPartition::MonthIndex(2020, 5);
+	uint64_t nStartId = CChatPartition::MonthStartMsgId(nMonth);
+	CHECK(nStartId > 0);
+	CHECK_EQ(nMonth, CChatPartition::MonthIndexOfMsgId(nStartId));
+	CHECK_EQ(nMonth - 1, CChatPartition::MonthIndexOfMsgId(nStartId - 1));
+	CHECK_EQ(nMonth, CChatPartition::MonthIndexOfMsgId(CChatPartition::MonthStartMsgId(nMonth + 1) - 1));
+	//早于SnowFlake起始时间的月份
+	CHECK_EQ(0u, CChatPartition::MonthStartMsgId(CChatPartition::MonthIndex(2016, 1)));
+
+	CHECK_EQ("p202005", CChatPartition::PartitionName(nMonth));
+	CHECK_EQ("p202012", CChatPartition::PartitionName(CChatPartition::MonthIndex(2020, 12)));
+	int nParsed = 0;
+	REQUIRE(CChatPartition::ParsePartitionName("p202012", nParsed));
+	CHECK_EQ(CChatPartition::MonthIndex(2020, 12), nParsed);
+	CHECK_FALSE(CChatPartition::ParsePartitionName(CChatPartition::MAX_PARTITION, nParsed));
+	CHECK_FALSE(CChatPartition::ParsePartitionName("p202013", nParsed));
+}
+
+TEST_CASE("ChatPartitionPlan") {
+	int nCurMonth = CChatPartition::CurrentMonthIndex();
+	auto partVec = CChatPartition::MonthPartitions(nCurMonth - 8, nCurMonth);
+	REQUIRE_EQ(10u, partVec.size());
+	CHECK(partVec.back().m_bMaxValue);
+	CHECK_EQ(CChatPartition::MonthStartMsgId(nCurMonth - 7), partVec[0].m_nLessThan);
+
+	//提前创建之后两个月的分区
+	auto missVec = CChatPartition::MissingPartitions(partVec, nCurMonth + 2);
+	REQUIRE_EQ(2u, missVec.size());
+	CHECK_EQ(CChatPartition::PartitionName(nCurMonth + 1), missVec[0].m_strName);
+	CHECK_EQ(CChatPartition::PartitionName(nCurMonth + 2), missVec[1].m_strName);
+	CHECK(CChatPartition::MissingPartitions(partVec, nCurMonth).empty());
+	//没有p_max的表不处理
+	partVec.pop_back();
+	CHECK(CChatPartition::MissingPartitions(partVec, nCurMonth + 2).empty());
+
+	//保留包括当前月在内的6个月
+	auto coldVec = CChatPartition::ColdPartitions(partVec, nCurMonth, 6);
+	REQUIRE_EQ(3u, coldVec.size());
+	CHECK_EQ(CChatPartition::PartitionName(nCurMonth - 8), coldVec[0].m_strName);
+	CHECK_EQ(CChatPartition::PartitionName(nCurMonth - 6), coldVec[2].m_strName);
+}
+
+TEST_CASE("ChatArchiveFriendMsg") {
+	const std::string strPath = "ChatArchiveFriendTest" + CChatArchive::FILE_SUFFIX;
+	{
+		CChatArchiveWriter writer(4);
+		REQUIRE(writer.Open(strPath, E_ARCHIVE_KIND::E_ARCHIVE_FRIEND_MSG));
+		CHECK_FALSE(writer.Append(ArchiveGroupMsg(1, "20001")));
+		for (uint64_t nMsgId = 1000; nMsgId < 1010; nMsgId++)
+		{
+			REQUIRE(writer.Append(ArchiveFriendMsg(nMsgId)));
+		}
+		REQUIRE(writer.Finish());
+	}
+	CChatArchiveReader reader;
+	REQUIRE(reader.Open(strPath));
+	CHECK(E_ARCHIVE_KIND::E_ARCHIVE_FRIEND_MSG == reader.Kind());
+	CHECK_EQ(10u, reader.Rows());
+	CHECK_EQ(1000u, reader.MinMsgId());
+	CHECK_EQ(1009u, reader.MaxMsgId());
+	REQUIRE_EQ(3u, reader.Blocks().size());
+
+	std::vector<T_USER_CHAT_MSG> msgVec;
+	REQUIRE(reader.ReadBlock(2, msgVec));
+	REQUIRE_EQ(2u, msgVec.size());
+	const auto expectMsg = ArchiveFriendMsg(1009);
+	CHECK_EQ(expectMsg.m_strF_MSG_ID, msgVec[1].m_strF_MSG_ID);
+	CHECK_EQ(expectMsg.m_strF_TO_ID, msgVec[1].m_strF_TO_ID);
+	CHECK_EQ(expectMsg.m_strF_FROM_ID, msgVec[1].m_strF_FROM_ID);
+	CHECK_EQ(expectMsg.m_strF_MSG_CONTEXT, msgVec[1].m_strF_MSG_CONTEXT);
+	CHECK_EQ(expectMsg.m_strF_OTHER_INFO, msgVec[1].m_strF_OTHER_INFO);
+	CHECK_EQ(expectMsg.m_strF_READ_FLAG, msgVec[1].m_strF_READ_FLAG);
+	CHECK_EQ(expectMsg.m_strF_CREATE_TIME, msgVec[1].m_strF_CREATE_TIME);
+	CHECK(CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE == msgVec[1].m_eChatMsgType);
+	CHECK_FALSE(reader.ReadBlock(3, msgVec));
+
+	//好友消息的归档没有群组消息
+	std::vector<T_GROUP_CHAT_MSG> groupVec;
+	CHECK_FALSE(reader.SelectGroupChatTextList("20001", "0", 10, groupVec));
+	std::remove(strPath.c_str());
+}
+
+TEST_CASE("ChatArchiveGroupMsg") {
+	const std::string strDir = "ChatArchiveTest";
+	CChatArchive archive;
+	REQUIRE(archive.Open(strDir));
+	CHECK(archive.Files().empty());
+
+	//两个月的归档,第二个文件只有群组20002的消息
+	const std::string strFirst = archive.ArchivePath("T_GROUP_CHAT_MSG", "p202004");
+	const std::string strSecond = archive.ArchivePath("T_GROUP_CHAT_MSG", "p202005");
+	{
+		CChatArchiveWriter writer(4);
+		REQUIRE(writer.Open(strFirst, E_ARCHIVE_KIND::E_ARCHIVE_GROUP_MSG));
+		for (uint64_t nMsgId = 100; nMsgId < 120; nMsgId++)
+		{
+			REQUIRE(writer.Append(ArchiveGroupMsg(nMsgId, (nMsgId < 110 || nMsgId % 2) ? "20001" : "20002")));
+		}
+		REQUIRE(writer.Finish());
+	}
+	{
+		CChatArchiveWriter writer(4);
+		REQUIRE(writer.Open(strSecond, E_ARCHIVE_KIND::E_ARCHIVE_GROUP_MSG));
+		for (uint64_t nMsgId = 200; nMsgId < 206; nMsgId++)
+		{
+			REQUIRE(writer.Append(ArchiveGroupMsg(nMsgId, "20002")));
+		}
+		REQUIRE(writer.Finish());
+	}
+	//写入中断的临时文件不会被加载
+	{
+		CChatArchiveWriter writer(4);
+		REQUIRE(writer.Open(archive.ArchivePath("T_GROUP_CHAT_MSG", "p202006"), E_ARCHIVE_KIND::E_ARCHIVE_GROUP_MSG));
+		REQUIRE(writer.Append(ArchiveGroupMsg(300, "20002")));
+	}
+	REQUIRE(archive.Reload());
+	auto fileVec = archive.Files();
+	REQUIRE_EQ(2u, fileVec.size());
+	CHECK_EQ(strFirst, fileVec[0].m_strPath);
+	CHECK_EQ(20u, fileVec[0].m_nRows);
+	CHECK_EQ(205u, fileVec[1].m_nMaxMsgId);
+
+	CChatArchiveReader reader;
+	REQUIRE(reader.Open(strFirst));
+	std::vector<T_GROUP_CHAT_MSG> msgVec;
+	REQUIRE(reader.SelectGroupChatTextList("20002", "0", 3, msgVec));
+	REQUIRE_EQ(3u, msgVec.size());
+	CHECK_EQ("110", msgVec[0].m_strF_MSG_ID);
+	CHECK_EQ("112", msgVec[1].m_strF_MSG_ID);
+	CHECK_EQ("114", msgVec[2].m_strF_MSG_ID);
+	CHECK_EQ("20002", msgVec[2].m_strF_GROUP_ID);
+	CHECK_EQ("Group 114", msgVec[2].m_strF_MSG_CONTEXT);
+
+	//跨越两个文件读取,结果按消息ID排列
+	REQUIRE(archive.SelectGroupChatTextList("20002", "114", 5, msgVec));
+	REQUIRE_EQ(5u, msgVec.size());
+	CHECK_EQ("116", msgVec[0].m_strF_MSG_ID);
+	CHECK_EQ("118", msgVec[1].m_strF_MSG_ID);
+	CHECK_EQ("200", msgVec[2].m_strF_MSG_ID);
+	CHECK_EQ("202", msgVec[4].m_strF_MSG_ID);
+	CHECK_FALSE(archive.SelectGroupChatTextList("20002", "205", 5, msgVec));
+	CHECK_FALSE(archive.SelectGroupChatTextList("20003", "0", 5, msgVec));
+
+	std::remove(strFirst.c_str());
+	std::remove(strSecond.c_str());
+	std::remove((archive.ArchivePath("T_GROUP_CHAT_MSG", "p202006") + ".tmp").c_str());
+	std::remove(strDir.c_str());
+}
@@ -0,0 +1,103 @@
+#include <doctest/doctest.h>
+#include <fstream>
+#include "../MediumServer/CChatMsgJournal.h"
+
+static T_USER_CHAT_MSG JournalFriendMsg(const std::string& strMsgId, const std::string& strContext)
+{
+	T_USER_CHAT_MSG msg;
+	msg.m_strF_MSG_ID = strMsgId;
+	msg.m_eChatMsgType = CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE;
+	msg.m_strF_FROM_ID = "10001";
+	msg.m_strF_TO_ID = "10002";
+	msg.m_strF_MSG_CONTEXT = strContext;
+	msg.m_strF_CREATE_TIME = "2020-04-26 10:00:00";
+	return msg;
+}
+
+static T_GROUP_CHAT_MSG JournalGroupMsg(const std::string& strMsgId)
+{
+	T_GROUP_CHAT_MSG msg;
+	msg.m_strF_MSG_ID = strMsgId;
+	msg.m_eChatMsgType = CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE;
+	msg.m_strF_SENDER_ID = "10001";
+	msg.m_strF_GROUP_ID = "20001";
+	msg.m_strF_MSG_CONTEXT = "Group" + strMsgId;
+	return msg;
+}
+
+TEST_CASE("ChatMsgJournalLine") {
+	ChatMsgJournalBatch_st batch;
+	//消息内容中的换行在日志中被转义,一条消息只占一行
+	std::string strLine = CChatMsgJournal::ToJournalLine(JournalFriendMsg("1001", "Hello\nWorld"));
+	CHECK(strLine.find('\n') == std::string::npos);
+	REQUIRE(CChatMsgJournal::ParseJournalLine(strLine, batch));
+	REQUIRE(CChatMsgJournal::ParseJournalLine(CChatMsgJournal::ToJournalLine(JournalGroupMsg("1002")), batch));
+	REQUIRE_EQ(1u, batch.m_friendMsgVec.size());
+	REQUIRE_EQ(1u, batch.m_groupMsgVec.size());
+	CHECK_EQ("Hello\nWorld", batch.m_friendMsgVec[0].m_strF_MSG_CONTEXT);
+	CHECK_EQ("10002", batch.m_friendMsgVec[0].m_strF_TO_ID);
+	CHECK_EQ("2020-04-26 10:00:00", batch.m_friendMsgVec[0].m_strF_CREATE_TIME);
+	CHECK_EQ("20001", batch.m_groupMsgVec[0].m_strF_GROUP_ID);
+	CHECK(CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE == batch.m_groupMsgVec[0].m_eChatMsgType);
+
+	//写了一半的行
+	CHECK_FALSE(CChatMsgJournal::ParseJournalLine(strLine.substr(0, strLine.length() / 2), batch));
+	CHECK_EQ(2u, batch.Size());
+}
+
+TEST_CASE("ChatMsgJournalReplay") {
+	const std::string strDir = "ChatMsgJournalTest";
+	std::vector<ChatMsgJournalBatch_st> replayVec;
+	uint64_t nSealed = 0;
+	uint64_t nPending = 0;
+	{
+		CChatMsgJournal journal;
+		REQUIRE(journal.Open(strDir, replayVec));
+		CHECK(replayVec.empty());
+		ChatMsgJournalBatch_st batch;
+		CHECK_FALSE(journal.Seal(batch));
+
+		REQUIRE(journal.Append(JournalFriendMsg("1001", "Msg1")));
+		REQUIRE(journal.Append(JournalGroupMsg("1002")));
+		CHECK_EQ(2u, journal.PendingCount());
+		REQUIRE(journal.Seal(batch));
+		CHECK_EQ(0u, journal.PendingCount());
+		CHECK_EQ(2u, batch.Size());
+		CHECK_FALSE(batch.m_bReplay);
+		nSealed = batch.m_nSegment;
+
+		//第一批没有入库,第二批入库以后删除
+		REQUIRE(journal.Append(JournalFriendMsg("1003", "Msg3")));
+		REQUIRE(journal.Seal(batch));
+		CHECK(journal.Remove(batch.m_nSegment));
+
+		REQUIRE(journal.Append(JournalFriendMsg("1004", "Msg4")));
+		nPending = batch.m_nSegment + 1;
+	}
+	//模拟进程崩溃时写了一半的行
+	{
+		std::ofstream outFile(strDir + "/chatmsg_" + std::to_string(nPending) + ".journal", std::ios::binary | std::ios::app);
+		outFile << "{\"Kind\":\"Friend\",\"MsgId\":\"10";
+	}
+	{
+		CChatMsgJournal journal;
+		REQUIRE(journal.Open(strDir, replayVec));
+		REQUIRE_EQ(2u, replayVec.size());
+		CHECK_EQ(nSealed, replayVec[0].m_nSegment);
+		CHECK(replayVec[0].m_bReplay);
+		CHECK_EQ(2u, replayVec[0].Size());
+		CHECK_EQ(nPending, replayVec[1].m_nSegment);
+		REQUIRE_EQ(1u, replayVec[1].m_friendMsgVec.size());
+		CHECK_EQ("1004", replayVec[1].m_friendMsgVec[0].m_strF_MSG_ID);
+		for (const auto& batch : replayVec)
+		{
+			CHECK(journal.Remove(batch.m_nSegment));
+		}
+	}
+	{
+		CChatMsgJournal journal;
+		REQUIRE(journal.Open(strDir, replayVec));
+		CHECK(replayVec.empty());
+	}
+	std::remove(strDir.c_str());
+}
@@ -0,0 +1,160 @@
+#include <doctest/doctest.h>
+#include "CDbExecutor.h"
+#include <stdexcept>
+
+struct FakeDbConn_st
+{
+	std::mutex m_mutex;
+	std::vector<int> m_doneVec;//在该连接上执行过的操作
+	int m_nPingCount = 0;
+};
+
+//模拟asio的strand,回调保存下来由测试线程执行
+struct FakeStrand_st
+{
+	std::mutex m_mutex;
+	std::vector<std::function<void()>> m_handlerVec;
+
+	template<typename Handler>
+	void post(Handler handler)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_handlerVec.push_back(handler);
+	}
+
+	std::size_t RunAll()
+	{
+		std::vector<std::function<void()>> handlerVec;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			handlerVec.swap(m_handlerVec);
+		}
+		for (auto& handler : handlerVec)
+		{
+			handler();
+		}
+		return handlerVec.size();
+	}
+};
+
+TEST_CASE("DbExecutorKeyOrder") {
+	std::vector<std::shared_ptr<FakeDbConn_st>> connVec;
+	DbExecutorCfg_st cfg;
+	cfg.m_nWorkerCount = 3;
+	CDbExecutor<FakeDbConn_st> executor;
+	CHECK(executor.Start(cfg, [&connVec]() {
+		connVec.push_back(std::make_shared<FakeDbConn_st>());
+		return connVec.back();
+	}, nullptr));
+	CHECK_EQ(3u, executor.WorkerCount());
+	CHECK_EQ(3u, connVec.size());
+
+	//同一个key的操作在同一个连接上按顺序执行
+	for (int i = 0; i < 100; i++)
+	{
+		CHECK(executor.Post("10001", [i](FakeDbConn_st& conn) {
+			std::lock_guard<std::mutex> lock(conn.m_mutex);
+			conn.m_doneVec.push_back(i);
+		}));
+	}
+	executor.Stop();
+	CHECK_FALSE(executor.IsRunning());
+	CHECK_FALSE(executor.Post("10001", [](FakeDbConn_st&) {}));
+
+	int nUsedConn = 0;
+	for (auto& pConn : connVec)
+	{
+		if (pConn->m_doneVec.empty())
+		{
+			continue;
+		}
+		nUsedConn++;
+		REQUIRE_EQ(100u, pConn->m_doneVec.size());
+		for (int i = 0; i < 100; i++)
+		{
+			CHECK_EQ(i, pConn->m_doneVec[i]);
+		}
+	}
+	CHECK_EQ(1, nUsedConn);
+}
+
+TEST_CASE("DbExecutorResultToStrand") {
+	DbExecutorCfg_st cfg;
+	cfg.m_nWorkerCount = 2;
+	CDbExecutor<FakeDbConn_st> executor;
+	CHECK(executor.Start(cfg, []() { return std::make_shared<FakeDbConn_st>(); }, nullptr));
+
+	FakeStrand_st strand;
+	std::vector<std::string> resultVec;
+	for (int i = 0; i < 10; i++)
+	{
+		CHECK(executor.Post(std::to_string(i), [i](FakeDbConn_st&) {
+			return std::to_string(i * 2);
+		}, strand, [&resultVec](const std::string& strResult) {
+			resultVec.push_back(strResult);
+		}));
+	}
+	executor.Stop();
+	//结果只在strand上回调
+	CHECK(resultVec.empty());
+	CHECK_EQ(10u, strand.RunAll());
+	REQUIRE_EQ(10u, resultVec.size());
+	std::sort(resultVec.begin(), resultVec.end());
+	CHECK_EQ("0", resultVec[0]);
+
+	auto stat = executor.Stat();
+	CHECK_EQ(10u, stat.m_nPostCount);
+	CHECK_EQ(10u, stat.m_nDoneCount);
+	CHECK_EQ(0u, stat.m_nQueueCount);
+}
+
+TEST_CASE("DbExecutorQueryThrow") {
+	DbExecutorCfg_st cfg;
+	cfg.m_nWorkerCount = 1;
+	CDbExecutor<FakeDbConn_st> executor;
+	CHECK(executor.Start(cfg, []() { return std::make_shared<FakeDbConn_st>(); }, nullptr));
+
+	//抛出异常的操作也会回调,结果为默认值
+	FakeStrand_st strand;
+	std::vector<int> resultVec;
+	CHECK(executor.Post("10001", [](FakeDbConn_st&) -> int {
+		throw std::runtime_error("lost connection");
+	}, strand, [&resultVec](const int nResult) {
+		resultVec.push_back(nResult);
+	}));
+	CHECK(executor.Post("10001", [](FakeDbConn_st&) {
+		return 7;
+	}, strand, [&resultVec](const int nResult) {
+		resultVec.push_back(nResult);
+	}));
+	executor.Stop();
+	CHECK_EQ(2u, strand.RunAll());
+	REQUIRE_EQ(2u, resultVec.size());
+	CHECK_EQ(0, resultVec[0]);
+	CHECK_EQ(7, resultVec[1]);
+
+	auto stat = executor.Stat();
+	CHECK_EQ(2u, stat.m_nDoneCount);
+	CHECK_EQ(1u, stat.m_nErrorCount);
+}
+
+TEST_CASE("DbExecutorPingIdle") {
+	DbExecutorCfg_st cfg;
+	cfg.m_nWorkerCount = 1;
+	cfg.m_nPingIntervalMs = 5;
+	std::shared_ptr<FakeDbConn_st> pConn = std::make_shared<FakeDbConn_st>();
+	std::atomic<int> nThreadStart{ 0 };
+	CDbExecutor<FakeDbConn_st> executor;
+	CHECK(executor.Start(cfg, [pConn]() { return pConn; }, [](FakeDbConn_st& conn) {
+		conn.m_nPingCount++;
+		return false;
+	}, [&nThreadStart]() { nThreadStart++; }));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	executor.Stop();
+	CHECK_EQ(1, nThreadStart.load());
+	//空闲时定期检查连接
+	CHECK(pConn->m_nPingCount > 0);
+	auto stat = executor.Stat();
+	CHECK_EQ(static_cast<uint64_t>(pConn->m_nPingCount), stat.m_nPingCount);
+	CHECK_EQ(stat.m_nPingCount, stat.m_nPingFailed);
+}
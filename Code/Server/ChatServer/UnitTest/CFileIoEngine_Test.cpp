@@ -0,0 +1,168 @@
+#include <doctest/doctest.h>
+#include "CFileIoEngine.h"
+#include <stdexcept>
+#ifdef __linux__
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+//FakeStrand_st在CDbExecutor_Test.cpp中定义
+
+TEST_CASE("FileIoEngineWriteAt") {
+	const std::string strFileName = "FileIoEngine_Test.dat";
+	std::remove(strFileName.c_str());
+	FileIoEngineCfg_st cfg;
+	cfg.m_nWorkerCount = 2;
+	CFileIoEngine engine;
+	REQUIRE(engine.Start(cfg));
+	FakeStrand_st strand;
+
+	REQUIRE(engine.Open(1, strFileName, FILE_OPEN_MODE::OPEN_WRITE));
+	CHECK(engine.FileName(1) == strFileName);
+	//已经存在的文件不能按新文件打开
+	CHECK_FALSE(engine.Open(2, strFileName, FILE_OPEN_MODE::OPEN_WRITE));
+
+	//数据包乱序写入
+	std::vector<int> doneVec;
+	const std::string strChunk[3] = { "aaaa", "bbbb", "cc" };
+	for (const int nIndex : { 3, 1, 2 })
+	{
+		std::vector<char> dataVec(strChunk[nIndex - 1].begin(), strChunk[nIndex - 1].end());
+		CHECK(engine.WriteAt(1, (nIndex - 1) * 4, std::move(dataVec), strand, [&doneVec, nIndex](bool bOk) {
+			CHECK(bOk);
+			doneVec.push_back(nIndex);
+		}));
+	}
+	//关闭以后投递的操作在之前的写入完成以后执行
+	CHECK(engine.Close(1));
+	CHECK_FALSE(engine.IsOpen(1));
+	CHECK_FALSE(engine.WriteAt(1, 0, std::vector<char>(1, 'x'), strand, [](bool) {}));
+	std::string strContent;
+	engine.Post(1, [strFileName]() {
+		std::string strData;
+		std::FILE* pFile = std::fopen(strFileName.c_str(), "rb");
+		if (nullptr != pFile)
+		{
+			char buff[16] = { 0 };
+			strData.assign(buff, std::fread(buff, 1, sizeof(buff), pFile));
+			std::fclose(pFile);
+		}
+		return strData;
+	}, strand, [&strContent](const std::string& strData) {
+		strContent = strData;
+	});
+	engine.Stop();
+	CHECK_EQ(4u, strand.RunAll());
+	//同一个文件的回调按投递顺序执行
+	CHECK(doneVec == std::vector<int>({ 3, 1, 2 }));
+	CHECK(strContent == "aaaabbbbcc");
+
+	auto stat = engine.Stat(true);
+	CHECK_EQ(4u, stat.m_nPostCount);
+	CHECK_EQ(4u, stat.m_nDoneCount);
+	CHECK_EQ(0u, stat.m_nFailCount);
+	CHECK_EQ(0u, stat.m_nOpenCount);
+	std::remove(strFileName.c_str());
+}
+
+TEST_CASE("FileIoEngineReadAt") {
+	const std::string strFileName = "FileIoEngine_Test.dat";
+	std::remove(strFileName.c_str());
+	//没有工作线程时在调用线程上读写,回调仍然投递到strand
+	CFileIoEngine engine;
+	CHECK_FALSE(engine.Start(FileIoEngineCfg_st{ 0, 100 }));
+	FakeStrand_st strand;
+
+	REQUIRE(engine.Open(1, strFileName, FILE_OPEN_MODE::OPEN_RESUME));
+	bool bWrite = false;
+	CHECK(engine.WriteAt(1, 0, std::vector<char>({ '1', '2', '3', '4', '5' }), strand, [&bWrite](bool bOk) { bWrite = bOk; }));
+	CHECK_FALSE(bWrite);
+	CHECK_EQ(1u, strand.RunAll());
+	CHECK(bWrite);
+	CHECK(engine.Close(1));
+
+	//续传时保留已有的内容
+	REQUIRE(engine.Open(2, strFileName, FILE_OPEN_MODE::OPEN_RESUME));
+	CHECK(engine.WriteAt(2, 4, std::vector<char>({ 'x', 'y' }), strand, [](bool bOk) { CHECK(bOk); }));
+	engine.Close(2);
+
+	REQUIRE(engine.Open(3, strFileName, FILE_OPEN_MODE::OPEN_READ));
+	std::string strLast;
+	bool bEnd = true;
+	CHECK(engine.ReadAt(3, 3, 4, strand, [&strLast](bool bOk, std::vector<char>& dataVec) {
+		CHECK(bOk);
+		strLast.assign(dataVec.begin(), dataVec.end());
+	}));
+	CHECK(engine.ReadAt(3, 6, 4, strand, [&bEnd](bool bOk, std::vector<char>& dataVec) {
+		bEnd = bOk;
+		CHECK(dataVec.empty());
+	}));
+	engine.Close(3);
+	CHECK_EQ(3u, strand.RunAll());
+	CHECK(strLast == "4xy");
+	//文件末尾没有数据
+	CHECK_FALSE(bEnd);
+	CHECK_FALSE(engine.Open(4, "NoSuchDir/FileIoEngine_Test.dat", FILE_OPEN_MODE::OPEN_READ));
+	CHECK_EQ(1u, engine.Stat().m_nFailCount);
+	std::remove(strFileName.c_str());
+}
+
+TEST_CASE("FileIoEngineQueryThrow") {
+	FileIoEngineCfg_st cfg;
+	cfg.m_nWorkerCount = 1;
+	CFileIoEngine engine;
+	REQUIRE(engine.Start(cfg));
+	FakeStrand_st strand;
+
+	//抛出异常的操作也会回调,结果为默认值
+	std::vector<std::string> resultVec;
+	engine.Post(1, []() -> std::string {
+		throw std::runtime_error("disk error");
+	}, strand, [&resultVec](const std::string& strResult) {
+		resultVec.push_back(strResult);
+	});
+	engine.Post(1, []() {
+		return std::string("ok");
+	}, strand, [&resultVec](const std::string& strResult) {
+		resultVec.push_back(strResult);
+	});
+	engine.Stop();
+	CHECK_EQ(2u, strand.RunAll());
+	REQUIRE_EQ(2u, resultVec.size());
+	CHECK(resultVec[0].empty());
+	CHECK(resultVec[1] == "ok");
+	CHECK_EQ(1u, engine.Stat().m_nFailCount);
+}
+
+#ifdef __linux__
+TEST_CASE("FileIoEngineSendTo") {
+	const std::string strFileName = "FileIoEngine_Test.dat";
+	std::remove(strFileName.c_str());
+	CFileIoEngine engine;
+	FakeStrand_st strand;
+	engine.Start(FileIoEngineCfg_st{ 0, 100 });
+	REQUIRE(engine.Open(1, strFileName, FILE_OPEN_MODE::OPEN_WRITE));
+	engine.WriteAt(1, 0, std::vector<char>({ 'a', 'b', 'c', 'd', 'e', 'f' }), strand, [](bool bOk) { CHECK(bOk); });
+	engine.Close(1);
+	REQUIRE(engine.Open(2, strFileName, FILE_OPEN_MODE::OPEN_READ));
+	auto pFile = engine.FindFile(2);
+	REQUIRE(pFile);
+	CHECK_FALSE(engine.FindFile(1));
+
+	int sockArray[2] = { -1, -1 };
+	REQUIRE_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockArray));
+	//文件数据直接写入socket,读取位置向后移动
+	int64_t nOffset = 2;
+	CHECK_EQ(3, pFile->SendTo(sockArray[0], nOffset, 3));
+	CHECK_EQ(5, nOffset);
+	CHECK_EQ(1, pFile->SendTo(sockArray[0], nOffset, 3));
+	CHECK_EQ(0, pFile->SendTo(sockArray[0], nOffset, 3));
+	char buff[8] = { 0 };
+	CHECK_EQ(4, read(sockArray[1], buff, sizeof(buff)));
+	CHECK(std::string(buff) == "cdef");
+	close(sockArray[0]);
+	close(sockArray[1]);
+	engine.Close(2);
+	std::remove(strFileName.c_str());
+}
+#endif
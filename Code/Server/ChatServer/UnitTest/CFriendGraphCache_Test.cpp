@@ -0,0 +1,49 @@
+#include <doctest/doctest.h>
+#include "CFriendGraphCache.h"
+
+TEST_CASE("FriendGraphCacheGetPut") {
+	CFriendGraphCache cache(10);
+	std::vector<FriendEdge_st> edgeVec;
+	CHECK_FALSE(cache.Get("10001", edgeVec));
+	cache.Put("10001", { { "10002","1000" }, { "10003","2000" } });
+	REQUIRE(cache.Get("10001", edgeVec));
+	REQUIRE_EQ(2u, edgeVec.size());
+	CHECK_EQ("10003", edgeVec[1].m_strFriendId);
+	CHECK_EQ("2000", edgeVec[1].m_strTeamId);
+
+	//好友关系改变以后重新查询
+	cache.Invalidate("10001");
+	CHECK_FALSE(cache.Get("10001", edgeVec));
+
+	//没有好友的用户也缓存
+	cache.Put("10004", {});
+	CHECK(cache.Get("10004", edgeVec));
+	CHECK(edgeVec.empty());
+
+	auto stat = cache.Stat(true);
+	CHECK_EQ(2u, stat.m_nHitCount);
+	CHECK_EQ(2u, stat.m_nMissCount);
+	CHECK_EQ(1u, stat.m_nSize);
+	CHECK_EQ(0u, cache.Stat().m_nHitCount);
+}
+
+TEST_CASE("FriendGraphCacheEvict") {
+	CFriendGraphCache cache(2);
+	std::vector<FriendEdge_st> edgeVec;
+	cache.Put("10001", { { "10002","1000" } });
+	cache.Put("10002", { { "10001","1000" } });
+	//10001最近使用过,淘汰10002
+	CHECK(cache.Get("10001", edgeVec));
+	cache.Put("10003", {});
+	CHECK_EQ(2u, cache.Size());
+	CHECK(cache.Get("10001", edgeVec));
+	CHECK_FALSE(cache.Get("10002", edgeVec));
+	CHECK(cache.Get("10003", edgeVec));
+	CHECK_EQ(1u, cache.Stat().m_nEvictCount);
+
+	//容量为0时不缓存
+	cache.SetCapacity(0);
+	CHECK_EQ(0u, cache.Size());
+	cache.Put("10001", {});
+	CHECK_FALSE(cache.Get("10001", edgeVec));
+}
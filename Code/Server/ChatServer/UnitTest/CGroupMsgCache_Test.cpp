@@ -0,0 +1,78 @@
+#include <doctest/doctest.h>
+#include "../MediumServer/CGroupMsgCache.h"
+
+static T_GROUP_CHAT_MSG GroupMsg(const std::string& strGroupId, const std::string& strMsgId)
+{
+	T_GROUP_CHAT_MSG msg;
+	msg.m_strF_GROUP_ID = strGroupId;
+	msg.m_strF_MSG_ID = strMsgId;
+	msg.m_eChatMsgType = CHAT_MSG_TYPE::E_CHAT_TEXT_TYPE;
+	msg.m_strF_SENDER_ID = "10001";
+	msg.m_strF_MSG_CONTEXT = "Msg" + strMsgId;
+	return msg;
+}
+
+TEST_CASE("GroupMsgCacheGetAfter") {
+	CGroupMsgCache cache(3);
+	std::vector<T_GROUP_CHAT_MSG> msgVec;
+	CHECK_FALSE(cache.GetAfter("20001", "00000000", 10, msgVec));
+
+	cache.Append(GroupMsg("20001", "1001"));
+	cache.Append(GroupMsg("20001", "1003"));
+	//乱序入库的消息插入到对应位置
+	cache.Append(GroupMsg("20001", "1002"));
+
+	REQUIRE(cache.GetAfter("20001", "1001", 10, msgVec));
+	REQUIRE_EQ(2u, msgVec.size());
+	CHECK_EQ("1002", msgVec[0].m_strF_MSG_ID);
+	CHECK_EQ("1003", msgVec[1].m_strF_MSG_ID);
+
+	REQUIRE(cache.GetAfter("20001", "1001", 1, msgVec));
+	REQUIRE_EQ(1u, msgVec.size());
+	CHECK_EQ("1002", msgVec[0].m_strF_MSG_ID);
+
+	//已经读到最新的消息
+	CHECK(cache.GetAfter("20001", "1003", 10, msgVec));
+	CHECK(msgVec.empty());
+
+	//超过条数丢弃最早的消息,更早的读取位置需要查询数据库
+	cache.Append(GroupMsg("20001", "1004"));
+	CHECK_FALSE(cache.GetAfter("20001", "1001", 10, msgVec));
+	CHECK_FALSE(cache.GetAfter("20001", "00000000", 10, msgVec));
+	CHECK(cache.GetAfter("20001", "1002", 10, msgVec));
+	CHECK_EQ(2u, msgVec.size());
+
+	auto stat = cache.Stat(true);
+	CHECK_EQ(1u, stat.m_nGroupCount);
+	CHECK_EQ(3u, stat.m_nMsgCount);
+	CHECK_EQ(4u, stat.m_nHitCount);
+	CHECK_EQ(3u, stat.m_nMissCount);
+
+	cache.Invalidate("20001");
+	CHECK_FALSE(cache.GetAfter("20001", "1003", 10, msgVec));
+	CHECK_EQ(0u, cache.Stat().m_nMsgCount);
+}
+
+TEST_CASE("GroupMsgCacheEvict") {
+	CGroupMsgCache cache(2, 2);
+	std::vector<T_GROUP_CHAT_MSG> msgVec;
+	cache.Append(GroupMsg("20001", "1001"));
+	cache.Append(GroupMsg("20002", "1002"));
+	cache.Append(GroupMsg("20001", "1003"));
+	//20002最久没有消息,被淘汰
+	cache.Append(GroupMsg("20003", "1004"));
+	CHECK(cache.GetAfter("20001", "1001", 10, msgVec));
+	CHECK_FALSE(cache.GetAfter("20002", "1002", 10, msgVec));
+	CHECK(cache.GetAfter("20003", "1004", 10, msgVec));
+	CHECK_EQ(3u, cache.Stat().m_nMsgCount);
+
+	CHECK(CGroupMsgCache::MsgIdLess("99", "100"));
+	CHECK_FALSE(CGroupMsgCache::MsgIdLess("100", "100"));
+	CHECK(CGroupMsgCache::MsgIdLess("00000000", "1"));
+	CHECK_FALSE(CGroupMsgCache::MsgIdLess("0100", "99"));
+
+	//条数为0时不缓存
+	cache.SetRingSize(0);
+	cache.Append(GroupMsg("20001", "1005"));
+	CHECK_FALSE(cache.GetAfter("20001", "1005", 10, msgVec));
+}
@@ -0,0 +1,39 @@
+#include <doctest/doctest.h>
+#include "CLogSampler.h"
+#include "Log.h"
+
+TEST_CASE("LogSamplerMode") {
+	KeepAliveReqMsg reqMsg("10001");
+	TransBaseMsg_t transMsg(reqMsg, false);
+
+	CLogSampler::SetMode(E_PAYLOAD_LOG::ALL, 0);
+	CHECK_EQ(transMsg.ToPrintString(), CLogSampler::Payload(transMsg));
+
+	CLogSampler::SetMode(E_PAYLOAD_LOG::NONE, 1);
+	CHECK_EQ("LEN:" + std::to_string(transMsg.GetSize()), CLogSampler::Payload(transMsg));
+
+	//每4条输出一次内容
+	CLogSampler::SetMode(E_PAYLOAD_LOG::SAMPLE, 4);
+	int nLogCount = 0;
+	for (int i = 0; i < 100; i++)
+	{
+		if (CLogSampler::ShouldLogPayload())
+		{
+			nLogCount++;
+		}
+	}
+	CHECK_EQ(25, nLogCount);
+
+	E_PAYLOAD_LOG mode = E_PAYLOAD_LOG::ALL;
+	CHECK(ParsePayloadLogMode("sample", mode));
+	CHECK_EQ(E_PAYLOAD_LOG::SAMPLE, mode);
+	CHECK_FALSE(ParsePayloadLogMode("some", mode));
+	CHECK_EQ("sample", PayloadLogModeName(mode));
+	CLogSampler::SetMode(E_PAYLOAD_LOG::ALL, 1);
+}
+
+TEST_CASE("LogFileName") {
+	CHECK_EQ(std::string("CLogSampler_Test.cpp"), std::string(__FILENAME__));
+	CHECK_EQ(4u, LogBaseNameOffset("a/b\\c"));
+	CHECK_EQ(0u, LogBaseNameOffset("abc"));
+}
@@ -0,0 +1,88 @@
+#include <doctest/doctest.h>
+#include "CMsgDispatcher.h"
+
+TEST_CASE("MsgDispatcherRegister") {
+	CMsgDispatcher<int&> dispatcher;
+	std::string strClientId;
+	dispatcher.Register<KeepAliveReqMsg>(E_MsgType::KeepAliveReq_Type, [&strClientId](int& nCount, const KeepAliveReqMsg& msg) {
+		nCount++;
+		strClientId = msg.m_strClientId;
+	});
+	CHECK(dispatcher.HasHandler(E_MsgType::KeepAliveReq_Type));
+	CHECK_FALSE(dispatcher.HasHandler(E_MsgType::KeepAliveRsp_Type));
+
+	int nCount = 0;
+	//json编码和二进制编码的消息使用同一个处理函数
+	KeepAliveReqMsg reqMsg("10001");
+	CHECK_EQ(E_DISPATCH_RESULT::HANDLED, dispatcher.Dispatch(TransBaseMsg_t(reqMsg, false), nCount));
+	CHECK_EQ("10001", strClientId);
+	reqMsg.m_strClientId = "10002";
+	CHECK_EQ(E_DISPATCH_RESULT::HANDLED, dispatcher.Dispatch(TransBaseMsg_t(reqMsg, true), nCount));
+	CHECK_EQ("10002", strClientId);
+	CHECK_EQ(2, nCount);
+
+	KeepAliveRspMsg rspMsg("10001");
+	CHECK_EQ(E_DISPATCH_RESULT::NO_HANDLER, dispatcher.Dispatch(TransBaseMsg_t(rspMsg, false), nCount));
+	CHECK_EQ(2, nCount);
+
+	//解码失败时不调用处理函数
+	CHECK_EQ(E_DISPATCH_RESULT::DECODE_FAILED, dispatcher.Dispatch(TransBaseMsg_t(E_MsgType::KeepAliveReq_Type, "{"), nCount));
+	CHECK_EQ(2, nCount);
+
+	int nVisit = 0;
+	dispatcher.VisitStat([&nVisit](const E_MsgType type, const MsgDispatchStat_st& stat) {
+		nVisit++;
+		CHECK_EQ(E_MsgType::KeepAliveReq_Type, type);
+		CHECK_EQ(3u, stat.m_nCount);
+		CHECK_EQ(1u, stat.m_nDecodeFailed);
+	}, true);
+	CHECK_EQ(1, nVisit);
+	dispatcher.VisitStat([&nVisit](const E_MsgType, const MsgDispatchStat_st&) {
+		nVisit++;
+	});
+	CHECK_EQ(1, nVisit);
+}
+
+TEST_CASE("MsgDispatcherRaw") {
+	CMsgDispatcher<> dispatcher;
+	E_MsgType recvType = E_MsgType::Base_Type;
+	dispatcher.RegisterRaw(E_MsgType::NetFailedReport_Type, [&recvType](const TransBaseMsg_t& msg) {
+		recvType = msg.GetType();
+	});
+	NetFailedReportMsg reportMsg;
+	CHECK_EQ(E_DISPATCH_RESULT::HANDLED, dispatcher.Dispatch(TransBaseMsg_t(reportMsg.GetMsgType(), reportMsg.ToString())));
+	CHECK_EQ(E_MsgType::NetFailedReport_Type, recvType);
+}
+
+TEST_CASE("MsgDispatchStatHistogram") {
+	MsgDispatchStat_st stat;
+	CHECK_EQ(0u, stat.PercentileUs(99));
+	for (int i = 0; i < 98; i++)
+	{
+		stat.Record(3);
+	}
+	stat.Record(100);
+	stat.Record(5000000);
+	CHECK_EQ(100u, stat.m_nCount);
+	CHECK_EQ(5000000u, stat.m_nMaxUs);
+	//3微秒落在[2,4)的桶
+	CHECK_EQ(4u, stat.PercentileUs(50));
+	CHECK_EQ(128u, stat.PercentileUs(99));
+	CHECK_EQ(5000000u, stat.PercentileUs(100));
+}
+
+TEST_CASE("MsgDispatchStatMerge") {
+	MsgDispatchStat_st stat;
+	stat.Record(3);
+	stat.m_nDecodeFailed = 1;
+	MsgDispatchStat_st other;
+	other.Record(3);
+	other.Record(100);
+	stat.Merge(other);
+	CHECK_EQ(3u, stat.m_nCount);
+	CHECK_EQ(1u, stat.m_nDecodeFailed);
+	CHECK_EQ(106u, stat.m_nTotalUs);
+	CHECK_EQ(100u, stat.m_nMaxUs);
+	CHECK_EQ(4u, stat.PercentileUs(50));
+	CHECK_EQ(100u, stat.PercentileUs(100));
+}
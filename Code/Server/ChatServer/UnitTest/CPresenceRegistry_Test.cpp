@@ -0,0 +1,126 @@
+#include <doctest/doctest.h>
+#include <algorithm>
+#include "../MediumServer/CPresenceRegistry.h"
+
+TEST_CASE("PresenceUserKey") {
+	uint64_t nKey = 0;
+	REQUIRE(CPresenceRegistry::UserKey("20001", nKey));
+	CHECK_EQ(20001u, nKey);
+	REQUIRE(CPresenceRegistry::UserKey("0", nKey));
+	CHECK_EQ(0u, nKey);
+	REQUIRE(CPresenceRegistry::UserKey("999999999999999999", nKey));
+	CHECK_EQ(999999999999999999ULL, nKey);
+	CHECK_FALSE(CPresenceRegistry::UserKey("", nKey));
+	CHECK_FALSE(CPresenceRegistry::UserKey("012", nKey));
+	CHECK_FALSE(CPresenceRegistry::UserKey("12a", nKey));
+	CHECK_FALSE(CPresenceRegistry::UserKey("1000000000000000000", nKey));
+}
+
+TEST_CASE("PresenceRegistry") {
+	CPresenceRegistry registry(4);
+	CHECK(nullptr == registry.Find("20001"));
+	CHECK_FALSE(registry.GetSess("20001"));
+
+	UserPresence_st& user = registry.Insert("20001");
+	CHECK_EQ("20001", user.m_strUserId);
+	CHECK(CLIENT_SESS_STATE::SESS_IDLE_STATE == user.m_eState);
+	CHECK(user.IsEmpty());
+	user.m_bHasUdpAddr = true;
+	user.m_udpAddr.m_strServerIp = "127.0.0.1";
+	user.m_udpAddr.m_nPort = 9000;
+
+	//有前导0和不是数字的ID是不同的用户
+	registry.Insert("020001").m_eState = CLIENT_SESS_STATE::SESS_WAIT_RECV_MSG_RSP;
+	registry.Insert("Guest").m_eState = CLIENT_SESS_STATE::SESS_RECV_MSG_FINISHED;
+	CHECK_EQ(3u, registry.Size());
+	CHECK(&user == registry.Find("20001"));
+	CHECK(CLIENT_SESS_STATE::SESS_IDLE_STATE == registry.Find("20001")->m_eState);
+	CHECK(CLIENT_SESS_STATE::SESS_WAIT_RECV_MSG_RSP == registry.Find("020001")->m_eState);
+	CHECK_EQ("Guest", registry.Find("Guest")->m_strUserId);
+
+	IpPortCfg udpAddr;
+	REQUIRE(registry.GetUdpAddr("20001", udpAddr));
+	CHECK_EQ("127.0.0.1", udpAddr.m_strServerIp);
+	CHECK_EQ(9000, udpAddr.m_nPort);
+	CHECK_FALSE(registry.GetUdpAddr("Guest", udpAddr));
+
+	//其他记录的插入不影响已经取得的指针
+	for (int i = 0; i < 1000; i++)
+	{
+		registry.Insert(std::to_string(30000 + i));
+	}
+	CHECK(&user == registry.Find("20001"));
+	CHECK_FALSE(registry.SetShardCount(8));
+	PresenceStat_st stat = registry.Stat();
+	CHECK_EQ(1003u, stat.m_nUsers);
+	CHECK_EQ(0u, stat.m_nOnline);
+	CHECK(stat.m_nMaxShard < 300u);
+
+	std::size_t nCount = 0;
+	registry.ForEach([&nCount](UserPresence_st&) { nCount++; });
+	CHECK_EQ(1003u, nCount);
+
+	//还有UDP地址的记录不删除
+	registry.Release("20001");
+	REQUIRE(registry.Find("20001") != nullptr);
+	registry.Find("20001")->m_bHasUdpAddr = false;
+	registry.Release("20001");
+	CHECK(nullptr == registry.Find("20001"));
+	registry.Remove("Guest");
+	CHECK(nullptr == registry.Find("Guest"));
+	CHECK_EQ(1001u, registry.Size());
+}
+
+TEST_CASE("PresenceShard") {
+	CPresenceRegistry registry(4);
+	//数字ID按整数取模,其他ID按字符串哈希
+	CHECK_EQ(1u, registry.ShardIndex("20001"));
+	CHECK_EQ(2u, registry.ShardIndex("20002"));
+	CHECK(registry.ShardIndex("Guest") < 4u);
+	CHECK_EQ(registry.ShardIndex("Guest"), registry.ShardIndex("Guest"));
+
+	UserPresence_st& user = registry.Insert("20001");
+	registry.Insert("20005");
+	registry.Insert("20002");
+	IpPortCfg udpAddr;
+	udpAddr.m_strServerIp = "127.0.0.1";
+	udpAddr.m_nPort = 9000;
+	registry.SetUdpAddr(user, true, udpAddr);
+	IpPortCfg result;
+	REQUIRE(registry.GetUdpAddr("20001", result));
+	CHECK_EQ(9000, result.m_nPort);
+	registry.SetUdpAddr(user, false);
+	CHECK_FALSE(registry.GetUdpAddr("20001", result));
+	CHECK(user.IsEmpty());
+
+	//只遍历一个分片
+	std::vector<std::string> userIdVec;
+	registry.ForEach(1, [&userIdVec](UserPresence_st& item) { userIdVec.push_back(item.m_strUserId); });
+	std::sort(userIdVec.begin(), userIdVec.end());
+	REQUIRE_EQ(2u, userIdVec.size());
+	CHECK_EQ("20001", userIdVec[0]);
+	CHECK_EQ("20005", userIdVec[1]);
+}
+
+TEST_CASE("PresenceGroupState") {
+	UserPresence_st user;
+	CHECK(nullptr == user.FindGroup("10001"));
+	GroupPresence_st& group = user.InsertGroup("10001");
+	group.m_eState = CLIENT_SESS_STATE::SESS_GROUP_MSG_SEND_RECV_STATE;
+	group.m_bBatchPending = true;
+	group.m_strBatchLastId = "1234";
+	user.InsertGroup("10002");
+	CHECK_EQ(2u, user.m_groupVec.size());
+	CHECK_FALSE(user.IsEmpty());
+
+	//再次插入返回已有的状态
+	CHECK(user.InsertGroup("10001").m_bBatchPending);
+	CHECK_EQ(2u, user.m_groupVec.size());
+	REQUIRE(user.FindGroup("10001") != nullptr);
+	CHECK_EQ("1234", user.FindGroup("10001")->m_strBatchLastId);
+
+	user.RemoveGroup("10001");
+	CHECK(nullptr == user.FindGroup("10001"));
+	user.RemoveGroup("10002");
+	CHECK(user.IsEmpty());
+}
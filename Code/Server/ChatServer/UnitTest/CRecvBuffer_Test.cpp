@@ -0,0 +1,83 @@
+#include <doctest/doctest.h>
+#include "CRecvBuffer.h"
+
+//模拟socket接收,每次最多写入nStep字节
+static void RecvData(CRecvBuffer& recvBuf, const std::string& strData, const std::size_t nStep, std::vector<TransBaseMsg_S_PTR>& msgVec)
+{
+	std::size_t nPos = 0;
+	while (nPos < strData.length())
+	{
+		char* pWrite = recvBuf.PrepareWrite();
+		std::size_t nLength = std::min(std::min(nStep, recvBuf.WritableSize()), strData.length() - nPos);
+		memcpy(pWrite, strData.data() + nPos, nLength);
+		recvBuf.CommitWrite(nLength);
+		nPos += nLength;
+		auto pMsg = recvBuf.NextMsg();
+		while (pMsg)
+		{
+			msgVec.push_back(pMsg);
+			pMsg = recvBuf.NextMsg();
+		}
+	}
+}
+
+TEST_CASE("RecvBufferSmallMsgBurst") {
+	CRecvBuffer recvBuf;
+	std::string strData;
+	for (int i = 0; i < 1000; i++)
+	{
+		KeepAliveReqMsg reqMsg(std::to_string(i));
+		TransBaseMsg_t transMsg(reqMsg, false);
+		strData.append(transMsg.GetData(), transMsg.GetSize());
+	}
+	std::vector<TransBaseMsg_S_PTR> msgVec;
+	RecvData(recvBuf, strData, 4096, msgVec);
+	REQUIRE_EQ(1000u, msgVec.size());
+	for (int i = 0; i < 1000; i++)
+	{
+		KeepAliveReqMsg parseMsg("");
+		CHECK(msgVec[i]->DecodeMsg(parseMsg));
+		CHECK_EQ(std::to_string(i), parseMsg.m_strClientId);
+	}
+	CHECK_EQ(0u, recvBuf.ReadableSize());
+	CHECK_FALSE(recvBuf.HasError());
+}
+
+TEST_CASE("RecvBufferLargeMsg") {
+	CRecvBuffer recvBuf;
+	FileDataSendReqMsg reqMsg;
+	reqMsg.m_strMsgId = "1234567890";
+	reqMsg.m_nChunkSize = FILE_DATA_TCP_CHUNK_SIZE;
+	reqMsg.m_nDataLength = FILE_DATA_TCP_CHUNK_SIZE;
+	reqMsg.m_dataVec.assign(FILE_DATA_TCP_CHUNK_SIZE, 'y');
+	TransBaseMsg_t transMsg(reqMsg, true);
+	KeepAliveReqMsg aliveMsg("10001");
+	TransBaseMsg_t aliveTransMsg(aliveMsg, false);
+
+	std::string strData(aliveTransMsg.GetData(), aliveTransMsg.GetSize());
+	strData.append(transMsg.GetData(), transMsg.GetSize());
+	strData.append(aliveTransMsg.GetData(), aliveTransMsg.GetSize());
+
+	std::vector<TransBaseMsg_S_PTR> msgVec;
+	RecvData(recvBuf, strData, 1500, msgVec);
+	REQUIRE_EQ(3u, msgVec.size());
+	CHECK_EQ(transMsg.GetSize(), msgVec[1]->GetSize());
+	FileDataSendReqMsg parseMsg;
+	CHECK(msgVec[1]->DecodeMsg(parseMsg));
+	CHECK(reqMsg.m_dataVec == parseMsg.m_dataVec);
+	//已经取出的消息在缓冲区更换数据块以后仍然有效
+	CHECK_EQ(aliveTransMsg.to_string(), msgVec[0]->to_string());
+	CHECK_EQ(aliveTransMsg.to_string(), msgVec[2]->to_string());
+}
+
+TEST_CASE("RecvBufferInvalidHead") {
+	CRecvBuffer recvBuf;
+	Header head;
+	head.m_type = static_cast<int32_t>(E_MsgType::KeepAliveReq_Type);
+	head.m_length = MSG_MAX_FRAME_SIZE + 1;
+	char* pWrite = recvBuf.PrepareWrite();
+	memcpy(pWrite, &head, sizeof(head));
+	recvBuf.CommitWrite(sizeof(head));
+	CHECK_FALSE(recvBuf.NextMsg());
+	CHECK(recvBuf.HasError());
+}
@@ -0,0 +1,174 @@
+#include <doctest/doctest.h>
+#include "CSendQueue.h"
+
+static TransBaseMsg_S_PTR MakeKeepAliveMsg(const int nIndex)
+{
+	KeepAliveReqMsg reqMsg(std::to_string(nIndex));
+	return std::make_shared<TransBaseMsg_t>(reqMsg, false);
+}
+
+TEST_CASE("SendQueueBatchInOrder") {
+	CSendQueue sendQueue;
+	CHECK_EQ(E_SEND_QUEUE_PUSH::START_SEND, sendQueue.Push(MakeKeepAliveMsg(0)));
+	for (int i = 1; i < 100; i++)
+	{
+		//已经在发送,不需要重新开始
+		CHECK_EQ(E_SEND_QUEUE_PUSH::QUEUED, sendQueue.Push(MakeKeepAliveMsg(i)));
+	}
+	CHECK_EQ(100u, sendQueue.Size());
+
+	int nIndex = 0;
+	std::vector<std::size_t> batchSizeVec;
+	auto pBatch = sendQueue.NextBatch();
+	while (pBatch)
+	{
+		CHECK(sendQueue.IsSending());
+		batchSizeVec.push_back(pBatch->size());
+		for (const auto& pMsg : *pBatch)
+		{
+			KeepAliveReqMsg parseMsg("");
+			CHECK(pMsg->DecodeMsg(parseMsg));
+			CHECK_EQ(std::to_string(nIndex), parseMsg.m_strClientId);
+			nIndex++;
+		}
+		pBatch = sendQueue.NextBatch();
+	}
+	CHECK_EQ(100, nIndex);
+	REQUIRE_EQ(2u, batchSizeVec.size());
+	CHECK_EQ(64u, batchSizeVec[0]);
+	CHECK_EQ(36u, batchSizeVec[1]);
+	CHECK_FALSE(sendQueue.IsSending());
+	CHECK_EQ(0u, sendQueue.Bytes());
+	//发送结束以后新的消息需要重新开始发送
+	CHECK_EQ(E_SEND_QUEUE_PUSH::START_SEND, sendQueue.Push(MakeKeepAliveMsg(100)));
+}
+
+TEST_CASE("SendQueueBatchBytes") {
+	auto pSmallMsg = MakeKeepAliveMsg(1);
+	FileDataSendReqMsg reqMsg;
+	reqMsg.m_nChunkSize = FILE_DATA_TCP_CHUNK_SIZE;
+	reqMsg.m_nDataLength = FILE_DATA_TCP_CHUNK_SIZE;
+	reqMsg.m_dataVec.assign(FILE_DATA_TCP_CHUNK_SIZE, 'x');
+	auto pLargeMsg = std::make_shared<TransBaseMsg_t>(reqMsg, true);
+
+	SendQueueCfg_st cfg;
+	cfg.m_nBatchBytes = 4096;
+	CSendQueue sendQueue(cfg);
+	sendQueue.Push(pSmallMsg);
+	sendQueue.Push(pLargeMsg);
+	sendQueue.Push(pSmallMsg);
+	CHECK_EQ(pSmallMsg->GetSize() * 2 + pLargeMsg->GetSize(), sendQueue.Bytes());
+
+	//超过字节数限制的消息单独成为一批
+	auto pBatch = sendQueue.NextBatch();
+	REQUIRE(pBatch);
+	CHECK_EQ(1u, pBatch->size());
+	pBatch = sendQueue.NextBatch();
+	REQUIRE(pBatch);
+	REQUIRE_EQ(1u, pBatch->size());
+	CHECK_EQ(pLargeMsg, pBatch->front());
+	pBatch = sendQueue.NextBatch();
+	REQUIRE(pBatch);
+	CHECK_EQ(1u, pBatch->size());
+	CHECK_FALSE(sendQueue.NextBatch());
+}
+
+TEST_CASE("SendQueueClear") {
+	CSendQueue sendQueue;
+	CHECK_EQ(E_SEND_QUEUE_PUSH::START_SEND, sendQueue.Push(MakeKeepAliveMsg(1)));
+	CHECK_EQ(E_SEND_QUEUE_PUSH::QUEUED, sendQueue.Push(MakeKeepAliveMsg(2)));
+	sendQueue.Clear();
+	CHECK_FALSE(sendQueue.IsSending());
+	CHECK_EQ(0u, sendQueue.Size());
+	CHECK_FALSE(sendQueue.NextBatch());
+	CHECK_EQ(E_SEND_QUEUE_PUSH::START_SEND, sendQueue.Push(MakeKeepAliveMsg(3)));
+}
+
+static TransBaseMsg_S_PTR MakeStateNotifyMsg(const std::string& strFriendId, const CLIENT_STATE state)
+{
+	FriendStateChangeNotifyReqMsg notifyMsg;
+	notifyMsg.m_strUserId = "10001";
+	notifyMsg.m_strFriendId = strFriendId;
+	notifyMsg.m_friendState = state;
+	return std::make_shared<TransBaseMsg_t>(notifyMsg, true);
+}
+
+static SendQueueCfg_st MakeWaterMarkCfg(const E_SEND_QUEUE_POLICY policy)
+{
+	SendQueueCfg_st cfg;
+	cfg.m_nHighCount = 10;
+	cfg.m_nLowCount = 2;
+	cfg.m_policy = policy;
+	return cfg;
+}
+
+TEST_CASE("SendQueueDropNotify") {
+	CSendQueue sendQueue(MakeWaterMarkCfg(E_SEND_QUEUE_POLICY::DROP_NOTIFY));
+	for (int i = 0; i < 10; i++)
+	{
+		sendQueue.Push(MakeKeepAliveMsg(i));
+	}
+	CHECK_FALSE(sendQueue.IsOverload());
+	//超过高水位以后通知被丢弃,普通消息继续排队
+	CHECK_EQ(E_SEND_QUEUE_PUSH::DROPPED, sendQueue.Push(MakeStateNotifyMsg("10002", CLIENT_STATE::C_STATE_OFFLINE)));
+	CHECK(sendQueue.IsOverload());
+	CHECK_EQ(E_SEND_QUEUE_PUSH::QUEUED, sendQueue.Push(MakeKeepAliveMsg(10)));
+	for (int i = 11; i < 20; i++)
+	{
+		CHECK_EQ(E_SEND_QUEUE_PUSH::QUEUED, sendQueue.Push(MakeKeepAliveMsg(i)));
+	}
+	//达到高水位的两倍时要求断开
+	CHECK_EQ(E_SEND_QUEUE_PUSH::OVERFLOW_CLOSE, sendQueue.Push(MakeKeepAliveMsg(20)));
+	auto stat = sendQueue.Stat();
+	CHECK_EQ(20u, stat.m_nQueueCount);
+	CHECK_EQ(1u, stat.m_nDropCount);
+	CHECK_EQ(1u, stat.m_nOverloadCount);
+
+	//回落到低水位以下恢复正常
+	CHECK(sendQueue.NextBatch());
+	CHECK_FALSE(sendQueue.IsOverload());
+	CHECK_EQ(E_SEND_QUEUE_PUSH::QUEUED, sendQueue.Push(MakeStateNotifyMsg("10002", CLIENT_STATE::C_STATE_ONLINE)));
+}
+
+TEST_CASE("SendQueueCoalesceNotify") {
+	CSendQueue sendQueue(MakeWaterMarkCfg(E_SEND_QUEUE_POLICY::COALESCE_NOTIFY));
+	sendQueue.Push(MakeStateNotifyMsg("10002", CLIENT_STATE::C_STATE_ONLINE));
+	sendQueue.Push(MakeStateNotifyMsg("10003", CLIENT_STATE::C_STATE_ONLINE));
+	for (int i = 0; i < 8; i++)
+	{
+		sendQueue.Push(MakeKeepAliveMsg(i));
+	}
+	//同一个好友的状态只保留最新的一条,位置不变
+	CHECK_EQ(E_SEND_QUEUE_PUSH::COALESCED, sendQueue.Push(MakeStateNotifyMsg("10002", CLIENT_STATE::C_STATE_OFFLINE)));
+	CHECK_EQ(E_SEND_QUEUE_PUSH::QUEUED, sendQueue.Push(MakeStateNotifyMsg("10004", CLIENT_STATE::C_STATE_ONLINE)));
+	CHECK_EQ(E_SEND_QUEUE_PUSH::COALESCED, sendQueue.Push(MakeStateNotifyMsg("10004", CLIENT_STATE::C_STATE_OFFLINE)));
+	CHECK_EQ(11u, sendQueue.Size());
+	CHECK_EQ(2u, sendQueue.Stat().m_nCoalesceCount);
+
+	auto pBatch = sendQueue.NextBatch();
+	REQUIRE(pBatch);
+	REQUIRE_EQ(11u, pBatch->size());
+	FriendStateChangeNotifyReqMsg notifyMsg;
+	CHECK(pBatch->front()->DecodeMsg(notifyMsg));
+	CHECK_EQ("10002", notifyMsg.m_strFriendId);
+	CHECK_EQ(CLIENT_STATE::C_STATE_OFFLINE, notifyMsg.m_friendState);
+	CHECK(pBatch->back()->DecodeMsg(notifyMsg));
+	CHECK_EQ("10004", notifyMsg.m_strFriendId);
+	CHECK_EQ(CLIENT_STATE::C_STATE_OFFLINE, notifyMsg.m_friendState);
+}
+
+TEST_CASE("SendQueueDisconnect") {
+	CSendQueue sendQueue(MakeWaterMarkCfg(E_SEND_QUEUE_POLICY::DISCONNECT));
+	for (int i = 0; i < 10; i++)
+	{
+		sendQueue.Push(MakeKeepAliveMsg(i));
+	}
+	CHECK_EQ(E_SEND_QUEUE_PUSH::OVERFLOW_CLOSE, sendQueue.Push(MakeKeepAliveMsg(10)));
+	CHECK_EQ(10u, sendQueue.Size());
+
+	E_SEND_QUEUE_POLICY policy = E_SEND_QUEUE_POLICY::DROP_NOTIFY;
+	CHECK(ParseSendQueuePolicy("disconnect", policy));
+	CHECK_EQ(E_SEND_QUEUE_POLICY::DISCONNECT, policy);
+	CHECK_FALSE(ParseSendQueuePolicy("unknown", policy));
+	CHECK_EQ("disconnect", SendQueuePolicyName(policy));
+}
@@ -0,0 +1,38 @@
+#include <doctest/doctest.h>
+#include "CUnReadMsgWindow.h"
+
+TEST_CASE("UnReadMsgWindowSend") {
+	CUnReadMsgWindow window(3);
+	for (int i = 1; i <= 3; i++)
+	{
+		REQUIRE(window.CanSend());
+		window.OnSend(std::to_string(i));
+	}
+	CHECK_FALSE(window.CanSend());
+	CHECK_EQ(3, window.InFlightCount());
+
+	//不是本窗口发送的消息和重复的确认都忽略
+	CHECK_FALSE(window.OnAck("100"));
+	CHECK(window.OnAck("2"));
+	CHECK_FALSE(window.OnAck("2"));
+	CHECK(window.CanSend());
+	CHECK_FALSE(window.NeedFlush());
+
+	window.OnSend("4");
+	CHECK(window.OnAck("1"));
+	CHECK(window.OnAck("3"));
+	//确认的消息达到窗口大小
+	REQUIRE(window.NeedFlush());
+	auto ackedVec = window.TakeAcked();
+	REQUIRE_EQ(3u, ackedVec.size());
+	CHECK_EQ("2", ackedVec[0]);
+	CHECK_EQ("3", ackedVec[2]);
+	CHECK_FALSE(window.NeedFlush());
+	CHECK_FALSE(window.IsIdle());
+
+	//在途的消息全部确认以后更新剩下的消息
+	CHECK(window.OnAck("4"));
+	CHECK(window.NeedFlush());
+	CHECK_EQ(1u, window.TakeAcked().size());
+	CHECK(window.IsIdle());
+}
@@ -684,4 +684,358 @@ TEST_CASE("Encode"){
 	std::string strUtf82 = u8"你好nihao";
 	std::cout<<EncodeUtil::Utf8ToAnsi(strUtf82)<<"  "<<std::endl;
 	std::cout<<EncodeUtil::UnicodeToUtf8(EncodeUtil::Utf8ToUnicode(strUtf82))<<std::endl; 
-}
\ No newline at end of file
+}
+
+TEST_CASE("BinaryVarInt") {
+	CBinaryWriter writer;
+	writer.WriteVarUInt(0);
+	writer.WriteVarUInt(300);
+	writer.WriteVarInt(-1);
+	writer.WriteVarInt(-2147483647 - 1);
+	writer.WriteString("TinyIM");
+	CHECK_EQ(writer.Data().length(), 1 + 2 + 1 + 5 + 7);
+	CBinaryReader reader(writer.Data().c_str(), writer.Data().length());
+	uint64_t nUValue = 1;
+	int nValue = 0;
+	std::string strValue;
+	CHECK(reader.ReadVarUInt(nUValue));
+	CHECK_EQ(nUValue, 0);
+	CHECK(reader.ReadVarUInt(nUValue));
+	CHECK_EQ(nUValue, 300);
+	CHECK(reader.ReadInt(nValue));
+	CHECK_EQ(nValue, -1);
+	CHECK(reader.ReadInt(nValue));
+	CHECK_EQ(nValue, -2147483647 - 1);
+	CHECK(reader.ReadString(strValue));
+	CHECK_EQ(strValue, "TinyIM");
+	CHECK_FALSE(reader.ReadVarUInt(nUValue));
+}
+
+TEST_CASE("BinaryFriendChatSendTxtReqMsg") {
+	FriendChatSendTxtReqMsg reqMsg;
+	reqMsg.m_strMsgId = "1234567890";
+	reqMsg.m_strSenderId = "10001";
+	reqMsg.m_strReceiverId = "10002";
+	reqMsg.m_strContext = u8"你好 TinyIM";
+	reqMsg.m_fontInfo.m_strFontName = "Arial";
+	reqMsg.m_fontInfo.m_nFontSize = 12;
+	reqMsg.m_fontInfo.m_strFontColorHex = "000000";
+	reqMsg.m_fontInfo.m_nFontStyle = E_FONT_BOLD;
+	TransBaseMsg_t transMsg(reqMsg, true);
+	CHECK(transMsg.IsBinary());
+	CHECK_EQ(reqMsg.GetMsgType(), transMsg.GetType());
+	CHECK_LT(transMsg.GetSize(), reqMsg.ToString().length());
+	FriendChatSendTxtReqMsg parseMsg;
+	CHECK(transMsg.DecodeMsg(parseMsg));
+	CHECK_EQ(reqMsg.ToString(), parseMsg.ToString());
+
+	TransBaseMsg_t copyMsg(transMsg);
+	CHECK(copyMsg.IsBinary());
+	auto pJsonMsg = ToJsonTransMsg(copyMsg);
+	REQUIRE(pJsonMsg);
+	CHECK_FALSE(pJsonMsg->IsBinary());
+	CHECK_EQ(reqMsg.ToString(), pJsonMsg->to_string());
+}
+
+TEST_CASE("BinaryFileDataSendReqMsg") {
+	FileDataSendReqMsg reqMsg;
+	reqMsg.m_strMsgId = "1234567890";
+	reqMsg.m_strUserId = "10001";
+	reqMsg.m_strFriendId = "10002";
+	reqMsg.m_nFileId = 7;
+	reqMsg.m_nDataTotalCount = 3;
+	reqMsg.m_nDataIndex = 2;
+	reqMsg.m_nDataLength = FILE_DATA_CHUNK_SIZE;
+	for (int i = 0; i < FILE_DATA_CHUNK_SIZE; i++)
+	{
+		reqMsg.m_dataVec.push_back(static_cast<char>(i));
+	}
+	TransBaseMsg_t transMsg(reqMsg, true);
+	CHECK(transMsg.IsBinary());
+	CHECK_LT(transMsg.GetSize(), FILE_DATA_CHUNK_SIZE + 64);
+	FileDataSendReqMsg parseMsg;
+	CHECK(transMsg.DecodeMsg(parseMsg));
+	CHECK_EQ(reqMsg.ToString(), parseMsg.ToString());
+	CHECK(reqMsg.m_dataVec == parseMsg.m_dataVec);
+
+	FileDataRecvReqMsg recvMsg;
+	recvMsg.m_strMsgId = "1234567890";
+	recvMsg.m_nDataLength = 0;
+	TransBaseMsg_t emptyMsg(recvMsg, true);
+	FileDataRecvReqMsg parseRecvMsg;
+	CHECK(emptyMsg.DecodeMsg(parseRecvMsg));
+	CHECK_EQ(0, parseRecvMsg.m_nDataLength);
+}
+
+TEST_CASE("BinaryFileDataLargeChunk") {
+	FileDataRecvReqMsg reqMsg;
+	reqMsg.m_strMsgId = "1234567890";
+	reqMsg.m_nFileId = 7;
+	reqMsg.m_nDataTotalCount = 16;
+	reqMsg.m_nDataIndex = 3;
+	reqMsg.m_nChunkSize = FILE_DATA_TCP_CHUNK_SIZE;
+	reqMsg.m_nDataLength = FILE_DATA_TCP_CHUNK_SIZE;
+	reqMsg.m_dataVec.assign(FILE_DATA_TCP_CHUNK_SIZE, 'x');
+	TransBaseMsg_t transMsg(reqMsg, true);
+	CHECK_LT(transMsg.GetSize(), static_cast<std::size_t>(FILE_DATA_TCP_CHUNK_SIZE + FILE_DATA_FRAME_RESERVE));
+	FileDataRecvReqMsg parseMsg;
+	CHECK(transMsg.DecodeMsg(parseMsg));
+	CHECK_EQ(FILE_DATA_TCP_CHUNK_SIZE, parseMsg.m_nChunkSize);
+	CHECK(reqMsg.m_dataVec == parseMsg.m_dataVec);
+
+	//数据长度超过分包大小的帧是非法的
+	reqMsg.m_nChunkSize = FILE_DATA_CHUNK_SIZE;
+	TransBaseMsg_t badMsg(reqMsg, true);
+	CHECK_FALSE(badMsg.DecodeMsg(parseMsg));
+}
+
+TEST_CASE("JsonFileDataChunkLimit") {
+	FileDataSendReqMsg reqMsg;
+	reqMsg.m_strMsgId = "1234567890";
+	reqMsg.m_strUserId = "10001";
+	reqMsg.m_strFriendId = "10002";
+	reqMsg.m_nFileId = 7;
+	reqMsg.m_nDataTotalCount = 2;
+	reqMsg.m_nDataIndex = 2;
+	reqMsg.m_nChunkSize = FILE_DATA_CHUNK_SIZE;
+	reqMsg.m_nDataLength = 100;
+	reqMsg.m_dataVec.assign(100, 'z');
+	FileDataSendReqMsg parseMsg;
+	CHECK(parseMsg.FromString(reqMsg.ToString()));
+	CHECK(reqMsg.m_dataVec == parseMsg.m_dataVec);
+
+	//json解码和二进制解码一样限制分包大小
+	reqMsg.m_nChunkSize = 0x7FFFFFFF;
+	CHECK_FALSE(parseMsg.FromString(reqMsg.ToString()));
+	reqMsg.m_nChunkSize = 0;
+	CHECK_FALSE(parseMsg.FromString(reqMsg.ToString()));
+
+	//数据长度超过分包大小
+	reqMsg.m_nChunkSize = 64;
+	CHECK_FALSE(parseMsg.FromString(reqMsg.ToString()));
+
+	FileDataRecvReqMsg recvMsg;
+	recvMsg.m_strMsgId = "1234567890";
+	recvMsg.m_nChunkSize = FILE_DATA_MAX_CHUNK_SIZE + 1;
+	FileDataRecvReqMsg parseRecvMsg;
+	CHECK_FALSE(parseRecvMsg.FromString(recvMsg.ToString()));
+	recvMsg.m_nChunkSize = FILE_DATA_CHUNK_SIZE;
+	CHECK(parseRecvMsg.FromString(recvMsg.ToString()));
+}
+
+TEST_CASE("FileDataFramePrefix") {
+	FileDataRecvReqMsg reqMsg;
+	reqMsg.m_strMsgId = "1234567890";
+	reqMsg.m_strUserId = "5000";
+	reqMsg.m_strFriendId = "6000";
+	reqMsg.m_nFileId = 7;
+	reqMsg.m_nDataTotalCount = 4;
+	reqMsg.m_nDataIndex = 4;
+	reqMsg.m_nChunkSize = FILE_DATA_TCP_CHUNK_SIZE;
+	reqMsg.m_nDataLength = 100;
+	reqMsg.m_dataVec.assign(100, 'y');
+	TransBaseMsg_t transMsg(reqMsg, true);
+
+	//帧头之后直接写入文件数据,与完整编码的消息相同
+	reqMsg.m_dataVec.clear();
+	std::string strFrame = FileDataFramePrefix(reqMsg);
+	CHECK_EQ(transMsg.GetSize() - 100, strFrame.length());
+	strFrame.append(100, 'y');
+	CHECK(strFrame == std::string(transMsg.GetData(), transMsg.GetSize()));
+
+	TransBaseMsg_t frameMsg(strFrame.data());
+	FileDataRecvReqMsg parseMsg;
+	CHECK(frameMsg.DecodeMsg(parseMsg));
+	CHECK_EQ(100, parseMsg.m_nDataLength);
+	CHECK(parseMsg.m_dataVec == std::vector<char>(100, 'y'));
+}
+
+TEST_CASE("NegotiateFrameSize") {
+	//旧版本的客户端不协商
+	CHECK_EQ(MSG_DEFAULT_FRAME_SIZE, NegotiateFrameSize(0, MSG_MAX_FRAME_SIZE));
+	CHECK_EQ(FILE_DATA_CHUNK_SIZE, NegotiateChunkSize(0, FILE_DATA_TCP_CHUNK_SIZE, MSG_MAX_FRAME_SIZE));
+
+	CHECK_EQ(MSG_MAX_FRAME_SIZE, NegotiateFrameSize(8 * MSG_MAX_FRAME_SIZE, 8 * MSG_MAX_FRAME_SIZE));
+	CHECK_EQ(256 * 1024, NegotiateFrameSize(256 * 1024, MSG_MAX_FRAME_SIZE));
+	CHECK_EQ(FILE_DATA_TCP_CHUNK_SIZE, NegotiateChunkSize(FILE_DATA_MAX_CHUNK_SIZE, FILE_DATA_TCP_CHUNK_SIZE, MSG_MAX_FRAME_SIZE));
+	//数据包加上帧头不能超过消息长度
+	CHECK_EQ(MSG_DEFAULT_FRAME_SIZE - FILE_DATA_FRAME_RESERVE, NegotiateChunkSize(FILE_DATA_MAX_CHUNK_SIZE, FILE_DATA_MAX_CHUNK_SIZE, MSG_DEFAULT_FRAME_SIZE));
+
+	CHECK_EQ(0, FileDataChunkCount(0, FILE_DATA_CHUNK_SIZE));
+	CHECK_EQ(1, FileDataChunkCount(FILE_DATA_CHUNK_SIZE, FILE_DATA_CHUNK_SIZE));
+	CHECK_EQ(2, FileDataChunkCount(FILE_DATA_CHUNK_SIZE + 1, FILE_DATA_CHUNK_SIZE));
+
+	UserLoginRspMsg rspMsg;
+	rspMsg.m_strUserId = "10001";
+	rspMsg.m_strUserName = "UserLoginRspMsg";
+	rspMsg.m_strMsgId = "1234567890";
+	rspMsg.m_nMaxFrameSize = MSG_MAX_FRAME_SIZE;
+	rspMsg.m_nChunkSize = FILE_DATA_TCP_CHUNK_SIZE;
+	rspMsg.m_bBinaryCodec = true;
+	UserLoginRspMsg parseMsg;
+	CHECK_FALSE(parseMsg.m_bBinaryCodec);
+	CHECK(parseMsg.FromString(rspMsg.ToString()));
+	CHECK_EQ(MSG_MAX_FRAME_SIZE, parseMsg.m_nMaxFrameSize);
+	CHECK_EQ(FILE_DATA_TCP_CHUNK_SIZE, parseMsg.m_nChunkSize);
+	CHECK(parseMsg.m_bBinaryCodec);
+}
+
+TEST_CASE("NegotiateGroupMsgBatch") {
+	//旧版本的客户端逐条接收
+	CHECK_EQ(0, NegotiateGroupMsgBatch(0, GROUP_MSG_BATCH_DEFAULT));
+	//服务器关闭批量下发
+	CHECK_EQ(0, NegotiateGroupMsgBatch(GROUP_MSG_BATCH_DEFAULT, 0));
+	CHECK_EQ(20, NegotiateGroupMsgBatch(20, GROUP_MSG_BATCH_DEFAULT));
+	CHECK_EQ(GROUP_MSG_BATCH_DEFAULT, NegotiateGroupMsgBatch(1000, GROUP_MSG_BATCH_DEFAULT));
+	CHECK_EQ(GROUP_MSG_BATCH_MAX, NegotiateGroupMsgBatch(10000, 10000));
+
+	UserLoginReqMsg reqMsg;
+	reqMsg.m_strUserName = "UserLoginReqMsg";
+	reqMsg.m_strPassword = "UserLoginReqMsg";
+	reqMsg.m_strMsgId = "1234567890";
+	reqMsg.m_nGroupMsgBatch = 20;
+	UserLoginReqMsg parseMsg;
+	CHECK(parseMsg.FromString(reqMsg.ToString()));
+	CHECK_EQ(20, parseMsg.m_nGroupMsgBatch);
+}
+
+TEST_CASE("BinaryRecvGroupTextMsgBatchReqMsg") {
+	RecvGroupTextMsgBatchReqMsg reqMsg;
+	reqMsg.m_strMsgId = "1234567890";
+	reqMsg.m_strUserId = "10001";
+	reqMsg.m_strGroupId = "20001";
+	for (int i = 0; i < 3; i++)
+	{
+		GroupChatMsg_s chatMsg;
+		chatMsg.m_strChatMsgId = "300" + std::to_string(i);
+		chatMsg.m_strSenderId = "10002";
+		chatMsg.m_strGroupId = "20001";
+		chatMsg.m_strContext = u8"你好 TinyIM " + std::to_string(i);
+		chatMsg.m_strMsgTime = "2020-04-17 10:00:00";
+		reqMsg.m_chatMsgVec.push_back(chatMsg);
+	}
+	reqMsg.m_strLastChatMsgId = "3003";
+
+	RecvGroupTextMsgBatchReqMsg jsonMsg;
+	CHECK(jsonMsg.FromString(reqMsg.ToString()));
+	REQUIRE_EQ(3u, jsonMsg.m_chatMsgVec.size());
+	CHECK_EQ("3003", jsonMsg.m_strLastChatMsgId);
+
+	TransBaseMsg_t transMsg(reqMsg, true);
+	CHECK(transMsg.IsBinary());
+	CHECK_EQ(E_MsgType::RecvGroupTextMsgBatchReq_Type, transMsg.GetType());
+	RecvGroupTextMsgBatchReqMsg parseMsg;
+	CHECK(transMsg.DecodeMsg(parseMsg));
+	CHECK_EQ(reqMsg.ToString(), parseMsg.ToString());
+	auto pJsonMsg = ToJsonTransMsg(transMsg);
+	REQUIRE(pJsonMsg);
+	CHECK_EQ(reqMsg.ToString(), pJsonMsg->to_string());
+
+	//错误的消息条数不能导致分配过多内存
+	CBinaryWriter writer;
+	writer.WriteString("1234567890");
+	writer.WriteString("10001");
+	writer.WriteString("20001");
+	writer.WriteString("3003");
+	writer.WriteVarUInt(1000000);
+	CBinaryReader reader(writer.Data().c_str(), writer.Data().length());
+	CHECK_FALSE(parseMsg.FromBinary(reader));
+}
+
+TEST_CASE("BinaryJsonFallback") {
+	UserLoginReqMsg reqMsg;
+	reqMsg.m_strUserName = "UserLoginReqMsg";
+	reqMsg.m_strPassword = "UserLoginReqMsg";
+	reqMsg.m_strMsgId = "1234567890";
+	//没有二进制编码的消息协商了二进制编码也按json发送
+	CHECK_FALSE(reqMsg.HasBinary());
+	TransBaseMsg_t transMsg(reqMsg, true);
+	CHECK_FALSE(transMsg.IsBinary());
+	UserLoginReqMsg parseMsg;
+	CHECK(transMsg.DecodeMsg(parseMsg));
+	CHECK_EQ(reqMsg.ToString(), parseMsg.ToString());
+
+	TransBaseMsg_t jsonMsg(reqMsg, false);
+	CHECK_FALSE(jsonMsg.IsBinary());
+	CHECK_EQ(reqMsg.ToString(), jsonMsg.to_string());
+
+	//旧版本把json串包在二进制帧中发送,仍然可以解码
+	CBinaryWriter writer;
+	reqMsg.ToBinary(writer);
+	TransBaseMsg_t wrapMsg(static_cast<E_MsgType>(static_cast<int32_t>(reqMsg.GetMsgType()) | MSG_FLAG_BINARY), writer.Data());
+	CHECK(wrapMsg.IsBinary());
+	UserLoginReqMsg wrapParseMsg;
+	CHECK(wrapMsg.DecodeMsg(wrapParseMsg));
+	CHECK_EQ(reqMsg.ToString(), wrapParseMsg.ToString());
+
+	KeepAliveReqMsg keepAliveMsg("UnitTest");
+	CHECK(keepAliveMsg.HasBinary());
+	CHECK(TransBaseMsg_t(keepAliveMsg, true).IsBinary());
+}
+
+TEST_CASE("BinaryTruncated") {
+	KeepAliveReqMsg reqMsg("UnitTest");
+	CBinaryWriter writer;
+	reqMsg.ToBinary(writer);
+	CBinaryReader reader(writer.Data().c_str(), writer.Data().length() - 1);
+	KeepAliveReqMsg parseMsg;
+	CHECK_FALSE(parseMsg.FromBinary(reader));
+}
+
+TEST_CASE("FileSendDataBeginResume") {
+	//旧版本的发送端没有文件大小和数据包长度
+	FileSendDataBeginReq reqMsg;
+	reqMsg.m_strMsgId = "1234567890";
+	reqMsg.m_strFileName = "a.png";
+	reqMsg.m_strFileHash = "900150983cd24fb0d6963f7d28e17f72";
+	std::string strOld = reqMsg.ToString();
+	FileSendDataBeginReq parseReq;
+	CHECK(parseReq.FromString(strOld));
+	CHECK_EQ(0, parseReq.m_nFileSize);
+	reqMsg.m_nFileSize = 100000;
+	reqMsg.m_nChunkSize = FILE_DATA_TCP_CHUNK_SIZE;
+	CHECK(parseReq.FromString(reqMsg.ToString()));
+	CHECK_EQ(100000, parseReq.m_nFileSize);
+	CHECK_EQ(FILE_DATA_TCP_CHUNK_SIZE, parseReq.m_nChunkSize);
+
+	FileSendDataBeginRsp rspMsg;
+	rspMsg.m_strMsgId = "1234567890";
+	FileSendDataBeginRsp parseRsp;
+	CHECK(parseRsp.FromString(rspMsg.ToString()));
+	CHECK_FALSE(parseRsp.m_bResume);
+	rspMsg.m_bResume = true;
+	rspMsg.m_nChunkSize = FILE_DATA_TCP_CHUNK_SIZE;
+	rspMsg.m_missingRangeVec = { { 1, 3 }, { 7, 7 } };
+	CHECK(parseRsp.FromString(rspMsg.ToString()));
+	CHECK(parseRsp.m_bResume);
+	CHECK_EQ(FILE_DATA_TCP_CHUNK_SIZE, parseRsp.m_nChunkSize);
+	CHECK(parseRsp.m_missingRangeVec == rspMsg.m_missingRangeVec);
+}
+
+TEST_CASE("FileSendDataBeginProof") {
+	//旧版本的发送端不支持秒传的持有证明
+	FileSendDataBeginReq reqMsg;
+	reqMsg.m_strMsgId = "1234567890";
+	reqMsg.m_strFileName = "a.png";
+	reqMsg.m_strFileHash = "900150983cd24fb0d6963f7d28e17f72";
+	FileSendDataBeginReq parseReq;
+	CHECK(parseReq.FromString(reqMsg.ToString()));
+	CHECK_FALSE(parseReq.m_bProofSupport);
+	CHECK(parseReq.m_strFileProof.empty());
+	reqMsg.m_bProofSupport = true;
+	reqMsg.m_strProofSalt = "0011223344556677";
+	reqMsg.m_strFileProof = "bddd813c634239723171ef3fee98579b94964e3bb1cb3e427262c8c068d52319";
+	CHECK(parseReq.FromString(reqMsg.ToString()));
+	CHECK(parseReq.m_bProofSupport);
+	CHECK_EQ(reqMsg.m_strProofSalt, parseReq.m_strProofSalt);
+	CHECK_EQ(reqMsg.m_strFileProof, parseReq.m_strFileProof);
+
+	FileSendDataBeginRsp rspMsg;
+	rspMsg.m_strMsgId = "1234567890";
+	rspMsg.m_errCode = ERROR_CODE_TYPE::E_CODE_FILE_NEED_PROOF;
+	rspMsg.m_strProofSalt = "0011223344556677";
+	FileSendDataBeginRsp parseRsp;
+	CHECK(parseRsp.FromString(rspMsg.ToString()));
+	CHECK(parseRsp.m_errCode == ERROR_CODE_TYPE::E_CODE_FILE_NEED_PROOF);
+	CHECK_EQ(rspMsg.m_strProofSalt, parseRsp.m_strProofSalt);
+}
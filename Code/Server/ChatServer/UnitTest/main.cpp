@@ -3,6 +3,19 @@
 
 //#include "header.h"
 #include "TransBaseMessage_Test.cpp"
+#include "CRecvBuffer_Test.cpp"
+#include "CSendQueue_Test.cpp"
+#include "CMsgDispatcher_Test.cpp"
+#include "CLogSampler_Test.cpp"
+#include "CDbExecutor_Test.cpp"
+#include "CFileIoEngine_Test.cpp"
+#include "CFriendGraphCache_Test.cpp"
+#include "CUnReadMsgWindow_Test.cpp"
+#include "CGroupMsgCache_Test.cpp"
+#include "CChatMsgJournal_Test.cpp"
+#include "CChatArchive_Test.cpp"
+#include "CPresenceRegistry_Test.cpp"
+#include "CBlobStore_Test.cpp"
 #include "DataBaseCmd_Test.cpp"
 int program();
 //void some_program_code(int argc, char** argv);
@@ -18,6 +18,7 @@
 
 #include "CommonConfig.h"
 #include "Log.h"
+#include <spdlog/async.h>
 #include "json11.hpp"
 
 #ifdef  WIN32
@@ -192,11 +193,11 @@ std::shared_ptr<spdlog::logger> CreateLogger(json11::Json& cfg)
     //调试日志
 	std::string strDebug=logDir+"Debug";
 	std::string strBusin=logDir+"Busin";
-    auto debugFile =std::make_shared<spdlog::sinks::daily_file_sink_st>(strDebug+"txt",00,00,true);
+    auto debugFile =std::make_shared<spdlog::sinks::daily_file_sink_mt>(strDebug+"txt",00,00,true);
 
     debugFile->set_level(spdlog::level::debug);
     //业务日志
-    auto businFile =std::make_shared<spdlog::sinks::daily_file_sink_st>(strBusin+"txt",00,00,true);
+    auto businFile =std::make_shared<spdlog::sinks::daily_file_sink_mt>(strBusin+"txt",00,00,true);
     if(1 == debugOn)
     {
         businFile->set_level(spdlog::level::debug);
@@ -208,9 +209,9 @@ std::shared_ptr<spdlog::logger> CreateLogger(json11::Json& cfg)
     
 
 #ifdef _WIN32
-	auto consoleSink = std::make_shared<spdlog::sinks::wincolor_stdout_sink_st>();
+	auto consoleSink = std::make_shared<spdlog::sinks::wincolor_stdout_sink_mt>();
 #else
-    auto consoleSink = std::make_shared<spdlog::sinks::ansicolor_stderr_sink_st>();
+    auto consoleSink = std::make_shared<spdlog::sinks::ansicolor_stderr_sink_mt>();
 #endif
 	consoleSink->set_level(spdlog::level::info);
 
@@ -218,7 +219,31 @@ std::shared_ptr<spdlog::logger> CreateLogger(json11::Json& cfg)
     sinks.push_back(businFile);
     sinks.push_back(consoleSink);
 
-	auto combined_logger = std::make_shared<spdlog::logger>("T",begin(sinks),end(sinks));
+    //默认使用异步日志,格式化后的日志经有界队列交给后台线程写文件,业务线程不等待磁盘
+    //logoverflow为block时队列满了等待,否则丢弃最旧的日志
+    std::shared_ptr<spdlog::logger> combined_logger;
+    bool bAsync = cfg["logasync"].is_number() ? (0 != cfg["logasync"].int_value()) : true;
+    if(bAsync)
+    {
+        std::size_t nQueueSize = 8192;
+        if(cfg["logqueuesize"].is_number() && cfg["logqueuesize"].int_value() > 0)
+        {
+            nQueueSize = static_cast<std::size_t>(cfg["logqueuesize"].int_value());
+        }
+        if(!spdlog::thread_pool())
+        {
+            spdlog::init_thread_pool(nQueueSize, 1);
+        }
+        auto overflow = ("block" == cfg["logoverflow"].string_value()) ? spdlog::async_overflow_policy::block : spdlog::async_overflow_policy::overrun_oldest;
+        combined_logger = std::make_shared<spdlog::async_logger>("T",begin(sinks),end(sinks),spdlog::thread_pool(),overflow);
+    }
+    else
+    {
+        combined_logger = std::make_shared<spdlog::logger>("T",begin(sinks),end(sinks));
+    }
+    //日志宏先按logger的级别过滤,关闭的级别不会计算参数
+    combined_logger->set_level(1 == debugOn ? spdlog::level::debug : spdlog::level::info);
+    combined_logger->flush_on(spdlog::level::err);
 	//spdlog::register_logger(combined_logger);
     return combined_logger;
 }
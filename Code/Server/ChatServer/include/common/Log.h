@@ -1,4 +1,3 @@
-
 #ifndef _DENNIS_THINK_LOG_H_
 #define _DENNIS_THINK_LOG_H_
 #include <spdlog/spdlog.h>
@@ -6,17 +5,31 @@
 #include <spdlog/sinks/daily_file_sink.h>
 //#include <spdlog/sinks/syslog_sink.h>
 #include <string.h>
+#include <type_traits>
+
+/**
+ * @brief 编译期计算__FILE__中文件名的偏移,同时支持'/'和'\\'分隔符
+ *
+ */
+constexpr std::size_t LogBaseNameOffset(const char* szPath, const std::size_t nIndex = 0, const std::size_t nLast = 0)
+{
+	return '\0' == szPath[nIndex] ? nLast : LogBaseNameOffset(szPath, nIndex + 1, ('/' == szPath[nIndex] || '\\' == szPath[nIndex]) ? nIndex + 1 : nLast);
+}
+
+//文件名在编译期确定,不再在每次写日志时调用strrchr
+#define __FILENAME__ (__FILE__ + std::integral_constant<std::size_t, LogBaseNameOffset(__FILE__)>::value)
+
+//先判断日志级别,级别不满足时不计算参数,也不格式化
+#define LOG_LEVEL_ON(LOG,LEVEL) ((LOG) && (LOG)->should_log(LEVEL))
 #ifdef _WIN32
-#define LOG_INFO(LOG,...) if(LOG){LOG->info(__VA_ARGS__);}
-#define LOG_WARN(LOG,...) if(LOG){LOG->warn(__VA_ARGS__);}
-#define LOG_ERR(LOG,...)  if(LOG){LOG->error(__VA_ARGS__);}
-#define LOG_DBG(LOG,...) if(LOG){LOG->debug(__VA_ARGS__);}
-#define __FILENAME__ (strrchr(__FILE__, '\\') ? (strrchr(__FILE__, '\\') + 1) : __FILE__)
+#define LOG_INFO(LOG,...) if(LOG_LEVEL_ON(LOG,spdlog::level::info)){LOG->info(__VA_ARGS__);}
+#define LOG_WARN(LOG,...) if(LOG_LEVEL_ON(LOG,spdlog::level::warn)){LOG->warn(__VA_ARGS__);}
+#define LOG_ERR(LOG,...)  if(LOG_LEVEL_ON(LOG,spdlog::level::err)){LOG->error(__VA_ARGS__);}
+#define LOG_DBG(LOG,...) if(LOG_LEVEL_ON(LOG,spdlog::level::debug)){LOG->debug(__VA_ARGS__);}
 #else
-#define LOG_INFO(LOG,msg...) if(LOG){LOG->info(msg);}
-#define LOG_WARN(LOG,msg...) if(LOG){LOG->warn(msg);}
-#define LOG_ERR(LOG,msg...)  if(LOG){LOG->error(msg);}
-#define LOG_DBG(LOG,msg...) if(LOG){LOG->debug(msg);}
-#define __FILENAME__ (strrchr(__FILE__, '/') ? (strrchr(__FILE__, '/') + 1) : __FILE__)
+#define LOG_INFO(LOG,msg...) if(LOG_LEVEL_ON(LOG,spdlog::level::info)){LOG->info(msg);}
+#define LOG_WARN(LOG,msg...) if(LOG_LEVEL_ON(LOG,spdlog::level::warn)){LOG->warn(msg);}
+#define LOG_ERR(LOG,msg...)  if(LOG_LEVEL_ON(LOG,spdlog::level::err)){LOG->error(msg);}
+#define LOG_DBG(LOG,msg...) if(LOG_LEVEL_ON(LOG,spdlog::level::debug)){LOG->debug(msg);}
 #endif
 #endif
\ No newline at end of file
@@ -12,9 +12,10 @@
 #define _DENNIS_C_MYSQL_CONNECT_H_
 #include "mysql.h"
 #include <string>
-#include <queue>
 #include <map>
+#include <memory>
 #include "CMysqlStruct.h"
+#include "CMySqlStmt.h"
 #include "Log.h"
 class CMySqlConnect
 {
@@ -26,9 +27,54 @@ public:
                          const std::string passwd,
                          const std::string database,
                          const std::string strHost,
-                         const int port=3306);
+                         const int port=3306,
+                         const bool bCreateTable=true);
+
+	//设置连接、读、写的超时时间(秒),在ConnectToServer之前调用
+	void SetTimeout(const int nSeconds);
+
+	//检查连接,断开时使用ConnectToServer的参数重新连接
+	bool Ping();
+
+	//关闭自动提交开始事务,Commit或Rollback以后恢复自动提交
+	bool BeginTransaction();
+	bool Commit();
+	bool Rollback();
 
 	bool CreateTable();
+
+	//把已有的聊天表升级为整数消息ID,并增加按游标查询需要的索引,已经升级的部分跳过
+	bool MigrateChatSchema();
+
+	//聊天表是否已经升级,没有升级时按消息ID的查询需要扫描全表
+	bool IsChatSchemaMigrated();
+
+	//执行不需要预处理的SQL,用于DDL和数据库工具
+	bool ExecuteSql(const std::string& strSql);
+
+	//查询表中某一列的类型,例如"bigint"
+	bool SelectColumnType(const std::string& strTable, const std::string& strColumn, std::string& strType);
+
+	bool IsIndexExist(const std::string& strTable, const std::string& strIndex);
+
+	//执行返回一个整数的查询,例如SELECT COUNT(*)
+	bool SelectCount(const std::string& strSql, int64_t& nCount);
+
+	//查询表的分区,按分区的顺序排列,没有分区的表返回空
+	bool SelectChatPartitions(const std::string& strTable, std::vector<ChatPartition_st>& partVec);
+
+	//给没有分区的聊天表按消息ID分区,主键改为(F_INDEX,F_MSG_ID)
+	bool PartitionChatTable(const std::string& strTable, const std::vector<ChatPartition_st>& partVec);
+
+	//从最后的p_max分区中拆分出新的月份分区
+	bool AddChatPartitions(const std::string& strTable, const std::vector<ChatPartition_st>& partVec);
+
+	//删除整个分区,分区中的消息需要先归档
+	bool DropChatPartition(const std::string& strTable, const std::string& strPartition);
+
+	//按(F_MSG_ID,F_INDEX)的顺序分页读取一个分区中的消息,用于归档
+	bool SelectFriendChatMsgPartition(const std::string& strPartition, const int nLimit, ChatPartitionCursor_st& cursor, std::vector<T_USER_CHAT_MSG>& msgVec);
+	bool SelectGroupChatTextPartition(const std::string& strPartition, const int nLimit, ChatPartitionCursor_st& cursor, std::vector<T_GROUP_CHAT_MSG>& msgVec);
     
 	//用户最基本的操作 begin
     bool SelectUserByName(const std::string userName,T_USER_BEAN& bean);
@@ -46,6 +92,7 @@ public:
 	bool SelectUserInfoByName(const std::string userName, T_USER_INFO_BEAN& bean);
 	bool UpdateUserInfo(const T_USER_INFO_BEAN& bean);
 	bool UpdateUserOnlineState(const std::string strUserId, const CLIENT_STATE);
+	bool UpdateUserOnlineState(const std::vector<std::string>& userIdVec, const CLIENT_STATE type);
 	bool InsertUserInfo(const T_USER_INFO_BEAN& bean);
 	bool GetAllUserName(std::vector<std::string>& userNameVec);
 	// 用户基本信息的操作 end
@@ -69,14 +116,18 @@ public:
 	bool InsertFriendRelation(const T_FRIEND_RELATION_BEAN& bean);
 	bool GetUserFriendList(const std::string strUser, std::vector<std::string>& friendList);
 	bool GetUserFriendList(const std::string strUser, std::vector<T_FRIEND_RELATION_BEAN>& friendList);
+	bool SelectFriendInfoList(const std::string strUser, std::vector<T_FRIEND_INFO_BEAN>& friendList);
 	// 好友关系的基本操作 end
 
 
 	// 好友聊天消息的操作 begin
 	bool InsertFriendChatMsg(const T_USER_CHAT_MSG& chatMsg);
-	bool SelectUnReadFriendChatMsg(const std::string& strToId, T_USER_CHAT_MSG& chatMsg);
+	bool InsertFriendChatMsg(const std::vector<T_USER_CHAT_MSG>& msgVec);
+	bool IsFriendChatMsgExist(const std::string& strMsgId);
+	bool SelectUnReadFriendChatMsg(const std::string& strToId, const int nLimit, std::vector<T_USER_CHAT_MSG>& chatMsgVec);
 	bool HaveUnReadMsg(const std::string strUserId);
 	bool UpdateFriendChatMsgState(const std::string& strMsgId, const std::string msgState);
+	bool UpdateFriendChatMsgState(const std::vector<std::string>& msgIdVec, const std::string msgState);
 	bool DeleteFriendChatMsg(const uint64_t msgId);
 	// 好友聊天消息的操作 end
 
@@ -107,6 +158,9 @@ public:
 	bool SelectUserGroupRelation(const std::string strUserName, std::vector<T_GROUP_RELATION_BEAN>& memBeans);
 
 	bool SelectGroupRelation(const std::string strGroupId, std::vector<T_GROUP_RELATION_BEAN>& memBeans);
+
+	//查询用户所在的全部群组和每个群组的成员资料,一次查询代替每个群组、每个成员查询一次
+	bool SelectUserGroupMemberList(const std::string strUserId, std::vector<T_GROUP_MEMBER_INFO_BEAN>& memberList);
 	
 	bool SelectGroupUsers(const std::string strGroupId, std::vector<std::string> groupUsers);
 
@@ -115,9 +169,15 @@ public:
 
 	// 群聊消息基本操作 Begin
 	bool InsertGroupChatText(const T_GROUP_CHAT_MSG& chatMsg);
+
+	bool InsertGroupChatText(const std::vector<T_GROUP_CHAT_MSG>& msgVec);
+
+	bool IsGroupChatTextExist(const std::string& strMsgId);
 	
 	bool SelectGroupChatText(T_GROUP_CHAT_MSG& chatMsg);
 
+	bool SelectGroupChatTextList(const std::string strGroupId, const std::string strLastMsgId, const int nLimit, std::vector<T_GROUP_CHAT_MSG>& msgVec);
+
 	bool DeleteGroupChatText(const std::string m_strMsgId);
 	// 群聊消息基本操作 End
 	
@@ -130,13 +190,45 @@ public:
 
 	static std::shared_ptr<spdlog::logger> m_loger;
 private:
-	bool SaveMsgToQueue(const std::string strUserId);
-	bool UnReadFromQueue(const std::string strUserId, T_USER_CHAT_MSG& chatMsg);
+	void ApplyOptions();
+	void CloseStmt();
+	bool Reconnect();
+
+	//获取SQL对应的预处理语句,每个连接上只准备一次
+	CMySqlStmt* GetStmt(const std::string& strSql);
+
+	/**
+	 * @brief 按顺序绑定参数并执行预处理语句
+	 *
+	 * @return CMySqlStmt* 执行成功返回语句,用于读取结果;失败返回nullptr
+	 */
+	template<typename... Args>
+	CMySqlStmt* ExecuteStmt(const std::string& strSql, const Args&... args)
+	{
+		CMySqlStmt* pStmt = GetStmt(strSql);
+		if (nullptr == pStmt)
+		{
+			return nullptr;
+		}
+		int bindArray[] = { 0, (pStmt->Bind(args), 0)... };
+		(void)bindArray;
+		LOG_DBG(m_loger, "SQL:{} [{} {}]", strSql, __FILENAME__, __LINE__);
+		if (!pStmt->Execute())
+		{
+			LOG_ERR(m_loger, "SQL:{} Failed {} {} [{} {}]", strSql, pStmt->Errno(), pStmt->Error(), __FILENAME__, __LINE__);
+			return nullptr;
+		}
+		return pStmt;
+	}
     MYSQL* m_mysql;
-	std::map<std::string,std::queue<T_USER_CHAT_MSG>> m_unReadChatMsg;
-	MYSQL_STMT* m_pFriendChatInsertStmt;
-	MYSQL_STMT* m_pSelectUserByNameStmt;
-	MYSQL_STMT* m_pSelectAllUserNameStmt;
+	std::map<std::string, std::unique_ptr<CMySqlStmt>> m_stmtMap;//SQL到预处理语句,属于当前连接
+	CMySqlStmt* m_pLastStmt = nullptr;//最后执行的语句,执行其他语句前丢弃它没有读完的结果
+	unsigned int m_nTimeout = 0;//连接、读、写的超时时间,0表示使用默认值
+	std::string m_strUserName;//以下为重连时使用的参数
+	std::string m_strPasswd;
+	std::string m_strDataBase;
+	std::string m_strHost;
+	int m_nPort = 3306;
 
 };
 #endif
\ No newline at end of file
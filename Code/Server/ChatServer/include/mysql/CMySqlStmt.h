@@ -0,0 +1,94 @@
+/**
+ * @file CMySqlStmt.h
+ * @author DennisMi (https://www.dennisthink.com/)
+ * @brief 预处理语句的封装,参数和结果使用可以重复使用的MYSQL_BIND
+ * @version 0.1
+ * @date 2020-04-15
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+#ifndef _DENNIS_C_MYSQL_STMT_H_
+#define _DENNIS_C_MYSQL_STMT_H_
+#include "mysql.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 预处理语句,在一个连接上准备一次,以后每次只绑定参数和执行
+ *
+ * 参数按照占位符的顺序绑定,结果的所有列都按字符串读取,
+ * 结果集不使用mysql_stmt_store_result缓存,逐行从服务器读取:
+ *     pStmt->Bind(strUserId).Execute();
+ *     while (pStmt->Fetch()) { pStmt->GetString(0); }
+ */
+class CMySqlStmt
+{
+public:
+	CMySqlStmt(MYSQL* pMysql, const std::string& strSql);
+	~CMySqlStmt();
+	CMySqlStmt(const CMySqlStmt&) = delete;
+	CMySqlStmt& operator=(const CMySqlStmt&) = delete;
+
+	//准备语句是否成功
+	bool IsValid() const { return m_bValid; }
+
+	const std::string& Sql() const { return m_strSql; }
+
+	//按占位符的顺序绑定参数,Execute以后重新从第一个参数开始
+	CMySqlStmt& Bind(const std::string& strValue);
+	CMySqlStmt& Bind(const int64_t nValue);
+	//依次绑定多个字符串参数,用于IN (?,?,...)
+	CMySqlStmt& Bind(const std::vector<std::string>& valueVec);
+	CMySqlStmt& Bind(const std::vector<int64_t>& valueVec);
+
+	bool Execute();
+
+	uint64_t AffectedRows() const;
+
+	//读取下一行,没有数据或者出错时返回false
+	bool Fetch();
+
+	std::string GetString(const std::size_t nCol) const;
+
+	int64_t GetInt(const std::size_t nCol) const;
+
+	bool IsNull(const std::size_t nCol) const;
+
+	//丢弃没有读取的行,同一个连接上执行其他语句之前必须读完或者丢弃
+	void FreeResult();
+
+	const char* Error() const;
+
+	unsigned int Errno() const;
+private:
+	struct Param_st
+	{
+		std::string m_strValue;
+		long long m_nValue = 0;
+		unsigned long m_nLength = 0;
+	};
+
+	struct Column_st
+	{
+		std::vector<char> m_buff;
+		unsigned long m_nLength = 0;
+		bool m_bNull = false;
+		bool m_bError = false;
+	};
+
+	bool BindResult();
+
+	MYSQL_STMT* m_pStmt;
+	std::string m_strSql;
+	bool m_bValid;
+	bool m_bResultBind;//结果的MYSQL_BIND是否已经绑定到语句
+	bool m_bHasResult;//是否有没有读完的结果
+	std::size_t m_nBindIndex;//下一个绑定的参数
+	std::vector<Param_st> m_paramVec;
+	std::vector<MYSQL_BIND> m_paramBind;
+	std::vector<Column_st> m_columnVec;
+	std::vector<MYSQL_BIND> m_resultBind;
+};
+#endif
@@ -145,6 +145,24 @@ struct T_FRIEND_RELATION_BEAN {
 	E_FRIEND_RELATION m_eF_STATUS;//好友关系
 };
 
+/**
+ * @brief 好友关系和好友的资料,获取好友列表时一次查询得到
+ * 
+ */
+struct T_FRIEND_INFO_BEAN {
+	T_FRIEND_RELATION_BEAN m_relation;//好友关系
+	T_USER_INFO_BEAN m_userInfo;//好友的资料
+};
+
+/**
+ * @brief 群组和群组成员的资料,获取群组列表时一次查询得到
+ * 
+ */
+struct T_GROUP_MEMBER_INFO_BEAN {
+	T_GROUP_BEAN m_group;//群组
+	T_USER_INFO_BEAN m_userInfo;//成员的资料
+};
+
 /**
  * @brief 文件Hash元数据
  * 
@@ -155,4 +173,26 @@ struct T_FILE_HASH_BEAN
 	std::string m_strF_FILE_NAME;//文件名
 	std::string m_strF_FILE_HASH;//文件HASH
 };
+
+/**
+ * @brief 聊天表按消息ID划分的分区,一个分区对应一个月的消息
+ * 
+ */
+struct ChatPartition_st
+{
+	std::string m_strName;//分区名,p202604或者p_max
+	uint64_t m_nLessThan = 0;//分区中的消息ID小于该值
+	bool m_bMaxValue = false;//是否为MAXVALUE分区
+	int64_t m_nRows = 0;//information_schema中的估计行数
+};
+
+/**
+ * @brief 按分区导出聊天消息时的读取位置,按(F_MSG_ID,F_INDEX)递增
+ * 
+ */
+struct ChatPartitionCursor_st
+{
+	uint64_t m_nLastMsgId = 0;
+	uint64_t m_nLastIndex = 0;
+};
 #endif
\ No newline at end of file
@@ -68,7 +68,7 @@ CREATE TABLE `T_FILE_HASH`  (
 DROP TABLE IF EXISTS `T_FRIEND_CHAT_MSG`;
 CREATE TABLE `T_FRIEND_CHAT_MSG`  (
   `F_INDEX` bigint(255) UNSIGNED NOT NULL AUTO_INCREMENT COMMENT '自增ID，由数据库产生',
-  `F_MSG_ID` char(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '消息ID,由程序生成',
+  `F_MSG_ID` bigint UNSIGNED NOT NULL COMMENT '消息ID,由程序生成',
   `F_MSG_TYPE` char(32) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '消息类型',
   `F_FROM_ID` char(8) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '消息发送者ID',
   `F_TO_ID` char(8) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '消息接收者ID',
@@ -77,8 +77,11 @@ CREATE TABLE `T_FRIEND_CHAT_MSG`  (
   `F_READ_FLAG` enum('UNREAD','READ') CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL DEFAULT 'UNREAD' COMMENT '信息是否被读取,\'READ\',\'UNREAD\'',
   `F_CREATE_TIME` timestamp(0) DEFAULT CURRENT_TIMESTAMP COMMENT '信息创建时间',
   `F_READ_TIME` timestamp(0) DEFAULT CURRENT_TIMESTAMP COMMENT '信息读取时间',
-  PRIMARY KEY (`F_INDEX`) USING BTREE
-) ENGINE = InnoDB AUTO_INCREMENT = 6344 CHARACTER SET = utf8mb4 COLLATE = utf8mb4_bin ROW_FORMAT = Dynamic;
+  PRIMARY KEY (`F_INDEX`, `F_MSG_ID`) USING BTREE,
+  INDEX `IDX_MSG_ID`(`F_MSG_ID`) USING BTREE,
+  INDEX `IDX_TO_UNREAD`(`F_TO_ID`, `F_READ_FLAG`, `F_MSG_ID`) USING BTREE
+) ENGINE = InnoDB AUTO_INCREMENT = 6344 CHARACTER SET = utf8mb4 COLLATE = utf8mb4_bin ROW_FORMAT = Dynamic
+PARTITION BY RANGE (`F_MSG_ID`) (PARTITION `p_max` VALUES LESS THAN MAXVALUE);
 
 -- ----------------------------
 -- Table structure for T_FRIEND_RELATION
@@ -114,15 +117,18 @@ CREATE TABLE `T_GROUP`  (
 DROP TABLE IF EXISTS `T_GROUP_CHAT_MSG`;
 CREATE TABLE `T_GROUP_CHAT_MSG`  (
   `F_INDEX` int(255) UNSIGNED NOT NULL AUTO_INCREMENT COMMENT '自增ID',
-  `F_MSG_ID` char(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin DEFAULT NULL COMMENT '消息ID,由程序生成 ',
+  `F_MSG_ID` bigint UNSIGNED NOT NULL COMMENT '消息ID,由程序生成 ',
   `F_MSG_TYPE` char(32) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin DEFAULT NULL COMMENT '消息类型',
   `F_SENDER_ID` char(8) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin DEFAULT NULL COMMENT '消息发送者ID,外键链接到T_USER的F_USER_ID',
   `F_GROUP_ID` char(8) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin DEFAULT NULL COMMENT '群组ID，外键链接到T_GROUP的F_GROUP_ID',
   `F_MSG_CONTEXT` blob COMMENT '消息内容',
   `F_OTHER_INFO` char(255) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin DEFAULT NULL,
   `F_CREATE_TIME` datetime(0) DEFAULT CURRENT_TIMESTAMP COMMENT '创建时间',
-  PRIMARY KEY (`F_INDEX`) USING BTREE
-) ENGINE = InnoDB AUTO_INCREMENT = 1592 CHARACTER SET = utf8mb4 COLLATE = utf8mb4_bin ROW_FORMAT = Dynamic;
+  PRIMARY KEY (`F_INDEX`, `F_MSG_ID`) USING BTREE,
+  INDEX `IDX_MSG_ID`(`F_MSG_ID`) USING BTREE,
+  INDEX `IDX_GROUP_MSG`(`F_GROUP_ID`, `F_MSG_ID`) USING BTREE
+) ENGINE = InnoDB AUTO_INCREMENT = 1592 CHARACTER SET = utf8mb4 COLLATE = utf8mb4_bin ROW_FORMAT = Dynamic
+PARTITION BY RANGE (`F_MSG_ID`) (PARTITION `p_max` VALUES LESS THAN MAXVALUE);
 
 -- ----------------------------
 -- Table structure for T_GROUP_RELATION
@@ -133,9 +139,11 @@ CREATE TABLE `T_GROUP_RELATION`  (
   `F_GROUP_ID` char(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '群组ID',
   `F_USER_ID` char(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '用户ID',
   `F_ROLE_TYPE` varchar(255) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin NOT NULL COMMENT '用户角色，\'OWNER\',\'MANAGER\',\'MEMBER\' ',
-  `F_LAST_READ_MSG_ID` char(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_bin DEFAULT '00000000' COMMENT '阅读的最后一个消息的编号',
+  `F_LAST_READ_MSG_ID` bigint UNSIGNED NOT NULL DEFAULT 0 COMMENT '阅读的最后一个消息的编号',
   `F_CREATE_TIME` datetime(0) DEFAULT CURRENT_TIMESTAMP COMMENT '创建时间',
-  PRIMARY KEY (`F_INDEX`) USING BTREE
+  PRIMARY KEY (`F_INDEX`) USING BTREE,
+  INDEX `IDX_GROUP_USER`(`F_GROUP_ID`, `F_USER_ID`) USING BTREE,
+  INDEX `IDX_USER_GROUP`(`F_USER_ID`, `F_GROUP_ID`) USING BTREE
 ) ENGINE = InnoDB AUTO_INCREMENT = 294 CHARACTER SET = utf8mb4 COLLATE = utf8mb4_bin ROW_FORMAT = Dynamic;
 
 -- ----------------------------
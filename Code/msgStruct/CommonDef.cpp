@@ -317,6 +317,7 @@ std::string MsgType(const E_MsgType& msgType)
 		ENUM_TO_STRING(E_MsgType::FileDownLoadRsp_Type)
 		ENUM_TO_STRING(E_MsgType::UdpMultiCastReq_Type)
 		ENUM_TO_STRING(E_MsgType::UdpMultiCastRsp_Type)
+		ENUM_TO_STRING(E_MsgType::RecvGroupTextMsgBatchReq_Type)
 	default:
 		{
 			return "UnKnownMsgType: "+std::to_string(static_cast<int>(msgType));
@@ -375,7 +375,9 @@ GroupMemberStateChangeNotifyRsp_Type,//群组成
 
 FriendFileTransResultNotifyReq_Type,//好友文件传输结果的通知
 
-GroupFileTransResultNotifyReq_Type，//群组文件传输结果的通知
+GroupFileTransResultNotifyReq_Type,//群组文件传输结果的通知
+
+RecvGroupTextMsgBatchReq_Type,//批量接收群组的文本聊天消息
 };
 
 //客户端会话状态
@@ -486,6 +488,7 @@ enum class ERROR_CODE_TYPE {
 	E_CODE_FILE_TRANSING,//文件正在传输
 	E_CODE_FILE_HAS_EXIST,//文件已存在
 	E_CODE_FILE_SEND_FAILED,//文件传输失败
+	E_CODE_FILE_NEED_PROOF,//服务器已有相同内容的文件,秒传需要先证明持有文件
 
 };
 
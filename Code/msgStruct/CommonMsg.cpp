@@ -1,4 +1,6 @@
 #include "CommonMsg.h"
+#include <algorithm>
+#include <limits>
 json11::Json FriendChatMsg(const FriendChatMsg_s& chatMsg) {
 	using namespace json11;
 	Json clientObj = Json::object(
@@ -134,10 +136,284 @@ bool GroupChatMsg(const json11::Json & msgItem, GroupChatMsg_s& chatMsg) {
 }
 
 
+/**
+ * @brief 写入无符号varint,每个字节的低7位为数据,最高位表示后面是否还有字节
+ * 
+ * @param nValue 待写入的值
+ */
+void CBinaryWriter::WriteVarUInt(uint64_t nValue)
+{
+	while (nValue >= 0x80)
+	{
+		m_strData.push_back(static_cast<char>((nValue & 0x7F) | 0x80));
+		nValue >>= 7;
+	}
+	m_strData.push_back(static_cast<char>(nValue));
+}
+
+/**
+ * @brief 写入有符号varint,先做zigzag变换,使绝对值小的负数也只占很少的字节
+ * 
+ * @param nValue 待写入的值
+ */
+void CBinaryWriter::WriteVarInt(int64_t nValue)
+{
+	WriteVarUInt((static_cast<uint64_t>(nValue) << 1) ^ static_cast<uint64_t>(nValue >> 63));
+}
+
+void CBinaryWriter::WriteString(const std::string& strValue)
+{
+	WriteVarUInt(strValue.length());
+	m_strData.append(strValue);
+}
+
+void CBinaryWriter::WriteBytes(const char* pData, const std::size_t nLength)
+{
+	WriteVarUInt(nLength);
+	m_strData.append(pData, nLength);
+}
+
+CBinaryReader::CBinaryReader(const char* pData, const std::size_t nLength):m_pData(pData),m_nLength(nLength),m_nPos(0)
+{
+}
+
+bool CBinaryReader::ReadVarUInt(uint64_t& nValue)
+{
+	nValue = 0;
+	for (int nShift = 0; nShift < 64; nShift += 7)
+	{
+		if (m_nPos >= m_nLength)
+		{
+			return false;
+		}
+		uint8_t nByte = static_cast<uint8_t>(m_pData[m_nPos++]);
+		nValue |= static_cast<uint64_t>(nByte & 0x7F) << nShift;
+		if (0 == (nByte & 0x80))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool CBinaryReader::ReadVarInt(int64_t& nValue)
+{
+	uint64_t nRaw = 0;
+	if (!ReadVarUInt(nRaw))
+	{
+		return false;
+	}
+	nValue = static_cast<int64_t>(nRaw >> 1) ^ -static_cast<int64_t>(nRaw & 1);
+	return true;
+}
+
+bool CBinaryReader::ReadInt(int& nValue)
+{
+	int64_t nRaw = 0;
+	if (!ReadVarInt(nRaw))
+	{
+		return false;
+	}
+	if (nRaw < std::numeric_limits<int>::min() || nRaw > std::numeric_limits<int>::max())
+	{
+		return false;
+	}
+	nValue = static_cast<int>(nRaw);
+	return true;
+}
+
+bool CBinaryReader::ReadString(std::string& strValue)
+{
+	uint64_t nLength = 0;
+	if (!ReadVarUInt(nLength) || nLength > m_nLength - m_nPos)
+	{
+		return false;
+	}
+	strValue.assign(m_pData + m_nPos, static_cast<std::size_t>(nLength));
+	m_nPos += static_cast<std::size_t>(nLength);
+	return true;
+}
+
+bool CBinaryReader::ReadBytes(char* pData, const std::size_t nBufLen, std::size_t& nLength)
+{
+	uint64_t nRawLength = 0;
+	if (!ReadVarUInt(nRawLength) || nRawLength > m_nLength - m_nPos || nRawLength > nBufLen)
+	{
+		return false;
+	}
+	nLength = static_cast<std::size_t>(nRawLength);
+	memcpy(pData, m_pData + m_nPos, nLength);
+	m_nPos += nLength;
+	return true;
+}
+
+void CBinaryWriter::WriteRaw(const char* pData, const std::size_t nLength)
+{
+	m_strData.append(pData, nLength);
+}
+
+bool CBinaryReader::ReadRaw(char* pData, const std::size_t nLength)
+{
+	if (nLength > m_nLength - m_nPos)
+	{
+		return false;
+	}
+	memcpy(pData, m_pData + m_nPos, nLength);
+	m_nPos += nLength;
+	return true;
+}
+
+bool IsFileDataMsgType(const E_MsgType& type)
+{
+	return E_MsgType::FileSendDataReq_Type == type || E_MsgType::FileRecvDataReq_Type == type;
+}
+
+int32_t NegotiateFrameSize(const int32_t nRequest, const int32_t nLimit)
+{
+	if (nRequest <= 0)
+	{
+		return MSG_DEFAULT_FRAME_SIZE;
+	}
+	int32_t nResult = std::min(nRequest, nLimit);
+	nResult = std::min(nResult, MSG_MAX_FRAME_SIZE);
+	return std::max(nResult, MSG_DEFAULT_FRAME_SIZE);
+}
+
+int32_t NegotiateChunkSize(const int32_t nRequest, const int32_t nLimit, const int32_t nFrameSize)
+{
+	if (nRequest <= 0)
+	{
+		return FILE_DATA_CHUNK_SIZE;
+	}
+	int32_t nResult = std::min(nRequest, nLimit);
+	nResult = std::min(nResult, nFrameSize - FILE_DATA_FRAME_RESERVE);
+	nResult = std::min(nResult, FILE_DATA_MAX_CHUNK_SIZE);
+	return std::max(nResult, FILE_DATA_CHUNK_SIZE);
+}
+
+int32_t NegotiateGroupMsgBatch(const int32_t nRequest, const int32_t nLimit)
+{
+	if (nRequest <= 0 || nLimit <= 0)
+	{
+		return 0;
+	}
+	return std::min(std::min(nRequest, nLimit), GROUP_MSG_BATCH_MAX);
+}
+
+int32_t FileDataChunkCount(const int nFileSize, const int32_t nChunkSize)
+{
+	if (nFileSize <= 0 || nChunkSize <= 0)
+	{
+		return 0;
+	}
+	return nFileSize / nChunkSize + (nFileSize % nChunkSize == 0 ? 0 : 1);
+}
+
+//文件数据帧中原始数据之前的部分,nDataLength为之后的原始数据的长度
+template<typename T>
+static void FileDataChunkHead(CBinaryWriter& writer, const T& msg, const int nDataLength) {
+	FileDataChunkHead_t head;
+	head.m_nFileId = msg.m_nFileId;
+	head.m_nDataTotalCount = msg.m_nDataTotalCount;
+	head.m_nDataIndex = msg.m_nDataIndex;
+	head.m_nDataLength = nDataLength;
+	head.m_nChunkSize = msg.m_nChunkSize;
+	writer.WriteRaw(reinterpret_cast<const char*>(&head), sizeof(head));
+	writer.WriteString(msg.m_strMsgId);
+	writer.WriteString(msg.m_strUserId);
+	writer.WriteString(msg.m_strFriendId);
+}
+
+/**
+ * @brief 文件数据帧的编码,固定头部之后是三个ID,最后是不带长度前缀的原始数据,长度由头部给出
+ * 
+ * @param writer 二进制编码器
+ * @param msg 文件数据发送或接收请求消息
+ */
+template<typename T>
+static void FileDataChunk(CBinaryWriter& writer, const T& msg) {
+	const int nDataLength = std::min(msg.m_nDataLength, static_cast<int>(msg.m_dataVec.size()));
+	FileDataChunkHead(writer, msg, nDataLength);
+	writer.WriteRaw(msg.m_dataVec.data(), static_cast<std::size_t>(nDataLength));
+}
+
+template<typename T>
+static bool FileDataChunk(CBinaryReader& reader, T& msg) {
+	FileDataChunkHead_t head;
+	if (!reader.ReadRaw(reinterpret_cast<char*>(&head), sizeof(head)))
+	{
+		return false;
+	}
+	if (head.m_nChunkSize <= 0 || head.m_nChunkSize > FILE_DATA_MAX_CHUNK_SIZE ||
+		head.m_nDataLength < 0 || head.m_nDataLength > head.m_nChunkSize)
+	{
+		return false;
+	}
+	msg.m_nFileId = head.m_nFileId;
+	msg.m_nDataTotalCount = head.m_nDataTotalCount;
+	msg.m_nDataIndex = head.m_nDataIndex;
+	msg.m_nDataLength = head.m_nDataLength;
+	msg.m_nChunkSize = head.m_nChunkSize;
+	msg.m_dataVec.resize(static_cast<std::size_t>(head.m_nDataLength));
+	return reader.ReadString(msg.m_strMsgId) &&
+		reader.ReadString(msg.m_strUserId) &&
+		reader.ReadString(msg.m_strFriendId) &&
+		reader.ReadRaw(msg.m_dataVec.data(), msg.m_dataVec.size());
+}
+
+std::string FileDataFramePrefix(const FileDataRecvReqMsg& msg)
+{
+	const int nDataLength = std::max(msg.m_nDataLength, 0);
+	CBinaryWriter writer;
+	FileDataChunkHead(writer, msg, nDataLength);
+	Header head;
+	head.m_type = static_cast<int32_t>(msg.GetMsgType()) | MSG_FLAG_BINARY;
+	head.m_length = static_cast<int32_t>(sizeof(head) + writer.Data().length() + static_cast<std::size_t>(nDataLength));
+	std::string strPrefix(reinterpret_cast<const char*>(&head), sizeof(head));
+	return strPrefix + writer.Data();
+}
+
+static void FriendChatMsg(CBinaryWriter& writer, const FriendChatMsg_s& chatMsg) {
+	writer.WriteString(chatMsg.m_strChatMsgId);
+	writer.WriteString(chatMsg.m_strSenderId);
+	writer.WriteString(chatMsg.m_strReceiverId);
+	writer.WriteString(chatMsg.m_strContext);
+	writer.WriteString(chatMsg.m_strMsgTime);
+	chatMsg.m_fontInfo.ToBinary(writer);
+}
+
+static bool FriendChatMsg(CBinaryReader& reader, FriendChatMsg_s& chatMsg) {
+	return reader.ReadString(chatMsg.m_strChatMsgId) &&
+		reader.ReadString(chatMsg.m_strSenderId) &&
+		reader.ReadString(chatMsg.m_strReceiverId) &&
+		reader.ReadString(chatMsg.m_strContext) &&
+		reader.ReadString(chatMsg.m_strMsgTime) &&
+		chatMsg.m_fontInfo.FromBinary(reader);
+}
+
+static void GroupChatMsg(CBinaryWriter& writer, const GroupChatMsg_s& chatMsg) {
+	writer.WriteString(chatMsg.m_strChatMsgId);
+	writer.WriteString(chatMsg.m_strSenderId);
+	writer.WriteString(chatMsg.m_strGroupId);
+	writer.WriteString(chatMsg.m_strContext);
+	writer.WriteString(chatMsg.m_strMsgTime);
+	chatMsg.m_fontInfo.ToBinary(writer);
+}
+
+static bool GroupChatMsg(CBinaryReader& reader, GroupChatMsg_s& chatMsg) {
+	return reader.ReadString(chatMsg.m_strChatMsgId) &&
+		reader.ReadString(chatMsg.m_strSenderId) &&
+		reader.ReadString(chatMsg.m_strGroupId) &&
+		reader.ReadString(chatMsg.m_strContext) &&
+		reader.ReadString(chatMsg.m_strMsgTime) &&
+		chatMsg.m_fontInfo.FromBinary(reader);
+}
+
+
 E_MsgType TransBaseMsg_t::GetType() const 
 {
     Header* head = reinterpret_cast<Header*>(m_data);
-    return static_cast<E_MsgType>(head->m_type);
+    return static_cast<E_MsgType>(head->m_type & MSG_TYPE_MASK);
 }
 
 std::size_t TransBaseMsg_t::GetSize() const
@@ -152,22 +428,84 @@ const char * TransBaseMsg_t::GetData() const
 }
 
 TransBaseMsg_t::TransBaseMsg_t(const E_MsgType& type, const std::string& strMsg)
+{
+    Init(static_cast<int32_t>(type), strMsg);
+}
+
+TransBaseMsg_t::TransBaseMsg_t(const BaseMsg& msg, const bool bBinary)
+{
+    //没有二进制编码的消息把json串包在二进制帧中比直接发送json更慢,仍然发送json
+    if (bBinary && msg.HasBinary())
+    {
+        CBinaryWriter writer;
+        msg.ToBinary(writer);
+        Init(static_cast<int32_t>(msg.GetMsgType()) | MSG_FLAG_BINARY, writer.Data());
+    }
+    else
+    {
+        Init(static_cast<int32_t>(msg.GetMsgType()), msg.ToString());
+    }
+}
+
+TransBaseMsg_t::TransBaseMsg_t(const char * data)
+{
+    m_data = const_cast<char*>(data);
+    m_selfData = false;
+}
+
+TransBaseMsg_t::TransBaseMsg_t(const std::shared_ptr<const void>& pOwner, const char * data):m_pOwner(pOwner)
+{
+    m_data = const_cast<char*>(data);
+    m_selfData = false;
+}
+
+TransBaseMsg_t::TransBaseMsg_t(const TransBaseMsg_t& other)
+{
+    std::size_t nSize = other.GetSize();
+    m_data = new char[nSize];
+    memcpy(m_data, other.GetData(), nSize);
+    m_selfData = true;
+}
+
+void TransBaseMsg_t::Init(const int32_t nType, const std::string& strMsg)
 {
     std::size_t strLen = strMsg.length();
     Header head;
-    head.m_type = static_cast<uint32_t>(type);
-    head.m_length = static_cast<uint32_t>(strLen + sizeof(head));
+    head.m_type = nType;
+    head.m_length = static_cast<int32_t>(strLen + sizeof(head));
     m_data = new char[head.m_length];
-    memset(m_data, 0, head.m_length);
     memcpy(m_data, &head, sizeof(head));
     memcpy(m_data + sizeof(head), strMsg.c_str(), strLen);
     m_selfData = true;
 }
 
-TransBaseMsg_t::TransBaseMsg_t(const char * data)
+bool TransBaseMsg_t::IsBinary() const
 {
-    m_data = const_cast<char*>(data);
-    m_selfData = false;
+    Header* head = reinterpret_cast<Header*>(m_data);
+    return 0 != (head->m_type & MSG_FLAG_BINARY);
+}
+
+bool TransBaseMsg_t::DecodeMsg(BaseMsg& msg) const
+{
+    if (GetSize() < sizeof(Header))
+    {
+        return false;
+    }
+    if (IsBinary())
+    {
+        CBinaryReader reader(m_data + sizeof(Header), GetSize() - sizeof(Header));
+        return msg.FromBinary(reader);
+    }
+    return msg.FromString(to_string());
+}
+
+std::string TransBaseMsg_t::ToPrintString() const
+{
+    if (IsBinary())
+    {
+        return "BINARY:" + std::to_string(GetSize());
+    }
+    return to_string();
 }
 
 TransBaseMsg_t::~TransBaseMsg_t()
@@ -176,7 +514,7 @@ TransBaseMsg_t::~TransBaseMsg_t()
     {
         if(nullptr != m_data)
         {
-            delete m_data;
+            delete[] m_data;
             m_data = nullptr;
         }
     }
@@ -362,6 +700,20 @@ bool KeepAliveReqMsg::FromString(const std::string &strJson)
     return true;
 }
 
+void KeepAliveReqMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strClientId);
+}
+
+bool KeepAliveReqMsg::FromBinary(CBinaryReader& reader)
+{
+	if (!reader.ReadString(m_strClientId))
+	{
+		return false;
+	}
+	return !m_strClientId.empty();
+}
+
 
 KeepAliveRspMsg::KeepAliveRspMsg()
 {
@@ -411,6 +763,20 @@ bool KeepAliveRspMsg::FromString(const std::string &strJson)
     return true;
 }
 
+void KeepAliveRspMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strClientId);
+}
+
+bool KeepAliveRspMsg::FromBinary(CBinaryReader& reader)
+{
+	if (!reader.ReadString(m_strClientId))
+	{
+		return false;
+	}
+	return !m_strClientId.empty();
+}
+
 
 
 
@@ -422,6 +788,9 @@ UserLoginReqMsg::UserLoginReqMsg()
     m_eOsType = CLIENT_OS_TYPE::OS_TYPE_UNKNOWN;
     m_eOnlineType = CLIENT_STATE::C_STATE_OFFLINE;
     m_eNetType = CLIENT_NET_TYPE::C_NET_TYPE_UNKNOWN;
+    m_nMaxFrameSize = 0;
+    m_nChunkSize = 0;
+    m_nGroupMsgBatch = 0;
 }
 
 std::string UserLoginReqMsg::ToString() const
@@ -435,6 +804,9 @@ std::string UserLoginReqMsg::ToString() const
         {"OsType", static_cast<int>(m_eOsType)},
         {"NetType", static_cast<int>(m_eNetType)},
         {"OnlineType", static_cast<int>(m_eOnlineType)},
+        {"MaxFrameSize", m_nMaxFrameSize},
+        {"ChunkSize", m_nChunkSize},
+        {"GroupMsgBatch", m_nGroupMsgBatch},
     });
 
     return clientObj.dump();
@@ -504,6 +876,22 @@ bool UserLoginReqMsg::FromString(const std::string &strJson)
         return false;
     }
 
+    //旧版本的登录消息不协商消息长度
+    if (json["MaxFrameSize"].is_number())
+    {
+        m_nMaxFrameSize = json["MaxFrameSize"].int_value();
+    }
+
+    if (json["ChunkSize"].is_number())
+    {
+        m_nChunkSize = json["ChunkSize"].int_value();
+    }
+
+    if (json["GroupMsgBatch"].is_number())
+    {
+        m_nGroupMsgBatch = json["GroupMsgBatch"].int_value();
+    }
+
     return true;
 }
 
@@ -532,6 +920,10 @@ UserLoginRspMsg::UserLoginRspMsg()
 {
     m_eErrCode = ERROR_CODE_TYPE::E_CODE_LOGIN_FAILED;
     m_type = E_MsgType::UserLoginRsp_Type;
+    m_nMaxFrameSize = MSG_DEFAULT_FRAME_SIZE;
+    m_nChunkSize = FILE_DATA_CHUNK_SIZE;
+    m_nGroupMsgBatch = 0;
+    m_bBinaryCodec = false;
 }
 
 std::string UserLoginRspMsg::ToString() const
@@ -556,7 +948,11 @@ std::string UserLoginRspMsg::ToString() const
         {"code", static_cast<int>(m_eErrCode)},
         {"message", m_strErrMsg},
         {"MsgId", m_strMsgId},
-        {"Info", itemObj}
+        {"Info", itemObj},
+        {"MaxFrameSize", m_nMaxFrameSize},
+        {"ChunkSize", m_nChunkSize},
+        {"GroupMsgBatch", m_nGroupMsgBatch},
+        {"BinaryCodec", m_bBinaryCodec},
     });
 
     return clientObj.dump();
@@ -694,6 +1090,28 @@ bool UserLoginRspMsg::FromString(const std::string &strJson)
         }
     }
 
+    //旧版本的服务器不协商消息长度
+    if (json["MaxFrameSize"].is_number())
+    {
+        m_nMaxFrameSize = json["MaxFrameSize"].int_value();
+    }
+
+    if (json["ChunkSize"].is_number())
+    {
+        m_nChunkSize = json["ChunkSize"].int_value();
+    }
+
+    if (json["GroupMsgBatch"].is_number())
+    {
+        m_nGroupMsgBatch = json["GroupMsgBatch"].int_value();
+    }
+
+    //旧版本的服务器不回复编码方式,客户端继续使用json
+    if (json["BinaryCodec"].is_bool())
+    {
+        m_bBinaryCodec = json["BinaryCodec"].bool_value();
+    }
+
     return true;
 }
 
@@ -1344,6 +1762,22 @@ std::string FontInfo_s::ToString() const
 	return clientObj.dump();
 }
 
+void FontInfo_s::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strFontName);
+	writer.WriteVarInt(m_nFontSize);
+	writer.WriteString(m_strFontColorHex);
+	writer.WriteVarInt(m_nFontStyle);
+}
+
+bool FontInfo_s::FromBinary(CBinaryReader& reader)
+{
+	return reader.ReadString(m_strFontName) &&
+		reader.ReadInt(m_nFontSize) &&
+		reader.ReadString(m_strFontColorHex) &&
+		reader.ReadInt(m_nFontStyle);
+}
+
 
 FriendChatSendTxtReqMsg::FriendChatSendTxtReqMsg()
 {
@@ -1425,6 +1859,24 @@ bool  FriendChatSendTxtReqMsg::FromString(const std::string &strJson)
     return true;
 }
 
+void FriendChatSendTxtReqMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	writer.WriteString(m_strSenderId);
+	writer.WriteString(m_strReceiverId);
+	writer.WriteString(m_strContext);
+	m_fontInfo.ToBinary(writer);
+}
+
+bool FriendChatSendTxtReqMsg::FromBinary(CBinaryReader& reader)
+{
+	return reader.ReadString(m_strMsgId) &&
+		reader.ReadString(m_strSenderId) &&
+		reader.ReadString(m_strReceiverId) &&
+		reader.ReadString(m_strContext) &&
+		m_fontInfo.FromBinary(reader);
+}
+
 bool  FriendChatSendTxtReqMsg::Valid() const
 {
     if (m_strMsgId.empty())
@@ -1520,6 +1972,28 @@ bool FriendChatSendTxtRspMsg::FromString(const std::string &strJson)
     return true;
 }
 
+void FriendChatSendTxtRspMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	writer.WriteVarInt(static_cast<int>(m_eErrCode));
+	writer.WriteString(m_strErrMsg);
+	FriendChatMsg(writer, m_chatMsg);
+}
+
+bool FriendChatSendTxtRspMsg::FromBinary(CBinaryReader& reader)
+{
+	int nErrCode = 0;
+	if (!(reader.ReadString(m_strMsgId) &&
+		reader.ReadInt(nErrCode) &&
+		reader.ReadString(m_strErrMsg) &&
+		FriendChatMsg(reader, m_chatMsg)))
+	{
+		return false;
+	}
+	m_eErrCode = static_cast<ERROR_CODE_TYPE>(nErrCode);
+	return true;
+}
+
 bool FriendChatSendTxtRspMsg::Valid() const
 {
     if (m_strMsgId.empty())
@@ -1571,6 +2045,18 @@ bool FriendChatRecvTxtReqMsg::FromString(const std::string &strJson)
     return true;
 }
 
+void FriendChatRecvTxtReqMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	FriendChatMsg(writer, m_chatMsg);
+}
+
+bool FriendChatRecvTxtReqMsg::FromBinary(CBinaryReader& reader)
+{
+	return reader.ReadString(m_strMsgId) &&
+		FriendChatMsg(reader, m_chatMsg);
+}
+
 
 bool FriendChatRecvTxtReqMsg::Valid() const
 {
@@ -1647,6 +2133,22 @@ bool FriendChatRecvTxtRspMsg::FromString(const std::string &strJson)
     return true;
 }
 
+void FriendChatRecvTxtRspMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	writer.WriteString(m_strUserId);
+	writer.WriteString(m_strFriendId);
+	writer.WriteString(m_strChatMsgId);
+}
+
+bool FriendChatRecvTxtRspMsg::FromBinary(CBinaryReader& reader)
+{
+	return reader.ReadString(m_strMsgId) &&
+		reader.ReadString(m_strUserId) &&
+		reader.ReadString(m_strFriendId) &&
+		reader.ReadString(m_strChatMsgId);
+}
+
 bool FriendChatRecvTxtRspMsg::Valid() const
 {
     if (m_strMsgId.empty())
@@ -5263,6 +5765,18 @@ bool SendGroupTextMsgReqMsg::FromString(const std::string &strJson)
     return true;
 }
 
+void SendGroupTextMsgReqMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	GroupChatMsg(writer, m_chatMsg);
+}
+
+bool SendGroupTextMsgReqMsg::FromBinary(CBinaryReader& reader)
+{
+	return reader.ReadString(m_strMsgId) &&
+		GroupChatMsg(reader, m_chatMsg);
+}
+
 
 SendGroupTextMsgRspMsg::SendGroupTextMsgRspMsg()
 {
@@ -5334,6 +5848,28 @@ bool SendGroupTextMsgRspMsg::FromString(const std::string &strJson)
     return true;
 }
 
+void SendGroupTextMsgRspMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	writer.WriteVarInt(static_cast<int>(m_eErrCode));
+	writer.WriteString(m_errMsg);
+	GroupChatMsg(writer, m_chatMsg);
+}
+
+bool SendGroupTextMsgRspMsg::FromBinary(CBinaryReader& reader)
+{
+	int nErrCode = 0;
+	if (!(reader.ReadString(m_strMsgId) &&
+		reader.ReadInt(nErrCode) &&
+		reader.ReadString(m_errMsg) &&
+		GroupChatMsg(reader, m_chatMsg)))
+	{
+		return false;
+	}
+	m_eErrCode = static_cast<ERROR_CODE_TYPE>(nErrCode);
+	return true;
+}
+
 
 RecvGroupTextMsgReqMsg::RecvGroupTextMsgReqMsg()
 {
@@ -5396,7 +5932,153 @@ bool RecvGroupTextMsgReqMsg::FromString(const std::string &strJson)
     return true;
 }
 
+void RecvGroupTextMsgReqMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	writer.WriteString(m_strUserId);
+	GroupChatMsg(writer, m_chatMsg);
+}
+
+bool RecvGroupTextMsgReqMsg::FromBinary(CBinaryReader& reader)
+{
+	return reader.ReadString(m_strMsgId) &&
+		reader.ReadString(m_strUserId) &&
+		GroupChatMsg(reader, m_chatMsg);
+}
+
+
+
+RecvGroupTextMsgBatchReqMsg::RecvGroupTextMsgBatchReqMsg()
+{
+	m_type = E_MsgType::RecvGroupTextMsgBatchReq_Type;
+}
+
+std::string RecvGroupTextMsgBatchReqMsg::ToString() const
+{
+	using namespace json11;
+	Json::array chatMsgArray;
+	for (const auto& item : m_chatMsgVec)
+	{
+		chatMsgArray.push_back(GroupChatMsg(item));
+	}
+	Json clientObj = Json::object(
+	{
+		{"MsgId", m_strMsgId},
+		{"UserId", m_strUserId},
+		{"GroupId", m_strGroupId},
+		{"LastChatMsgId", m_strLastChatMsgId},
+		{"ChatMsgList", chatMsgArray},
+	});
+	return clientObj.dump();
+}
+
+bool RecvGroupTextMsgBatchReqMsg::FromString(const std::string &strJson)
+{
+	std::string err;
+	using namespace json11;
+	auto json = Json::parse(strJson, err);
+	if (!err.empty())
+	{
+		return false;
+	}
+
+	if (json["MsgId"].is_string())
+	{
+		m_strMsgId = json["MsgId"].string_value();
+	}
+	else
+	{
+		return false;
+	}
+
+	if (json["UserId"].is_string())
+	{
+		m_strUserId = json["UserId"].string_value();
+	}
+	else
+	{
+		return false;
+	}
+
+	if (json["GroupId"].is_string())
+	{
+		m_strGroupId = json["GroupId"].string_value();
+	}
+	else
+	{
+		return false;
+	}
+
+	if (json["LastChatMsgId"].is_string())
+	{
+		m_strLastChatMsgId = json["LastChatMsgId"].string_value();
+	}
+	else
+	{
+		return false;
+	}
+
+	if (json["ChatMsgList"].is_array())
+	{
+		m_chatMsgVec.clear();
+		for (const auto& item : json["ChatMsgList"].array_items())
+		{
+			GroupChatMsg_s chatMsg;
+			if (!GroupChatMsg(item, chatMsg))
+			{
+				return false;
+			}
+			m_chatMsgVec.push_back(chatMsg);
+		}
+	}
+	else
+	{
+		return false;
+	}
 
+	return true;
+}
+
+void RecvGroupTextMsgBatchReqMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	writer.WriteString(m_strUserId);
+	writer.WriteString(m_strGroupId);
+	writer.WriteString(m_strLastChatMsgId);
+	writer.WriteVarUInt(m_chatMsgVec.size());
+	for (const auto& item : m_chatMsgVec)
+	{
+		GroupChatMsg(writer, item);
+	}
+}
+
+bool RecvGroupTextMsgBatchReqMsg::FromBinary(CBinaryReader& reader)
+{
+	uint64_t nCount = 0;
+	if (!(reader.ReadString(m_strMsgId) &&
+		reader.ReadString(m_strUserId) &&
+		reader.ReadString(m_strGroupId) &&
+		reader.ReadString(m_strLastChatMsgId) &&
+		reader.ReadVarUInt(nCount)))
+	{
+		return false;
+	}
+	//每条消息至少占用一个字节,防止错误的条数导致分配过多内存
+	if (nCount > reader.Remain())
+	{
+		return false;
+	}
+	m_chatMsgVec.clear();
+	m_chatMsgVec.resize(static_cast<std::size_t>(nCount));
+	for (auto& item : m_chatMsgVec)
+	{
+		if (!GroupChatMsg(reader, item))
+		{
+			return false;
+		}
+	}
+	return true;
+}
 
 RecvGroupTextMsgRspMsg::RecvGroupTextMsgRspMsg()
 {
@@ -5466,6 +6148,22 @@ bool RecvGroupTextMsgRspMsg::FromString(const std::string &strJson)
     return true;
 }
 
+void RecvGroupTextMsgRspMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	writer.WriteString(m_strUserId);
+	writer.WriteString(m_strGroupId);
+	writer.WriteString(m_strChatMsgId);
+}
+
+bool RecvGroupTextMsgRspMsg::FromBinary(CBinaryReader& reader)
+{
+	return reader.ReadString(m_strMsgId) &&
+		reader.ReadString(m_strUserId) &&
+		reader.ReadString(m_strGroupId) &&
+		reader.ReadString(m_strChatMsgId);
+}
+
 
 
 FriendSendFileMsgReqMsg::FriendSendFileMsgReqMsg()
@@ -6267,7 +6965,7 @@ bool GetGroupListRspMsg::FromString(const std::string &strJson)
 }
 
 
-FileDataSendReqMsg::FileDataSendReqMsg()
+FileDataSendReqMsg::FileDataSendReqMsg():m_nFileId(0),m_nDataTotalCount(0),m_nDataIndex(0),m_nDataLength(0),m_nChunkSize(FILE_DATA_CHUNK_SIZE)
 {
     m_type = E_MsgType::FileSendDataReq_Type;
 }
@@ -6275,7 +6973,7 @@ FileDataSendReqMsg::FileDataSendReqMsg()
 std::string FileDataSendReqMsg::ToString() const
 {
     using namespace json11;
-    std::string strData(m_szData, m_nDataLength);
+    std::string strData(m_dataVec.data(), std::min(static_cast<std::size_t>(m_nDataLength), m_dataVec.size()));
     Json clientObj = Json::object(
     {
         {"MsgId", m_strMsgId},
@@ -6285,6 +6983,7 @@ std::string FileDataSendReqMsg::ToString() const
         {"DataTotalCount", m_nDataTotalCount},
         {"DataIndex", m_nDataIndex},
         {"DataLength", m_nDataLength},
+        {"ChunkSize", m_nChunkSize},
         {"Data", StringToHex(strData)},
     });
     return clientObj.dump();
@@ -6361,13 +7060,26 @@ bool FileDataSendReqMsg::FromString(const std::string &strJson)
         return false;
     }
 
+    //旧版本的文件数据没有分包大小
+    if (json["ChunkSize"].is_number())
+    {
+        m_nChunkSize = json["ChunkSize"].int_value();
+    }
+
+    //与二进制解码的检查一致,分包大小决定数据写入文件的偏移
+    if (m_nChunkSize <= 0 || m_nChunkSize > FILE_DATA_MAX_CHUNK_SIZE ||
+        m_nDataLength < 0 || m_nDataLength > m_nChunkSize)
+    {
+        return false;
+    }
+
     if (json["Data"].is_string())
     {
         std::string strHex = json["Data"].string_value();
         std::string strData = HexToString(strHex);
-        if (strData.length() <= 1024)
+        if (strData.length() <= static_cast<std::size_t>(m_nChunkSize))
         {
-            memcpy(m_szData, strData.data(), strData.length());
+            m_dataVec.assign(strData.begin(), strData.end());
         }
         else
         {
@@ -6383,7 +7095,17 @@ bool FileDataSendReqMsg::FromString(const std::string &strJson)
 }
 
 
-FileDataSendRspMsg::FileDataSendRspMsg()
+void FileDataSendReqMsg::ToBinary(CBinaryWriter& writer) const
+{
+	FileDataChunk(writer, *this);
+}
+
+bool FileDataSendReqMsg::FromBinary(CBinaryReader& reader)
+{
+	return FileDataChunk(reader, *this);
+}
+
+FileDataSendRspMsg::FileDataSendRspMsg():m_nFileId(0),m_nDataTotalCount(0),m_nDataIndex(0),m_nCumAckIndex(0)
 {
     m_type = E_MsgType::FileSendDataRsp_Type;
 }
@@ -6400,6 +7122,7 @@ std::string FileDataSendRspMsg::ToString() const
         {"FileId", m_nFileId},
         {"DataTotalCount", m_nDataTotalCount},
         {"DataIndex", m_nDataIndex},
+        {"CumAckIndex", m_nCumAckIndex},
     });
     return clientObj.dump();
 }
@@ -6468,11 +7191,39 @@ bool FileDataSendRspMsg::FromString(const std::string &strJson)
         return false;
     }
 
+    //旧版本的确认消息没有累计确认
+    if (json["CumAckIndex"].is_number())
+    {
+        m_nCumAckIndex = json["CumAckIndex"].int_value();
+    }
+
     return true;
 }
 
+void FileDataSendRspMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	writer.WriteString(m_strUserId);
+	writer.WriteString(m_strFriendId);
+	writer.WriteVarInt(m_nFileId);
+	writer.WriteVarInt(m_nDataTotalCount);
+	writer.WriteVarInt(m_nDataIndex);
+	writer.WriteVarInt(m_nCumAckIndex);
+}
+
+bool FileDataSendRspMsg::FromBinary(CBinaryReader& reader)
+{
+	return reader.ReadString(m_strMsgId) &&
+		reader.ReadString(m_strUserId) &&
+		reader.ReadString(m_strFriendId) &&
+		reader.ReadInt(m_nFileId) &&
+		reader.ReadInt(m_nDataTotalCount) &&
+		reader.ReadInt(m_nDataIndex) &&
+		reader.ReadInt(m_nCumAckIndex);
+}
 
-FileDataRecvReqMsg::FileDataRecvReqMsg()
+
+FileDataRecvReqMsg::FileDataRecvReqMsg():m_nFileId(0),m_nDataTotalCount(0),m_nDataIndex(0),m_nDataLength(0),m_nChunkSize(FILE_DATA_CHUNK_SIZE)
 {
     m_type = E_MsgType::FileRecvDataReq_Type;
 }
@@ -6480,7 +7231,7 @@ FileDataRecvReqMsg::FileDataRecvReqMsg()
 std::string FileDataRecvReqMsg::ToString() const
 {
     using namespace json11;
-    std::string strData(m_szData, m_nDataLength);
+    std::string strData(m_dataVec.data(), std::min(static_cast<std::size_t>(m_nDataLength), m_dataVec.size()));
     Json clientObj = Json::object(
     {
         {"MsgId", m_strMsgId},
@@ -6490,6 +7241,7 @@ std::string FileDataRecvReqMsg::ToString() const
         {"DataTotalCount", m_nDataTotalCount},
         {"DataIndex", m_nDataIndex},
         {"DataLength", m_nDataLength},
+        {"ChunkSize", m_nChunkSize},
         {"Data", StringToHex(strData)},
     });
     return clientObj.dump();
@@ -6565,12 +7317,25 @@ bool FileDataRecvReqMsg::FromString(const std::string &strJson)
     {
         return false;
     }
+    //旧版本的文件数据没有分包大小
+    if (json["ChunkSize"].is_number())
+    {
+        m_nChunkSize = json["ChunkSize"].int_value();
+    }
+
+    //与二进制解码的检查一致,分包大小决定数据写入文件的偏移
+    if (m_nChunkSize <= 0 || m_nChunkSize > FILE_DATA_MAX_CHUNK_SIZE ||
+        m_nDataLength < 0 || m_nDataLength > m_nChunkSize)
+    {
+        return false;
+    }
+
     if (json["Data"].is_string())
     {
         std::string strData = HexToString(json["Data"].string_value());
-        if (strData.length() <= 1024)
+        if (strData.length() <= static_cast<std::size_t>(m_nChunkSize))
         {
-            memcpy(m_szData, strData.data(), strData.length());
+            m_dataVec.assign(strData.begin(), strData.end());
         }
         else
         {
@@ -6586,7 +7351,17 @@ bool FileDataRecvReqMsg::FromString(const std::string &strJson)
 }
 
 
-FileDataRecvRspMsg::FileDataRecvRspMsg()
+void FileDataRecvReqMsg::ToBinary(CBinaryWriter& writer) const
+{
+	FileDataChunk(writer, *this);
+}
+
+bool FileDataRecvReqMsg::FromBinary(CBinaryReader& reader)
+{
+	return FileDataChunk(reader, *this);
+}
+
+FileDataRecvRspMsg::FileDataRecvRspMsg():m_nFileId(0),m_nDataTotalCount(0),m_nDataIndex(0),m_nCumAckIndex(0)
 {
     m_type = E_MsgType::FileRecvDataRsp_Type;
 }
@@ -6603,6 +7378,7 @@ std::string FileDataRecvRspMsg::ToString() const
         {"FileId", m_nFileId},
         {"DataTotalCount", m_nDataTotalCount},
         {"DataIndex", m_nDataIndex},
+        {"CumAckIndex", m_nCumAckIndex},
     });
     return clientObj.dump();
 }
@@ -6671,9 +7447,37 @@ bool FileDataRecvRspMsg::FromString(const std::string &strJson)
         return false;
     }
 
+    //旧版本的确认消息没有累计确认
+    if (json["CumAckIndex"].is_number())
+    {
+        m_nCumAckIndex = json["CumAckIndex"].int_value();
+    }
+
     return true;
 }
 
+void FileDataRecvRspMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	writer.WriteString(m_strUserId);
+	writer.WriteString(m_strFriendId);
+	writer.WriteVarInt(m_nFileId);
+	writer.WriteVarInt(m_nDataTotalCount);
+	writer.WriteVarInt(m_nDataIndex);
+	writer.WriteVarInt(m_nCumAckIndex);
+}
+
+bool FileDataRecvRspMsg::FromBinary(CBinaryReader& reader)
+{
+	return reader.ReadString(m_strMsgId) &&
+		reader.ReadString(m_strUserId) &&
+		reader.ReadString(m_strFriendId) &&
+		reader.ReadInt(m_nFileId) &&
+		reader.ReadInt(m_nDataTotalCount) &&
+		reader.ReadInt(m_nDataIndex) &&
+		reader.ReadInt(m_nCumAckIndex);
+}
+
 
 
 FileVerifyReqMsg::FileVerifyReqMsg()
@@ -8251,7 +9055,7 @@ bool AsyncGroupChatMsgRsp::FromString(const std::string& strJson)
 	return true;
 }
 
-FileSendDataBeginReq::FileSendDataBeginReq()
+FileSendDataBeginReq::FileSendDataBeginReq():m_nFileId(0),m_eFileType(FILE_TYPE::FILE_TYPE_FILE),m_nFileSize(0),m_nChunkSize(0),m_bProofSupport(false)
 {
 	m_type = E_MsgType::FileSendDataBeginReq_Type;
 }
@@ -8268,7 +9072,17 @@ std::string FileSendDataBeginReq::ToString() const
 		{"FileId",m_nFileId},
 		{"FileHash",m_strFileHash},
 		{"FileType",static_cast<int>(m_eFileType)},
+		{"FileSize",m_nFileSize},
+		{"ChunkSize",m_nChunkSize},
+		{"ProofSupport",m_bProofSupport},
 		});
+	if (!m_strFileProof.empty())
+	{
+		auto msgObj = msgJson.object_items();
+		msgObj["ProofSalt"] = m_strProofSalt;
+		msgObj["FileProof"] = m_strFileProof;
+		return Json(msgObj).dump();
+	}
 	return msgJson.dump();
 }
 
@@ -8339,11 +9153,25 @@ bool FileSendDataBeginReq::FromString(const std::string& strJson)
 	{
 		return false;
 	}
+
+	//旧版本没有文件大小和数据包长度,不续传
+	if (json["FileSize"].is_number())
+	{
+		m_nFileSize = json["FileSize"].int_value();
+	}
+	if (json["ChunkSize"].is_number())
+	{
+		m_nChunkSize = json["ChunkSize"].int_value();
+	}
+	//旧版本不支持秒传的持有证明
+	m_bProofSupport = json["ProofSupport"].is_bool() && json["ProofSupport"].bool_value();
+	m_strProofSalt = json["ProofSalt"].string_value();
+	m_strFileProof = json["FileProof"].string_value();
 	return true;
 }
 
 
-FileSendDataBeginRsp::FileSendDataBeginRsp()
+FileSendDataBeginRsp::FileSendDataBeginRsp():m_errCode(ERROR_CODE_TYPE::E_CODE_SUCCEED),m_nFileId(0),m_eFileType(FILE_TYPE::FILE_TYPE_FILE),m_bResume(false),m_nChunkSize(0)
 {
 	m_type = E_MsgType::FileSendDataBeginRsp_Type;
 }
@@ -8361,6 +9189,25 @@ std::string FileSendDataBeginRsp::ToString() const
 		{"FileId",m_nFileId},
 		{"FileType",static_cast<int>(m_eFileType)},
 	});
+	if (m_bResume)
+	{
+		Json::array rangeArray;
+		for (const auto& range : m_missingRangeVec)
+		{
+			rangeArray.push_back(Json::array({ range.first, range.second }));
+		}
+		auto msgObj = msgJson.object_items();
+		msgObj["Resume"] = true;
+		msgObj["ChunkSize"] = m_nChunkSize;
+		msgObj["MissingRanges"] = rangeArray;
+		return Json(msgObj).dump();
+	}
+	if (!m_strProofSalt.empty())
+	{
+		auto msgObj = msgJson.object_items();
+		msgObj["ProofSalt"] = m_strProofSalt;
+		return Json(msgObj).dump();
+	}
 	return msgJson.dump();
 }
 
@@ -8438,6 +9285,31 @@ bool FileSendDataBeginRsp::FromString(const std::string& strJson)
 	{
 		return false;
 	}
+
+	m_strProofSalt = json["ProofSalt"].string_value();
+	//旧版本的接收端不续传,没有以下字段
+	m_bResume = json["Resume"].is_bool() && json["Resume"].bool_value();
+	m_missingRangeVec.clear();
+	if (m_bResume)
+	{
+		if (json["ChunkSize"].is_number() && json["MissingRanges"].is_array())
+		{
+			m_nChunkSize = json["ChunkSize"].int_value();
+			for (const auto& rangeJson : json["MissingRanges"].array_items())
+			{
+				if (!rangeJson.is_array() || rangeJson.array_items().size() != 2 ||
+					!rangeJson[0].is_number() || !rangeJson[1].is_number())
+				{
+					return false;
+				}
+				m_missingRangeVec.push_back({ rangeJson[0].int_value(), rangeJson[1].int_value() });
+			}
+		}
+		else
+		{
+			return false;
+		}
+	}
 	return true;
 }
 
@@ -9241,6 +10113,20 @@ bool NotifyGroupMsgReqMsg::FromString(const std::string &strJson)
 	return true;
 }
 
+void NotifyGroupMsgReqMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	writer.WriteString(m_strUserId);
+	writer.WriteString(m_strGroupId);
+}
+
+bool NotifyGroupMsgReqMsg::FromBinary(CBinaryReader& reader)
+{
+	return reader.ReadString(m_strMsgId) &&
+		reader.ReadString(m_strUserId) &&
+		reader.ReadString(m_strGroupId);
+}
+
 NotifyGroupMsgRspMsg::NotifyGroupMsgRspMsg()
 {
 	m_type = E_MsgType::NotifyGroupMsgRsp_Type;
@@ -9297,6 +10183,20 @@ bool NotifyGroupMsgRspMsg::FromString(const std::string &strJson)
 	return true;
 }
 
+void NotifyGroupMsgRspMsg::ToBinary(CBinaryWriter& writer) const
+{
+	writer.WriteString(m_strMsgId);
+	writer.WriteString(m_strUserId);
+	writer.WriteString(m_strGroupId);
+}
+
+bool NotifyGroupMsgRspMsg::FromBinary(CBinaryReader& reader)
+{
+	return reader.ReadString(m_strMsgId) &&
+		reader.ReadString(m_strUserId) &&
+		reader.ReadString(m_strGroupId);
+}
+
 
 FriendStateChangeNotifyReqMsg::FriendStateChangeNotifyReqMsg()
 {
@@ -9742,4 +10642,262 @@ bool GroupTransFileResultNotifyReqMsg::FromString(const std::string &strJson)
 //		return false;
 //	}
 //	return true;
-//}
\ No newline at end of file
+//}
+
+
+/**
+ * @brief 根据消息类型创建对应的消息对象
+ * 
+ * @param type 消息类型
+ * @return std::shared_ptr<BaseMsg> 未知的类型返回nullptr
+ */
+std::shared_ptr<BaseMsg> CreateMsgByType(const E_MsgType& type)
+{
+	switch (type)
+	{
+	case E_MsgType::NetFailedReport_Type:
+		return std::make_shared<NetFailedReportMsg>();
+	case E_MsgType::NetRecoverReport_Type:
+		return std::make_shared<NetRecoverReportMsg>();
+	case E_MsgType::KeepAliveReq_Type:
+		return std::make_shared<KeepAliveReqMsg>();
+	case E_MsgType::KeepAliveRsp_Type:
+		return std::make_shared<KeepAliveRspMsg>();
+	case E_MsgType::UserLoginReq_Type:
+		return std::make_shared<UserLoginReqMsg>();
+	case E_MsgType::UserLoginRsp_Type:
+		return std::make_shared<UserLoginRspMsg>();
+	case E_MsgType::UserLogoutReq_Type:
+		return std::make_shared<UserLogoutReqMsg>();
+	case E_MsgType::UserLogoutRsp_Type:
+		return std::make_shared<UserLogoutRspMsg>();
+	case E_MsgType::UserRegisterReq_Type:
+		return std::make_shared<UserRegisterReqMsg>();
+	case E_MsgType::UserRegisterRsp_Type:
+		return std::make_shared<UserRegisterRspMsg>();
+	case E_MsgType::UserUnRegisterReq_Type:
+		return std::make_shared<UserUnRegisterReqMsg>();
+	case E_MsgType::UserUnRegisterRsp_Type:
+		return std::make_shared<UserUnRegisterRspMsg>();
+	case E_MsgType::FriendChatSendTxtMsgReq_Type:
+		return std::make_shared<FriendChatSendTxtReqMsg>();
+	case E_MsgType::FriendChatSendTxtMsgRsp_Type:
+		return std::make_shared<FriendChatSendTxtRspMsg>();
+	case E_MsgType::FriendChatReceiveTxtMsgReq_Type:
+		return std::make_shared<FriendChatRecvTxtReqMsg>();
+	case E_MsgType::FriendChatReceiveTxtMsgRsp_Type:
+		return std::make_shared<FriendChatRecvTxtRspMsg>();
+	case E_MsgType::GetFriendListReq_Type:
+		return std::make_shared<GetFriendListReqMsg>();
+	case E_MsgType::GetFriendListRsp_Type:
+		return std::make_shared<GetFriendListRspMsg>();
+	case E_MsgType::AddFriendSendReq_Type:
+		return std::make_shared<AddFriendSendReqMsg>();
+	case E_MsgType::AddFriendSendRsp_Type:
+		return std::make_shared<AddFriendSendRspMsg>();
+	case E_MsgType::AddFriendRecvReq_Type:
+		return std::make_shared<AddFriendRecvReqMsg>();
+	case E_MsgType::AddFriendRecvRsp_Type:
+		return std::make_shared<AddFriendRecvRspMsg>();
+	case E_MsgType::AddFriendNotifyReq_Type:
+		return std::make_shared<AddFriendNotifyReqMsg>();
+	case E_MsgType::AddFriendNotifyRsp_Type:
+		return std::make_shared<AddFriendNotifyRspMsg>();
+	case E_MsgType::RemoveFriendReq_Type:
+		return std::make_shared<RemoveFriendReqMsg>();
+	case E_MsgType::RemoveFriendRsp_Type:
+		return std::make_shared<RemoveFriendRspMsg>();
+	case E_MsgType::FindFriendReq_Type:
+		return std::make_shared<FindFriendReqMsg>();
+	case E_MsgType::FindFriendRsp_Type:
+		return std::make_shared<FindFriendRspMsg>();
+	case E_MsgType::AddTeamReq_Type:
+		return std::make_shared<AddTeamReqMsg>();
+	case E_MsgType::AddTeamRsp_Type:
+		return std::make_shared<AddTeamRspMsg>();
+	case E_MsgType::RemoveTeamReq_Type:
+		return std::make_shared<RemoveTeamReqMsg>();
+	case E_MsgType::RemoveTeamRsp_Type:
+		return std::make_shared<RemoveTeamRspMsg>();
+	case E_MsgType::MoveFriendToTeamReq_Type:
+		return std::make_shared<MoveFriendToTeamReqMsg>();
+	case E_MsgType::MoveFriendToTeamRsp_Type:
+		return std::make_shared<MoveFriendToTeamRspMsg>();
+	case E_MsgType::CreateGroupReq_Type:
+		return std::make_shared<CreateGroupReqMsg>();
+	case E_MsgType::CreateGroupRsp_Type:
+		return std::make_shared<CreateGroupRspMsg>();
+	case E_MsgType::DestroyGroupReq_Type:
+		return std::make_shared<DestroyGroupReqMsg>();
+	case E_MsgType::DestroyGroupRsp_Type:
+		return std::make_shared<DestroyGroupRspMsg>();
+	case E_MsgType::FindGroupReq_Type:
+		return std::make_shared<FindGroupReqMsg>();
+	case E_MsgType::FindGroupRsp_Type:
+		return std::make_shared<FindGroupRspMsg>();
+	case E_MsgType::AddToGroupReq_Type:
+		return std::make_shared<AddToGroupReqMsg>();
+	case E_MsgType::AddToGroupRsp_Type:
+		return std::make_shared<AddToGroupRspMsg>();
+	case E_MsgType::AddToGroupRecvReq_Type:
+		return std::make_shared<AddToGroupRecvReqMsg>();
+	case E_MsgType::AddToGroupRecvRsp_Type:
+		return std::make_shared<AddToGroupRecvRspMsg>();
+	case E_MsgType::AddToGroupNotifyReq_Type:
+		return std::make_shared<AddToGroupNotifyReqMsg>();
+	case E_MsgType::AddToGroupNotifyRsp_Type:
+		return std::make_shared<AddToGroupNotifyRspMsg>();
+	case E_MsgType::InviteFriendToGroupReq_Type:
+		return std::make_shared<InviteFriendToGroupReqMsg>();
+	case E_MsgType::InviteFriendToGroupRsp_Type:
+		return std::make_shared<InviteFriendToGroupRspMsg>();
+	case E_MsgType::InviteToGroupRecvReq_Type:
+		return std::make_shared<InviteFriendToGroupRecvReqMsg>();
+	case E_MsgType::InviteToGroupRecvRsp_Type:
+		return std::make_shared<InviteFriendToGroupRecvRspMsg>();
+	case E_MsgType::InviteResultNotifyReq_Type:
+		return std::make_shared<InviteFriendToGroupNotifyReqMsg>();
+	case E_MsgType::QuitGroupReq_Type:
+		return std::make_shared<QuitFromGroupReqMsg>();
+	case E_MsgType::QuitGroupRsp_Type:
+		return std::make_shared<QuitFromGroupRspMsg>();
+	case E_MsgType::InviteResultNotifyRsp_Type:
+		return std::make_shared<InviteFriendToGroupNotifyRspMsg>();
+	case E_MsgType::SendGroupTextMsgReq_Type:
+		return std::make_shared<SendGroupTextMsgReqMsg>();
+	case E_MsgType::SendGroupTextMsgRsp_Type:
+		return std::make_shared<SendGroupTextMsgRspMsg>();
+	case E_MsgType::RecvGroupTextMsgReq_Type:
+		return std::make_shared<RecvGroupTextMsgReqMsg>();
+	case E_MsgType::RecvGroupTextMsgRsp_Type:
+		return std::make_shared<RecvGroupTextMsgRspMsg>();
+	case E_MsgType::FriendSendFileMsgReq_Type:
+		return std::make_shared<FriendSendFileMsgReqMsg>();
+	case E_MsgType::FriendSendFileMsgRsp_Type:
+		return std::make_shared<FriendSendFileMsgRspMsg>();
+	case E_MsgType::FriendRecvFileMsgReq_Type:
+		return std::make_shared<FriendRecvFileMsgReqMsg>();
+	case E_MsgType::FriendRecvFileMsgRsp_Type:
+		return std::make_shared<FriendRecvFileMsgRspMsg>();
+	case E_MsgType::FriendNotifyFileMsgReq_Type:
+		return std::make_shared<FriendNotifyFileMsgReqMsg>();
+	case E_MsgType::FriendNotifyFileMsgRsp_Type:
+		return std::make_shared<FriendNotifyFileMsgRspMsg>();
+	case E_MsgType::GetGroupListReq_Type:
+		return std::make_shared<GetGroupListReqMsg>();
+	case E_MsgType::GetGroupListRsp_Type:
+		return std::make_shared<GetGroupListRspMsg>();
+	case E_MsgType::FileSendDataReq_Type:
+		return std::make_shared<FileDataSendReqMsg>();
+	case E_MsgType::FileSendDataRsp_Type:
+		return std::make_shared<FileDataSendRspMsg>();
+	case E_MsgType::FileRecvDataReq_Type:
+		return std::make_shared<FileDataRecvReqMsg>();
+	case E_MsgType::FileRecvDataRsp_Type:
+		return std::make_shared<FileDataRecvRspMsg>();
+	case E_MsgType::FileVerifyReq_Type:
+		return std::make_shared<FileVerifyReqMsg>();
+	case E_MsgType::FileVerifyRsp_Type:
+		return std::make_shared<FileVerifyRspMsg>();
+	case E_MsgType::UserKickOffReq_Type:
+		return std::make_shared<UserKickOffReqMsg>();
+	case E_MsgType::UserKickOffRsp_Type:
+		return std::make_shared<UserKickOffRspMsg>();
+	case E_MsgType::FriendUnReadMsgNotifyReq_Type:
+		return std::make_shared<FriendUnReadNotifyReqMsg>();
+	case E_MsgType::FriendUnReadMsgNotifyRsp_Type:
+		return std::make_shared<FriendUnReadNotifyRspMsg>();
+	case E_MsgType::UpdateFriendListNotifyReq_Type:
+		return std::make_shared<UpdateFriendListNotifyReqMsg>();
+	case E_MsgType::UpdateFriendListNotifyRsp_Type:
+		return std::make_shared<UpdateFriendListNotifyRspMsg>();
+	case E_MsgType::UpdateGroupListNotifyReq_Type:
+		return std::make_shared<UpdateGroupListNotifyReqMsg>();
+	case E_MsgType::UpdateGroupListNotifyRsp_Type:
+		return std::make_shared<UpdateGroupListNotifyRspMsg>();
+	case E_MsgType::QueryUserUdpAddrReq_Type:
+		return std::make_shared<QueryUserUdpAddrReqMsg>();
+	case E_MsgType::QueryUserUdpAddrRsp_Type:
+		return std::make_shared<QueryUserUdpAddrRspMsg>();
+	case E_MsgType::GetFriendChatHistroyReq_Type:
+		return std::make_shared<GetFriendChatHistoryReq>();
+	case E_MsgType::GetFriendChatHistoryRsp_Type:
+		return std::make_shared<GetFriendChatHistoryRsp>();
+	case E_MsgType::GetGroupChatHistoryReq_Type:
+		return std::make_shared<GetGroupChatHistoryReq>();
+	case E_MsgType::GetGroupChatHistoryRsp_Type:
+		return std::make_shared<GetGroupChatHistoryRsp>();
+	case E_MsgType::SearchChatMsgReq_Type:
+		return std::make_shared<SearchChatHistoryReq>();
+	case E_MsgType::SearchChatMsgRsp_Type:
+		return std::make_shared<SearchChatHistoryRsp>();
+	case E_MsgType::AsyncFriendChatMsgReq_Type:
+		return std::make_shared<AsyncFriendChatMsgReq>();
+	case E_MsgType::AsyncFriendChatMsgRsp_Type:
+		return std::make_shared<AsyncFriendChatMsgRsp>();
+	case E_MsgType::AsyncGroupChatMsgReq_Type:
+		return std::make_shared<AsyncGroupChatMsgReq>();
+	case E_MsgType::AsyncGroupChatMsgRsp_Type:
+		return std::make_shared<AsyncGroupChatMsgRsp>();
+	case E_MsgType::FileSendDataBeginReq_Type:
+		return std::make_shared<FileSendDataBeginReq>();
+	case E_MsgType::FileSendDataBeginRsp_Type:
+		return std::make_shared<FileSendDataBeginRsp>();
+	case E_MsgType::FileTransProgressNotifyReq_Type:
+		return std::make_shared<FileTransProgressNotifyReqMsg>();
+	case E_MsgType::FileDownLoadReq_Type:
+		return std::make_shared<FileDownLoadReqMsg>();
+	case E_MsgType::FileDownLoadRsp_Type:
+		return std::make_shared<FileDownLoadRspMsg>();
+	case E_MsgType::GetRandomUserReq_Type:
+		return std::make_shared<GetRandomUserReqMsg>();
+	case E_MsgType::GetRandomUserRsp_Type:
+		return std::make_shared<GetRandomUserRspMsg>();
+	case E_MsgType::UdpP2PStartReq_Type:
+		return std::make_shared<UdpP2pStartReqMsg>();
+	case E_MsgType::UdpP2PStartRsp_Type:
+		return std::make_shared<UdpP2pStartRspMsg>();
+	case E_MsgType::UdpMultiCastReq_Type:
+		return std::make_shared<UdpMultiCastReqMsg>();
+	case E_MsgType::UdpMultiCastRsp_Type:
+		return std::make_shared<UdpMultiCastRspMsg>();
+	case E_MsgType::NotifyGroupMsgReq_Type:
+		return std::make_shared<NotifyGroupMsgReqMsg>();
+	case E_MsgType::NotifyGroupMsgRsp_Type:
+		return std::make_shared<NotifyGroupMsgRspMsg>();
+	case E_MsgType::FriendStateChangeNotifyReq_Type:
+		return std::make_shared<FriendStateChangeNotifyReqMsg>();
+	case E_MsgType::FriendStateChangeNotifyRsp_Type:
+		return std::make_shared<FriendStateChangeNotifyRspMsg>();
+	case E_MsgType::GroupMemberStateChangeNotifyReq_Type:
+		return std::make_shared<GroupMemberStateChangeNotifyReqMsg>();
+	case E_MsgType::FriendFileTransResultNotifyReq_Type:
+		return std::make_shared<FriendTransFileResultNotifyReqMsg>();
+	case E_MsgType::GroupMemberStateChangeNotifyRsp_Type:
+		return std::make_shared<GroupTransFileResultNotifyReqMsg>();
+	case E_MsgType::RecvGroupTextMsgBatchReq_Type:
+		return std::make_shared<RecvGroupTextMsgBatchReqMsg>();
+	default:
+		return nullptr;
+	}
+}
+
+/**
+ * @brief 将二进制编码的消息转为json编码的消息
+ * 
+ * @param msg 传输的消息
+ * @return TransBaseMsg_S_PTR 转码失败返回nullptr
+ */
+TransBaseMsg_S_PTR ToJsonTransMsg(const TransBaseMsg_t& msg)
+{
+	if (!msg.IsBinary())
+	{
+		return std::make_shared<TransBaseMsg_t>(msg);
+	}
+	auto pMsg = CreateMsgByType(msg.GetType());
+	if (pMsg && msg.DecodeMsg(*pMsg))
+	{
+		return std::make_shared<TransBaseMsg_t>(msg.GetType(), pMsg->ToString());
+	}
+	return nullptr;
+}
@@ -14,6 +14,46 @@
 #include "CommonDef.h"
 #include <stdlib.h>
 #include <string.h>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief 二进制消息编码,整数使用varint(有符号数先做zigzag),字符串使用varint长度前缀
+ * 
+ */
+class CBinaryWriter
+{
+public:
+	void WriteVarUInt(uint64_t nValue);//写入无符号varint
+	void WriteVarInt(int64_t nValue);//写入有符号varint
+	void WriteString(const std::string& strValue);//写入长度前缀的字符串
+	void WriteBytes(const char* pData, const std::size_t nLength);//写入长度前缀的字节块
+	void WriteRaw(const char* pData, const std::size_t nLength);//写入不带长度前缀的原始数据
+	const std::string& Data() const { return m_strData; }
+private:
+	std::string m_strData;
+};
+
+/**
+ * @brief 二进制消息解码,所有读取函数在数据不足或格式错误时返回false
+ * 
+ */
+class CBinaryReader
+{
+public:
+	explicit CBinaryReader(const char* pData, const std::size_t nLength);
+	bool ReadVarUInt(uint64_t& nValue);//读取无符号varint
+	bool ReadVarInt(int64_t& nValue);//读取有符号varint
+	bool ReadInt(int& nValue);//读取有符号varint并检查int范围
+	bool ReadString(std::string& strValue);//读取长度前缀的字符串
+	bool ReadBytes(char* pData, const std::size_t nBufLen, std::size_t& nLength);//读取长度前缀的字节块
+	bool ReadRaw(char* pData, const std::size_t nLength);//读取固定长度的原始数据
+	std::size_t Remain() const { return m_nLength - m_nPos; }//剩余没有读取的长度
+private:
+	const char* m_pData;
+	std::size_t m_nLength;
+	std::size_t m_nPos;
+};
 
  //用户基本信息
 struct UserBaseInfo {
@@ -65,6 +105,8 @@ public:
 	void SetUnderScore();//设置下划线
 	bool FromString(const std::string& strJson);//从json构造
 	std::string ToString() const;//转为json
+	void ToBinary(CBinaryWriter& writer) const;//二进制编码
+	bool FromBinary(CBinaryReader& reader);//二进制解码
 
 public:
 
@@ -111,11 +153,97 @@ ChatMsgElemVec MsgElemVec(const std::string strVec);
 struct Header
 {
 	//消息类型
-	int32_t   m_type;//消息类型
+	int32_t   m_type;//消息类型,高8位为标志位
 	//消息长度
 	int32_t    m_length;//消息长度
 };
 
+const int32_t MSG_TYPE_MASK = 0x00FFFFFF;//Header::m_type中消息类型所占的位
+const int32_t MSG_FLAG_BINARY = 0x01000000;//消息体为二进制编码,未设置时为json
+
+/**
+ * @brief 二进制文件数据帧的固定头部,头部之后依次为消息ID、发送者ID、接收者ID和原始文件数据
+ * 
+ */
+struct FileDataChunkHead_t
+{
+	int32_t m_nFileId;//文件ID
+	int32_t m_nDataTotalCount;//文件总数据包数
+	int32_t m_nDataIndex;//文件数据包索引
+	int32_t m_nDataLength;//本数据包的文件数据长度
+	int32_t m_nChunkSize;//发送方的分包大小,用于计算数据在文件中的偏移
+};
+
+const int32_t FILE_DATA_CHUNK_SIZE = 1024;//未协商时文件数据包的长度,与旧版本一致
+const int32_t FILE_DATA_TCP_CHUNK_SIZE = 64 * 1024;//TCP传输时默认请求的文件数据包长度
+const int32_t FILE_DATA_UDP_CHUNK_SIZE = 1200;//UDP传输时文件数据包的长度,加上帧头以后不超过以太网的MTU,避免IP分片
+const int32_t FILE_DATA_MAX_CHUNK_SIZE = 1024 * 1024;//文件数据包的最大长度
+const int32_t FILE_DATA_FRAME_RESERVE = 1024;//文件数据帧中除文件数据以外的部分的最大长度
+const int32_t MSG_DEFAULT_FRAME_SIZE = 16384;//未协商时单条消息的最大长度,与旧版本的接收缓冲区一致
+const int32_t MSG_MAX_FRAME_SIZE = FILE_DATA_MAX_CHUNK_SIZE + FILE_DATA_FRAME_RESERVE;//单条消息的最大长度
+
+/**
+ * @brief 协商单条消息的最大长度,登录时使用
+ * 
+ * @param nRequest 客户端请求的长度,0表示客户端不支持协商
+ * @param nLimit 服务器允许的长度
+ * @return int32_t 协商后的长度
+ */
+int32_t NegotiateFrameSize(const int32_t nRequest, const int32_t nLimit);
+
+/**
+ * @brief 协商文件数据包的长度,登录时使用,数据包加上帧头不能超过协商后的消息长度
+ * 
+ * @param nRequest 客户端请求的长度,0表示客户端不支持协商
+ * @param nLimit 服务器允许的长度
+ * @param nFrameSize 协商后的单条消息最大长度
+ * @return int32_t 协商后的长度
+ */
+int32_t NegotiateChunkSize(const int32_t nRequest, const int32_t nLimit, const int32_t nFrameSize);
+
+const int32_t GROUP_MSG_BATCH_DEFAULT = 50;//服务器默认允许的每批群聊消息条数
+const int32_t GROUP_MSG_BATCH_MAX = 500;//每批群聊消息条数的上限
+
+/**
+ * @brief 协商每批下发的群聊消息条数,登录时使用
+ * 
+ * @param nRequest 客户端请求的条数,0表示客户端不支持批量接收
+ * @param nLimit 服务器允许的条数,0表示服务器关闭批量下发
+ * @return int32_t 协商后的条数,0表示逐条下发
+ */
+int32_t NegotiateGroupMsgBatch(const int32_t nRequest, const int32_t nLimit);
+
+/**
+ * @brief 按数据包长度计算文件的数据包个数
+ * 
+ * @param nFileSize 文件大小
+ * @param nChunkSize 数据包长度
+ * @return int32_t 数据包个数
+ */
+int32_t FileDataChunkCount(const int nFileSize, const int32_t nChunkSize);
+
+class FileDataRecvReqMsg;
+
+/**
+ * @brief 生成二进制文件数据帧中文件数据之前的部分,帧头中的长度包括文件数据
+ *        发送方在这部分之后直接写入m_nDataLength字节的文件数据,与TransBaseMsg_t(msg, true)的结果相同
+ * 
+ * @param msg 文件数据接收请求消息,不使用m_dataVec
+ * @return std::string 帧头、文件数据头部和三个ID
+ */
+std::string FileDataFramePrefix(const FileDataRecvReqMsg& msg);
+
+/**
+ * @brief 是否为携带文件数据的消息,这类消息总是使用二进制编码,不做hex转换
+ * 
+ * @param type 消息类型
+ * @return true 文件数据消息
+ * @return false 其他消息
+ */
+bool IsFileDataMsgType(const E_MsgType& type);
+
+struct BaseMsg;
+
 
 
 /**
@@ -160,6 +288,14 @@ public:
 	 * @param strMsg  消息字符串
 	 */
 	explicit TransBaseMsg_t(const E_MsgType& type, const std::string& strMsg);
+	/**
+	 * @brief 使用消息构造传输的消息,bBinary为true时使用二进制编码
+	 *
+	 * @param msg 待发送的消息
+	 * @param bBinary 是否使用二进制编码,消息没有二进制编码时仍然使用json
+	 */
+	explicit TransBaseMsg_t(const BaseMsg& msg, const bool bBinary);
+
 	/**
 	 * @brief 从内存直接构造消息，接收消息的时候使用
 	 * 
@@ -167,12 +303,57 @@ public:
 	 */
 	explicit TransBaseMsg_t(const char * data);
 
+	/**
+	 * @brief 构造引用接收缓冲区的消息,不拷贝数据,消息存在期间pOwner保持缓冲区有效
+	 * 
+	 * @param pOwner 数据所在的缓冲区
+	 * @param data 消息在缓冲区中的位置
+	 */
+	explicit TransBaseMsg_t(const std::shared_ptr<const void>& pOwner, const char * data);
+
+	/**
+	 * @brief 拷贝消息,拷贝后的消息自己保存数据,保留编码标志
+	 * 
+	 * @param other 被拷贝的消息
+	 */
+	TransBaseMsg_t(const TransBaseMsg_t& other);
+
+	TransBaseMsg_t& operator=(const TransBaseMsg_t& other) = delete;
+
+	/**
+	 * @brief 消息体是否为二进制编码
+	 * 
+	 * @return true 二进制编码
+	 * @return false json编码
+	 */
+	bool IsBinary() const;
+
+	/**
+	 * @brief 根据消息体的编码方式解码到msg
+	 * 
+	 * @param msg 解码的目标消息
+	 * @return true 解码成功
+	 * @return false 解码失败
+	 */
+	bool DecodeMsg(BaseMsg& msg) const;
+
+	/**
+	 * @brief 获取用于打印日志的字符串,二进制消息只打印长度
+	 * 
+	 * @return std::string 
+	 */
+	std::string ToPrintString() const;
+
 	virtual ~TransBaseMsg_t();
 protected:
+	//使用带标志位的类型和消息体初始化数据块
+	void Init(const int32_t nType, const std::string& strMsg);
 	//数据块内容
 	char *   m_data;
 	//是否自己保存了数据
 	bool m_selfData = false;
+	//引用缓冲区数据时,保持缓冲区有效
+	std::shared_ptr<const void> m_pOwner;
 };
 
 using TransBaseMsg_S_PTR=std::shared_ptr<TransBaseMsg_t>;
@@ -266,8 +447,62 @@ public:
 	virtual std::string ToPrintString() const {
 		return ToString();
 	}
+
+	/**
+	 * @brief 是否有逐个字段的二进制编码,没有时即使协商了二进制编码也按json发送
+	 * 
+	 * @return true 有单独实现的ToBinary/FromBinary
+	 */
+	virtual bool HasBinary() const
+	{
+		return false;
+	}
+
+	/**
+	 * @brief 二进制序列化,没有单独实现的消息把json串作为一个字符串写入,
+	 *        发送时不再使用,只用于解码旧版本发送的这种二进制帧
+	 * 
+	 * @param writer 二进制编码器
+	 */
+	virtual void ToBinary(CBinaryWriter& writer) const
+	{
+		writer.WriteString(ToString());
+	}
+
+	/**
+	 * @brief 二进制反序列化,与ToBinary对应
+	 * 
+	 * @param reader 二进制解码器
+	 * @return true 反序列化成功
+	 * @return false 反序列化失败
+	 */
+	virtual bool FromBinary(CBinaryReader& reader)
+	{
+		std::string strJson;
+		if (!reader.ReadString(strJson))
+		{
+			return false;
+		}
+		return FromString(strJson);
+	}
 };
 
+/**
+ * @brief 根据消息类型创建对应的消息对象,用于不知道具体类型时的转码
+ * 
+ * @param type 消息类型
+ * @return std::shared_ptr<BaseMsg> 未知的类型返回nullptr
+ */
+std::shared_ptr<BaseMsg> CreateMsgByType(const E_MsgType& type);
+
+/**
+ * @brief 将二进制编码的消息转为json编码的消息,json编码的消息直接拷贝
+ * 
+ * @param msg 传输的消息
+ * @return TransBaseMsg_S_PTR 转码失败返回nullptr
+ */
+TransBaseMsg_S_PTR ToJsonTransMsg(const TransBaseMsg_t& msg);
+
 
 /**
  * @brief 网络连接断开上报消息
@@ -322,6 +557,9 @@ public:
 	virtual std::string ToString() const override;
 
 	virtual bool FromString(const std::string& strJson) override;
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
 };
 
 /**
@@ -340,6 +578,9 @@ public:
 	virtual std::string ToString() const override;
 
 	virtual bool FromString(const std::string& strJson) override;
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
 };
 
 
@@ -356,6 +597,9 @@ public:
 	CLIENT_OS_TYPE m_eOsType;//操作系统类型
 	CLIENT_NET_TYPE m_eNetType;//网络类型
 	CLIENT_STATE m_eOnlineType;//在线类型
+	int m_nMaxFrameSize;//请求的单条消息最大长度,0表示不协商
+	int m_nChunkSize;//请求的文件数据包长度,0表示不协商
+	int m_nGroupMsgBatch;//请求的每批群聊消息条数,0表示逐条接收
 public:
 	explicit UserLoginReqMsg();
 
@@ -380,7 +624,10 @@ public:
 	std::string m_strUserId;//用户ID
 	std::string m_strUserName; //用户名
 	UserBaseInfo m_userInfo;//用户的基本信息
-	
+	int m_nMaxFrameSize;//协商后的单条消息最大长度
+	int m_nChunkSize;//协商后的文件数据包长度
+	int m_nGroupMsgBatch;//协商后的每批群聊消息条数,0表示逐条下发
+	bool m_bBinaryCodec;//服务器是否支持二进制编码,旧版本的服务器不回复此字段
 public:
 	explicit UserLoginRspMsg();
 
@@ -551,6 +798,10 @@ public:
 	
 	virtual bool FromString(const std::string& strJson) override;
 
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
+
 	virtual bool Valid() const override;
 	
 };
@@ -572,6 +823,10 @@ public:
 	
 	virtual bool FromString(const std::string& strJson) override;
 
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
+
 	virtual bool Valid() const override;
 };
 
@@ -594,6 +849,10 @@ public:
 	
 	virtual bool FromString(const std::string& strJson) override;
 
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
+
 	virtual bool Valid() const override;
 	
 };
@@ -616,6 +875,10 @@ public:
 	
 	virtual bool FromString(const std::string& strJson) override;
 
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
+
 	virtual bool Valid() const override;
 	
 };
@@ -1430,6 +1693,9 @@ public:
 	virtual std::string ToString() const override;
 	
 	virtual bool FromString(const std::string& strJson) override;
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
 
 };
 
@@ -1451,6 +1717,9 @@ public:
 	virtual std::string ToString() const override;
 
 	virtual bool FromString(const std::string& strJson) override;
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
 
 };
 
@@ -1471,6 +1740,9 @@ public:
 	virtual std::string ToString() const override;
 	
 	virtual bool FromString(const std::string& strJson) override;
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
 
 };
 
@@ -1491,6 +1763,35 @@ public:
 	virtual std::string ToString() const override;
 
 	virtual bool FromString(const std::string& strJson);
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
+
+};
+
+/**
+ * @brief 批量接收群组的文本聊天消息[服务器--->接收方]
+ * 
+ * 登录时协商了批量条数的用户,服务器一次下发读取位置以后的多条消息,
+ * 接收方处理完以后回复一个RecvGroupTextMsgRspMsg,ChatMsgId填写m_strLastChatMsgId
+ */
+class RecvGroupTextMsgBatchReqMsg :public BaseMsg
+{
+public:
+	std::string m_strMsgId;//消息ID
+	std::string m_strUserId;//用户ID
+	std::string m_strGroupId;//群组ID
+	std::string m_strLastChatMsgId;//本批最后一条消息的ID,包括没有下发的非文本消息
+	std::vector<GroupChatMsg_s> m_chatMsgVec;
+public:
+	RecvGroupTextMsgBatchReqMsg();
+
+	virtual std::string ToString() const override;
+
+	virtual bool FromString(const std::string& strJson) override;
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
 
 };
 
@@ -1680,7 +1981,8 @@ public:
 	int			m_nDataTotalCount;//文件总数据包数
 	int			m_nDataIndex;//文件数据包索引
 	int			m_nDataLength;//文件数据长度
-	char		m_szData[1024];//实际数据
+	int			m_nChunkSize;//分包大小,数据在文件中的偏移为(m_nDataIndex-1)*m_nChunkSize
+	std::vector<char> m_dataVec;//实际数据,长度为m_nDataLength
 public:
 	FileDataSendReqMsg();
 
@@ -1688,7 +1990,9 @@ public:
 
 
 	virtual bool FromString(const std::string& strJson) override;
-
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
 };
 
 /**
@@ -1703,13 +2007,17 @@ public:
 	std::string m_strFriendId;//接受者ID
 	int		    m_nFileId;//文件ID
 	int			m_nDataTotalCount;//文件总数据包数
-	int			m_nDataIndex;//文件数据包索引
+	int			m_nDataIndex;//本次确认的文件数据包索引
+	int			m_nCumAckIndex;//累计确认,该索引及之前的数据包全部已收到
 public:
 	FileDataSendRspMsg();
 
 	virtual std::string ToString() const override;
 	
 	virtual bool FromString(const std::string& strJson) override;
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
 };
 
 
@@ -1727,13 +2035,17 @@ public:
 	int			m_nDataTotalCount;//文件总数据包数
 	int			m_nDataIndex;//文件数据包索引
 	int			m_nDataLength;//文件数据长度
-	char		m_szData[1024];//实际数据
+	int			m_nChunkSize;//分包大小,数据在文件中的偏移为(m_nDataIndex-1)*m_nChunkSize
+	std::vector<char> m_dataVec;//实际数据,长度为m_nDataLength
 public:
 	FileDataRecvReqMsg();
 
 	virtual std::string ToString() const override;
 
 	virtual bool FromString(const std::string& strJson) override;
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
 };
 
 
@@ -1749,13 +2061,17 @@ public:
 	std::string m_strFriendId;//接受者ID
 	int		    m_nFileId;//文件ID
 	int			m_nDataTotalCount;//文件总数据包数
-	int			m_nDataIndex;//文件数据包索引
+	int			m_nDataIndex;//本次确认的文件数据包索引
+	int			m_nCumAckIndex;//累计确认,该索引及之前的数据包全部已收到
 public:
 	FileDataRecvRspMsg();
 
 	virtual std::string ToString() const override;
 	
 	virtual bool FromString(const std::string& strJson) override;
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
 };
 
 
@@ -2172,6 +2488,11 @@ public:
 	int m_nFileId;//文件Id
 	std::string m_strFileHash;//文件的Hash值
 	FILE_TYPE   m_eFileType;
+	int m_nFileSize;//文件大小,旧版本没有此字段,为0时接收端不续传
+	int m_nChunkSize;//发送端的数据包长度,续传时按此长度计算缺少的数据包
+	bool m_bProofSupport;//发送端支持秒传的持有证明,旧版本没有此字段,服务器不给旧版本秒传
+	std::string m_strProofSalt;//服务器回复E_CODE_FILE_NEED_PROOF时给出的盐
+	std::string m_strFileProof;//持有文件的证明,BLAKE2b(盐 + 文件内容)
 public:
 	FileSendDataBeginReq();
 	virtual std::string ToString() const override;
@@ -2194,6 +2515,10 @@ public:
 	std::string m_strFileName;//文件名
 	int m_nFileId;//文件ID
 	FILE_TYPE   m_eFileType;
+	bool m_bResume;//接收端已经有上次中断时收到的数据,只需要发送缺少的数据包
+	int m_nChunkSize;//缺少的数据包范围对应的数据包长度
+	std::vector<std::pair<int, int>> m_missingRangeVec;//缺少的数据包范围,起止索引都包含在内
+	std::string m_strProofSalt;//错误码为E_CODE_FILE_NEED_PROOF时,发送端用此盐计算持有证明
 public:
 	FileSendDataBeginRsp();
 	virtual std::string ToString() const override;
@@ -2336,6 +2661,9 @@ public:
 	NotifyGroupMsgReqMsg();
 	virtual std::string ToString() const override;
 	virtual bool FromString(const std::string& strJson) override;
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
 };
 
 class NotifyGroupMsgRspMsg :public BaseMsg
@@ -2348,6 +2676,9 @@ public:
 	NotifyGroupMsgRspMsg();
 	virtual std::string ToString() const override;
 	virtual bool FromString(const std::string& strJson) override;
+	virtual void ToBinary(CBinaryWriter& writer) const override;
+	virtual bool FromBinary(CBinaryReader& reader) override;
+	virtual bool HasBinary() const override { return true; }
 };
 
 class FriendStateChangeNotifyReqMsg :public BaseMsg